@@ -0,0 +1,759 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * 映像パイプラインのホスト上でのベンチマーク
+ * 映像フォーマット(uvc_raw_frame_t)・映像サイズ毎に各ステージを実行して
+ * ns/frame, MB/s, フレーム当たりのメモリー確保回数, p50/p99をJSONで出力する
+ *
+ *   convert  非圧縮映像 → RGBA (convertToRgba)
+ *   convert_mt 非圧縮映像 → RGBA, 横帯に分割して並列変換 (convertToRgbaParallel)
+ *            --threadsで指定したスレッド数毎に計測する(既定は1からCPUのコア数まで倍々)
+ *   decode   MJPEG → RGBA, 元サイズ (MjpegDecoder)
+ *   decode_half MJPEG → RGBA, 1/2サイズ (スケーリングIDCT)
+ *   scale    RGBA → 1/2サイズ (scaleRgba)
+ *   mux      記録ファイルへの書き込み (FrameCaptureWriter)
+ *   fanout   記録ファイルを最大速度で再生してFlutterUvcFrameRendererから
+ *            プレビュー(1/2サイズ)と録画(元サイズ)の2つのANativeWindowへ描画する
+ *
+ * 使い方
+ *   flutter-uvc-benchmark [--frames N] [--sizes 480p,720p,1080p,4k]
+ *       [--types yuyv,nv21,nv12,rgb565,rgbx,mjpeg,h264] [--stages convert,decode,...]
+ *       [--threads 1,2,4] [--output result.json] [--baseline old.json] [--threshold 10]
+ * --baselineを指定すると同じステージ/映像フォーマット/映像サイズ/スレッド数のns/frameを比較して
+ * threshold%以上遅くなったものがあれば終了コード1を返す
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "jpeglib.h"
+
+#include "flutter_frame_capture.h"
+#include "flutter_frame_converter.h"
+#include "flutter_frame_scaler.h"
+#include "flutter_mjpeg_decoder.h"
+#include "flutter_uvc_frame_renderer.h"
+#include "host_native_window.h"
+
+using namespace serenegiant::flutter;
+
+//--------------------------------------------------------------------------------
+// メモリー確保回数の計測
+// glibcならmallocを置き換えてlibjpeg等のC側の確保も数える
+// それ以外はoperator newのみ
+//--------------------------------------------------------------------------------
+static std::atomic<uint64_t> alloc_count{0};
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t num, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+	alloc_count.fetch_add(1, std::memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size)
+{
+	alloc_count.fetch_add(1, std::memory_order_relaxed);
+	return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	alloc_count.fetch_add(1, std::memory_order_relaxed);
+	return __libc_realloc(ptr, size);
+}
+}	// extern "C"
+#else
+void *operator new(size_t size)
+{
+	alloc_count.fetch_add(1, std::memory_order_relaxed);
+	void *p = malloc(size ? size : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+#endif
+
+//--------------------------------------------------------------------------------
+typedef struct bench_size {
+	const char *name;
+	uint32_t width;
+	uint32_t height;
+} bench_size_t;
+
+static const bench_size_t SIZES[] = {
+	{ "480p", 640, 480 },
+	{ "720p", 1280, 720 },
+	{ "1080p", 1920, 1080 },
+	{ "4k", 3840, 2160 },
+};
+
+typedef struct bench_type {
+	const char *name;
+	uint32_t frame_type;
+} bench_type_t;
+
+static const bench_type_t TYPES[] = {
+	{ "yuyv", RAW_FRAME_UNCOMPRESSED_YUYV },
+	{ "nv21", RAW_FRAME_UNCOMPRESSED_NV21 },
+	{ "nv12", RAW_FRAME_UNCOMPRESSED_NV12 },
+	{ "rgb565", RAW_FRAME_UNCOMPRESSED_RGB565 },
+	{ "rgbx", RAW_FRAME_UNCOMPRESSED_RGBX },
+	{ "mjpeg", RAW_FRAME_MJPEG },
+	{ "h264", RAW_FRAME_H264 },
+};
+
+static const char *STAGES[] = {
+	"convert", "convert_mt", "decode", "decode_half", "scale", "mux", "fanout",
+};
+
+/** 計測前に捨てるフレーム数 */
+#define WARMUP_FRAMES (3)
+
+typedef struct bench_result {
+	std::string stage;
+	std::string frame_type;
+	uint32_t width;
+	uint32_t height;
+	uint32_t frames;
+	double ns_per_frame;
+	double mb_per_s;
+	double allocs_per_frame;
+	int64_t p50_ns;
+	int64_t p99_ns;
+	/** 並列に処理したスレッド数, 並列化していないステージは1 */
+	uint32_t threads;
+} bench_result_t;
+
+static inline int64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int64_t percentile(std::vector<int64_t> &samples, const double &p)
+{
+	if (samples.empty()) return 0;
+	std::sort(samples.begin(), samples.end());
+	const size_t ix = std::min(samples.size() - 1, (size_t)(p * (samples.size() - 1) + 0.5));
+	return samples[ix];
+}
+
+/**
+ * 1フレーム毎の所要時間から結果を生成する
+ * @param bytes 1フレーム当たりの入力バイト数
+ * @param elapsed_ns 計測期間全体の所要時間, 0なら所要時間の合計を使う
+ */
+static bench_result_t make_result(
+	const char *stage, const bench_type_t &type, const bench_size_t &size,
+	std::vector<int64_t> &samples, const uint64_t &bytes,
+	const uint64_t &allocs, int64_t elapsed_ns = 0)
+{
+	if (!elapsed_ns) {
+		for (const auto &s : samples) elapsed_ns += s;
+	}
+	const auto frames = samples.size();
+	bench_result_t result;
+	result.stage = stage;
+	result.frame_type = type.name;
+	result.width = size.width;
+	result.height = size.height;
+	result.frames = frames;
+	result.ns_per_frame = frames ? (double)elapsed_ns / frames : 0.0;
+	result.mb_per_s = elapsed_ns > 0 ? (double)bytes * frames * 1000.0 / elapsed_ns : 0.0;
+	result.allocs_per_frame = frames ? (double)allocs / frames : 0.0;
+	result.p50_ns = percentile(samples, 0.50);
+	result.p99_ns = percentile(samples, 0.99);
+	result.threads = 1;
+	return result;
+}
+
+/**
+ * ウォームアップ後にframes回funcを実行して1回毎の所要時間を計測する
+ */
+static bench_result_t run_stage(
+	const char *stage, const bench_type_t &type, const bench_size_t &size,
+	const uint32_t &frames, const uint64_t &bytes, const std::function<int()> &func)
+{
+	for (int i = 0; i < WARMUP_FRAMES; i++) {
+		func();
+	}
+	std::vector<int64_t> samples;
+	samples.reserve(frames);
+	const auto allocs = alloc_count.load();
+	for (uint32_t i = 0; i < frames; i++) {
+		const auto start = now_ns();
+		if (func()) {
+			fprintf(stderr, "%s/%s/%s failed\n", stage, type.name, size.name);
+			break;
+		}
+		samples.push_back(now_ns() - start);
+	}
+	// samplesの確保分は計測期間外なので差し引く必要は無い
+	return make_result(stage, type, size, samples, bytes, alloc_count.load() - allocs);
+}
+
+//--------------------------------------------------------------------------------
+// 入力映像の生成
+//--------------------------------------------------------------------------------
+/**
+ * グラデーションに疑似乱数のノイズを加えたYUYV映像を生成する
+ * ノイズが無いとMJPEGが実機より極端に小さくなるので加える
+ */
+static void make_yuyv(const uint32_t &width, const uint32_t &height, std::vector<uint8_t> &yuyv)
+{
+	yuyv.resize((size_t)width * height * 2);
+	uint32_t seed = 0x12345678;
+	for (uint32_t y = 0; y < height; y++) {
+		uint8_t *dst = &yuyv[(size_t)y * width * 2];
+		for (uint32_t x = 0; x < width; x += 2, dst += 4) {
+			seed = seed * 1664525 + 1013904223;
+			const int noise = (int)(seed >> 28) - 8;
+			dst[0] = (uint8_t)std::clamp((int)(x * 255 / width) + noise, 16, 235);
+			dst[1] = (uint8_t)(y * 255 / height);
+			dst[2] = (uint8_t)std::clamp((int)((x + 1) * 255 / width) - noise, 16, 235);
+			dst[3] = (uint8_t)(255 - x * 255 / width);
+		}
+	}
+}
+
+static void yuyv_to_yuv420sp(
+	const std::vector<uint8_t> &yuyv, const uint32_t &width, const uint32_t &height,
+	const bool &vu, std::vector<uint8_t> &dst)
+{
+	dst.resize((size_t)width * height * 3 / 2);
+	uint8_t *y_plane = dst.data();
+	uint8_t *uv_plane = y_plane + (size_t)width * height;
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *src = &yuyv[(size_t)y * width * 2];
+		uint8_t *uv = uv_plane + (size_t)(y >> 1) * width;
+		for (uint32_t x = 0; x < width; x += 2, src += 4, uv += 2) {
+			y_plane[(size_t)y * width + x] = src[0];
+			y_plane[(size_t)y * width + x + 1] = src[2];
+			if (!(y & 1)) {
+				uv[vu ? 1 : 0] = src[1];
+				uv[vu ? 0 : 1] = src[3];
+			}
+		}
+	}
+}
+
+static void rgba_to_rgb565(const std::vector<uint8_t> &rgba, std::vector<uint8_t> &dst)
+{
+	const size_t pixels = rgba.size() / 4;
+	dst.resize(pixels * 2);
+	for (size_t i = 0; i < pixels; i++) {
+		const uint8_t *s = &rgba[i * 4];
+		const uint16_t p = (uint16_t)(((s[0] >> 3) << 11) | ((s[1] >> 2) << 5) | (s[2] >> 3));
+		dst[i * 2] = (uint8_t)(p & 0xff);
+		dst[i * 2 + 1] = (uint8_t)(p >> 8);
+	}
+}
+
+/**
+ * UVC機器のMJPEGと同じ4:2:2でエンコードする
+ */
+static int encode_jpeg(
+	const std::vector<uint8_t> &yuyv, const uint32_t &width, const uint32_t &height,
+	std::vector<uint8_t> &jpeg)
+{
+	jpeg_compress_struct cinfo{};
+	jpeg_error_mgr jerr{};
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_compress(&cinfo);
+	unsigned char *out = nullptr;
+	unsigned long out_size = 0;
+	jpeg_mem_dest(&cinfo, &out, &out_size);
+	cinfo.image_width = width;
+	cinfo.image_height = height;
+	cinfo.input_components = 3;
+	cinfo.in_color_space = JCS_YCbCr;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_quality(&cinfo, 85, TRUE);
+	cinfo.comp_info[0].h_samp_factor = 2;
+	cinfo.comp_info[0].v_samp_factor = 1;
+	jpeg_start_compress(&cinfo, TRUE);
+	std::vector<uint8_t> row(width * 3);
+	while (cinfo.next_scanline < cinfo.image_height) {
+		const uint8_t *src = &yuyv[(size_t)cinfo.next_scanline * width * 2];
+		for (uint32_t x = 0; x < width; x += 2, src += 4) {
+			uint8_t *dst = &row[x * 3];
+			dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[3];
+			dst[3] = src[2]; dst[4] = src[1]; dst[5] = src[3];
+		}
+		JSAMPROW rows[1] = { row.data() };
+		jpeg_write_scanlines(&cinfo, rows, 1);
+	}
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+	jpeg.assign(out, out + out_size);
+	free(out);
+	return jpeg.empty() ? -EIO : 0;
+}
+
+/**
+ * H.264のAnnex-Bストリームに見えるダミーデータを生成する
+ * デコードはしないので書き込み(mux)の計測にのみ使う
+ * 大きさは映像サイズの1/20程度(1080pで約100KB)
+ */
+static void make_h264(const uint32_t &width, const uint32_t &height, std::vector<uint8_t> &dst)
+{
+	dst.resize(std::max((size_t)64, (size_t)width * height / 20));
+	uint32_t seed = 0x9e3779b9;
+	for (auto &b : dst) {
+		seed = seed * 1664525 + 1013904223;
+		b = (uint8_t)(seed >> 24);
+	}
+	static const uint8_t IDR[] = { 0x00, 0x00, 0x00, 0x01, 0x65 };
+	memcpy(dst.data(), IDR, sizeof(IDR));
+}
+
+/**
+ * 指定した映像フォーマットの入力映像を生成する
+ */
+static int make_frame(
+	const uint32_t &frame_type, const uint32_t &width, const uint32_t &height,
+	std::vector<uint8_t> &frame)
+{
+	std::vector<uint8_t> yuyv;
+	make_yuyv(width, height, yuyv);
+	switch (frame_type) {
+	case RAW_FRAME_UNCOMPRESSED_YUYV:
+		frame.swap(yuyv);
+		return 0;
+	case RAW_FRAME_UNCOMPRESSED_NV12:
+	case RAW_FRAME_UNCOMPRESSED_NV21:
+		yuyv_to_yuv420sp(yuyv, width, height, frame_type == RAW_FRAME_UNCOMPRESSED_NV21, frame);
+		return 0;
+	case RAW_FRAME_UNCOMPRESSED_RGB565:
+	case RAW_FRAME_UNCOMPRESSED_RGBX:
+	{
+		std::vector<uint8_t> rgba((size_t)width * height * 4);
+		convertToRgba(RAW_FRAME_UNCOMPRESSED_YUYV, yuyv.data(), yuyv.size(),
+			width, height, rgba.data(), width * 4);
+		if (frame_type == RAW_FRAME_UNCOMPRESSED_RGBX) {
+			frame.swap(rgba);
+		} else {
+			rgba_to_rgb565(rgba, frame);
+		}
+		return 0;
+	}
+	case RAW_FRAME_MJPEG:
+		return encode_jpeg(yuyv, width, height, frame);
+	case RAW_FRAME_H264:
+		make_h264(width, height, frame);
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+//--------------------------------------------------------------------------------
+// 各ステージ
+//--------------------------------------------------------------------------------
+static std::string temp_path(const char *name)
+{
+	char path[256];
+	snprintf(path, sizeof(path), "/tmp/flutter-uvc-benchmark_%s_%d.uvccap", name, (int)getpid());
+	return path;
+}
+
+static bool is_uncompressed(const uint32_t &frame_type)
+{
+	return rawFrameBytes(frame_type, 2, 2) > 0;
+}
+
+static void bench_convert(
+	const bench_type_t &type, const bench_size_t &size, const uint32_t &frames,
+	const std::vector<uint8_t> &frame, std::vector<bench_result_t> &results)
+{
+	if (!is_uncompressed(type.frame_type)) return;
+	std::vector<uint8_t> rgba((size_t)size.width * size.height * 4);
+	results.push_back(run_stage("convert", type, size, frames, frame.size(), [&] {
+		return convertToRgba(type.frame_type, frame.data(), frame.size(),
+			size.width, size.height, rgba.data(), size.width * 4);
+	}));
+}
+
+/**
+ * スレッド数毎に分割並列変換を計測する
+ * 呼び出し元スレッドも変換するのでnスレッドならワーカースレッドはn-1
+ */
+static void bench_convert_mt(
+	const bench_type_t &type, const bench_size_t &size, const uint32_t &frames,
+	const std::vector<uint8_t> &frame, const std::vector<uint32_t> &threads,
+	std::vector<bench_result_t> &results)
+{
+	if (!is_uncompressed(type.frame_type)) return;
+	std::vector<uint8_t> rgba((size_t)size.width * size.height * 4);
+	for (const auto &n : threads) {
+		TaskPool pool(std::max(1u, n - 1));
+		auto result = run_stage("convert_mt", type, size, frames, frame.size(), [&] {
+			return convertToRgbaParallel(pool, 0, TASK_PRIORITY_PREVIEW, type.frame_type,
+				frame.data(), frame.size(), size.width, size.height, rgba.data(), size.width * 4, n);
+		});
+		result.threads = n;
+		results.push_back(result);
+	}
+}
+
+static void bench_decode(
+	const bench_type_t &type, const bench_size_t &size, const uint32_t &frames,
+	const std::vector<uint8_t> &frame, const bool &half, std::vector<bench_result_t> &results)
+{
+	if (type.frame_type != RAW_FRAME_MJPEG) return;
+	MjpegDecoder decoder;
+	std::vector<uint8_t> rgba;
+	const uint32_t dst_width = half ? size.width / 2 : 0;
+	const uint32_t dst_height = half ? size.height / 2 : 0;
+	results.push_back(run_stage(half ? "decode_half" : "decode", type, size, frames, frame.size(), [&] {
+		uint32_t width, height;
+		return decoder.decode(frame.data(), frame.size(), dst_width, dst_height, rgba, width, height);
+	}));
+}
+
+/**
+ * 縮小は映像フォーマットに依存しないのでRGBX(RGBA)としてのみ計測する
+ */
+static void bench_scale(
+	const bench_type_t &type, const bench_size_t &size, const uint32_t &frames,
+	const std::vector<uint8_t> &frame, std::vector<bench_result_t> &results)
+{
+	if (type.frame_type != RAW_FRAME_UNCOMPRESSED_RGBX) return;
+	const uint32_t dst_width = size.width / 2;
+	const uint32_t dst_height = size.height / 2;
+	std::vector<uint8_t> scaled((size_t)dst_width * dst_height * 4);
+	results.push_back(run_stage("scale", type, size, frames, frame.size(), [&] {
+		return scaleRgba(frame.data(), size.width, size.height, size.width * 4,
+			scaled.data(), dst_width, dst_height, dst_width * 4);
+	}));
+}
+
+static void bench_mux(
+	const bench_type_t &type, const bench_size_t &size, const uint32_t &frames,
+	const std::vector<uint8_t> &frame, std::vector<bench_result_t> &results)
+{
+	const auto path = temp_path("mux");
+	FrameCaptureWriter writer;
+	if (writer.open(path)) {
+		fprintf(stderr, "failed to open %s\n", path.c_str());
+		return;
+	}
+	int64_t pts_us = 0;
+	results.push_back(run_stage("mux", type, size, frames, frame.size(), [&] {
+		pts_us += 33333;
+		return writer.write(type.frame_type, size.width, size.height,
+			frame.data(), frame.size(), pts_us, 0);
+	}));
+	writer.close();
+	unlink(path.c_str());
+}
+
+/**
+ * 記録ファイルをFrameReplaySourceで最大速度で繰り返し再生して
+ * FlutterUvcFrameRendererのプレビュー(1/2サイズ)と録画(元サイズ)へ描画する
+ * フレーム毎の所要時間はフレームコールバックの呼び出し間隔で計測する
+ */
+static void bench_fanout(
+	const bench_type_t &type, const bench_size_t &size, const uint32_t &frames,
+	const std::vector<uint8_t> &frame, std::vector<bench_result_t> &results)
+{
+	if (type.frame_type == RAW_FRAME_H264) return;
+	const auto path = temp_path("fanout");
+	{
+		FrameCaptureWriter writer;
+		if (writer.open(path)) return;
+		writer.write(type.frame_type, size.width, size.height,
+			frame.data(), frame.size(), 0, 0);
+		writer.close();
+	}
+	auto source = std::make_shared<FrameReplaySource>();
+	if (source->open(path, 0.0f, true)) {
+		unlink(path.c_str());
+		return;
+	}
+	auto preview = host_native_window_create(size.width / 2, size.height / 2);
+	auto recording = host_native_window_create(size.width, size.height);
+	std::vector<int64_t> samples;
+	samples.reserve(frames);
+	std::atomic<uint32_t> count{0};
+	int64_t last = 0, start = 0;
+	uint64_t allocs = 0;
+	{
+		FlutterUvcFrameRenderer renderer(nullptr, 0);
+		renderer.setReplaySource(source);
+		renderer.setPreviewWindow(preview, size.width / 2, size.height / 2);
+		renderer.setRecordingWindow(recording, size.width, size.height);
+		renderer.setFrameCallback([&](const uint8_t *, size_t, uint32_t, uint32_t, int64_t) {
+			// コールバックはキャプチャースレッドから呼ばれる
+			const auto now = now_ns();
+			const auto n = count.load();
+			if (n == WARMUP_FRAMES) {
+				start = now;
+				allocs = alloc_count.load();
+			} else if ((n > WARMUP_FRAMES) && (n <= WARMUP_FRAMES + frames)) {
+				samples.push_back(now - last);
+				if (n == WARMUP_FRAMES + frames) {
+					allocs = alloc_count.load() - allocs;
+				}
+			}
+			last = now;
+			count++;
+		});
+		if (!renderer.start(size.width, size.height, type.frame_type)) {
+			const auto limit = now_ns() + 60 * 1000000000LL;
+			while ((count.load() <= WARMUP_FRAMES + frames) && (now_ns() < limit)) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			renderer.stop();
+		}
+		renderer.setPreviewWindow(nullptr);
+		renderer.setRecordingWindow(nullptr);
+	}
+	ANativeWindow_release(preview);
+	ANativeWindow_release(recording);
+	source->close();
+	unlink(path.c_str());
+	if (samples.size() == frames) {
+		results.push_back(make_result("fanout", type, size, samples, frame.size(), allocs, last - start));
+	} else {
+		fprintf(stderr, "fanout/%s/%s timed out\n", type.name, size.name);
+	}
+}
+
+//--------------------------------------------------------------------------------
+// JSON入出力
+//--------------------------------------------------------------------------------
+/**
+ * 1行に1つの結果を出力する
+ * リリース間でdiffしやすいように順序と書式は固定
+ */
+static void write_json(FILE *out, const uint32_t &frames, const std::vector<bench_result_t> &results)
+{
+	fprintf(out, "{\n");
+	fprintf(out, "  \"benchmark\": \"flutter-uvc-pipeline\",\n");
+	fprintf(out, "  \"version\": 2,\n");
+	fprintf(out, "  \"frames\": %u,\n", frames);
+	fprintf(out, "  \"results\": [\n");
+	for (size_t i = 0; i < results.size(); i++) {
+		const auto &r = results[i];
+		fprintf(out,
+			"    {\"stage\": \"%s\", \"frame_type\": \"%s\", \"width\": %u, \"height\": %u, "
+			"\"frames\": %u, \"ns_per_frame\": %.0f, \"mb_per_s\": %.1f, "
+			"\"allocs_per_frame\": %.2f, \"p50_ns\": %lld, \"p99_ns\": %lld, \"threads\": %u}%s\n",
+			r.stage.c_str(), r.frame_type.c_str(), r.width, r.height,
+			r.frames, r.ns_per_frame, r.mb_per_s,
+			r.allocs_per_frame, (long long)r.p50_ns, (long long)r.p99_ns, r.threads,
+			i + 1 < results.size() ? "," : "");
+	}
+	fprintf(out, "  ]\n");
+	fprintf(out, "}\n");
+}
+
+static std::string result_key(const std::string &stage, const std::string &type,
+	const uint32_t &width, const uint32_t &height, const uint32_t &threads)
+{
+	char key[128];
+	snprintf(key, sizeof(key), "%s/%s/%ux%u/%ut", stage.c_str(), type.c_str(), width, height, threads);
+	return key;
+}
+
+/**
+ * write_jsonで出力したファイルからns/frameを読み込む
+ * 1行1結果の自分自身の出力形式のみ対応
+ * threadsが無いversion 1の出力は全て1スレッドとして扱う
+ */
+static int read_baseline(const char *path, std::map<std::string, double> &baseline)
+{
+	FILE *fp = fopen(path, "r");
+	if (!fp) return -errno;
+	char line[1024];
+	while (fgets(line, sizeof(line), fp)) {
+		char stage[64], type[64];
+		uint32_t width, height, frames;
+		double ns_per_frame;
+		if (sscanf(line,
+			" {\"stage\": \"%63[^\"]\", \"frame_type\": \"%63[^\"]\", \"width\": %u, \"height\": %u, "
+			"\"frames\": %u, \"ns_per_frame\": %lf",
+			stage, type, &width, &height, &frames, &ns_per_frame) == 6) {
+			uint32_t threads = 1;
+			const char *p = strstr(line, "\"threads\": ");
+			if (p) sscanf(p, "\"threads\": %u", &threads);
+			baseline[result_key(stage, type, width, height, threads)] = ns_per_frame;
+		}
+	}
+	fclose(fp);
+	return 0;
+}
+
+static bool contains(const std::vector<std::string> &list, const char *name)
+{
+	return list.empty() || (std::find(list.begin(), list.end(), name) != list.end());
+}
+
+static std::vector<std::string> split(const char *arg)
+{
+	std::vector<std::string> result;
+	std::string s(arg);
+	size_t start = 0;
+	while (start <= s.size()) {
+		const auto end = s.find(',', start);
+		const auto item = s.substr(start, end == std::string::npos ? std::string::npos : end - start);
+		if (!item.empty()) result.push_back(item);
+		if (end == std::string::npos) break;
+		start = end + 1;
+	}
+	return result;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [--frames N] [--sizes 480p,720p,1080p,4k]\n"
+		"    [--types yuyv,nv21,nv12,rgb565,rgbx,mjpeg,h264]\n"
+		"    [--stages convert,convert_mt,decode,decode_half,scale,mux,fanout]\n"
+		"    [--threads 1,2,4] [--output result.json] [--baseline old.json] [--threshold percent]\n",
+		name);
+}
+
+int main(int argc, const char *argv[])
+{
+	uint32_t frames = 30;
+	std::vector<std::string> sizes, types, stages;
+	std::vector<uint32_t> threads;
+	const char *output = nullptr;
+	const char *baseline_path = nullptr;
+	double threshold = 10.0;
+	for (int i = 1; i < argc; i++) {
+		const bool has_value = i + 1 < argc;
+		if (!strcmp(argv[i], "--frames") && has_value) {
+			frames = std::max(1, atoi(argv[++i]));
+		} else if (!strcmp(argv[i], "--sizes") && has_value) {
+			sizes = split(argv[++i]);
+		} else if (!strcmp(argv[i], "--types") && has_value) {
+			types = split(argv[++i]);
+		} else if (!strcmp(argv[i], "--stages") && has_value) {
+			stages = split(argv[++i]);
+		} else if (!strcmp(argv[i], "--threads") && has_value) {
+			for (const auto &t : split(argv[++i])) {
+				threads.push_back(std::max(1, atoi(t.c_str())));
+			}
+		} else if (!strcmp(argv[i], "--output") && has_value) {
+			output = argv[++i];
+		} else if (!strcmp(argv[i], "--baseline") && has_value) {
+			baseline_path = argv[++i];
+		} else if (!strcmp(argv[i], "--threshold") && has_value) {
+			threshold = atof(argv[++i]);
+		} else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+
+	if (threads.empty()) {
+		const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+		for (uint32_t n = 1; n < cores; n *= 2) {
+			threads.push_back(n);
+		}
+		threads.push_back(cores);
+	}
+
+	std::vector<bench_result_t> results;
+	for (const auto &size : SIZES) {
+		if (!contains(sizes, size.name)) continue;
+		for (const auto &type : TYPES) {
+			if (!contains(types, type.name)) continue;
+			std::vector<uint8_t> frame;
+			if (make_frame(type.frame_type, size.width, size.height, frame)) {
+				fprintf(stderr, "failed to make %s %s frame\n", type.name, size.name);
+				continue;
+			}
+			fprintf(stderr, "%s %s (%zu bytes)\n", size.name, type.name, frame.size());
+			if (contains(stages, "convert")) bench_convert(type, size, frames, frame, results);
+			if (contains(stages, "convert_mt")) bench_convert_mt(type, size, frames, frame, threads, results);
+			if (contains(stages, "decode")) bench_decode(type, size, frames, frame, false, results);
+			if (contains(stages, "decode_half")) bench_decode(type, size, frames, frame, true, results);
+			if (contains(stages, "scale")) bench_scale(type, size, frames, frame, results);
+			if (contains(stages, "mux")) bench_mux(type, size, frames, frame, results);
+			if (contains(stages, "fanout")) bench_fanout(type, size, frames, frame, results);
+		}
+	}
+	for (const auto &stage : stages) {
+		if (std::none_of(std::begin(STAGES), std::end(STAGES),
+			[&](const char *s) { return stage == s; })) {
+			fprintf(stderr, "unknown stage %s\n", stage.c_str());
+		}
+	}
+
+	FILE *out = output ? fopen(output, "w") : stdout;
+	if (!out) {
+		fprintf(stderr, "failed to open %s\n", output);
+		return 1;
+	}
+	write_json(out, frames, results);
+	if (out != stdout) fclose(out);
+
+	int exit_code = 0;
+	if (baseline_path) {
+		std::map<std::string, double> baseline;
+		if (read_baseline(baseline_path, baseline)) {
+			fprintf(stderr, "failed to read %s\n", baseline_path);
+			return 1;
+		}
+		for (const auto &r : results) {
+			const auto key = result_key(r.stage, r.frame_type, r.width, r.height, r.threads);
+			const auto it = baseline.find(key);
+			if ((it == baseline.end()) || (it->second <= 0.0)) continue;
+			const double change = (r.ns_per_frame - it->second) * 100.0 / it->second;
+			if (change > threshold) {
+				fprintf(stderr, "REGRESSION %s: %.0f -> %.0f ns/frame (+%.1f%%)\n",
+					key.c_str(), it->second, r.ns_per_frame, change);
+				exit_code = 1;
+			}
+		}
+	}
+
+	return exit_code;
+}
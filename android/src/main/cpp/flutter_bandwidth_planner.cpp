@@ -0,0 +1,341 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#define LOG_TAG "BandwidthPlanner"
+
+#if 1	// デバッグ情報を出さない時は1
+	#ifndef LOG_NDEBUG
+		#define	LOG_NDEBUG		// LOGV/LOGD/MARKを出力しない時
+	#endif
+	#undef USE_LOGALL			// 指定したLOGxだけを出力
+#else
+	#define USE_LOGALL
+	#define USE_LOGD
+	#undef LOG_NDEBUG
+	#undef NDEBUG
+#endif
+
+// 標準ライブラリ
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+// aandusb
+#include "utilbase.h"
+// flutter
+#include "flutter_video_size.h"
+#include "flutter_bandwidth_planner.h"
+
+namespace serenegiant::flutter
+{
+
+/**
+ * MJPEGの圧縮率の見積もり(YUYVに対する比)
+ * 実際に確保されるアイソクロナス帯域はUVC機器のdwMaxPayloadTransferSizeに依存するので控えめにしておく
+ */
+#define MJPEG_COMPRESSION_RATIO (4)
+/**
+ * H264/H265/VP8の圧縮率の見積もり(NV12に対する比)
+ */
+#define H26X_COMPRESSION_RATIO (20)
+
+	/**
+	 * 非圧縮フォーマットの1ピクセルあたりのバイト数×2を取得
+	 * 値は映像フォーマットのGUIDに対応するuvc_raw_frame_tの値
+	 * @param frame_type
+	 * @return 非圧縮フォーマットでなければ0
+	 */
+	static uint32_t uncompressed_half_bytes_per_pixel(const uint32_t &frame_type)
+	{
+		if ((frame_type & 0x0000ffff) != 0x00000005)
+		{
+			// 非圧縮フォーマットではない
+			return 0;
+		}
+		switch (frame_type)
+		{
+		case 0x00030005:	// GRAY8
+		case 0x00040005:	// BY8
+			return 2;
+		case 0x00050005:	// NV21
+		case 0x00060005:	// YV12
+		case 0x00070005:	// I420
+		case 0x000b0005:	// NV12
+		case 0x00170005:	// 411p
+		case 0x00180005:	// 411sp
+			return 3;
+		case 0x000e0005:	// RGB
+		case 0x000f0005:	// BGR
+		case 0x00110005:	// 444p
+		case 0x00120005:	// 444sp
+			return 6;
+		case 0x00100005:	// RGBX
+		case 0x001a0005:	// XRGB
+		case 0x001b0005:	// XBGR
+		case 0x001c0005:	// BGRX
+			return 8;
+		default:			// YUYV/UYVY/Y16/RGB565/422p/422sp等
+			return 4;
+		}
+	}
+
+	/**
+	 * 指定したフォーマットの処理負荷の重みを取得
+	 * 非圧縮フォーマットは色空間変換のみ、MJPEGはデコードが必要、
+	 * H264等はハードウエアデコーダーの確保が必要なので最も重くする
+	 * @param frame_type
+	 * @return
+	 */
+	static uint64_t cost_weight(const uint32_t &frame_type)
+	{
+		if (uncompressed_half_bytes_per_pixel(frame_type))
+		{
+			return 4;
+		}
+		else if (frame_type == RAW_FRAME_MJPEG)
+		{
+			return 12;
+		}
+		else
+		{
+			return 24;
+		}
+	}
+
+	/*public*/
+	BandwidthPlanner::BandwidthPlanner(
+		const uint64_t &bus_bandwidth,
+		const uint64_t &endpoint_bandwidth)
+	:	m_bus_bandwidth(bus_bandwidth),
+		m_endpoint_bandwidth(endpoint_bandwidth)
+	{
+		ENTER();
+		EXIT();
+	}
+
+	/**
+	 * 指定した映像設定に必要な帯域[バイト/秒]を見積もる
+	 * 非圧縮フォーマットは1フレームのバイト数×フレームレート、
+	 * MJPEG/H264等の圧縮フォーマットは典型的な圧縮率で見積もる
+	 * @param frame_type
+	 * @param width
+	 * @param height
+	 * @param frame_interval フレームインターバル[100ナノ秒単位]
+	 * @return 帯域[バイト/秒], frame_intervalが0なら0
+	 */
+	/*public*/
+	/*static*/
+	uint64_t BandwidthPlanner::estimate_bandwidth(
+		const uint32_t &frame_type,
+		const uint32_t &width, const uint32_t &height,
+		const uint32_t &frame_interval)
+	{
+		if (UNLIKELY(!frame_interval))
+		{
+			return 0;
+		}
+		const uint64_t pixels = (uint64_t)width * height;
+		uint64_t frame_bytes;
+		const auto half_bpp = uncompressed_half_bytes_per_pixel(frame_type);
+		if (half_bpp)
+		{
+			frame_bytes = pixels * half_bpp / 2;
+		}
+		else if (frame_type == RAW_FRAME_MJPEG)
+		{
+			frame_bytes = pixels * 2 / MJPEG_COMPRESSION_RATIO;
+		}
+		else
+		{
+			frame_bytes = pixels * 3 / 2 / H26X_COMPRESSION_RATIO;
+		}
+		return frame_bytes * FRAME_INTERVAL_UNITS_PER_SEC / frame_interval;
+	}
+
+	/**
+	 * 指定した映像設定をプレビュー/録画するときの処理負荷を見積もる
+	 * 1秒あたりのピクセル数×フォーマット毎の重み
+	 * @param frame_type
+	 * @param width
+	 * @param height
+	 * @param frame_interval フレームインターバル[100ナノ秒単位]
+	 * @return 処理負荷, frame_intervalが0なら0
+	 */
+	/*public*/
+	/*static*/
+	uint64_t BandwidthPlanner::estimate_cost(
+		const uint32_t &frame_type,
+		const uint32_t &width, const uint32_t &height,
+		const uint32_t &frame_interval)
+	{
+		if (UNLIKELY(!frame_interval))
+		{
+			return 0;
+		}
+		const uint64_t pixels = (uint64_t)width * height;
+		return pixels * cost_weight(frame_type) * FRAME_INTERVAL_UNITS_PER_SEC / frame_interval;
+	}
+
+	/**
+	 * UVC機器を追加する
+	 * @param requirement 要求
+	 * @param supported 対応解像度一覧
+	 * @return 0: 成功, 負: エラーコード(要求を満たす映像設定が無い)
+	 */
+	/*public*/
+	int BandwidthPlanner::add_device(
+		const bandwidth_requirement_t &requirement,
+		const std::vector<uvc_video_size_t> &supported)
+	{
+		ENTER();
+
+		const auto min_fps = requirement.min_fps > 0.0f ? requirement.min_fps : BANDWIDTH_DEFAULT_MIN_FPS;
+		std::vector<bandwidth_assignment_t> candidates;
+		for (const auto &size: supported)
+		{
+			if ((size.width < requirement.min_width) || (size.height < requirement.min_height))
+			{
+				continue;
+			}
+			// 録画時はmin_fps以上で最も低いフレームレートへ間引く
+			const auto interval = select_frame_interval(size, min_fps, min_fps, 0.0f);
+			if (!interval)
+			{
+				continue;
+			}
+			// uvc_resizeはフレームインターバルを指定できないのでUVC機器はデフォルトの
+			// フレームレートで送ってくる, デフォルトは分からないので最高フレームレートとして
+			// 帯域と処理負荷(全フレームを受け取って変換する)を見積もる
+			const auto negotiated = select_frame_interval(size, 0.0f);
+			const auto bandwidth = estimate_bandwidth(size.frame_type, size.width, size.height, negotiated);
+			if (bandwidth > m_endpoint_bandwidth)
+			{
+				continue;
+			}
+			candidates.push_back({
+				requirement.device_id,
+				size.frame_type, size.width, size.height,
+				interval, negotiated, bandwidth,
+				estimate_cost(size.frame_type, size.width, size.height, negotiated),
+			});
+		}
+		if (candidates.empty())
+		{
+			LOGW("no candidate for device %d,min=%dx%d@%f",
+				requirement.device_id, requirement.min_width, requirement.min_height, min_fps);
+			RETURN(-ENOENT, int);
+		}
+		// 処理負荷の昇順に並べて、より軽い候補よりも帯域が小さくならない候補を取り除く
+		std::sort(candidates.begin(), candidates.end(),
+			[](const bandwidth_assignment_t &a, const bandwidth_assignment_t &b) {
+				return (a.cost < b.cost) || ((a.cost == b.cost) && (a.bandwidth < b.bandwidth));
+			});
+		device_candidates device{requirement, {}, UINT64_MAX};
+		for (const auto &candidate: candidates)
+		{
+			if (candidate.bandwidth < device.min_bandwidth)
+			{
+				device.candidates.push_back(candidate);
+				device.min_bandwidth = candidate.bandwidth;
+			}
+		}
+		LOGD("device %d,candidates=%" FMT_SIZE_T "/%" FMT_SIZE_T,
+			requirement.device_id, device.candidates.size(), candidates.size());
+		m_devices.push_back(std::move(device));
+
+		RETURN(0, int);
+	}
+
+	/**
+	 * 帯域内に収まる映像設定の組み合わせを求める
+	 * @param result 結果を受け取るvector, add_deviceで追加した順
+	 * @return 0: 成功, 負: エラーコード(帯域内に収まる組み合わせが無い)
+	 */
+	/*public*/
+	int BandwidthPlanner::plan(std::vector<bandwidth_assignment_t> &result) const
+	{
+		ENTER();
+
+		result.clear();
+		uint64_t remain_min_bandwidth = 0;
+		for (const auto &device: m_devices)
+		{
+			remain_min_bandwidth += device.min_bandwidth;
+		}
+		if (remain_min_bandwidth > m_bus_bandwidth)
+		{
+			// 最小帯域の候補を組み合わせても収まらない
+			LOGW("insufficient bandwidth,required=%" PRIu64 ",bus=%" PRIu64, remain_min_bandwidth, m_bus_bandwidth);
+			RETURN(-ENOSPC, int);
+		}
+		std::vector<bandwidth_assignment_t> current;
+		current.reserve(m_devices.size());
+		uint64_t best_cost = UINT64_MAX;
+		search(0, 0, 0, remain_min_bandwidth, current, best_cost, result);
+
+		RETURN(result.size() == m_devices.size() ? 0 : -ENOSPC, int);
+	}
+
+	/**
+	 * 枝刈り付きの深さ優先探索で最適な組み合わせを探す
+	 * 各UVC機器の候補は処理負荷の昇順かつ帯域の降順に並んでいる
+	 * @param ix
+	 * @param bandwidth ここまでに選択した映像設定の帯域の合計
+	 * @param cost ここまでに選択した映像設定の処理負荷の合計
+	 * @param remain_min_bandwidth ix以降のUVC機器の最小帯域の合計
+	 * @param current
+	 * @param best_cost
+	 * @param best
+	 */
+	/*private*/
+	void BandwidthPlanner::search(const size_t &ix,
+		const uint64_t &bandwidth, const uint64_t &cost,
+		const uint64_t &remain_min_bandwidth,
+		std::vector<bandwidth_assignment_t> &current,
+		uint64_t &best_cost, std::vector<bandwidth_assignment_t> &best) const
+	{
+		if (ix >= m_devices.size())
+		{
+			if (cost < best_cost)
+			{
+				best_cost = cost;
+				best = current;
+			}
+			return;
+		}
+		const auto &device = m_devices[ix];
+		const auto others_min_bandwidth = remain_min_bandwidth - device.min_bandwidth;
+		for (const auto &candidate: device.candidates)
+		{
+			if (cost + candidate.cost >= best_cost)
+			{
+				// これ以降の候補は処理負荷がさらに大きいので打ち切り
+				break;
+			}
+			if (bandwidth + candidate.bandwidth + others_min_bandwidth > m_bus_bandwidth)
+			{
+				// これ以降の候補は帯域が小さいので続ける
+				continue;
+			}
+			current.push_back(candidate);
+			search(ix + 1,
+				bandwidth + candidate.bandwidth, cost + candidate.cost,
+				others_min_bandwidth, current, best_cost, best);
+			current.pop_back();
+		}
+	}
+
+}	// namespace serenegiant::flutter
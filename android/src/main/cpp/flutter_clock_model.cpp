@@ -0,0 +1,327 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#define LOG_TAG "PtsClockModel"
+
+#if 1	// デバッグ情報を出さない時は1
+	#ifndef LOG_NDEBUG
+		#define	LOG_NDEBUG		// LOGV/LOGD/MARKを出力しない時
+	#endif
+	#undef USE_LOGALL			// 指定したLOGxだけを出力
+#else
+	#define USE_LOGALL
+	#define USE_LOGD
+	#undef LOG_NDEBUG
+	#undef NDEBUG
+#endif
+
+// 標準ライブラリ
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+// aandusb
+#include "utilbase.h"
+// flutter
+#include "flutter_clock_model.h"
+
+namespace serenegiant::flutter
+{
+
+	/**
+	 * コンストラクタ
+	 * @param window クロックモデルの推定に使う直近のフレーム数
+	 */
+	PtsClockModel::PtsClockModel(const uint32_t &window)
+	:	m_window(std::max<uint32_t>(window, CLOCK_MODEL_MIN_SAMPLES)),
+		m_pts_ns(m_window), m_arrival_ns(m_window),
+		m_head(0), m_count(0),
+		m_bucket_pts_ns(CLOCK_MODEL_BUCKETS), m_bucket_arrival_ns(CLOCK_MODEL_BUCKETS),
+		m_bucket_head(0), m_bucket_count(0), m_bucket_frames(0),
+		m_bucket_min_pts_ns(0), m_bucket_min_arrival_ns(0),
+		m_origin_pts_ns(0), m_origin_arrival_ns(0),
+		m_last_pts_ns(0), m_last_arrival_ns(0), m_last_output_ns(0),
+		m_slope(1.0), m_offset_ns(0),
+		m_frames(0), m_no_pts(0), m_resets(0),
+		m_jitter_ns(0), m_max_jitter_ns(0), m_pacing_ns(0)
+	{
+		ENTER();
+
+		m_work.reserve(std::max<uint32_t>(m_window, CLOCK_MODEL_BUCKETS));
+
+		EXIT();
+	}
+
+	/**
+	 * CLOCK_MONOTONICの現在時刻を取得
+	 * @return 現在時刻[ナノ秒]
+	 */
+	/*public,static*/
+	int64_t PtsClockModel::monotonic_ns()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/**
+	 * 推定結果と統計情報を破棄してやり直す
+	 */
+	/*public*/
+	void PtsClockModel::reset()
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_head = m_count = 0;
+		m_bucket_head = m_bucket_count = m_bucket_frames = 0;
+		m_last_output_ns = 0;
+		m_slope = 1.0;
+		m_offset_ns = 0;
+		m_frames = m_no_pts = m_resets = 0;
+		m_jitter_ns = m_max_jitter_ns = m_pacing_ns = 0;
+
+		EXIT();
+	}
+
+	/**
+	 * フレームのPTSと到着時刻でクロックモデルを更新して揺らぎを取り除いたタイムスタンプを返す
+	 * @param pts_us uvc_get_frameで受け取ったPTS[マイクロ秒], 0ならPTS無し
+	 * @param arrival_ns フレームを受け取ったCLOCK_MONOTONICの時刻[ナノ秒]
+	 * @return CLOCK_MONOTONICでのタイムスタンプ[ナノ秒]
+	 */
+	/*public*/
+	int64_t PtsClockModel::update(const int64_t &pts_us, const int64_t &arrival_ns)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_frames++;
+		int64_t result;
+		if (pts_us > 0)
+		{
+			const int64_t pts_ns = pts_us * 1000LL;
+			const int64_t dp = pts_ns - m_last_pts_ns;
+			bool restarted = !m_count;
+			if (restarted)
+			{
+				restart_locked(pts_ns, arrival_ns);
+			}
+			else
+			{
+				const int64_t da = arrival_ns - m_last_arrival_ns;
+				if ((dp <= 0) || (std::llabs(dp - da) > CLOCK_MODEL_DISCONTINUITY_NS))
+				{
+					// 機器側の再起動等でPTSが巻き戻った/飛んだ
+					LOGD("discontinuity,dp=%lld,da=%lld", (long long)dp, (long long)da);
+					m_resets++;
+					restart_locked(pts_ns, arrival_ns);
+					restarted = true;
+				}
+			}
+			m_pts_ns[m_head] = pts_ns - m_origin_pts_ns;
+			m_arrival_ns[m_head] = arrival_ns - m_origin_arrival_ns;
+			add_bucket_locked(m_pts_ns[m_head], m_arrival_ns[m_head]);
+			m_head = (m_head + 1) % m_window;
+			m_count = std::min(m_count + 1, m_window);
+			m_last_pts_ns = pts_ns;
+			m_last_arrival_ns = arrival_ns;
+			estimate_locked();
+			const double model = (double)m_origin_arrival_ns
+				+ m_slope * (double)(pts_ns - m_origin_pts_ns) + (double)m_offset_ns;
+			if (restarted || !m_last_output_ns)
+			{
+				result = std::llround(model);
+			}
+			else
+			{
+				// 前のフレームからPTSの間隔だけ進めてクロックモデルとの差を少しずつ補正する
+				const double predicted = (double)m_last_output_ns + m_slope * (double)dp;
+				result = std::llround(predicted + (model - predicted) / CLOCK_MODEL_TRACKING);
+			}
+		}
+		else
+		{
+			// PTSが無ければ到着時刻をそのまま使う
+			m_no_pts++;
+			result = arrival_ns;
+		}
+		// 推定し直した時に前のフレームより前にならないようにする
+		if (result <= m_last_output_ns)
+		{
+			result = m_last_output_ns + 1;
+		}
+		m_last_output_ns = result;
+
+		return result;
+	}
+
+	/**
+	 * updateが返したタイムスタンプのフレームを揺らぎを吸収して等間隔で出力できる時刻を取得
+	 * @param timestamp_ns updateが返したタイムスタンプ[ナノ秒]
+	 * @return CLOCK_MONOTONICでの出力時刻[ナノ秒]
+	 */
+	/*public*/
+	int64_t PtsClockModel::pacing_target_ns(const int64_t &timestamp_ns) const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return timestamp_ns + m_pacing_ns;
+	}
+
+	/**
+	 * 統計情報を取得
+	 * @param stats
+	 */
+	/*public*/
+	void PtsClockModel::get_stats(clock_stats_t &stats) const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		memset(&stats, 0, sizeof(stats));
+		stats.frames = m_frames;
+		stats.no_pts = m_no_pts;
+		stats.resets = m_resets;
+		stats.samples = m_count;
+		stats.drift_ppm = (1.0 / m_slope - 1.0) * 1.0e6;
+		stats.jitter_ns = m_jitter_ns;
+		stats.max_jitter_ns = m_max_jitter_ns;
+		stats.pacing_ns = m_pacing_ns;
+	}
+
+	/**
+	 * 指定したフレームを基準にしてクロックモデルをやり直す
+	 * @param pts_ns
+	 * @param arrival_ns
+	 */
+	/*private*/
+	void PtsClockModel::restart_locked(const int64_t &pts_ns, const int64_t &arrival_ns)
+	{
+		m_head = m_count = 0;
+		m_bucket_head = m_bucket_count = m_bucket_frames = 0;
+		m_origin_pts_ns = pts_ns;
+		m_origin_arrival_ns = arrival_ns;
+		m_slope = 1.0;
+		m_offset_ns = 0;
+	}
+
+	/**
+	 * 代表点を作成中のフレームを追加する
+	 * CLOCK_MODEL_BUCKET_FRAMES毎に最も遅れが小さいフレームを代表点にして傾きを推定し直す
+	 * @param pts_ns m_origin_pts_nsからの相対値
+	 * @param arrival_ns m_origin_arrival_nsからの相対値
+	 */
+	/*private*/
+	void PtsClockModel::add_bucket_locked(const int64_t &pts_ns, const int64_t &arrival_ns)
+	{
+		if (!m_bucket_frames
+			|| ((double)arrival_ns - m_slope * (double)pts_ns
+				< (double)m_bucket_min_arrival_ns - m_slope * (double)m_bucket_min_pts_ns))
+		{
+			m_bucket_min_pts_ns = pts_ns;
+			m_bucket_min_arrival_ns = arrival_ns;
+		}
+		if (++m_bucket_frames >= CLOCK_MODEL_BUCKET_FRAMES)
+		{
+			m_bucket_pts_ns[m_bucket_head] = m_bucket_min_pts_ns;
+			m_bucket_arrival_ns[m_bucket_head] = m_bucket_min_arrival_ns;
+			m_bucket_head = (m_bucket_head + 1) % CLOCK_MODEL_BUCKETS;
+			m_bucket_count = std::min<uint32_t>(m_bucket_count + 1, CLOCK_MODEL_BUCKETS);
+			m_bucket_frames = 0;
+			estimate_slope_locked();
+		}
+	}
+
+	/**
+	 * 代表点から傾き(クロックのずれ)を推定する
+	 * 半分離れた代表点同士の傾きの中央値(Theil-Sen推定)
+	 * 外れ値の影響を受けにくく, 全ての組み合わせを使うより軽い
+	 */
+	/*private*/
+	void PtsClockModel::estimate_slope_locked()
+	{
+		const uint32_t n = m_bucket_count;
+		if (n < CLOCK_MODEL_MIN_BUCKETS)
+		{
+			return;
+		}
+		const uint32_t first = (m_bucket_head + CLOCK_MODEL_BUCKETS - n) % CLOCK_MODEL_BUCKETS;
+		const uint32_t half = n / 2;
+		m_work.clear();
+		for (uint32_t i = 0; i + half < n; i++)
+		{
+			const auto a = (first + i) % CLOCK_MODEL_BUCKETS;
+			const auto b = (first + i + half) % CLOCK_MODEL_BUCKETS;
+			const int64_t dx = m_bucket_pts_ns[b] - m_bucket_pts_ns[a];
+			if (dx > 0)
+			{
+				m_work.push_back((double)(m_bucket_arrival_ns[b] - m_bucket_arrival_ns[a]) / (double)dx);
+			}
+		}
+		if (!m_work.empty())
+		{
+			auto mid = m_work.begin() + m_work.size() / 2;
+			std::nth_element(m_work.begin(), mid, m_work.end());
+			const double limit = CLOCK_MODEL_MAX_DRIFT_PPM * 1.0e-6;
+			m_slope = std::clamp(*mid, 1.0 - limit, 1.0 + limit);
+		}
+	}
+
+	/**
+	 * 直近のフレームから切片と到着時刻の揺らぎを推定する
+	 */
+	/*private*/
+	void PtsClockModel::estimate_locked()
+	{
+		const uint32_t n = m_count;
+		const uint32_t first = (m_head + m_window - n) % m_window;
+		auto index = [&](const uint32_t &i) { return (first + i) % m_window; };
+
+		const double slope = m_slope;
+		// USB転送の遅れは常に正なので最も遅れが小さいフレーム(下側包絡線)を切片にする
+		double offset = 0.0;
+		for (uint32_t i = 0; i < n; i++)
+		{
+			const auto k = index(i);
+			const double d = (double)m_arrival_ns[k] - slope * (double)m_pts_ns[k];
+			offset = i ? std::min(offset, d) : d;
+		}
+
+		// 到着時刻のクロックモデルからの遅れ
+		m_work.clear();
+		double sum = 0.0, sum2 = 0.0, max = 0.0;
+		for (uint32_t i = 0; i < n; i++)
+		{
+			const auto k = index(i);
+			const double r = (double)m_arrival_ns[k] - (slope * (double)m_pts_ns[k] + offset);
+			m_work.push_back(r);
+			sum += r;
+			sum2 += r * r;
+			max = std::max(max, r);
+		}
+		const double mean = sum / n;
+		const double variance = std::max(0.0, sum2 / n - mean * mean);
+		auto p95 = m_work.begin() + (m_work.size() * 95) / 100;
+		if (p95 == m_work.end())
+		{
+			--p95;
+		}
+		std::nth_element(m_work.begin(), p95, m_work.end());
+
+		m_offset_ns = std::llround(offset);
+		m_jitter_ns = std::llround(std::sqrt(variance));
+		m_max_jitter_ns = std::llround(max);
+		m_pacing_ns = std::min<int64_t>(std::llround(*p95), CLOCK_MODEL_MAX_PACING_NS);
+	}
+
+}	// namespace serenegiant::flutter
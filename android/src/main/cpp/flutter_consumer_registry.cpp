@@ -0,0 +1,445 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#define LOG_TAG "ConsumerRegistry"
+
+#if 1	// デバッグ情報を出さない時は1
+	#ifndef LOG_NDEBUG
+		#define	LOG_NDEBUG		// LOGV/LOGD/MARKを出力しない時
+	#endif
+	#undef USE_LOGALL			// 指定したLOGxだけを出力
+#else
+	#define USE_LOGALL
+	#define USE_LOGD
+	#undef LOG_NDEBUG
+	#undef NDEBUG
+#endif
+
+// 標準ライブラリ
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+// aandusb
+#include "utilbase.h"
+// flutter
+#include "flutter_consumer_registry.h"
+
+namespace serenegiant::flutter
+{
+
+	static inline int64_t now_ns()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/**
+	 * コンストラクタ
+	 * @param start_stream
+	 * @param stop_stream
+	 * @param idle_timeout_ms
+	 */
+	ConsumerRegistry::ConsumerRegistry(
+		StreamControl start_stream, StreamControl stop_stream,
+		const int64_t &idle_timeout_ms)
+	:	m_start_stream(std::move(start_stream)),
+		m_stop_stream(std::move(stop_stream)),
+		m_idle_timeout_ms(idle_timeout_ms),
+		m_deadline_ns(0), m_retry_ns(0), m_suspended_at_ns(0),
+		m_started(false), m_suspended(false), m_running(true),
+		m_suspend_count(0), m_resume_count(0),
+		m_last_resume_ns(0), m_total_suspended_ns(0)
+	{
+		ENTER();
+
+		memset(m_consumers, 0, sizeof(m_consumers));
+
+		EXIT();
+	}
+
+	/**
+	 * デストラクタ
+	 */
+	ConsumerRegistry::~ConsumerRegistry()
+	{
+		ENTER();
+
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_running = false;
+		}
+		m_cond.notify_all();
+		if (m_idle_thread.joinable())
+		{
+			m_idle_thread.join();
+		}
+
+		EXIT();
+	}
+
+	/**
+	 * 映像取得を開始する
+	 * @return 映像取得の開始処理の戻り値
+	 */
+	/*public*/
+	int ConsumerRegistry::start()
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (m_suspended)
+		{
+			const int result = resume_locked();
+			if (result)
+			{
+				retry_locked();
+			}
+			RETURN(result, int);
+		}
+		const int result = m_start_stream ? m_start_stream() : 0;
+		if (!result)
+		{
+			m_started = true;
+			arm_locked();
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 映像取得を終了する
+	 * @return 映像取得の終了処理の戻り値
+	 */
+	/*public*/
+	int ConsumerRegistry::stop()
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		int result = 0;
+		if (m_suspended)
+		{
+			// 一時停止時に終了処理済み
+			m_total_suspended_ns += now_ns() - m_suspended_at_ns;
+			m_suspended = false;
+		}
+		else if (m_stop_stream)
+		{
+			result = m_stop_stream();
+		}
+		m_started = false;
+		m_deadline_ns = 0;
+		m_retry_ns = 0;
+		m_cond.notify_all();
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 映像取得中なら一旦終了してから指定した処理を実行して映像取得を再開する
+	 * @param reconfigure 映像取得を終了している間に実行する処理
+	 * @return 0: 成功, 負: reconfigureまたは映像取得の開始処理のエラーコード
+	 */
+	/*public*/
+	int ConsumerRegistry::restart(const StreamControl &reconfigure)
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		const bool streaming = m_started && !m_suspended;
+		if (streaming && m_stop_stream)
+		{
+			m_stop_stream();
+		}
+		const int result = reconfigure ? reconfigure() : 0;
+		if (streaming)
+		{
+			const int r = m_start_stream ? m_start_stream() : 0;
+			if (r)
+			{
+				LOGW("failed to restart,err=%d", r);
+				m_suspended = true;
+				m_suspended_at_ns = now_ns();
+				// 消費者がいれば再開されるのを待っているので再試行する
+				retry_locked();
+				RETURN(result ? result : r, int);
+			}
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 消費者を登録する
+	 * @param type
+	 * @return 0以上: 登録後のその種類の消費者の数, 負: エラーコード
+	 */
+	/*public*/
+	int ConsumerRegistry::acquire(const consumer_type_t &type)
+	{
+		ENTER();
+
+		if ((type < 0) || (type >= CONSUMER_NUM))
+		{
+			RETURN(-EINVAL, int);
+		}
+		std::lock_guard<std::mutex> lock(m_lock);
+		const int count = ++m_consumers[type];
+		m_deadline_ns = 0;
+		if (m_suspended)
+		{
+			const int result = resume_locked();
+			if (result)
+			{
+				retry_locked();
+				RETURN(result, int);
+			}
+		}
+
+		RETURN(count, int);
+	}
+
+	/**
+	 * 消費者の登録を解除する
+	 * @param type
+	 * @return 0以上: 解除後のその種類の消費者の数, 負: エラーコード
+	 */
+	/*public*/
+	int ConsumerRegistry::release(const consumer_type_t &type)
+	{
+		ENTER();
+
+		if ((type < 0) || (type >= CONSUMER_NUM))
+		{
+			RETURN(-EINVAL, int);
+		}
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (m_consumers[type] <= 0)
+		{
+			RETURN(-EINVAL, int);
+		}
+		const int count = --m_consumers[type];
+		arm_locked();
+
+		RETURN(count, int);
+	}
+
+	/*public*/
+	bool ConsumerRegistry::has_consumer(const consumer_type_t &type) const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return (type >= 0) && (type < CONSUMER_NUM) && (m_consumers[type] > 0);
+	}
+
+	/*public*/
+	bool ConsumerRegistry::is_started() const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return m_started;
+	}
+
+	/*public*/
+	bool ConsumerRegistry::is_suspended() const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return m_suspended;
+	}
+
+	/**
+	 * 一時停止中なら再開するか指定時間経過するまで待機する
+	 * @param timeout_ms
+	 * @return 一時停止中でなければtrue
+	 */
+	/*public*/
+	bool ConsumerRegistry::wait_resumed(const int64_t &timeout_ms)
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		return m_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+			[this] { return !m_suspended || !m_running; });
+	}
+
+	/**
+	 * 猶予時間を変更する
+	 * @param idle_timeout_ms
+	 */
+	/*public*/
+	void ConsumerRegistry::set_idle_timeout(const int64_t &idle_timeout_ms)
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_idle_timeout_ms = idle_timeout_ms;
+		m_deadline_ns = 0;
+		arm_locked();
+
+		EXIT();
+	}
+
+	/**
+	 * 統計情報を取得
+	 * @param metrics
+	 */
+	/*public*/
+	void ConsumerRegistry::get_metrics(consumer_metrics_t &metrics) const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		memset(&metrics, 0, sizeof(metrics));
+		memcpy(metrics.consumers, m_consumers, sizeof(m_consumers));
+		metrics.started = m_started;
+		metrics.suspended = m_suspended;
+		metrics.suspend_count = m_suspend_count;
+		metrics.resume_count = m_resume_count;
+		metrics.last_resume_ns = m_last_resume_ns;
+		metrics.total_suspended_ns = m_total_suspended_ns;
+	}
+
+	/*private*/
+	int32_t ConsumerRegistry::total_locked() const
+	{
+		int32_t total = 0;
+		for (const auto &c: m_consumers)
+		{
+			total += c;
+		}
+		return total;
+	}
+
+	/**
+	 * 映像取得中で消費者がいなければ猶予時間後に一時停止するようにする
+	 */
+	/*private*/
+	void ConsumerRegistry::arm_locked()
+	{
+		if (!m_started || m_suspended || total_locked() || (m_idle_timeout_ms < 0) || m_deadline_ns)
+		{
+			return;
+		}
+		m_deadline_ns = now_ns() + m_idle_timeout_ms * 1000000LL;
+		if (!m_idle_thread.joinable())
+		{
+			m_idle_thread = std::thread(&ConsumerRegistry::idle_loop, this);
+		}
+		m_cond.notify_all();
+	}
+
+	/**
+	 * 消費者がいるのに一時停止中ならRESUME_RETRY_MS後に再開を再試行するようにする
+	 */
+	/*private*/
+	void ConsumerRegistry::retry_locked()
+	{
+		if (!m_started || !m_suspended || !total_locked() || m_retry_ns)
+		{
+			return;
+		}
+		m_retry_ns = now_ns() + RESUME_RETRY_MS * 1000000LL;
+		if (!m_idle_thread.joinable())
+		{
+			m_idle_thread = std::thread(&ConsumerRegistry::idle_loop, this);
+		}
+		m_cond.notify_all();
+	}
+
+	/**
+	 * 一時停止中の映像取得を再開する
+	 * @return 映像取得の開始処理の戻り値
+	 */
+	/*private*/
+	int ConsumerRegistry::resume_locked()
+	{
+		ENTER();
+
+		const auto start = now_ns();
+		const int result = m_start_stream ? m_start_stream() : 0;
+		if (!result)
+		{
+			const auto now = now_ns();
+			m_suspended = false;
+			m_retry_ns = 0;
+			m_resume_count++;
+			m_last_resume_ns = now - start;
+			m_total_suspended_ns += start - m_suspended_at_ns;
+			m_cond.notify_all();
+			LOGD("resumed in %lld ns", (long long)m_last_resume_ns);
+		}
+		else
+		{
+			LOGW("failed to resume,err=%d", result);
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 猶予時間の経過を待って一時停止するスレッドの処理
+	 */
+	/*private*/
+	void ConsumerRegistry::idle_loop()
+	{
+		ENTER();
+
+		std::unique_lock<std::mutex> lock(m_lock);
+		while (m_running)
+		{
+			const auto now = now_ns();
+			if (m_retry_ns && (now >= m_retry_ns))
+			{
+				m_retry_ns = 0;
+				// 待機中に再開した/消費者がいなくなった場合は何もしない
+				if (m_started && m_suspended && total_locked() && resume_locked())
+				{
+					retry_locked();
+				}
+				continue;
+			}
+			if (m_deadline_ns && (now >= m_deadline_ns))
+			{
+				m_deadline_ns = 0;
+				// 待機中に消費者が登録された/終了した場合は何もしない
+				if (m_started && !m_suspended && !total_locked())
+				{
+					const int result = m_stop_stream ? m_stop_stream() : 0;
+					if (result)
+					{
+						LOGW("failed to stop on suspend,err=%d", result);
+					}
+					m_suspended = true;
+					m_suspended_at_ns = now_ns();
+					m_suspend_count++;
+				}
+				continue;
+			}
+			// 一時停止する時刻と再試行する時刻の早い方まで待機する
+			int64_t next = m_deadline_ns;
+			if (m_retry_ns && (!next || (m_retry_ns < next)))
+			{
+				next = m_retry_ns;
+			}
+			if (next)
+			{
+				m_cond.wait_for(lock, std::chrono::nanoseconds(next - now));
+			}
+			else
+			{
+				m_cond.wait(lock);
+			}
+		}
+
+		EXIT();
+	}
+
+}	// namespace serenegiant::flutter
@@ -0,0 +1,144 @@
+/**
+ * Flutter Frame Burst Implementation
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#define LOG_TAG "FrameBurst"
+
+#if 1
+#ifndef LOG_NDEBUG
+#define LOG_NDEBUG
+#endif
+#undef USE_LOGALL
+#else
+#define USE_LOGALL
+#undef LOG_NDEBUG
+#undef NDEBUG
+#endif
+
+// Standard C/C++ headers
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+// Project headers
+#include "aandusb/aandusb_native.h"
+#include "flutter_frame_burst.h"
+#include "flutter_still_capture.h"
+#include "utilbase.h"
+
+namespace serenegiant::flutter {
+
+//------------------------------------------------------------------------------
+// Slots
+//------------------------------------------------------------------------------
+int FrameBurst::reserve(uint32_t count, size_t slot_bytes) {
+  if (!count || count > BURST_MAX_FRAMES || !slot_bytes) {
+    return -EINVAL;
+  }
+  if (slot_bytes > BURST_MAX_BYTES / count) {
+    return -ENOMEM;
+  }
+
+  m_jpegs.clear();
+  m_storage.resize(slot_bytes * count);
+  m_slot_bytes = slot_bytes;
+  m_frames.assign(count, BurstFrame{});
+  m_dropped = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_size.store(0, std::memory_order_release);
+  }
+  LOGD("reserved %u slots of %zu bytes", count, slot_bytes);
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Producer
+//------------------------------------------------------------------------------
+uint8_t *FrameBurst::nextSlot() {
+  const uint32_t index = m_size.load(std::memory_order_relaxed);
+  return index < capacity() ? &m_storage[index * m_slot_bytes] : nullptr;
+}
+
+void FrameBurst::commit(size_t len, uint32_t frame_type, uint32_t width,
+                        uint32_t height, int64_t pts_us) {
+  const uint32_t index = m_size.load(std::memory_order_relaxed);
+  if (index >= capacity()) {
+    return;
+  }
+  m_frames[index] = {&m_storage[index * m_slot_bytes], len, frame_type, width,
+                     height, pts_us};
+  // The frame is written before the count makes it visible to the consumer
+  std::lock_guard<std::mutex> lock(m_lock);
+  m_size.store(index + 1, std::memory_order_release);
+  if (index + 1 == capacity()) {
+    m_full.notify_all();
+  }
+}
+
+int FrameBurst::push(const uint8_t *data, size_t len, uint32_t frame_type,
+                     uint32_t width, uint32_t height, int64_t pts_us) {
+  uint8_t *slot = nextSlot();
+  if (!slot) {
+    return -ENOBUFS;
+  }
+  if (len > m_slot_bytes) {
+    drop();
+    return -ENOSPC;
+  }
+  memcpy(slot, data, len);
+  commit(len, frame_type, width, height, pts_us);
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Consumer
+//------------------------------------------------------------------------------
+bool FrameBurst::wait(int64_t timeout_ms) const {
+  std::unique_lock<std::mutex> lock(m_lock);
+  return m_full.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                         [this] { return full(); });
+}
+
+int FrameBurst::encode(TaskPool &pool, int32_t device_id) {
+  const uint32_t n = size();
+  std::vector<std::vector<uint8_t>> jpegs(n);
+  std::vector<int> results(n, 0);
+  {
+    TaskGroup group(pool, device_id);
+    for (uint32_t i = 0; i < n; i++) {
+      group.run(TASK_PRIORITY_ANALYSIS, [this, i, &jpegs, &results]() {
+        const BurstFrame &frame = m_frames[i];
+        JpegEncoder encoder;
+        results[i] = makeStillJpeg(frame.frame_type, frame.data, frame.len,
+                                   frame.width, frame.height, encoder,
+                                   jpegs[i]);
+      });
+    }
+    group.wait();
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    if (results[i]) {
+      LOGW("failed to encode frame %u, err=%d", i, results[i]);
+      return results[i];
+    }
+  }
+
+  m_jpegs.swap(jpegs);
+  for (uint32_t i = 0; i < n; i++) {
+    m_frames[i].data = m_jpegs[i].data();
+    m_frames[i].len = m_jpegs[i].size();
+    m_frames[i].frame_type = RAW_FRAME_MJPEG;
+  }
+  // The frames point to the JPEG data now
+  std::vector<uint8_t>().swap(m_storage);
+
+  return 0;
+}
+
+} // namespace serenegiant::flutter
@@ -0,0 +1,510 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#define LOG_TAG "FrameCapture"
+
+#if 1	// デバッグ情報を出さない時は1
+	#ifndef LOG_NDEBUG
+		#define	LOG_NDEBUG		// LOGV/LOGD/MARKを出力しない時
+	#endif
+	#undef USE_LOGALL			// 指定したLOGxだけを出力
+#else
+	#define USE_LOGALL
+	#define USE_LOGD
+	#undef LOG_NDEBUG
+	#undef NDEBUG
+#endif
+
+// 標準ライブラリ
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+// システム
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+// aandusb
+#include "utilbase.h"
+// flutter
+#include "flutter_frame_capture.h"
+
+namespace serenegiant::flutter
+{
+
+// 書き込み用のバッファサイズ
+#define CAPTURE_WRITE_BUFFER_SIZE (1024 * 1024)
+
+	static inline size_t align_up(const size_t &v)
+	{
+		return (v + FRAME_CAPTURE_ALIGNMENT - 1) & ~(size_t)(FRAME_CAPTURE_ALIGNMENT - 1);
+	}
+
+	static const uint8_t PADDING[FRAME_CAPTURE_ALIGNMENT] = { 0 };
+
+	//--------------------------------------------------------------------------------
+	/*public*/
+	FrameCaptureWriter::FrameCaptureWriter()
+	:	m_fp(nullptr), m_offset(0), m_created_us(0)
+	{
+		ENTER();
+		EXIT();
+	}
+
+	/*public*/
+	FrameCaptureWriter::~FrameCaptureWriter()
+	{
+		ENTER();
+
+		close();
+
+		EXIT();
+	}
+
+	/*public*/
+	int FrameCaptureWriter::open(const std::string &path)
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (m_fp) RETURN(-EBUSY, int);
+		m_fp = fopen(path.c_str(), "wb");
+		if (!m_fp)
+		{
+			const auto err = errno;
+			LOGE("failed to open %s,err=%d", path.c_str(), err);
+			RETURN(-err, int);
+		}
+		setvbuf(m_fp, nullptr, _IOFBF, CAPTURE_WRITE_BUFFER_SIZE);
+		frame_capture_header_t header{};
+		memcpy(header.magic, FRAME_CAPTURE_MAGIC, sizeof(header.magic));
+		header.version = FRAME_CAPTURE_VERSION;
+		header.header_size = sizeof(frame_capture_header_t);
+		header.created_us = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		m_created_us = header.created_us;
+		if (fwrite(&header, sizeof(header), 1, m_fp) != 1)
+		{
+			fclose(m_fp);
+			m_fp = nullptr;
+			RETURN(-EIO, int);
+		}
+		m_path = path;
+		m_offset = sizeof(header);
+		m_index.clear();
+		m_start = std::chrono::steady_clock::now();
+
+		RETURN(0, int);
+	}
+
+	/*public*/
+	int FrameCaptureWriter::write(
+		const uint32_t &frame_type,
+		const uint32_t &width, const uint32_t &height,
+		const uint8_t *data, const uint32_t &data_len,
+		const int64_t &pts_us, const uint32_t &flags)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (!m_fp) return -EINVAL;
+		if (!data && data_len) return -EINVAL;
+		frame_capture_record_t record{};
+		record.magic = FRAME_CAPTURE_RECORD_MAGIC;
+		record.frame_type = frame_type;
+		record.width = width;
+		record.height = height;
+		record.flags = flags;
+		record.data_len = data_len;
+		record.pts_us = pts_us;
+		record.arrival_us = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - m_start).count();
+		const size_t padding = align_up(data_len) - data_len;
+		if ((fwrite(&record, sizeof(record), 1, m_fp) != 1)
+			|| (data_len && (fwrite(data, data_len, 1, m_fp) != 1))
+			|| (padding && (fwrite(PADDING, padding, 1, m_fp) != 1)))
+		{
+			LOGE("failed to write frame to %s", m_path.c_str());
+			return -EIO;
+		}
+		m_index.push_back({ m_offset, pts_us });
+		m_offset += sizeof(record) + data_len + padding;
+
+		return 0;
+	}
+
+	/*public*/
+	int FrameCaptureWriter::close()
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_lock);
+
+		RETURN(close_locked(), int);
+	}
+
+	/**
+	 * インデックスを書き込んでヘッダーのindex_offset/num_framesを更新する
+	 * m_lockを保持した状態で呼び出すこと
+	 */
+	/*private*/
+	int FrameCaptureWriter::close_locked()
+	{
+		ENTER();
+
+		if (!m_fp) RETURN(0, int);
+		int result = 0;
+		if (!m_index.empty()
+			&& (fwrite(m_index.data(), sizeof(frame_capture_index_t), m_index.size(), m_fp) != m_index.size()))
+		{
+			result = -EIO;
+		}
+		if (!result)
+		{
+			frame_capture_header_t header{};
+			memcpy(header.magic, FRAME_CAPTURE_MAGIC, sizeof(header.magic));
+			header.version = FRAME_CAPTURE_VERSION;
+			header.header_size = sizeof(frame_capture_header_t);
+			header.index_offset = m_offset;
+			header.num_frames = (uint32_t)m_index.size();
+			header.created_us = m_created_us;
+			if (fseek(m_fp, 0, SEEK_SET)
+				|| (fwrite(&header, sizeof(header), 1, m_fp) != 1))
+			{
+				result = -EIO;
+			}
+		}
+		if (fclose(m_fp) && !result)
+		{
+			result = -EIO;
+		}
+		m_fp = nullptr;
+		LOGD("closed %s,frames=%" FMT_SIZE_T ",result=%d", m_path.c_str(), m_index.size(), result);
+
+		RETURN(result, int);
+	}
+
+	/*public*/
+	bool FrameCaptureWriter::is_opened() const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return m_fp != nullptr;
+	}
+
+	/*public*/
+	uint32_t FrameCaptureWriter::num_frames() const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return (uint32_t)m_index.size();
+	}
+
+	/*public*/
+	uint64_t FrameCaptureWriter::bytes() const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return m_offset;
+	}
+
+	//--------------------------------------------------------------------------------
+	/*public*/
+	FrameCaptureReader::FrameCaptureReader()
+	:	m_map(nullptr), m_map_size(0), m_complete(false)
+	{
+		ENTER();
+		EXIT();
+	}
+
+	/*public*/
+	FrameCaptureReader::~FrameCaptureReader()
+	{
+		ENTER();
+
+		close();
+
+		EXIT();
+	}
+
+	/*public*/
+	int FrameCaptureReader::open(const std::string &path)
+	{
+		ENTER();
+
+		close();
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			const auto err = errno;
+			LOGE("failed to open %s,err=%d", path.c_str(), err);
+			RETURN(-err, int);
+		}
+		struct stat st{};
+		if (fstat(fd, &st) || (st.st_size < (off_t)sizeof(frame_capture_header_t)))
+		{
+			::close(fd);
+			RETURN(-EINVAL, int);
+		}
+		void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		// マップしていればファイルディスクリプタは不要
+		::close(fd);
+		if (map == MAP_FAILED)
+		{
+			const auto err = errno;
+			LOGE("mmap failed,err=%d", err);
+			RETURN(-err, int);
+		}
+		// 再生時は先頭から順に読むので先読みさせる
+		madvise(map, st.st_size, MADV_SEQUENTIAL);
+		m_map = static_cast<const uint8_t *>(map);
+		m_map_size = st.st_size;
+
+		frame_capture_header_t header;
+		memcpy(&header, m_map, sizeof(header));
+		if (memcmp(header.magic, FRAME_CAPTURE_MAGIC, sizeof(header.magic))
+			|| (header.version != FRAME_CAPTURE_VERSION)
+			|| (header.header_size < sizeof(frame_capture_header_t))
+			|| (header.header_size > m_map_size))
+		{
+			LOGW("not a frame capture file,%s", path.c_str());
+			close();
+			RETURN(-EINVAL, int);
+		}
+		const uint64_t index_bytes = (uint64_t)header.num_frames * sizeof(frame_capture_index_t);
+		m_complete = header.index_offset
+			&& (header.index_offset >= header.header_size)
+			&& (header.index_offset + index_bytes <= m_map_size);
+		int result = 0;
+		if (m_complete)
+		{
+			m_index.resize(header.num_frames);
+			if (index_bytes)
+			{
+				memcpy(m_index.data(), m_map + header.index_offset, index_bytes);
+			}
+		}
+		else
+		{
+			LOGW("index not found, rebuild from records,%s", path.c_str());
+			result = rebuild_index(header.header_size);
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * レコードを先頭から走査してインデックスを再構築する
+	 * 途中で途切れているレコード以降は無視する
+	 */
+	/*private*/
+	int FrameCaptureReader::rebuild_index(const size_t &start)
+	{
+		ENTER();
+
+		m_index.clear();
+		size_t offset = start;
+		while (offset + sizeof(frame_capture_record_t) <= m_map_size)
+		{
+			frame_capture_record_t record;
+			memcpy(&record, m_map + offset, sizeof(record));
+			const size_t next = offset + sizeof(record) + align_up(record.data_len);
+			if ((record.magic != FRAME_CAPTURE_RECORD_MAGIC)
+				|| (offset + sizeof(record) + record.data_len > m_map_size))
+			{
+				break;
+			}
+			m_index.push_back({ offset, record.pts_us });
+			offset = next;
+		}
+
+		RETURN(0, int);
+	}
+
+	/*public*/
+	void FrameCaptureReader::close()
+	{
+		ENTER();
+
+		if (m_map)
+		{
+			munmap(const_cast<uint8_t *>(m_map), m_map_size);
+			m_map = nullptr;
+		}
+		m_map_size = 0;
+		m_complete = false;
+		m_index.clear();
+
+		EXIT();
+	}
+
+	/*public*/
+	int FrameCaptureReader::get(const size_t &index, capture_frame_t &frame) const
+	{
+		if (!m_map) return -EINVAL;
+		if (index >= m_index.size()) return -ENOENT;
+		const auto offset = m_index[index].offset;
+		if (offset + sizeof(frame_capture_record_t) > m_map_size) return -EINVAL;
+		frame_capture_record_t record;
+		memcpy(&record, m_map + offset, sizeof(record));
+		if ((record.magic != FRAME_CAPTURE_RECORD_MAGIC)
+			|| (offset + sizeof(record) + record.data_len > m_map_size))
+		{
+			return -EINVAL;
+		}
+		frame.frame_type = record.frame_type;
+		frame.width = record.width;
+		frame.height = record.height;
+		frame.flags = record.flags;
+		frame.data = m_map + offset + sizeof(record);
+		frame.data_len = record.data_len;
+		frame.pts_us = record.pts_us;
+		frame.arrival_us = record.arrival_us;
+
+		return 0;
+	}
+
+	/*public*/
+	size_t FrameCaptureReader::find(const int64_t &pts_us) const
+	{
+		// ptsは記録順に単調増加するはずなので二分探索する
+		const auto found = std::lower_bound(m_index.begin(), m_index.end(), pts_us,
+			[](const frame_capture_index_t &a, const int64_t &v) { return a.pts_us < v; });
+		return found - m_index.begin();
+	}
+
+	//--------------------------------------------------------------------------------
+	/*public*/
+	FrameReplaySource::FrameReplaySource()
+	:	m_speed(1.0f), m_loop(false), m_next(0),
+		m_started(false), m_start_pts_us(0)
+	{
+		ENTER();
+		EXIT();
+	}
+
+	/*public*/
+	int FrameReplaySource::open(const std::string &path, const float &speed, const bool &loop)
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		const auto result = m_reader.open(path);
+		m_speed = std::max(0.0f, speed);
+		m_loop = loop;
+		m_next = 0;
+		m_started = false;
+
+		RETURN(result, int);
+	}
+
+	/*public*/
+	void FrameReplaySource::close()
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_reader.close();
+
+		EXIT();
+	}
+
+	/*public*/
+	size_t FrameReplaySource::num_frames() const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return m_reader.num_frames();
+	}
+
+	/*public*/
+	int FrameReplaySource::seek(const int64_t &pts_us)
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (!m_reader.is_opened()) RETURN(-EINVAL, int);
+		m_next = m_reader.find(pts_us);
+		m_started = false;
+
+		RETURN(m_next < m_reader.num_frames() ? 0 : -ENOENT, int);
+	}
+
+	/*public*/
+	int FrameReplaySource::next(capture_frame_t &frame)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (!m_reader.is_opened() || !m_reader.num_frames()) return -EINVAL;
+		if (m_next >= m_reader.num_frames())
+		{
+			if (!m_loop) return -ENOENT;
+			m_next = 0;
+			m_started = false;
+		}
+		const int result = m_reader.get(m_next, frame);
+		if (result) return result;
+		if (m_speed > 0.0f)
+		{
+			const auto now = std::chrono::steady_clock::now();
+			if (!m_started)
+			{
+				// 最初の映像フレームを受け取った時刻を基準にする
+				m_started = true;
+				m_start = now;
+				m_start_pts_us = frame.pts_us;
+			}
+			const auto due = m_start + std::chrono::microseconds(
+				(int64_t)((frame.pts_us - m_start_pts_us) / m_speed));
+			if (now < due) return -EAGAIN;
+		}
+		m_next++;
+
+		return 0;
+	}
+
+	/*public*/
+	int FrameReplaySource::next(
+		uint32_t *frame_type, uint32_t *width, uint32_t *height,
+		uint8_t *data, uint32_t *data_len,
+		int64_t *pts_us, uint32_t *flags)
+	{
+		if (!data || !data_len) return -EINVAL;
+		capture_frame_t frame;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			// バッファが足りないときは映像フレームを消費しないように先に確認する
+			if (m_reader.is_opened() && (m_next < m_reader.num_frames())
+				&& !m_reader.get(m_next, frame) && (frame.data_len > *data_len))
+			{
+				*data_len = frame.data_len;
+				return -ENOSPC;
+			}
+		}
+		const int result = next(frame);
+		if (result) return result;
+		if (frame.data_len > *data_len)
+		{
+			// ループして先頭へ戻ったときは先頭の映像フレームが大きいことがある
+			*data_len = frame.data_len;
+			return -ENOSPC;
+		}
+		memcpy(data, frame.data, frame.data_len);
+		*data_len = frame.data_len;
+		if (frame_type) *frame_type = frame.frame_type;
+		if (width) *width = frame.width;
+		if (height) *height = frame.height;
+		if (pts_us) *pts_us = frame.pts_us;
+		if (flags) *flags = frame.flags;
+
+		return 0;
+	}
+
+}	// namespace serenegiant::flutter
@@ -0,0 +1,441 @@
+/**
+ * Flutter Frame Converter Implementation
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#define LOG_TAG "FrameConverter"
+
+#if 1
+#ifndef LOG_NDEBUG
+#define LOG_NDEBUG
+#endif
+#undef USE_LOGALL
+#else
+#define USE_LOGALL
+#undef LOG_NDEBUG
+#undef NDEBUG
+#endif
+
+// Standard C/C++ headers
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+// Project headers
+#include "aandusb/aandusb_native.h"
+#include "flutter_frame_converter.h"
+#include "utilbase.h"
+
+namespace serenegiant::flutter {
+
+//------------------------------------------------------------------------------
+// BT.601 YUV to RGBA, 8 bit fixed point
+//------------------------------------------------------------------------------
+static inline void yuvToRgba(int y, int u, int v, uint8_t *dst) {
+  dst[0] = std::clamp(y + (359 * v >> 8), 0, 255);
+  dst[1] = std::clamp(y - ((88 * u + 183 * v) >> 8), 0, 255);
+  dst[2] = std::clamp(y + (454 * u >> 8), 0, 255);
+  dst[3] = 255;
+}
+
+//------------------------------------------------------------------------------
+// Rows to convert: columns [x_begin, x_end) of rows [y_begin, y_end)
+//------------------------------------------------------------------------------
+struct RowRange {
+  uint32_t x_begin;
+  uint32_t x_end;
+  uint32_t y_begin;
+  uint32_t y_end;
+};
+
+//------------------------------------------------------------------------------
+// Where each source pixel goes: the pixel (x0, y0) to origin, one column to
+// the right step_x bytes further and one row down step_y bytes further.
+// Upright output has step_x 4 and step_y the destination stride, the other
+// orientations only change the signs and swap the steps.
+//------------------------------------------------------------------------------
+struct PixelMap {
+  uint8_t *origin;
+  uint32_t x0;
+  uint32_t y0;
+  ptrdiff_t step_x;
+  ptrdiff_t step_y;
+
+  uint8_t *at(uint32_t x, uint32_t y) const {
+    return origin + ((ptrdiff_t)x - x0) * step_x + ((ptrdiff_t)y - y0) * step_y;
+  }
+};
+
+static PixelMap mapRegion(const FrameRect &region,
+                          const FrameOrientation &orientation, uint8_t *dst,
+                          uint32_t dst_stride) {
+  auto offset = [&](int64_t x, int64_t y) {
+    int64_t out_x, out_y;
+    orientPoint(orientation, region.width, region.height, x, y, out_x, out_y);
+    return (ptrdiff_t)(out_y * dst_stride + out_x * 4);
+  };
+  const ptrdiff_t origin = offset(0, 0);
+  return {dst + origin, region.x, region.y, offset(1, 0) - origin,
+          offset(0, 1) - origin};
+}
+
+//------------------------------------------------------------------------------
+// YUYV: 2 pixels per 4 bytes (Y0 U0 Y1 V0)
+// kPacked: the destination pixels of a row are adjacent (step_x is 4), the
+// compiler then folds the steps into constants
+//------------------------------------------------------------------------------
+template <bool kPacked>
+static void yuyvToRgba(const uint8_t *src, uint32_t width,
+                       const RowRange &rows, const PixelMap &map) {
+  const ptrdiff_t step = kPacked ? 4 : map.step_x;
+  for (uint32_t y = rows.y_begin; y < rows.y_end; y++) {
+    const uint8_t *s = src + ((size_t)y * width + rows.x_begin) * 2;
+    uint8_t *d = map.at(rows.x_begin, y);
+    for (uint32_t x = rows.x_begin; x + 1 < rows.x_end;
+         x += 2, s += 4, d += 2 * step) {
+      const int u = s[1] - 128;
+      const int v = s[3] - 128;
+      yuvToRgba(s[0], u, v, d);
+      yuvToRgba(s[2], u, v, d + step);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// NV12/NV21: full size Y plane followed by a half size interleaved chroma
+// plane, UV order for NV12 and VU order for NV21
+//------------------------------------------------------------------------------
+template <bool kPacked>
+static void yuv420spToRgba(const uint8_t *src, uint32_t width,
+                           uint32_t height, const RowRange &rows, bool vu,
+                           const PixelMap &map) {
+  const ptrdiff_t step = kPacked ? 4 : map.step_x;
+  const uint8_t *uv_plane = src + (size_t)width * height;
+  const int u_index = vu ? 1 : 0;
+  const int v_index = vu ? 0 : 1;
+  for (uint32_t y = rows.y_begin; y < rows.y_end; y++) {
+    const uint8_t *s = src + (size_t)y * width + rows.x_begin;
+    const uint8_t *uv = uv_plane + (size_t)(y >> 1) * width + rows.x_begin;
+    uint8_t *d = map.at(rows.x_begin, y);
+    for (uint32_t x = rows.x_begin; x + 1 < rows.x_end;
+         x += 2, s += 2, uv += 2, d += 2 * step) {
+      const int u = uv[u_index] - 128;
+      const int v = uv[v_index] - 128;
+      yuvToRgba(s[0], u, v, d);
+      yuvToRgba(s[1], u, v, d + step);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// RGB565 (little endian) to RGBA, 5/6 bit channels widened by bit replication
+//------------------------------------------------------------------------------
+template <bool kPacked>
+static void rgb565ToRgba(const uint8_t *src, uint32_t width,
+                         const RowRange &rows, const PixelMap &map) {
+  const ptrdiff_t step = kPacked ? 4 : map.step_x;
+  for (uint32_t y = rows.y_begin; y < rows.y_end; y++) {
+    const uint8_t *s = src + ((size_t)y * width + rows.x_begin) * 2;
+    uint8_t *d = map.at(rows.x_begin, y);
+    for (uint32_t x = rows.x_begin; x < rows.x_end; x++, s += 2, d += step) {
+      const uint16_t p = (uint16_t)(s[0] | (s[1] << 8));
+      const uint8_t r = (p >> 11) & 0x1f;
+      const uint8_t g = (p >> 5) & 0x3f;
+      const uint8_t b = p & 0x1f;
+      d[0] = (uint8_t)((r << 3) | (r >> 2));
+      d[1] = (uint8_t)((g << 2) | (g >> 4));
+      d[2] = (uint8_t)((b << 3) | (b >> 2));
+      d[3] = 255;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// RGBX to RGBA, the padding byte is not guaranteed to be opaque
+//------------------------------------------------------------------------------
+template <bool kPacked>
+static void rgbxToRgba(const uint8_t *src, uint32_t width,
+                       const RowRange &rows, const PixelMap &map) {
+  const uint32_t pixels = rows.x_end - rows.x_begin;
+  for (uint32_t y = rows.y_begin; y < rows.y_end; y++) {
+    const uint8_t *s = src + ((size_t)y * width + rows.x_begin) * 4;
+    uint8_t *d = map.at(rows.x_begin, y);
+    if (kPacked) {
+      memcpy(d, s, (size_t)pixels * 4);
+      for (uint32_t x = 0; x < pixels; x++) {
+        d[x * 4 + 3] = 255;
+      }
+    } else {
+      for (uint32_t x = 0; x < pixels; x++, s += 4, d += map.step_x) {
+        memcpy(d, s, 3);
+        d[3] = 255;
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Frame size
+//------------------------------------------------------------------------------
+size_t rawFrameBytes(uint32_t frame_type, uint32_t width, uint32_t height) {
+  const size_t pixels = (size_t)width * height;
+  switch (frame_type) {
+  case RAW_FRAME_UNCOMPRESSED_YUYV:
+  case RAW_FRAME_UNCOMPRESSED_RGB565:
+    return pixels * 2;
+  case RAW_FRAME_UNCOMPRESSED_NV12:
+  case RAW_FRAME_UNCOMPRESSED_NV21:
+    return pixels * 3 / 2;
+  case RAW_FRAME_UNCOMPRESSED_RGBX:
+    return pixels * 4;
+  default:
+    return 0;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Convert a row range, arguments are already validated
+//------------------------------------------------------------------------------
+template <bool kPacked>
+static void convertRows(uint32_t frame_type, const uint8_t *src,
+                        uint32_t width, uint32_t height, const RowRange &rows,
+                        const PixelMap &map) {
+  switch (frame_type) {
+  case RAW_FRAME_UNCOMPRESSED_YUYV:
+    yuyvToRgba<kPacked>(src, width, rows, map);
+    break;
+  case RAW_FRAME_UNCOMPRESSED_NV12:
+    yuv420spToRgba<kPacked>(src, width, height, rows, false, map);
+    break;
+  case RAW_FRAME_UNCOMPRESSED_NV21:
+    yuv420spToRgba<kPacked>(src, width, height, rows, true, map);
+    break;
+  case RAW_FRAME_UNCOMPRESSED_RGB565:
+    rgb565ToRgba<kPacked>(src, width, rows, map);
+    break;
+  case RAW_FRAME_UNCOMPRESSED_RGBX:
+    rgbxToRgba<kPacked>(src, width, rows, map);
+    break;
+  default:
+    break;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Convert a row range with any orientation
+// Upright and mirrored rows are written as they are read. When the axes are
+// swapped each source row becomes a destination column, so the rows are
+// walked in tiles: a tile of ORIENT_TILE_ROWS rows fills whole cache lines of
+// ORIENT_TILE_COLUMNS destination rows, which stay in L1 until the tile is
+// done instead of being evicted and reloaded for every source row.
+//------------------------------------------------------------------------------
+static void convertBlock(uint32_t frame_type, const uint8_t *src,
+                         uint32_t width, uint32_t height, const RowRange &rows,
+                         const PixelMap &map) {
+  if (map.step_x == 4) {
+    convertRows<true>(frame_type, src, width, height, rows, map);
+  } else if (map.step_x == -4) {
+    convertRows<false>(frame_type, src, width, height, rows, map);
+  } else {
+    for (uint32_t y = rows.y_begin; y < rows.y_end; y += ORIENT_TILE_ROWS) {
+      const uint32_t y_end = std::min(rows.y_end, y + ORIENT_TILE_ROWS);
+      for (uint32_t x = rows.x_begin; x < rows.x_end;
+           x += ORIENT_TILE_COLUMNS) {
+        const uint32_t x_end = std::min(rows.x_end, x + ORIENT_TILE_COLUMNS);
+        convertRows<false>(frame_type, src, width, height,
+                           {x, x_end, y, y_end}, map);
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Clip the region to the frame and widen it to whole chroma samples
+//------------------------------------------------------------------------------
+FrameRect alignConvertRegion(uint32_t frame_type, uint32_t width,
+                             uint32_t height, const FrameRect &region) {
+  FrameRect rect = clipRect(region, width, height);
+  auto align = [](uint32_t &begin, uint32_t &length, uint32_t limit) {
+    const uint32_t end = std::min(limit, (begin + length + 1) & ~1u);
+    begin &= ~1u;
+    length = end - begin;
+  };
+  switch (frame_type) {
+  case RAW_FRAME_UNCOMPRESSED_NV12:
+  case RAW_FRAME_UNCOMPRESSED_NV21:
+    // 4:2:0, chroma rows are shared by row pairs
+    align(rect.y, rect.height, height);
+    [[fallthrough]];
+  case RAW_FRAME_UNCOMPRESSED_YUYV:
+    // 4:2:2, chroma is shared by pixel pairs
+    align(rect.x, rect.width, width);
+    break;
+  default:
+    break;
+  }
+  return rect;
+}
+
+static int validate(uint32_t frame_type, const uint8_t *src, size_t src_len,
+                    uint32_t width, uint32_t height, const uint8_t *dst,
+                    uint32_t dst_stride, uint32_t dst_width) {
+  const size_t bytes = rawFrameBytes(frame_type, width, height);
+  if (!src || !dst || !bytes || dst_stride < dst_width * 4) {
+    return -EINVAL;
+  }
+  if (src_len < bytes) {
+    return -ENOSPC;
+  }
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Convert to RGBA
+//------------------------------------------------------------------------------
+int convertToRgba(uint32_t frame_type, const uint8_t *src, size_t src_len,
+                  uint32_t width, uint32_t height, uint8_t *dst,
+                  uint32_t dst_stride) {
+  const int result = validate(frame_type, src, src_len, width, height, dst,
+                              dst_stride, width);
+  if (result == 0) {
+    convertRows<true>(frame_type, src, width, height, {0, width, 0, height},
+                      {dst, 0, 0, 4, (ptrdiff_t)dst_stride});
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+// Stripe count
+// A stripe reads its source rows and writes its RGBA rows once, so keeping
+// both around STRIPE_TARGET_BYTES lets each worker stay in its own L2.
+// More stripes than workers evens out the load when a worker is preempted.
+//------------------------------------------------------------------------------
+uint32_t selectStripeCount(uint32_t frame_type, uint32_t width,
+                           uint32_t height, uint32_t workers) {
+  const size_t src_bytes = rawFrameBytes(frame_type, width, height);
+  if (workers <= 1 || !src_bytes || height < 4) {
+    return 1;
+  }
+  const size_t bytes = src_bytes + (size_t)width * height * 4;
+  size_t stripes = bytes / STRIPE_TARGET_BYTES;
+  stripes = std::min(stripes, (size_t)workers * STRIPES_PER_WORKER);
+  // Stripes start on even rows so that 4:2:0 chroma rows are not shared
+  stripes = std::min(stripes, (size_t)height / 2);
+  return std::max((size_t)1, stripes);
+}
+
+//------------------------------------------------------------------------------
+// Convert to RGBA in parallel stripes
+//------------------------------------------------------------------------------
+int convertToRgbaParallel(TaskPool &pool, int32_t device_id,
+                          task_priority_t priority, uint32_t frame_type,
+                          const uint8_t *src, size_t src_len, uint32_t width,
+                          uint32_t height, uint8_t *dst, uint32_t dst_stride,
+                          uint32_t max_threads) {
+  FrameRect region;
+  return convertRegionToRgbaParallel(pool, device_id, priority, frame_type,
+                                     src, src_len, width, height, region, dst,
+                                     dst_stride, max_threads);
+}
+
+//------------------------------------------------------------------------------
+// Convert a region to RGBA in parallel stripes
+// The stripes split the region, so a small crop of a 4K frame is converted
+// in one pass on the calling thread.
+//------------------------------------------------------------------------------
+int convertRegionToRgbaParallel(TaskPool &pool, int32_t device_id,
+                                task_priority_t priority, uint32_t frame_type,
+                                const uint8_t *src, size_t src_len,
+                                uint32_t width, uint32_t height,
+                                FrameRect &region, uint8_t *dst,
+                                uint32_t dst_stride, uint32_t max_threads) {
+  return convertRegionToRgbaParallel(pool, device_id, priority, frame_type,
+                                     src, src_len, width, height, region,
+                                     FrameOrientation(), dst, dst_stride,
+                                     max_threads);
+}
+
+//------------------------------------------------------------------------------
+// Convert a region to RGBA in parallel stripes, rotated and/or mirrored
+// The orientation only changes where the pixels are stored, each stripe
+// still reads its source rows once, in order.
+//------------------------------------------------------------------------------
+int convertRegionToRgbaParallel(TaskPool &pool, int32_t device_id,
+                                task_priority_t priority, uint32_t frame_type,
+                                const uint8_t *src, size_t src_len,
+                                uint32_t width, uint32_t height,
+                                FrameRect &region,
+                                const FrameOrientation &orientation,
+                                uint8_t *dst, uint32_t dst_stride,
+                                uint32_t max_threads) {
+  if (!orientation.valid()) {
+    return -EINVAL;
+  }
+  const FrameRect rect = alignConvertRegion(frame_type, width, height, region);
+  uint32_t dst_width, dst_height;
+  orientedSize(orientation, rect.width, rect.height, dst_width, dst_height);
+  const int result = validate(frame_type, src, src_len, width, height, dst,
+                              dst_stride, dst_width);
+  if (result != 0) {
+    return result;
+  }
+  region = rect;
+  const PixelMap map = mapRegion(rect, orientation, dst, dst_stride);
+
+  // The calling thread converts stripes too while it waits
+  uint32_t workers = (uint32_t)pool.num_workers() + 1;
+  if (max_threads) {
+    workers = std::min(workers, max_threads);
+  }
+  const uint32_t x_end = rect.x + rect.width;
+  const uint32_t y_end = rect.y + rect.height;
+  const uint32_t stripes =
+      selectStripeCount(frame_type, rect.width, rect.height, workers);
+  if (stripes <= 1) {
+    convertBlock(frame_type, src, width, height, {rect.x, x_end, rect.y, y_end},
+                 map);
+    return 0;
+  }
+
+  // Even number of rows per stripe, the last stripe takes the remainder.
+  // Stripes of a rotated region are whole tiles so that two stripes never
+  // write the same destination cache line.
+  const uint32_t align = orientation.swapsAxes() ? ORIENT_TILE_ROWS : 2;
+  const uint32_t rows =
+      ((rect.height + stripes - 1) / stripes + align - 1) / align * align;
+  TaskGroup group(pool, device_id);
+  for (uint32_t y = rect.y + rows; y < y_end; y += rows) {
+    const RowRange stripe = {rect.x, x_end, y, std::min(y_end, y + rows)};
+    group.run(priority, [=] {
+      convertBlock(frame_type, src, width, height, stripe, map);
+    });
+  }
+  convertBlock(frame_type, src, width, height,
+               {rect.x, x_end, rect.y, std::min(y_end, rect.y + rows)}, map);
+  group.wait();
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Copy RGBX/RGBA pixels rotated and/or mirrored
+//------------------------------------------------------------------------------
+int orientRgbx(const uint8_t *src, uint32_t width, uint32_t height,
+               uint32_t src_stride, const FrameOrientation &orientation,
+               uint8_t *dst, uint32_t dst_stride) {
+  uint32_t dst_width, dst_height;
+  orientedSize(orientation, width, height, dst_width, dst_height);
+  if (!src || !dst || !orientation.valid() || src_stride % 4 ||
+      src_stride < width * 4 || dst_stride < dst_width * 4) {
+    return -EINVAL;
+  }
+  // Rows of src_stride / 4 pixels, the padding is never read
+  const FrameRect rect = {0, 0, width, height};
+  convertBlock(RAW_FRAME_UNCOMPRESSED_RGBX, src, src_stride / 4, height,
+               {0, width, 0, height},
+               mapRegion(rect, orientation, dst, dst_stride));
+  return 0;
+}
+
+} // namespace serenegiant::flutter
@@ -0,0 +1,197 @@
+/**
+ * Flutter Frame Dedup Implementation
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#define LOG_TAG "FrameDedup"
+
+#if 1
+#ifndef LOG_NDEBUG
+#define LOG_NDEBUG
+#endif
+#undef USE_LOGALL
+#else
+#define USE_LOGALL
+#undef LOG_NDEBUG
+#undef NDEBUG
+#endif
+
+// Standard C/C++ headers
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+// Project headers
+#include "aandusb/aandusb_native.h"
+#include "flutter_frame_converter.h"
+#include "flutter_frame_dedup.h"
+#include "utilbase.h"
+
+namespace serenegiant::flutter {
+
+//------------------------------------------------------------------------------
+// XXH64
+//------------------------------------------------------------------------------
+static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+// Both Android ABIs and the host are little endian
+static inline uint64_t read64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input) {
+  acc += input * PRIME64_2;
+  return rotl64(acc, 31) * PRIME64_1;
+}
+
+static inline uint64_t merge64(uint64_t acc, uint64_t val) {
+  acc ^= round64(0, val);
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t xxhash64(const void *data, size_t len, uint64_t seed) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  const uint8_t *const end = p + len;
+  uint64_t h;
+  if (len >= 32) {
+    uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+    uint64_t v2 = seed + PRIME64_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME64_1;
+    const uint8_t *const limit = end - 32;
+    do {
+      v1 = round64(v1, read64(p));
+      v2 = round64(v2, read64(p + 8));
+      v3 = round64(v3, read64(p + 16));
+      v4 = round64(v4, read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+    h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    h = merge64(h, v1);
+    h = merge64(h, v2);
+    h = merge64(h, v3);
+    h = merge64(h, v4);
+  } else {
+    h = seed + PRIME64_5;
+  }
+  h += (uint64_t)len;
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= round64(0, read64(p));
+    h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+  }
+  if (p + 4 <= end) {
+    h ^= (uint64_t)read32(p) * PRIME64_1;
+    h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= (uint64_t)*p * PRIME64_5;
+    h = rotl64(h, 11) * PRIME64_1;
+  }
+
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+//------------------------------------------------------------------------------
+// Frame hash
+//------------------------------------------------------------------------------
+uint64_t frameHash(uint32_t frame_type, const uint8_t *data, size_t len,
+                   uint32_t width, uint32_t height, uint32_t sample_rows) {
+  const size_t bytes = rawFrameBytes(frame_type, width, height);
+  if (!bytes || len < bytes || sample_rows <= 1) {
+    // Compressed (or unknown) payload, or every row wanted
+    return xxhash64(data, len);
+  }
+  // Rows of the first plane, the chroma plane of NV12/NV21 has rows of the
+  // same length
+  const bool planar = frame_type == RAW_FRAME_UNCOMPRESSED_NV12 ||
+                      frame_type == RAW_FRAME_UNCOMPRESSED_NV21;
+  const size_t row_bytes = planar ? width : bytes / height;
+  const size_t rows = bytes / row_bytes;
+  uint64_t h = 0;
+  for (size_t row = 0; row < rows; row += sample_rows) {
+    h = xxhash64(data + row * row_bytes, row_bytes, h);
+  }
+  if ((rows - 1) % sample_rows) {
+    // The last row too, it is where a partially written frame differs
+    h = xxhash64(data + (rows - 1) * row_bytes, row_bytes, h);
+  }
+  return h;
+}
+
+//------------------------------------------------------------------------------
+// Deduplication
+//------------------------------------------------------------------------------
+int FrameDedup::configure(bool enabled, uint32_t sample_rows) {
+  if (!sample_rows || sample_rows > DEDUP_MAX_SAMPLE_ROWS) {
+    return -EINVAL;
+  }
+  m_sample_rows = sample_rows;
+  m_invalidated = true;
+  {
+    std::lock_guard<std::mutex> lock(m_stats_lock);
+    m_stats = DedupStats{};
+  }
+  m_enabled = enabled;
+  LOGD("enabled %d, sample rows %u", enabled, sample_rows);
+
+  return 0;
+}
+
+bool FrameDedup::isDuplicate(uint32_t frame_type, const uint8_t *data,
+                             size_t len, uint32_t width, uint32_t height) {
+  if (!m_enabled || !data || !len) {
+    return false;
+  }
+  const uint64_t hash =
+      frameHash(frame_type, data, len, width, height, m_sample_rows);
+  const bool duplicate = !m_invalidated.exchange(false) &&
+                         hash == m_last_hash && len == m_last_len &&
+                         frame_type == m_last_type &&
+                         width == m_last_width && height == m_last_height;
+  m_last_hash = hash;
+  m_last_len = len;
+  m_last_type = frame_type;
+  m_last_width = width;
+  m_last_height = height;
+  m_run = duplicate ? m_run + 1 : 0;
+
+  std::lock_guard<std::mutex> lock(m_stats_lock);
+  m_stats.frames++;
+  if (duplicate) {
+    m_stats.duplicates++;
+    m_stats.longest_run = std::max(m_stats.longest_run, m_run);
+  }
+  return duplicate;
+}
+
+void FrameDedup::getStats(DedupStats &stats) const {
+  std::lock_guard<std::mutex> lock(m_stats_lock);
+  stats = m_stats;
+}
+
+} // namespace serenegiant::flutter
@@ -0,0 +1,178 @@
+/**
+ * Flutter Frame Scaler Implementation
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#define LOG_TAG "FrameScaler"
+
+#if 1
+#ifndef LOG_NDEBUG
+#define LOG_NDEBUG
+#endif
+#undef USE_LOGALL
+#else
+#define USE_LOGALL
+#undef LOG_NDEBUG
+#undef NDEBUG
+#endif
+
+// Standard C/C++ headers
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(USE_LIBYUV)
+// libyuv (bundled yuv1905_static)
+#include "libyuv.h"
+#endif
+
+// Project headers
+#include "flutter_frame_scaler.h"
+#include "utilbase.h"
+
+namespace serenegiant::flutter {
+
+//------------------------------------------------------------------------------
+// Portable box filter
+// Each destination pixel is the average of the source rectangle it covers.
+// The inner loops work on whole rows of 4 byte pixels with 32 bit
+// accumulators so the compiler can vectorize them.
+//------------------------------------------------------------------------------
+static void boxScale(const uint8_t *src, uint32_t src_width,
+                     uint32_t src_height, uint32_t src_stride, uint8_t *dst,
+                     uint32_t dst_width, uint32_t dst_height,
+                     uint32_t dst_stride) {
+  std::vector<uint32_t> x_start(dst_width + 1);
+  for (uint32_t x = 0; x <= dst_width; x++) {
+    x_start[x] = (uint32_t)((uint64_t)x * src_width / dst_width);
+  }
+  std::vector<uint32_t> row_sum((size_t)src_width * 4);
+
+  for (uint32_t dy = 0; dy < dst_height; dy++) {
+    const uint32_t y0 = (uint32_t)((uint64_t)dy * src_height / dst_height);
+    uint32_t y1 = (uint32_t)((uint64_t)(dy + 1) * src_height / dst_height);
+    if (y1 <= y0) {
+      y1 = y0 + 1;
+    }
+
+    // Sum the covered source rows
+    std::fill(row_sum.begin(), row_sum.end(), 0);
+    for (uint32_t sy = y0; sy < y1; sy++) {
+      const uint8_t *s = src + (size_t)sy * src_stride;
+      uint32_t *sum = row_sum.data();
+      for (uint32_t i = 0; i < src_width * 4; i++) {
+        sum[i] += s[i];
+      }
+    }
+
+    // Sum horizontally and divide with a 16.16 reciprocal
+    uint8_t *d = dst + (size_t)dy * dst_stride;
+    for (uint32_t dx = 0; dx < dst_width; dx++) {
+      const uint32_t x0 = x_start[dx];
+      uint32_t x1 = x_start[dx + 1];
+      if (x1 <= x0) {
+        x1 = x0 + 1;
+      }
+      uint32_t acc[4] = {0, 0, 0, 0};
+      for (uint32_t sx = x0; sx < x1; sx++) {
+        const uint32_t *p = &row_sum[sx * 4];
+        acc[0] += p[0];
+        acc[1] += p[1];
+        acc[2] += p[2];
+        acc[3] += p[3];
+      }
+      const uint64_t count = (uint64_t)(x1 - x0) * (y1 - y0);
+      const uint64_t inv = (65536 + count / 2) / count;
+      for (int c = 0; c < 4; c++) {
+        d[dx * 4 + c] = (uint8_t)std::min<uint64_t>(
+            255, (acc[c] * inv + 32768) >> 16);
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Portable bilinear filter (16.16 fixed point, pixel centers aligned)
+//------------------------------------------------------------------------------
+static void bilinearScale(const uint8_t *src, uint32_t src_width,
+                          uint32_t src_height, uint32_t src_stride,
+                          uint8_t *dst, uint32_t dst_width,
+                          uint32_t dst_height, uint32_t dst_stride) {
+  // Source position of each destination column
+  std::vector<uint32_t> x_pos(dst_width);
+  std::vector<uint32_t> x_frac(dst_width);
+  const int64_t x_step = ((int64_t)src_width << 16) / dst_width;
+  for (uint32_t dx = 0; dx < dst_width; dx++) {
+    int64_t fx = x_step * dx + x_step / 2 - 32768;
+    fx = std::clamp<int64_t>(fx, 0, ((int64_t)src_width - 1) << 16);
+    x_pos[dx] = (uint32_t)(fx >> 16);
+    x_frac[dx] = (uint32_t)(fx & 0xffff) >> 8; // 8 bit weight
+  }
+
+  const int64_t y_step = ((int64_t)src_height << 16) / dst_height;
+  for (uint32_t dy = 0; dy < dst_height; dy++) {
+    int64_t fy = y_step * dy + y_step / 2 - 32768;
+    fy = std::clamp<int64_t>(fy, 0, ((int64_t)src_height - 1) << 16);
+    const uint32_t sy = (uint32_t)(fy >> 16);
+    const uint32_t wy = (uint32_t)(fy & 0xffff) >> 8;
+    const uint8_t *r0 = src + (size_t)sy * src_stride;
+    const uint8_t *r1 =
+        src + (size_t)std::min(sy + 1, src_height - 1) * src_stride;
+    uint8_t *d = dst + (size_t)dy * dst_stride;
+    for (uint32_t dx = 0; dx < dst_width; dx++) {
+      const uint32_t sx0 = x_pos[dx] * 4;
+      const uint32_t sx1 = std::min(x_pos[dx] + 1, src_width - 1) * 4;
+      const uint32_t wx = x_frac[dx];
+      for (int c = 0; c < 4; c++) {
+        const uint32_t top = r0[sx0 + c] * (256 - wx) + r0[sx1 + c] * wx;
+        const uint32_t bottom = r1[sx0 + c] * (256 - wx) + r1[sx1 + c] * wx;
+        d[dx * 4 + c] =
+            (uint8_t)((top * (256 - wy) + bottom * wy + 32768) >> 16);
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Scale RGBA frame
+//------------------------------------------------------------------------------
+int scaleRgba(const uint8_t *src, uint32_t src_width, uint32_t src_height,
+              uint32_t src_stride, uint8_t *dst, uint32_t dst_width,
+              uint32_t dst_height, uint32_t dst_stride, ScaleFilter filter) {
+  if (!src || !dst || !src_width || !src_height || !dst_width ||
+      !dst_height) {
+    return -1;
+  }
+
+  if (src_width == dst_width && src_height == dst_height) {
+    for (uint32_t y = 0; y < src_height; y++) {
+      memcpy(dst + (size_t)y * dst_stride, src + (size_t)y * src_stride,
+             (size_t)src_width * 4);
+    }
+    return 0;
+  }
+
+  const bool downscale = dst_width <= src_width && dst_height <= src_height;
+
+#if defined(USE_LIBYUV)
+  // libyuv's ARGB functions do not care about channel order
+  return libyuv::ARGBScale(
+      src, (int)src_stride, (int)src_width, (int)src_height, dst,
+      (int)dst_stride, (int)dst_width, (int)dst_height,
+      filter == ScaleFilter::Box && downscale ? libyuv::kFilterBox
+                                              : libyuv::kFilterBilinear);
+#else
+  if (filter == ScaleFilter::Box && downscale) {
+    boxScale(src, src_width, src_height, src_stride, dst, dst_width,
+             dst_height, dst_stride);
+  } else {
+    bilinearScale(src, src_width, src_height, src_stride, dst, dst_width,
+                  dst_height, dst_stride);
+  }
+  return 0;
+#endif
+}
+
+} // namespace serenegiant::flutter
@@ -0,0 +1,385 @@
+/**
+ * Flutter Frame Subscriptions Implementation
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#define LOG_TAG "FrameSubscriptions"
+
+#if 1
+#ifndef LOG_NDEBUG
+#define LOG_NDEBUG
+#endif
+#undef USE_LOGALL
+#else
+#define USE_LOGALL
+#undef LOG_NDEBUG
+#undef NDEBUG
+#endif
+
+// Standard C/C++ headers
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+// Project headers
+#include "aandusb_native.h"
+#include "flutter_frame_converter.h"
+#include "flutter_frame_scaler.h"
+#include "flutter_frame_subscription.h"
+#include "utilbase.h"
+
+namespace serenegiant::flutter {
+
+//------------------------------------------------------------------------------
+// Subscriber state
+//------------------------------------------------------------------------------
+struct FrameSubscriptions::Subscriber {
+  int32_t id;
+  SubscriberOptions options;
+  FrameFunctionRef callback;
+  // Minimum distance between two delivered frames, 0 means every frame
+  int64_t interval_ns;
+
+  // Capture thread only
+  int64_t next_due_ns = 0;
+  bool due = false;
+  // Frame copy for pool calls and scaled RGBA, reused across frames
+  std::vector<uint8_t> buffer;
+  // Scaled RGBA before the orientation is applied
+  std::vector<uint8_t> scaled;
+  FrameView view{};
+
+  // Guarded by FrameSubscriptions::m_lock
+  bool active = true;
+  int in_flight = 0;
+
+  // Set by the capture thread when a pool call is submitted, cleared by the
+  // pool worker when it returns
+  std::atomic<bool> busy{false};
+
+  std::atomic<uint64_t> delivered{0};
+  std::atomic<uint64_t> rate_limited{0};
+  std::atomic<uint64_t> dropped_busy{0};
+};
+
+// Subscriber being called on this thread, lets a callback unsubscribe itself
+static thread_local const void *t_current = nullptr;
+
+//------------------------------------------------------------------------------
+// Constructor/Destructor
+//------------------------------------------------------------------------------
+FrameSubscriptions::FrameSubscriptions(int32_t device_id)
+    : m_device_id(device_id), m_next_id(1),
+      m_subscribers(
+          std::make_shared<std::vector<std::shared_ptr<Subscriber>>>()) {}
+
+FrameSubscriptions::~FrameSubscriptions() { clear(); }
+
+//------------------------------------------------------------------------------
+// Subscribe/unsubscribe
+//------------------------------------------------------------------------------
+int32_t FrameSubscriptions::subscribe(const SubscriberOptions &options,
+                                      FrameFunctionRef callback) {
+  if (!callback || options.max_fps < 0.0f ||
+      (!options.width != !options.height) || !options.orientation.valid() ||
+      (options.format == FrameFormat::Raw &&
+       (options.width || !options.crop.empty() ||
+        !options.orientation.isIdentity()))) {
+    return -EINVAL;
+  }
+
+  auto subscriber = std::make_shared<Subscriber>();
+  subscriber->options = options;
+  subscriber->callback = callback;
+  subscriber->interval_ns =
+      options.max_fps > 0.0f ? (int64_t)(1.0e9 / options.max_fps) : 0;
+
+  std::lock_guard<std::mutex> lock(m_lock);
+  subscriber->id = m_next_id++;
+  // Copy on write, the capture thread keeps using its snapshot
+  auto list =
+      std::make_shared<std::vector<std::shared_ptr<Subscriber>>>(*m_subscribers);
+  list->push_back(subscriber);
+  m_subscribers = std::move(list);
+  LOGD("subscribe: id=%d, format=%d, %ux%u, max_fps=%.1f, mode=%d",
+       subscriber->id, (int)options.format, options.width, options.height,
+       options.max_fps, (int)options.mode);
+  return subscriber->id;
+}
+
+int FrameSubscriptions::unsubscribe(int32_t id) {
+  std::unique_lock<std::mutex> lock(m_lock);
+  auto list = std::make_shared<std::vector<std::shared_ptr<Subscriber>>>();
+  std::shared_ptr<Subscriber> removed;
+  for (const auto &subscriber : *m_subscribers) {
+    if (subscriber->id == id) {
+      removed = subscriber;
+    } else {
+      list->push_back(subscriber);
+    }
+  }
+  if (!removed) {
+    return -ENOENT;
+  }
+  m_subscribers = std::move(list);
+  removed->active = false;
+  if (removed->in_flight) {
+    if (t_current == removed.get()) {
+      // Called from its own callback, released when the call returns
+      m_retired.push_back(removed);
+    } else {
+      m_idle.wait(lock, [&] { return removed->in_flight == 0; });
+    }
+  }
+  LOGD("unsubscribe: id=%d", id);
+  return 0;
+}
+
+void FrameSubscriptions::clear() {
+  std::unique_lock<std::mutex> lock(m_lock);
+  auto removed = m_subscribers;
+  m_subscribers =
+      std::make_shared<std::vector<std::shared_ptr<Subscriber>>>();
+  for (const auto &subscriber : *removed) {
+    subscriber->active = false;
+  }
+  m_idle.wait(lock, [&] {
+    return m_retired.empty() &&
+           std::none_of(removed->begin(), removed->end(),
+                        [](const std::shared_ptr<Subscriber> &s) {
+                          return s->in_flight != 0;
+                        });
+  });
+}
+
+size_t FrameSubscriptions::size() const {
+  std::lock_guard<std::mutex> lock(m_lock);
+  return m_subscribers->size();
+}
+
+int FrameSubscriptions::getStats(int32_t id, SubscriberStats &stats) const {
+  const auto subscribers = snapshot();
+  for (const auto &subscriber : *subscribers) {
+    if (subscriber->id == id) {
+      stats.delivered = subscriber->delivered;
+      stats.rate_limited = subscriber->rate_limited;
+      stats.dropped_busy = subscriber->dropped_busy;
+      return 0;
+    }
+  }
+  return -ENOENT;
+}
+
+FrameSubscriptions::Snapshot FrameSubscriptions::snapshot() const {
+  std::lock_guard<std::mutex> lock(m_lock);
+  return m_subscribers;
+}
+
+bool FrameSubscriptions::wantsRgba(const Snapshot &subscribers) {
+  return std::any_of(subscribers->begin(), subscribers->end(),
+                     [](const std::shared_ptr<Subscriber> &s) {
+                       return s->options.format == FrameFormat::Rgba;
+                     });
+}
+
+//------------------------------------------------------------------------------
+// Pick the subscribers due for a frame
+//------------------------------------------------------------------------------
+bool FrameSubscriptions::schedule(const Snapshot &subscribers,
+                                  int64_t timestamp_ns, uint32_t width,
+                                  uint32_t height, RgbaDemand &rgba) {
+  rgba = {};
+  bool any = false;
+  for (const auto &subscriber : *subscribers) {
+    auto &s = *subscriber;
+    s.due = false;
+    if (s.interval_ns && s.next_due_ns &&
+        timestamp_ns + s.interval_ns / 8 < s.next_due_ns) {
+      s.rate_limited++;
+      continue;
+    }
+    if (s.options.mode == DispatchMode::Pool && s.busy) {
+      s.dropped_busy++;
+      continue;
+    }
+    if (s.interval_ns) {
+      // Keep the average rate at max_fps, restart after a gap
+      s.next_due_ns =
+          s.next_due_ns && timestamp_ns - s.next_due_ns < s.interval_ns
+              ? s.next_due_ns + s.interval_ns
+              : timestamp_ns + s.interval_ns;
+    }
+    s.due = true;
+    any = true;
+    if (s.options.format == FrameFormat::Rgba) {
+      rgba.due = true;
+      const FrameRect crop = clipRect(s.options.crop, width, height);
+      rgba.region = unionRect(rgba.region, crop);
+      if (!s.options.width || crop.empty()) {
+        rgba.full = true;
+      } else {
+        // The requested size is oriented, the crop is not
+        uint32_t out_width, out_height, w, h;
+        orientedSize(s.options.orientation, s.options.width, s.options.height,
+                     out_width, out_height);
+        frameSizeForCrop(crop, width, height, out_width, out_height, w, h);
+        rgba.width = std::max(rgba.width, w);
+        rgba.height = std::max(rgba.height, h);
+      }
+    }
+  }
+  return any;
+}
+
+//------------------------------------------------------------------------------
+// Hand a frame to the due subscribers
+//------------------------------------------------------------------------------
+void FrameSubscriptions::dispatch(const Snapshot &subscribers,
+                                  const FrameView &frame,
+                                  FunctionRef<void()> on_deliver) {
+  for (const auto &subscriber : *subscribers) {
+    auto &s = *subscriber;
+    if (!s.due || s.options.format != FrameFormat::Raw) {
+      continue;
+    }
+    s.due = false;
+    // The capture buffers are reused by the next frame
+    deliver(s, frame, s.options.mode == DispatchMode::Pool, on_deliver);
+  }
+}
+
+void FrameSubscriptions::dispatch(const Snapshot &subscribers,
+                                  const DecodedFrame &frame,
+                                  FunctionRef<void()> on_deliver) {
+  const uint32_t stride = frame.stride();
+  for (const auto &subscriber : *subscribers) {
+    auto &s = *subscriber;
+    if (!s.due || s.options.format != FrameFormat::Rgba) {
+      continue;
+    }
+    s.due = false;
+
+    const uint8_t *data;
+    const FrameRect rect = locateCrop(frame, s.options.crop, data);
+    // Rows of the crop as stored and what is left to turn them by
+    uint32_t stored_width, stored_height;
+    orientedSize(frame.orientation, rect.width, rect.height, stored_width,
+                 stored_height);
+    const FrameOrientation turn =
+        relativeOrientation(frame.orientation, s.options.orientation);
+    uint32_t width, height;
+    orientedSize(turn, stored_width, stored_height, width, height);
+    if (s.options.width) {
+      width = s.options.width;
+      height = s.options.height;
+    }
+    FrameView view = {data, (size_t)width * height * 4,
+                      RAW_FRAME_UNCOMPRESSED_RGBX, width, height,
+                      frame.pts_us};
+    bool copy = s.options.mode == DispatchMode::Pool;
+    // Scale in the stored orientation, then turn while copying
+    uint32_t scaled_width, scaled_height;
+    orientedSize(turn, width, height, scaled_width, scaled_height);
+    const uint8_t *src = data;
+    uint32_t src_stride = stride;
+    if (scaled_width != stored_width || scaled_height != stored_height) {
+      auto &scaled = turn.isIdentity() ? s.buffer : s.scaled;
+      scaled.resize(view.len);
+      if (scaleRgba(data, stored_width, stored_height, stride, scaled.data(),
+                    scaled_width, scaled_height, scaled_width * 4) != 0) {
+        continue;
+      }
+      src = scaled.data();
+      src_stride = scaled_width * 4;
+    }
+    if (!turn.isIdentity()) {
+      s.buffer.resize(view.len);
+      if (orientRgbx(src, scaled_width, scaled_height, src_stride, turn,
+                     s.buffer.data(), width * 4) != 0) {
+        continue;
+      }
+      view.data = s.buffer.data();
+      copy = false;
+    } else if (src != data) {
+      view.data = src;
+      copy = false;
+    } else if (rect != frame.region) {
+      // Pack the crop rows
+      s.buffer.resize(view.len);
+      for (uint32_t y = 0; y < height; y++) {
+        memcpy(s.buffer.data() + (size_t)y * width * 4,
+               data + (size_t)y * stride, (size_t)width * 4);
+      }
+      view.data = s.buffer.data();
+      copy = false;
+    }
+    deliver(s, view, copy, on_deliver);
+  }
+}
+
+void FrameSubscriptions::deliver(Subscriber &s, const FrameView &frame,
+                                 bool copy, FunctionRef<void()> on_deliver) {
+  FrameView view = frame;
+  if (copy) {
+    s.buffer.resize(frame.len);
+    memcpy(s.buffer.data(), frame.data, frame.len);
+    view.data = s.buffer.data();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (!s.active) {
+      return;
+    }
+    s.in_flight++;
+  }
+  on_deliver();
+  s.delivered++;
+  if (s.options.mode == DispatchMode::Pool) {
+    s.view = view;
+    s.busy = true;
+    // Capturing the raw pointer keeps the task small enough for the
+    // inline storage of std::function, the subscriber stays alive until
+    // finish() since unsubscribe waits for in_flight
+    Subscriber *raw = &s;
+    const int result = TaskPool::get_instance().submit(
+        m_device_id, TASK_PRIORITY_ANALYSIS, [this, raw] { runOnPool(raw); });
+    if (result != 0) {
+      s.busy = false;
+      finish(&s);
+    }
+  } else {
+    t_current = &s;
+    s.callback(view);
+    t_current = nullptr;
+    finish(&s);
+  }
+}
+
+void FrameSubscriptions::runOnPool(Subscriber *subscriber) {
+  t_current = subscriber;
+  subscriber->callback(subscriber->view);
+  t_current = nullptr;
+  subscriber->busy = false;
+  finish(subscriber);
+}
+
+void FrameSubscriptions::finish(Subscriber *subscriber) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  if (--subscriber->in_flight == 0) {
+    if (!subscriber->active) {
+      // May release the subscriber, it is not touched after this
+      m_retired.erase(
+          std::remove_if(m_retired.begin(), m_retired.end(),
+                         [&](const std::shared_ptr<Subscriber> &s) {
+                           return s.get() == subscriber;
+                         }),
+          m_retired.end());
+    }
+    m_idle.notify_all();
+  }
+}
+
+} // namespace serenegiant::flutter
@@ -0,0 +1,354 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#define LOG_TAG "LatencyProbe"
+
+#if 1	// デバッグ情報を出さない時は1
+	#ifndef LOG_NDEBUG
+		#define	LOG_NDEBUG		// LOGV/LOGD/MARKを出力しない時
+	#endif
+	#undef USE_LOGALL			// 指定したLOGxだけを出力
+#else
+	#define USE_LOGALL
+	#define USE_LOGD
+	#undef LOG_NDEBUG
+	#undef NDEBUG
+#endif
+
+// 標準ライブラリ
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+// aandusb
+#include "utilbase.h"
+#include "aandusb_native.h"
+// flutter
+#include "flutter_latency_probe.h"
+
+namespace serenegiant::flutter
+{
+
+	/**
+	 * MJPEGへ挿入するCOMセグメントのマーカーとセグメント長(長さフィールド自体を含む)
+	 */
+	#define JPEG_MARKER_SOI (0xd8)
+	#define JPEG_MARKER_COM (0xfe)
+	#define JPEG_COM_LENGTH (2 + LATENCY_PROBE_STAMP_BYTES)
+
+	/**
+	 * スタンプを16バイトへ書き出す(リトルエンディアン)
+	 */
+	static void write_stamp(uint8_t *dst, const latency_stamp_t &stamp)
+	{
+		const uint32_t magic = LATENCY_PROBE_MAGIC;
+		memcpy(dst, &magic, 4);
+		memcpy(dst + 4, &stamp.seq, 4);
+		memcpy(dst + 8, &stamp.capture_ns, 8);
+	}
+
+	/**
+	 * 16バイトからスタンプを読み取る
+	 * @return true: 識別子が一致した
+	 */
+	static bool read_stamp(const uint8_t *src, latency_stamp_t &stamp)
+	{
+		uint32_t magic;
+		memcpy(&magic, src, 4);
+		if (magic != LATENCY_PROBE_MAGIC)
+		{
+			return false;
+		}
+		memcpy(&stamp.seq, src + 4, 4);
+		memcpy(&stamp.capture_ns, src + 8, 8);
+		return true;
+	}
+
+	/**
+	 * 遅延測定用のスタンプをフレームへ埋め込む
+	 * @param frame_type フレームの映像フォーマット
+	 * @param data フレームデータ
+	 * @param bytes フレームデータのバイト数, MJPEGならCOMセグメント分だけ増える
+	 * @param capacity dataのバイト数
+	 * @param stamp
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int latency_probe_embed(
+		const uint32_t &frame_type,
+		uint8_t *data, size_t &bytes, const size_t &capacity,
+		const latency_stamp_t &stamp)
+	{
+		if (!data)
+		{
+			return -EINVAL;
+		}
+		if (frame_type == RAW_FRAME_MJPEG)
+		{
+			if ((bytes < 2) || (data[0] != 0xff) || (data[1] != JPEG_MARKER_SOI))
+			{
+				return -EINVAL;
+			}
+			if (bytes + 2 + JPEG_COM_LENGTH > capacity)
+			{
+				return -ENOSPC;
+			}
+			// SOIの直後へCOMセグメントを挿入する
+			memmove(data + 4 + JPEG_COM_LENGTH, data + 2, bytes - 2);
+			data[2] = 0xff;
+			data[3] = JPEG_MARKER_COM;
+			data[4] = (JPEG_COM_LENGTH >> 8) & 0xff;
+			data[5] = JPEG_COM_LENGTH & 0xff;
+			write_stamp(data + 6, stamp);
+			bytes += 2 + JPEG_COM_LENGTH;
+			return 0;
+		}
+		if ((frame_type & 0xffff) == 0x0005)
+		{
+			// 非圧縮フレームは左上の画素を上書きする
+			if (bytes < LATENCY_PROBE_STAMP_BYTES)
+			{
+				return -ENOSPC;
+			}
+			write_stamp(data, stamp);
+			return 0;
+		}
+		return -EINVAL;
+	}
+
+	/**
+	 * フレームから遅延測定用のスタンプを取り出す
+	 * @param data フレームデータ
+	 * @param bytes フレームデータのバイト数
+	 * @param stamp
+	 * @return true: スタンプが埋め込まれていた
+	 */
+	bool latency_probe_extract(
+		const uint8_t *data, const size_t &bytes,
+		latency_stamp_t &stamp)
+	{
+		if (!data || (bytes < 4 + JPEG_COM_LENGTH))
+		{
+			return false;
+		}
+		if ((data[0] == 0xff) && (data[1] == JPEG_MARKER_SOI))
+		{
+			return (data[2] == 0xff) && (data[3] == JPEG_MARKER_COM)
+				&& (((data[4] << 8) | data[5]) == JPEG_COM_LENGTH)
+				&& read_stamp(data + 6, stamp);
+		}
+		return read_stamp(data, stamp);
+	}
+
+	//--------------------------------------------------------------------------------
+	/**
+	 * 遅延をヒストグラムのビン番号へ変換する
+	 */
+	static int bucket_of(const int64_t &latency_ns)
+	{
+		const int64_t us = latency_ns / 1000;
+		int bucket = 0;
+		for (int64_t v = us; (v > 0) && (bucket < LATENCY_HISTOGRAM_BUCKETS - 1); v >>= 1)
+		{
+			bucket++;
+		}
+		return bucket;
+	}
+
+	/**
+	 * ヒストグラムのビンの上限値[ナノ秒]
+	 */
+	static int64_t bucket_upper_ns(const int &bucket)
+	{
+		return (1LL << bucket) * 1000LL;
+	}
+
+	LatencyProbe::LatencyProbe()
+	:	m_enabled(false),
+		m_frames(0), m_no_stamp(0), m_dropped(0),
+		m_has_seq(false), m_last_seq(0),
+		m_stages()
+	{
+		ENTER();
+		EXIT();
+	}
+
+	/**
+	 * 遅延の測定を有効/無効にする, 集計結果は破棄する
+	 * @param enabled
+	 */
+	/*public*/
+	void LatencyProbe::set_enabled(const bool &enabled)
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		reset_locked();
+		m_enabled = enabled;
+
+		EXIT();
+	}
+
+	/**
+	 * 集計結果を破棄する
+	 */
+	/*public*/
+	void LatencyProbe::reset()
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		reset_locked();
+
+		EXIT();
+	}
+
+	/*private*/
+	void LatencyProbe::reset_locked()
+	{
+		m_frames = m_no_stamp = m_dropped = 0;
+		m_has_seq = false;
+		m_last_seq = 0;
+		memset(m_stages, 0, sizeof(m_stages));
+	}
+
+	/**
+	 * 受け取ったフレームからスタンプを取り出して欠番を数える
+	 * @param data
+	 * @param bytes
+	 * @param stamp
+	 * @return true: 測定が有効でスタンプが埋め込まれていた
+	 */
+	/*public*/
+	bool LatencyProbe::begin(const uint8_t *data, const size_t &bytes, latency_stamp_t &stamp)
+	{
+		if (!m_enabled)
+		{
+			return false;
+		}
+		const bool found = latency_probe_extract(data, bytes, stamp);
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (!found)
+		{
+			m_no_stamp++;
+			return false;
+		}
+		m_frames++;
+		// 映像ソースは古いフレームを新しいフレームで上書きするので欠番はパイプラインの遅れ
+		if (m_has_seq && (stamp.seq > m_last_seq + 1))
+		{
+			m_dropped += stamp.seq - m_last_seq - 1;
+		}
+		m_has_seq = true;
+		m_last_seq = stamp.seq;
+		return true;
+	}
+
+	/**
+	 * フレームがパイプラインの段階へ届いたのを記録する
+	 * @param stage
+	 * @param stamp beginで取り出したスタンプ
+	 * @param now_ns 届いたCLOCK_MONOTONICの時刻[ナノ秒], 0なら現在時刻
+	 */
+	/*public*/
+	void LatencyProbe::record(const latency_stage_t &stage, const latency_stamp_t &stamp, const int64_t &now_ns)
+	{
+		if ((stage < 0) || (stage >= LATENCY_STAGE_NUM))
+		{
+			return;
+		}
+		const int64_t now = now_ns ? now_ns
+			: std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		const int64_t latency_ns = std::max<int64_t>(0, now - stamp.capture_ns);
+		std::lock_guard<std::mutex> lock(m_lock);
+		auto &s = m_stages[stage];
+		if (!s.count || (latency_ns < s.min_ns))
+		{
+			s.min_ns = latency_ns;
+		}
+		if (!s.count || (latency_ns > s.max_ns))
+		{
+			s.max_ns = latency_ns;
+		}
+		s.count++;
+		s.sum_ns += latency_ns;
+		s.histogram[bucket_of(latency_ns)]++;
+	}
+
+	/**
+	 * 段階毎の集計結果を取得
+	 * @param stage
+	 * @param stats
+	 */
+	/*public*/
+	void LatencyProbe::get_stats(const latency_stage_t &stage, latency_stats_t &stats) const
+	{
+		memset(&stats, 0, sizeof(stats));
+		if ((stage < 0) || (stage >= LATENCY_STAGE_NUM))
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(m_lock);
+		const auto &s = m_stages[stage];
+		stats.count = s.count;
+		memcpy(stats.histogram, s.histogram, sizeof(stats.histogram));
+		if (!s.count)
+		{
+			return;
+		}
+		stats.min_ns = s.min_ns;
+		stats.max_ns = s.max_ns;
+		stats.mean_ns = s.sum_ns / (int64_t)s.count;
+		// パーセンタイルはそのビンの上限値を最小値〜最大値の範囲へ丸める
+		const auto percentile = [&](const uint64_t &rank) {
+			uint64_t total = 0;
+			for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+			{
+				total += s.histogram[i];
+				if (total >= rank)
+				{
+					return std::clamp(bucket_upper_ns(i), s.min_ns, s.max_ns);
+				}
+			}
+			return s.max_ns;
+		};
+		stats.p50_ns = percentile((s.count * 50 + 99) / 100);
+		stats.p95_ns = percentile((s.count * 95 + 99) / 100);
+		stats.p99_ns = percentile((s.count * 99 + 99) / 100);
+	}
+
+	/**
+	 * シーケンス番号の欠番から求めたパイプラインへ届かなかったフレーム数
+	 */
+	/*public*/
+	uint64_t LatencyProbe::get_dropped() const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return m_dropped;
+	}
+
+	/**
+	 * スタンプが無かったので測定できなかったフレーム数
+	 */
+	/*public*/
+	uint64_t LatencyProbe::get_no_stamp() const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return m_no_stamp;
+	}
+
+}	// namespace serenegiant::flutter
@@ -0,0 +1,229 @@
+/**
+ * Flutter MJPEG Decoder Implementation
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#define LOG_TAG "MjpegDecoder"
+
+#if 1
+#ifndef LOG_NDEBUG
+#define LOG_NDEBUG
+#endif
+#undef USE_LOGALL
+#else
+#define USE_LOGALL
+#undef LOG_NDEBUG
+#undef NDEBUG
+#endif
+
+// Standard C/C++ headers
+#include <algorithm>
+#include <csetjmp>
+#include <cstring>
+
+// Project headers
+#include "flutter_mjpeg_decoder.h"
+#include "utilbase.h"
+
+namespace serenegiant::flutter {
+
+//------------------------------------------------------------------------------
+// Error handling
+// libjpeg reports fatal errors through error_exit which must not return,
+// so jump back to decode() instead of calling exit().
+//------------------------------------------------------------------------------
+void MjpegDecoder::onError(j_common_ptr cinfo) {
+  auto *err = reinterpret_cast<ErrorManager *>(cinfo->err);
+  char msg[JMSG_LENGTH_MAX];
+  (*cinfo->err->format_message)(cinfo, msg);
+  LOGW("libjpeg error: %s", msg);
+  longjmp(*static_cast<jmp_buf *>(err->jmp_buf_ptr), 1);
+}
+
+void MjpegDecoder::onMessage(j_common_ptr /*cinfo*/) {
+  // UVC cameras often emit frames with minor corruption (e.g. extraneous
+  // bytes before markers), keep the log quiet for those warnings.
+}
+
+//------------------------------------------------------------------------------
+// Constructor / Destructor
+//------------------------------------------------------------------------------
+MjpegDecoder::MjpegDecoder() : m_last_scale_denom(1) {
+  memset(&m_cinfo, 0, sizeof(m_cinfo));
+  m_cinfo.err = jpeg_std_error(&m_jerr.pub);
+  m_jerr.pub.error_exit = onError;
+  m_jerr.pub.output_message = onMessage;
+  m_jerr.jmp_buf_ptr = nullptr;
+  jpeg_create_decompress(&m_cinfo);
+}
+
+MjpegDecoder::~MjpegDecoder() { jpeg_destroy_decompress(&m_cinfo); }
+
+//------------------------------------------------------------------------------
+// Scale selection
+//------------------------------------------------------------------------------
+uint32_t MjpegDecoder::selectScaleDenom(uint32_t src_width,
+                                        uint32_t src_height,
+                                        uint32_t dst_width,
+                                        uint32_t dst_height) {
+  if (!dst_width || !dst_height || !src_width || !src_height) {
+    return 1;
+  }
+  uint32_t denom = 1;
+  // Scaled output size is ceil(src / denom)
+  while (denom < 8 &&
+         (src_width + denom * 2 - 1) / (denom * 2) >= dst_width &&
+         (src_height + denom * 2 - 1) / (denom * 2) >= dst_height) {
+    denom *= 2;
+  }
+  return denom;
+}
+
+//------------------------------------------------------------------------------
+// Decode
+//------------------------------------------------------------------------------
+int MjpegDecoder::decode(const uint8_t *jpeg, size_t len, uint32_t dst_width,
+                         uint32_t dst_height, std::vector<uint8_t> &rgba,
+                         uint32_t &out_width, uint32_t &out_height) {
+  FrameRect region;
+  return decode(jpeg, len, dst_width, dst_height, FrameRect(), rgba,
+                out_width, out_height, region);
+}
+
+int MjpegDecoder::decode(const uint8_t *jpeg, size_t len, uint32_t dst_width,
+                         uint32_t dst_height, const FrameRect &crop,
+                         std::vector<uint8_t> &rgba, uint32_t &out_width,
+                         uint32_t &out_height, FrameRect &region) {
+  if (!jpeg || !len) {
+    return -1;
+  }
+
+  jmp_buf env;
+  m_jerr.jmp_buf_ptr = &env;
+  if (setjmp(env)) {
+    jpeg_abort_decompress(&m_cinfo);
+    m_jerr.jmp_buf_ptr = nullptr;
+    return -2;
+  }
+
+  jpeg_mem_src(&m_cinfo, const_cast<uint8_t *>(jpeg), (unsigned long)len);
+  if (jpeg_read_header(&m_cinfo, TRUE) != JPEG_HEADER_OK) {
+    jpeg_abort_decompress(&m_cinfo);
+    m_jerr.jmp_buf_ptr = nullptr;
+    return -3;
+  }
+
+  const uint32_t denom = selectScaleDenom(
+      m_cinfo.image_width, m_cinfo.image_height, dst_width, dst_height);
+  m_cinfo.scale_num = 1;
+  m_cinfo.scale_denom = denom;
+  m_cinfo.out_color_space = JCS_EXT_RGBA;
+  m_cinfo.dct_method = JDCT_IFAST;
+  // Fancy upsampling only improves chroma edges which the reduced preview
+  // can not show anyway
+  m_cinfo.do_fancy_upsampling = denom > 1 ? FALSE : TRUE;
+
+  jpeg_start_decompress(&m_cinfo);
+
+  out_width = m_cinfo.output_width;
+  out_height = m_cinfo.output_height;
+  region = scaleRect(
+      clipRect(crop, m_cinfo.image_width, m_cinfo.image_height),
+      m_cinfo.image_width, m_cinfo.image_height, out_width, out_height);
+  if (region.x || region.width < out_width) {
+    // Only the iMCU columns covering the crop go through the IDCT, libjpeg
+    // widens the crop to their boundaries and output_width becomes its width.
+    // Fancy upsampling has no right neighbour for the last column, so one
+    // more column is decoded to keep the crop identical to a full decode.
+    JDIMENSION x = region.x;
+    JDIMENSION width = std::min(region.width + 1, out_width - region.x);
+    jpeg_crop_scanline(&m_cinfo, &x, &width);
+    region.x = x;
+    region.width = width;
+  }
+  if (region.y) {
+    // Skipped rows are entropy decoded only
+    jpeg_skip_scanlines(&m_cinfo, region.y);
+  }
+
+  const size_t stride = (size_t)region.width * 4;
+  if (rgba.size() < stride * region.height) {
+    rgba.resize(stride * region.height);
+  }
+  m_rows.resize(region.height);
+  for (uint32_t y = 0; y < region.height; y++) {
+    m_rows[y] = rgba.data() + stride * y;
+  }
+  const uint32_t y_end = region.y + region.height;
+  while (m_cinfo.output_scanline < y_end) {
+    jpeg_read_scanlines(&m_cinfo, &m_rows[m_cinfo.output_scanline - region.y],
+                        y_end - m_cinfo.output_scanline);
+  }
+
+  if (m_cinfo.output_scanline < m_cinfo.output_height) {
+    // Rows below the crop are not needed, stop without decoding them
+    jpeg_abort_decompress(&m_cinfo);
+  } else {
+    jpeg_finish_decompress(&m_cinfo);
+  }
+  m_jerr.jmp_buf_ptr = nullptr;
+  m_last_scale_denom = denom;
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Luma only decode
+//------------------------------------------------------------------------------
+int MjpegDecoder::decodeLuma(const uint8_t *jpeg, size_t len,
+                             uint32_t scale_denom, std::vector<uint8_t> &luma,
+                             uint32_t &out_width, uint32_t &out_height) {
+  if (!jpeg || !len) {
+    return -1;
+  }
+
+  jmp_buf env;
+  m_jerr.jmp_buf_ptr = &env;
+  if (setjmp(env)) {
+    jpeg_abort_decompress(&m_cinfo);
+    m_jerr.jmp_buf_ptr = nullptr;
+    return -2;
+  }
+
+  jpeg_mem_src(&m_cinfo, const_cast<uint8_t *>(jpeg), (unsigned long)len);
+  if (jpeg_read_header(&m_cinfo, TRUE) != JPEG_HEADER_OK) {
+    jpeg_abort_decompress(&m_cinfo);
+    m_jerr.jmp_buf_ptr = nullptr;
+    return -3;
+  }
+
+  m_cinfo.scale_num = 1;
+  m_cinfo.scale_denom = scale_denom;
+  // YCbCr to grayscale only keeps the Y component
+  m_cinfo.out_color_space = JCS_GRAYSCALE;
+  m_cinfo.dct_method = JDCT_IFAST;
+  m_cinfo.do_fancy_upsampling = FALSE;
+
+  jpeg_start_decompress(&m_cinfo);
+
+  out_width = m_cinfo.output_width;
+  out_height = m_cinfo.output_height;
+  if (luma.size() < (size_t)out_width * out_height) {
+    luma.resize((size_t)out_width * out_height);
+  }
+  m_rows.resize(out_height);
+  for (uint32_t y = 0; y < out_height; y++) {
+    m_rows[y] = luma.data() + (size_t)out_width * y;
+  }
+  while (m_cinfo.output_scanline < out_height) {
+    jpeg_read_scanlines(&m_cinfo, &m_rows[m_cinfo.output_scanline],
+                        out_height - m_cinfo.output_scanline);
+  }
+  jpeg_finish_decompress(&m_cinfo);
+  m_jerr.jmp_buf_ptr = nullptr;
+  m_last_scale_denom = scale_denom;
+  return 0;
+}
+
+} // namespace serenegiant::flutter
@@ -0,0 +1,269 @@
+/**
+ * Flutter Motion Detector Implementation
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#define LOG_TAG "MotionDetector"
+
+#if 1
+#ifndef LOG_NDEBUG
+#define LOG_NDEBUG
+#endif
+#undef USE_LOGALL
+#else
+#define USE_LOGALL
+#undef LOG_NDEBUG
+#undef NDEBUG
+#endif
+
+// Standard C/C++ headers
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Project headers
+#include "aandusb/aandusb_native.h"
+#include "flutter_frame_converter.h"
+#include "flutter_motion_detector.h"
+#include "utilbase.h"
+
+namespace serenegiant::flutter {
+
+//------------------------------------------------------------------------------
+// Sum of absolute differences
+//------------------------------------------------------------------------------
+uint32_t sadRow(const uint8_t *a, const uint8_t *b, size_t n) {
+  uint32_t sum = 0;
+  size_t i = 0;
+#if defined(__ARM_NEON)
+  // |a - b| widened pairwise into 32 bit lanes, 16 pixels per step
+  uint32x4_t acc = vdupq_n_u32(0);
+  for (; i + 16 <= n; i += 16) {
+    const uint8x16_t diff = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+    acc = vpadalq_u16(acc, vpaddlq_u8(diff));
+  }
+  sum = vgetq_lane_u32(acc, 0) + vgetq_lane_u32(acc, 1) +
+        vgetq_lane_u32(acc, 2) + vgetq_lane_u32(acc, 3);
+#elif defined(__SSE2__)
+  // psadbw sums each half of 16 absolute differences into a 64 bit lane
+  __m128i acc = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+    const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+  }
+  sum = (uint32_t)_mm_cvtsi128_si32(acc) +
+        (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#endif
+  for (; i < n; i++) {
+    sum += (uint32_t)std::abs((int)a[i] - (int)b[i]);
+  }
+  return sum;
+}
+
+//------------------------------------------------------------------------------
+// Settings
+//------------------------------------------------------------------------------
+int MotionDetector::configure(const MotionConfig &config) {
+  const uint32_t cells = config.grid_columns * config.grid_rows;
+  if (!config.grid_columns || config.grid_columns > MOTION_MAX_GRID ||
+      !config.grid_rows || config.grid_rows > MOTION_MAX_GRID ||
+      (config.subsample != 1 && config.subsample != 2 &&
+       config.subsample != 4 && config.subsample != 8) ||
+      !config.cell_threshold || config.cell_threshold > 255 ||
+      !config.min_cells || config.min_cells > cells ||
+      !config.trigger_frames ||
+      (!config.mask.empty() && config.mask.size() != cells)) {
+    return -EINVAL;
+  }
+
+  std::lock_guard<std::mutex> lock(m_lock);
+  m_config = config;
+  m_gate_recording = config.gate_recording;
+  m_reference.clear();
+  m_motion_frames = 0;
+  m_in_motion = false;
+  LOGD("grid %ux%u, subsample %u, threshold %u, min cells %u",
+       config.grid_columns, config.grid_rows, config.subsample,
+       config.cell_threshold, config.min_cells);
+
+  return 0;
+}
+
+void MotionDetector::reset() {
+  std::lock_guard<std::mutex> lock(m_lock);
+  m_reference.clear();
+  m_motion_frames = 0;
+  m_in_motion = false;
+}
+
+//------------------------------------------------------------------------------
+// Analysis
+//------------------------------------------------------------------------------
+int MotionDetector::process(uint32_t frame_type, const uint8_t *frame,
+                            size_t len, uint32_t width, uint32_t height,
+                            int64_t time_us, MotionResult &result) {
+  result = MotionResult{};
+  std::lock_guard<std::mutex> lock(m_lock);
+  result.motion = m_in_motion;
+  if (!m_reference.empty() &&
+      time_us - m_last_time_us < (int64_t)m_config.interval_ms * 1000) {
+    return -EAGAIN;
+  }
+  const int err = extractLuma(frame_type, frame, len, width, height);
+  if (err) {
+    return err;
+  }
+  m_last_time_us = time_us;
+
+  const bool comparable = !m_reference.empty() &&
+                          frame_type == m_reference_type &&
+                          width == m_reference_width &&
+                          height == m_reference_height;
+  if (comparable) {
+    compare(result);
+  }
+  // Another format (e.g. RGBX from the recording thread instead of the
+  // camera's format) or size only becomes the reference
+  m_luma.swap(m_reference);
+  m_reference_type = frame_type;
+  m_reference_width = width;
+  m_reference_height = height;
+  if (!comparable) {
+    return -EAGAIN;
+  }
+
+  const bool moving = result.changed_cells >= m_config.min_cells;
+  if (moving) {
+    m_last_motion_us = time_us;
+  }
+  if (!m_in_motion) {
+    m_motion_frames = moving ? m_motion_frames + 1 : 0;
+    if (m_motion_frames >= m_config.trigger_frames) {
+      m_in_motion = true;
+      result.changed = true;
+    }
+  } else if (!moving &&
+             time_us - m_last_motion_us >= (int64_t)m_config.hold_ms * 1000) {
+    m_in_motion = false;
+    m_motion_frames = 0;
+    result.changed = true;
+  }
+  result.motion = m_in_motion;
+  if (result.changed) {
+    LOGD("motion %d, cells %u, peak %u", result.motion, result.changed_cells,
+         result.peak);
+  }
+
+  return 0;
+}
+
+/*private*/
+int MotionDetector::extractLuma(uint32_t frame_type, const uint8_t *frame,
+                                size_t len, uint32_t width, uint32_t height) {
+  const uint32_t step = m_config.subsample;
+  if (!frame || !len || !width || !height) {
+    return -EINVAL;
+  }
+  if (frame_type == RAW_FRAME_MJPEG) {
+    uint32_t w = 0, h = 0;
+    if (m_decoder.decodeLuma(frame, len, step, m_luma, w, h)) {
+      return -ENODATA;
+    }
+    m_luma_width = w;
+    m_luma_height = h;
+    return 0;
+  }
+
+  const size_t bytes = rawFrameBytes(frame_type, width, height);
+  if (!bytes) {
+    return -ENOTSUP;
+  }
+  if (len < bytes) {
+    return -EINVAL;
+  }
+  // Same size as the scaled IDCT, ceil(size / step)
+  const uint32_t w = (width + step - 1) / step;
+  const uint32_t h = (height + step - 1) / step;
+  if (m_luma.size() < (size_t)w * h) {
+    m_luma.resize((size_t)w * h);
+  }
+  uint8_t *dst = m_luma.data();
+  for (uint32_t y = 0; y < h; y++) {
+    const size_t row = (size_t)y * step * width;
+    switch (frame_type) {
+    case RAW_FRAME_UNCOMPRESSED_YUYV: {
+      const uint8_t *src = frame + row * 2;
+      for (uint32_t x = 0; x < w; x++) {
+        *dst++ = src[(size_t)x * step * 2];
+      }
+      break;
+    }
+    case RAW_FRAME_UNCOMPRESSED_NV12:
+    case RAW_FRAME_UNCOMPRESSED_NV21: {
+      const uint8_t *src = frame + row;
+      for (uint32_t x = 0; x < w; x++) {
+        *dst++ = src[(size_t)x * step];
+      }
+      break;
+    }
+    case RAW_FRAME_UNCOMPRESSED_RGBX: {
+      // Full range BT.601 like the Y of a JPEG
+      const uint8_t *src = frame + row * 4;
+      for (uint32_t x = 0; x < w; x++) {
+        const uint8_t *p = src + (size_t)x * step * 4;
+        *dst++ = (uint8_t)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+      }
+      break;
+    }
+    default:
+      return -ENOTSUP;
+    }
+  }
+  m_luma_width = w;
+  m_luma_height = h;
+
+  return 0;
+}
+
+/*private*/
+void MotionDetector::compare(MotionResult &result) const {
+  const uint32_t columns = m_config.grid_columns;
+  const uint32_t rows = m_config.grid_rows;
+  const uint32_t stride = m_luma_width;
+  for (uint32_t r = 0; r < rows; r++) {
+    const uint32_t y0 = r * m_luma_height / rows;
+    const uint32_t y1 = (r + 1) * m_luma_height / rows;
+    for (uint32_t c = 0; c < columns; c++) {
+      if (!m_config.mask.empty() && !m_config.mask[r * columns + c]) {
+        continue;
+      }
+      const uint32_t x0 = c * m_luma_width / columns;
+      const uint32_t x1 = (c + 1) * m_luma_width / columns;
+      const uint64_t pixels = (uint64_t)(x1 - x0) * (y1 - y0);
+      if (!pixels) {
+        continue;
+      }
+      uint64_t sad = 0;
+      for (uint32_t y = y0; y < y1; y++) {
+        const size_t offset = (size_t)y * stride + x0;
+        sad += sadRow(&m_luma[offset], &m_reference[offset], x1 - x0);
+      }
+      const uint32_t mean = (uint32_t)(sad / pixels);
+      result.peak = std::max(result.peak, mean);
+      if (mean >= m_config.cell_threshold) {
+        result.changed_cells++;
+      }
+    }
+  }
+}
+
+} // namespace serenegiant::flutter
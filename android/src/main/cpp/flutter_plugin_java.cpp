@@ -32,6 +32,8 @@
 #undef NDEBUG
 #endif
 
+// 標準ライブラリ
+#include <cerrno>
 // android
 #include <android/native_window.h>
 #include <android/native_window_jni.h>
@@ -43,6 +45,7 @@
 #include "flutter_utils.h"
 #include "flutter_uvc_holder.h"
 #include "flutter_plugin_java.h"
+#include "flutter_video_size.h"
 
 namespace serenegiant::flutter
 {
@@ -54,7 +57,8 @@ namespace serenegiant::flutter
 	FlutterPluginJava::FlutterPluginJava(jobject plugin_java)
 		: plugin_java(plugin_java),
 		  m_manager(nullptr),
-		  holders()
+		  holders(),
+		  m_prewarm_on_attach(false)
 	{
 		ENTER();
 
@@ -171,228 +175,960 @@ namespace serenegiant::flutter
 			auto holder = get_holder_locked(device_id, true);
 			if (holder)
 			{
+				// 対応解像度一覧等の取得はワーカースレッドで行うので
+				// 他のUVC機器へのアクセスをブロックしない
+				holder->prepare_async([](const int32_t &id, const int &r)
+				{
+					send_on_capabilities_ready(id, r);
+				});
+				if (m_prewarm_on_attach)
+				{
+					holder->prewarm_async();
+				}
+				result = 0;
+			}
+		}
+		if (!result)
+		{
+			result = send_on_device_changed(device_id, true);
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * UVC機器が取り外されたときの処理
+	 * @param device_id
+	 */
+	/*private*/
+	void FlutterPluginJava::remove(const int32_t &device_id)
+	{
+		ENTER();
+
+		FlutterUVCHolderSp removed;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			auto iter = holders.find(device_id);
+			if (iter != holders.end())
+			{
+				removed = iter->second;
+				holders.erase(device_id);
+			}
+		}
+		if (removed)
+		{
+			LOGD("remove %d", id);
+			removed->stop();
+			send_on_device_changed(device_id, false);
+			LOGD("remove: finished");
+		}
+
+		EXIT();
+	}
+
+	/**
+	 * 指定したIDに対応するUVC機器が接続されていて利用可能かどうか
+	 * @param device_id
+	 * @return
+	 */
+	bool FlutterPluginJava::is_available(const int32_t &device_id)
+	{
+		ENTER();
+
+		FlutterUVCHolderSp holder = nullptr;
+		if (m_lock.try_lock())
+		{
+			holder = get_holder_locked(device_id, false);
+			m_lock.unlock();
+		}
+
+		RETURN(holder != nullptr, bool);
+	}
+
+	/**
+	 * UVC機器との接続状態を取得する
+	 * @param device_id
+	 * @return
+	 */
+	device_state FlutterPluginJava::get_device_state(const int32_t &device_id)
+	{
+		ENTER();
+
+		device_state result = DISCONNECTED;
+		FlutterUVCHolderSp holder = nullptr;
+		if (m_lock.try_lock())
+		{
+			holder = get_holder_locked(device_id, false);
+			m_lock.unlock();
+		}
+		result = holder && holder->is_running() ? STREAMING : CONNECTED;
+
+		RETURN(result, device_state);
+	}
+
+	usb_device_info_t FlutterPluginJava::get_device_info(const int32_t &device_id)
+	{
+		ENTER();
+
+		usb_device_info_t result;
+		usb_get_device_info(m_manager, device_id, &result);
+
+		RET(result);
+	}
+
+	/**
+	 * 映像取得開始
+	 * レンダーコールバックを呼び出さないと実際には描画されない
+	 * @param device_id
+	 * @return
+	 */
+	/*public*/
+	int32_t FlutterPluginJava::start(const int32_t &device_id)
+	{
+		ENTER();
+
+		int32_t result = -1;
+		FlutterUVCHolderSp holder = nullptr;
+		if (m_lock.try_lock())
+		{
+			holder = get_holder_locked(device_id, false);
+			m_lock.unlock();
+		}
+		if (holder)
+		{
+			result = holder->start();
+		}
+		else
+		{
+			LOGW("failed to get UVCHolder");
+		}
+
+		RETURN(result, int32_t);
+	}
+
+	/**
+	 * 映像取得終了
+	 * @param info
+	 * @return
+	 */
+	/*public*/
+	int32_t FlutterPluginJava::stop(const int32_t &device_id)
+	{
+		ENTER();
+
+		FlutterUVCHolderSp holder = nullptr;
+		if (m_lock.try_lock())
+		{
+			holder = get_holder_locked(device_id, false);
+			m_lock.unlock();
+		}
+		if (holder)
+		{
+			holder->stop();
+		}
+
+		RETURN(0, int32_t);
+	}
+
+	/**
+	 * UVC機器からの映像サイズの変更要求
+	 * @param info
+	 * @param width
+	 * @param height
+	 * @param fps 要求するフレームレート, 0以下なら範囲内で最大のフレームレート
+	 * @param min_fps 最小フレームレート, 0以下なら制限なし
+	 * @param max_fps 最大フレームレート, 0以下なら制限なし
+	 * @return
+	 */
+	/*private*/
+	int32_t FlutterPluginJava::set_video_size(const int32_t &device_id,
+											  const uvc_raw_frame_t &frame_type,
+											  const uint32_t &width, const uint32_t &height,
+											  const float &fps, const float &min_fps, const float &max_fps)
+	{
+
+		ENTER();
+
+		LOGV("id=%d,type=%d,sz(%dx%d),fps=%f(%f-%f)", device_id, frame_type, width, height, fps, min_fps, max_fps);
+		int result = -1;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		// 映像サイズの変更は対応解像度一覧の取得完了を待つことがあるので
+		// m_lockを保持したまま呼び出さない
+		if (holder)
+		{
+			result = holder->set_video_size(frame_type, width, height, fps, min_fps, max_fps);
+		}
+		else
+		{
+			LOGW("UVCHolder not found, already detached?");
+		}
+
+		RETURN(result, int32_t);
+	}
+
+	/**
+	 * 現在の映像サイズ設定を取得
+	 * @param device_id
+	 * @param data 映像サイズ設定を書き込むためのflutter_video_size_t構造体へのポインタ
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterPluginJava::get_current_size(
+		const int &device_id,
+		flutter_video_size_t *data)
+	{
+
+		ENTER();
+
+		int result = -1;
+		if (LIKELY(data))
+		{
+			FlutterUVCHolderSp holder = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+				holder = get_holder_locked(device_id, false);
+			}
+			if (holder)
+			{
+				copy_video_size(holder->get_current_size(), *data);
 				result = 0;
 			}
+			else
+			{
+				LOGW("UVCHolder not found, already detached?");
+			}
+		}
+
+		RETURN(result, int32_t);
+	}
+
+	/**
+	 * set_video_sizeで選択したフレームレートを取得
+	 * @param device_id
+	 * @return フレームレート, 未選択/エラー時は0
+	 */
+	float FlutterPluginJava::get_current_fps(const int32_t &device_id)
+	{
+		ENTER();
+
+		float result = 0.0f;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			result = holder->get_current_fps();
+		}
+
+		RET(result);
+	}
+
+	/**
+	 * uvc_get_frameで受け取った映像フレームのファイルへの記録を開始する
+	 * @param device_id
+	 * @param path 記録ファイルのパス, 既存のファイルは上書きする
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterPluginJava::start_frame_capture(const int32_t &device_id, const std::string &path)
+	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			result = holder->start_capture(path);
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 映像フレームの記録を終了する
+	 * @param device_id
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterPluginJava::stop_frame_capture(const int32_t &device_id)
+	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			result = holder->stop_capture();
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 映像の消費者を登録する
+	 * @param device_id
+	 * @param type
+	 * @return 0以上: 登録後のその種類の消費者の数, 負: エラーコード
+	 */
+	int FlutterPluginJava::acquire_consumer(const int32_t &device_id, const consumer_type_t &type)
+	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			result = holder->acquire_consumer(type);
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * acquire_consumerで登録した映像の消費者を解除する
+	 * @param device_id
+	 * @param type
+	 * @return 0以上: 解除後のその種類の消費者の数, 負: エラーコード
+	 */
+	int FlutterPluginJava::release_consumer(const int32_t &device_id, const consumer_type_t &type)
+	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			result = holder->release_consumer(type);
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 消費者がいなくなってから映像取得を一時停止するまでの猶予時間をセットする
+	 * @param device_id
+	 * @param timeout_ms 猶予時間[ミリ秒], 負なら一時停止しない
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterPluginJava::set_idle_timeout(const int32_t &device_id, const int64_t &timeout_ms)
+	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			holder->set_idle_timeout(timeout_ms);
+			result = 0;
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * ヘッドレスモードを切り替える
+	 * @param device_id
+	 * @param headless
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterPluginJava::set_headless(const int32_t &device_id, const bool &headless)
+	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			result = holder->set_headless(headless);
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 最後に映像取得中に映像サイズを変更した時に映像取得を再開するまでに掛かった時間を取得
+	 * @param device_id
+	 * @param latency_ns 切り替え時間[ナノ秒], 映像取得中に変更していなければ0
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterPluginJava::get_switch_latency(const int32_t &device_id, int64_t &latency_ns)
+	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			latency_ns = holder->get_switch_latency_ns();
+			result = 0;
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * UVC機器が接続された時に映像取得開始後の最初のフレームまでの処理を前もって行うかどうかをセットする
+	 * trueにした時に既に接続されているUVC機器も事前準備する
+	 * @param prewarm
+	 */
+	void FlutterPluginJava::set_prewarm_on_attach(const bool &prewarm)
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_prewarm_on_attach = prewarm;
+		if (prewarm)
+		{
+			for (const auto &iter : holders)
+			{
+				if (iter.second && !iter.second->is_running())
+				{
+					iter.second->prewarm_async();
+				}
+			}
+		}
+
+		EXIT();
+	}
+
+	/**
+	 * 映像取得を開始してから最初のフレームを受け取るまでに掛かった時間を取得
+	 * @param device_id
+	 * @param time_ns 時間[ナノ秒], 最初のフレームを受け取っていなければ0
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterPluginJava::get_time_to_first_frame(const int32_t &device_id, int64_t &time_ns)
+	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			time_ns = holder->get_time_to_first_frame_ns();
+			result = 0;
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * クロックモデルの推定結果と到着時刻の揺らぎを取得
+	 * @param device_id
+	 * @param stats
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterPluginJava::get_clock_stats(const int32_t &device_id, clock_stats_t &stats)
+	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			holder->get_clock_stats(stats);
+			result = 0;
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 撮影からパイプラインの段階へフレームが届くまでの遅延の測定を有効/無効にする
+	 * @param device_id
+	 * @param enabled
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterPluginJava::set_latency_probe(const int32_t &device_id, const bool &enabled)
+	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			holder->set_latency_probe(enabled);
+			result = 0;
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 映像の一部だけを録画する
+	 * @param device_id
+	 * @param crop 録画する範囲(映像の画素単位), 空なら映像全体
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterPluginJava::set_recording_crop(const int32_t &device_id, const FrameRect &crop)
+	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
 		}
-		if (!result)
+		if (holder)
 		{
-			result = send_on_device_changed(device_id, true);
+			holder->set_recording_crop(crop);
+			result = 0;
 		}
 
 		RETURN(result, int);
 	}
 
 	/**
-	 * UVC機器が取り外されたときの処理
+	 * 録画する映像を回転/反転する
 	 * @param device_id
+	 * @param orientation 時計回りの回転角度(0/90/180/270)と左右/上下反転
+	 * @return 0: 成功, 負: エラーコード
 	 */
-	/*private*/
-	void FlutterPluginJava::remove(const int32_t &device_id)
+	int FlutterPluginJava::set_recording_orientation(const int32_t &device_id, const FrameOrientation &orientation)
 	{
 		ENTER();
 
-		FlutterUVCHolderSp removed;
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
 		{
 			std::lock_guard<std::mutex> lock(m_lock);
-			auto iter = holders.find(device_id);
-			if (iter != holders.end())
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			result = holder->set_recording_orientation(orientation);
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 次のフレームを静止画(JPEG)としてワーカースレッドで撮影する
+	 * 完了すると"on_still_captured"イベントをDartへ送信する
+	 * @param device_id
+	 * @param path 書き込み先のファイルパス, 空ならJPEGデータをイベントで送る
+	 * @return 0: 撮影を開始した, 負: エラーコード
+	 */
+	int FlutterPluginJava::capture_still(const int32_t &device_id, const std::string &path)
+	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			result = holder->capture_still(path,
+				[](const int32_t &id, const int &r, std::vector<uint8_t> &&jpeg)
 			{
-				removed = iter->second;
-				holders.erase(device_id);
-			}
+				send_on_still_captured(id, r, std::move(jpeg));
+			});
 		}
-		if (removed)
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 連続したフレームをワーカースレッドで撮影する
+	 * 完了すると"on_burst_captured"イベントをDartへ送信する
+	 * @param device_id
+	 * @param count 撮影するフレーム数
+	 * @param encode trueならJPEGへ圧縮する
+	 * @return 0: 撮影を開始した, 負: エラーコード
+	 */
+	int FlutterPluginJava::capture_burst(const int32_t &device_id, const uint32_t &count, const bool &encode)
+	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
 		{
-			LOGD("remove %d", id);
-			removed->stop();
-			send_on_device_changed(device_id, false);
-			LOGD("remove: finished");
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			result = holder->capture_burst(count, encode,
+				[](const int32_t &id, const int &r, std::shared_ptr<FrameBurst> burst)
+			{
+				send_on_burst_captured(id, r, std::move(burst));
+			});
 		}
 
-		EXIT();
+		RETURN(result, int);
 	}
 
 	/**
-	 * 指定したIDに対応するUVC機器が接続されていて利用可能かどうか
+	 * 動き検出を開始/停止する
+	 * 動きの有無が切り替わると"on_motion"イベントをDartへ送信する
 	 * @param device_id
-	 * @return
+	 * @param enabled
+	 * @param config 動き検出の設定, 停止時は使わない
+	 * @return 0: 成功, 負: エラーコード
 	 */
-	bool FlutterPluginJava::is_available(const int32_t &device_id)
+	int FlutterPluginJava::set_motion_detection(const int32_t &device_id, const bool &enabled, const MotionConfig &config)
 	{
 		ENTER();
 
+		int result = -ENODEV;
 		FlutterUVCHolderSp holder = nullptr;
-		if (m_lock.try_lock())
 		{
+			std::lock_guard<std::mutex> lock(m_lock);
 			holder = get_holder_locked(device_id, false);
-			m_lock.unlock();
+		}
+		if (holder)
+		{
+			result = holder->set_motion_detection(enabled, config,
+				[](const int32_t &id, const MotionResult &r, const int64_t &pts_us)
+			{
+				send_on_motion(id, r.motion, r.changed_cells, r.peak, pts_us);
+			});
 		}
 
-		RETURN(holder != nullptr, bool);
+		RETURN(result, int);
 	}
 
 	/**
-	 * UVC機器との接続状態を取得する
+	 * 前のフレームと同じフレームを録画用Surfaceへ書き込まないようにする
 	 * @param device_id
-	 * @return
+	 * @param enabled
+	 * @param sample_rows 比較する行の間隔, 1なら全ての行
+	 * @return 0: 成功, 負: エラーコード
 	 */
-	device_state FlutterPluginJava::get_device_state(const int32_t &device_id)
+	int FlutterPluginJava::set_frame_dedup(const int32_t &device_id, const bool &enabled, const uint32_t &sample_rows)
 	{
 		ENTER();
 
-		device_state result = DISCONNECTED;
+		int result = -ENODEV;
 		FlutterUVCHolderSp holder = nullptr;
-		if (m_lock.try_lock())
 		{
+			std::lock_guard<std::mutex> lock(m_lock);
 			holder = get_holder_locked(device_id, false);
-			m_lock.unlock();
 		}
-		result = holder && holder->is_running() ? STREAMING : CONNECTED;
+		if (holder)
+		{
+			result = holder->set_frame_dedup(enabled, sample_rows);
+		}
 
-		RETURN(result, device_state);
+		RETURN(result, int);
 	}
 
-	usb_device_info_t FlutterPluginJava::get_device_info(const int32_t &device_id)
+	/**
+	 * 重複フレームの検出の統計情報を取得
+	 * @param device_id
+	 * @param stats
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterPluginJava::get_dedup_stats(const int32_t &device_id, DedupStats &stats)
 	{
 		ENTER();
 
-		usb_device_info_t result;
-		usb_get_device_info(m_manager, device_id, &result);
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			holder->get_dedup_stats(stats);
+			result = 0;
+		}
 
-		RET(result);
+		RETURN(result, int);
 	}
 
 	/**
-	 * 映像取得開始
-	 * レンダーコールバックを呼び出さないと実際には描画されない
+	 * 録画用Surfaceへ書き込まなかった間にエンコーダーが前のフレームを繰り返すべきかどうか
 	 * @param device_id
 	 * @return
 	 */
-	/*public*/
-	int32_t FlutterPluginJava::start(const int32_t &device_id)
+	bool FlutterPluginJava::repeats_frames(const int32_t &device_id)
 	{
 		ENTER();
 
-		int32_t result = -1;
 		FlutterUVCHolderSp holder = nullptr;
-		if (m_lock.try_lock())
 		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+
+		const bool result = holder && holder->repeats_frames();
+
+		RETURN(result, bool);
+	}
+
+	/**
+	 * エンコーダーの処理待ちや書き込みの停滞に合わせてビットレートとフレームレートを下げる
+	 * @param device_id
+	 * @param enabled
+	 * @param config
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterPluginJava::set_rate_control(const int32_t &device_id, const bool &enabled, const RateControlConfig &config)
+	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
 			holder = get_holder_locked(device_id, false);
-			m_lock.unlock();
 		}
 		if (holder)
 		{
-			result = holder->start();
+			result = holder->set_rate_control(enabled, config);
 		}
-		else
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * エンコーダーの録画開始からの累計を報告する
+	 * @param device_id
+	 * @param encoded_frames エンコードしたフレーム数
+	 * @param output_bytes エンコードしたバイト数
+	 * @param stall_us 書き込みが停滞した時間[マイクロ秒]
+	 * @param bitrate エンコーダーの現在のビットレート
+	 * @return 正: エンコーダーに設定するビットレート, 0: 変更なし, 負: エラーコード
+	 */
+	int FlutterPluginJava::report_encoder_stats(const int32_t &device_id,
+		const uint64_t &encoded_frames, const uint64_t &output_bytes,
+		const uint64_t &stall_us, const uint32_t &bitrate)
+	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
 		{
-			LOGW("failed to get UVCHolder");
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			result = (int)holder->report_encoder_stats(encoded_frames, output_bytes, stall_us, bitrate);
 		}
 
-		RETURN(result, int32_t);
+		RETURN(result, int);
 	}
 
 	/**
-	 * 映像取得終了
-	 * @param info
-	 * @return
+	 * ビットレート/フレームレート制御の集計結果を取得
+	 * @param device_id
+	 * @param stats
+	 * @return 0: 成功, 負: エラーコード
 	 */
-	/*public*/
-	int32_t FlutterPluginJava::stop(const int32_t &device_id)
+	int FlutterPluginJava::get_rate_control_stats(const int32_t &device_id, RateControlStats &stats)
 	{
 		ENTER();
 
+		int result = -ENODEV;
 		FlutterUVCHolderSp holder = nullptr;
-		if (m_lock.try_lock())
 		{
+			std::lock_guard<std::mutex> lock(m_lock);
 			holder = get_holder_locked(device_id, false);
-			m_lock.unlock();
 		}
 		if (holder)
 		{
-			holder->stop();
+			holder->get_rate_control_stats(stats);
+			result = 0;
 		}
 
-		RETURN(0, int32_t);
+		RETURN(result, int);
 	}
 
 	/**
-	 * UVC機器からの映像サイズの変更要求
-	 * @param info
-	 * @param width
-	 * @param height
-	 * @return
+	 * 最近のビットレート/フレームレートの変更を古い順に取得
+	 * @param device_id
+	 * @param decisions
+	 * @return 0: 成功, 負: エラーコード
 	 */
-	/*private*/
-	int32_t FlutterPluginJava::set_video_size(const int32_t &device_id,
-											  const uvc_raw_frame_t &frame_type,
-											  const uint32_t &width, const uint32_t &height)
+	int FlutterPluginJava::get_rate_decisions(const int32_t &device_id, std::vector<RateDecision> &decisions)
 	{
+		ENTER();
+
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			holder->get_rate_decisions(decisions);
+			result = 0;
+		}
+
+		RETURN(result, int);
+	}
 
+	/**
+	 * 撮影からパイプラインの段階へフレームが届くまでの遅延の集計結果を取得
+	 * @param device_id
+	 * @param stats 段階(latency_stage_t)毎の集計結果
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterPluginJava::get_latency_stats(const int32_t &device_id, std::vector<latency_stats_t> &stats)
+	{
 		ENTER();
 
-		LOGV("id=%d,type=%d,sz(%dx%d)", device_id, frame_type, width, height);
-		int result = -1;
-		std::lock_guard<std::mutex> lock(m_lock);
-		auto iter = holders.find(device_id);
-		if (iter != holders.end())
+		int result = -ENODEV;
+		FlutterUVCHolderSp holder = nullptr;
 		{
-			FlutterUVCHolderSp holder = iter->second;
-			if (holder)
-			{
-				result = holder->set_video_size(frame_type, width, height);
-			}
-			else
+			std::lock_guard<std::mutex> lock(m_lock);
+			holder = get_holder_locked(device_id, false);
+		}
+		if (holder)
+		{
+			stats.resize(LATENCY_STAGE_NUM);
+			for (int stage = 0; stage < LATENCY_STAGE_NUM; stage++)
 			{
-				LOGW("Failed to get UVCHolder");
+				holder->get_latency_stats((latency_stage_t)stage, stats[stage]);
 			}
+			result = 0;
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 対応解像度一覧/UVCコントロール一覧の取得が完了しているかどうか
+	 * @param device_id
+	 * @return 1: 取得完了, 0: 取得中, 負: エラーコード
+	 */
+	int32_t FlutterPluginJava::is_capabilities_ready(const int32_t &device_id)
+	{
+		ENTER();
+
+		int32_t result = -1;
+		FlutterUVCHolderSp holder = nullptr;
+		if (m_lock.try_lock())
+		{
+			holder = get_holder_locked(device_id, false);
+			m_lock.unlock();
+		}
+		if (holder)
+		{
+			result = holder->is_ready() ? 1 : 0;
 		}
 		else
 		{
-			LOGW("UVCHolder not found, already detached?");
+			LOGD("FlutterUVCHolder not found! id=%d", device_id);
 		}
 
 		RETURN(result, int32_t);
 	}
 
 	/**
-	 * 現在の映像サイズ設定を取得
-	 * @param device_id
-	 * @param data 映像サイズ設定を書き込むためのflutter_video_size_t構造体へのポインタ
+	 * 接続中の複数のUVC機器がUSBの帯域内に収まるように映像設定を計画する
+	 * 対応解像度一覧の取得完了を待つことがあるのでUIスレッドから呼ばないこと
+	 * @param requirements UVC機器毎の要求
+	 * @param bus_bandwidth USBバスの帯域[バイト/秒], 0ならUSB2.0の周期転送の帯域
+	 * @param apply trueなら計画した映像設定をset_video_sizeで適用する
+	 * @param result 計画した映像設定を受け取るvector, requirementsと同じ順
 	 * @return 0: 成功, 負: エラーコード
 	 */
-	int FlutterPluginJava::get_current_size(
-		const int &device_id,
-		uvc_video_size_t *data)
+	int FlutterPluginJava::plan_video_sizes(
+		const std::vector<bandwidth_requirement_t> &requirements,
+		const uint64_t &bus_bandwidth, const bool &apply,
+		std::vector<bandwidth_assignment_t> &result)
 	{
-
 		ENTER();
 
-		int result = -1;
-		if (LIKELY(data))
+		result.clear();
+		std::vector<FlutterUVCHolderSp> targets;
 		{
 			std::lock_guard<std::mutex> lock(m_lock);
-			auto iter = holders.find(device_id);
-			if (iter != holders.end())
+			for (const auto &requirement: requirements)
 			{
-				auto &holder = iter->second;
-				if (holder)
-				{
-					*data = holder->get_current_size();
-					result = 0;
-				}
-				else
+				auto holder = get_holder_locked(requirement.device_id, false);
+				if (UNLIKELY(!holder))
 				{
-					LOGW("Failed to get UVCHolder");
+					LOGW("UVCHolder not found, already detached?id=%d", requirement.device_id);
+					RETURN(-ENODEV, int);
 				}
+				targets.push_back(holder);
 			}
-			else
+		}
+		// 対応解像度一覧の取得完了を待つことがあるのでm_lockを保持したまま呼び出さない
+		BandwidthPlanner planner(bus_bandwidth ? bus_bandwidth : BANDWIDTH_USB2_BUS);
+		for (size_t i = 0; i < requirements.size(); i++)
+		{
+			auto r = planner.add_device(requirements[i], targets[i]->supported_size());
+			if (UNLIKELY(r))
 			{
-				LOGW("UVCHolder not found, already detached?");
+				RETURN(r, int);
+			}
+		}
+		auto r = planner.plan(result);
+		if (!r && apply)
+		{
+			for (size_t i = 0; i < result.size(); i++)
+			{
+				const auto &assignment = result[i];
+				LOGD("apply id=%d,type=0x%08x,%dx%d,interval=%d",
+					assignment.device_id, assignment.frame_type,
+					assignment.width, assignment.height, assignment.frame_interval);
+				const auto fps = interval_to_fps(assignment.frame_interval);
+				r = targets[i]->set_video_size(
+					(uvc_raw_frame_t)assignment.frame_type,
+					assignment.width, assignment.height, fps);
+				if (UNLIKELY(r))
+				{
+					LOGW("failed to apply video size,id=%d,err=%d", assignment.device_id, r);
+					break;
+				}
 			}
 		}
 
-		RETURN(result, int32_t);
+		RETURN(r, int);
 	}
 
 	/**
@@ -634,7 +1370,7 @@ namespace serenegiant::flutter
 	int FlutterPluginJava::get_supported_size(
 		const int &device_id,
 		const int32_t &index, int32_t *num_supported,
-		uvc_video_size_t *data)
+		flutter_video_size_t *data)
 	{
 
 		ENTER();
@@ -648,7 +1384,12 @@ namespace serenegiant::flutter
 		}
 		if (holder)
 		{
-			result = holder->get_supported_size(index, num_supported, data);
+			uvc_video_size_t size;
+			result = holder->get_supported_size(index, num_supported, data ? &size : nullptr);
+			if (!result && data)
+			{
+				copy_video_size(size, *data);
+			}
 		}
 		else
 		{
@@ -32,6 +32,10 @@
 #undef NDEBUG
 #endif
 
+// 標準ライブラリ
+#include <algorithm>
+#include <cstring>
+#include <vector>
 // android
 #include <android/native_window.h>
 #include <android/native_window_jni.h>
@@ -44,6 +48,8 @@
 // flutter
 #include "flutter_plugin.h"
 #include "flutter_plugin_java.h"
+#include "flutter_thread_policy.h"
+#include "flutter_video_size.h"
 
 // Java側オブジェクトのFQCN
 #define FQCN_JAVA_PLUGIN "com/serenegiant/flutter/uvcplugin/UVCManager"
@@ -141,8 +147,40 @@ int set_video_size(const int32_t device_id, const uint32_t type,
   RETURN(result, int);
 }
 
+/**
+ * 映像サイズとフレームレートを設定する
+ * @param device_id
+ * @param type
+ * @param width
+ * @param height
+ * @param fps 要求するフレームレート, 0以下なら範囲内で最大のフレームレート
+ * @param min_fps 最小フレームレート, 0以下なら制限なし
+ * @param max_fps 最大フレームレート, 0以下なら制限なし
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int set_video_size_fps(const int32_t device_id, const uint32_t type,
+                       const uint32_t width, const uint32_t height,
+                       const float fps, const float min_fps,
+                       const float max_fps)
+{
+
+  ENTER();
+
+  LOGV("id=%d", device_id);
+  int result = -1;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->set_video_size(device_id, (uvc_raw_frame_t)type, width,
+                                        height, fps, min_fps, max_fps);
+  }
+
+  RETURN(result, int);
+}
+
 DART_EXPORT
-int get_current_size(int32_t device_id, uvc_video_size_t *data)
+int get_current_size(int32_t device_id, flutter_video_size_t *data)
 {
 
   ENTER();
@@ -158,6 +196,757 @@ int get_current_size(int32_t device_id, uvc_video_size_t *data)
   RETURN(result, int);
 }
 
+/**
+ * 現在選択されているフレームレートを取得する
+ * @param device_id
+ * @return フレームレート, 未選択/エラー時は0
+ */
+DART_EXPORT
+float get_current_fps(int32_t device_id)
+{
+
+  ENTER();
+
+  float result = 0.0f;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->get_current_fps(device_id);
+  }
+
+  RET(result);
+}
+
+/**
+ * uvc_get_frameで受け取った映像フレームのファイルへの記録を開始する
+ * 記録したファイルはFrameReplaySourceで再生できる
+ * @param device_id
+ * @param path 記録ファイルのパス, 既存のファイルは上書きする
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t start_frame_capture(int32_t device_id, const char *path)
+{
+  ENTER();
+
+  int32_t result = -EINVAL;
+  if (path)
+  {
+    std::lock_guard<std::mutex> lock(plugin_lock);
+    result = -ENODEV;
+    if (pluginJava)
+    {
+      result = pluginJava->start_frame_capture(device_id, path);
+    }
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 映像フレームの記録を終了する
+ * @param device_id
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t stop_frame_capture(int32_t device_id)
+{
+  ENTER();
+
+  int32_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->stop_frame_capture(device_id);
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 映像の消費者を登録する
+ * @param device_id
+ * @param type 0: プレビュー, 1: 録画, 2: 映像解析
+ * @return 0以上: 登録後のその種類の消費者の数, 負: エラーコード
+ */
+DART_EXPORT
+int32_t acquire_consumer(int32_t device_id, int32_t type)
+{
+  ENTER();
+
+  int32_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->acquire_consumer(device_id, (plugin::consumer_type_t)type);
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * acquire_consumerで登録した映像の消費者を解除する
+ * @param device_id
+ * @param type 0: プレビュー, 1: 録画, 2: 映像解析
+ * @return 0以上: 解除後のその種類の消費者の数, 負: エラーコード
+ */
+DART_EXPORT
+int32_t release_consumer(int32_t device_id, int32_t type)
+{
+  ENTER();
+
+  int32_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->release_consumer(device_id, (plugin::consumer_type_t)type);
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 消費者がいなくなってから映像取得を一時停止するまでの猶予時間をセットする
+ * @param device_id
+ * @param timeout_ms 猶予時間[ミリ秒], 負なら一時停止しない
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t set_idle_timeout(int32_t device_id, int32_t timeout_ms)
+{
+  ENTER();
+
+  int32_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->set_idle_timeout(device_id, timeout_ms);
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * ヘッドレスモードを切り替える
+ * @param device_id
+ * @param headless 0: 解除, 0以外: ヘッドレスモード
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t set_headless(int32_t device_id, int32_t headless)
+{
+  ENTER();
+
+  int32_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->set_headless(device_id, headless != 0);
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 最後に映像取得中に映像サイズを変更した時に映像取得を再開するまでに掛かった時間を取得
+ * @param device_id
+ * @return 0以上: 切り替え時間[マイクロ秒](映像取得中に変更していなければ0), 負: エラーコード
+ */
+DART_EXPORT
+int64_t get_switch_latency_us(int32_t device_id)
+{
+  ENTER();
+
+  int64_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    int64_t latency_ns = 0;
+    const auto r = pluginJava->get_switch_latency(device_id, latency_ns);
+    result = r ? r : latency_ns / 1000;
+  }
+
+  RETURN(result, int64_t);
+}
+
+/**
+ * UVC機器が接続された時に映像取得開始後の最初のフレームまでの処理を前もって行うかどうかをセットする
+ * @param enabled 0: 事前準備しない(デフォルト), 0以外: 事前準備する
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t set_prewarm_on_attach(int32_t enabled)
+{
+  ENTER();
+
+  int32_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    pluginJava->set_prewarm_on_attach(enabled != 0);
+    result = 0;
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 映像取得を開始してから最初のフレームを受け取るまでに掛かった時間を取得
+ * @param device_id
+ * @return 0以上: 時間[マイクロ秒](最初のフレームを受け取っていなければ0), 負: エラーコード
+ */
+DART_EXPORT
+int64_t get_time_to_first_frame_us(int32_t device_id)
+{
+  ENTER();
+
+  int64_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    int64_t time_ns = 0;
+    const auto r = pluginJava->get_time_to_first_frame(device_id, time_ns);
+    result = r ? r : time_ns / 1000;
+  }
+
+  RETURN(result, int64_t);
+}
+
+/**
+ * 映像処理スレッドのスレッドポリシーをセットする
+ * @param device_id UVC機器の識別子, -1ならタスクプールのワーカースレッド
+ * @param policy
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t set_thread_policy(int32_t device_id,
+                          const flutter_thread_policy_t *policy)
+{
+  ENTER();
+
+  int32_t result = -EINVAL;
+  if (policy)
+  {
+    const plugin::thread_policy_t p = {policy->cpu_mask, policy->nice,
+                                       policy->rt_priority};
+    result = plugin::set_thread_policy(device_id, p);
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 実行中の映像処理スレッドの統計情報を取得する
+ * @param device_id UVC機器の識別子, -1ならタスクプールのワーカースレッド
+ * @param stats_out
+ * @param max_stats stats_outの要素数
+ * @return 0以上: 書き込んだ統計情報の数, 負: エラーコード
+ */
+DART_EXPORT
+int32_t get_thread_stats(int32_t device_id, flutter_thread_stats_t *stats_out,
+                         int32_t max_stats)
+{
+  ENTER();
+
+  int32_t result = -EINVAL;
+  if (stats_out && (max_stats >= 0))
+  {
+    std::vector<plugin::thread_stats_t> stats;
+    plugin::get_thread_stats(device_id, stats);
+    result = std::min((int32_t)stats.size(), max_stats);
+    for (int32_t i = 0; i < result; i++)
+    {
+      const auto &s = stats[i];
+      auto &out = stats_out[i];
+      memset(out.name, 0, sizeof(out.name));
+      memcpy(out.name, s.name, std::min(sizeof(out.name), sizeof(s.name)));
+      out.device_id = s.device_id;
+      out.tid = s.tid;
+      out.cpu = s.cpu;
+      out.sched_policy = s.sched_policy;
+      out.policy_result = s.policy_result;
+      out.samples = s.samples;
+      out.migrations = s.migrations;
+      out.preemptions = s.preemptions;
+      out.voluntary_switches = s.voluntary_switches;
+    }
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * クロックモデルの推定結果と到着時刻の揺らぎを取得する
+ * @param device_id
+ * @param stats_out
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t get_clock_stats(int32_t device_id, flutter_clock_stats_t *stats_out)
+{
+  ENTER();
+
+  int32_t result = -EINVAL;
+  if (stats_out)
+  {
+    result = -ENODEV;
+    std::lock_guard<std::mutex> lock(plugin_lock);
+    if (pluginJava)
+    {
+      plugin::clock_stats_t stats;
+      result = pluginJava->get_clock_stats(device_id, stats);
+      if (!result)
+      {
+        stats_out->frames = stats.frames;
+        stats_out->no_pts = stats.no_pts;
+        stats_out->resets = stats.resets;
+        stats_out->samples = stats.samples;
+        stats_out->drift_ppm = stats.drift_ppm;
+        stats_out->jitter_us = stats.jitter_ns / 1000;
+        stats_out->max_jitter_us = stats.max_jitter_ns / 1000;
+        stats_out->pacing_us = stats.pacing_ns / 1000;
+      }
+    }
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 撮影からパイプラインの段階へフレームが届くまでの遅延の測定を有効/無効にする
+ * @param device_id
+ * @param enabled 0: 無効, それ以外: 有効
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t set_latency_probe(int32_t device_id, int32_t enabled)
+{
+  ENTER();
+
+  int32_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->set_latency_probe(device_id, enabled != 0);
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 映像の一部だけを録画する
+ * @param device_id
+ * @param x
+ * @param y
+ * @param width 幅か高さが0なら映像全体を録画する
+ * @param height
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t set_recording_crop(int32_t device_id, int32_t x, int32_t y, int32_t width, int32_t height)
+{
+  ENTER();
+
+  if ((x < 0) || (y < 0) || (width < 0) || (height < 0))
+  {
+    RETURN(-EINVAL, int32_t);
+  }
+  int32_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    const plugin::FrameRect crop{(uint32_t)x, (uint32_t)y, (uint32_t)width, (uint32_t)height};
+    result = pluginJava->set_recording_crop(device_id, crop);
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 録画する映像を回転/反転する
+ * @param device_id
+ * @param rotation 時計回りの回転角度, 0/90/180/270
+ * @param mirror_h 0: 左右反転しない, それ以外: 左右反転する
+ * @param mirror_v 0: 上下反転しない, それ以外: 上下反転する
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t set_recording_orientation(int32_t device_id, int32_t rotation, int32_t mirror_h, int32_t mirror_v)
+{
+  ENTER();
+
+  if (rotation < 0)
+  {
+    RETURN(-EINVAL, int32_t);
+  }
+  int32_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    const plugin::FrameOrientation orientation{(uint32_t)rotation, mirror_h != 0, mirror_v != 0};
+    result = pluginJava->set_recording_orientation(device_id, orientation);
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 次のフレームを静止画(JPEG)としてワーカースレッドで撮影する
+ * 完了すると"on_still_captured"イベントをDartへ送信する
+ * @param device_id
+ * @param path 書き込み先のファイルパス, nullptrまたは空文字列ならJPEGデータをイベントで送る
+ * @return 0: 撮影を開始した, 負: エラーコード
+ */
+DART_EXPORT
+int32_t capture_still(int32_t device_id, const char *path)
+{
+  ENTER();
+
+  int32_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->capture_still(device_id, path ? path : "");
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 連続したフレームをワーカースレッドで撮影する
+ * 完了すると"on_burst_captured"イベントをDartへ送信する
+ * @param device_id
+ * @param count 撮影するフレーム数(1〜BURST_MAX_FRAMES)
+ * @param encode 0以外ならJPEGへ圧縮する
+ * @return 0: 撮影を開始した, 負: エラーコード
+ */
+DART_EXPORT
+int32_t capture_burst(int32_t device_id, int32_t count, int32_t encode)
+{
+  ENTER();
+
+  int32_t result = -EINVAL;
+  if (count > 0)
+  {
+    result = -ENODEV;
+    std::lock_guard<std::mutex> lock(plugin_lock);
+    if (pluginJava)
+    {
+      result = pluginJava->capture_burst(device_id, count, encode != 0);
+    }
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 動き検出を開始/停止する
+ * 動きの有無が切り替わると"on_motion"イベントをDartへ送信する
+ * @param device_id
+ * @param config 動き検出の設定, nullptrなら停止する
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t set_motion_detection(int32_t device_id,
+                             const flutter_motion_config_t *config)
+{
+  ENTER();
+
+  plugin::MotionConfig c;
+  if (config)
+  {
+    if ((config->mask_cells < 0) ||
+        (config->mask_cells > FLUTTER_MOTION_MAX_CELLS))
+    {
+      RETURN(-EINVAL, int32_t);
+    }
+    // 負の値は符号無しにすると範囲外になるのでconfigureで弾かれる
+    c.grid_columns = (uint32_t)config->grid_columns;
+    c.grid_rows = (uint32_t)config->grid_rows;
+    c.subsample = (uint32_t)config->subsample;
+    c.cell_threshold = (uint32_t)config->cell_threshold;
+    c.min_cells = (uint32_t)config->min_cells;
+    c.trigger_frames = (uint32_t)config->trigger_frames;
+    c.hold_ms = (uint32_t)std::max(config->hold_ms, 0);
+    c.interval_ms = (uint32_t)std::max(config->interval_ms, 0);
+    c.gate_recording = config->gate_recording != 0;
+    c.mask.assign(config->mask, config->mask + config->mask_cells);
+  }
+  int32_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->set_motion_detection(device_id, config != nullptr, c);
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 前のフレームと同じフレームを録画用Surfaceへ書き込まないようにする
+ * @param device_id
+ * @param enabled 0: 無効, それ以外: 有効
+ * @param sample_rows 比較する行の間隔(1〜64), 1なら全ての行
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t set_frame_dedup(int32_t device_id, int32_t enabled, int32_t sample_rows)
+{
+  ENTER();
+
+  if (sample_rows <= 0)
+  {
+    RETURN(-EINVAL, int32_t);
+  }
+  int32_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->set_frame_dedup(device_id, enabled != 0,
+                                         (uint32_t)sample_rows);
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 重複フレームの検出の統計情報を取得する
+ * @param device_id
+ * @param stats_out
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t get_dedup_stats(int32_t device_id, flutter_dedup_stats_t *stats_out)
+{
+  ENTER();
+
+  int32_t result = -EINVAL;
+  if (stats_out)
+  {
+    result = -ENODEV;
+    std::lock_guard<std::mutex> lock(plugin_lock);
+    if (pluginJava)
+    {
+      plugin::DedupStats stats;
+      result = pluginJava->get_dedup_stats(device_id, stats);
+      if (!result)
+      {
+        stats_out->frames = stats.frames;
+        stats_out->duplicates = stats.duplicates;
+        stats_out->longest_run = stats.longest_run;
+        stats_out->ratio = stats.ratio();
+      }
+    }
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * エンコーダーの処理待ちや書き込みの停滞に合わせて録画のビットレートとフレームレートを下げる
+ * @param device_id
+ * @param config 制御の設定, nullptrなら停止する
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t set_rate_control(int32_t device_id,
+                         const flutter_rate_control_config_t *config)
+{
+  ENTER();
+
+  plugin::RateControlConfig c;
+  if (config)
+  {
+    if ((config->min_bitrate < 0) || (config->max_bitrate < 0) ||
+        (config->target_queue_depth < 0) || (config->interval_ms < 0))
+    {
+      RETURN(-EINVAL, int32_t);
+    }
+    // 負の値は符号無しにすると範囲外になるのでconfigureで弾かれる
+    c.min_bitrate = (uint32_t)config->min_bitrate;
+    c.max_bitrate = (uint32_t)config->max_bitrate;
+    c.target_queue_depth = (uint32_t)config->target_queue_depth;
+    c.max_queue_depth = (uint32_t)config->max_queue_depth;
+    c.max_decimation = (uint32_t)config->max_decimation;
+    c.stall_permille = (uint32_t)config->stall_permille;
+    c.interval_ms = (uint32_t)config->interval_ms;
+    c.recover_intervals = (uint32_t)config->recover_intervals;
+  }
+  int32_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->set_rate_control(device_id, config != nullptr, c);
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * ビットレート/フレームレート制御の集計結果を取得する
+ * @param device_id
+ * @param stats_out
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t get_rate_control_stats(int32_t device_id,
+                               flutter_rate_control_stats_t *stats_out)
+{
+  ENTER();
+
+  int32_t result = -EINVAL;
+  if (stats_out)
+  {
+    result = -ENODEV;
+    std::lock_guard<std::mutex> lock(plugin_lock);
+    if (pluginJava)
+    {
+      plugin::RateControlStats stats;
+      result = pluginJava->get_rate_control_stats(device_id, stats);
+      if (!result)
+      {
+        stats_out->updates = stats.updates;
+        stats_out->decisions = stats.decisions;
+        stats_out->bitrate_decreases = stats.bitrate_decreases;
+        stats_out->bitrate_increases = stats.bitrate_increases;
+        stats_out->decimation_increases = stats.decimation_increases;
+        stats_out->decimation_decreases = stats.decimation_decreases;
+        stats_out->dropped_frames = stats.dropped_frames;
+        stats_out->output_bps = stats.output_bps;
+        stats_out->bitrate = stats.bitrate;
+        stats_out->decimation = stats.decimation;
+        stats_out->queue_depth = stats.queue_depth;
+        stats_out->max_queue_depth = stats.max_queue_depth;
+        stats_out->stall_permille = stats.stall_permille;
+      }
+    }
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 最近のビットレート/フレームレートの変更を古い順に取得する
+ * @param device_id
+ * @param decisions_out
+ * @param max_decisions decisions_outの要素数
+ * @return 0以上: 書き込んだ変更の数, 負: エラーコード
+ */
+DART_EXPORT
+int32_t get_rate_decisions(int32_t device_id,
+                           flutter_rate_decision_t *decisions_out,
+                           int32_t max_decisions)
+{
+  ENTER();
+
+  int32_t result = -EINVAL;
+  if (decisions_out && (max_decisions >= 0))
+  {
+    result = -ENODEV;
+    std::lock_guard<std::mutex> lock(plugin_lock);
+    if (pluginJava)
+    {
+      std::vector<plugin::RateDecision> decisions;
+      result = pluginJava->get_rate_decisions(device_id, decisions);
+      if (!result)
+      {
+        // バッファが足りなければ新しい方を返す
+        const size_t skip =
+            decisions.size() > (size_t)max_decisions
+                ? decisions.size() - (size_t)max_decisions
+                : 0;
+        for (size_t i = skip; i < decisions.size(); i++)
+        {
+          const auto &d = decisions[i];
+          auto &out = decisions_out[result++];
+          out.time_us = d.time_us;
+          out.output_bps = d.output_bps;
+          out.reason = (uint32_t)d.reason;
+          out.old_bitrate = d.old_bitrate;
+          out.bitrate = d.bitrate;
+          out.old_decimation = d.old_decimation;
+          out.decimation = d.decimation;
+          out.queue_depth = d.queue_depth;
+          out.stall_permille = d.stall_permille;
+        }
+      }
+    }
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 撮影からパイプラインの段階へフレームが届くまでの遅延の集計結果を取得する
+ * @param device_id
+ * @param stats_out
+ * @param max_stats stats_outの要素数
+ * @return 0以上: 書き込んだ集計結果の数, 負: エラーコード
+ */
+DART_EXPORT
+int32_t get_latency_stats(int32_t device_id, flutter_latency_stats_t *stats_out,
+                          int32_t max_stats)
+{
+  ENTER();
+
+  int32_t result = -EINVAL;
+  if (stats_out && (max_stats >= 0))
+  {
+    result = -ENODEV;
+    std::lock_guard<std::mutex> lock(plugin_lock);
+    if (pluginJava)
+    {
+      std::vector<plugin::latency_stats_t> stats;
+      result = pluginJava->get_latency_stats(device_id, stats);
+      if (!result)
+      {
+        for (int32_t stage = 0;
+             (stage < (int32_t)stats.size()) && (result < max_stats); stage++)
+        {
+          const auto &s = stats[stage];
+          if (!s.count)
+          {
+            continue;
+          }
+          auto &out = stats_out[result++];
+          out.stage = stage;
+          out.count = s.count;
+          out.min_us = s.min_ns / 1000;
+          out.mean_us = s.mean_ns / 1000;
+          out.max_us = s.max_ns / 1000;
+          out.p50_us = s.p50_ns / 1000;
+          out.p95_us = s.p95_ns / 1000;
+          out.p99_us = s.p99_ns / 1000;
+          memcpy(out.histogram, s.histogram,
+                 std::min(sizeof(out.histogram), sizeof(s.histogram)));
+        }
+      }
+    }
+  }
+
+  RETURN(result, int32_t);
+}
+
+/**
+ * 対応解像度一覧/UVCコントロール一覧の取得が完了しているかどうか
+ * @param device_id
+ * @return 1: 取得完了, 0: 取得中, 負: エラーコード
+ */
+DART_EXPORT
+int32_t is_capabilities_ready(int32_t device_id)
+{
+  ENTER();
+
+  int32_t result = -1;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->is_capabilities_ready(device_id);
+  }
+
+  RETURN(result, int32_t);
+}
+
 /**
  * コントロール機能でサポートしている機能を取得
  * @param device_id
@@ -276,7 +1065,7 @@ int32_t get_ctrl_value(int32_t device_id, uint64_t type, int32_t *value)
  */
 DART_EXPORT
 int32_t get_supported_size(int32_t device_id, int32_t index,
-                           int32_t *num_supported, uvc_video_size_t *data)
+                           int32_t *num_supported, flutter_video_size_t *data)
 {
 
   ENTER();
@@ -292,6 +1081,58 @@ int32_t get_supported_size(int32_t device_id, int32_t index,
   RETURN(result, int32_t);
 }
 
+/**
+ * 接続中の複数のUVC機器がUSBの帯域内に収まるように映像設定を計画する
+ * @param requests UVC機器毎の要求
+ * @param num_requests requestsの要素数
+ * @param bus_bandwidth USBバスの帯域[バイト/秒], 0ならUSB2.0の周期転送の帯域
+ * @param apply 0以外なら計画した映像設定を適用する
+ * @param plan_out 計画した映像設定を書き込むバッファ, num_requests個以上の要素が必要
+ * @return 0: 成功, 負: エラーコード
+ */
+DART_EXPORT
+int32_t plan_video_sizes(flutter_bandwidth_request_t *requests,
+                         int32_t num_requests, uint64_t bus_bandwidth,
+                         int32_t apply, flutter_bandwidth_plan_t *plan_out)
+{
+
+  ENTER();
+
+  int32_t result = -1;
+  if (!requests || (num_requests <= 0) || !plan_out)
+  {
+    RETURN(result, int32_t);
+  }
+  std::vector<plugin::bandwidth_requirement_t> requirements;
+  for (int32_t i = 0; i < num_requests; i++)
+  {
+    requirements.push_back({requests[i].device_id, requests[i].min_width,
+                            requests[i].min_height, requests[i].min_fps});
+  }
+  std::vector<plugin::bandwidth_assignment_t> plan;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->plan_video_sizes(requirements, bus_bandwidth,
+                                          apply != 0, plan);
+    for (size_t i = 0; i < plan.size(); i++)
+    {
+      plan_out[i].device_id = plan[i].device_id;
+      plan_out[i].frame_type = plan[i].frame_type;
+      plan_out[i].width = plan[i].width;
+      plan_out[i].height = plan[i].height;
+      plan_out[i].frame_interval = plan[i].frame_interval;
+      plan_out[i].fps = plugin::interval_to_fps(plan[i].frame_interval);
+      plan_out[i].bandwidth = plan[i].bandwidth;
+      plan_out[i].negotiated_interval = plan[i].negotiated_interval;
+      plan_out[i].negotiated_fps =
+          plugin::interval_to_fps(plan[i].negotiated_interval);
+    }
+  }
+
+  RETURN(result, int32_t);
+}
+
 /**
  * 映像取得用のsurfaceをセットする
  * @param device_id UVC機器の識別子
@@ -499,6 +1340,47 @@ static jint nativeSetRecordingSurfaceObj(JNIEnv *env, jobject thiz, jint deviceI
   RETURN(result, jint);
 }
 
+/**
+ * Report the recording encoder's counters to the rate controller
+ * Called by UvcVideoRecorder while draining the encoder
+ * @param env JNI environment
+ * @param thiz Java object
+ * @param deviceId UVC device ID
+ * @param encodedFrames frames output since the recording started
+ * @param outputBytes bytes output since the recording started
+ * @param stallUs time writing the output blocked since the recording started
+ * @param bitrate bitrate the encoder is running at
+ * @return bitrate the encoder should switch to, 0 to keep it, negative on error
+ */
+static jint nativeReportEncoderStats(JNIEnv *env, jobject thiz, jint deviceId,
+                                     jlong encodedFrames, jlong outputBytes,
+                                     jlong stallUs, jint bitrate)
+{
+  int32_t result = -ENODEV;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->report_encoder_stats(
+        deviceId, (uint64_t)std::max<jlong>(encodedFrames, 0),
+        (uint64_t)std::max<jlong>(outputBytes, 0),
+        (uint64_t)std::max<jlong>(stallUs, 0), (uint32_t)std::max(bitrate, 0));
+  }
+
+  return result;
+}
+
+static jboolean nativeRepeatsFrames(JNIEnv *env, jobject thiz, jint deviceId)
+{
+  bool result = false;
+  std::lock_guard<std::mutex> lock(plugin_lock);
+  if (pluginJava)
+  {
+    result = pluginJava->repeats_frames(deviceId);
+  }
+
+  return result ? JNI_TRUE : JNI_FALSE;
+}
+
 //================================================================================
 static JNINativeMethod methods[] = {
     {"nativeInit", "()I", (void *)nativeInit},
@@ -516,6 +1398,9 @@ static JNINativeMethod methods[] = {
     {"nativeSetRecordingSurface", "(IJ)I", (void *)nativeSetRecordingSurface},
     {"nativeSetRecordingSurfaceObj", "(ILandroid/view/Surface;)I",
      (void *)nativeSetRecordingSurfaceObj},
+    {"nativeReportEncoderStats", "(IJJJI)I",
+     (void *)nativeReportEncoderStats},
+    {"nativeRepeatsFrames", "(I)Z", (void *)nativeRepeatsFrames},
 };
 
 int register_plugin(JNIEnv *env)
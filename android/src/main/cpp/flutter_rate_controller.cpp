@@ -0,0 +1,246 @@
+/**
+ * Flutter Rate Controller Implementation
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#define LOG_TAG "RateController"
+
+#if 1
+#ifndef LOG_NDEBUG
+#define LOG_NDEBUG
+#endif
+#undef USE_LOGALL
+#else
+#define USE_LOGALL
+#undef LOG_NDEBUG
+#undef NDEBUG
+#endif
+
+// Standard C/C++ headers
+#include <algorithm>
+#include <cerrno>
+
+// Project headers
+#include "flutter_rate_controller.h"
+#include "utilbase.h"
+
+namespace serenegiant::flutter {
+
+static const char *reasonName(RateReason reason) {
+  switch (reason) {
+  case RateReason::EncoderBacklog:
+    return "encoder backlog";
+  case RateReason::StorageStall:
+    return "storage stall";
+  case RateReason::Recovered:
+    return "recovered";
+  }
+  return "unknown";
+}
+
+//------------------------------------------------------------------------------
+// Settings
+//------------------------------------------------------------------------------
+int RateController::configure(bool enabled, const RateControlConfig &config) {
+  if (!config.min_bitrate ||
+      (config.max_bitrate && config.max_bitrate < config.min_bitrate) ||
+      !config.max_queue_depth ||
+      config.target_queue_depth >= config.max_queue_depth ||
+      !config.max_decimation || config.max_decimation > RATE_MAX_DECIMATION ||
+      !config.stall_permille || config.stall_permille > 1000 ||
+      !config.interval_ms || !config.recover_intervals) {
+    return -EINVAL;
+  }
+
+  std::lock_guard<std::mutex> lock(m_lock);
+  m_config = config;
+  resetLocked();
+  m_enabled = enabled;
+  LOGD("enabled %d, bitrate %u..%u, queue %u/%u, decimation <= %u", enabled,
+       config.min_bitrate, config.max_bitrate, config.target_queue_depth,
+       config.max_queue_depth, config.max_decimation);
+
+  return 0;
+}
+
+void RateController::reset() {
+  std::lock_guard<std::mutex> lock(m_lock);
+  resetLocked();
+}
+
+/*private*/
+void RateController::resetLocked() {
+  m_decimation = 1;
+  m_posted = 0;
+  m_dropped = 0;
+  m_bitrate = m_min_bitrate = m_max_bitrate = 0;
+  m_has_last = false;
+  m_encoded_offset = 0;
+  m_calm = 0;
+  m_stats = RateControlStats{};
+  m_stats.decimation = 1;
+  m_decisions.clear();
+  m_next_decision = 0;
+}
+
+//------------------------------------------------------------------------------
+// Decimation
+//------------------------------------------------------------------------------
+bool RateController::dropFrame() {
+  const uint32_t decimation = m_decimation;
+  if (decimation <= 1) {
+    m_phase = 0;
+    return false;
+  }
+  // Keep the first of every n frames
+  const bool drop = m_phase != 0;
+  m_phase = (m_phase + 1) % decimation;
+  if (drop) {
+    m_dropped++;
+  }
+  return drop;
+}
+
+//------------------------------------------------------------------------------
+// Control
+//------------------------------------------------------------------------------
+uint32_t RateController::update(const EncoderSample &sample) {
+  if (!m_enabled) {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(m_lock);
+  if (!m_bitrate) {
+    // The encoder's configured bitrate is the ceiling unless one is given
+    m_bitrate = sample.bitrate;
+    m_max_bitrate = m_config.max_bitrate ? m_config.max_bitrate : m_bitrate;
+    m_min_bitrate = std::min(m_config.min_bitrate, m_max_bitrate);
+    m_stats.bitrate = m_bitrate;
+  }
+  if (!m_has_last) {
+    m_last = sample;
+    m_has_last = true;
+    return 0;
+  }
+  const int64_t dt_us = sample.time_us - m_last.time_us;
+  if (dt_us < (int64_t)m_config.interval_ms * 1000) {
+    // Deltas keep accumulating until the interval has passed
+    return 0;
+  }
+
+  // Input queue depth, the encoder outputs frames of its own when it
+  // repeats the last frame, those are taken out
+  const uint64_t posted = m_posted;
+  uint64_t encoded = sample.encoded_frames - m_encoded_offset;
+  if (encoded > posted) {
+    m_encoded_offset += encoded - posted;
+    encoded = posted;
+  }
+  const uint32_t depth = (uint32_t)std::min<uint64_t>(posted - encoded,
+                                                      UINT32_MAX);
+  const uint64_t bytes = sample.output_bytes - m_last.output_bytes;
+  const uint64_t output_bps = bytes * 8 * 1000000 / (uint64_t)dt_us;
+  const uint32_t stall = (uint32_t)std::min<uint64_t>(
+      (sample.stall_us - m_last.stall_us) * 1000 / (uint64_t)dt_us, 1000);
+  m_last = sample;
+
+  m_stats.updates++;
+  m_stats.queue_depth = depth;
+  m_stats.max_queue_depth = std::max(m_stats.max_queue_depth, depth);
+  m_stats.output_bps = output_bps;
+  m_stats.stall_permille = stall;
+
+  const uint32_t decimation = m_decimation;
+  uint32_t new_bitrate = m_bitrate;
+  uint32_t new_decimation = decimation;
+  RateReason reason = RateReason::Recovered;
+  const bool backlog = depth > m_config.max_queue_depth;
+  const bool stalled = stall >= m_config.stall_permille;
+  if (backlog || stalled) {
+    m_calm = 0;
+    reason = stalled ? RateReason::StorageStall : RateReason::EncoderBacklog;
+    // Step down from what the encoder produces, a cut that stays above its
+    // output would not relieve the encoder or the storage at all
+    const uint64_t current =
+        output_bps ? std::min<uint64_t>(m_bitrate, output_bps) : m_bitrate;
+    new_bitrate = std::max(m_min_bitrate, (uint32_t)(current * 3 / 4));
+    // Drop frames too when the bitrate is at its floor or the queue is far
+    // too long to wait for the lower bitrate to take effect
+    if ((new_bitrate == m_bitrate || depth > m_config.max_queue_depth * 2) &&
+        decimation < m_config.max_decimation) {
+      new_decimation = decimation + 1;
+    }
+  } else if (depth <= m_config.target_queue_depth &&
+             stall < m_config.stall_permille / 4) {
+    if (++m_calm >= m_config.recover_intervals) {
+      m_calm = 0;
+      // Frame rate first, it is what viewers notice most
+      if (decimation > 1) {
+        new_decimation = decimation - 1;
+      } else if (m_bitrate < m_max_bitrate &&
+                 output_bps * 1000 >=
+                     (uint64_t)m_bitrate * RATE_MIN_OUTPUT_PERMILLE) {
+        new_bitrate = std::min(m_max_bitrate,
+                               (uint32_t)((uint64_t)m_bitrate * 9 / 8 + 1));
+      }
+    }
+  } else {
+    m_calm = 0;
+  }
+
+  if (new_bitrate == m_bitrate && new_decimation == decimation) {
+    return 0;
+  }
+  const RateDecision decision = {sample.time_us, reason,     m_bitrate,
+                                 new_bitrate,    decimation, new_decimation,
+                                 depth,          output_bps, stall};
+  if (m_decisions.size() < RATE_MAX_DECISIONS) {
+    m_decisions.push_back(decision);
+  } else {
+    m_decisions[m_next_decision] = decision;
+  }
+  m_next_decision = (m_next_decision + 1) % RATE_MAX_DECISIONS;
+  m_stats.decisions++;
+  if (new_bitrate < m_bitrate) {
+    m_stats.bitrate_decreases++;
+  } else if (new_bitrate > m_bitrate) {
+    m_stats.bitrate_increases++;
+  }
+  if (new_decimation > decimation) {
+    m_stats.decimation_increases++;
+  } else if (new_decimation < decimation) {
+    m_stats.decimation_decreases++;
+  }
+  LOGI("%s: bitrate %u -> %u, decimation %u -> %u, queue %u, %llu bps, "
+       "stall %u permille",
+       reasonName(reason), m_bitrate, new_bitrate, decimation, new_decimation,
+       depth, (unsigned long long)output_bps, stall);
+
+  const bool bitrate_changed = new_bitrate != m_bitrate;
+  m_bitrate = new_bitrate;
+  m_decimation = new_decimation;
+  m_stats.bitrate = new_bitrate;
+  m_stats.decimation = new_decimation;
+  return bitrate_changed ? new_bitrate : 0;
+}
+
+void RateController::getStats(RateControlStats &stats) const {
+  std::lock_guard<std::mutex> lock(m_lock);
+  stats = m_stats;
+  stats.dropped_frames = m_dropped;
+}
+
+void RateController::getDecisions(std::vector<RateDecision> &decisions) const {
+  std::lock_guard<std::mutex> lock(m_lock);
+  decisions.clear();
+  decisions.reserve(m_decisions.size());
+  // The ring starts at the oldest entry once it is full
+  const size_t start =
+      m_decisions.size() < RATE_MAX_DECISIONS ? 0 : m_next_decision;
+  for (size_t i = 0; i < m_decisions.size(); i++) {
+    decisions.push_back(m_decisions[(start + i) % m_decisions.size()]);
+  }
+}
+
+} // namespace serenegiant::flutter
@@ -0,0 +1,354 @@
+/**
+ * Flutter Still Capture Implementation
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#define LOG_TAG "StillCapture"
+
+#if 1
+#ifndef LOG_NDEBUG
+#define LOG_NDEBUG
+#endif
+#undef USE_LOGALL
+#else
+#define USE_LOGALL
+#undef LOG_NDEBUG
+#undef NDEBUG
+#endif
+
+// Standard C/C++ headers
+#include <cerrno>
+#include <csetjmp>
+#include <cstdlib>
+#include <cstring>
+
+// Project headers
+#include "aandusb/aandusb_native.h"
+#include "flutter_frame_converter.h"
+#include "flutter_still_capture.h"
+#include "utilbase.h"
+
+namespace serenegiant::flutter {
+
+//------------------------------------------------------------------------------
+// Standard Huffman tables
+// One DHT segment with the four tables of JPEG Annex K.3 in the order
+// luminance DC, luminance AC, chrominance DC, chrominance AC. Each table is
+// its class/id byte, the code counts for lengths 1 to 16 and the symbols.
+//------------------------------------------------------------------------------
+static const uint8_t STANDARD_DHT[] = {
+    0xff, 0xc4, 0x01, 0xa2,
+    // Luminance DC
+    0x00,
+    0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b,
+    // Luminance AC
+    0x10,
+    0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03,
+    0x05, 0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7d,
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12,
+    0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+    0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16,
+    0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+    0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+    0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79,
+    0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98,
+    0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+    0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4,
+    0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
+    0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+    // Chrominance DC
+    0x01,
+    0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b,
+    // Chrominance AC
+    0x11,
+    0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04,
+    0x07, 0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77,
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21,
+    0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+    0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34,
+    0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38,
+    0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+    0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78,
+    0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96,
+    0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+    0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2,
+    0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9,
+    0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+static_assert(sizeof(STANDARD_DHT) == 2 + 0x01a2, "DHT length mismatch");
+
+//------------------------------------------------------------------------------
+// Marker parsing
+//------------------------------------------------------------------------------
+static constexpr uint8_t MARKER_SOI = 0xd8;
+static constexpr uint8_t MARKER_EOI = 0xd9;
+static constexpr uint8_t MARKER_SOS = 0xda;
+static constexpr uint8_t MARKER_DHT = 0xc4;
+
+// Markers without a length field: TEM and RST0-7
+static inline bool isStandalone(uint8_t marker) {
+  return marker == 0x01 || (marker >= 0xd0 && marker <= 0xd7);
+}
+
+/**
+ * Header segments of a JPEG, the part before the first scan
+ * @param sos Offset of the first SOS marker
+ * @param has_dht Whether a DHT segment comes before it
+ * @return 0 on success, -EINVAL when not a JPEG or no scan was found
+ */
+static int parseHeader(const uint8_t *jpeg, size_t len, size_t &sos,
+                       bool &has_dht) {
+  has_dht = false;
+  if (!jpeg || len < 4 || jpeg[0] != 0xff || jpeg[1] != MARKER_SOI) {
+    return -EINVAL;
+  }
+  size_t pos = 2;
+  while (pos + 1 < len) {
+    if (jpeg[pos] != 0xff) {
+      return -EINVAL;
+    }
+    const uint8_t marker = jpeg[pos + 1];
+    if (marker == 0xff) {
+      // Fill byte before a marker
+      pos++;
+      continue;
+    }
+    if (marker == MARKER_SOS) {
+      sos = pos;
+      return 0;
+    }
+    if (marker == MARKER_SOI || marker == MARKER_EOI) {
+      return -EINVAL;
+    }
+    if (isStandalone(marker)) {
+      pos += 2;
+      continue;
+    }
+    if (pos + 3 >= len) {
+      break;
+    }
+    has_dht |= marker == MARKER_DHT;
+    pos += 2 + ((size_t)jpeg[pos + 2] << 8 | jpeg[pos + 3]);
+  }
+
+  return -EINVAL;
+}
+
+/**
+ * End of the JPEG, right after its EOI marker
+ * Walks the entropy coded data of every scan, stuffed zeros and restart
+ * markers are skipped, segments between scans by their length.
+ * @param sos Offset of the first SOS marker
+ * @return offset after EOI, 0 when the data ends before EOI
+ */
+static size_t findEnd(const uint8_t *jpeg, size_t len, size_t sos) {
+  size_t pos = sos;
+  while (pos + 3 < len) {
+    // pos is at a marker with a length, skip the segment
+    pos += 2 + ((size_t)jpeg[pos + 2] << 8 | jpeg[pos + 3]);
+    // Entropy coded data (empty after other segments) until the next marker
+    for (;;) {
+      const uint8_t *ff = pos < len ? static_cast<const uint8_t *>(
+                                          memchr(jpeg + pos, 0xff, len - pos))
+                                    : nullptr;
+      if (!ff) {
+        return 0;
+      }
+      pos = ff - jpeg;
+      if (pos + 1 >= len) {
+        return 0;
+      }
+      const uint8_t marker = jpeg[pos + 1];
+      if (marker == 0x00 || isStandalone(marker)) {
+        pos += 2;
+      } else if (marker == 0xff) {
+        pos++;
+      } else if (marker == MARKER_EOI) {
+        return pos + 2;
+      } else {
+        break;
+      }
+    }
+  }
+
+  return 0;
+}
+
+bool jpegHasHuffmanTables(const uint8_t *jpeg, size_t len) {
+  size_t sos = 0;
+  bool has_dht = false;
+  return !parseHeader(jpeg, len, sos, has_dht) && has_dht;
+}
+
+int completeJpeg(const uint8_t *frame, size_t len,
+                 std::vector<uint8_t> &jpeg) {
+  size_t sos = 0;
+  bool has_dht = false;
+  int result = parseHeader(frame, len, sos, has_dht);
+  if (result) {
+    return result;
+  }
+  const size_t end = findEnd(frame, len, sos);
+  if (!end) {
+    return -ENODATA;
+  }
+
+  if (has_dht) {
+    jpeg.assign(frame, frame + end);
+  } else {
+    jpeg.resize(end + sizeof(STANDARD_DHT));
+    memcpy(jpeg.data(), frame, sos);
+    memcpy(jpeg.data() + sos, STANDARD_DHT, sizeof(STANDARD_DHT));
+    memcpy(jpeg.data() + sos + sizeof(STANDARD_DHT), frame + sos, end - sos);
+    LOGV("inserted standard DHT");
+  }
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Encoder
+// libjpeg reports fatal errors through error_exit which must not return,
+// so jump back to encode() instead of calling exit().
+//------------------------------------------------------------------------------
+void JpegEncoder::onError(j_common_ptr cinfo) {
+  auto *err = reinterpret_cast<ErrorManager *>(cinfo->err);
+  char msg[JMSG_LENGTH_MAX];
+  (*cinfo->err->format_message)(cinfo, msg);
+  LOGW("libjpeg error: %s", msg);
+  longjmp(*static_cast<jmp_buf *>(err->jmp_buf_ptr), 1);
+}
+
+JpegEncoder::JpegEncoder(int quality) : m_quality(quality) {
+  memset(&m_cinfo, 0, sizeof(m_cinfo));
+  m_cinfo.err = jpeg_std_error(&m_jerr.pub);
+  m_jerr.pub.error_exit = onError;
+  m_jerr.jmp_buf_ptr = nullptr;
+  jpeg_create_compress(&m_cinfo);
+}
+
+JpegEncoder::~JpegEncoder() { jpeg_destroy_compress(&m_cinfo); }
+
+int JpegEncoder::encode(uint32_t frame_type, const uint8_t *src,
+                        size_t src_len, uint32_t width, uint32_t height,
+                        std::vector<uint8_t> &jpeg) {
+  if (!width || !height) {
+    return -EINVAL;
+  }
+  m_rgba.resize((size_t)width * height * 4);
+  int result = convertToRgba(frame_type, src, src_len, width, height,
+                             m_rgba.data(), width * 4);
+  if (result) {
+    return result;
+  }
+
+  // jpeg_mem_dest allocates the output with malloc, it is freed here on
+  // error as well
+  unsigned char *out = nullptr;
+  unsigned long out_len = 0;
+  jmp_buf env;
+  m_jerr.jmp_buf_ptr = &env;
+  if (setjmp(env)) {
+    jpeg_abort_compress(&m_cinfo);
+    m_jerr.jmp_buf_ptr = nullptr;
+    free(out);
+    return -EIO;
+  }
+
+  jpeg_mem_dest(&m_cinfo, &out, &out_len);
+  m_cinfo.image_width = width;
+  m_cinfo.image_height = height;
+  m_cinfo.input_components = 4;
+  m_cinfo.in_color_space = JCS_EXT_RGBA;
+  jpeg_set_defaults(&m_cinfo);
+  jpeg_set_quality(&m_cinfo, m_quality, TRUE);
+  // A still is encoded once, so take the accurate DCT
+  m_cinfo.dct_method = JDCT_ISLOW;
+  jpeg_start_compress(&m_cinfo, TRUE);
+  while (m_cinfo.next_scanline < m_cinfo.image_height) {
+    JSAMPROW row = &m_rgba[(size_t)m_cinfo.next_scanline * width * 4];
+    jpeg_write_scanlines(&m_cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&m_cinfo);
+  m_jerr.jmp_buf_ptr = nullptr;
+
+  jpeg.assign(out, out + out_len);
+  free(out);
+
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Still
+//------------------------------------------------------------------------------
+int makeStillJpeg(uint32_t frame_type, const uint8_t *frame, size_t len,
+                  uint32_t width, uint32_t height, JpegEncoder &encoder,
+                  std::vector<uint8_t> &jpeg) {
+  if (frame_type == RAW_FRAME_MJPEG) {
+    return completeJpeg(frame, len, jpeg);
+  }
+  if (!rawFrameBytes(frame_type, width, height)) {
+    return -ENOTSUP;
+  }
+
+  return encoder.encode(frame_type, frame, len, width, height, jpeg);
+}
+
+int writeStillFile(const std::string &path, const std::vector<uint8_t> &jpeg) {
+  if (path.empty() || jpeg.empty()) {
+    return -EINVAL;
+  }
+  const std::string tmp = path + ".tmp";
+  FILE *fp = fopen(tmp.c_str(), "wb");
+  if (!fp) {
+    const int err = errno;
+    LOGW("failed to open %s, err=%d", tmp.c_str(), err);
+    return -err;
+  }
+  int result = 0;
+  if (fwrite(jpeg.data(), jpeg.size(), 1, fp) != 1) {
+    result = -(errno ? errno : EIO);
+  }
+  if (fclose(fp) && !result) {
+    result = -(errno ? errno : EIO);
+  }
+  if (!result && rename(tmp.c_str(), path.c_str())) {
+    result = -errno;
+  }
+  if (result) {
+    LOGW("failed to write %s, err=%d", path.c_str(), result);
+    remove(tmp.c_str());
+  }
+
+  return result;
+}
+
+} // namespace serenegiant::flutter
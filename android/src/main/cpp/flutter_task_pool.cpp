@@ -0,0 +1,508 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#define LOG_TAG "TaskPool"
+
+#if 1	// デバッグ情報を出さない時は1
+	#ifndef LOG_NDEBUG
+		#define	LOG_NDEBUG		// LOGV/LOGD/MARKを出力しない時
+	#endif
+	#undef USE_LOGALL			// 指定したLOGxだけを出力
+#else
+	#define USE_LOGALL
+	#define USE_LOGD
+	#undef LOG_NDEBUG
+	#undef NDEBUG
+#endif
+
+// 標準ライブラリ
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+// aandusb
+#include "utilbase.h"
+// flutter
+#include "flutter_task_pool.h"
+#include "flutter_thread_policy.h"
+
+namespace serenegiant::flutter
+{
+
+	/**
+	 * 現在のスレッドがワーカースレッドならそのタスクプール
+	 */
+	static thread_local TaskPool *tls_pool = nullptr;
+	/**
+	 * 現在のスレッドがワーカースレッドならそのインデックス
+	 */
+	static thread_local size_t tls_worker = 0;
+
+	static inline int64_t now_ns()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static inline void update_submitted(task_queue_metrics_t &metrics)
+	{
+		metrics.submitted++;
+		metrics.queued++;
+		metrics.max_queued = std::max(metrics.max_queued, metrics.queued);
+	}
+
+	static inline void update_started(task_queue_metrics_t &metrics, const uint64_t &wait_ns)
+	{
+		metrics.executed++;
+		if (metrics.queued) metrics.queued--;
+		metrics.total_wait_ns += wait_ns;
+		metrics.max_wait_ns = std::max(metrics.max_wait_ns, wait_ns);
+	}
+
+	static inline void merge(task_queue_metrics_t &dst, const task_queue_metrics_t &src)
+	{
+		dst.submitted += src.submitted;
+		dst.executed += src.executed;
+		dst.queued += src.queued;
+		dst.max_queued = std::max(dst.max_queued, src.max_queued);
+		dst.total_wait_ns += src.total_wait_ns;
+		dst.max_wait_ns = std::max(dst.max_wait_ns, src.max_wait_ns);
+	}
+
+//--------------------------------------------------------------------------------
+	/*public,static*/
+	TaskPool &TaskPool::get_instance()
+	{
+		static TaskPool instance;
+		return instance;
+	}
+
+	/**
+	 * コンストラクタ
+	 * @param num_workers ワーカースレッド数, 0ならCPUのコア数
+	 */
+	TaskPool::TaskPool(const size_t &num_workers)
+	:	m_pending(0), m_stolen(0), m_running(true)
+	{
+		ENTER();
+
+		memset(m_metrics, 0, sizeof(m_metrics));
+		size_t n = num_workers;
+		if (!n)
+		{
+			n = std::max(2u, std::thread::hardware_concurrency());
+		}
+		for (size_t i = 0; i < n; i++)
+		{
+			m_workers.push_back(std::make_unique<worker>());
+		}
+		// 全てのworkerを生成してからスレッドを開始する(盗む時にm_workersを参照するため)
+		for (size_t i = 0; i < n; i++)
+		{
+			m_workers[i]->thread = std::thread(&TaskPool::worker_loop, this, i);
+		}
+		LOGD("num_workers=%zu", n);
+
+		EXIT();
+	}
+
+	/**
+	 * デストラクタ
+	 * キューに残っているタスクを全て実行してからワーカースレッドを終了する
+	 */
+	TaskPool::~TaskPool()
+	{
+		ENTER();
+
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			m_running = false;
+		}
+		m_cond.notify_all();
+		for (auto &w: m_workers)
+		{
+			if (w->thread.joinable())
+			{
+				w->thread.join();
+			}
+		}
+
+		EXIT();
+	}
+
+	/**
+	 * タスクを投入する
+	 * @param device_id 公平性の単位となるUVC機器の識別子
+	 * @param priority
+	 * @param task
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	/*public*/
+	int TaskPool::submit(const int32_t &device_id, const task_priority_t &priority, Task task)
+	{
+		if (!task || (priority < 0) || (priority >= TASK_PRIORITY_NUM)) return -EINVAL;
+
+		task_item item { std::move(task), device_id, priority, now_ns() };
+		if (tls_pool == this)
+		{
+			// ワーカースレッド内から投入したときは自分のキューへ入れる
+			// 他のワーカースレッドがすぐに盗んでも数が合うように先に数える
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+				update_submitted(m_devices[device_id].metrics[priority]);
+				update_submitted(m_metrics[priority]);
+				m_pending++;
+			}
+			std::lock_guard<std::mutex> lock(m_workers[tls_worker]->lock);
+			m_workers[tls_worker]->tasks.push_back(std::move(item));
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			if (!m_running) return -EINVAL;
+			auto &dev = m_devices[device_id];
+			auto &tasks = dev.tasks[priority];
+			if (tasks.empty())
+			{
+				m_ready[priority].push_back(device_id);
+			}
+			tasks.push_back(std::move(item));
+			update_submitted(dev.metrics[priority]);
+			update_submitted(m_metrics[priority]);
+			m_pending++;
+		}
+		m_cond.notify_one();
+
+		return 0;
+	}
+
+	/**
+	 * キューに入っているタスクを1つ実行する
+	 * @return タスクを実行したらtrue
+	 */
+	/*public*/
+	bool TaskPool::run_one()
+	{
+		task_item item;
+		if (pop(item))
+		{
+			execute(item);
+			return true;
+		}
+		return false;
+	}
+
+	/*private*/
+	void TaskPool::worker_loop(const size_t &ix)
+	{
+		ENTER();
+
+		tls_pool = this;
+		tls_worker = ix;
+		char name[THREAD_NAME_LEN];
+		snprintf(name, sizeof(name), "uvc-pool%zu", ix);
+		PipelineThread thread(THREAD_POLICY_POOL, name);
+		for ( ; ; )
+		{
+			thread.update();
+			task_item item;
+			if (pop(item))
+			{
+				execute(item);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(m_lock);
+			if (!m_running && !m_pending) break;
+			m_cond.wait(lock, [this] { return !m_running || (m_pending > 0); });
+		}
+		tls_pool = nullptr;
+
+		EXIT();
+	}
+
+	/**
+	 * 実行するタスクを1つ取り出す
+	 * 自分のキュー→UVC機器毎のキュー(優先度順, ラウンドロビン)→他のワーカースレッドのキューの順
+	 */
+	/*private*/
+	bool TaskPool::pop(task_item &item)
+	{
+		if (!m_pending) return false;
+
+		const bool is_worker = tls_pool == this;
+		if (is_worker)
+		{
+			auto &self = *m_workers[tls_worker];
+			std::unique_lock<std::mutex> lock(self.lock);
+			if (!self.tasks.empty())
+			{
+				item = std::move(self.tasks.back());
+				self.tasks.pop_back();
+				lock.unlock();
+				std::lock_guard<std::mutex> global_lock(m_lock);
+				update_queued_locked(item);
+				return true;
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			if (pop_global_locked(item))
+			{
+				update_queued_locked(item);
+				return true;
+			}
+		}
+		// 他のワーカースレッドのキューから盗む
+		const size_t n = m_workers.size();
+		const size_t start = is_worker ? tls_worker + 1 : 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			auto &victim = *m_workers[(start + i) % n];
+			if (is_worker && (&victim == m_workers[tls_worker].get())) continue;
+			std::unique_lock<std::mutex> lock(victim.lock);
+			if (!victim.tasks.empty())
+			{
+				item = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				lock.unlock();
+				std::lock_guard<std::mutex> global_lock(m_lock);
+				update_queued_locked(item);
+				m_stolen++;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * 優先度の高い順にUVC機器毎のキューからタスクを取り出す
+	 * 同じ優先度のタスクがある機器はラウンドロビンで選ぶ
+	 */
+	/*private*/
+	bool TaskPool::pop_global_locked(task_item &item)
+	{
+		for (int p = 0; p < TASK_PRIORITY_NUM; p++)
+		{
+			auto &ready = m_ready[p];
+			while (!ready.empty())
+			{
+				const auto device_id = ready.front();
+				ready.pop_front();
+				auto found = m_devices.find(device_id);
+				if (found == m_devices.end()) continue;
+				auto &tasks = found->second.tasks[p];
+				if (tasks.empty()) continue;
+				item = std::move(tasks.front());
+				tasks.pop_front();
+				if (!tasks.empty())
+				{
+					// まだ残っていれば最後尾へ回す
+					ready.push_back(device_id);
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/*private*/
+	void TaskPool::update_queued_locked(const task_item &item)
+	{
+		const auto wait_ns = (uint64_t)std::max((int64_t)0, now_ns() - item.queued_ns);
+		update_started(m_devices[item.device_id].metrics[item.priority], wait_ns);
+		update_started(m_metrics[item.priority], wait_ns);
+		m_pending--;
+	}
+
+	/*private*/
+	void TaskPool::execute(task_item &item)
+	{
+		try
+		{
+			item.task();
+		}
+		catch (const std::exception &e)
+		{
+			LOGE("task threw exception,device_id=%d,%s", item.device_id, e.what());
+		}
+		catch (...)
+		{
+			LOGE("task threw unknown exception,device_id=%d", item.device_id);
+		}
+	}
+
+	/**
+	 * 統計情報を取得
+	 * @param metrics
+	 */
+	/*public*/
+	void TaskPool::get_metrics(task_pool_metrics_t &metrics) const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		memset(&metrics, 0, sizeof(metrics));
+		metrics.num_workers = m_workers.size();
+		metrics.stolen = m_stolen;
+		memcpy(metrics.queues, m_metrics, sizeof(m_metrics));
+	}
+
+	/**
+	 * UVC機器毎の統計情報を取得
+	 * @param device_id
+	 * @param metrics
+	 * @return 0: 成功, -ENOENT: タスクを投入したことがないUVC機器
+	 */
+	/*public*/
+	int TaskPool::get_metrics(const int32_t &device_id, task_pool_metrics_t &metrics) const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		memset(&metrics, 0, sizeof(metrics));
+		metrics.num_workers = m_workers.size();
+		auto found = m_devices.find(device_id);
+		if (found == m_devices.end()) return -ENOENT;
+		for (int p = 0; p < TASK_PRIORITY_NUM; p++)
+		{
+			merge(metrics.queues[p], found->second.metrics[p]);
+		}
+		return 0;
+	}
+
+	/**
+	 * UVC機器の統計情報を破棄する
+	 * キューに残っているタスクがあるときは何もしない(タスクはそのまま実行される)
+	 * @param device_id
+	 */
+	/*public*/
+	void TaskPool::remove_device(const int32_t &device_id)
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_lock);
+		auto found = m_devices.find(device_id);
+		if ((found != m_devices.end())
+			&& std::none_of(std::begin(found->second.metrics), std::end(found->second.metrics),
+				[](const task_queue_metrics_t &metrics) { return metrics.queued > 0; }))
+		{
+			m_devices.erase(found);
+		}
+
+		EXIT();
+	}
+
+//--------------------------------------------------------------------------------
+	/**
+	 * TaskGroupへ投入したタスク, ワーカースレッドとwaitで待機中のスレッドの先に取り出した方が実行する
+	 */
+	struct TaskGroup::group_item {
+		Task task;
+		std::atomic<bool> claimed{false};
+	};
+
+	/**
+	 * TaskGroupとワーカースレッドで共有する状態
+	 */
+	struct TaskGroup::group_state {
+		std::mutex lock;
+		std::condition_variable cond;
+		// 未終了のタスク数, lockで保護する
+		int pending = 0;
+		// 投入した順のタスク, 実行済みのタスクも取り出すまで残る, lockで保護する
+		std::deque<std::shared_ptr<group_item>> queue;
+
+		/**
+		 * まだ誰も実行していなければタスクを実行する
+		 * @param item
+		 */
+		void execute(const std::shared_ptr<group_item> &item)
+		{
+			if (item->claimed.exchange(true))
+			{
+				return;
+			}
+			item->task();
+			std::lock_guard<std::mutex> l(lock);
+			if (--pending == 0)
+			{
+				cond.notify_all();
+			}
+		}
+	};
+
+	TaskGroup::TaskGroup(TaskPool &pool, const int32_t &device_id)
+	:	m_pool(pool), m_device_id(device_id),
+		m_state(std::make_shared<group_state>())
+	{
+	}
+
+	TaskGroup::~TaskGroup()
+	{
+		wait();
+	}
+
+	/**
+	 * タスクを投入する
+	 * タスクプールが終了処理中で投入できないときはこのスレッドで実行する
+	 * @param priority
+	 * @param task
+	 */
+	/*public*/
+	void TaskGroup::run(const task_priority_t &priority, Task task)
+	{
+		auto item = std::make_shared<group_item>();
+		item->task = std::move(task);
+		{
+			std::lock_guard<std::mutex> lock(m_state->lock);
+			m_state->pending++;
+			m_state->queue.push_back(item);
+		}
+		auto state = m_state;
+		const int result = m_pool.submit(m_device_id, priority, [state, item]() {
+			state->execute(item);
+		});
+		if (result)
+		{
+			state->execute(item);
+		}
+	}
+
+	/**
+	 * 投入した全てのタスクが終了するまで待つ
+	 * 待っている間はまだワーカースレッドが取り出していない自分のタスクを実行する
+	 * 他のTaskGroupのタスクは実行しないので遅いタスクに待たされない
+	 */
+	/*public*/
+	void TaskGroup::wait()
+	{
+		std::unique_lock<std::mutex> lock(m_state->lock);
+		while (m_state->pending > 0)
+		{
+			if (!m_state->queue.empty())
+			{
+				auto item = std::move(m_state->queue.front());
+				m_state->queue.pop_front();
+				lock.unlock();
+				m_state->execute(item);
+				lock.lock();
+				continue;
+			}
+			m_state->cond.wait(lock);
+		}
+		m_state->queue.clear();
+	}
+
+}	// namespace serenegiant::flutter
@@ -0,0 +1,362 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#define LOG_TAG "ThreadPolicy"
+
+#if 1	// デバッグ情報を出さない時は1
+	#ifndef LOG_NDEBUG
+		#define	LOG_NDEBUG		// LOGV/LOGD/MARKを出力しない時
+	#endif
+	#undef USE_LOGALL			// 指定したLOGxだけを出力
+#else
+	#define USE_LOGALL
+	#define USE_LOGD
+	#undef LOG_NDEBUG
+	#undef NDEBUG
+#endif
+
+// 標準ライブラリ
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+// システム
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+// aandusb
+#include "utilbase.h"
+// flutter
+#include "flutter_thread_policy.h"
+
+namespace serenegiant::flutter
+{
+
+	/**
+	 * 実行中の映像処理スレッド毎の情報
+	 * 統計情報は映像処理スレッドだけが書き込むのでs_lockではなくアトミック変数で受け渡す
+	 */
+	struct PipelineThread::record {
+		// 生成後は変更しない
+		char name[THREAD_NAME_LEN];
+		int32_t device_id;
+		int32_t tid;
+		std::atomic<int32_t> cpu{-1};
+		std::atomic<int32_t> sched_policy{SCHED_OTHER};
+		std::atomic<int32_t> policy_result{0};
+		std::atomic<uint64_t> samples{0};
+		std::atomic<uint64_t> migrations{0};
+		std::atomic<uint64_t> preemptions{0};
+		std::atomic<uint64_t> voluntary_switches{0};
+
+		void snapshot(thread_stats_t &stats) const
+		{
+			memset(&stats, 0, sizeof(stats));
+			memcpy(stats.name, name, sizeof(stats.name));
+			stats.device_id = device_id;
+			stats.tid = tid;
+			stats.cpu = cpu.load(std::memory_order_relaxed);
+			stats.sched_policy = sched_policy.load(std::memory_order_relaxed);
+			stats.policy_result = policy_result.load(std::memory_order_relaxed);
+			stats.samples = samples.load(std::memory_order_relaxed);
+			stats.migrations = migrations.load(std::memory_order_relaxed);
+			stats.preemptions = preemptions.load(std::memory_order_relaxed);
+			stats.voluntary_switches = voluntary_switches.load(std::memory_order_relaxed);
+		}
+	};
+
+	/**
+	 * スレッドポリシーと実行中の映像処理スレッドの一覧
+	 * 映像処理スレッドの統計情報の更新には使わない
+	 */
+	static std::mutex s_lock;
+	static std::unordered_map<int32_t, thread_policy_t> s_policies;
+	static std::list<std::shared_ptr<PipelineThread::record>> s_threads;
+	/**
+	 * スレッドポリシーをセットする毎に増やす
+	 * 映像処理スレッドはループ毎にこれだけを確認して変化した時だけs_lockをロックする
+	 */
+	static std::atomic<uint64_t> s_generation(1);
+
+	static inline int64_t now_ns()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static inline int32_t thread_id()
+	{
+		return (int32_t)syscall(__NR_gettid);
+	}
+
+	/**
+	 * 自スレッドのコンテキストスイッチ回数を取得
+	 */
+	static inline void get_switches(int64_t &preemptions, int64_t &voluntary)
+	{
+		struct rusage usage {};
+		if (!getrusage(RUSAGE_THREAD, &usage))
+		{
+			preemptions = usage.ru_nivcsw;
+			voluntary = usage.ru_nvcsw;
+		}
+	}
+
+	/**
+	 * 自スレッドへスレッドポリシーを適用する
+	 * @param policy
+	 * @param sched_policy 適用したスケジューリングポリシー
+	 * @return 0: 成功, 負: 最初に失敗した設定のエラーコード
+	 */
+	static int apply_policy(const thread_policy_t &policy, int32_t &sched_policy)
+	{
+		ENTER();
+
+		int result = 0;
+		auto error = [&](const int &err) {
+			if (!result) result = -err;
+		};
+
+		// CPUアフィニティ
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		const int num_cpus = std::min((int)CPU_SETSIZE, std::max(1, (int)sysconf(_SC_NPROCESSORS_CONF)));
+		for (int i = 0; i < num_cpus; i++)
+		{
+			if (!policy.cpu_mask || ((i < 64) && (policy.cpu_mask & (1ULL << i))))
+			{
+				CPU_SET(i, &cpus);
+			}
+		}
+		if (!CPU_COUNT(&cpus) || sched_setaffinity(0, sizeof(cpus), &cpus))
+		{
+			error(CPU_COUNT(&cpus) ? errno : EINVAL);
+			LOGW("failed to set cpu affinity 0x%llx", (unsigned long long)policy.cpu_mask);
+		}
+
+		// スケジューリングポリシー, SCHED_FIFOにできなければnice値にする
+		sched_param param {};
+		sched_policy = SCHED_OTHER;
+		if (policy.rt_priority > 0)
+		{
+			param.sched_priority = std::clamp(policy.rt_priority,
+				sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+			const int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+			if (!err)
+			{
+				sched_policy = SCHED_FIFO;
+			}
+			else
+			{
+				error(err);
+				LOGW("SCHED_FIFO is not permitted(%d), fall back to nice %d", err, policy.nice);
+			}
+		}
+		if (sched_policy != SCHED_FIFO)
+		{
+			param.sched_priority = 0;
+			pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+			// Linuxのsetpriorityはスレッド単位で効く
+			if (setpriority(PRIO_PROCESS, thread_id(), policy.nice))
+			{
+				error(errno);
+				LOGW("failed to set nice %d", policy.nice);
+			}
+		}
+
+		RETURN(result, int);
+	}
+
+//--------------------------------------------------------------------------------
+	/**
+	 * UVC機器毎のスレッドポリシーをセットする
+	 * @param device_id
+	 * @param policy
+	 * @return 0: 成功, -EINVAL: 範囲外の値
+	 */
+	int set_thread_policy(const int32_t &device_id, const thread_policy_t &policy)
+	{
+		ENTER();
+
+		if ((policy.nice < -20) || (policy.nice > 19)
+			|| (policy.rt_priority < 0) || (policy.rt_priority > 99))
+		{
+			RETURN(-EINVAL, int);
+		}
+		{
+			std::lock_guard<std::mutex> lock(s_lock);
+			s_policies[device_id] = policy;
+		}
+		s_generation++;
+
+		RETURN(0, int);
+	}
+
+	/**
+	 * UVC機器毎のスレッドポリシーを取得する
+	 * @param device_id
+	 * @param policy
+	 * @return 0: 成功, -ENOENT: スレッドポリシーをセットしていない
+	 */
+	int get_thread_policy(const int32_t &device_id, thread_policy_t &policy)
+	{
+		std::lock_guard<std::mutex> lock(s_lock);
+		auto found = s_policies.find(device_id);
+		if (found == s_policies.end()) return -ENOENT;
+		policy = found->second;
+		return 0;
+	}
+
+	/**
+	 * UVC機器の実行中の映像処理スレッドの統計情報を取得する
+	 * @param device_id
+	 * @param stats
+	 */
+	void get_thread_stats(const int32_t &device_id, std::vector<thread_stats_t> &stats)
+	{
+		stats.clear();
+		std::lock_guard<std::mutex> lock(s_lock);
+		for (const auto &r: s_threads)
+		{
+			if (r->device_id == device_id)
+			{
+				thread_stats_t s;
+				r->snapshot(s);
+				stats.push_back(s);
+			}
+		}
+	}
+
+//--------------------------------------------------------------------------------
+	/**
+	 * コンストラクタ
+	 * @param device_id
+	 * @param name
+	 */
+	PipelineThread::PipelineThread(const int32_t &device_id, const char *name)
+	:	m_record(std::make_shared<record>()),
+		m_generation(0),
+		m_last_cpu(sched_getcpu()),
+		m_base_preemptions(0), m_base_voluntary(0),
+		m_next_collect_ns(0)
+	{
+		ENTER();
+
+		auto &r = *m_record;
+		memset(r.name, 0, sizeof(r.name));
+		strncpy(r.name, name ? name : "", THREAD_NAME_LEN - 1);
+		r.device_id = device_id;
+		r.tid = thread_id();
+		r.cpu = m_last_cpu;
+		pthread_setname_np(pthread_self(), r.name);
+		get_switches(m_base_preemptions, m_base_voluntary);
+		{
+			std::lock_guard<std::mutex> lock(s_lock);
+			s_threads.push_back(m_record);
+		}
+		update();
+
+		EXIT();
+	}
+
+	/**
+	 * デストラクタ
+	 */
+	PipelineThread::~PipelineThread()
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(s_lock);
+		s_threads.remove(m_record);
+
+		EXIT();
+	}
+
+	/**
+	 * スレッドポリシーが変更されていれば適用する
+	 */
+	/*private*/
+	void PipelineThread::apply()
+	{
+		ENTER();
+
+		thread_policy_t policy;
+		const auto generation = s_generation.load();
+		const bool has_policy = !get_thread_policy(m_record->device_id, policy);
+		m_generation = generation;
+		if (has_policy)
+		{
+			int32_t sched_policy;
+			const int result = apply_policy(policy, sched_policy);
+			m_record->sched_policy.store(sched_policy, std::memory_order_relaxed);
+			m_record->policy_result.store(result, std::memory_order_relaxed);
+			// CPUアフィニティを変更した時は次の集計を待たずに反映させる
+			m_next_collect_ns = 0;
+		}
+
+		EXIT();
+	}
+
+	/**
+	 * 実行しているCPUとコンテキストスイッチ回数を集計する
+	 * sched_getcpuとgetrusageを呼ぶのでTHREAD_STATS_INTERVAL_NS毎にだけ呼ぶ
+	 * @param now
+	 */
+	/*private*/
+	void PipelineThread::collect(const int64_t &now)
+	{
+		m_next_collect_ns = now + THREAD_STATS_INTERVAL_NS;
+		const int32_t cpu = sched_getcpu();
+		int64_t preemptions = m_base_preemptions, voluntary = m_base_voluntary;
+		get_switches(preemptions, voluntary);
+
+		auto &r = *m_record;
+		if ((cpu >= 0) && (m_last_cpu >= 0) && (cpu != m_last_cpu))
+		{
+			r.migrations.fetch_add(1, std::memory_order_relaxed);
+		}
+		if (cpu >= 0) m_last_cpu = cpu;
+		r.cpu.store(m_last_cpu, std::memory_order_relaxed);
+		r.preemptions.store(preemptions - m_base_preemptions, std::memory_order_relaxed);
+		r.voluntary_switches.store(voluntary - m_base_voluntary, std::memory_order_relaxed);
+	}
+
+	/**
+	 * スレッドポリシーが変更されていれば適用して統計情報を更新する
+	 */
+	/*public*/
+	void PipelineThread::update()
+	{
+		if (m_generation != s_generation.load(std::memory_order_relaxed))
+		{
+			apply();
+		}
+		m_record->samples.fetch_add(1, std::memory_order_relaxed);
+		const auto now = now_ns();
+		if (now >= m_next_collect_ns)
+		{
+			collect(now);
+		}
+	}
+
+}	// namespace serenegiant::flutter
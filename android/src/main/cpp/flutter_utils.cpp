@@ -33,7 +33,9 @@
 #endif
 
 // 標準ライブラリ
+#include <cerrno>
 #include <cstdarg>
+#include <vector>
 // dart
 #include "dartAPIDL/dart_api_dl.h"
 #include "dartAPIDL/dart_native_api.h"
@@ -95,7 +97,9 @@ int send_msg_to_flutter(const Char *action, Args * ...args) {
 	};
 
 	LOGD("call Dart_PostCObject_DL");
-	Dart_PostCObject_DL(dart_api_message_port, &obj);
+	if (!Dart_PostCObject_DL(dart_api_message_port, &obj)) {
+		RETURN(-EIO, int);
+	}
 
 	RETURN(0, int);
 }
@@ -130,4 +134,227 @@ int send_on_device_changed(const int32_t &device_id, const bool &attached) {
 	RETURN(0, int);
 }
 
+/**
+ * 対応解像度一覧/UVCコントロール一覧の取得完了イベントをnative portを使ってDartへ送信する
+ * action="on_capabilities_ready"
+ * @param device_id
+ * @param result 0: 成功, 負: エラーコード
+ * @return
+ */
+int send_on_capabilities_ready(const int32_t &device_id, const int32_t &result) {
+	ENTER();
+
+	if (dart_api_message_port == -1) {
+		RETURN(-29, int);
+	}
+	Dart_CObject arg1 = {
+		.type = Dart_CObject_kInt32,
+		.value {
+			.as_int32 = device_id
+		}
+	};
+	Dart_CObject arg2 = {
+		.type = Dart_CObject_kInt32,
+		.value {
+			.as_int32 = result
+		}
+	};
+	send_msg_to_flutter("on_capabilities_ready", &arg1, &arg2);
+
+	RETURN(0, int);
+}
+
+/**
+ * 静止画の撮影完了イベントをnative portを使ってDartへ送信する
+ * action="on_still_captured"
+ * JPEGデータはコピーせずにExternalTypedData(Uint8List)として渡し, Dart側で不要になった時に破棄する
+ * @param device_id
+ * @param result 0: 成功, 負: エラーコード
+ * @param jpeg JPEGデータ, 空ならnullを送る
+ * @return
+ */
+int send_on_still_captured(const int32_t &device_id, const int32_t &result, std::vector<uint8_t> &&jpeg) {
+	ENTER();
+
+	if (dart_api_message_port == -1) {
+		RETURN(-29, int);
+	}
+	Dart_CObject arg1 = {
+		.type = Dart_CObject_kInt32,
+		.value {
+			.as_int32 = device_id
+		}
+	};
+	Dart_CObject arg2 = {
+		.type = Dart_CObject_kInt32,
+		.value {
+			.as_int32 = result
+		}
+	};
+	Dart_CObject arg3 = {
+		.type = Dart_CObject_kNull,
+		.value {},
+	};
+	std::vector<uint8_t> *data = nullptr;
+	if (!jpeg.empty()) {
+		data = new std::vector<uint8_t>(std::move(jpeg));
+		arg3.type = Dart_CObject_kExternalTypedData;
+		arg3.value.as_external_typed_data = {
+			.type = Dart_TypedData_kUint8,
+			.length = (intptr_t)data->size(),
+			.data = data->data(),
+			.peer = data,
+			.callback = [](void * /*isolate_callback_data*/, void *peer) {
+				delete static_cast<std::vector<uint8_t> *>(peer);
+			},
+		};
+	}
+	const auto r = send_msg_to_flutter("on_still_captured", &arg1, &arg2, &arg3);
+	if (r && data) {
+		// 送信できなかった時はDart側が破棄しないのでここで破棄する
+		delete data;
+	}
+
+	RETURN(r, int);
+}
+
+/**
+ * 連写の完了イベントをnative portを使ってDartへ送信する
+ * action="on_burst_captured"
+ * @param device_id
+ * @param result 0: 成功, 負: エラーコード
+ * @param burst 撮影したフレーム, nullptrならnullを送る
+ * @return
+ */
+int send_on_burst_captured(const int32_t &device_id, const int32_t &result, std::shared_ptr<FrameBurst> burst) {
+	ENTER();
+
+	if (dart_api_message_port == -1) {
+		RETURN(-29, int);
+	}
+	Dart_CObject arg1 = {
+		.type = Dart_CObject_kInt32,
+		.value {
+			.as_int32 = device_id
+		}
+	};
+	Dart_CObject arg2 = {
+		.type = Dart_CObject_kInt32,
+		.value {
+			.as_int32 = result
+		}
+	};
+	Dart_CObject arg3 = {
+		.type = Dart_CObject_kNull,
+		.value {},
+	};
+	const uint32_t n = burst ? burst->size() : 0;
+	// 1フレームあたりpts_us, frame_type, width, height, dataの5要素
+	std::vector<Dart_CObject> values(n * 5);
+	std::vector<Dart_CObject *> value_ptrs(n * 5);
+	std::vector<Dart_CObject> frames(n);
+	std::vector<Dart_CObject *> frame_ptrs(n);
+	std::vector<std::shared_ptr<FrameBurst> *> peers;
+	if (burst) {
+		peers.reserve(n);
+		for (uint32_t i = 0; i < n; i++) {
+			const auto &frame = burst->at(i);
+			Dart_CObject *v = &values[i * 5];
+			v[0].type = Dart_CObject_kInt64;
+			v[0].value.as_int64 = frame.pts_us;
+			v[1].type = Dart_CObject_kInt32;
+			v[1].value.as_int32 = (int32_t)frame.frame_type;
+			v[2].type = Dart_CObject_kInt32;
+			v[2].value.as_int32 = (int32_t)frame.width;
+			v[3].type = Dart_CObject_kInt32;
+			v[3].value.as_int32 = (int32_t)frame.height;
+			// フレーム毎にburstへの参照を持たせてDart側で使っている間はスロットを破棄しない
+			auto peer = new std::shared_ptr<FrameBurst>(burst);
+			peers.push_back(peer);
+			v[4].type = Dart_CObject_kExternalTypedData;
+			v[4].value.as_external_typed_data = {
+				.type = Dart_TypedData_kUint8,
+				.length = (intptr_t)frame.len,
+				.data = const_cast<uint8_t *>(frame.data),
+				.peer = peer,
+				.callback = [](void * /*isolate_callback_data*/, void *peer) {
+					delete static_cast<std::shared_ptr<FrameBurst> *>(peer);
+				},
+			};
+			for (int j = 0; j < 5; j++) {
+				value_ptrs[i * 5 + j] = &v[j];
+			}
+			frames[i].type = Dart_CObject_kArray;
+			frames[i].value.as_array.length = 5;
+			frames[i].value.as_array.values = &value_ptrs[i * 5];
+			frame_ptrs[i] = &frames[i];
+		}
+		arg3.type = Dart_CObject_kArray;
+		arg3.value.as_array.length = n;
+		arg3.value.as_array.values = frame_ptrs.data();
+	}
+	const auto r = send_msg_to_flutter("on_burst_captured", &arg1, &arg2, &arg3);
+	if (r) {
+		// 送信できなかった時はDart側が破棄しないのでここで破棄する
+		for (auto peer : peers) {
+			delete peer;
+		}
+	}
+
+	RETURN(r, int);
+}
+
+/**
+ * 動きの有無が切り替わったイベントをnative portを使ってDartへ送信する
+ * action="on_motion"
+ * @param device_id
+ * @param motion true: 動きを検出した, false: 動きが無くなった
+ * @param changed_cells 切り替わったフレームで閾値を超えた区画の数
+ * @param peak 切り替わったフレームの区画の輝度の差分の平均の最大値
+ * @param pts_us 切り替わったフレームのPTS[マイクロ秒]
+ * @return
+ */
+int send_on_motion(
+	const int32_t &device_id, const bool &motion,
+	const uint32_t &changed_cells, const uint32_t &peak, const int64_t &pts_us) {
+	ENTER();
+
+	if (dart_api_message_port == -1) {
+		RETURN(-29, int);
+	}
+	Dart_CObject arg1 = {
+		.type = Dart_CObject_kInt32,
+		.value {
+			.as_int32 = device_id
+		}
+	};
+	Dart_CObject arg2 = {
+		.type = Dart_CObject_kBool,
+		.value {
+			.as_bool = motion
+		}
+	};
+	Dart_CObject arg3 = {
+		.type = Dart_CObject_kInt32,
+		.value {
+			.as_int32 = (int32_t)changed_cells
+		}
+	};
+	Dart_CObject arg4 = {
+		.type = Dart_CObject_kInt32,
+		.value {
+			.as_int32 = (int32_t)peak
+		}
+	};
+	Dart_CObject arg5 = {
+		.type = Dart_CObject_kInt64,
+		.value {
+			.as_int64 = pts_us
+		}
+	};
+	const auto r = send_msg_to_flutter("on_motion", &arg1, &arg2, &arg3, &arg4, &arg5);
+
+	RETURN(r, int);
+}
+
 }	// namespace serenegiant::flutter
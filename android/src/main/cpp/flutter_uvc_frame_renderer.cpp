@@ -25,6 +25,8 @@
 // Standard C/C++ headers (first to avoid conflicts)
 #include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
 
 // Android headers
 #include <android/log.h>
@@ -66,8 +68,17 @@ static int64_t getCurrentTimeNs() {
 FlutterUvcFrameRenderer::FlutterUvcFrameRenderer(usb_manager_t *manager,
                                                  int32_t device_id)
     : m_manager(manager), m_device_id(device_id), m_width(1280), m_height(720),
-      m_frame_type(RAW_FRAME_MJPEG), m_preview_window(nullptr),
-      m_recording_window(nullptr), m_start_time_ns(0) {
+      m_frame_type(RAW_FRAME_MJPEG),
+      m_consumers(
+          [manager, device_id] { return uvc_start(manager, device_id); },
+          [manager, device_id] { return uvc_stop(manager, device_id); }),
+      m_preview_window(nullptr), m_recording_window(nullptr),
+      m_headless(false), m_preview_request_width(0),
+      m_preview_request_height(0), m_recording_request_width(0),
+      m_recording_request_height(0), m_frame_callback_id(0),
+      m_subscriptions(device_id), m_start_time_ns(0), m_prewarmed(false),
+      m_prewarm_width(0), m_prewarm_height(0),
+      m_prewarm_frame_type(RAW_FRAME_UNKNOWN), m_switch_requested_ns(0) {
   LOGD("FlutterUvcFrameRenderer created for device %d", device_id);
 }
 
@@ -77,6 +88,81 @@ FlutterUvcFrameRenderer::FlutterUvcFrameRenderer(usb_manager_t *manager,
 FlutterUvcFrameRenderer::~FlutterUvcFrameRenderer() {
   LOGD("FlutterUvcFrameRenderer destructor");
   stop();
+  // Wait for subscriber calls still running on the pool
+  m_subscriptions.clear();
+}
+
+//------------------------------------------------------------------------------
+// Prepare everything the first frame needs before start()
+//------------------------------------------------------------------------------
+int FlutterUvcFrameRenderer::prewarm(uint32_t width, uint32_t height,
+                                     uint32_t frame_type) {
+  LOGD("prewarm: %dx%d, frame_type=%d", width, height, frame_type);
+
+  if (m_is_running) {
+    LOGW("Already running");
+    return -1;
+  }
+  // Only reported by LOGD, unused in release builds
+  [[maybe_unused]] const int64_t begin_ns = getCurrentTimeNs();
+  m_prewarmed = false;
+
+  // Spawn the shared pool workers now rather than on the first frame
+  TaskPool::get_instance();
+
+  bool replaying;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    replaying = m_replay_source != nullptr;
+  }
+  if (!replaying) {
+    // Format negotiation is the slowest part of the first start()
+    const int result =
+        uvc_resize(m_manager, m_device_id, frame_type, width, height);
+    if (result != 0) {
+      LOGE("Failed to set video size: %d", result);
+      return -2;
+    }
+  }
+
+  // resize() zero fills, so the pages are faulted in here and not while the
+  // first frame is decoded
+  m_frame_buffer.resize(frameBufferBytes(frame_type, width, height));
+  m_rgb_buffer.resize((size_t)width * height * 4);
+  if (frame_type == RAW_FRAME_MJPEG && !m_mjpeg_decoder) {
+    m_mjpeg_decoder = std::make_unique<MjpegDecoder>();
+  }
+
+  // Windows already set get their buffer geometry and scaled buffer
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto prepare = [&](ANativeWindow *window, uint32_t req_width,
+                       uint32_t req_height, std::vector<uint8_t> &scaled) {
+      if (!window) {
+        return;
+      }
+      const bool scale = req_width && req_height &&
+                         (req_width != width || req_height != height);
+      const uint32_t w = scale ? req_width : width;
+      const uint32_t h = scale ? req_height : height;
+      ANativeWindow_setBuffersGeometry(window, w, h, WINDOW_FORMAT_RGBA_8888);
+      if (scale) {
+        scaled.resize((size_t)w * h * 4);
+      }
+    };
+    prepare(activePreviewLocked(), m_preview_request_width,
+            m_preview_request_height, m_preview_buffer);
+    prepare(m_recording_window, m_recording_request_width,
+            m_recording_request_height, m_recording_buffer);
+  }
+
+  m_prewarm_width = width;
+  m_prewarm_height = height;
+  m_prewarm_frame_type = frame_type;
+  m_prewarmed = true;
+  LOGD("prewarmed in %lld us",
+       (long long)((getCurrentTimeNs() - begin_ns) / 1000));
+  return 0;
 }
 
 //------------------------------------------------------------------------------
@@ -96,24 +182,53 @@ int FlutterUvcFrameRenderer::start(uint32_t width, uint32_t height,
   m_frame_type = frame_type;
   m_frame_count = 0;
   m_start_time_ns = getCurrentTimeNs();
+  m_time_to_first_frame_ns = 0;
+  m_clock.reset();
+  m_dedup.invalidate();
+  // The device keeps the format negotiated by prewarm() until it is resized
+  const bool prewarmed = m_prewarmed && m_prewarm_width == width &&
+                         m_prewarm_height == height &&
+                         m_prewarm_frame_type == frame_type;
+  m_prewarmed = false;
 
   // Allocate frame buffers
-  // For YUV420: width * height * 1.5
-  // For YUYV: width * height * 2
-  // For MJPEG: variable, allocate generously
-  size_t buffer_size = width * height * 3; // Generous allocation
-  m_frame_buffer.resize(buffer_size);
+  m_frame_buffer.resize(frameBufferBytes(frame_type, width, height));
   m_rgb_buffer.resize(width * height * 4); // RGBA
 
+  if (frame_type == RAW_FRAME_MJPEG && !m_mjpeg_decoder) {
+    m_mjpeg_decoder = std::make_unique<MjpegDecoder>();
+  }
+
+  std::shared_ptr<FrameReplaySource> replay;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    replay = m_replay_source;
+  }
+  m_replaying = replay != nullptr;
+  if (replay) {
+    // Frames come from the capture file, the device is left untouched and
+    // never suspended
+    m_is_running = true;
+    m_capture_thread = std::thread(&FlutterUvcFrameRenderer::captureLoop, this);
+    LOGD("Frame replay started");
+    return 0;
+  }
+
   // Request video size from UVC device
-  int result = uvc_resize(m_manager, m_device_id, frame_type, width, height);
+  int result = prewarmed ? 0
+                         : uvc_resize(m_manager, m_device_id, frame_type,
+                                      width, height);
   if (result != 0) {
     LOGE("Failed to set video size: %d", result);
     return -2;
   }
 
-  // Start UVC streaming
-  result = uvc_start(m_manager, m_device_id);
+  // Start UVC streaming, suspended after the idle timeout while nothing
+  // consumes the frames
+  {
+    std::lock_guard<std::mutex> lock(m_consumer_mutex);
+    result = m_consumers.start();
+  }
   if (result != 0) {
     LOGE("Failed to start UVC: %d", result);
     return -3;
@@ -134,19 +249,33 @@ int FlutterUvcFrameRenderer::start(uint32_t width, uint32_t height,
 void FlutterUvcFrameRenderer::stop() {
   LOGD("stop");
 
-  if (!m_is_running) {
-    return;
+  // Clearing the flag and draining under the lock that reconfigure() stores
+  // the switch under, so that no switch is left waiting after the drain
+  std::unique_ptr<PendingConfig> pending;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_is_running) {
+      return;
+    }
+    m_is_running = false;
+    pending = std::move(m_pending_config);
+  }
+  // A switch requested right before stopping is never applied
+  if (pending) {
+    pending->done.set_value(-1);
   }
-
-  m_is_running = false;
 
   // Wait for capture thread
   if (m_capture_thread.joinable()) {
     m_capture_thread.join();
   }
+  m_switch_requested_ns = 0;
 
-  // Stop UVC streaming
-  uvc_stop(m_manager, m_device_id);
+  // Stop UVC streaming, already stopped if suspended
+  if (!m_replaying) {
+    std::lock_guard<std::mutex> lock(m_consumer_mutex);
+    m_consumers.stop();
+  }
 
   // Clear buffers
   m_frame_buffer.clear();
@@ -155,53 +284,322 @@ void FlutterUvcFrameRenderer::stop() {
   LOGD("Frame capture stopped, frames: %lld", (long long)m_frame_count.load());
 }
 
+//------------------------------------------------------------------------------
+// Switch resolution/format while running
+//------------------------------------------------------------------------------
+int FlutterUvcFrameRenderer::reconfigure(uint32_t width, uint32_t height,
+                                         uint32_t frame_type) {
+  LOGD("reconfigure: %dx%d, frame_type=%d", width, height, frame_type);
+
+  if (!m_is_running) {
+    LOGW("Not running");
+    return -1;
+  }
+
+  // Allocate everything here so that the capture loop only swaps pointers
+  auto config = std::make_unique<PendingConfig>();
+  config->width = width;
+  config->height = height;
+  config->frame_type = frame_type;
+  config->frame_buffer.resize(frameBufferBytes(frame_type, width, height));
+  config->rgb_buffer.resize((size_t)width * height * 4);
+  if (frame_type == RAW_FRAME_MJPEG) {
+    config->mjpeg_decoder = std::make_unique<MjpegDecoder>();
+  }
+  config->requested_ns = getCurrentTimeNs();
+  auto done = config->done.get_future();
+
+  std::unique_ptr<PendingConfig> prev;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Checked again here, stop() may have drained the switches since
+    if (!m_is_running) {
+      LOGW("Stopped before the switch was queued");
+      return -1;
+    }
+    prev = std::move(m_pending_config);
+    m_pending_config = std::move(config);
+  }
+  if (prev) {
+    // Superseded before the capture loop got to it
+    prev->done.set_value(-1);
+  }
+
+  return done.get();
+}
+
 //------------------------------------------------------------------------------
 // Set preview window
 //------------------------------------------------------------------------------
-void FlutterUvcFrameRenderer::setPreviewWindow(ANativeWindow *window) {
-  std::lock_guard<std::mutex> lock(m_mutex);
+void FlutterUvcFrameRenderer::setPreviewWindow(ANativeWindow *window,
+                                               uint32_t width,
+                                               uint32_t height) {
+  std::lock_guard<std::mutex> consumer_lock(m_consumer_mutex);
+  std::unique_lock<std::mutex> lock(m_mutex);
 
+  const bool attached = activePreviewLocked() != nullptr;
   if (m_preview_window) {
     ANativeWindow_release(m_preview_window);
   }
 
   m_preview_window = window;
+  m_preview_request_width = width;
+  m_preview_request_height = height;
 
   if (window) {
     ANativeWindow_acquire(window);
-    // Set buffer format
-    ANativeWindow_setBuffersGeometry(window, m_width, m_height,
+    // Set buffer format at the preview size instead of the camera size
+    ANativeWindow_setBuffersGeometry(window, width ? width : m_width,
+                                     height ? height : m_height,
                                      WINDOW_FORMAT_RGBA_8888);
   }
 
-  LOGD("Preview window set: %p", window);
+  // A new window has no frame yet even if the camera's is unchanged
+  m_dedup.invalidate();
+  LOGD("Preview window set: %p (%ux%u)", window, width, height);
+  const bool attach = activePreviewLocked() != nullptr;
+  lock.unlock();
+  updateConsumer(CONSUMER_PREVIEW, attached, attach);
 }
 
 //------------------------------------------------------------------------------
-// Set recording window
+// Headless mode
 //------------------------------------------------------------------------------
-void FlutterUvcFrameRenderer::setRecordingWindow(ANativeWindow *window) {
+void FlutterUvcFrameRenderer::setHeadless(bool headless) {
+  std::lock_guard<std::mutex> consumer_lock(m_consumer_mutex);
+  bool attached, attach;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    attached = activePreviewLocked() != nullptr;
+    m_headless = headless;
+    attach = activePreviewLocked() != nullptr;
+  }
+  m_dedup.invalidate();
+  // A hidden preview does not keep the device streaming
+  updateConsumer(CONSUMER_PREVIEW, attached, attach);
+
+  LOGD("Headless mode: %d", headless);
+}
+
+bool FlutterUvcFrameRenderer::isHeadless() {
   std::lock_guard<std::mutex> lock(m_mutex);
+  return m_headless;
+}
+
+//------------------------------------------------------------------------------
+// Set recording window
+//------------------------------------------------------------------------------
+void FlutterUvcFrameRenderer::setRecordingWindow(ANativeWindow *window,
+                                                 uint32_t width,
+                                                 uint32_t height) {
+  std::lock_guard<std::mutex> consumer_lock(m_consumer_mutex);
+  std::unique_lock<std::mutex> lock(m_mutex);
 
+  const bool attached = m_recording_window != nullptr;
   if (m_recording_window) {
     ANativeWindow_release(m_recording_window);
   }
 
   m_recording_window = window;
+  m_recording_request_width = width;
+  m_recording_request_height = height;
 
   if (window) {
     ANativeWindow_acquire(window);
   }
 
-  LOGD("Recording window set: %p", window);
+  m_dedup.invalidate();
+  LOGD("Recording window set: %p (%ux%u)", window, width, height);
+  lock.unlock();
+  updateConsumer(CONSUMER_RECORDING, attached, window != nullptr);
+}
+
+//------------------------------------------------------------------------------
+// Set window crops, picked up by the next frame
+//------------------------------------------------------------------------------
+void FlutterUvcFrameRenderer::setPreviewCrop(const FrameRect &crop) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_preview_crop = crop;
+  m_dedup.invalidate();
+  LOGD("Preview crop: (%u,%u) %ux%u", crop.x, crop.y, crop.width,
+       crop.height);
+}
+
+void FlutterUvcFrameRenderer::setRecordingCrop(const FrameRect &crop) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_recording_crop = crop;
+  m_dedup.invalidate();
+  LOGD("Recording crop: (%u,%u) %ux%u", crop.x, crop.y, crop.width,
+       crop.height);
+}
+
+//------------------------------------------------------------------------------
+// Set window orientations, picked up by the next frame
+//------------------------------------------------------------------------------
+int FlutterUvcFrameRenderer::setPreviewOrientation(
+    const FrameOrientation &orientation) {
+  if (!orientation.valid()) {
+    return -EINVAL;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_preview_orientation = orientation;
+  m_dedup.invalidate();
+  LOGD("Preview orientation: %u, mirror %d/%d", orientation.rotation,
+       orientation.mirror_h, orientation.mirror_v);
+  return 0;
+}
+
+int FlutterUvcFrameRenderer::setRecordingOrientation(
+    const FrameOrientation &orientation) {
+  if (!orientation.valid()) {
+    return -EINVAL;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_recording_orientation = orientation;
+  m_dedup.invalidate();
+  LOGD("Recording orientation: %u, mirror %d/%d", orientation.rotation,
+       orientation.mirror_h, orientation.mirror_v);
+  return 0;
 }
 
 //------------------------------------------------------------------------------
 // Set frame callback
 //------------------------------------------------------------------------------
 void FlutterUvcFrameRenderer::setFrameCallback(FrameCallback callback) {
+  std::lock_guard<std::mutex> consumer_lock(m_consumer_mutex);
+  const bool attached = m_subscriptions.size() > 0;
+  if (m_frame_callback_id > 0) {
+    // Waits for a running call before the callback is replaced
+    m_subscriptions.unsubscribe(m_frame_callback_id);
+    m_frame_callback_id = 0;
+  }
+  m_frame_callback = std::move(callback);
+  if (m_frame_callback) {
+    SubscriberOptions options;
+    options.format = FrameFormat::Raw;
+    options.mode = DispatchMode::Pool;
+    m_frame_callback_id =
+        m_subscriptions.subscribe(options, m_frame_callback_adapter);
+  }
+  updateConsumer(CONSUMER_ANALYSIS, attached, m_subscriptions.size() > 0);
+}
+
+//------------------------------------------------------------------------------
+// Frame subscribers
+//------------------------------------------------------------------------------
+int32_t FlutterUvcFrameRenderer::subscribe(const SubscriberOptions &options,
+                                           FrameFunctionRef callback) {
+  std::lock_guard<std::mutex> consumer_lock(m_consumer_mutex);
+  const bool attached = m_subscriptions.size() > 0;
+  const int32_t id = m_subscriptions.subscribe(options, callback);
+  if (id > 0) {
+    updateConsumer(CONSUMER_ANALYSIS, attached, true);
+  }
+  return id;
+}
+
+int FlutterUvcFrameRenderer::unsubscribe(int32_t id) {
+  std::lock_guard<std::mutex> consumer_lock(m_consumer_mutex);
+  const bool attached = m_subscriptions.size() > 0;
+  const int result = m_subscriptions.unsubscribe(id);
+  if (result == 0) {
+    updateConsumer(CONSUMER_ANALYSIS, attached, m_subscriptions.size() > 0);
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+// Start recording frames into a capture file
+//------------------------------------------------------------------------------
+int FlutterUvcFrameRenderer::startCapture(const std::string &path) {
+  auto writer = std::make_shared<FrameCaptureWriter>();
+  int result = writer->open(path);
+  if (result != 0) {
+    LOGE("Failed to open capture file %s: %d", path.c_str(), result);
+    return result;
+  }
+
+  std::shared_ptr<FrameCaptureWriter> prev;
+  {
+    std::lock_guard<std::mutex> consumer_lock(m_consumer_mutex);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      prev = std::move(m_capture_writer);
+      m_capture_writer = writer;
+    }
+    // The capture file records every frame like a recording
+    updateConsumer(CONSUMER_RECORDING, prev != nullptr, true);
+  }
+  if (prev) {
+    prev->close();
+  }
+
+  LOGD("Capture started: %s", path.c_str());
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+// Stop recording frames
+//------------------------------------------------------------------------------
+int FlutterUvcFrameRenderer::stopCapture() {
+  std::shared_ptr<FrameCaptureWriter> writer;
+  {
+    std::lock_guard<std::mutex> consumer_lock(m_consumer_mutex);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      writer = std::move(m_capture_writer);
+    }
+    updateConsumer(CONSUMER_RECORDING, writer != nullptr, false);
+  }
+  if (!writer) {
+    return 0;
+  }
+
+  LOGD("Capture stopped, frames: %u", writer->num_frames());
+  return writer->close();
+}
+
+//------------------------------------------------------------------------------
+// Set replay source
+//------------------------------------------------------------------------------
+void FlutterUvcFrameRenderer::setReplaySource(
+    std::shared_ptr<FrameReplaySource> source) {
+  if (m_is_running) {
+    LOGW("Replay source must be set before start");
+    return;
+  }
+
   std::lock_guard<std::mutex> lock(m_mutex);
-  m_frame_callback = callback;
+  m_replay_source = std::move(source);
+}
+
+//------------------------------------------------------------------------------
+// Explicit consumers
+//------------------------------------------------------------------------------
+int FlutterUvcFrameRenderer::acquireConsumer(consumer_type_t type) {
+  std::lock_guard<std::mutex> lock(m_consumer_mutex);
+  return m_consumers.acquire(type);
+}
+
+int FlutterUvcFrameRenderer::releaseConsumer(consumer_type_t type) {
+  std::lock_guard<std::mutex> lock(m_consumer_mutex);
+  return m_consumers.release(type);
+}
+
+void FlutterUvcFrameRenderer::setIdleTimeout(int64_t timeout_ms) {
+  m_consumers.set_idle_timeout(timeout_ms);
+}
+
+//------------------------------------------------------------------------------
+// Implicit consumers, called with m_consumer_mutex held
+//------------------------------------------------------------------------------
+void FlutterUvcFrameRenderer::updateConsumer(consumer_type_t type,
+                                             bool attached, bool attach) {
+  if (attach && !attached) {
+    m_consumers.acquire(type);
+  } else if (!attach && attached) {
+    m_consumers.release(type);
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -220,24 +618,114 @@ float FlutterUvcFrameRenderer::getFrameRate() const {
   return (float)m_frame_count.load() * 1e9f / (float)elapsed_ns;
 }
 
+//------------------------------------------------------------------------------
+// Frame buffer size
+//------------------------------------------------------------------------------
+size_t FlutterUvcFrameRenderer::frameBufferBytes(uint32_t frame_type,
+                                                 uint32_t width,
+                                                 uint32_t height) {
+  // Uncompressed formats need exactly one frame (RGBX is 4 bytes per pixel),
+  // MJPEG is variable so allocate generously
+  return std::max((size_t)width * height * 3,
+                  rawFrameBytes(frame_type, width, height));
+}
+
+//------------------------------------------------------------------------------
+// Apply the configuration prepared by reconfigure()
+//------------------------------------------------------------------------------
+void FlutterUvcFrameRenderer::applyPendingConfig() {
+  std::unique_ptr<PendingConfig> config;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    config = std::move(m_pending_config);
+  }
+  if (!config) {
+    return;
+  }
+
+  // The device only accepts a new size while stopped, restart just the
+  // stream (a suspended device is resized without starting it)
+  int result = 0;
+  if (!m_replaying) {
+    int resized = 0;
+    const int restarted = m_consumers.restart([&] {
+      resized = uvc_resize(m_manager, m_device_id, config->frame_type,
+                           config->width, config->height);
+      return resized;
+    });
+    if (resized != 0) {
+      LOGE("Failed to set video size: %d", resized);
+      config->done.set_value(-2);
+      return;
+    }
+    if (restarted != 0) {
+      LOGE("Failed to restart UVC: %d", restarted);
+      result = -3;
+    }
+  }
+
+  m_frame_buffer.swap(config->frame_buffer);
+  m_rgb_buffer.swap(config->rgb_buffer);
+  if (config->mjpeg_decoder && !m_mjpeg_decoder) {
+    m_mjpeg_decoder = std::move(config->mjpeg_decoder);
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_width = config->width;
+    m_height = config->height;
+    m_frame_type = config->frame_type;
+    // Windows following the camera resolution keep their surface, only the
+    // buffer geometry changes
+    if (m_preview_window &&
+        (!m_preview_request_width || !m_preview_request_height)) {
+      ANativeWindow_setBuffersGeometry(m_preview_window, m_width, m_height,
+                                       WINDOW_FORMAT_RGBA_8888);
+    }
+    if (m_recording_window &&
+        (!m_recording_request_width || !m_recording_request_height)) {
+      ANativeWindow_setBuffersGeometry(m_recording_window, m_width, m_height,
+                                       WINDOW_FORMAT_RGBA_8888);
+    }
+  }
+  // The device clock starts over with the stream
+  m_clock.reset();
+  m_switch_requested_ns = config->requested_ns;
+  config->done.set_value(result);
+
+  LOGD("Switched to %ux%u, frame_type=%u", m_width, m_height, m_frame_type);
+}
+
 //------------------------------------------------------------------------------
 // Main capture loop
 //------------------------------------------------------------------------------
 void FlutterUvcFrameRenderer::captureLoop() {
   LOGD("Capture loop started");
 
+  char name[THREAD_NAME_LEN];
+  snprintf(name, sizeof(name), "uvc%d-capture", m_device_id);
+  PipelineThread thread(m_device_id, name);
+
   while (m_is_running) {
+    thread.update();
+    applyPendingConfig();
+    if (m_consumers.is_suspended()) {
+      // Nobody consumes the frames, wait until a consumer resumes streaming
+      m_consumers.wait_resumed(10);
+      continue;
+    }
     // Get frame from UVC camera
-    uint32_t frame_type = m_frame_type;
+    // MJPEG is requested undecoded so that decodeFrame can pick the IDCT
+    // scale for the current consumers
+    uint32_t frame_type = m_frame_type == RAW_FRAME_MJPEG
+                              ? (uint32_t)RAW_FRAME_UNKNOWN
+                              : m_frame_type;
     uint32_t width = m_width;
     uint32_t height = m_height;
     uint32_t data_len = m_frame_buffer.size();
     int64_t pts_us = 0;
     uint32_t flags = 0;
 
-    int result =
-        uvc_get_frame(m_manager, m_device_id, &frame_type, &width, &height,
-                      m_frame_buffer.data(), &data_len, &pts_us, &flags);
+    int result = fetchFrame(frame_type, width, height, data_len, pts_us, flags);
 
     if (result != 0 || data_len == 0) {
       // No frame available, wait a bit
@@ -246,30 +734,179 @@ void FlutterUvcFrameRenderer::captureLoop() {
     }
 
     m_frame_count++;
-
-    // Convert to displayable format (YUV->RGB)
-    convertYuvToRgb(m_frame_buffer.data(), m_rgb_buffer.data(), width, height);
-
+    // Replayed frames are already paced by the replay source, so only device
+    // frames go through the clock model
+    const int64_t arrival_ns = PtsClockModel::monotonic_ns();
+    const int64_t timestamp_ns =
+        m_clock.update(m_replaying ? 0 : pts_us, arrival_ns);
+    latency_stamp_t stamp;
+    const bool probe =
+        !m_replaying && m_latency.begin(m_frame_buffer.data(), data_len, stamp);
+    if (probe) {
+      m_latency.record(LATENCY_STAGE_FETCH, stamp, arrival_ns);
+    }
+    // A frame repeating the previous one is not rendered again, the windows
+    // still show it and the encoder repeats it on its own
+    const bool duplicate = m_dedup.isDuplicate(
+        frame_type, m_frame_buffer.data(), data_len, width, height);
+    // The first frame at the new size ends a switch
+    const bool switched = m_switch_requested_ns && width == m_width &&
+                          height == m_height;
+
+    // Take the consumers for this frame, the windows are held so that they
+    // stay valid while the pool renders into them
+    ANativeWindow *preview_window;
+    ANativeWindow *recording_window;
+    uint32_t preview_width, preview_height;
+    uint32_t recording_width, recording_height;
+    FrameRect preview_crop, recording_crop;
+    FrameOrientation preview_orientation, recording_orientation;
     {
       std::lock_guard<std::mutex> lock(m_mutex);
-
-      // Render to preview window
-      if (m_preview_window) {
-        renderToWindow(m_preview_window, m_rgb_buffer.data(), width, height);
+      preview_window = activePreviewLocked();
+      recording_window = m_recording_window;
+      preview_width = m_preview_request_width;
+      preview_height = m_preview_request_height;
+      recording_width = m_recording_request_width;
+      recording_height = m_recording_request_height;
+      preview_crop = m_preview_crop;
+      recording_crop = m_recording_crop;
+      preview_orientation = m_preview_orientation;
+      recording_orientation = m_recording_orientation;
+      if (preview_window) {
+        ANativeWindow_acquire(preview_window);
       }
+      if (recording_window) {
+        ANativeWindow_acquire(recording_window);
+      }
+    }
 
-      // Render to recording window (if recording)
-      if (m_recording_window) {
-        renderToWindow(m_recording_window, m_rgb_buffer.data(), width, height);
+    // Subscribers due for this frame, the list is a snapshot so that
+    // (un)subscribing never blocks the capture thread
+    const auto subscribers = m_subscriptions.snapshot();
+    RgbaDemand rgba{};
+    const bool subscribed =
+        !subscribers->empty() &&
+        m_subscriptions.schedule(subscribers, timestamp_ns, width, height,
+                                 rgba);
+    const FrameView raw_frame = {m_frame_buffer.data(), data_len, frame_type,
+                                 width, height, timestamp_ns / 1000};
+    auto on_deliver = [&] {
+      if (probe) {
+        m_latency.record(LATENCY_STAGE_CALLBACK, stamp);
+      }
+    };
+
+    // Decode/convert and then fan out to the consumers on the shared pool,
+    // recording goes before preview and preview before analysis. Raw frame
+    // subscribers take the fetched frame, so nothing is converted unless a
+    // window or a RGBA subscriber needs pixels and the windows only need
+    // pixels of a new frame.
+    TaskGroup group(TaskPool::get_instance(), m_device_id);
+    int decoded = 0;
+    // Crops are given in camera pixels, decodeFrame replaces width/height
+    // with the decoded size
+    const uint32_t source_width = width;
+    const uint32_t source_height = height;
+    FrameRect region;
+    FrameOrientation orientation;
+    const bool render = !duplicate && (preview_window || recording_window);
+    const bool convert = render || rgba.due;
+    // Outside the branch, the task reads it until group.wait() returns
+    const task_priority_t decode_priority =
+        recording_window ? TASK_PRIORITY_RECORDING
+        : preview_window ? TASK_PRIORITY_PREVIEW
+                         : TASK_PRIORITY_ANALYSIS;
+    if (convert) {
+      group.run(decode_priority, [&] {
+        // Convert to displayable format (MJPEG/YUV->RGB)
+        decoded = decodeFrame(frame_type, data_len, width, height, region,
+                              orientation, decode_priority, rgba);
+      });
+    }
+    if (subscribed) {
+      // The fetched frame is only read while decoding, inline subscribers run
+      // on the capture thread meanwhile
+      m_subscriptions.dispatch(subscribers, raw_frame, on_deliver);
+    }
+    if (convert) {
+      group.wait();
+      if (probe && decoded == 0) {
+        m_latency.record(LATENCY_STAGE_CONVERT, stamp);
       }
+      if (decoded != 0) {
+        // The windows did not get this frame, do not skip its repeats
+        m_dedup.invalidate();
+      }
+    }
 
-      // Call frame callback if set
-      if (m_frame_callback) {
-        m_frame_callback(m_frame_buffer.data(), data_len, width, height,
-                         pts_us);
+    if (decoded == 0) {
+      const DecodedFrame frame = {m_rgb_buffer.data(), width, height, region,
+                                  source_width, source_height,
+                                  timestamp_ns / 1000, orientation};
+      if (recording_window && render) {
+        // The encoder stamps frames when they are posted, hold the frame
+        // until the smoothed timeline so that the jitter does not reach it.
+        // The capture thread waits, a pool worker shared by all devices must
+        // not sleep.
+        const int64_t delay_ns = m_clock.pacing_target_ns(timestamp_ns) -
+                                 PtsClockModel::monotonic_ns();
+        if (delay_ns > 0) {
+          std::this_thread::sleep_for(std::chrono::nanoseconds(delay_ns));
+        }
+        group.run(TASK_PRIORITY_RECORDING, [&] {
+          renderScaled(recording_window, frame, recording_crop,
+                       recording_orientation, recording_width,
+                       recording_height, m_recording_buffer);
+          if (probe) {
+            m_latency.record(LATENCY_STAGE_RECORDING, stamp);
+          }
+        });
+      }
+      if (preview_window && render) {
+        group.run(TASK_PRIORITY_PREVIEW, [&] {
+          renderScaled(preview_window, frame, preview_crop,
+                       preview_orientation, preview_width, preview_height,
+                       m_preview_buffer);
+          if (probe) {
+            m_latency.record(LATENCY_STAGE_PREVIEW, stamp);
+          }
+        });
+      }
+      if (convert && rgba.due) {
+        // Inline subscribers run here while the pool renders
+        m_subscriptions.dispatch(subscribers, frame, on_deliver);
+      }
+      group.wait();
+      if (!m_time_to_first_frame_ns &&
+          (preview_window || recording_window || subscribed)) {
+        m_time_to_first_frame_ns = getCurrentTimeNs() - m_start_time_ns;
+        LOGD("Time to first frame: %lld us",
+             (long long)(m_time_to_first_frame_ns.load() / 1000));
       }
     }
 
+    if (preview_window) {
+      ANativeWindow_release(preview_window);
+    } else if (!m_preview_buffer.empty()) {
+      // Headless or detached, drop the preview-only scaled frame
+      std::vector<uint8_t>().swap(m_preview_buffer);
+    }
+    if (recording_window) {
+      ANativeWindow_release(recording_window);
+    } else if (!preview_window && !m_rgb_buffer.empty() &&
+               !FrameSubscriptions::wantsRgba(subscribers)) {
+      // Nothing renders, the decoded frame is reallocated on demand
+      std::vector<uint8_t>().swap(m_rgb_buffer);
+    }
+
+    if (switched) {
+      m_switch_latency_ns = getCurrentTimeNs() - m_switch_requested_ns;
+      m_switch_requested_ns = 0;
+      LOGD("Switch latency: %lld us",
+           (long long)(m_switch_latency_ns.load() / 1000));
+    }
+
     // Log FPS periodically
     if (m_frame_count % 100 == 0) {
       LOGD("Frame %lld, FPS: %.1f", (long long)m_frame_count.load(),
@@ -280,23 +917,206 @@ void FlutterUvcFrameRenderer::captureLoop() {
   LOGD("Capture loop ended");
 }
 
+//------------------------------------------------------------------------------
+// Get the next frame from the replay source or the device
+//------------------------------------------------------------------------------
+int FlutterUvcFrameRenderer::fetchFrame(uint32_t &frame_type, uint32_t &width,
+                                        uint32_t &height, uint32_t &data_len,
+                                        int64_t &pts_us, uint32_t &flags) {
+  std::shared_ptr<FrameReplaySource> replay;
+  std::shared_ptr<FrameCaptureWriter> writer;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    replay = m_replay_source;
+    writer = m_capture_writer;
+  }
+
+  int result;
+  if (replay) {
+    result = replay->next(&frame_type, &width, &height, m_frame_buffer.data(),
+                          &data_len, &pts_us, &flags);
+  } else {
+    result = uvc_get_frame(m_manager, m_device_id, &frame_type, &width,
+                           &height, m_frame_buffer.data(), &data_len, &pts_us,
+                           &flags);
+  }
+
+  if (result == 0 && writer) {
+    writer->write(frame_type, width, height, m_frame_buffer.data(), data_len,
+                  pts_us, flags);
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+// Decode captured frame
+//------------------------------------------------------------------------------
+int FlutterUvcFrameRenderer::decodeFrame(uint32_t frame_type, uint32_t data_len,
+                                         uint32_t &width, uint32_t &height,
+                                         FrameRect &region,
+                                         FrameOrientation &orientation,
+                                         task_priority_t priority,
+                                         const RgbaDemand &subscribers) {
+  // Decode just the part of the frame the consumers look at, and just enough
+  // pixels of it for the largest consumer. Full resolution is decoded only
+  // when a consumer needs it.
+  uint32_t dst_width = 0, dst_height = 0;
+  FrameRect crop;
+  orientation = FrameOrientation();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ANativeWindow *preview_window = activePreviewLocked();
+    if (!m_recording_window && !preview_window && !subscribers.due) {
+      // Nobody needs pixels, raw subscribers get the fetched data
+      region = FrameRect();
+      return 0;
+    }
+    bool full = subscribers.due && subscribers.full;
+    if (subscribers.due) {
+      dst_width = subscribers.width;
+      dst_height = subscribers.height;
+      crop = subscribers.region;
+    }
+    auto require = [&](ANativeWindow *window, const FrameRect &window_crop,
+                       const FrameOrientation &window_orientation,
+                       uint32_t w, uint32_t h) {
+      if (!window) {
+        return;
+      }
+      const FrameRect clipped = clipRect(window_crop, width, height);
+      crop = unionRect(crop, clipped);
+      if (!w || !h || clipped.empty()) {
+        full = true;
+        return;
+      }
+      // The output size is oriented, the crop is not
+      uint32_t crop_width, crop_height;
+      orientedSize(window_orientation, w, h, crop_width, crop_height);
+      uint32_t frame_width, frame_height;
+      frameSizeForCrop(clipped, width, height, crop_width, crop_height,
+                       frame_width, frame_height);
+      dst_width = std::max(dst_width, frame_width);
+      dst_height = std::max(dst_height, frame_height);
+    };
+    require(preview_window, m_preview_crop, m_preview_orientation,
+            m_preview_request_width, m_preview_request_height);
+    require(m_recording_window, m_recording_crop, m_recording_orientation,
+            m_recording_request_width, m_recording_request_height);
+    if (full) {
+      dst_width = dst_height = 0;
+    }
+    // The conversion stores the frame in the orientation of the most time
+    // critical window, the others turn it while copying it into their window
+    if (m_recording_window) {
+      orientation = m_recording_orientation;
+    } else if (preview_window) {
+      orientation = m_preview_orientation;
+    }
+  }
+
+  if (frame_type != RAW_FRAME_MJPEG || !m_mjpeg_decoder) {
+    region = alignConvertRegion(frame_type, width, height, crop);
+    m_rgb_buffer.resize((size_t)region.width * region.height * 4);
+    uint32_t stored_width, stored_height;
+    orientedSize(orientation, region.width, region.height, stored_width,
+                 stored_height);
+    // 4K frames are split into stripes that idle pool workers steal
+    const int result = convertRegionToRgbaParallel(
+        TaskPool::get_instance(), m_device_id, priority, frame_type,
+        m_frame_buffer.data(), data_len, width, height, region, orientation,
+        m_rgb_buffer.data(), stored_width * 4);
+    if (result != 0) {
+      LOGW("Failed to convert frame 0x%08x: %d", frame_type, result);
+    }
+    return result;
+  }
+
+  // libjpeg decodes upright
+  orientation = FrameOrientation();
+  const int result = m_mjpeg_decoder->decode(
+      m_frame_buffer.data(), data_len, dst_width, dst_height, crop,
+      m_rgb_buffer, width, height, region);
+  if (result != 0) {
+    LOGW("Failed to decode MJPEG frame: %d", result);
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+// Crop, scale to consumer output size and render
+// The scale works in the orientation the frame is stored with, what is left
+// of the consumer's orientation is applied by the copy into the window.
+//------------------------------------------------------------------------------
+void FlutterUvcFrameRenderer::renderScaled(ANativeWindow *window,
+                                           const DecodedFrame &frame,
+                                           const FrameRect &crop,
+                                           const FrameOrientation &orientation,
+                                           uint32_t req_width,
+                                           uint32_t req_height,
+                                           std::vector<uint8_t> &scaled) {
+  const uint8_t *data;
+  const FrameRect rect = locateCrop(frame, crop, data);
+  const uint32_t stride = frame.stride();
+  uint32_t stored_width, stored_height;
+  orientedSize(frame.orientation, rect.width, rect.height, stored_width,
+               stored_height);
+  const FrameOrientation turn =
+      relativeOrientation(frame.orientation, orientation);
+  uint32_t scaled_width = stored_width, scaled_height = stored_height;
+  if (req_width && req_height) {
+    orientedSize(turn, req_width, req_height, scaled_width, scaled_height);
+  }
+  if (scaled_width == stored_width && scaled_height == stored_height) {
+    renderToWindow(window, data, stored_width, stored_height, stride, turn);
+    return;
+  }
+
+  scaled.resize((size_t)scaled_width * scaled_height * 4);
+  if (scaleRgba(data, stored_width, stored_height, stride, scaled.data(),
+                scaled_width, scaled_height, scaled_width * 4) == 0) {
+    renderToWindow(window, scaled.data(), scaled_width, scaled_height,
+                   scaled_width * 4, turn);
+  }
+}
+
 //------------------------------------------------------------------------------
 // Render frame to native window
 //------------------------------------------------------------------------------
 void FlutterUvcFrameRenderer::renderToWindow(ANativeWindow *window,
                                              const uint8_t *data,
-                                             uint32_t width, uint32_t height) {
+                                             uint32_t width, uint32_t height,
+                                             uint32_t stride,
+                                             const FrameOrientation &turn) {
   if (!window || !data) {
     return;
   }
 
+  uint32_t out_width, out_height;
+  orientedSize(turn, width, height, out_width, out_height);
+  if (ANativeWindow_getWidth(window) != (int32_t)out_width ||
+      ANativeWindow_getHeight(window) != (int32_t)out_height) {
+    ANativeWindow_setBuffersGeometry(window, out_width, out_height,
+                                     WINDOW_FORMAT_RGBA_8888);
+  }
+
   ANativeWindow_Buffer buffer;
   if (ANativeWindow_lock(window, &buffer, nullptr) != 0) {
     return;
   }
 
-  // Copy RGBA data to window buffer
   uint8_t *dst = static_cast<uint8_t *>(buffer.bits);
+  if (!turn.isIdentity()) {
+    // Rotate/mirror while copying, a buffer still at the old geometry
+    // keeps its previous contents
+    if (buffer.width >= (int32_t)out_width &&
+        buffer.height >= (int32_t)out_height) {
+      orientRgbx(data, width, height, stride, turn, dst, buffer.stride * 4);
+    }
+    ANativeWindow_unlockAndPost(window);
+    return;
+  }
+
+  // Copy RGBA data to window buffer
   const uint8_t *src = data;
 
   int copy_width = std::min((int)width, buffer.width);
@@ -305,47 +1125,10 @@ void FlutterUvcFrameRenderer::renderToWindow(ANativeWindow *window,
   for (int y = 0; y < copy_height; y++) {
     memcpy(dst, src, copy_width * 4);
     dst += buffer.stride * 4;
-    src += width * 4;
+    src += stride;
   }
 
   ANativeWindow_unlockAndPost(window);
 }
 
-//------------------------------------------------------------------------------
-// Convert YUV to RGB
-// Supports YUYV and NV21 formats
-//------------------------------------------------------------------------------
-void FlutterUvcFrameRenderer::convertYuvToRgb(const uint8_t *yuv, uint8_t *rgb,
-                                              uint32_t width, uint32_t height) {
-  // For now, assume YUYV format (most common for UVC cameras)
-  // YUYV: 2 pixels per 4 bytes (Y0 U0 Y1 V0)
-
-  for (uint32_t i = 0; i < width * height / 2; i++) {
-    int y0 = yuv[i * 4 + 0];
-    int u = yuv[i * 4 + 1] - 128;
-    int y1 = yuv[i * 4 + 2];
-    int v = yuv[i * 4 + 3] - 128;
-
-    // First pixel
-    int r0 = y0 + (359 * v >> 8);
-    int g0 = y0 - (88 * u + 183 * v >> 8);
-    int b0 = y0 + (454 * u >> 8);
-
-    rgb[i * 8 + 0] = std::clamp(r0, 0, 255);
-    rgb[i * 8 + 1] = std::clamp(g0, 0, 255);
-    rgb[i * 8 + 2] = std::clamp(b0, 0, 255);
-    rgb[i * 8 + 3] = 255; // Alpha
-
-    // Second pixel
-    int r1 = y1 + (359 * v >> 8);
-    int g1 = y1 - (88 * u + 183 * v >> 8);
-    int b1 = y1 + (454 * u >> 8);
-
-    rgb[i * 8 + 4] = std::clamp(r1, 0, 255);
-    rgb[i * 8 + 5] = std::clamp(g1, 0, 255);
-    rgb[i * 8 + 6] = std::clamp(b1, 0, 255);
-    rgb[i * 8 + 7] = 255; // Alpha
-  }
-}
-
 } // namespace serenegiant::flutter
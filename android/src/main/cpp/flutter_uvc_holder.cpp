@@ -33,14 +33,24 @@
 
 // Standard C++
 #include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
 
 // aandusb
 #include "utilbase.h"
+#if defined(__ANDROID__)
 // common
 #include "common/eglbase.h"
+#endif
 // flutter
+#include "flutter_frame_converter.h"
+#include "flutter_mjpeg_decoder.h"
+#include "flutter_task_pool.h"
+#include "flutter_thread_policy.h"
 #include "flutter_uvc_holder.h"
+#include "flutter_video_size.h"
 
 //--------------------------------------------------------------------------------
 #if MEAS_TIME
@@ -72,6 +82,35 @@
 namespace serenegiant::flutter
 {
 
+	/**
+	 * カメラが送ってきたフォーマットの映像フレームを録画用のRGBXへ変換する
+	 * @param frame_type uvc_raw_frame_t
+	 * @param data
+	 * @param data_len
+	 * @param width
+	 * @param height
+	 * @param decoder MJPEGのデコーダー
+	 * @param rgbx 変換先, width x height x 4バイト
+	 * @return 0: 成功, 負: エラーコード(H.264等の変換できないフォーマットや破損したフレーム)
+	 */
+	static int to_rgbx(
+		const uint32_t &frame_type, const uint8_t *data, const size_t &data_len,
+		const uint32_t &width, const uint32_t &height,
+		MjpegDecoder &decoder, std::vector<uint8_t> &rgbx)
+	{
+		if (rgbx.size() != (size_t)width * height * 4)
+		{
+			return -ENOSPC;
+		}
+		if (frame_type == RAW_FRAME_MJPEG)
+		{
+			uint32_t out_width, out_height;
+			const int r = decoder.decode(data, data_len, width, height, rgbx, out_width, out_height);
+			return r ? r : ((out_width == width) && (out_height == height) ? 0 : -EINVAL);
+		}
+		return convertToRgba(frame_type, data, data_len, width, height, rgbx.data(), width * 4);
+	}
+
 	/*public*/
 	FlutterUVCHolder::FlutterUVCHolder(
 		usb_manager_t *manager, const int32_t &device_id,
@@ -79,43 +118,20 @@ namespace serenegiant::flutter
 		const uint32_t &width, const uint32_t &height)
 		: m_manager(manager),
 		  m_device_id(device_id),
+		  m_initial_frame_type(frame_type),
+		  m_initial_width(width),
+		  m_initial_height(height),
 		  m_current_size(),
 		  m_supported_size(),
-		  m_supported_ctrls()
+		  m_supported_ctrls(),
+		  m_consumers(
+			  [manager, device_id]() { return uvc_start(manager, device_id); },
+			  [manager, device_id]() { return uvc_stop(manager, device_id); })
 	{
 		ENTER();
 
-		uvc_resize(m_manager, m_device_id, frame_type, width, height);
-
-		// 対応解像度一覧を取得する
-		int32_t num_supported = 0;
-		auto r = uvc_get_supported_size(manager, m_device_id, 0, &num_supported, nullptr);
-		if (!r && num_supported)
-		{
-			uvc_video_size_t size;
-			for (int32_t i = 0; i < num_supported; i++)
-			{
-				r = uvc_get_supported_size(manager, m_device_id, i, &num_supported, &size);
-				if (!r)
-				{
-					m_supported_size.push_back(size);
-					LOGD("video_size_t(type=0x%08x,ix=%d,%dx%d)", size.frame_type, size.frame_index, size.width, size.height);
-				}
-				else
-				{
-					LOGE("Failed to get supported size,err=%d", r);
-					break;
-				}
-			}
-		}
-		else
-		{
-			LOGE("Failed to get supported size,err=%d", r);
-		}
-		LOGD("num_supported=%d,added=%" FMT_SIZE_T, num_supported, m_supported_size.size());
-
-		get_current_size();
-		update_supported_ctrls();
+		// 対応解像度一覧等の取得は時間がかかることがあるので
+		// ここでは行わずにprepare_asyncでワーカースレッド上で行う
 
 		EXIT();
 	}
@@ -135,6 +151,20 @@ namespace serenegiant::flutter
 			}
 			m_recording_thread.reset();
 		}
+		// 動き検出スレッドを停止する
+		m_motion_enabled = false;
+		if (m_motion_thread && m_motion_thread->joinable())
+		{
+			m_motion_thread->join();
+		}
+		m_motion_thread.reset();
+		// 記録スレッドを停止する
+		m_capture_active = false;
+		if (m_capture_thread && m_capture_thread->joinable())
+		{
+			m_capture_thread->join();
+		}
+		m_capture_thread.reset();
 
 		// Release recording window
 		if (m_recording_window)
@@ -143,18 +173,161 @@ namespace serenegiant::flutter
 			m_recording_window = nullptr;
 		}
 
-		uvc_stop(m_manager, m_device_id);
+		if (m_preview_window)
+		{
+			if (!m_headless)
+			{
+				uvc_set_surface(m_manager, m_device_id, nullptr, nullptr);
+			}
+			ANativeWindow_release(m_preview_window);
+			m_preview_window = nullptr;
+		}
+
+		// ワーカースレッドがthisへアクセスしなくなるまで待機する
+		std::shared_future<int> prewarmed, ready;
+		{
+			std::lock_guard<std::mutex> lock(m_ready_lock);
+			prewarmed = m_prewarmed;
+			ready = m_ready;
+		}
+		if (prewarmed.valid())
+		{
+			prewarmed.wait();
+		}
+		if (ready.valid())
+		{
+			ready.wait();
+		}
+		if (m_still.valid())
+		{
+			m_still.wait();
+		}
+		{
+			std::unique_lock<std::mutex> lock(m_burst_lock);
+			m_burst_cond.wait(lock, [this]() { return !m_burst_workers; });
+		}
+
+		m_consumers.stop();
+		// 共有タスクプールのこの機器の統計情報を破棄する
+		TaskPool::get_instance().remove_device(m_device_id);
 
 		EXIT();
 	}
 
+	/**
+	 * 対応解像度一覧/UVCコントロール一覧の取得をワーカースレッドで開始する
+	 * 既に開始している場合は何もしない
+	 * @param on_ready 取得完了時のコールバック, nullptrでも可
+	 * @return 取得完了を待機するためのfuture
+	 */
+	/*public*/
+	std::shared_future<int> FlutterUVCHolder::prepare_async(OnCapabilitiesReady on_ready)
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_ready_lock);
+		if (!m_ready.valid())
+		{
+			m_ready = std::async(std::launch::async, [this, on_ready]()
+			{
+				const auto r = enumerate_capabilities();
+				if (on_ready)
+				{
+					on_ready(m_device_id, r);
+				}
+				return r;
+			}).share();
+		}
+
+		RET(m_ready);
+	}
+
+	/**
+	 * 対応解像度一覧/UVCコントロール一覧の取得完了後に
+	 * 映像取得開始後の最初のフレームまでの処理をワーカースレッドで前もって行う
+	 * 既に開始している場合は何もしない
+	 * @return 事前準備の完了を待機するためのfuture
+	 */
+	/*public*/
+	std::shared_future<int> FlutterUVCHolder::prewarm_async()
+	{
+		ENTER();
+
+		// prepare_asyncもm_ready_lockを保持するので先に呼ぶ
+		const auto ready = prepare_async();
+		std::lock_guard<std::mutex> lock(m_ready_lock);
+		if (!m_prewarmed.valid())
+		{
+			m_prewarmed = std::async(std::launch::async, [this, ready]()
+			{
+				const auto r = ready.get();
+				return r ? r : prewarm();
+			}).share();
+		}
+
+		RET(m_prewarmed);
+	}
+
+	/**
+	 * 対応解像度一覧/UVCコントロール一覧の取得が完了しているかどうか
+	 * @return
+	 */
+	/*public*/
+	bool FlutterUVCHolder::is_ready() const
+	{
+		ENTER();
+
+		std::shared_future<int> ready;
+		{
+			std::lock_guard<std::mutex> lock(m_ready_lock);
+			ready = m_ready;
+		}
+		const auto result = ready.valid()
+			&& (ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+
+		RETURN(result, bool);
+	}
+
+	/**
+	 * 対応解像度一覧/UVCコントロール一覧の取得完了を待機する
+	 * prepare_asyncを呼んでいなければ呼び出し元スレッドで取得する
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	/*public*/
+	int FlutterUVCHolder::wait_ready()
+	{
+		ENTER();
+
+		std::shared_future<int> ready;
+		std::promise<int> promise;
+		bool enumerate = false;
+		{
+			std::lock_guard<std::mutex> lock(m_ready_lock);
+			if (UNLIKELY(!m_ready.valid()))
+			{
+				LOGW("prepare_async has not been called, enumerate on caller thread");
+				m_ready = promise.get_future().share();
+				enumerate = true;
+			}
+			ready = m_ready;
+		}
+		if (enumerate)
+		{
+			// 取得中に呼ばれた他のスレッドはこのfutureで完了を待つ
+			promise.set_value(enumerate_capabilities());
+		}
+
+		RETURN(ready.get(), int);
+	}
+
 	bool FlutterUVCHolder::is_running() const
 	{
 		ENTER();
 
+		// 消費者がいなくて一時停止している間も映像取得中として扱う
 		const auto state = uvc_get_device_state(m_manager, m_device_id);
 
-		RETURN(state > CONNECTED, bool);
+		RETURN(m_consumers.is_started() || (state > CONNECTED), bool);
 	}
 
 	int FlutterUVCHolder::set_config(const int32_t &enabled, const bool &use_first_config)
@@ -166,12 +339,15 @@ namespace serenegiant::flutter
 	uint64_t FlutterUVCHolder::get_ctrl_supports()
 	{
 		ENTER();
+		// 取得中のuvc_resize/コントロールの列挙と競合しないように取得完了を待つ
+		wait_ready();
 		RETURN(uvc_get_ctrl_supports(m_manager, m_device_id), uint64_t);
 	}
 
 	uint64_t FlutterUVCHolder::get_proc_supports()
 	{
 		ENTER();
+		wait_ready();
 		RETURN(uvc_get_proc_supports(m_manager, m_device_id), uint64_t);
 	}
 
@@ -180,9 +356,10 @@ namespace serenegiant::flutter
 	 * @param info
 	 * @return 0: 成功, 負: エラーコード
 	 */
-	int FlutterUVCHolder::get_control_info(uvc_control_info_t &info) const
+	int FlutterUVCHolder::get_control_info(uvc_control_info_t &info)
 	{
 		ENTER();
+		wait_ready();
 		RETURN(uvc_get_control_info(m_manager, m_device_id, &info), int);
 	}
 
@@ -192,9 +369,10 @@ namespace serenegiant::flutter
 	 * @param value
 	 * @return 0: 成功, 負: エラーコード
 	 */
-	int FlutterUVCHolder::set_control_value(const uint64_t &type, const int32_t &value) const
+	int FlutterUVCHolder::set_control_value(const uint64_t &type, const int32_t &value)
 	{
 		ENTER();
+		wait_ready();
 		RETURN(uvc_set_control_value(m_manager, m_device_id, type, value), int);
 	}
 
@@ -204,9 +382,10 @@ namespace serenegiant::flutter
 	 * @param value
 	 * @return 0: 成功, 負: エラーコード
 	 */
-	int FlutterUVCHolder::get_control_value(const uint64_t &type, int32_t &value) const
+	int FlutterUVCHolder::get_control_value(const uint64_t &type, int32_t &value)
 	{
 		ENTER();
+		wait_ready();
 		RETURN(uvc_get_control_value(m_manager, m_device_id, type, &value), int);
 	}
 
@@ -219,7 +398,88 @@ namespace serenegiant::flutter
 	int FlutterUVCHolder::set_preview_surface(ANativeWindow *preview_window, const float *mvp_matrix)
 	{
 		ENTER();
-		RETURN(uvc_set_surface(m_manager, m_device_id, preview_window, const_cast<float *>(mvp_matrix)), int);
+
+		std::lock_guard<std::mutex> lock(m_preview_lock);
+		const bool attached = m_preview_window && !m_headless;
+		if (preview_window)
+		{
+			ANativeWindow_acquire(preview_window);
+		}
+		if (m_preview_window)
+		{
+			ANativeWindow_release(m_preview_window);
+		}
+		m_preview_window = preview_window;
+		if (mvp_matrix)
+		{
+			m_mvp_matrix.assign(mvp_matrix, mvp_matrix + 16);
+		}
+		else
+		{
+			m_mvp_matrix.clear();
+		}
+		const auto result = apply_preview_locked(attached);
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * ヘッドレスモードを切り替える
+	 * @param headless
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterUVCHolder::set_headless(const bool &headless)
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_preview_lock);
+		const bool attached = m_preview_window && !m_headless;
+		m_headless = headless;
+		const auto result = apply_preview_locked(attached);
+
+		RETURN(result, int);
+	}
+
+	bool FlutterUVCHolder::is_headless()
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_preview_lock);
+
+		RETURN(m_headless, bool);
+	}
+
+	/**
+	 * プレビュー用Surfaceとヘッドレスモードの状態をaandusbへ反映する
+	 * @param attached 変更前にaandusbへSurfaceをセットしていたかどうか
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	/*private*/
+	int FlutterUVCHolder::apply_preview_locked(const bool &attached)
+	{
+		ENTER();
+
+		const bool attach = m_preview_window && !m_headless;
+		if (!attach && !attached)
+		{
+			// ヘッドレスモード中のSurfaceの変更は保持するだけ
+			RETURN(0, int);
+		}
+		if (attach && !attached)
+		{
+			// 一時停止中ならSurfaceをセットする前に映像取得を再開する
+			m_consumers.acquire(CONSUMER_PREVIEW);
+		}
+		// Surfaceを外すとaandusbはプレビューのための変換/描画を行わない
+		const auto result = uvc_set_surface(m_manager, m_device_id,
+			attach ? m_preview_window : nullptr,
+			(attach && !m_mvp_matrix.empty()) ? m_mvp_matrix.data() : nullptr);
+		if (!attach && attached)
+		{
+			m_consumers.release(CONSUMER_PREVIEW);
+		}
+
+		RETURN(result, int);
 	}
 
 	/**
@@ -233,6 +493,13 @@ namespace serenegiant::flutter
 		ENTER();
 		LOGD("set_recording_surface: window=%p, current=%p", recording_window, m_recording_window);
 
+		const bool had_recording = m_recording_window != nullptr;
+		if (recording_window && !had_recording)
+		{
+			// 一時停止中なら録画スレッドを開始する前に映像取得を再開する
+			m_consumers.acquire(CONSUMER_RECORDING);
+		}
+
 		// Stop existing recording thread if any
 		if (m_recording_active)
 		{
@@ -264,13 +531,30 @@ namespace serenegiant::flutter
 			ANativeWindow_setBuffersGeometry(m_recording_window, width, height, WINDOW_FORMAT_RGBA_8888);
 
 			// Allocate frame buffer for RGBA conversion
+			// 事前準備で同じサイズのバッファを確保していればそれを使う
+			{
+				std::lock_guard<std::mutex> lock(m_config_lock);
+				if (m_prewarm_frame_buffer.size() == (size_t)width * height * 4)
+				{
+					m_frame_buffer.swap(m_prewarm_frame_buffer);
+				}
+				std::vector<uint8_t>().swap(m_prewarm_frame_buffer);
+			}
 			m_frame_buffer.resize(width * height * 4);
 
+			// 新しいSurfaceには前のフレームが無い
+			m_dedup.invalidate();
+			// 新しいエンコーダーの報告から制御し直す
+			m_rate.reset();
 			// Start recording capture thread
 			m_recording_active = true;
 			m_recording_thread = std::make_unique<std::thread>(&FlutterUVCHolder::recording_capture_loop, this);
 			LOGD("Recording thread started");
 		}
+		else if (had_recording)
+		{
+			m_consumers.release(CONSUMER_RECORDING);
+		}
 
 		RETURN(0, int);
 	}
@@ -283,13 +567,35 @@ namespace serenegiant::flutter
 		LOGD("recording_capture_loop started");
 
 		// Allocate temporary buffers
-		std::vector<uint8_t> yuv_buffer(m_current_size.width * m_current_size.height * 2);
+		// 記録中にカメラが送ってきたフォーマットのまま受け取るバッファ, 受け取れなかった時に大きくする
+		std::vector<uint8_t> raw_buffer(m_current_size.width * m_current_size.height * 2);
+		MjpegDecoder decoder;
 		int64_t frame_count = 0;
-		const int64_t frame_interval_ns = 1000000000LL / 30; // 30 FPS target
+		// set_video_sizeで選択したフレームレート, 未選択なら30fps
+		const auto interval = m_frame_interval.load();
+		const int64_t frame_interval_ns = interval ? interval * 100LL : 1000000000LL / 30;
 		auto last_frame_time = std::chrono::high_resolution_clock::now();
+		// 最初のフレームまでの時間は映像取得開始と録画開始の遅い方から数える
+		const int64_t loop_start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+		char name[THREAD_NAME_LEN];
+		snprintf(name, sizeof(name), "uvc%d-record", m_device_id);
+		PipelineThread thread(m_device_id, name);
 
 		while (m_recording_active && m_recording_window)
 		{
+			thread.update();
+			if (m_has_pending)
+			{
+				// 映像サイズが変更されたのでフレームの間でバッファと録画用Surfaceのサイズを切り替える
+				std::lock_guard<std::mutex> lock(m_config_lock);
+				m_frame_buffer.swap(m_pending_frame_buffer);
+				std::vector<uint8_t>().swap(m_pending_frame_buffer);
+				ANativeWindow_setBuffersGeometry(m_recording_window,
+					m_pending_width, m_pending_height, WINDOW_FORMAT_RGBA_8888);
+				m_has_pending = false;
+				m_dedup.invalidate();
+			}
 			// Rate limit to avoid overwhelming the encoder
 			auto now = std::chrono::high_resolution_clock::now();
 			auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_frame_time).count();
@@ -301,45 +607,174 @@ namespace serenegiant::flutter
 			last_frame_time = now;
 
 			// Get frame from UVC camera
-			uint32_t frame_type = RAW_FRAME_UNCOMPRESSED_RGBX; // Request RGBA directly if possible
+			// 記録中はカメラが送ってきたフォーマットのまま受け取って記録してからRGBXへ変換する
+			const bool capturing = m_capture_active;
+			uint32_t frame_type = capturing ? RAW_FRAME_UNKNOWN : RAW_FRAME_UNCOMPRESSED_RGBX; // Request RGBA directly if possible
 			uint32_t width = m_current_size.width;
 			uint32_t height = m_current_size.height;
-			uint32_t data_len = m_frame_buffer.size();
+			std::vector<uint8_t> &received = capturing ? raw_buffer : m_frame_buffer;
+			uint32_t data_len = received.size();
 			int64_t pts_us = 0;
 			uint32_t flags = 0;
 
 			int result = uvc_get_frame(m_manager, m_device_id,
 									   &frame_type, &width, &height,
-									   m_frame_buffer.data(), &data_len,
+									   received.data(), &data_len,
 									   &pts_us, &flags);
 
+			if (capturing && (result == -ENOSPC))
+			{
+				raw_buffer.resize(raw_buffer.size() * 2);
+				continue;
+			}
 			if (result != 0 || data_len == 0)
 			{
 				// No frame available, continue
 				continue;
 			}
+			offer_still(frame_type, received.data(), data_len, width, height);
+
+			if (capturing)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_capture_lock);
+					if (m_capture)
+					{
+						m_capture->write(frame_type, width, height,
+							raw_buffer.data(), data_len, pts_us, flags);
+					}
+				}
+				if (to_rgbx(frame_type, raw_buffer.data(), data_len, width, height, decoder, m_frame_buffer))
+				{
+					// 録画用Surfaceへ書き込めないフレーム
+					continue;
+				}
+				frame_type = RAW_FRAME_UNCOMPRESSED_RGBX;
+				data_len = m_frame_buffer.size();
+			}
+			if (m_burst_active)
+			{
+				// 連写中なら確保済みのスロットへコピーする
+				std::lock_guard<std::mutex> lock(m_burst_lock);
+				if (m_burst)
+				{
+					m_burst->push(m_frame_buffer.data(), data_len,
+						frame_type, width, height, pts_us);
+				}
+			}
+			if (m_motion_enabled)
+			{
+				detect_motion(frame_type, m_frame_buffer.data(), data_len, width, height, pts_us);
+				if (m_motion.gatesRecording() && !m_motion.inMotion())
+				{
+					// 動きが無い間は録画用Surfaceへ書き込まない
+					continue;
+				}
+			}
+			if (m_rate.dropFrame())
+			{
+				// エンコーダーが追いつかない間はフレームを間引く
+				continue;
+			}
+			if (m_dedup.isDuplicate(frame_type, m_frame_buffer.data(), data_len, width, height))
+			{
+				// 前のフレームと同じなら書き込まない, エンコーダーが前のフレームを繰り返す
+				continue;
+			}
+
+			// 到着時刻の揺らぎを取り除いたタイムスタンプ
+			// エンコーダーは書き込んだ時刻をタイムスタンプにするのでその時刻まで待ってから書き込む
+			const int64_t arrival_ns = PtsClockModel::monotonic_ns();
+			const int64_t timestamp_ns = m_clock.update(pts_us, arrival_ns);
+			latency_stamp_t stamp;
+			const bool probe = m_latency.begin(m_frame_buffer.data(), data_len, stamp);
+			if (probe)
+			{
+				m_latency.record(LATENCY_STAGE_FETCH, stamp, arrival_ns);
+			}
+
+			// 録画する範囲と向き, 録画用Surfaceは範囲を回転したサイズにする
+			FrameRect crop;
+			FrameOrientation orientation;
+			{
+				std::lock_guard<std::mutex> lock(m_config_lock);
+				crop = clipRect(m_recording_crop, width, height);
+				orientation = m_recording_orientation;
+			}
+			uint32_t out_width, out_height;
+			orientedSize(orientation, crop.width, crop.height, out_width, out_height);
+			if ((ANativeWindow_getWidth(m_recording_window) != (int32_t)out_width)
+				|| (ANativeWindow_getHeight(m_recording_window) != (int32_t)out_height))
+			{
+				ANativeWindow_setBuffersGeometry(m_recording_window,
+					out_width, out_height, WINDOW_FORMAT_RGBA_8888);
+			}
+
+			// 揺らぎを取り除いた時刻まで録画スレッドで待つ
+			const int64_t delay_ns = m_clock.pacing_target_ns(timestamp_ns) - PtsClockModel::monotonic_ns();
+			if (delay_ns > 0)
+			{
+				std::this_thread::sleep_for(std::chrono::nanoseconds(delay_ns));
+			}
 
 			// Render to recording window
+			// 1回のコピーなので共有タスクプールへは渡さずに録画スレッドで行う
+			bool rendered = false;
 			ANativeWindow_Buffer buffer;
 			if (ANativeWindow_lock(m_recording_window, &buffer, nullptr) == 0)
 			{
 				// Copy frame data to window buffer
-				uint8_t *dst = static_cast<uint8_t *>(buffer.bits);
-				const uint8_t *src = m_frame_buffer.data();
-
-				int copy_width = std::min((int)width, buffer.width);
-				int copy_height = std::min((int)height, buffer.height);
 				int bytes_per_pixel = 4; // RGBA
+				uint8_t *dst = static_cast<uint8_t *>(buffer.bits);
+				const uint8_t *src = m_frame_buffer.data()
+					+ ((size_t)crop.y * width + crop.x) * bytes_per_pixel;
 
-				for (int y = 0; y < copy_height; y++)
+				if (!orientation.isIdentity())
+				{
+					// コピーしながら回転/反転する, サイズ変更前のバッファなら前の内容のまま
+					if ((buffer.width >= (int32_t)out_width) && (buffer.height >= (int32_t)out_height))
+					{
+						orientRgbx(src, crop.width, crop.height, width * bytes_per_pixel,
+							orientation, dst, buffer.stride * bytes_per_pixel);
+					}
+				}
+				else
 				{
-					memcpy(dst, src, copy_width * bytes_per_pixel);
-					dst += buffer.stride * bytes_per_pixel;
-					src += width * bytes_per_pixel;
+					int copy_width = std::min((int)crop.width, buffer.width);
+					int copy_height = std::min((int)crop.height, buffer.height);
+
+					for (int y = 0; y < copy_height; y++)
+					{
+						memcpy(dst, src, copy_width * bytes_per_pixel);
+						dst += buffer.stride * bytes_per_pixel;
+						src += width * bytes_per_pixel;
+					}
 				}
 
 				ANativeWindow_unlockAndPost(m_recording_window);
+				rendered = true;
+				if (probe)
+				{
+					m_latency.record(LATENCY_STAGE_RECORDING, stamp);
+				}
+			}
+			if (!rendered)
+			{
+				// 書き込めなかったフレームは次に同じフレームが来たら書き込む
+				m_dedup.invalidate();
+			}
+			else
+			{
 				frame_count++;
+				m_rate.framePosted();
+				const int64_t start_ns = m_start_ns;
+				if (start_ns && !m_time_to_first_frame_ns)
+				{
+					const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+						std::chrono::steady_clock::now().time_since_epoch()).count();
+					m_time_to_first_frame_ns = now_ns - std::max(start_ns, loop_start_ns);
+					LOGD("time to first frame: %lld us", (long long)(m_time_to_first_frame_ns / 1000));
+				}
 
 				if (frame_count % 30 == 0)
 				{
@@ -360,20 +795,93 @@ namespace serenegiant::flutter
 	int FlutterUVCHolder::set_mvp_matrix(const float *mvp_matrix)
 	{
 		ENTER();
+
+		// ヘッドレスモードを解除した時にセットし直せるように保持しておく
+		std::lock_guard<std::mutex> lock(m_preview_lock);
+		if (mvp_matrix)
+		{
+			m_mvp_matrix.assign(mvp_matrix, mvp_matrix + 16);
+		}
+		else
+		{
+			m_mvp_matrix.clear();
+		}
+
 		RETURN(uvc_set_mvp_matrix(m_manager, m_device_id, const_cast<float *>(mvp_matrix)), int);
 	}
 
 	int FlutterUVCHolder::set_video_size(
 		const uvc_raw_frame_t &frame_type,
-		const uint32_t &width, const uint32_t &height)
+		const uint32_t &width, const uint32_t &height,
+		const float &fps, const float &min_fps, const float &max_fps)
 	{
 
 		ENTER();
-		auto r = uvc_resize(m_manager, m_device_id, frame_type, width, height);
+		// prepare_asyncでの初期設定で上書きされないように取得完了を待つ
+		wait_ready();
+		// 対応解像度一覧から該当する映像サイズ設定を探してフレームインターバルを選択する
+		uint32_t interval = 0;
+		bool found = false;
+		for (const auto &size: m_supported_size)
+		{
+			if ((size.frame_type == frame_type) && (size.width == width) && (size.height == height))
+			{
+				found = true;
+				interval = select_frame_interval(size, fps, min_fps, max_fps);
+				break;
+			}
+		}
+		if (found && !interval && ((fps > 0.0f) || (min_fps > 0.0f) || (max_fps > 0.0f)))
+		{
+			// 範囲内のフレームレートに対応していない
+			LOGW("unsupported frame rate,fps=%f(%f-%f)", fps, min_fps, max_fps);
+			RETURN(-EINVAL, int);
+		}
+		// 録画中なら新しい映像サイズのフレームバッファを先に確保しておく
+		std::vector<uint8_t> frame_buffer;
+		if (m_recording_active)
+		{
+			frame_buffer.resize((size_t)width * height * 4);
+		}
+		// aandusbのuvc_resizeはフレームインターバルを指定できないので
+		// カメラ側はデフォルトのフレームレートのままで録画時に間引いて選択したフレームレートにする
+		// 映像取得中はuvc_resizeできないので映像取得だけを終了→変更→再開する
+		const bool running = m_consumers.is_started();
+		const auto start = std::chrono::steady_clock::now();
+		auto r = m_consumers.restart([&]() {
+			return uvc_resize(m_manager, m_device_id, frame_type, width, height);
+		});
+		if (!r)
+		{
+			m_frame_interval = interval;
+			if (running)
+			{
+				m_switch_latency_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now() - start).count();
+			}
+			if (!frame_buffer.empty())
+			{
+				std::lock_guard<std::mutex> lock(m_config_lock);
+				m_pending_frame_buffer.swap(frame_buffer);
+				m_pending_width = width;
+				m_pending_height = height;
+				m_has_pending = true;
+			}
+		}
 		get_current_size();
 		RETURN(r, int);
 	}
 
+	/**
+	 * set_video_sizeで選択したフレームレートを取得
+	 * @return フレームレート, 未選択なら0
+	 */
+	float FlutterUVCHolder::get_current_fps() const
+	{
+		ENTER();
+		RET(interval_to_fps(m_frame_interval));
+	}
+
 	const uvc_video_size_t &FlutterUVCHolder::get_current_size()
 	{
 		ENTER();
@@ -389,7 +897,7 @@ namespace serenegiant::flutter
 
 	int FlutterUVCHolder::get_supported_size(
 		const int32_t &index, int32_t *num_supported,
-		uvc_video_size_t *data) const
+		uvc_video_size_t *data)
 	{
 
 		ENTER();
@@ -415,13 +923,792 @@ namespace serenegiant::flutter
 	int FlutterUVCHolder::start()
 	{
 		ENTER();
-		RETURN(uvc_start(m_manager, m_device_id), int);
+		wait_ready();
+		if (!m_consumers.is_started())
+		{
+			m_time_to_first_frame_ns = 0;
+			m_clock.reset();
+			m_start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+		RETURN(m_consumers.start(), int);
 	}
 
 	int FlutterUVCHolder::stop()
 	{
 		ENTER();
-		RETURN(uvc_stop(m_manager, m_device_id), int);
+		RETURN(m_consumers.stop(), int);
+	}
+
+	/**
+	 * 映像の消費者を登録する
+	 * @param type
+	 * @return 0以上: 登録後のその種類の消費者の数, 負: エラーコード
+	 */
+	int FlutterUVCHolder::acquire_consumer(const consumer_type_t &type)
+	{
+		ENTER();
+		RETURN(m_consumers.acquire(type), int);
+	}
+
+	/**
+	 * acquire_consumerで登録した映像の消費者を解除する
+	 * @param type
+	 * @return 0以上: 解除後のその種類の消費者の数, 負: エラーコード
+	 */
+	int FlutterUVCHolder::release_consumer(const consumer_type_t &type)
+	{
+		ENTER();
+		RETURN(m_consumers.release(type), int);
+	}
+
+	/**
+	 * 映像の一部だけを録画する
+	 * 録画スレッドが次のフレームから録画用Surfaceのサイズを切り替える
+	 * @param crop 録画する範囲(映像の画素単位), 空なら映像全体
+	 */
+	void FlutterUVCHolder::set_recording_crop(const FrameRect &crop)
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_config_lock);
+		m_recording_crop = crop;
+		m_dedup.invalidate();
+		LOGD("recording crop=(%u,%u)%ux%u", crop.x, crop.y, crop.width, crop.height);
+
+		EXIT();
+	}
+
+	/**
+	 * 録画する映像を回転/反転する
+	 * 録画スレッドが次のフレームから録画用Surfaceのサイズを切り替える
+	 * @param orientation 時計回りの回転角度(0/90/180/270)と左右/上下反転
+	 * @return 0: 成功, -EINVAL: 回転角度が90度単位ではない
+	 */
+	int FlutterUVCHolder::set_recording_orientation(const FrameOrientation &orientation)
+	{
+		ENTER();
+
+		if (!orientation.valid())
+		{
+			RETURN(-EINVAL, int);
+		}
+		std::lock_guard<std::mutex> lock(m_config_lock);
+		m_recording_orientation = orientation;
+		m_dedup.invalidate();
+		LOGD("recording orientation=%u,mirror=%d/%d",
+			orientation.rotation, orientation.mirror_h, orientation.mirror_v);
+
+		RETURN(0, int);
+	}
+
+	/**
+	 * 次のフレームを静止画(JPEG)としてワーカースレッドで撮影する
+	 * @param path 書き込み先のファイルパス, 空ならJPEGデータをコールバックへ渡す
+	 * @param on_captured 撮影完了時のコールバック, nullptrでも可
+	 * @return 0: 撮影を開始した, -EBUSY: 撮影中, -EPIPE: 映像取得中ではない
+	 */
+	int FlutterUVCHolder::capture_still(const std::string &path, OnStillCaptured on_captured)
+	{
+		ENTER();
+
+		if (!m_consumers.is_started())
+		{
+			RETURN(-EPIPE, int);
+		}
+		std::lock_guard<std::mutex> lock(m_still_lock);
+		if (m_still.valid()
+			&& (m_still.wait_for(std::chrono::seconds(0)) != std::future_status::ready))
+		{
+			RETURN(-EBUSY, int);
+		}
+		m_still = std::async(std::launch::async, [this, path, on_captured]()
+		{
+			std::vector<uint8_t> jpeg;
+			auto r = take_still(jpeg);
+			if (!r && !path.empty())
+			{
+				// ファイルへ書き込んだ時はJPEGデータを渡さない
+				r = writeStillFile(path, jpeg);
+				std::vector<uint8_t>().swap(jpeg);
+			}
+			LOGD("still captured:r=%d,bytes=%zu", r, jpeg.size());
+			if (on_captured)
+			{
+				on_captured(m_device_id, r, std::move(jpeg));
+			}
+			return r;
+		}).share();
+
+		RETURN(0, int);
+	}
+
+	/**
+	 * 次のフレームを受け取って静止画(JPEG)にする
+	 * RAW_FRAME_UNKNOWNでカメラが送ってきたフォーマットのまま受け取るので
+	 * MJPEGはデコード/再圧縮しない
+	 * 録画/記録/動き検出スレッドと同時にuvc_get_frameを呼ぶとフレームを取り合うので
+	 * それらのスレッドが動いている間はそのスレッドが受け取ったフレームを待つ
+	 * 録画中は録画用のRGBXフレームになる(記録中はカメラが送ってきたフォーマットのまま)
+	 * @param jpeg
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	/*private*/
+	int FlutterUVCHolder::take_still(std::vector<uint8_t> &jpeg)
+	{
+		ENTER();
+
+		// 一時停止中なら映像取得を再開させる
+		m_consumers.acquire(CONSUMER_ANALYSIS);
+		const auto deadline = std::chrono::steady_clock::now()
+			+ std::chrono::milliseconds(STILL_TIMEOUT_MS);
+		std::vector<uint8_t> frame((size_t)m_current_size.width * m_current_size.height * 4);
+		JpegEncoder encoder;
+		int result = -ETIMEDOUT;
+		{
+			std::lock_guard<std::mutex> lock(m_still_frame_lock);
+			m_still_frame.data_len = 0;
+			m_still_requested = true;
+		}
+		while (std::chrono::steady_clock::now() < deadline)
+		{
+			uint32_t frame_type = RAW_FRAME_UNKNOWN;
+			uint32_t width = 0, height = 0;
+			size_t data_len = 0;
+			if (m_recording_active || m_capture_active || m_motion_enabled)
+			{
+				// スレッドが止まった時に自分で受け取れるように短い間隔で確認する
+				std::unique_lock<std::mutex> lock(m_still_frame_lock);
+				m_still_frame_cond.wait_for(lock, std::chrono::milliseconds(10),
+					[this]() { return m_still_frame.data_len != 0; });
+				if (!m_still_frame.data_len)
+				{
+					continue;
+				}
+				frame.swap(m_still_frame.data);
+				data_len = m_still_frame.data_len;
+				frame_type = m_still_frame.frame_type;
+				width = m_still_frame.width;
+				height = m_still_frame.height;
+				m_still_frame.data_len = 0;
+			}
+			else
+			{
+				uint32_t len = frame.size();
+				int64_t pts_us = 0;
+				uint32_t flags = 0;
+				const int r = uvc_get_frame(m_manager, m_device_id,
+					&frame_type, &width, &height,
+					frame.data(), &len, &pts_us, &flags);
+				if (r == -ENOSPC)
+				{
+					// このフレームは諦めて次のフレームを受け取れるようにバッファを拡張する
+					frame.resize(std::max<size_t>(len, frame.size() * 2));
+					continue;
+				}
+				if (r || !len)
+				{
+					// 未着または破損したフレーム
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					continue;
+				}
+				data_len = len;
+			}
+			result = makeStillJpeg(frame_type, frame.data(), data_len, width, height, encoder, jpeg);
+			if (result != -ENODATA)
+			{
+				// 途中で切れたMJPEGフレーム(-ENODATA)なら次のフレームを待つ
+				break;
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_still_frame_lock);
+			m_still_requested = false;
+			m_still_frame.data_len = 0;
+			std::vector<uint8_t>().swap(m_still_frame.data);
+		}
+		m_consumers.release(CONSUMER_ANALYSIS);
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 静止画の撮影待ちならフレームをコピーして撮影スレッドへ渡す
+	 * @param frame_type
+	 * @param data
+	 * @param data_len
+	 * @param width
+	 * @param height
+	 */
+	/*private*/
+	void FlutterUVCHolder::offer_still(
+		const uint32_t &frame_type, const uint8_t *data, const size_t &data_len,
+		const uint32_t &width, const uint32_t &height)
+	{
+		if (!m_still_requested)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(m_still_frame_lock);
+		if (m_still_requested && !m_still_frame.data_len)
+		{
+			m_still_frame.data.assign(data, data + data_len);
+			m_still_frame.data_len = data_len;
+			m_still_frame.frame_type = frame_type;
+			m_still_frame.width = width;
+			m_still_frame.height = height;
+			m_still_frame_cond.notify_all();
+		}
+	}
+
+	/**
+	 * 連続したフレームをワーカースレッドで撮影する
+	 * @param count 撮影するフレーム数(1〜BURST_MAX_FRAMES)
+	 * @param encode trueならすべて揃ってから共有タスクプールで並列にJPEGへ圧縮する
+	 * @param on_captured 撮影完了時のコールバック, nullptrでも可
+	 * @return 0: 撮影を開始した, -EBUSY: 撮影中, -EPIPE: 映像取得中ではない,
+	 *         -ENOTSUP: 保持できないフォーマット, -EINVAL/-ENOMEM: フレーム数/サイズが大きすぎる
+	 */
+	int FlutterUVCHolder::capture_burst(const uint32_t &count, const bool &encode, OnBurstCaptured on_captured)
+	{
+		ENTER();
+
+		if (!m_consumers.is_started())
+		{
+			RETURN(-EPIPE, int);
+		}
+		std::lock_guard<std::mutex> lock(m_burst_lock);
+		if (m_burst_running)
+		{
+			RETURN(-EBUSY, int);
+		}
+		// 録画中は録画用のRGBXフレーム, それ以外はカメラが送ってくるフレームが入る大きさにする
+		const uint32_t frame_type = m_current_size.frame_type;
+		const uint32_t width = m_current_size.width;
+		const uint32_t height = m_current_size.height;
+		size_t slot_bytes;
+		if (m_recording_active)
+		{
+			slot_bytes = rawFrameBytes(RAW_FRAME_UNCOMPRESSED_RGBX, width, height);
+		}
+		else if (frame_type == RAW_FRAME_MJPEG)
+		{
+			// MJPEGは1画素1バイトあれば十分に収まる
+			slot_bytes = (size_t)width * height;
+		}
+		else
+		{
+			slot_bytes = rawFrameBytes(frame_type, width, height);
+		}
+		if (!slot_bytes)
+		{
+			RETURN(-ENOTSUP, int);
+		}
+		auto burst = std::make_shared<FrameBurst>();
+		const int result = burst->reserve(count, slot_bytes);
+		if (result)
+		{
+			RETURN(result, int);
+		}
+		// 取りこぼしがあっても終わるように1フレームあたりフレーム間隔の2倍まで待つ
+		const auto interval = m_frame_interval.load();
+		const int64_t interval_ms = interval ? interval / 10000 : 1000 / 30;
+		const int64_t timeout_ms = STILL_TIMEOUT_MS + count * interval_ms * 2;
+		m_burst_running = true;
+		m_burst_workers++;
+		std::thread([this, burst, encode, timeout_ms, on_captured]()
+		{
+			auto r = fill_burst(burst, timeout_ms);
+			if (!r && encode)
+			{
+				r = burst->encode(TaskPool::get_instance(), m_device_id);
+			}
+			LOGD("burst captured:r=%d,frames=%u,dropped=%llu",
+				r, burst->size(), (unsigned long long)burst->dropped());
+			m_burst_running = false;
+			if (on_captured)
+			{
+				on_captured(m_device_id, r, r ? nullptr : burst);
+			}
+			// 破棄時に待っているので通知した後はメンバーへアクセスしない
+			std::lock_guard<std::mutex> lock(m_burst_lock);
+			m_burst_workers--;
+			m_burst_cond.notify_all();
+		}).detach();
+
+		RETURN(0, int);
+	}
+
+	/**
+	 * 連写のスロットがすべて埋まるまでフレームを受け取る
+	 * 録画スレッドと同時にuvc_get_frameを呼ぶとフレームを取り合うので
+	 * 録画中は録画スレッドがm_burstへ書き込むのを待つ
+	 * 書き込むスレッドはm_burst_lockで受け渡すので同時に書き込むことはない
+	 * @param burst
+	 * @param timeout_ms
+	 * @return 0: 成功, -ETIMEDOUT: 時間内にすべてのスロットが埋まらなかった
+	 */
+	/*private*/
+	int FlutterUVCHolder::fill_burst(const std::shared_ptr<FrameBurst> &burst, const int64_t &timeout_ms)
+	{
+		ENTER();
+
+		// 一時停止中なら映像取得を再開させる
+		m_consumers.acquire(CONSUMER_ANALYSIS);
+		const auto deadline = std::chrono::steady_clock::now()
+			+ std::chrono::milliseconds(timeout_ms);
+		while (!burst->full() && (std::chrono::steady_clock::now() < deadline))
+		{
+			if (m_recording_active)
+			{
+				if (!m_burst_active)
+				{
+					std::lock_guard<std::mutex> lock(m_burst_lock);
+					m_burst = burst;
+					m_burst_active = true;
+				}
+				// 録画が止まった時に自分で受け取れるように短い間隔で確認する
+				burst->wait(10);
+				continue;
+			}
+			if (m_burst_active)
+			{
+				std::lock_guard<std::mutex> lock(m_burst_lock);
+				m_burst_active = false;
+				m_burst.reset();
+			}
+			// スロットへ直接受け取るのでコピーしない
+			uint8_t *slot = burst->nextSlot();
+			uint32_t frame_type = RAW_FRAME_UNKNOWN;
+			uint32_t width = 0, height = 0;
+			uint32_t data_len = burst->slotBytes();
+			int64_t pts_us = 0;
+			uint32_t flags = 0;
+			const int r = uvc_get_frame(m_manager, m_device_id,
+				&frame_type, &width, &height,
+				slot, &data_len, &pts_us, &flags);
+			if (r == -ENOSPC)
+			{
+				// スロットに収まらないフレームは捨てる
+				burst->drop();
+				continue;
+			}
+			if (r || !data_len)
+			{
+				// 未着または破損したフレーム
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+			burst->commit(data_len, frame_type, width, height, pts_us);
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_burst_lock);
+			m_burst_active = false;
+			m_burst.reset();
+		}
+		m_consumers.release(CONSUMER_ANALYSIS);
+
+		RETURN(burst->full() ? 0 : -ETIMEDOUT, int);
+	}
+
+	/**
+	 * 動き検出を開始/停止する
+	 * @param enabled
+	 * @param config 動き検出の設定, 停止時は使わない
+	 * @param on_motion 動きの有無が切り替わった時のコールバック, nullptrでも可
+	 * @return 0: 成功, -EINVAL: 設定が範囲外
+	 */
+	int FlutterUVCHolder::set_motion_detection(const bool &enabled, const MotionConfig &config, OnMotionChanged on_motion)
+	{
+		ENTER();
+
+		std::unique_ptr<std::thread> thread;
+		{
+			std::lock_guard<std::mutex> lock(m_motion_lock);
+			if (enabled)
+			{
+				const int result = m_motion.configure(config);
+				if (result)
+				{
+					RETURN(result, int);
+				}
+				m_on_motion = on_motion;
+				m_motion_interval_ms = config.interval_ms;
+				if (!m_motion_enabled)
+				{
+					m_motion_enabled = true;
+					m_motion_thread = std::make_unique<std::thread>(&FlutterUVCHolder::motion_loop, this);
+				}
+				RETURN(0, int);
+			}
+			m_motion_enabled = false;
+			m_on_motion = nullptr;
+			thread.swap(m_motion_thread);
+		}
+		if (thread && thread->joinable())
+		{
+			thread->join();
+		}
+		m_motion.reset();
+
+		RETURN(0, int);
+	}
+
+	/**
+	 * 録画中以外にフレームを受け取って動き検出を行う
+	 * 録画スレッドと同時にuvc_get_frameを呼ぶとフレームを取り合うので
+	 * 録画中は録画スレッドに, 記録中は記録スレッドに解析を任せて待機する
+	 * 他の消費者とフレームを取り合わないように解析間隔の間は受け取らない
+	 */
+	/*private*/
+	void FlutterUVCHolder::motion_loop()
+	{
+		ENTER();
+
+		char name[THREAD_NAME_LEN];
+		snprintf(name, sizeof(name), "uvc%d-motion", m_device_id);
+		PipelineThread thread(m_device_id, name);
+		// 一時停止中なら映像取得を再開させる
+		m_consumers.acquire(CONSUMER_ANALYSIS);
+		// 映像サイズが変わっても良いように受け取れなかった時に大きくする
+		std::vector<uint8_t> buffer((size_t)DEFAULT_WIDTH * DEFAULT_HEIGHT * 2);
+		while (m_motion_enabled)
+		{
+			thread.update();
+			if (m_recording_active || m_capture_active)
+			{
+				// 録画スレッドまたは記録スレッドが解析する
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				continue;
+			}
+			uint32_t frame_type = RAW_FRAME_UNKNOWN;
+			uint32_t width = 0, height = 0;
+			uint32_t data_len = buffer.size();
+			int64_t pts_us = 0;
+			uint32_t flags = 0;
+			const int r = uvc_get_frame(m_manager, m_device_id,
+				&frame_type, &width, &height,
+				buffer.data(), &data_len, &pts_us, &flags);
+			if (r == -ENOSPC)
+			{
+				buffer.resize(buffer.size() * 2);
+				continue;
+			}
+			if (r || !data_len)
+			{
+				// 未着または破損したフレーム
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+			offer_still(frame_type, buffer.data(), data_len, width, height);
+			detect_motion(frame_type, buffer.data(), data_len, width, height, pts_us);
+			// 静止画の撮影待ちなら解析間隔を待たずに次のフレームを受け取る
+			const auto next = std::chrono::steady_clock::now()
+				+ std::chrono::milliseconds(m_motion_interval_ms.load());
+			while (m_motion_enabled && !m_still_requested
+				&& (std::chrono::steady_clock::now() < next))
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+		m_consumers.release(CONSUMER_ANALYSIS);
+
+		EXIT();
+	}
+
+	/**
+	 * 録画中以外にカメラが送ってきたフォーマットのままフレームを受け取ってファイルへ記録する
+	 * 録画中は録画スレッドが記録するので待機する
+	 * 記録するフレームが抜けないように動き検出中は動き検出スレッドの代わりに解析する
+	 */
+	/*private*/
+	void FlutterUVCHolder::capture_loop()
+	{
+		ENTER();
+
+		char name[THREAD_NAME_LEN];
+		snprintf(name, sizeof(name), "uvc%d-capture", m_device_id);
+		PipelineThread thread(m_device_id, name);
+		// 一時停止中なら映像取得を再開させる
+		m_consumers.acquire(CONSUMER_ANALYSIS);
+		// 映像サイズが変わっても良いように受け取れなかった時に大きくする
+		std::vector<uint8_t> buffer((size_t)DEFAULT_WIDTH * DEFAULT_HEIGHT * 2);
+		while (m_capture_active)
+		{
+			thread.update();
+			if (m_recording_active)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				continue;
+			}
+			uint32_t frame_type = RAW_FRAME_UNKNOWN;
+			uint32_t width = 0, height = 0;
+			uint32_t data_len = buffer.size();
+			int64_t pts_us = 0;
+			uint32_t flags = 0;
+			const int r = uvc_get_frame(m_manager, m_device_id,
+				&frame_type, &width, &height,
+				buffer.data(), &data_len, &pts_us, &flags);
+			if (r == -ENOSPC)
+			{
+				buffer.resize(buffer.size() * 2);
+				continue;
+			}
+			if (r || !data_len)
+			{
+				// 未着または破損したフレーム
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+			{
+				std::lock_guard<std::mutex> lock(m_capture_lock);
+				if (m_capture)
+				{
+					m_capture->write(frame_type, width, height,
+						buffer.data(), data_len, pts_us, flags);
+				}
+			}
+			offer_still(frame_type, buffer.data(), data_len, width, height);
+			if (m_motion_enabled)
+			{
+				detect_motion(frame_type, buffer.data(), data_len, width, height, pts_us);
+			}
+		}
+		m_consumers.release(CONSUMER_ANALYSIS);
+
+		EXIT();
+	}
+
+	/**
+	 * フレームを動き検出器へ渡して動きの有無が切り替わればコールバックを呼ぶ
+	 * 解析間隔とヒステリシスはフレームを受け取った時刻(CLOCK_MONOTONIC)で判断する
+	 */
+	/*private*/
+	void FlutterUVCHolder::detect_motion(
+		const uint32_t &frame_type, const uint8_t *data, const size_t &data_len,
+		const uint32_t &width, const uint32_t &height, const int64_t &pts_us)
+	{
+		MotionResult result;
+		const int64_t now_us = PtsClockModel::monotonic_ns() / 1000;
+		const int r = m_motion.process(frame_type, data, data_len, width, height, now_us, result);
+		if (r || !result.changed)
+		{
+			return;
+		}
+		OnMotionChanged on_motion;
+		{
+			std::lock_guard<std::mutex> lock(m_motion_lock);
+			on_motion = m_on_motion;
+		}
+		if (on_motion)
+		{
+			on_motion(m_device_id, result, pts_us);
+		}
+	}
+
+	/**
+	 * エンコーダーの録画開始からの累計を報告する
+	 * @param encoded_frames エンコードしたフレーム数
+	 * @param output_bytes エンコードしたバイト数
+	 * @param stall_us 書き込みが停滞した時間[マイクロ秒]
+	 * @param bitrate エンコーダーの現在のビットレート
+	 * @return エンコーダーに設定するビットレート, 0なら変更なし
+	 */
+	uint32_t FlutterUVCHolder::report_encoder_stats(
+		const uint64_t &encoded_frames, const uint64_t &output_bytes,
+		const uint64_t &stall_us, const uint32_t &bitrate)
+	{
+		const EncoderSample sample = {
+			PtsClockModel::monotonic_ns() / 1000,
+			encoded_frames, output_bytes, stall_us, bitrate,
+		};
+		return m_rate.update(sample);
+	}
+
+	/**
+	 * 消費者がいなくなってから映像取得を一時停止するまでの猶予時間をセットする
+	 * @param timeout_ms 猶予時間[ミリ秒], 負なら一時停止しない
+	 */
+	void FlutterUVCHolder::set_idle_timeout(const int64_t &timeout_ms)
+	{
+		ENTER();
+		m_consumers.set_idle_timeout(timeout_ms);
+		EXIT();
+	}
+
+	/**
+	 * 映像の消費者の登録状況と一時停止/再開の統計情報を取得する
+	 * @param metrics
+	 */
+	void FlutterUVCHolder::get_consumer_metrics(consumer_metrics_t &metrics) const
+	{
+		ENTER();
+		m_consumers.get_metrics(metrics);
+		EXIT();
+	}
+
+	/**
+	 * uvc_get_frameで受け取った映像フレームのファイルへの記録を開始する
+	 * 録画中かどうかにかかわらずカメラが送ってきたフォーマットのまま記録する
+	 * @param path 記録ファイルのパス, 既存のファイルは上書きする
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterUVCHolder::start_capture(const std::string &path)
+	{
+		ENTER();
+
+		auto capture = std::make_shared<FrameCaptureWriter>();
+		const auto result = capture->open(path);
+		if (!result)
+		{
+			std::shared_ptr<FrameCaptureWriter> prev;
+			{
+				std::lock_guard<std::mutex> lock(m_capture_lock);
+				prev = std::move(m_capture);
+				m_capture = capture;
+				if (!m_capture_active)
+				{
+					m_capture_active = true;
+					m_capture_thread = std::make_unique<std::thread>(&FlutterUVCHolder::capture_loop, this);
+				}
+			}
+			if (prev)
+			{
+				prev->close();
+			}
+		}
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 映像フレームの記録を終了する
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int FlutterUVCHolder::stop_capture()
+	{
+		ENTER();
+
+		std::shared_ptr<FrameCaptureWriter> capture;
+		std::unique_ptr<std::thread> thread;
+		{
+			std::lock_guard<std::mutex> lock(m_capture_lock);
+			capture = std::move(m_capture);
+			m_capture_active = false;
+			thread.swap(m_capture_thread);
+		}
+		if (thread && thread->joinable())
+		{
+			// 記録スレッドはm_capture_lockを保持して書き込むのでロックの外で待つ
+			thread->join();
+		}
+		const auto result = capture ? capture->close() : 0;
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 映像フレームを記録中かどうか
+	 * @return
+	 */
+	bool FlutterUVCHolder::is_capturing()
+	{
+		ENTER();
+
+		std::lock_guard<std::mutex> lock(m_capture_lock);
+
+		RETURN(m_capture != nullptr, bool);
+	}
+
+	/**
+	 * 対応解像度一覧/UVCコントロール一覧を取得する
+	 * prepare_asyncからワーカースレッド上で呼び出される
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	/*private*/
+	int FlutterUVCHolder::enumerate_capabilities()
+	{
+		ENTER();
+
+		uvc_resize(m_manager, m_device_id, m_initial_frame_type, m_initial_width, m_initial_height);
+
+		const auto result = update_supported_size();
+		get_current_size();
+		update_supported_ctrls();
+
+		RETURN(result, int);
+	}
+
+	/**
+	 * 映像取得開始後の最初のフレームまでの処理を前もって行う
+	 * prewarm_asyncからワーカースレッド上で呼び出される
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	/*private*/
+	int FlutterUVCHolder::prewarm()
+	{
+		ENTER();
+
+		// LOGDでだけ使うのでリリースビルドでは使わない
+		[[maybe_unused]] const auto begin = std::chrono::steady_clock::now();
+		// 共有タスクプールのワーカースレッドを最初のフレームの前に生成しておく
+		TaskPool::get_instance();
+		// 録画開始直後のフレームでページフォールトしないように
+		// 録画用のフレームバッファを確保して0クリアしておく
+		uvc_video_size_t size;
+		const auto r = uvc_get_current_size(m_manager, m_device_id, &size);
+		if (!r && size.width && size.height)
+		{
+			std::vector<uint8_t> buffer((size_t)size.width * size.height * 4);
+			std::lock_guard<std::mutex> lock(m_config_lock);
+			if (!m_recording_active)
+			{
+				m_prewarm_frame_buffer.swap(buffer);
+			}
+		}
+		LOGD("prewarmed in %lld us,r=%d", (long long)std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - begin).count(), r);
+
+		RETURN(r, int);
+	}
+
+	/**
+	 * 対応解像度一覧を更新する
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	/*private*/
+	int FlutterUVCHolder::update_supported_size()
+	{
+		ENTER();
+
+		m_supported_size.clear();
+		int32_t num_supported = 0;
+		auto r = uvc_get_supported_size(m_manager, m_device_id, 0, &num_supported, nullptr);
+		if (!r && num_supported)
+		{
+			uvc_video_size_t size;
+			for (int32_t i = 0; i < num_supported; i++)
+			{
+				r = uvc_get_supported_size(m_manager, m_device_id, i, &num_supported, &size);
+				if (!r)
+				{
+					m_supported_size.push_back(size);
+					LOGD("video_size_t(type=0x%08x,ix=%d,%dx%d)", size.frame_type, size.frame_index, size.width, size.height);
+				}
+				else
+				{
+					LOGE("Failed to get supported size,err=%d", r);
+					break;
+				}
+			}
+		}
+		else
+		{
+			LOGE("Failed to get supported size,err=%d", r);
+		}
+		LOGD("num_supported=%d,added=%" FMT_SIZE_T, num_supported, m_supported_size.size());
+
+		RETURN(r, int);
 	}
 
 	/**
@@ -0,0 +1,188 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#define LOG_TAG "FlutterVideoSize"
+
+#if 1	// デバッグ情報を出さない時は1
+	#ifndef LOG_NDEBUG
+		#define	LOG_NDEBUG		// LOGV/LOGD/MARKを出力しない時
+	#endif
+	#undef USE_LOGALL			// 指定したLOGxだけを出力
+#else
+	#define USE_LOGALL
+	#define USE_LOGD
+	#undef LOG_NDEBUG
+	#undef NDEBUG
+#endif
+
+// 標準ライブラリ
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+// aandusb
+#include "utilbase.h"
+// flutter
+#include "flutter_video_size.h"
+
+namespace serenegiant::flutter
+{
+
+	/**
+	 * フレームインターバル[100ナノ秒単位]をフレームレートへ変換する
+	 * @param interval
+	 * @return フレームレート, intervalが0なら0
+	 */
+	float interval_to_fps(const uint32_t &interval)
+	{
+		return interval ? FRAME_INTERVAL_UNITS_PER_SEC / (float)interval : 0.0f;
+	}
+
+	/**
+	 * フレームレートをフレームインターバル[100ナノ秒単位]へ変換する
+	 * @param fps
+	 * @return フレームインターバル, fpsが0以下なら0
+	 */
+	uint32_t fps_to_interval(const float &fps)
+	{
+		return fps > 0.0f ? (uint32_t)std::lround(FRAME_INTERVAL_UNITS_PER_SEC / fps) : 0;
+	}
+
+	/**
+	 * 指定したフレームインターバルがmin_fps〜max_fpsの範囲内かどうか
+	 * @param interval
+	 * @param min_fps 0以下なら制限なし
+	 * @param max_fps 0以下なら制限なし
+	 * @return
+	 */
+	static bool is_in_range(const uint32_t &interval, const float &min_fps, const float &max_fps)
+	{
+		// 浮動小数点の丸め誤差で30fps指定時に29.97fpsが外れたりしないように少し余裕を持たせる
+		static constexpr float EPS = 0.01f;
+		const auto fps = interval_to_fps(interval);
+		return (fps > 0.0f)
+			&& ((min_fps <= 0.0f) || (fps >= min_fps - EPS))
+			&& ((max_fps <= 0.0f) || (fps <= max_fps + EPS));
+	}
+
+	/**
+	 * 映像サイズ設定が対応しているフレームインターバルの中から
+	 * 指定したフレームレートに最も近いものを選択する
+	 * min_fps/max_fpsは0以下なら制限なし
+	 * @param size 映像サイズ設定
+	 * @param fps 要求するフレームレート, 0以下ならmin_fps〜max_fpsの範囲内で最大のフレームレートを選択する
+	 * @param min_fps 最小フレームレート
+	 * @param max_fps 最大フレームレート
+	 * @return 選択したフレームインターバル[100ナノ秒単位], 該当するものが無ければ0
+	 */
+	uint32_t select_frame_interval(
+		const uvc_video_size_t &size,
+		const float &fps, const float &min_fps, const float &max_fps)
+	{
+		ENTER();
+
+		uint32_t result = 0;
+		if (UNLIKELY(!size.frame_intervals || (size.num_frame_intervals <= 0)))
+		{
+			RETURN(result, uint32_t);
+		}
+		// 要求フレームインターバル, 0なら範囲内で最大のフレームレート(=最小のフレームインターバル)を選択する
+		const auto requested = fps_to_interval(fps);
+		if (!size.frame_interval_type && (size.num_frame_intervals >= 3))
+		{
+			// 連続値(min/max/step)の場合
+			const auto min_interval = size.frame_intervals[0];
+			const auto max_interval = std::max(size.frame_intervals[1], min_interval);
+			const auto step = size.frame_intervals[2] ? size.frame_intervals[2] : 1;
+			// 範囲指定をフレームインターバルの範囲へ変換して対応範囲と重なる部分を求める
+			auto lo = max_fps > 0.0f ? std::max(min_interval, fps_to_interval(max_fps)) : min_interval;
+			auto hi = min_fps > 0.0f ? std::min(max_interval, fps_to_interval(min_fps)) : max_interval;
+			if (lo <= hi)
+			{
+				const auto target = requested ? std::clamp(requested, lo, hi) : lo;
+				// stepの倍数へ丸めてから範囲内へ収める
+				auto n = (target - min_interval + step / 2) / step;
+				result = min_interval + n * step;
+				while ((result < lo) && (result + step <= hi)) result += step;
+				while ((result > hi) && (result >= min_interval + step)) result -= step;
+				if ((result < lo) || (result > hi))
+				{
+					result = 0;
+				}
+			}
+		}
+		else
+		{
+			// 離散値の場合
+			uint64_t best_diff = UINT64_MAX;
+			for (int32_t i = 0; i < size.num_frame_intervals; i++)
+			{
+				const auto interval = size.frame_intervals[i];
+				if (!is_in_range(interval, min_fps, max_fps))
+				{
+					continue;
+				}
+				if (requested)
+				{
+					const uint64_t diff = interval > requested ? interval - requested : requested - interval;
+					if (diff < best_diff)
+					{
+						best_diff = diff;
+						result = interval;
+					}
+				}
+				else if (!result || (interval < result))
+				{
+					result = interval;
+				}
+			}
+		}
+		LOGD("fps=%f(%f-%f),selected=%u", fps, min_fps, max_fps, result);
+
+		RETURN(result, uint32_t);
+	}
+
+	/**
+	 * uvc_video_size_tをDart側とやりとりするためのflutter_video_size_tへコピーする
+	 * フレームインターバル/フレームレートはMAX_INTERVALS個までしかコピーしない
+	 * @param src
+	 * @param dst
+	 */
+	void copy_video_size(const uvc_video_size_t &src, flutter_video_size_t &dst)
+	{
+		ENTER();
+
+		memset(&dst, 0, sizeof(dst));
+		dst.frame_type = src.frame_type;
+		dst.frame_index = src.frame_index;
+		dst.width = src.width;
+		dst.height = src.height;
+		dst.frame_interval_type = src.frame_interval_type;
+		if (src.frame_intervals && (src.num_frame_intervals > 0))
+		{
+			dst.num_frame_intervals = std::min(src.num_frame_intervals, MAX_INTERVALS);
+			memcpy(dst.frame_intervals, src.frame_intervals, sizeof(uint32_t) * dst.num_frame_intervals);
+		}
+		if (src.fps && (src.num_fps > 0))
+		{
+			dst.num_fps = std::min(src.num_fps, MAX_INTERVALS);
+			memcpy(dst.fps, src.fps, sizeof(float) * dst.num_fps);
+		}
+
+		EXIT();
+	}
+
+}	// namespace serenegiant::flutter
@@ -0,0 +1,38 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+// 標準ライブラリ
+#include <cstdarg>
+#include <cstdio>
+// android
+#include <android/log.h>
+
+/**
+ * ホスト上でのandroid/log.hの実装, logcatの代わりに標準エラー出力へ書き込む
+ */
+int __android_log_print(int prio, const char *tag, const char *fmt, ...)
+{
+	static const char PRIORITY[] = "??VDIWEFS";
+	const char p = (prio >= 0) && (prio < (int)sizeof(PRIORITY) - 1) ? PRIORITY[prio] : '?';
+	int result = fprintf(stderr, "[%c/%s]:", p, tag ? tag : "");
+	va_list args;
+	va_start(args, fmt);
+	result += vfprintf(stderr, fmt, args);
+	va_end(args);
+	fputc('\n', stderr);
+	return result + 1;
+}
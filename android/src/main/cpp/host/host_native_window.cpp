@@ -0,0 +1,183 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#define LOG_TAG "HostNativeWindow"
+
+// 標準ライブラリ
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+// aandusb
+#include "utilbase.h"
+// host
+#include "host_native_window.h"
+
+/**
+ * メモリー上のダブルバッファへ描画するANativeWindowの実装
+ * ANativeWindow_lockでバックバッファを返し、ANativeWindow_unlockAndPostで表裏を入れ替える
+ */
+struct ANativeWindow {
+	std::atomic<int32_t> ref_count{1};
+	std::mutex lock;
+	int32_t width;
+	int32_t height;
+	int32_t format;
+	// ANativeWindow_setBuffersGeometryで指定したバッファサイズ, 0ならウインドウサイズ
+	int32_t buffer_width = 0;
+	int32_t buffer_height = 0;
+	int32_t buffer_format = 0;
+	bool locked = false;
+	std::vector<uint8_t> back;
+	std::vector<uint8_t> front;
+	int32_t front_width = 0;
+	int32_t front_height = 0;
+	uint64_t posted = 0;
+
+	ANativeWindow(const int32_t &_width, const int32_t &_height, const int32_t &_format)
+	:	width(_width), height(_height), format(_format)
+	{
+	}
+};
+
+/*private*/
+static inline int32_t buffer_width(const ANativeWindow *window)
+{
+	return window->buffer_width > 0 ? window->buffer_width : window->width;
+}
+
+/*private*/
+static inline int32_t buffer_height(const ANativeWindow *window)
+{
+	return window->buffer_height > 0 ? window->buffer_height : window->height;
+}
+
+ANativeWindow *host_native_window_create(
+	const int32_t &width, const int32_t &height,
+	const int32_t &format)
+{
+	ENTER();
+	RET(new ANativeWindow(width, height, format));
+}
+
+uint64_t host_native_window_get_posted_frames(ANativeWindow *window)
+{
+	if (!window) return 0;
+	std::lock_guard<std::mutex> lock(window->lock);
+	return window->posted;
+}
+
+int host_native_window_copy_front(
+	ANativeWindow *window,
+	std::vector<uint8_t> &dst, int32_t &width, int32_t &height)
+{
+	ENTER();
+
+	if (!window) RETURN(-EINVAL, int);
+	std::lock_guard<std::mutex> lock(window->lock);
+	if (!window->posted) RETURN(-ENOENT, int);
+	dst = window->front;
+	width = window->front_width;
+	height = window->front_height;
+
+	RETURN(0, int);
+}
+
+//--------------------------------------------------------------------------------
+void ANativeWindow_acquire(ANativeWindow *window)
+{
+	if (window) {
+		window->ref_count++;
+	}
+}
+
+void ANativeWindow_release(ANativeWindow *window)
+{
+	if (window && (--window->ref_count == 0)) {
+		delete window;
+	}
+}
+
+int32_t ANativeWindow_getWidth(ANativeWindow *window)
+{
+	if (!window) return -EINVAL;
+	std::lock_guard<std::mutex> lock(window->lock);
+	return buffer_width(window);
+}
+
+int32_t ANativeWindow_getHeight(ANativeWindow *window)
+{
+	if (!window) return -EINVAL;
+	std::lock_guard<std::mutex> lock(window->lock);
+	return buffer_height(window);
+}
+
+int32_t ANativeWindow_getFormat(ANativeWindow *window)
+{
+	if (!window) return -EINVAL;
+	std::lock_guard<std::mutex> lock(window->lock);
+	return window->buffer_format ? window->buffer_format : window->format;
+}
+
+int32_t ANativeWindow_setBuffersGeometry(ANativeWindow *window, int32_t width, int32_t height, int32_t format)
+{
+	if (!window || (width < 0) || (height < 0) || (!width != !height)) return -EINVAL;
+	std::lock_guard<std::mutex> lock(window->lock);
+	window->buffer_width = width;
+	window->buffer_height = height;
+	window->buffer_format = format;
+	return 0;
+}
+
+int32_t ANativeWindow_lock(ANativeWindow *window, ANativeWindow_Buffer *out_buffer, ARect *in_out_dirty_bounds)
+{
+	if (!window || !out_buffer) return -EINVAL;
+	std::lock_guard<std::mutex> lock(window->lock);
+	if (window->locked) return -EBUSY;
+	const auto width = buffer_width(window);
+	const auto height = buffer_height(window);
+	const auto format = window->buffer_format ? window->buffer_format : window->format;
+	// ホスト上ではRGB565も含めて4バイト/ピクセル分確保しておく
+	window->back.resize((size_t)width * height * 4);
+	window->locked = true;
+	out_buffer->width = width;
+	out_buffer->height = height;
+	out_buffer->stride = width;
+	out_buffer->format = format;
+	out_buffer->bits = window->back.data();
+	if (in_out_dirty_bounds) {
+		// 常に全面を書き換える
+		in_out_dirty_bounds->left = in_out_dirty_bounds->top = 0;
+		in_out_dirty_bounds->right = width;
+		in_out_dirty_bounds->bottom = height;
+	}
+	return 0;
+}
+
+int32_t ANativeWindow_unlockAndPost(ANativeWindow *window)
+{
+	if (!window) return -EINVAL;
+	std::lock_guard<std::mutex> lock(window->lock);
+	if (!window->locked) return -EINVAL;
+	window->locked = false;
+	window->front.swap(window->back);
+	window->front_width = buffer_width(window);
+	window->front_height = buffer_height(window);
+	window->posted++;
+	return 0;
+}
@@ -0,0 +1,71 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef AANDUSB_HOST_ANDROID_NATIVE_WINDOW_H
+#define AANDUSB_HOST_ANDROID_NATIVE_WINDOW_H
+
+/**
+ * ホスト(Android以外)でビルドするためのandroid/native_window.hの代替ヘッダー
+ * aandusb_native.hがANativeWindowの型宣言を必要とするので型を定義する
+ * 実装はhost/host_native_window.cpp(メモリー上のバッファへ描画するだけ)
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ANativeWindow;
+typedef struct ANativeWindow ANativeWindow;
+
+typedef struct ARect {
+	int32_t left;
+	int32_t top;
+	int32_t right;
+	int32_t bottom;
+} ARect;
+
+typedef struct ANativeWindow_Buffer {
+	int32_t width;
+	int32_t height;
+	int32_t stride;		// ピクセル単位
+	int32_t format;
+	void *bits;
+	uint32_t reserved[6];
+} ANativeWindow_Buffer;
+
+enum {
+	WINDOW_FORMAT_RGBA_8888 = 1,
+	WINDOW_FORMAT_RGBX_8888 = 2,
+	WINDOW_FORMAT_RGB_565 = 4,
+};
+
+void ANativeWindow_acquire(ANativeWindow *window);
+void ANativeWindow_release(ANativeWindow *window);
+int32_t ANativeWindow_getWidth(ANativeWindow *window);
+int32_t ANativeWindow_getHeight(ANativeWindow *window);
+int32_t ANativeWindow_getFormat(ANativeWindow *window);
+int32_t ANativeWindow_setBuffersGeometry(ANativeWindow *window, int32_t width, int32_t height, int32_t format);
+int32_t ANativeWindow_lock(ANativeWindow *window, ANativeWindow_Buffer *out_buffer, ARect *in_out_dirty_bounds);
+int32_t ANativeWindow_unlockAndPost(ANativeWindow *window);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //AANDUSB_HOST_ANDROID_NATIVE_WINDOW_H
@@ -0,0 +1,28 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef AANDUSB_HOST_ANDROID_NATIVE_WINDOW_JNI_H
+#define AANDUSB_HOST_ANDROID_NATIVE_WINDOW_JNI_H
+
+/**
+ * ホスト(Android以外)でビルドするためのandroid/native_window_jni.hの代替ヘッダー
+ * ホストにはJava側のSurfaceが無いのでANativeWindowの宣言だけを取り込む
+ * ホスト上でANativeWindowを生成するときはhost_native_window.hのhost_native_window_createを使う
+ */
+#include <android/native_window.h>
+
+#endif //AANDUSB_HOST_ANDROID_NATIVE_WINDOW_JNI_H
@@ -0,0 +1,63 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef AANDUSB_HOST_NATIVE_WINDOW_H
+#define AANDUSB_HOST_NATIVE_WINDOW_H
+
+/**
+ * ホスト上でANativeWindowの代わりに使うメモリー上の描画先
+ * Android上ではSurfaceから生成するANativeWindowをホストで生成/検証するためのヘルパー関数
+ */
+
+// 標準ライブラリ
+#include <cstdint>
+#include <vector>
+// android
+#include <android/native_window.h>
+
+/**
+ * メモリー上へ描画するANativeWindowを生成する
+ * 参照カウントは1, 不要になればANativeWindow_releaseを呼ぶこと
+ * @param width
+ * @param height
+ * @param format WINDOW_FORMAT_XXX
+ * @return
+ */
+ANativeWindow *host_native_window_create(
+	const int32_t &width, const int32_t &height,
+	const int32_t &format = WINDOW_FORMAT_RGBA_8888);
+
+/**
+ * ANativeWindow_unlockAndPostで表示(post)されたフレーム数を取得する
+ * @param window
+ * @return
+ */
+uint64_t host_native_window_get_posted_frames(ANativeWindow *window);
+
+/**
+ * 最後に表示(post)されたフレームをコピーする
+ * @param window
+ * @param dst 4バイト/ピクセル, stride=width
+ * @param width
+ * @param height
+ * @return 0: 成功, 負: エラーコード(-ENOENT: まだ1フレームも表示されていない)
+ */
+int host_native_window_copy_front(
+	ANativeWindow *window,
+	std::vector<uint8_t> &dst, int32_t &width, int32_t &height);
+
+#endif //AANDUSB_HOST_NATIVE_WINDOW_H
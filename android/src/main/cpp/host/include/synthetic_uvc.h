@@ -0,0 +1,163 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef AANDUSB_HOST_SYNTHETIC_UVC_H
+#define AANDUSB_HOST_SYNTHETIC_UVC_H
+
+/**
+ * ホスト(Linux等)上でaandusb_native.hのAPIを実装する合成UVC機器バックエンド
+ * 実機のUVC機器の代わりにYUYV/MJPEG/NV12/H264の映像を合成して
+ * FlutterUVCHolderやFlutterUvcFrameRendererをホスト上で動かす(負荷試験/ベンチマーク用)
+ *
+ * manager_initで生成したusb_manager_tに対してsynthetic_uvc_attachで機器を追加すると
+ * 実機の接続時と同様にon_device_attach_tコールバックが呼ばれる
+ */
+
+// 標準ライブラリ
+#include <cstdint>
+// aandusb
+#include "aandusb_native.h"
+
+// 合成する映像フォーマット, synthetic_uvc_config_t.formatsへ論理和で指定する
+#define SYNTHETIC_FORMAT_YUYV	(0x00000001)
+#define SYNTHETIC_FORMAT_MJPEG	(0x00000002)
+#define SYNTHETIC_FORMAT_NV12	(0x00000004)
+#define SYNTHETIC_FORMAT_H264	(0x00000008)	// NALの構造だけを模したもの(デコードはできない)
+#define SYNTHETIC_FORMAT_ALL	(0x0000000f)
+
+/**
+ * 合成UVC機器の設定
+ */
+typedef struct synthetic_uvc_config {
+	uint16_t vendor_id;
+	uint16_t product_id;
+	/**
+	 * 製品名, nullptrなら"Synthetic UVC"
+	 */
+	const char *name;
+	/**
+	 * 対応する映像フォーマット, SYNTHETIC_FORMAT_XXXの論理和
+	 */
+	uint32_t formats;
+	/**
+	 * 対応解像度の上限
+	 * 320x240から3840x2160までの一般的な解像度のうち上限以下のものと上限の解像度に対応する
+	 */
+	uint32_t max_width;
+	uint32_t max_height;
+	/**
+	 * 最大フレームレート
+	 * 非圧縮フォーマットはUSB2.0のアイソクロナス転送の帯域に収まるフレームレートのみ対応する
+	 */
+	float fps;
+	/**
+	 * フレーム到着タイミングの揺らぎ[マイクロ秒], ±jitter_usの一様分布
+	 */
+	uint32_t jitter_us;
+	/**
+	 * uvc_get_frameがエラー(-EIO)を返す確率[0,1]
+	 */
+	float error_rate;
+	/**
+	 * 機器側クロックのずれ[ppm], pts_usへ反映する
+	 */
+	float drift_ppm;
+	/**
+	 * falseなら毎フレーム同じ映像を生成する
+	 */
+	bool moving;
+	/**
+	 * UAC(48kHz/16bit/モノラル)を持つかどうか
+	 */
+	bool audio;
+	/**
+	 * uvc_get_frameで返すフレームへ遅延測定用のスタンプ(シーケンス番号と撮影時刻)を埋め込むかどうか
+	 * MJPEGはCOMセグメント, 非圧縮フォーマットは先頭の16バイトへ埋め込む
+	 */
+	bool latency_probe;
+	/**
+	 * MJPEGのフレームからハフマンテーブル(DHT)を取り除くかどうか
+	 * 多くのUVC機器と同じく標準のハフマンテーブル(JPEG Annex K.3)を前提にしたフレームになる
+	 */
+	bool omit_dht;
+	/**
+	 * 揺らぎ/エラー発生用の乱数シード
+	 */
+	uint32_t seed;
+} synthetic_uvc_config_t;
+
+/**
+ * 合成UVC機器の統計情報
+ */
+typedef struct synthetic_uvc_stats {
+	uint64_t generated;	// 生成したフレーム数
+	uint64_t delivered;	// uvc_get_frameで返したフレーム数
+	uint64_t dropped;	// uvc_get_frameで読み取られる前に上書きされたフレーム数
+	uint64_t errors;	// uvc_get_frameでエラーを返したフレーム数
+	uint64_t rendered;	// uvc_set_surfaceでセットしたSurfaceへ描画したフレーム数
+} synthetic_uvc_stats_t;
+
+/**
+ * 合成UVC機器の設定を既定値で初期化する
+ * YUYV/MJPEG/NV12/H264, 最大1920x1080@30fps, 揺らぎ/エラー無し
+ * @param config
+ */
+void synthetic_uvc_default_config(synthetic_uvc_config_t &config);
+
+/**
+ * 合成UVC機器を接続する
+ * manager_initで指定したon_device_attach_tコールバックが呼び出し元スレッドで呼ばれる
+ * @param manager manager_initで生成したUSBデバイスマネージャー
+ * @param config
+ * @return 正: 機器ID, 負: エラーコード
+ */
+int32_t synthetic_uvc_attach(usb_manager_t *manager, const synthetic_uvc_config_t &config);
+
+/**
+ * 合成UVC機器を取り外す
+ * 映像取得中なら停止してからon_device_detach_tコールバックを呼び出し元スレッドで呼ぶ
+ * @param manager
+ * @param device_id
+ * @return 0: 成功, 負: エラーコード
+ */
+int synthetic_uvc_detach(usb_manager_t *manager, const int32_t &device_id);
+
+/**
+ * 合成UVC機器の統計情報を取得する
+ * @param manager
+ * @param device_id
+ * @param stats
+ * @return 0: 成功, 負: エラーコード
+ */
+int synthetic_uvc_get_stats(
+	usb_manager_t *manager, const int32_t &device_id,
+	synthetic_uvc_stats_t &stats);
+
+/**
+ * 合成UVC機器の映像を止める/再開する
+ * 止めている間は止めた時点の絵を繰り返し生成する(H264はGOP構造のみ維持)
+ * 動き検出の確認用
+ * @param manager
+ * @param device_id
+ * @param frozen true: 止める, false: 再開する
+ * @return 0: 成功, 負: エラーコード
+ */
+int synthetic_uvc_freeze(
+	usb_manager_t *manager, const int32_t &device_id,
+	const bool &frozen);
+
+#endif //AANDUSB_HOST_SYNTHETIC_UVC_H
@@ -0,0 +1,1543 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#define LOG_TAG "SyntheticUVC"
+
+#if 1 // デバッグ情報を出さない時は1
+#ifndef LOG_NDEBUG
+#define LOG_NDEBUG // LOGV/LOGD/MARKを出力しない時
+#endif
+#undef USE_LOGALL // 指定したLOGxだけを出力
+#else
+#define USE_LOGALL
+#undef LOG_NDEBUG
+#undef NDEBUG
+#endif
+
+// 標準ライブラリ
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+// libjpeg-turbo
+#include "jpeglib.h"
+// aandusb
+#include "utilbase.h"
+// flutter
+#include "flutter_bandwidth_planner.h"
+#include "flutter_latency_probe.h"
+#include "flutter_mjpeg_decoder.h"
+#include "flutter_video_size.h"
+// host
+#include "synthetic_uvc.h"
+
+namespace serenegiant::usb::synthetic {
+
+using namespace serenegiant::flutter;
+
+// 合成するMJPEGフレームの種類数(動きがあるときはこれを順に繰り返す)
+#define NUM_MJPEG_FRAMES (8)
+#define MJPEG_QUALITY (85)
+// 1フレーム毎のカラーバーの水平移動量[ピクセル], 偶数にすること
+#define MOVING_STEP (8)
+// UACの設定, 1パケット=1ミリ秒分
+#define AUDIO_SAMPLING_FREQ (48000)
+#define AUDIO_CHANNELS (1)
+#define AUDIO_RESOLUTION (16)
+#define AUDIO_PACKET_BYTES (AUDIO_SAMPLING_FREQ / 1000 * AUDIO_CHANNELS * AUDIO_RESOLUTION / 8)
+#define AUDIO_TONE_HZ (1000)
+
+/**
+ * BT.601(limited range)のカラーバー(白,黄,シアン,緑,マゼンタ,赤,青,黒)のY/Cb/Cr
+ */
+static const uint8_t BAR_YUV[8][3] = {
+	{ 235, 128, 128 }, { 210, 16, 146 }, { 170, 166, 16 }, { 145, 54, 34 },
+	{ 106, 202, 222 }, { 81, 90, 240 }, { 41, 240, 110 }, { 16, 128, 128 },
+};
+
+/**
+ * 対応解像度の候補
+ */
+static const uint32_t STANDARD_SIZES[][2] = {
+	{ 320, 240 }, { 640, 480 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 },
+};
+
+/**
+ * フレームレートの候補(最大フレームレート以外)
+ */
+static const float STANDARD_FPS[] = { 30.0f, 15.0f, 5.0f };
+
+/**
+ * 合成したフレーム
+ * dataは使いまわすのでbytesが有効なデータのバイト数
+ */
+typedef struct frame {
+	uint32_t frame_type = RAW_FRAME_UNKNOWN;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> data;
+	size_t bytes = 0;
+	int64_t pts_us = 0;
+	/**
+	 * 映像生成スレッドが撮影したとみなすCLOCK_MONOTONICの時刻[ナノ秒]とシーケンス番号
+	 * 遅延測定を有効にしたときにuvc_get_frameで返すフレームへ埋め込む
+	 */
+	int64_t capture_ns = 0;
+	uint32_t seq = 0;
+	bool error = false;
+} frame_t;
+
+/**
+ * 合成UVC機器の対応コントロール機能の既定値
+ */
+typedef struct control_def {
+	uint64_t type;
+	int32_t def;
+	int32_t res;
+	int32_t min;
+	int32_t max;
+} control_def_t;
+
+static const control_def_t CONTROLS[] = {
+	{ CTRL_AE, 8, 1, 1, 8 },
+	{ CTRL_AE_ABS, 156, 1, 3, 2047 },
+	{ CTRL_FOCUS_ABS, 0, 1, 0, 255 },
+	{ CTRL_ZOOM_ABS, 100, 1, 100, 500 },
+	{ CTRL_FOCUS_AUTO, 1, 1, 0, 1 },
+	{ PU_MASK | PU_BRIGHTNESS, 0, 1, -64, 64 },
+	{ PU_MASK | PU_CONTRAST, 32, 1, 0, 64 },
+	{ PU_MASK | PU_SATURATION, 64, 1, 0, 128 },
+	{ PU_MASK | PU_SHARPNESS, 3, 1, 0, 6 },
+	{ PU_MASK | PU_GAMMA, 100, 1, 72, 500 },
+	{ PU_MASK | PU_WB_TEMP, 4600, 10, 2800, 6500 },
+	{ PU_MASK | PU_GAIN, 0, 1, 0, 100 },
+	{ PU_MASK | PU_POWER_LF, 1, 1, 0, 2 },
+	{ PU_MASK | PU_WB_TEMP_AUTO, 1, 1, 0, 1 },
+};
+
+static inline int64_t now_us()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static inline uint8_t clamp_u8(const int &v)
+{
+	return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+/**
+ * BT.601(limited range)のYUVからRGBXへ変換
+ */
+static inline void yuv_to_rgbx(const int &y, const int &u, const int &v, uint8_t *dst)
+{
+	const int c = 298 * (y - 16);
+	const int d = u - 128;
+	const int e = v - 128;
+	dst[0] = clamp_u8((c + 409 * e + 128) >> 8);
+	dst[1] = clamp_u8((c - 100 * d - 208 * e + 128) >> 8);
+	dst[2] = clamp_u8((c + 516 * d + 128) >> 8);
+	dst[3] = 0xff;
+}
+
+static void yuyv_to_rgbx(const uint8_t *src, const uint32_t &width, const uint32_t &height, uint8_t *dst)
+{
+	const size_t pairs = (size_t)width * height / 2;
+	for (size_t i = 0; i < pairs; i++, src += 4, dst += 8) {
+		yuv_to_rgbx(src[0], src[1], src[3], dst);
+		yuv_to_rgbx(src[2], src[1], src[3], dst + 4);
+	}
+}
+
+static void nv12_to_rgbx(const uint8_t *src, const uint32_t &width, const uint32_t &height, uint8_t *dst)
+{
+	const uint8_t *uv_plane = src + (size_t)width * height;
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *yy = src + (size_t)y * width;
+		const uint8_t *uv = uv_plane + (size_t)(y / 2) * width;
+		for (uint32_t x = 0; x < width; x++, dst += 4) {
+			yuv_to_rgbx(yy[x], uv[x & ~1u], uv[(x & ~1u) + 1], dst);
+		}
+	}
+}
+
+/**
+ * YUYVからNV12/NV21へ変換
+ * @param swap_uv trueならNV21
+ */
+static void yuyv_to_yuv420sp(
+	const uint8_t *src, const uint32_t &width, const uint32_t &height,
+	uint8_t *dst, const bool &swap_uv)
+{
+	uint8_t *uv_plane = dst + (size_t)width * height;
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *row = src + (size_t)y * width * 2;
+		uint8_t *yy = dst + (size_t)y * width;
+		uint8_t *uv = (y & 1) ? nullptr : uv_plane + (size_t)(y / 2) * width;
+		for (uint32_t x = 0; x < width; x += 2, row += 4) {
+			yy[x] = row[0];
+			yy[x + 1] = row[2];
+			if (uv) {
+				uv[x] = swap_uv ? row[3] : row[1];
+				uv[x + 1] = swap_uv ? row[1] : row[3];
+			}
+		}
+	}
+}
+
+/**
+ * NV12からNV12/NV21へ変換
+ * @param swap_uv trueならNV21
+ */
+static void nv12_to_yuv420sp(
+	const uint8_t *src, const uint32_t &width, const uint32_t &height,
+	uint8_t *dst, const bool &swap_uv)
+{
+	const size_t y_bytes = (size_t)width * height;
+	memcpy(dst, src, y_bytes);
+	const size_t uv_bytes = y_bytes / 2;
+	if (swap_uv) {
+		for (size_t i = 0; i < uv_bytes; i += 2) {
+			dst[y_bytes + i] = src[y_bytes + i + 1];
+			dst[y_bytes + i + 1] = src[y_bytes + i];
+		}
+	} else {
+		memcpy(dst + y_bytes, src + y_bytes, uv_bytes);
+	}
+}
+
+/**
+ * YUYVをJPEGへ圧縮する
+ * @return 0: 成功, 負: エラーコード
+ */
+static int encode_jpeg(
+	const uint8_t *yuyv, const uint32_t &width, const uint32_t &height,
+	std::vector<uint8_t> &jpeg)
+{
+	ENTER();
+
+	jpeg_compress_struct cinfo{};
+	jpeg_error_mgr jerr{};
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_compress(&cinfo);
+	unsigned char *out = nullptr;
+	unsigned long out_size = 0;
+	jpeg_mem_dest(&cinfo, &out, &out_size);
+	cinfo.image_width = width;
+	cinfo.image_height = height;
+	cinfo.input_components = 3;
+	cinfo.in_color_space = JCS_YCbCr;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_quality(&cinfo, MJPEG_QUALITY, TRUE);
+	// UVC機器のMJPEGと同じ4:2:2にする
+	cinfo.comp_info[0].h_samp_factor = 2;
+	cinfo.comp_info[0].v_samp_factor = 1;
+	cinfo.dct_method = JDCT_IFAST;
+	jpeg_start_compress(&cinfo, TRUE);
+	std::vector<uint8_t> row(width * 3);
+	while (cinfo.next_scanline < cinfo.image_height) {
+		const uint8_t *src = yuyv + (size_t)cinfo.next_scanline * width * 2;
+		for (uint32_t x = 0; x < width; x += 2, src += 4) {
+			uint8_t *dst = &row[x * 3];
+			dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[3];
+			dst[3] = src[2]; dst[4] = src[1]; dst[5] = src[3];
+		}
+		JSAMPROW rows[1] = { row.data() };
+		jpeg_write_scanlines(&cinfo, rows, 1);
+	}
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+	jpeg.assign(out, out + out_size);
+	free(out);
+
+	RETURN(jpeg.empty() ? -EIO : 0, int);
+}
+
+/**
+ * JPEGからハフマンテーブル(DHT)のセグメントを取り除く
+ * 最初のSOSより後ろはそのまま
+ */
+static void strip_dht(std::vector<uint8_t> &jpeg)
+{
+	size_t pos = 2;
+	while ((pos + 3 < jpeg.size()) && (jpeg[pos + 1] != 0xda)) {
+		const size_t len = ((size_t)jpeg[pos + 2] << 8) | jpeg[pos + 3];
+		if (jpeg[pos + 1] == 0xc4) {
+			jpeg.erase(jpeg.begin() + pos, jpeg.begin() + pos + 2 + len);
+		} else {
+			pos += 2 + len;
+		}
+	}
+}
+
+/**
+ * 合成したフレームを指定した映像フォーマットへ変換する
+ * @param dst_type RAW_FRAME_UNKNOWNなら変換しない
+ * @param bytes 変換後のバイト数(-ENOSPCのときは必要なバイト数)
+ * @param decoder MJPEGを変換するときに使うデコーダー(スレッド毎に用意すること)
+ * @return 0: 成功, 負: エラーコード
+ */
+static int convert_frame(
+	const frame_t &src, const uint32_t &dst_type,
+	uint8_t *dst, const size_t &capacity, size_t &bytes, uint32_t &out_type,
+	MjpegDecoder &decoder, std::vector<uint8_t> &decoded)
+{
+	const size_t pixels = (size_t)src.width * src.height;
+	out_type = dst_type;
+	if ((dst_type == RAW_FRAME_UNKNOWN) || (dst_type == src.frame_type)) {
+		out_type = src.frame_type;
+		bytes = src.bytes;
+		if (capacity < bytes) return -ENOSPC;
+		memcpy(dst, src.data.data(), bytes);
+		return 0;
+	}
+	switch (dst_type) {
+	case RAW_FRAME_UNCOMPRESSED_RGBX:
+		bytes = pixels * 4;
+		if (capacity < bytes) return -ENOSPC;
+		switch (src.frame_type) {
+		case RAW_FRAME_UNCOMPRESSED_YUYV:
+			yuyv_to_rgbx(src.data.data(), src.width, src.height, dst);
+			return 0;
+		case RAW_FRAME_UNCOMPRESSED_NV12:
+			nv12_to_rgbx(src.data.data(), src.width, src.height, dst);
+			return 0;
+		case RAW_FRAME_MJPEG:
+		{
+			uint32_t w = 0, h = 0;
+			if (decoder.decode(src.data.data(), src.bytes, 0, 0, decoded, w, h)
+				|| (w != src.width) || (h != src.height)) {
+				return -EIO;
+			}
+			memcpy(dst, decoded.data(), bytes);
+			return 0;
+		}
+		default:
+			return -ENOTSUP;
+		}
+	case RAW_FRAME_UNCOMPRESSED_NV12:
+	case RAW_FRAME_UNCOMPRESSED_NV21:
+		bytes = pixels * 3 / 2;
+		if (capacity < bytes) return -ENOSPC;
+		switch (src.frame_type) {
+		case RAW_FRAME_UNCOMPRESSED_YUYV:
+			yuyv_to_yuv420sp(src.data.data(), src.width, src.height, dst,
+				dst_type == RAW_FRAME_UNCOMPRESSED_NV21);
+			return 0;
+		case RAW_FRAME_UNCOMPRESSED_NV12:
+			nv12_to_yuv420sp(src.data.data(), src.width, src.height, dst,
+				dst_type == RAW_FRAME_UNCOMPRESSED_NV21);
+			return 0;
+		default:
+			return -ENOTSUP;
+		}
+	case RAW_FRAME_MJPEG:
+	case RAW_FRAME_H264:
+		// MJPEGやH264へは変換できない
+		return -EINVAL;
+	default:
+		return -ENOTSUP;
+	}
+}
+
+/**
+ * 合成UVC機器
+ */
+class SyntheticDevice {
+private:
+	const int32_t m_device_id;
+	const synthetic_uvc_config_t m_config;
+	const std::string m_name;
+	mutable std::mutex m_lock;
+	// 対応解像度一覧, frame_intervals/fpsはm_intervals/m_fpsを指す
+	std::vector<uvc_video_size_t> m_sizes;
+	std::vector<std::vector<uint32_t>> m_intervals;
+	std::vector<std::vector<float>> m_fps;
+	size_t m_current = 0;
+	std::map<uint64_t, int32_t> m_control_values;
+	ANativeWindow *m_surface = nullptr;
+	// 映像生成スレッド
+	std::atomic<bool> m_running{false};
+	std::unique_ptr<std::thread> m_thread;
+	std::mt19937 m_random;
+	// trueなら映像を止めて最後の絵を繰り返す, m_frozen_kは映像生成スレッドのみが使う
+	std::atomic<bool> m_frozen{false};
+	uint64_t m_frozen_k = 0;
+	// カラーバー1行分を2回繰り返したもの, 移動量分ずらしてコピーする
+	std::vector<uint8_t> m_row_yuyv;
+	std::vector<uint8_t> m_row_y;
+	std::vector<uint8_t> m_row_uv;
+	std::vector<std::vector<uint8_t>> m_jpegs;
+	std::vector<uint8_t> m_h264_pool;
+	frame_t m_work;		// 映像生成スレッドが書き込む
+	// 最新フレーム
+	std::mutex m_frame_lock;
+	frame_t m_ready;
+	bool m_has_frame = false;
+	// uvc_get_frameで読み取り中のフレーム
+	std::mutex m_read_lock;
+	frame_t m_reading;
+	// uvc_get_frameとSurfaceへの描画はスレッドが異なるのでMJPEGデコーダーを別々に持つ
+	MjpegDecoder m_decoder;
+	std::vector<uint8_t> m_decoded;
+	MjpegDecoder m_surface_decoder;
+	std::vector<uint8_t> m_surface_decoded;
+	std::vector<uint8_t> m_surface_rgbx;
+	// UAC
+	std::atomic<bool> m_audio_running{false};
+	int64_t m_audio_start_us = 0;
+	uint64_t m_audio_packets = 0;
+	// 統計情報
+	std::atomic<uint64_t> m_generated{0};
+	std::atomic<uint64_t> m_delivered{0};
+	std::atomic<uint64_t> m_dropped{0};
+	std::atomic<uint64_t> m_errors{0};
+	std::atomic<uint64_t> m_rendered{0};
+
+	void init_sizes();
+	void add_size(const uint32_t &frame_type, const uint32_t &frame_index,
+		const uint32_t &width, const uint32_t &height);
+	void prepare_source(const uvc_video_size_t &size);
+	void render_yuyv(uint8_t *dst, const uint32_t &width, const uint32_t &height, const uint64_t &n) const;
+	void render_nv12(uint8_t *dst, const uint32_t &width, const uint32_t &height, const uint64_t &n) const;
+	void render_h264(frame_t &frame, const uint64_t &n, const uint32_t &gop);
+	void render_frame(frame_t &frame, const uvc_video_size_t &size, const uint64_t &n, const uint32_t &gop);
+	void render_surface(const frame_t &frame);
+	void generator_loop();
+public:
+	SyntheticDevice(const int32_t &device_id, const synthetic_uvc_config_t &config);
+	~SyntheticDevice();
+
+	[[nodiscard]]
+	inline int32_t id() const { return m_device_id; };
+	[[nodiscard]]
+	inline const synthetic_uvc_config_t &config() const { return m_config; };
+	[[nodiscard]]
+	inline const std::string &name() const { return m_name; };
+	[[nodiscard]]
+	inline bool is_running() const { return m_running; };
+	inline void freeze(const bool &frozen) { m_frozen = frozen; };
+
+	int resize(const uint32_t &frame_type, const uint32_t &width, const uint32_t &height);
+	int start();
+	int stop();
+	int get_supported_size(const int32_t &index, int32_t *num_supported, uvc_video_size_t *size) const;
+	int get_current_size(uvc_video_size_t *size) const;
+	int get_control_info(uvc_control_info_t *info) const;
+	int set_control_value(const uint64_t &type, const int32_t &value);
+	int get_control_value(const uint64_t &type, int32_t *value) const;
+	int set_surface(ANativeWindow *surface);
+	int get_frame(
+		uint32_t *frame_type, uint32_t *width, uint32_t *height,
+		uint8_t *data, uint32_t *data_len,
+		int64_t *pts_us, uint32_t *flags);
+	int audio_start();
+	int audio_stop();
+	[[nodiscard]]
+	inline bool is_audio_running() const { return m_audio_running; };
+	int audio_get_frame(uint8_t *data, uint32_t *data_len, int64_t *pts_us);
+	void get_stats(synthetic_uvc_stats_t &stats) const;
+};
+
+typedef std::shared_ptr<SyntheticDevice> SyntheticDeviceSp;
+
+/*public*/
+SyntheticDevice::SyntheticDevice(const int32_t &device_id, const synthetic_uvc_config_t &config)
+:	m_device_id(device_id), m_config(config),
+	m_name(config.name ? config.name : "Synthetic UVC"),
+	m_random(config.seed ^ (uint32_t)device_id)
+{
+	ENTER();
+
+	init_sizes();
+	for (const auto &ctrl : CONTROLS) {
+		m_control_values[ctrl.type] = ctrl.def;
+	}
+
+	EXIT();
+}
+
+/*public*/
+SyntheticDevice::~SyntheticDevice()
+{
+	ENTER();
+
+	stop();
+	audio_stop();
+	set_surface(nullptr);
+
+	EXIT();
+}
+
+/**
+ * 設定から対応解像度一覧を生成する
+ */
+/*private*/
+void SyntheticDevice::init_sizes()
+{
+	ENTER();
+
+	static const uint32_t FORMATS[][2] = {
+		{ SYNTHETIC_FORMAT_YUYV, RAW_FRAME_UNCOMPRESSED_YUYV },
+		{ SYNTHETIC_FORMAT_MJPEG, RAW_FRAME_MJPEG },
+		{ SYNTHETIC_FORMAT_NV12, RAW_FRAME_UNCOMPRESSED_NV12 },
+		{ SYNTHETIC_FORMAT_H264, RAW_FRAME_H264 },
+	};
+	for (const auto &format : FORMATS) {
+		if (!(m_config.formats & format[0])) continue;
+		uint32_t frame_index = 1;
+		bool has_max = false;
+		for (const auto &sz : STANDARD_SIZES) {
+			if ((sz[0] <= m_config.max_width) && (sz[1] <= m_config.max_height)) {
+				add_size(format[1], frame_index++, sz[0], sz[1]);
+				has_max |= (sz[0] == m_config.max_width) && (sz[1] == m_config.max_height);
+			}
+		}
+		if (!has_max) {
+			add_size(format[1], frame_index, m_config.max_width, m_config.max_height);
+		}
+	}
+	// frame_intervals/fpsのポインタをセットする(vectorの再配置後でないといけない)
+	for (size_t i = 0; i < m_sizes.size(); i++) {
+		m_sizes[i].frame_intervals = m_intervals[i].data();
+		m_sizes[i].num_frame_intervals = (int32_t)m_intervals[i].size();
+		m_sizes[i].frame_interval_type = (int32_t)m_intervals[i].size();
+		m_sizes[i].fps = m_fps[i].data();
+		m_sizes[i].num_fps = (int32_t)m_fps[i].size();
+	}
+
+	EXIT();
+}
+
+/**
+ * 対応解像度を追加する
+ * 非圧縮フォーマットはUSB2.0のアイソクロナス転送の帯域に収まるフレームレートのみ
+ */
+/*private*/
+void SyntheticDevice::add_size(
+	const uint32_t &frame_type, const uint32_t &frame_index,
+	const uint32_t &width, const uint32_t &height)
+{
+	ENTER();
+
+	std::vector<float> candidates = { m_config.fps };
+	for (const auto &fps : STANDARD_FPS) {
+		if (fps < m_config.fps) {
+			candidates.push_back(fps);
+		}
+	}
+	const bool uncompressed = (frame_type & 0xffff) == 0x0005;
+	const auto bytes_per_frame = (uint64_t)width * height * 2;
+	std::vector<uint32_t> intervals;
+	for (const auto &fps : candidates) {
+		if (!uncompressed || (bytes_per_frame * fps <= BANDWIDTH_USB2_ENDPOINT)) {
+			intervals.push_back(fps_to_interval(fps));
+		}
+	}
+	if (intervals.empty()) {
+		// 帯域に収まる最大のフレームレートだけに対応する
+		intervals.push_back((uint32_t)((bytes_per_frame * FRAME_INTERVAL_UNITS_PER_SEC
+			+ BANDWIDTH_USB2_ENDPOINT - 1) / BANDWIDTH_USB2_ENDPOINT));
+	}
+	std::vector<float> fps;
+	for (const auto &interval : intervals) {
+		fps.push_back(interval_to_fps(interval));
+	}
+	uvc_video_size_t size{};
+	size.frame_type = frame_type;
+	size.frame_index = frame_index;
+	size.width = width;
+	size.height = height;
+	m_sizes.push_back(size);
+	m_intervals.push_back(std::move(intervals));
+	m_fps.push_back(std::move(fps));
+
+	EXIT();
+}
+
+/*public*/
+int SyntheticDevice::resize(const uint32_t &frame_type, const uint32_t &width, const uint32_t &height)
+{
+	ENTER();
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	for (size_t i = 0; i < m_sizes.size(); i++) {
+		const auto &size = m_sizes[i];
+		if ((size.frame_type == frame_type) && (size.width == width) && (size.height == height)) {
+			if (m_running && (i != m_current)) {
+				LOGW("can't resize while streaming");
+				RETURN(-EBUSY, int);
+			}
+			m_current = i;
+			RETURN(0, int);
+		}
+	}
+
+	RETURN(-EINVAL, int);
+}
+
+/*public*/
+int SyntheticDevice::start()
+{
+	ENTER();
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (m_sizes.empty()) RETURN(-EINVAL, int);
+	if (!m_running) {
+		prepare_source(m_sizes[m_current]);
+		{
+			std::lock_guard<std::mutex> frame_lock(m_frame_lock);
+			m_has_frame = false;
+		}
+		m_running = true;
+		m_thread = std::make_unique<std::thread>([this] { generator_loop(); });
+	}
+
+	RETURN(0, int);
+}
+
+/*public*/
+int SyntheticDevice::stop()
+{
+	ENTER();
+
+	std::unique_ptr<std::thread> thread;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_running = false;
+		thread = std::move(m_thread);
+	}
+	if (thread && thread->joinable()) {
+		thread->join();
+	}
+
+	RETURN(0, int);
+}
+
+/*public*/
+int SyntheticDevice::get_supported_size(
+	const int32_t &index, int32_t *num_supported, uvc_video_size_t *size) const
+{
+	ENTER();
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (num_supported) {
+		*num_supported = (int32_t)m_sizes.size();
+	}
+	if (size) {
+		if ((index < 0) || (index >= (int32_t)m_sizes.size())) RETURN(-EINVAL, int);
+		*size = m_sizes[index];
+	}
+
+	RETURN(0, int);
+}
+
+/*public*/
+int SyntheticDevice::get_current_size(uvc_video_size_t *size) const
+{
+	ENTER();
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (!size || m_sizes.empty()) RETURN(-EINVAL, int);
+	*size = m_sizes[m_current];
+
+	RETURN(0, int);
+}
+
+/*public*/
+int SyntheticDevice::get_control_info(uvc_control_info_t *info) const
+{
+	ENTER();
+
+	if (!info) RETURN(-EINVAL, int);
+	std::lock_guard<std::mutex> lock(m_lock);
+	for (const auto &ctrl : CONTROLS) {
+		if (ctrl.type == info->type) {
+			info->initialized = 1;
+			info->has_min_max = 1;
+			info->def = ctrl.def;
+			info->current = m_control_values.at(ctrl.type);
+			info->res = ctrl.res;
+			info->min = ctrl.min;
+			info->max = ctrl.max;
+			RETURN(0, int);
+		}
+	}
+
+	RETURN(-EINVAL, int);
+}
+
+/*public*/
+int SyntheticDevice::set_control_value(const uint64_t &type, const int32_t &value)
+{
+	ENTER();
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	for (const auto &ctrl : CONTROLS) {
+		if (ctrl.type == type) {
+			m_control_values[type] = CLAMP(value, ctrl.min, ctrl.max);
+			RETURN(0, int);
+		}
+	}
+
+	RETURN(-EINVAL, int);
+}
+
+/*public*/
+int SyntheticDevice::get_control_value(const uint64_t &type, int32_t *value) const
+{
+	ENTER();
+
+	if (!value) RETURN(-EINVAL, int);
+	std::lock_guard<std::mutex> lock(m_lock);
+	const auto found = m_control_values.find(type);
+	if (found == m_control_values.end()) RETURN(-EINVAL, int);
+	*value = found->second;
+
+	RETURN(0, int);
+}
+
+/*public*/
+int SyntheticDevice::set_surface(ANativeWindow *surface)
+{
+	ENTER();
+
+	std::lock_guard<std::mutex> lock(m_frame_lock);
+	if (m_surface != surface) {
+		if (m_surface) {
+			ANativeWindow_release(m_surface);
+		}
+		m_surface = surface;
+		if (m_surface) {
+			ANativeWindow_acquire(m_surface);
+		}
+	}
+
+	RETURN(0, int);
+}
+
+/**
+ * 映像生成に必要なデータを準備する
+ * カラーバー1行分と, MJPEGなら圧縮済みのフレーム, H264ならペイロード用の乱数列
+ */
+/*private*/
+void SyntheticDevice::prepare_source(const uvc_video_size_t &size)
+{
+	ENTER();
+
+	const uint32_t width = size.width;
+	const uint32_t height = size.height;
+	m_row_yuyv.resize(width * 4);
+	m_row_y.resize(width * 2);
+	m_row_uv.resize(width * 2);
+	for (uint32_t x = 0; x < width * 2; x += 2) {
+		const auto &bar = BAR_YUV[((x % width) * 8) / width];
+		m_row_yuyv[x * 2 + 0] = bar[0];
+		m_row_yuyv[x * 2 + 1] = bar[1];
+		m_row_yuyv[x * 2 + 2] = bar[0];
+		m_row_yuyv[x * 2 + 3] = bar[2];
+		m_row_y[x] = m_row_y[x + 1] = bar[0];
+		m_row_uv[x] = bar[1];
+		m_row_uv[x + 1] = bar[2];
+	}
+	m_jpegs.clear();
+	if (size.frame_type == RAW_FRAME_MJPEG) {
+		std::vector<uint8_t> yuyv((size_t)width * height * 2);
+		const int n = m_config.moving ? NUM_MJPEG_FRAMES : 1;
+		for (int i = 0; i < n; i++) {
+			render_yuyv(yuyv.data(), width, height, (uint64_t)i * width / (MOVING_STEP * n));
+			std::vector<uint8_t> jpeg;
+			if (!encode_jpeg(yuyv.data(), width, height, jpeg)) {
+				if (m_config.omit_dht) {
+					strip_dht(jpeg);
+				}
+				m_jpegs.push_back(std::move(jpeg));
+			}
+		}
+	}
+	m_h264_pool.clear();
+	if (size.frame_type == RAW_FRAME_H264) {
+		// スタートコードと紛らわしくならないように0を含まない乱数列にする
+		m_h264_pool.resize(std::max<size_t>(4096, (size_t)width * height / 4));
+		std::uniform_int_distribution<int> dist(1, 255);
+		for (auto &v : m_h264_pool) {
+			v = (uint8_t)dist(m_random);
+		}
+	}
+
+	EXIT();
+}
+
+/**
+ * YUYVのカラーバーを生成する
+ * 動きがあるときはフレーム毎にカラーバーが左へ, 白い横線が下へ移動する
+ */
+/*private*/
+void SyntheticDevice::render_yuyv(
+	uint8_t *dst, const uint32_t &width, const uint32_t &height,
+	const uint64_t &n) const
+{
+	const size_t row_bytes = (size_t)width * 2;
+	const size_t shift = ((n * MOVING_STEP) % width) & ~1u;
+	const uint32_t band_height = std::max<uint32_t>(2, height / 60);
+	const uint32_t band_top = (uint32_t)((n * 4) % height);
+	for (uint32_t y = 0; y < height; y++, dst += row_bytes) {
+		if ((y >= band_top) && (y < band_top + band_height)) {
+			for (size_t x = 0; x < row_bytes; x += 2) {
+				dst[x] = 235;
+				dst[x + 1] = 128;
+			}
+		} else {
+			memcpy(dst, &m_row_yuyv[shift * 2], row_bytes);
+		}
+	}
+}
+
+/**
+ * NV12のカラーバーを生成する
+ */
+/*private*/
+void SyntheticDevice::render_nv12(
+	uint8_t *dst, const uint32_t &width, const uint32_t &height,
+	const uint64_t &n) const
+{
+	const size_t shift = ((n * MOVING_STEP) % width) & ~1u;
+	const uint32_t band_height = std::max<uint32_t>(2, height / 60);
+	const uint32_t band_top = (uint32_t)((n * 4) % height);
+	uint8_t *uv_plane = dst + (size_t)width * height;
+	for (uint32_t y = 0; y < height; y++) {
+		const bool band = (y >= band_top) && (y < band_top + band_height);
+		uint8_t *yy = dst + (size_t)y * width;
+		if (band) {
+			memset(yy, 235, width);
+		} else {
+			memcpy(yy, &m_row_y[shift], width);
+		}
+		if (!(y & 1)) {
+			uint8_t *uv = uv_plane + (size_t)(y / 2) * width;
+			if (band) {
+				memset(uv, 128, width);
+			} else {
+				memcpy(uv, &m_row_uv[shift], width);
+			}
+		}
+	}
+}
+
+/**
+ * H264のアクセスユニットを模したデータを生成する
+ * Annex-B形式でGOPの先頭はSPS/PPS/IDR, それ以外はnon-IDRスライス
+ * NALの構造とサイズだけを模したものなのでデコードはできない
+ */
+/*private*/
+void SyntheticDevice::render_h264(frame_t &frame, const uint64_t &n, const uint32_t &gop)
+{
+	static const uint8_t START_CODE[] = { 0x00, 0x00, 0x00, 0x01 };
+	static const uint8_t SPS[] = { 0x67, 0x64, 0x00, 0x28, 0xac, 0xd9, 0x40, 0x78, 0x02, 0x27, 0xe5, 0x84 };
+	static const uint8_t PPS[] = { 0x68, 0xeb, 0xe3, 0xcb, 0x22, 0xc0 };
+
+	const bool idr = (n % gop) == 0;
+	const size_t pixels = (size_t)frame.width * frame.height;
+	std::uniform_int_distribution<int> variation(90, 110);
+	size_t payload = (idr ? pixels / 8 : pixels / 64) * variation(m_random) / 100;
+	payload = std::min(std::max<size_t>(payload, 256), m_h264_pool.size() - 1);
+	frame.data.resize(sizeof(START_CODE) * 3 + sizeof(SPS) + sizeof(PPS) + 1 + payload);
+	uint8_t *dst = frame.data.data();
+	if (idr) {
+		memcpy(dst, START_CODE, sizeof(START_CODE)); dst += sizeof(START_CODE);
+		memcpy(dst, SPS, sizeof(SPS)); dst += sizeof(SPS);
+		memcpy(dst, START_CODE, sizeof(START_CODE)); dst += sizeof(START_CODE);
+		memcpy(dst, PPS, sizeof(PPS)); dst += sizeof(PPS);
+	}
+	memcpy(dst, START_CODE, sizeof(START_CODE)); dst += sizeof(START_CODE);
+	*dst++ = idr ? 0x65 : 0x41;
+	const size_t offset = (n * 4099) % (m_h264_pool.size() - payload);
+	memcpy(dst, &m_h264_pool[offset], payload); dst += payload;
+	frame.bytes = dst - frame.data.data();
+}
+
+/**
+ * 現在の映像フォーマットでn番目のフレームを生成する
+ */
+/*private*/
+void SyntheticDevice::render_frame(
+	frame_t &frame, const uvc_video_size_t &size,
+	const uint64_t &n, const uint32_t &gop)
+{
+	frame.frame_type = size.frame_type;
+	frame.width = size.width;
+	frame.height = size.height;
+	if (!m_frozen) {
+		m_frozen_k = m_config.moving ? n : 0;
+	}
+	const uint64_t k = m_frozen_k;
+	switch (size.frame_type) {
+	case RAW_FRAME_UNCOMPRESSED_YUYV:
+		frame.bytes = (size_t)size.width * size.height * 2;
+		frame.data.resize(frame.bytes);
+		render_yuyv(frame.data.data(), size.width, size.height, k);
+		break;
+	case RAW_FRAME_UNCOMPRESSED_NV12:
+		frame.bytes = (size_t)size.width * size.height * 3 / 2;
+		frame.data.resize(frame.bytes);
+		render_nv12(frame.data.data(), size.width, size.height, k);
+		break;
+	case RAW_FRAME_MJPEG:
+	{
+		if (m_jpegs.empty()) {
+			frame.bytes = 0;
+			break;
+		}
+		const auto &jpeg = m_jpegs[k % m_jpegs.size()];
+		frame.data.resize(std::max(frame.data.size(), jpeg.size()));
+		memcpy(frame.data.data(), jpeg.data(), jpeg.size());
+		frame.bytes = jpeg.size();
+		break;
+	}
+	case RAW_FRAME_H264:
+		render_h264(frame, n, gop);
+		break;
+	default:
+		frame.bytes = 0;
+		break;
+	}
+}
+
+/**
+ * uvc_set_surfaceでセットしたSurfaceへ描画する
+ * m_frame_lockを保持した状態で呼び出すこと
+ */
+/*private*/
+void SyntheticDevice::render_surface(const frame_t &frame)
+{
+	size_t bytes = 0;
+	uint32_t out_type;
+	m_surface_rgbx.resize((size_t)frame.width * frame.height * 4);
+	if (convert_frame(frame, RAW_FRAME_UNCOMPRESSED_RGBX,
+		m_surface_rgbx.data(), m_surface_rgbx.size(), bytes, out_type,
+		m_surface_decoder, m_surface_decoded)) {
+		return;
+	}
+	ANativeWindow_Buffer buffer;
+	if (ANativeWindow_lock(m_surface, &buffer, nullptr) == 0) {
+		const int32_t w = std::min((int32_t)frame.width, buffer.width);
+		const int32_t h = std::min((int32_t)frame.height, buffer.height);
+		auto dst = static_cast<uint8_t *>(buffer.bits);
+		const uint8_t *src = m_surface_rgbx.data();
+		for (int32_t y = 0; y < h; y++) {
+			memcpy(dst + (size_t)y * buffer.stride * 4, src + (size_t)y * frame.width * 4, w * 4);
+		}
+		ANativeWindow_unlockAndPost(m_surface);
+		m_rendered++;
+	}
+}
+
+/**
+ * 映像生成スレッドの実行関数
+ * フレームインターバル毎に揺らぎを加えたタイミングでフレームを生成する
+ * pts_usは揺らぎを含まない機器側クロック(drift_ppm分ずれる)
+ */
+/*private*/
+void SyntheticDevice::generator_loop()
+{
+	ENTER();
+
+	uvc_video_size_t size;
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		size = m_sizes[m_current];
+	}
+	const uint32_t interval = size.frame_intervals[0];
+	const auto interval_us = std::chrono::microseconds(interval / 10);
+	const uint32_t gop = std::max<uint32_t>(1, (uint32_t)lroundf(interval_to_fps(interval)));
+	const double clock_scale = 1.0 + m_config.drift_ppm * 1.0e-6;
+	const int32_t jitter = (int32_t)m_config.jitter_us;
+	std::uniform_int_distribution<int32_t> jitter_dist(-jitter, jitter);
+	std::uniform_real_distribution<float> error_dist(0.0f, 1.0f);
+
+	const auto start = std::chrono::steady_clock::now();
+	const int64_t pts_base = now_us();
+	auto due = start;
+	for (uint64_t n = 0; m_running; n++) {
+		due += interval_us;
+		const auto now = std::chrono::steady_clock::now();
+		if (now > due + interval_us) {
+			// 生成が間に合わなかったときはスケジュールを現在時刻へ合わせる
+			due = now;
+		}
+		std::this_thread::sleep_until(due + std::chrono::microseconds(jitter ? jitter_dist(m_random) : 0));
+		if (!m_running) break;
+		m_work.capture_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+		m_work.seq = (uint32_t)n;
+		render_frame(m_work, size, n, gop);
+		const auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(due - start).count();
+		m_work.pts_us = pts_base + (int64_t)(elapsed_us * clock_scale);
+		m_work.error = (m_config.error_rate > 0.0f) && (error_dist(m_random) < m_config.error_rate);
+		m_generated++;
+		{
+			std::lock_guard<std::mutex> lock(m_frame_lock);
+			if (m_surface && !m_work.error) {
+				render_surface(m_work);
+			}
+			if (m_has_frame) {
+				m_dropped++;
+			}
+			std::swap(m_ready, m_work);
+			m_has_frame = true;
+		}
+	}
+
+	EXIT();
+}
+
+/**
+ * 最新フレームを取得する
+ * 新しいフレームが無ければ-EAGAIN, フレームエラーを模擬したときは-EIOを返す
+ * バッファが足りないときは*data_lenへ必要なバイト数をセットして-ENOSPCを返す(フレームは破棄される)
+ */
+/*public*/
+int SyntheticDevice::get_frame(
+	uint32_t *frame_type, uint32_t *width, uint32_t *height,
+	uint8_t *data, uint32_t *data_len,
+	int64_t *pts_us, uint32_t *flags)
+{
+	if (!data || !data_len) return -EINVAL;
+	std::lock_guard<std::mutex> read_lock(m_read_lock);
+	{
+		std::lock_guard<std::mutex> lock(m_frame_lock);
+		if (!m_has_frame) return -EAGAIN;
+		std::swap(m_reading, m_ready);
+		m_has_frame = false;
+	}
+	if (m_reading.error) {
+		m_errors++;
+		return -EIO;
+	}
+	size_t bytes = 0;
+	uint32_t out_type = RAW_FRAME_UNKNOWN;
+	const size_t capacity = *data_len;
+	const int result = convert_frame(m_reading,
+		frame_type ? *frame_type : (uint32_t)RAW_FRAME_UNKNOWN,
+		data, capacity, bytes, out_type,
+		m_decoder, m_decoded);
+	if (!result && m_config.latency_probe) {
+		// 変換後のフレームへ埋め込む, 埋め込めないフォーマットやバッファが足りないときはスタンプ無し
+		const latency_stamp_t stamp = { m_reading.seq, m_reading.capture_ns };
+		latency_probe_embed(out_type, data, bytes, capacity, stamp);
+	}
+	*data_len = (uint32_t)bytes;
+	if (result) return result;
+	if (frame_type) *frame_type = out_type;
+	if (width) *width = m_reading.width;
+	if (height) *height = m_reading.height;
+	if (pts_us) *pts_us = m_reading.pts_us;
+	if (flags) *flags = 0;
+	m_delivered++;
+
+	return 0;
+}
+
+/*public*/
+int SyntheticDevice::audio_start()
+{
+	ENTER();
+
+	if (!m_config.audio) RETURN(-ENODEV, int);
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (!m_audio_running) {
+		m_audio_start_us = now_us();
+		m_audio_packets = 0;
+		m_audio_running = true;
+	}
+
+	RETURN(0, int);
+}
+
+/*public*/
+int SyntheticDevice::audio_stop()
+{
+	ENTER();
+
+	m_audio_running = false;
+
+	RETURN(0, int);
+}
+
+/**
+ * 1ミリ秒分の正弦波を返す
+ * 経過時間分のパケットを読み取り済みなら-EAGAIN
+ */
+/*public*/
+int SyntheticDevice::audio_get_frame(uint8_t *data, uint32_t *data_len, int64_t *pts_us)
+{
+	if (!data_len) return -EINVAL;
+	if (!data) {
+		*data_len = AUDIO_PACKET_BYTES;
+		return 0;
+	}
+	if (*data_len < AUDIO_PACKET_BYTES) return -ENOSPC;
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (!m_audio_running) return -EAGAIN;
+	const auto available = (uint64_t)((now_us() - m_audio_start_us) / 1000);
+	if (m_audio_packets >= available) return -EAGAIN;
+	const uint32_t samples = AUDIO_SAMPLING_FREQ / 1000;
+	const uint64_t first = m_audio_packets * samples;
+	for (uint32_t i = 0; i < samples; i++) {
+		const double t = (double)(first + i) / AUDIO_SAMPLING_FREQ;
+		const auto sample = (int16_t)(8192.0 * sin(2.0 * M_PI * AUDIO_TONE_HZ * t));
+		memcpy(data + i * sizeof(int16_t), &sample, sizeof(int16_t));
+	}
+	*data_len = AUDIO_PACKET_BYTES;
+	if (pts_us) *pts_us = m_audio_start_us + (int64_t)m_audio_packets * 1000;
+	m_audio_packets++;
+
+	return 0;
+}
+
+/*public*/
+void SyntheticDevice::get_stats(synthetic_uvc_stats_t &stats) const
+{
+	stats.generated = m_generated;
+	stats.delivered = m_delivered;
+	stats.dropped = m_dropped;
+	stats.errors = m_errors;
+	stats.rendered = m_rendered;
+}
+
+} // namespace serenegiant::usb::synthetic
+
+using namespace serenegiant::usb::synthetic;
+
+/**
+ * 合成UVC機器用のUSBデバイスマネージャー
+ */
+struct manager {
+	void *args;
+	on_device_attach_t on_attach;
+	on_device_detach_t on_detach;
+	std::mutex lock;
+	int32_t next_device_id = 1;
+	std::unordered_map<int32_t, SyntheticDeviceSp> devices;
+};
+
+static SyntheticDeviceSp find_device(usb_manager_t *manager, const int32_t &device_id)
+{
+	if (!manager) return nullptr;
+	std::lock_guard<std::mutex> lock(manager->lock);
+	const auto found = manager->devices.find(device_id);
+	return found != manager->devices.end() ? found->second : nullptr;
+}
+
+//--------------------------------------------------------------------------------
+// 合成UVC機器の操作
+//--------------------------------------------------------------------------------
+void synthetic_uvc_default_config(synthetic_uvc_config_t &config)
+{
+	config = {};
+	config.vendor_id = 0x1209;
+	config.product_id = 0x5543;
+	config.name = nullptr;
+	config.formats = SYNTHETIC_FORMAT_ALL;
+	config.max_width = 1920;
+	config.max_height = 1080;
+	config.fps = 30.0f;
+	config.moving = true;
+	config.seed = 1;
+}
+
+int32_t synthetic_uvc_attach(usb_manager_t *manager, const synthetic_uvc_config_t &config)
+{
+	ENTER();
+
+	if (!manager || !config.formats || (config.fps <= 0.0f)
+		|| (config.max_width < 2) || (config.max_height < 2)
+		|| (config.max_width & 1) || (config.max_height & 1)) {
+		RETURN(-EINVAL, int32_t);
+	}
+	int32_t device_id;
+	{
+		std::lock_guard<std::mutex> lock(manager->lock);
+		device_id = manager->next_device_id++;
+		manager->devices[device_id] = std::make_shared<SyntheticDevice>(device_id, config);
+	}
+	LOGI("attached synthetic device %d", device_id);
+	if (manager->on_attach) {
+		manager->on_attach(manager, manager->args, device_id);
+	}
+
+	RETURN(device_id, int32_t);
+}
+
+int synthetic_uvc_detach(usb_manager_t *manager, const int32_t &device_id)
+{
+	ENTER();
+
+	if (!manager) RETURN(-EINVAL, int);
+	SyntheticDeviceSp device;
+	{
+		std::lock_guard<std::mutex> lock(manager->lock);
+		const auto found = manager->devices.find(device_id);
+		if (found == manager->devices.end()) RETURN(-ENODEV, int);
+		device = found->second;
+		manager->devices.erase(found);
+	}
+	device->stop();
+	device->audio_stop();
+	device->set_surface(nullptr);
+	LOGI("detached synthetic device %d", device_id);
+	if (manager->on_detach) {
+		manager->on_detach(manager, manager->args, device_id);
+	}
+
+	RETURN(0, int);
+}
+
+int synthetic_uvc_get_stats(
+	usb_manager_t *manager, const int32_t &device_id,
+	synthetic_uvc_stats_t &stats)
+{
+	ENTER();
+
+	const auto device = find_device(manager, device_id);
+	if (!device) RETURN(-ENODEV, int);
+	device->get_stats(stats);
+
+	RETURN(0, int);
+}
+
+int synthetic_uvc_freeze(
+	usb_manager_t *manager, const int32_t &device_id,
+	const bool &frozen)
+{
+	ENTER();
+
+	const auto device = find_device(manager, device_id);
+	if (!device) RETURN(-ENODEV, int);
+	device->freeze(frozen);
+
+	RETURN(0, int);
+}
+
+//--------------------------------------------------------------------------------
+// native Cバインディング/USB
+//--------------------------------------------------------------------------------
+usb_manager_t *manager_init(void *args, on_device_attach_t on_attach, on_device_detach_t on_detach)
+{
+	ENTER();
+
+	auto manager = new usb_manager_t();
+	manager->args = args;
+	manager->on_attach = on_attach;
+	manager->on_detach = on_detach;
+
+	RET(manager);
+}
+
+void manager_release(usb_manager_t *manager)
+{
+	ENTER();
+
+	if (manager) {
+		std::unordered_map<int32_t, SyntheticDeviceSp> devices;
+		{
+			std::lock_guard<std::mutex> lock(manager->lock);
+			devices.swap(manager->devices);
+		}
+		devices.clear();
+		delete manager;
+	}
+
+	EXIT();
+}
+
+int32_t usb_match(usb_manager_t *manager, int32_t device_id, uint8_t bClass, uint8_t bSubClass, uint8_t bProtocol)
+{
+	const auto device = find_device(manager, device_id);
+	if (!device) return 0;
+	// 機器(IAD)とインターフェース(映像, 音声)のクラス/サブクラス/プロトコル
+	std::vector<std::array<uint8_t, 3>> classes = {
+		{ 0xef, 0x02, 0x01 }, { 0x0e, 0x01, 0x00 }, { 0x0e, 0x02, 0x00 },
+	};
+	if (device->config().audio) {
+		classes.push_back({ 0x01, 0x01, 0x00 });
+		classes.push_back({ 0x01, 0x02, 0x00 });
+	}
+	for (const auto &c : classes) {
+		if (((bClass == 0xff) || (bClass == c[0]))
+			&& ((bSubClass == 0xff) || (bSubClass == c[1]))
+			&& ((bProtocol == 0xff) || (bProtocol == c[2]))) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+uint16_t usb_get_bcd_usb(usb_manager_t *manager, int32_t device_id)
+{
+	return find_device(manager, device_id) ? 0x0200 : 0;
+}
+
+uint8_t usb_get_device_class(usb_manager_t *manager, int32_t device_id)
+{
+	return find_device(manager, device_id) ? 0xef : 0;
+}
+
+uint8_t usb_get_device_sub_class(usb_manager_t *manager, int32_t device_id)
+{
+	return find_device(manager, device_id) ? 0x02 : 0;
+}
+
+uint8_t usb_get_device_protocol(usb_manager_t *manager, int32_t device_id)
+{
+	return find_device(manager, device_id) ? 0x01 : 0;
+}
+
+uint16_t usb_get_vendor_id(usb_manager_t *manager, int32_t device_id)
+{
+	const auto device = find_device(manager, device_id);
+	return device ? device->config().vendor_id : 0;
+}
+
+uint16_t usb_get_product_id(usb_manager_t *manager, int32_t device_id)
+{
+	const auto device = find_device(manager, device_id);
+	return device ? device->config().product_id : 0;
+}
+
+int usb_get_name(usb_manager_t *manager, int32_t device_id, char *buffer, size_t *buf_size)
+{
+	ENTER();
+
+	const auto device = find_device(manager, device_id);
+	if (!device) RETURN(-ENODEV, int);
+	if (!buffer || !buf_size || !*buf_size) RETURN(-EINVAL, int);
+	const auto &name = device->name();
+	const size_t len = std::min(name.size(), *buf_size - 1);
+	memcpy(buffer, name.c_str(), len);
+	buffer[len] = '\0';
+	*buf_size = len;
+
+	RETURN(0, int);
+}
+
+int usb_get_device_info(usb_manager_t *manager, int32_t device_id, usb_device_info_t *info)
+{
+	ENTER();
+
+	const auto device = find_device(manager, device_id);
+	if (!device) RETURN(-ENODEV, int);
+	if (!info) RETURN(-EINVAL, int);
+	memset(info, 0, sizeof(usb_device_info_t));
+	info->bcd_usb = 0x0200;
+	info->vendor_id = device->config().vendor_id;
+	info->product_id = device->config().product_id;
+	info->device_class = 0xef;
+	info->device_subclass = 0x02;
+	info->device_protocol = 0x01;
+	snprintf((char *)info->name, sizeof(info->name), "/dev/bus/usb/synthetic/%03d", device_id);
+	snprintf((char *)info->manufacturer_name, sizeof(info->manufacturer_name), "serenegiant");
+	snprintf((char *)info->product_name, sizeof(info->product_name), "%s", device->name().c_str());
+	snprintf((char *)info->serial, sizeof(info->serial), "SYN%08d", device_id);
+
+	RETURN(0, int);
+}
+
+//--------------------------------------------------------------------------------
+// native Cバインディング/UVC
+//--------------------------------------------------------------------------------
+device_state_t uvc_get_device_state(usb_manager_t *manager, int32_t device_id)
+{
+	const auto device = find_device(manager, device_id);
+	if (!device) return DISCONNECTED;
+	return device->is_running() ? STREAMING : CONNECTED;
+}
+
+int uvc_set_config(
+	usb_manager_t *manager, int32_t device_id,
+	int32_t /*enabled*/, uint8_t /*use_first_config*/)
+{
+	return find_device(manager, device_id) ? 0 : -ENODEV;
+}
+
+int uvc_resize(
+	usb_manager_t *manager, int32_t device_id,
+	uint32_t frame_type,
+	uint32_t width, uint32_t height)
+{
+	const auto device = find_device(manager, device_id);
+	return device ? device->resize(frame_type, width, height) : -ENODEV;
+}
+
+int uvc_start(usb_manager_t *manager, int32_t device_id)
+{
+	const auto device = find_device(manager, device_id);
+	return device ? device->start() : -ENODEV;
+}
+
+int uvc_stop(usb_manager_t *manager, int32_t device_id)
+{
+	const auto device = find_device(manager, device_id);
+	return device ? device->stop() : -ENODEV;
+}
+
+uint64_t uvc_get_ctrl_supports(usb_manager_t *manager, int32_t device_id)
+{
+	if (!find_device(manager, device_id)) return 0;
+	uint64_t result = 0;
+	for (const auto &ctrl : CONTROLS) {
+		if (!(ctrl.type & PU_MASK)) {
+			result |= ctrl.type & 0x00ffffff;
+		}
+	}
+	return result;
+}
+
+uint64_t uvc_get_proc_supports(usb_manager_t *manager, int32_t device_id)
+{
+	if (!find_device(manager, device_id)) return 0;
+	uint64_t result = 0;
+	for (const auto &ctrl : CONTROLS) {
+		if (ctrl.type & PU_MASK) {
+			result |= ctrl.type & ~(uint64_t)PU_MASK;
+		}
+	}
+	return result;
+}
+
+int uvc_get_control_info(
+	usb_manager_t *manager, int32_t device_id,
+	uvc_control_info_t *info)
+{
+	const auto device = find_device(manager, device_id);
+	return device ? device->get_control_info(info) : -ENODEV;
+}
+
+int uvc_set_control_value(
+	usb_manager_t *manager, int32_t device_id,
+	uint64_t type, int32_t value)
+{
+	const auto device = find_device(manager, device_id);
+	return device ? device->set_control_value(type, value) : -ENODEV;
+}
+
+int uvc_get_control_value(
+	usb_manager_t *manager, int32_t device_id,
+	uint64_t type, int32_t *value)
+{
+	const auto device = find_device(manager, device_id);
+	return device ? device->get_control_value(type, value) : -ENODEV;
+}
+
+int uvc_get_supported_size(
+	usb_manager_t *manager, int32_t device_id,
+	int32_t index, int32_t *num_supported, uvc_video_size_t *size)
+{
+	const auto device = find_device(manager, device_id);
+	return device ? device->get_supported_size(index, num_supported, size) : -ENODEV;
+}
+
+int uvc_get_current_size(
+	usb_manager_t *manager, int32_t device_id,
+	uvc_video_size_t *size)
+{
+	const auto device = find_device(manager, device_id);
+	return device ? device->get_current_size(size) : -ENODEV;
+}
+
+int uvc_get_frame(
+	usb_manager_t *manager, int32_t device_id,
+	uint32_t *frame_type, uint32_t *width, uint32_t *height,
+	uint8_t *data, uint32_t *data_len,
+	int64_t *pts_us, uint32_t *flags)
+{
+	const auto device = find_device(manager, device_id);
+	return device ? device->get_frame(frame_type, width, height, data, data_len, pts_us, flags) : -ENODEV;
+}
+
+int uvc_set_surface(
+	usb_manager_t *manager, int32_t device_id,
+	ANativeWindow *surface, float * /*mvp_matrix*/)
+{
+	// ホスト上ではモデルビュー変換行列は無視する
+	const auto device = find_device(manager, device_id);
+	return device ? device->set_surface(surface) : -ENODEV;
+}
+
+int uvc_set_mvp_matrix(
+	usb_manager_t *manager, int32_t device_id,
+	float * /*mvp_matrix*/)
+{
+	return find_device(manager, device_id) ? 0 : -ENODEV;
+}
+
+//--------------------------------------------------------------------------------
+// native Cバインディング/UAC
+//--------------------------------------------------------------------------------
+device_state_t uac_get_device_state(usb_manager_t *manager, int32_t device_id)
+{
+	const auto device = find_device(manager, device_id);
+	if (!device || !device->config().audio) return DISCONNECTED;
+	return device->is_audio_running() ? STREAMING : CONNECTED;
+}
+
+int uac_start(usb_manager_t *manager, int32_t device_id)
+{
+	const auto device = find_device(manager, device_id);
+	return device ? device->audio_start() : -ENODEV;
+}
+
+int uac_stop(usb_manager_t *manager, int32_t device_id)
+{
+	const auto device = find_device(manager, device_id);
+	return device ? device->audio_stop() : -ENODEV;
+}
+
+int uac_get_info(
+	usb_manager_t *manager, int32_t device_id,
+	uac_info_t *info)
+{
+	const auto device = find_device(manager, device_id);
+	if (!device || !device->config().audio) return -ENODEV;
+	if (!info) return -EINVAL;
+	info->device_id = device_id;
+	info->channels = AUDIO_CHANNELS;
+	info->resolution = AUDIO_RESOLUTION;
+	info->sampling_freq = AUDIO_SAMPLING_FREQ;
+	info->packet_bytes = AUDIO_PACKET_BYTES;
+	return 0;
+}
+
+int uac_get_frame(
+	usb_manager_t *manager, int32_t device_id,
+	uint8_t *data, uint32_t *data_len, int64_t *pts_us)
+{
+	const auto device = find_device(manager, device_id);
+	return device ? device->audio_get_frame(data, data_len, pts_us) : -ENODEV;
+}
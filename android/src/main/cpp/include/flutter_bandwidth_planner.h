@@ -0,0 +1,207 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef AANDUSB_FLUTTER_BANDWIDTH_PLANNER_H
+#define AANDUSB_FLUTTER_BANDWIDTH_PLANNER_H
+
+// 標準ライブラリ
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+// aandusb-native
+#include "aandusb_native.h"
+
+namespace serenegiant::flutter
+{
+
+/**
+ * USB2.0(High Speed)で周期転送(アイソクロナス転送)に使える帯域[バイト/秒]
+ * 480Mbpsの80%を周期転送に割り当て可能
+ */
+#define BANDWIDTH_USB2_BUS (48000000ULL)
+/**
+ * USB2.0(High Speed)の1つのアイソクロナスエンドポイントで使える最大帯域[バイト/秒]
+ * 1024バイト×3トランザクション×8000マイクロフレーム/秒
+ */
+#define BANDWIDTH_USB2_ENDPOINT (24576000ULL)
+/**
+ * min_fpsを指定しなかったときの最小フレームレート
+ */
+#define BANDWIDTH_DEFAULT_MIN_FPS (15.0f)
+
+	/**
+	 * UVC機器毎の映像設定の要求
+	 */
+	typedef struct bandwidth_requirement {
+		/**
+		 * UVC機器の識別子
+		 */
+		int32_t device_id;
+		/**
+		 * 最小映像幅[ピクセル数], 0なら制限なし
+		 */
+		uint32_t min_width;
+		/**
+		 * 最小映像高さ[ピクセル数], 0なら制限なし
+		 */
+		uint32_t min_height;
+		/**
+		 * 最小フレームレート, 0以下ならBANDWIDTH_DEFAULT_MIN_FPS
+		 */
+		float min_fps;
+	} bandwidth_requirement_t;
+
+	/**
+	 * 帯域計画の結果(UVC機器毎の映像設定)
+	 */
+	typedef struct bandwidth_assignment {
+		int32_t device_id;
+		uint32_t frame_type;
+		uint32_t width;
+		uint32_t height;
+		/**
+		 * フレームインターバル[100ナノ秒単位]
+		 * set_video_sizeへ渡すフレームレート(録画時はこのフレームレートへ間引く)
+		 */
+		uint32_t frame_interval;
+		/**
+		 * UVC機器がネゴシエーションするフレームインターバル[100ナノ秒単位]
+		 * uvc_resizeはフレームインターバルを指定できずUVC機器のデフォルト(多くは最高フレームレート)になるので
+		 * 対応している最短のフレームインターバルとする
+		 */
+		uint32_t negotiated_interval;
+		/**
+		 * 必要な帯域の見積もり[バイト/秒], negotiated_intervalで見積もる
+		 */
+		uint64_t bandwidth;
+		/**
+		 * 処理負荷の見積もり(小さいほど処理が軽い)
+		 */
+		uint64_t cost;
+	} bandwidth_assignment_t;
+
+	/**
+	 * 複数のUVC機器を同時に使うときにUSBの帯域内に収まる映像設定の組み合わせを求めるためのヘルパークラス
+	 * 各UVC機器の対応解像度一覧と要求(最小解像度/最小フレームレート)から
+	 * 帯域内に収まる組み合わせのうち処理負荷の合計が最も小さいものを選択する
+	 * aandusbのuvc_resizeはフレームインターバルを指定できないので
+	 * 帯域と処理負荷は要求したフレームレートではなくUVC機器がネゴシエーションする
+	 * 最高フレームレートで見積もる
+	 * (MJPEG/H264はデコードが必要なので同じ解像度/フレームレートなら非圧縮フォーマットを優先する)
+	 */
+	class BandwidthPlanner
+	{
+	private:
+		/**
+		 * UVC機器毎の映像設定の候補
+		 */
+		struct device_candidates {
+			bandwidth_requirement_t requirement;
+			std::vector<bandwidth_assignment_t> candidates;
+			/**
+			 * 候補の中で最小の帯域
+			 */
+			uint64_t min_bandwidth;
+		};
+		const uint64_t m_bus_bandwidth;
+		const uint64_t m_endpoint_bandwidth;
+		std::vector<device_candidates> m_devices;
+
+		/**
+		 * 枝刈り付きの深さ優先探索で最適な組み合わせを探す
+		 * @param ix
+		 * @param bandwidth ここまでに選択した映像設定の帯域の合計
+		 * @param cost ここまでに選択した映像設定の処理負荷の合計
+		 * @param remain_min_bandwidth ix以降のUVC機器の最小帯域の合計
+		 * @param current
+		 * @param best_cost
+		 * @param best
+		 */
+		void search(const size_t &ix,
+			const uint64_t &bandwidth, const uint64_t &cost,
+			const uint64_t &remain_min_bandwidth,
+			std::vector<bandwidth_assignment_t> &current,
+			uint64_t &best_cost, std::vector<bandwidth_assignment_t> &best) const;
+	public:
+		/**
+		 * コンストラクタ
+		 * @param bus_bandwidth 全UVC機器で共有するUSBバスの帯域[バイト/秒]
+		 * @param endpoint_bandwidth UVC機器1台あたりの最大帯域[バイト/秒]
+		 */
+		explicit BandwidthPlanner(
+			const uint64_t &bus_bandwidth = BANDWIDTH_USB2_BUS,
+			const uint64_t &endpoint_bandwidth = BANDWIDTH_USB2_ENDPOINT);
+		/**
+		 * デストラクタ
+		 */
+		~BandwidthPlanner() = default;
+
+		/**
+		 * 指定した映像設定に必要な帯域[バイト/秒]を見積もる
+		 * 非圧縮フォーマットは1フレームのバイト数×フレームレート、
+		 * MJPEG/H264等の圧縮フォーマットは典型的な圧縮率で見積もる
+		 * @param frame_type
+		 * @param width
+		 * @param height
+		 * @param frame_interval フレームインターバル[100ナノ秒単位]
+		 * @return 帯域[バイト/秒], frame_intervalが0なら0
+		 */
+		static uint64_t estimate_bandwidth(
+			const uint32_t &frame_type,
+			const uint32_t &width, const uint32_t &height,
+			const uint32_t &frame_interval);
+		/**
+		 * 指定した映像設定をプレビュー/録画するときの処理負荷を見積もる
+		 * 1秒あたりのピクセル数×フォーマット毎の重み
+		 * @param frame_type
+		 * @param width
+		 * @param height
+		 * @param frame_interval フレームインターバル[100ナノ秒単位]
+		 * @return 処理負荷, frame_intervalが0なら0
+		 */
+		static uint64_t estimate_cost(
+			const uint32_t &frame_type,
+			const uint32_t &width, const uint32_t &height,
+			const uint32_t &frame_interval);
+
+		/**
+		 * UVC機器を追加する
+		 * @param requirement 要求
+		 * @param supported 対応解像度一覧
+		 * @return 0: 成功, 負: エラーコード(要求を満たす映像設定が無い)
+		 */
+		int add_device(
+			const bandwidth_requirement_t &requirement,
+			const std::vector<uvc_video_size_t> &supported);
+
+		/**
+		 * 追加したUVC機器の数を取得
+		 * @return
+		 */
+		inline size_t num_devices() const { return m_devices.size(); };
+
+		/**
+		 * 帯域内に収まる映像設定の組み合わせを求める
+		 * @param result 結果を受け取るvector, add_deviceで追加した順
+		 * @return 0: 成功, 負: エラーコード(帯域内に収まる組み合わせが無い)
+		 */
+		int plan(std::vector<bandwidth_assignment_t> &result) const;
+	};
+
+}	// namespace serenegiant::flutter
+
+#endif //AANDUSB_FLUTTER_BANDWIDTH_PLANNER_H
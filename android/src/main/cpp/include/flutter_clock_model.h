@@ -0,0 +1,213 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef AANDUSB_FLUTTER_CLOCK_MODEL_H
+#define AANDUSB_FLUTTER_CLOCK_MODEL_H
+
+// 標準ライブラリ
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace serenegiant::flutter
+{
+
+	/**
+	 * クロックモデルの推定に使う直近のフレーム数の既定値
+	 */
+	#define CLOCK_MODEL_WINDOW (120)
+	/**
+	 * クロックモデルの推定に使う最小のフレーム数
+	 */
+	#define CLOCK_MODEL_MIN_SAMPLES (8)
+	/**
+	 * 機器側クロックのずれの推定に使う代表点の数と代表点1つあたりのフレーム数
+	 * CLOCK_MODEL_BUCKET_FRAMES毎に最も遅れが小さいフレームを代表点にして
+	 * 直近のCLOCK_MODEL_BUCKETS個(30fpsなら約1分)から傾きを求める
+	 */
+	#define CLOCK_MODEL_BUCKETS (64)
+	#define CLOCK_MODEL_BUCKET_FRAMES (30)
+	/**
+	 * 機器側クロックのずれを推定し始めるまでの代表点の数
+	 */
+	#define CLOCK_MODEL_MIN_BUCKETS (4)
+	/**
+	 * 機器側クロックのずれとして受け付ける最大値[ppm], これを超える推定値は丸める
+	 */
+	#define CLOCK_MODEL_MAX_DRIFT_PPM (1000)
+	/**
+	 * タイムスタンプをクロックモデルへ追従させる時定数[フレーム]
+	 * 毎フレームクロックモデルとの差の1/CLOCK_MODEL_TRACKING分だけ補正する
+	 */
+	#define CLOCK_MODEL_TRACKING (16)
+	/**
+	 * PTSと到着時刻の間隔の差がこれを超えるとPTSが不連続になったとしてやり直す[ナノ秒]
+	 */
+	#define CLOCK_MODEL_DISCONTINUITY_NS (500000000LL)
+	/**
+	 * 到着時刻の揺らぎを吸収するために録画用Surfaceへの書き込みを遅らせる最大時間[ナノ秒]
+	 */
+	#define CLOCK_MODEL_MAX_PACING_NS (50000000LL)
+
+	/**
+	 * クロックモデルの推定結果と到着時刻の揺らぎの統計情報
+	 */
+	typedef struct clock_stats {
+		/**
+		 * クロックモデルへ入力したフレーム数
+		 */
+		uint64_t frames;
+		/**
+		 * PTSが無い(0)ので到着時刻をそのまま使ったフレーム数
+		 */
+		uint64_t no_pts;
+		/**
+		 * PTSの巻き戻り/不連続でクロックモデルをやり直した回数
+		 */
+		uint64_t resets;
+		/**
+		 * 推定に使っているフレーム数
+		 */
+		uint32_t samples;
+		/**
+		 * 推定したCLOCK_MONOTONICに対する機器側クロックのずれ[ppm]
+		 * 正なら機器側クロックが進んでいる(CLOCK_MONOTONICの1秒の間にPTSが1秒より多く進む)
+		 */
+		double drift_ppm;
+		/**
+		 * 到着時刻のクロックモデルからの遅れの標準偏差[ナノ秒](測定した揺らぎ)
+		 */
+		int64_t jitter_ns;
+		/**
+		 * 到着時刻のクロックモデルからの遅れの最大値[ナノ秒]
+		 */
+		int64_t max_jitter_ns;
+		/**
+		 * 揺らぎを吸収するために録画用Surfaceへの書き込みを遅らせる時間[ナノ秒]
+		 * (到着時刻のクロックモデルからの遅れの95パーセンタイル)
+		 */
+		int64_t pacing_ns;
+	} clock_stats_t;
+
+	/**
+	 * UVC機器のPTS(機器側クロック)をCLOCK_MONOTONICへ対応付けるクロックモデル
+	 * USBのスケジューリングによる到着時刻の揺らぎを取り除いた等間隔のタイムスタンプを生成する
+	 *
+	 * ・USB転送の遅れは常に正なので一定フレーム毎に最も遅れが小さいフレームを代表点にして
+	 *   直近の代表点から外れ値に強いTheil-Sen推定で傾き(クロックのずれ)を求め
+	 *   直近のフレームの到着時刻の下側包絡線(最も遅れが小さいフレーム)を切片にする
+	 * ・出力するタイムスタンプは前のフレームからPTSの間隔(クロックのずれを補正)だけ進めて
+	 *   クロックモデルとの差を少しずつ補正するので推定値の細かな変動はタイムスタンプの間隔に出ない
+	 * ・PTSが巻き戻った/到着時刻と大きく食い違った時は機器側の再起動等とみなしてやり直す
+	 * ・生成するタイムスタンプは単調増加する
+	 * ・updateは映像取得スレッドから, get_stats等は任意のスレッドから呼び出してよい
+	 */
+	class PtsClockModel
+	{
+	private:
+		mutable std::mutex m_lock;
+		const uint32_t m_window;
+		/**
+		 * 直近のフレームのPTSと到着時刻(m_origin_pts_ns/m_origin_arrival_nsからの相対値)
+		 * m_window個のリングバッファ
+		 */
+		std::vector<int64_t> m_pts_ns;
+		std::vector<int64_t> m_arrival_ns;
+		uint32_t m_head;
+		uint32_t m_count;
+		/**
+		 * 傾きの推定に使う代表点(最も遅れが小さいフレーム)のリングバッファ
+		 */
+		std::vector<int64_t> m_bucket_pts_ns;
+		std::vector<int64_t> m_bucket_arrival_ns;
+		uint32_t m_bucket_head;
+		uint32_t m_bucket_count;
+		/**
+		 * 作成中の代表点のフレーム数と最も遅れが小さいフレーム
+		 */
+		uint32_t m_bucket_frames;
+		int64_t m_bucket_min_pts_ns;
+		int64_t m_bucket_min_arrival_ns;
+		int64_t m_origin_pts_ns;
+		int64_t m_origin_arrival_ns;
+		int64_t m_last_pts_ns;
+		int64_t m_last_arrival_ns;
+		int64_t m_last_output_ns;
+		double m_slope;
+		int64_t m_offset_ns;
+		uint64_t m_frames;
+		uint64_t m_no_pts;
+		uint64_t m_resets;
+		int64_t m_jitter_ns;
+		int64_t m_max_jitter_ns;
+		int64_t m_pacing_ns;
+		/**
+		 * 推定用の作業領域
+		 */
+		std::vector<double> m_work;
+
+		void restart_locked(const int64_t &pts_ns, const int64_t &arrival_ns);
+		void add_bucket_locked(const int64_t &pts_ns, const int64_t &arrival_ns);
+		void estimate_slope_locked();
+		void estimate_locked();
+	public:
+		/**
+		 * コンストラクタ
+		 * @param window クロックモデルの推定に使う直近のフレーム数
+		 */
+		explicit PtsClockModel(const uint32_t &window = CLOCK_MODEL_WINDOW);
+		~PtsClockModel() = default;
+
+		PtsClockModel(const PtsClockModel &) = delete;
+		PtsClockModel &operator=(const PtsClockModel &) = delete;
+
+		/**
+		 * CLOCK_MONOTONICの現在時刻を取得
+		 * @return 現在時刻[ナノ秒]
+		 */
+		static int64_t monotonic_ns();
+
+		/**
+		 * 推定結果と統計情報を破棄してやり直す
+		 * 映像取得を開始する時に呼ぶ
+		 */
+		void reset();
+		/**
+		 * フレームのPTSと到着時刻でクロックモデルを更新して揺らぎを取り除いたタイムスタンプを返す
+		 * @param pts_us uvc_get_frameで受け取ったPTS[マイクロ秒], 0ならPTS無し
+		 * @param arrival_ns フレームを受け取ったCLOCK_MONOTONICの時刻[ナノ秒]
+		 * @return CLOCK_MONOTONICでのタイムスタンプ[ナノ秒]
+		 */
+		int64_t update(const int64_t &pts_us, const int64_t &arrival_ns);
+		/**
+		 * updateが返したタイムスタンプのフレームを揺らぎを吸収して等間隔で出力できる時刻を取得
+		 * 録画用Surfaceへこの時刻まで待ってから書き込むと投稿時刻でタイムスタンプを付ける
+		 * エンコーダーでも等間隔になる
+		 * @param timestamp_ns updateが返したタイムスタンプ[ナノ秒]
+		 * @return CLOCK_MONOTONICでの出力時刻[ナノ秒]
+		 */
+		int64_t pacing_target_ns(const int64_t &timestamp_ns) const;
+		/**
+		 * 統計情報を取得
+		 * @param stats
+		 */
+		void get_stats(clock_stats_t &stats) const;
+	};
+
+}	// namespace serenegiant::flutter
+
+#endif //AANDUSB_FLUTTER_CLOCK_MODEL_H
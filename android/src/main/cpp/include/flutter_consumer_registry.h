@@ -0,0 +1,226 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef AANDUSB_FLUTTER_CONSUMER_REGISTRY_H
+#define AANDUSB_FLUTTER_CONSUMER_REGISTRY_H
+
+// 標準ライブラリ
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace serenegiant::flutter
+{
+
+	/**
+	 * 消費者がいなくなってから映像取得を一時停止するまでの既定の猶予時間[ミリ秒]
+	 */
+	#define DEFAULT_IDLE_TIMEOUT_MS (3000)
+	/**
+	 * 消費者がいるのに映像取得を再開できなかった時に再試行する間隔[ミリ秒]
+	 */
+	#define RESUME_RETRY_MS (100)
+
+	/**
+	 * 映像の消費者の種類
+	 */
+	typedef enum consumer_type {
+		CONSUMER_PREVIEW = 0,	// プレビュー
+		CONSUMER_RECORDING,		// 録画
+		CONSUMER_ANALYSIS,		// 映像解析(フレームコールバック等)
+		CONSUMER_NUM,
+	} consumer_type_t;
+
+	/**
+	 * 消費者の登録状況と一時停止/再開の統計情報
+	 */
+	typedef struct consumer_metrics {
+		/**
+		 * 種類毎の消費者の数
+		 */
+		int32_t consumers[CONSUMER_NUM];
+		/**
+		 * startを呼んでからstopを呼ぶまではtrue(一時停止中も含む)
+		 */
+		bool started;
+		/**
+		 * 映像取得を一時停止しているかどうか
+		 * 消費者がいないか, 映像取得を再開できずに再試行を待っている
+		 */
+		bool suspended;
+		/**
+		 * 一時停止した回数
+		 */
+		uint64_t suspend_count;
+		/**
+		 * 消費者が登録されて再開した回数
+		 */
+		uint64_t resume_count;
+		/**
+		 * 最後に再開した時に映像取得の開始に掛かった時間[ナノ秒]
+		 */
+		int64_t last_resume_ns;
+		/**
+		 * 一時停止していた時間の合計[ナノ秒], 一時停止中の分は含まない
+		 */
+		int64_t total_suspended_ns;
+	} consumer_metrics_t;
+
+	/**
+	 * 映像取得の開始/終了処理
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	typedef std::function<int()> StreamControl;
+
+	/**
+	 * UVC機器毎の映像の消費者(プレビュー/録画/映像解析)を参照カウントで管理して
+	 * 消費者がいなくなってから猶予時間が経過すると映像取得を一時停止し
+	 * 消費者が登録されるとすぐに再開するためのヘルパークラス
+	 * 常時稼働させる設置型の機器で画面外のプレビュー等のためにUSBの帯域とCPUを使い続けないようにする
+	 *
+	 * ・映像取得の開始/終了処理はm_lockを保持したまま呼び出すので
+	 *   開始/終了処理の中からこのクラスの関数を呼んではいけない
+	 * ・猶予時間の経過は専用スレッドで待機する(最初に必要になった時に生成する)
+	 * ・消費者がいるのに映像取得を再開できなかった時は専用スレッドがRESUME_RETRY_MS毎に再試行する
+	 */
+	class ConsumerRegistry
+	{
+	private:
+		const StreamControl m_start_stream;
+		const StreamControl m_stop_stream;
+		mutable std::mutex m_lock;
+		std::condition_variable m_cond;
+		std::thread m_idle_thread;
+		int32_t m_consumers[CONSUMER_NUM];
+		int64_t m_idle_timeout_ms;
+		/**
+		 * 一時停止する時刻[ナノ秒], 0なら一時停止しない
+		 */
+		int64_t m_deadline_ns;
+		/**
+		 * 映像取得の再開を再試行する時刻[ナノ秒], 0なら再試行しない
+		 */
+		int64_t m_retry_ns;
+		int64_t m_suspended_at_ns;
+		bool m_started;
+		bool m_suspended;
+		bool m_running;
+		uint64_t m_suspend_count;
+		uint64_t m_resume_count;
+		int64_t m_last_resume_ns;
+		int64_t m_total_suspended_ns;
+
+		int32_t total_locked() const;
+		void arm_locked();
+		void retry_locked();
+		int resume_locked();
+		void idle_loop();
+	public:
+		/**
+		 * コンストラクタ
+		 * @param start_stream 映像取得の開始処理(uvc_start等)
+		 * @param stop_stream 映像取得の終了処理(uvc_stop等)
+		 * @param idle_timeout_ms 消費者がいなくなってから一時停止するまでの猶予時間[ミリ秒], 負なら一時停止しない
+		 */
+		ConsumerRegistry(
+			StreamControl start_stream, StreamControl stop_stream,
+			const int64_t &idle_timeout_ms = DEFAULT_IDLE_TIMEOUT_MS);
+		/**
+		 * デストラクタ
+		 * 映像取得の終了処理は呼ばないので必要なら先にstopを呼ぶこと
+		 */
+		~ConsumerRegistry();
+
+		ConsumerRegistry(const ConsumerRegistry &) = delete;
+		ConsumerRegistry &operator=(const ConsumerRegistry &) = delete;
+
+		/**
+		 * 映像取得を開始する
+		 * 消費者がいなければ猶予時間の経過後に一時停止する
+		 * @return 映像取得の開始処理の戻り値
+		 */
+		int start();
+		/**
+		 * 映像取得を終了する
+		 * 一時停止中なら映像取得の終了処理は呼ばない
+		 * @return 映像取得の終了処理の戻り値
+		 */
+		int stop();
+		/**
+		 * 映像取得中なら一旦終了してから指定した処理を実行して映像取得を再開する
+		 * 映像サイズの変更(uvc_resize)等の映像取得中にはできない処理に使う
+		 * 映像取得中でなければ指定した処理を実行するだけ
+		 * 再開に失敗した時は一時停止中として扱い, 消費者がいればRESUME_RETRY_MS毎に再試行する
+		 * (消費者がいなければ消費者の登録/startで再開する)
+		 * @param reconfigure 映像取得を終了している間に実行する処理
+		 * @return 0: 成功, 負: reconfigureまたは映像取得の開始処理のエラーコード
+		 */
+		int restart(const StreamControl &reconfigure);
+		/**
+		 * 消費者を登録する
+		 * 一時停止中なら呼び出し元スレッドで映像取得を再開する
+		 * 再開に失敗した時はエラーを返すが消費者は登録したままでRESUME_RETRY_MS毎に再試行する
+		 * @param type
+		 * @return 0以上: 登録後のその種類の消費者の数, 負: エラーコード
+		 */
+		int acquire(const consumer_type_t &type);
+		/**
+		 * 消費者の登録を解除する
+		 * 消費者がいなくなれば猶予時間の経過後に一時停止する
+		 * @param type
+		 * @return 0以上: 解除後のその種類の消費者の数, 負: エラーコード
+		 */
+		int release(const consumer_type_t &type);
+		/**
+		 * 指定した種類の消費者がいるかどうか
+		 * @param type
+		 * @return
+		 */
+		bool has_consumer(const consumer_type_t &type) const;
+		/**
+		 * startを呼んでからstopを呼ぶまではtrue(一時停止中も含む)
+		 * @return
+		 */
+		bool is_started() const;
+		/**
+		 * 一時停止中かどうか
+		 * @return
+		 */
+		bool is_suspended() const;
+		/**
+		 * 一時停止中なら再開するか指定時間経過するまで待機する
+		 * @param timeout_ms
+		 * @return 一時停止中でなければtrue
+		 */
+		bool wait_resumed(const int64_t &timeout_ms);
+		/**
+		 * 猶予時間を変更する
+		 * @param idle_timeout_ms 負なら一時停止しない, 一時停止中ならそのまま
+		 */
+		void set_idle_timeout(const int64_t &idle_timeout_ms);
+		/**
+		 * 統計情報を取得
+		 * @param metrics
+		 */
+		void get_metrics(consumer_metrics_t &metrics) const;
+	};
+
+}	// namespace serenegiant::flutter
+
+#endif //AANDUSB_FLUTTER_CONSUMER_REGISTRY_H
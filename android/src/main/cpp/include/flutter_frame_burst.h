@@ -0,0 +1,163 @@
+/**
+ * Flutter Frame Burst
+ *
+ * Ring of frame slots for capturing a burst of consecutive frames at the
+ * sensor rate. All slots are reserved before the burst starts, the capture
+ * thread only copies (or fetches) each frame into the next slot, so nothing
+ * is allocated while frames arrive. When the burst is complete the frames
+ * are handed back as one batch, either as the raw frames or encoded to JPEG
+ * in parallel on the shared task pool.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#ifndef FLUTTER_FRAME_BURST_H
+#define FLUTTER_FRAME_BURST_H
+
+// Standard C/C++ headers
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Project headers
+#include "flutter_task_pool.h"
+
+namespace serenegiant::flutter {
+
+/**
+ * Maximum number of frames in one burst
+ */
+#define BURST_MAX_FRAMES (60)
+/**
+ * Maximum memory reserved for the slots of one burst, 60 full HD YUYV frames
+ */
+#define BURST_MAX_BYTES ((size_t)256 << 20)
+
+/**
+ * One frame of a burst, points into the slot it was stored in
+ */
+struct BurstFrame {
+  const uint8_t *data;
+  size_t len;
+  // RAW_FRAME_XXX, RAW_FRAME_MJPEG once encoded
+  uint32_t frame_type;
+  uint32_t width;
+  uint32_t height;
+  // Presentation timestamp from uvc_get_frame in microseconds
+  int64_t pts_us;
+};
+
+/**
+ * Pre-allocated ring of frame slots
+ * One producer (the capture thread) fills the slots, the consumer waits
+ * until the burst is full and then reads or encodes the frames. A producer
+ * may hand over to another thread as long as they do not fill at the same
+ * time.
+ */
+class FrameBurst {
+public:
+  FrameBurst() = default;
+
+  // Disable copy
+  FrameBurst(const FrameBurst &) = delete;
+  FrameBurst &operator=(const FrameBurst &) = delete;
+
+  /**
+   * Allocate the slots, drops any stored frames
+   * @param count Number of frames of the burst
+   * @param slot_bytes Size of each slot, larger frames are dropped
+   * @return 0 on success, -EINVAL when count is 0 or above BURST_MAX_FRAMES
+   *         or slot_bytes is 0, -ENOMEM when the slots would take more than
+   *         BURST_MAX_BYTES
+   */
+  int reserve(uint32_t count, size_t slot_bytes);
+
+  uint32_t capacity() const { return (uint32_t)m_frames.size(); }
+  size_t slotBytes() const { return m_slot_bytes; }
+  /**
+   * Number of frames stored so far
+   */
+  uint32_t size() const { return m_size.load(std::memory_order_acquire); }
+  bool full() const { return size() >= capacity(); }
+  /**
+   * Frames that did not fit into a slot
+   */
+  uint64_t dropped() const { return m_dropped; }
+
+  //----------------------------------------------------------------------------
+  // Producer side
+
+  /**
+   * Slot the next frame goes to, slotBytes() long
+   * Lets the producer fetch a frame straight into the slot, commit() stores
+   * it.
+   * @return nullptr when the burst is full
+   */
+  uint8_t *nextSlot();
+
+  /**
+   * Store the frame written to nextSlot()
+   */
+  void commit(size_t len, uint32_t frame_type, uint32_t width,
+              uint32_t height, int64_t pts_us);
+
+  /**
+   * Copy a frame into the next slot
+   * @return 0 on success, -ENOSPC when the frame is larger than a slot (it
+   *         is dropped), -ENOBUFS when the burst is full
+   */
+  int push(const uint8_t *data, size_t len, uint32_t frame_type,
+           uint32_t width, uint32_t height, int64_t pts_us);
+
+  /**
+   * Count a frame the producer could not store
+   */
+  void drop() { m_dropped++; }
+
+  //----------------------------------------------------------------------------
+  // Consumer side
+
+  /**
+   * Wait until the burst is full
+   * @return whether the burst is full
+   */
+  bool wait(int64_t timeout_ms) const;
+
+  /**
+   * Stored frame, only valid once the producer is done
+   */
+  const BurstFrame &at(uint32_t index) const { return m_frames[index]; }
+
+  /**
+   * Encode the stored frames to JPEG, one pool task per frame at analysis
+   * priority. MJPEG frames are not encoded again (see makeStillJpeg). The
+   * frames then point to the JPEG data and the raw slots are released.
+   * Only call once the producer is done.
+   * @return 0 on success, the error of the first frame that failed
+   */
+  int encode(TaskPool &pool, int32_t device_id);
+
+  /**
+   * Whether encode() has succeeded
+   */
+  bool encoded() const { return !m_jpegs.empty(); }
+
+private:
+  std::vector<uint8_t> m_storage;
+  size_t m_slot_bytes = 0;
+  std::vector<BurstFrame> m_frames;
+  std::atomic<uint32_t> m_size{0};
+  std::atomic<uint64_t> m_dropped{0};
+  std::vector<std::vector<uint8_t>> m_jpegs;
+
+  mutable std::mutex m_lock;
+  mutable std::condition_variable m_full;
+};
+
+} // namespace serenegiant::flutter
+
+#endif // FLUTTER_FRAME_BURST_H
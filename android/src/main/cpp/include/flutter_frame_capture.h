@@ -0,0 +1,272 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef AANDUSB_FLUTTER_FRAME_CAPTURE_H
+#define AANDUSB_FLUTTER_FRAME_CAPTURE_H
+
+/**
+ * uvc_get_frameで受け取った映像フレームをそのままファイルへ記録/再生するためのクラス
+ *
+ * ファイルフォーマット(リトルエンディアン, 各ブロックは8バイト境界に揃える)
+ *   frame_capture_header_t
+ *   frame_capture_record_t + 映像データ(data_len バイト + 8バイト境界までのパディング) × num_frames
+ *   frame_capture_index_t × num_frames (index_offsetから)
+ * index_offsetはクローズ時に書き込むので0ならクローズされていない(記録中に異常終了した)ファイル
+ * その場合は読み込み時にレコードを先頭から走査してインデックスを再構築する
+ */
+
+// 標準ライブラリ
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace serenegiant::flutter
+{
+
+#define FRAME_CAPTURE_MAGIC "UVCCAP01"
+#define FRAME_CAPTURE_VERSION (1)
+#define FRAME_CAPTURE_RECORD_MAGIC (0x46435655)	// 'UVCF'
+#define FRAME_CAPTURE_ALIGNMENT (8)
+
+	typedef struct frame_capture_header {
+		char magic[8];				// FRAME_CAPTURE_MAGIC
+		uint32_t version;			// FRAME_CAPTURE_VERSION
+		uint32_t header_size;		// sizeof(frame_capture_header_t)
+		uint64_t index_offset;		// インデックスの開始位置, 0ならクローズされていない
+		uint32_t num_frames;		// インデックスのエントリー数
+		uint32_t reserved1;
+		int64_t created_us;			// 記録開始時のシステム時刻[マイクロ秒, UNIXエポック]
+		uint8_t reserved[24];
+	} __attribute__((__packed__)) frame_capture_header_t;
+
+	typedef struct frame_capture_record {
+		uint32_t magic;				// FRAME_CAPTURE_RECORD_MAGIC
+		uint32_t frame_type;		// uvc_get_frameが返した映像フォーマット
+		uint32_t width;
+		uint32_t height;
+		uint32_t flags;
+		uint32_t data_len;			// 映像データのバイト数(パディングを含まない)
+		int64_t pts_us;				// uvc_get_frameが返したpts_us
+		int64_t arrival_us;			// 記録開始からuvc_get_frameで受け取るまでの経過時間[マイクロ秒]
+	} __attribute__((__packed__)) frame_capture_record_t;
+
+	typedef struct frame_capture_index {
+		uint64_t offset;			// frame_capture_record_tのファイル内位置
+		int64_t pts_us;
+	} __attribute__((__packed__)) frame_capture_index_t;
+
+	/**
+	 * 記録ファイルから読み込んだ映像フレーム
+	 * dataはメモリーマップしたファイル内を指すのでFrameCaptureReaderを閉じるまで有効
+	 */
+	typedef struct capture_frame {
+		uint32_t frame_type;
+		uint32_t width;
+		uint32_t height;
+		uint32_t flags;
+		const uint8_t *data;
+		uint32_t data_len;
+		int64_t pts_us;
+		int64_t arrival_us;
+	} capture_frame_t;
+
+	/**
+	 * uvc_get_frameで受け取った映像フレームをファイルへ記録する
+	 * 複数スレッドから呼び出し可能
+	 */
+	class FrameCaptureWriter
+	{
+	private:
+		mutable std::mutex m_lock;
+		FILE *m_fp;
+		std::string m_path;
+		uint64_t m_offset;
+		std::chrono::steady_clock::time_point m_start;
+		int64_t m_created_us;
+		std::vector<frame_capture_index_t> m_index;
+
+		int close_locked();
+	public:
+		FrameCaptureWriter();
+		~FrameCaptureWriter();
+
+		FrameCaptureWriter(const FrameCaptureWriter &) = delete;
+		FrameCaptureWriter &operator=(const FrameCaptureWriter &) = delete;
+
+		/**
+		 * 記録ファイルを生成する, 既存のファイルは上書きする
+		 * @param path
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int open(const std::string &path);
+
+		/**
+		 * 映像フレームを1つ追記する
+		 * 引数はuvc_get_frameの出力値をそのまま渡す
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int write(
+			const uint32_t &frame_type,
+			const uint32_t &width, const uint32_t &height,
+			const uint8_t *data, const uint32_t &data_len,
+			const int64_t &pts_us, const uint32_t &flags);
+
+		/**
+		 * インデックスを書き込んでファイルを閉じる
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int close();
+
+		[[nodiscard]]
+		bool is_opened() const;
+
+		[[nodiscard]]
+		uint32_t num_frames() const;
+
+		/**
+		 * これまでに書き込んだバイト数
+		 */
+		[[nodiscard]]
+		uint64_t bytes() const;
+	};
+
+	/**
+	 * 記録ファイルをメモリーマップして映像フレームを読み込む
+	 * 読み込みはコピー無し(capture_frame_t.dataはマップしたファイルを指す)
+	 */
+	class FrameCaptureReader
+	{
+	private:
+		const uint8_t *m_map;
+		size_t m_map_size;
+		bool m_complete;
+		std::vector<frame_capture_index_t> m_index;
+
+		int rebuild_index(const size_t &start);
+	public:
+		FrameCaptureReader();
+		~FrameCaptureReader();
+
+		FrameCaptureReader(const FrameCaptureReader &) = delete;
+		FrameCaptureReader &operator=(const FrameCaptureReader &) = delete;
+
+		/**
+		 * 記録ファイルをメモリーマップする
+		 * クローズされていないファイルはレコードを走査してインデックスを再構築する
+		 * @param path
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int open(const std::string &path);
+
+		void close();
+
+		[[nodiscard]]
+		inline bool is_opened() const { return m_map != nullptr; };
+
+		/**
+		 * ファイルにインデックスが記録されていたかどうか
+		 * falseなら記録中に異常終了したファイルでインデックスは再構築したもの
+		 */
+		[[nodiscard]]
+		inline bool is_complete() const { return m_complete; };
+
+		[[nodiscard]]
+		inline size_t num_frames() const { return m_index.size(); };
+
+		/**
+		 * 指定したインデックスの映像フレームを取得する
+		 * @param index
+		 * @param frame
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int get(const size_t &index, capture_frame_t &frame) const;
+
+		/**
+		 * pts_usが指定した値以上の最初の映像フレームのインデックスを取得する
+		 * @param pts_us
+		 * @return 映像フレームのインデックス, 該当するものが無ければnum_frames()
+		 */
+		[[nodiscard]]
+		size_t find(const int64_t &pts_us) const;
+	};
+
+	/**
+	 * 記録ファイルの映像フレームをuvc_get_frameの代わりに供給する
+	 * speedが正なら記録時の間隔(pts_us)をspeed倍速で, 0なら待たずに最大速度で供給する
+	 */
+	class FrameReplaySource
+	{
+	private:
+		mutable std::mutex m_lock;
+		FrameCaptureReader m_reader;
+		float m_speed;
+		bool m_loop;
+		size_t m_next;
+		bool m_started;
+		std::chrono::steady_clock::time_point m_start;
+		int64_t m_start_pts_us;
+	public:
+		FrameReplaySource();
+		~FrameReplaySource() = default;
+
+		/**
+		 * 記録ファイルを開く
+		 * @param path
+		 * @param speed 再生速度, 1.0なら記録時と同じ間隔, 0なら最大速度
+		 * @param loop trueなら最後まで供給すると先頭へ戻る
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int open(const std::string &path, const float &speed = 1.0f, const bool &loop = false);
+
+		void close();
+
+		[[nodiscard]]
+		size_t num_frames() const;
+
+		/**
+		 * 指定したpts_us以降の映像フレームから供給するように移動する
+		 * @param pts_us
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int seek(const int64_t &pts_us);
+
+		/**
+		 * 次の映像フレームを取得する(コピー無し)
+		 * @param frame
+		 * @return 0: 成功, -EAGAIN: まだ供給時刻になっていない, -ENOENT: 最後まで供給した, 負: その他のエラー
+		 */
+		int next(capture_frame_t &frame);
+
+		/**
+		 * 次の映像フレームをuvc_get_frameと同じ引数で取得する
+		 * 映像フォーマットの変換はしないので*frame_typeには記録時の映像フォーマットがセットされる
+		 * バッファが足りないときは*data_lenへ必要なバイト数をセットして-ENOSPCを返す(映像フレームは消費しない)
+		 * @return 0: 成功, 負: エラーコード(nextと同じ)
+		 */
+		int next(
+			uint32_t *frame_type, uint32_t *width, uint32_t *height,
+			uint8_t *data, uint32_t *data_len,
+			int64_t *pts_us, uint32_t *flags);
+	};
+
+}	// namespace serenegiant::flutter
+
+#endif //AANDUSB_FLUTTER_FRAME_CAPTURE_H
@@ -0,0 +1,150 @@
+/**
+ * Flutter Frame Converter
+ *
+ * Converts the uncompressed frame formats uvc_get_frame can deliver
+ * (YUYV, NV12, NV21, RGB565, RGBX) to RGBA for rendering. MJPEG is handled
+ * by MjpegDecoder, H.264 is not decoded here. Large frames can be split
+ * into horizontal stripes converted in parallel on the shared TaskPool.
+ * Rotation and mirroring are fused into the conversion.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#ifndef FLUTTER_FRAME_CONVERTER_H
+#define FLUTTER_FRAME_CONVERTER_H
+
+// Standard C/C++ headers
+#include <cstddef>
+#include <cstdint>
+
+// Project headers
+#include "flutter_frame_crop.h"
+#include "flutter_frame_orientation.h"
+#include "flutter_task_pool.h"
+
+namespace serenegiant::flutter {
+
+/**
+ * Source plus RGBA bytes each parallel stripe aims for, about one L2
+ */
+#define STRIPE_TARGET_BYTES (1024 * 1024)
+/**
+ * Upper bound of stripes per worker thread
+ */
+#define STRIPES_PER_WORKER (4)
+/**
+ * Source rows and columns of a tile when converting with swapped axes
+ * (90/270 degrees). 16 RGBA pixels are one 64 byte cache line of a
+ * destination row, 64 columns keep the written lines (4KB) in L1.
+ */
+#define ORIENT_TILE_ROWS (16)
+#define ORIENT_TILE_COLUMNS (64)
+
+/**
+ * Bytes of one uncompressed frame
+ * @param frame_type uvc_raw_frame_t
+ * @return frame size in bytes, 0 for compressed or unknown formats
+ */
+size_t rawFrameBytes(uint32_t frame_type, uint32_t width, uint32_t height);
+
+/**
+ * Convert an uncompressed frame to RGBA
+ * @param frame_type uvc_raw_frame_t of the source frame
+ * @param src_len Bytes available at src, must be at least rawFrameBytes()
+ * @param dst_stride Bytes per destination row, at least width * 4
+ * @return 0 on success, -EINVAL for unsupported formats or bad arguments,
+ *         -ENOSPC when src is shorter than one frame
+ */
+int convertToRgba(uint32_t frame_type, const uint8_t *src, size_t src_len,
+                  uint32_t width, uint32_t height, uint8_t *dst,
+                  uint32_t dst_stride);
+
+/**
+ * Number of horizontal stripes used by convertToRgbaParallel
+ * Frames smaller than a couple of stripes are not split.
+ * @param workers Threads that can convert at the same time
+ * @return stripe count, 1 means the frame is converted in one pass
+ */
+uint32_t selectStripeCount(uint32_t frame_type, uint32_t width,
+                           uint32_t height, uint32_t workers);
+
+/**
+ * Convert an uncompressed frame to RGBA, splitting large frames into
+ * horizontal stripes converted on the pool. The calling thread converts
+ * the first stripe and runs its own pending stripes while waiting. The
+ * output is identical to convertToRgba.
+ * @param device_id Device the stripes are accounted to in the pool
+ * @param priority Priority of the stripe tasks
+ * @param max_threads Upper bound of threads including the caller,
+ *                    0 means the pool workers plus the caller
+ * @return same as convertToRgba
+ */
+int convertToRgbaParallel(TaskPool &pool, int32_t device_id,
+                          task_priority_t priority, uint32_t frame_type,
+                          const uint8_t *src, size_t src_len, uint32_t width,
+                          uint32_t height, uint8_t *dst, uint32_t dst_stride,
+                          uint32_t max_threads = 0);
+
+/**
+ * Part of the frame convertRegionToRgbaParallel converts for a region
+ * The region is clipped to the frame and widened to whole chroma samples,
+ * even columns for YUYV/NV12/NV21 and even rows for NV12/NV21.
+ * @param region Requested region, empty means the whole frame
+ */
+FrameRect alignConvertRegion(uint32_t frame_type, uint32_t width,
+                             uint32_t height, const FrameRect &region);
+
+/**
+ * Convert the part of an uncompressed frame inside a region to RGBA, so a
+ * cropped consumer only pays for the pixels it shows. Large regions are
+ * split into stripes like convertToRgbaParallel.
+ * @param region Part of the frame to convert, empty means the whole frame.
+ *        Updated to alignConvertRegion() of it on success.
+ * @param dst Receives the region, its first pixel at dst
+ * @param dst_stride Bytes per destination row, at least the aligned region
+ *        width * 4
+ * @return same as convertToRgba
+ */
+int convertRegionToRgbaParallel(TaskPool &pool, int32_t device_id,
+                                task_priority_t priority, uint32_t frame_type,
+                                const uint8_t *src, size_t src_len,
+                                uint32_t width, uint32_t height,
+                                FrameRect &region, uint8_t *dst,
+                                uint32_t dst_stride, uint32_t max_threads = 0);
+
+/**
+ * Convert the part of an uncompressed frame inside a region to RGBA rotated
+ * and/or mirrored in the same pass, so an oriented consumer costs no extra
+ * pass over the frame. Rotated regions are written in cache sized tiles.
+ * @param orientation Orientation of dst
+ * @param dst Receives the oriented region, its first pixel at dst
+ * @param dst_stride Bytes per destination row, at least the width of the
+ *        oriented aligned region * 4
+ * @return same as convertToRgba, -EINVAL for an invalid rotation
+ */
+int convertRegionToRgbaParallel(TaskPool &pool, int32_t device_id,
+                                task_priority_t priority, uint32_t frame_type,
+                                const uint8_t *src, size_t src_len,
+                                uint32_t width, uint32_t height,
+                                FrameRect &region,
+                                const FrameOrientation &orientation,
+                                uint8_t *dst, uint32_t dst_stride,
+                                uint32_t max_threads = 0);
+
+/**
+ * Copy RGBX/RGBA pixels to RGBA rotated and/or mirrored, used where the
+ * pixels are copied anyway (into a window buffer, a subscriber's frame).
+ * The 4th byte is set opaque like convertToRgba does for RGBX.
+ * @param src_stride Bytes per source row, a multiple of 4
+ * @param dst_stride Bytes per destination row, at least the oriented
+ *        width * 4
+ * @return 0 on success, -EINVAL for bad arguments
+ */
+int orientRgbx(const uint8_t *src, uint32_t width, uint32_t height,
+               uint32_t src_stride, const FrameOrientation &orientation,
+               uint8_t *dst, uint32_t dst_stride);
+
+} // namespace serenegiant::flutter
+
+#endif // FLUTTER_FRAME_CONVERTER_H
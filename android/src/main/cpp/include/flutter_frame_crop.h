@@ -0,0 +1,192 @@
+/**
+ * Flutter Frame Crop
+ *
+ * Region of interest handling shared by the decoder, the converter and the
+ * consumers. Each consumer may look at a part of the camera frame only; the
+ * capture loop decodes or converts just the union of those parts, and each
+ * consumer then reads its crop out of that decoded region.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#ifndef FLUTTER_FRAME_CROP_H
+#define FLUTTER_FRAME_CROP_H
+
+// Standard C/C++ headers
+#include <algorithm>
+#include <cstdint>
+
+// Project headers
+#include "flutter_frame_orientation.h"
+
+namespace serenegiant::flutter {
+
+/**
+ * Rectangle in pixels, an empty rectangle means the whole frame
+ */
+struct FrameRect {
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+
+  bool empty() const { return !width || !height; }
+
+  bool operator==(const FrameRect &other) const {
+    return x == other.x && y == other.y && width == other.width &&
+           height == other.height;
+  }
+  bool operator!=(const FrameRect &other) const { return !(*this == other); }
+};
+
+/**
+ * Clip a crop to the frame
+ * @return The part of the crop inside the frame, the whole frame if the
+ *         crop is empty or does not overlap the frame
+ */
+inline FrameRect clipRect(const FrameRect &crop, uint32_t width,
+                          uint32_t height) {
+  if (crop.empty() || crop.x >= width || crop.y >= height) {
+    return {0, 0, width, height};
+  }
+  return {crop.x, crop.y, std::min(crop.width, width - crop.x),
+          std::min(crop.height, height - crop.y)};
+}
+
+/**
+ * Smallest rectangle containing both, empty rectangles are ignored
+ */
+inline FrameRect unionRect(const FrameRect &a, const FrameRect &b) {
+  if (a.empty()) {
+    return b;
+  }
+  if (b.empty()) {
+    return a;
+  }
+  const uint32_t x = std::min(a.x, b.x);
+  const uint32_t y = std::min(a.y, b.y);
+  return {x, y, std::max(a.x + a.width, b.x + b.width) - x,
+          std::max(a.y + a.height, b.y + b.height) - y};
+}
+
+/**
+ * Map a rectangle of a src sized frame onto the same frame scaled to dst,
+ * rounded outwards so that the result covers every source pixel
+ */
+inline FrameRect scaleRect(const FrameRect &rect, uint32_t src_width,
+                           uint32_t src_height, uint32_t dst_width,
+                           uint32_t dst_height) {
+  if (src_width == dst_width && src_height == dst_height) {
+    return rect;
+  }
+  const uint64_t x0 = (uint64_t)rect.x * dst_width / src_width;
+  const uint64_t y0 = (uint64_t)rect.y * dst_height / src_height;
+  const uint64_t x1 =
+      ((uint64_t)(rect.x + rect.width) * dst_width + src_width - 1) /
+      src_width;
+  const uint64_t y1 =
+      ((uint64_t)(rect.y + rect.height) * dst_height + src_height - 1) /
+      src_height;
+  return {(uint32_t)x0, (uint32_t)y0, (uint32_t)(x1 - x0),
+          (uint32_t)(y1 - y0)};
+}
+
+/**
+ * Size the whole frame has to be decoded at so that a crop of it still
+ * covers the consumer's output size
+ * @param crop Crop already clipped to the frame
+ * @param out_width Consumer output width, must not be 0
+ * @param out_height Consumer output height, must not be 0
+ */
+inline void frameSizeForCrop(const FrameRect &crop, uint32_t frame_width,
+                             uint32_t frame_height, uint32_t out_width,
+                             uint32_t out_height, uint32_t &width,
+                             uint32_t &height) {
+  width = (uint32_t)std::min<uint64_t>(
+      frame_width,
+      ((uint64_t)out_width * frame_width + crop.width - 1) / crop.width);
+  height = (uint32_t)std::min<uint64_t>(
+      frame_height,
+      ((uint64_t)out_height * frame_height + crop.height - 1) / crop.height);
+}
+
+/**
+ * Rectangle of a width x height frame after the orientation
+ */
+inline FrameRect orientRect(const FrameOrientation &orientation,
+                            const FrameRect &rect, uint32_t width,
+                            uint32_t height) {
+  if (rect.empty()) {
+    return rect;
+  }
+  int64_t x0, y0, x1, y1;
+  orientPoint(orientation, width, height, rect.x, rect.y, x0, y0);
+  orientPoint(orientation, width, height, rect.x + rect.width - 1,
+              rect.y + rect.height - 1, x1, y1);
+  return {(uint32_t)std::min(x0, x1), (uint32_t)std::min(y0, y1),
+          (uint32_t)(std::max(x0, x1) - std::min(x0, x1) + 1),
+          (uint32_t)(std::max(y0, y1) - std::min(y0, y1) + 1)};
+}
+
+/**
+ * Decoded pixels of a frame, only the region the consumers look at
+ * Sizes and rectangles are upright, the pixels of region may be stored
+ * rotated/mirrored when the conversion applied a consumer's orientation.
+ */
+struct DecodedFrame {
+  // Pixels of region with orientation applied, row stride stride()
+  const uint8_t *data;
+  // Size of the whole frame at the decoded scale
+  uint32_t width;
+  uint32_t height;
+  // Part of the decoded frame held by data
+  FrameRect region;
+  // Size of the camera frame, crops are given in camera pixels
+  uint32_t source_width;
+  uint32_t source_height;
+  // De-jittered CLOCK_MONOTONIC timestamp in microseconds
+  int64_t pts_us;
+  // Orientation data is stored with
+  FrameOrientation orientation = {};
+
+  uint32_t stride() const {
+    return (orientation.swapsAxes() ? region.height : region.width) * 4;
+  }
+};
+
+/**
+ * Locate a consumer's crop in a decoded frame
+ * @param crop Crop in camera pixels, empty means the whole frame
+ * @param data Set to the first stored pixel of the crop, the row stride is
+ *        frame.stride()
+ * @return Crop in upright decoded pixels, inside frame.region. It is stored
+ *         with frame.orientation, so its rows in data are orientedSize() of
+ *         it.
+ */
+inline FrameRect locateCrop(const DecodedFrame &frame, const FrameRect &crop,
+                            const uint8_t *&data) {
+  const FrameRect clipped =
+      clipRect(crop, frame.source_width, frame.source_height);
+  FrameRect rect = scaleRect(clipped, frame.source_width, frame.source_height,
+                             frame.width, frame.height);
+  // The region covers every crop, clamp anyway against rounding
+  const FrameRect &region = frame.region;
+  const uint32_t x0 = std::clamp(rect.x, region.x, region.x + region.width);
+  const uint32_t y0 = std::clamp(rect.y, region.y, region.y + region.height);
+  const uint32_t x1 =
+      std::clamp(rect.x + rect.width, x0, region.x + region.width);
+  const uint32_t y1 =
+      std::clamp(rect.y + rect.height, y0, region.y + region.height);
+  rect = {x0, y0, x1 - x0, y1 - y0};
+  const FrameRect stored =
+      orientRect(frame.orientation,
+                 {x0 - region.x, y0 - region.y, rect.width, rect.height},
+                 region.width, region.height);
+  data = frame.data + (size_t)stored.y * frame.stride() + (size_t)stored.x * 4;
+  return rect;
+}
+
+} // namespace serenegiant::flutter
+
+#endif // FLUTTER_FRAME_CROP_H
@@ -0,0 +1,115 @@
+/**
+ * Flutter Frame Dedup
+ *
+ * Detects frames that repeat the previous one so that the pipeline can skip
+ * converting and rendering them. Capture cards and document cameras send
+ * long runs of identical frames. Compressed frames are hashed completely
+ * (XXH64 over the MJPEG payload, which is small), uncompressed frames are
+ * hashed over every n-th row only to keep the cost far below a conversion.
+ * A change confined to the rows that are not sampled goes unnoticed, so
+ * sources with fine detail should sample every row.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#ifndef FLUTTER_FRAME_DEDUP_H
+#define FLUTTER_FRAME_DEDUP_H
+
+// Standard C/C++ headers
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace serenegiant::flutter {
+
+/**
+ * Rows of an uncompressed frame the hash skips between two sampled rows
+ */
+#define DEDUP_DEFAULT_SAMPLE_ROWS (4)
+#define DEDUP_MAX_SAMPLE_ROWS (64)
+
+/**
+ * Deduplication statistics
+ */
+struct DedupStats {
+  // Frames checked while enabled
+  uint64_t frames;
+  // Frames that repeated the previous frame and were skipped
+  uint64_t duplicates;
+  // Longest run of consecutive duplicates
+  uint64_t longest_run;
+
+  double ratio() const {
+    return frames ? (double)duplicates / (double)frames : 0.0;
+  }
+};
+
+/**
+ * XXH64 of a byte range
+ */
+uint64_t xxhash64(const void *data, size_t len, uint64_t seed = 0);
+
+/**
+ * Hash of a frame, see the file comment for what is covered
+ * @param sample_rows Hash every n-th row of uncompressed frames, 1 hashes
+ *        every byte
+ */
+uint64_t frameHash(uint32_t frame_type, const uint8_t *data, size_t len,
+                   uint32_t width, uint32_t height, uint32_t sample_rows);
+
+/**
+ * Compares every frame with the previous one. Frames come from the capture
+ * thread only, configure/invalidate/getStats may be called from any thread.
+ */
+class FrameDedup {
+public:
+  FrameDedup() = default;
+
+  // Disable copy
+  FrameDedup(const FrameDedup &) = delete;
+  FrameDedup &operator=(const FrameDedup &) = delete;
+
+  /**
+   * Enable or disable deduplication, the statistics are cleared
+   * @param sample_rows 1..DEDUP_MAX_SAMPLE_ROWS
+   * @return 0 on success, -EINVAL for sample_rows out of range
+   */
+  int configure(bool enabled, uint32_t sample_rows = DEDUP_DEFAULT_SAMPLE_ROWS);
+
+  bool enabled() const { return m_enabled.load(); }
+
+  /**
+   * Whether the frame repeats the previous one
+   * Always false while disabled and for the first frame after invalidate(),
+   * e.g. when an output changed and needs the frame again.
+   */
+  bool isDuplicate(uint32_t frame_type, const uint8_t *data, size_t len,
+                   uint32_t width, uint32_t height);
+
+  /**
+   * Forget the previous frame, the next frame is never a duplicate
+   */
+  void invalidate() { m_invalidated = true; }
+
+  void getStats(DedupStats &stats) const;
+
+private:
+  std::atomic<bool> m_enabled{false};
+  std::atomic<uint32_t> m_sample_rows{DEDUP_DEFAULT_SAMPLE_ROWS};
+  std::atomic<bool> m_invalidated{true};
+  // Previous frame, capture thread only
+  uint64_t m_last_hash = 0;
+  size_t m_last_len = 0;
+  uint32_t m_last_type = 0;
+  uint32_t m_last_width = 0;
+  uint32_t m_last_height = 0;
+  uint64_t m_run = 0;
+  mutable std::mutex m_stats_lock;
+  DedupStats m_stats{};
+};
+
+} // namespace serenegiant::flutter
+
+#endif // FLUTTER_FRAME_DEDUP_H
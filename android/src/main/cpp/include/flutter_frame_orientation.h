@@ -0,0 +1,132 @@
+/**
+ * Flutter Frame Orientation
+ *
+ * Rotation and mirroring of a consumer's output. The frames fetched with
+ * uvc_get_frame are upright camera frames; a consumer may want them turned
+ * by a multiple of 90 degrees and/or mirrored (camera mounted sideways,
+ * front facing preview). The converter applies the orientation while it
+ * writes the RGBA pixels, so it costs no pass of its own.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#ifndef FLUTTER_FRAME_ORIENTATION_H
+#define FLUTTER_FRAME_ORIENTATION_H
+
+// Standard C/C++ headers
+#include <cstdint>
+
+namespace serenegiant::flutter {
+
+/**
+ * Orientation of a consumer's output
+ * The mirrors are applied to the camera frame first, then it is rotated
+ * clockwise. Different settings can give the same result (mirror_h plus
+ * 180 degrees is mirror_v), comparisons take that into account.
+ */
+struct FrameOrientation {
+  // Clockwise rotation in degrees, 0, 90, 180 or 270
+  uint32_t rotation = 0;
+  // Flip left and right
+  bool mirror_h = false;
+  // Flip top and bottom
+  bool mirror_v = false;
+
+  bool valid() const { return rotation < 360 && rotation % 90 == 0; }
+
+  /**
+   * Whether the output is the camera frame turned by 90 or 270 degrees, the
+   * output width is then the camera frame height
+   */
+  bool swapsAxes() const { return quarterTurns() & 1; }
+
+  bool isIdentity() const { return !flipped() && !quarterTurns(); }
+
+  /**
+   * Canonical form: a horizontal flip (flipped()) followed by quarterTurns()
+   * clockwise quarter turns. A vertical flip is a horizontal flip turned by
+   * 180 degrees.
+   */
+  bool flipped() const { return mirror_h != mirror_v; }
+  uint32_t quarterTurns() const {
+    return (rotation / 90 + (mirror_v ? 2 : 0)) & 3;
+  }
+
+  bool operator==(const FrameOrientation &other) const {
+    return flipped() == other.flipped() &&
+           quarterTurns() == other.quarterTurns();
+  }
+  bool operator!=(const FrameOrientation &other) const {
+    return !(*this == other);
+  }
+
+  /**
+   * Orientation from the canonical form
+   */
+  static FrameOrientation fromCanonical(bool flip, uint32_t turns) {
+    return {(turns & 3) * 90, flip, false};
+  }
+};
+
+/**
+ * Orientation that turns pixels already laid out with from into to
+ * Used when a consumer reads a frame that was converted for another one.
+ */
+inline FrameOrientation relativeOrientation(const FrameOrientation &from,
+                                            const FrameOrientation &to) {
+  // Undo from: a flip is its own inverse and a flipped turn commutes to the
+  // opposite turn, so (flip, k)^-1 is (flip, k) when flipped, (0, -k) if not
+  const bool inv_flip = from.flipped();
+  const uint32_t inv_turns = inv_flip ? from.quarterTurns()
+                                      : 4 - from.quarterTurns();
+  // Then apply to, its flip reverses the direction of the turns before it
+  const uint32_t turns =
+      to.quarterTurns() + (to.flipped() ? 4 - inv_turns : inv_turns);
+  return FrameOrientation::fromCanonical(inv_flip != to.flipped(), turns);
+}
+
+/**
+ * Size of a width x height frame after the orientation
+ */
+inline void orientedSize(const FrameOrientation &orientation, uint32_t width,
+                         uint32_t height, uint32_t &out_width,
+                         uint32_t &out_height) {
+  out_width = orientation.swapsAxes() ? height : width;
+  out_height = orientation.swapsAxes() ? width : height;
+}
+
+/**
+ * Position of the pixel (x, y) of a width x height frame after the
+ * orientation. Linear in x and y, so it also gives the step between pixels
+ * when x or y are outside of the frame.
+ */
+inline void orientPoint(const FrameOrientation &orientation, uint32_t width,
+                        uint32_t height, int64_t x, int64_t y, int64_t &out_x,
+                        int64_t &out_y) {
+  if (orientation.flipped()) {
+    x = (int64_t)width - 1 - x;
+  }
+  switch (orientation.quarterTurns()) {
+  case 1:
+    out_x = (int64_t)height - 1 - y;
+    out_y = x;
+    break;
+  case 2:
+    out_x = (int64_t)width - 1 - x;
+    out_y = (int64_t)height - 1 - y;
+    break;
+  case 3:
+    out_x = y;
+    out_y = (int64_t)width - 1 - x;
+    break;
+  default:
+    out_x = x;
+    out_y = y;
+    break;
+  }
+}
+
+} // namespace serenegiant::flutter
+
+#endif // FLUTTER_FRAME_ORIENTATION_H
@@ -0,0 +1,57 @@
+/**
+ * Flutter Frame Scaler
+ *
+ * Scales RGBA frames so that each consumer (preview texture, recording
+ * surface) can receive its own output size. On Android the bundled libyuv
+ * (yuv1905_static) is used, which has NEON/SSE box and bilinear kernels.
+ * Other builds fall back to portable fixed point loops.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#ifndef FLUTTER_FRAME_SCALER_H
+#define FLUTTER_FRAME_SCALER_H
+
+// Standard C/C++ headers
+#include <cstdint>
+
+namespace serenegiant::flutter {
+
+/**
+ * Scaling filter
+ */
+enum class ScaleFilter {
+  /**
+   * Average of all source pixels covered by a destination pixel, best for
+   * downscaling. Falls back to bilinear when upscaling.
+   */
+  Box,
+  /**
+   * Bilinear interpolation
+   */
+  Bilinear,
+};
+
+/**
+ * Scale a RGBA (4 bytes per pixel) frame
+ * Channels are treated independently, so any 4 byte per pixel layout works.
+ * @param src Source pixels
+ * @param src_width Source width
+ * @param src_height Source height
+ * @param src_stride Source row stride in bytes
+ * @param dst Destination pixels
+ * @param dst_width Destination width
+ * @param dst_height Destination height
+ * @param dst_stride Destination row stride in bytes
+ * @param filter Scaling filter
+ * @return 0 on success, negative on error
+ */
+int scaleRgba(const uint8_t *src, uint32_t src_width, uint32_t src_height,
+              uint32_t src_stride, uint8_t *dst, uint32_t dst_width,
+              uint32_t dst_height, uint32_t dst_stride,
+              ScaleFilter filter = ScaleFilter::Box);
+
+} // namespace serenegiant::flutter
+
+#endif // FLUTTER_FRAME_SCALER_H
@@ -0,0 +1,281 @@
+/**
+ * Flutter Frame Subscriptions
+ *
+ * Lets several analysis consumers subscribe to the frames of one renderer.
+ * Each subscriber picks the frame format and size it wants, a maximum rate,
+ * and whether it runs inline on the capture thread or on the shared task
+ * pool. Pool subscribers get their own copy of the frame, and a frame is
+ * dropped for a subscriber that is still busy with the previous one, so a
+ * slow subscriber never stalls capture.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#ifndef FLUTTER_FRAME_SUBSCRIPTION_H
+#define FLUTTER_FRAME_SUBSCRIPTION_H
+
+// Standard C/C++ headers
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Project headers
+#include "flutter_frame_crop.h"
+#include "flutter_task_pool.h"
+
+namespace serenegiant::flutter {
+
+template <typename Signature> class FunctionRef;
+
+/**
+ * Non-owning reference to a callable, two pointers and no allocation
+ * The callable must outlive the reference, temporaries are rejected.
+ */
+template <typename R, typename... Args> class FunctionRef<R(Args...)> {
+public:
+  FunctionRef() = default;
+
+  template <typename F,
+            typename = std::enable_if_t<
+                !std::is_same_v<std::remove_cv_t<F>, FunctionRef>>>
+  FunctionRef(F &callable) // NOLINT(google-explicit-constructor)
+      : m_object(const_cast<void *>(static_cast<const void *>(&callable))),
+        m_call([](void *object, Args... args) -> R {
+          return (*static_cast<F *>(object))(std::forward<Args>(args)...);
+        }) {}
+
+  template <typename F,
+            typename = std::enable_if_t<!std::is_lvalue_reference_v<F> &&
+                                        !std::is_same_v<F, FunctionRef>>>
+  FunctionRef(F &&callable) = delete;
+
+  R operator()(Args... args) const {
+    return m_call(m_object, std::forward<Args>(args)...);
+  }
+
+  explicit operator bool() const { return m_call != nullptr; }
+
+private:
+  void *m_object = nullptr;
+  R (*m_call)(void *, Args...) = nullptr;
+};
+
+/**
+ * Frame format handed to a subscriber
+ */
+enum class FrameFormat {
+  /**
+   * The frame as fetched from the device (MJPEG, YUYV, ...)
+   */
+  Raw,
+  /**
+   * Decoded RGBA, cropped, oriented and scaled to the requested size
+   */
+  Rgba,
+};
+
+/**
+ * Where a subscriber runs
+ */
+enum class DispatchMode {
+  /**
+   * On the capture thread, the frame is not copied. Must return quickly.
+   */
+  Inline,
+  /**
+   * On the shared task pool at analysis priority with a copy of the frame.
+   * Frames arriving while the previous call is running are dropped.
+   */
+  Pool,
+};
+
+/**
+ * Frame handed to a subscriber, only valid during the call
+ */
+struct FrameView {
+  const uint8_t *data;
+  size_t len;
+  // RAW_FRAME_XXX, RAW_FRAME_UNCOMPRESSED_RGBX for FrameFormat::Rgba
+  uint32_t frame_type;
+  uint32_t width;
+  uint32_t height;
+  // De-jittered CLOCK_MONOTONIC timestamp in microseconds
+  int64_t pts_us;
+};
+
+using FrameFunctionRef = FunctionRef<void(const FrameView &)>;
+
+/**
+ * What a subscriber wants to receive
+ */
+struct SubscriberOptions {
+  FrameFormat format = FrameFormat::Raw;
+  // Part of the frame for FrameFormat::Rgba in camera pixels, empty means the
+  // whole frame. Only the union of the crops is decoded.
+  FrameRect crop;
+  // Rotation/mirroring for FrameFormat::Rgba, applied after the crop
+  FrameOrientation orientation;
+  // Output size for FrameFormat::Rgba after the orientation, 0 means the
+  // decoded size of the crop
+  uint32_t width = 0;
+  uint32_t height = 0;
+  // Maximum frame rate, 0 means every frame
+  float max_fps = 0.0f;
+  DispatchMode mode = DispatchMode::Pool;
+};
+
+/**
+ * Decoded pixels needed by the subscribers due for a frame
+ */
+struct RgbaDemand {
+  // Whether any due subscriber wants RGBA
+  bool due;
+  // Size the whole frame has to be decoded at so that every crop covers its
+  // requested size, only valid when full is false
+  uint32_t width;
+  uint32_t height;
+  // Whether a due subscriber wants the decoded size
+  bool full;
+  // Union of the crops of the due subscribers in camera pixels
+  FrameRect region;
+};
+
+/**
+ * Delivery counters of a subscriber
+ */
+struct SubscriberStats {
+  // Frames handed to the subscriber
+  uint64_t delivered;
+  // Frames skipped to stay under max_fps
+  uint64_t rate_limited;
+  // Frames dropped because the previous pool call was still running
+  uint64_t dropped_busy;
+};
+
+/**
+ * Subscriber registry of one renderer
+ * subscribe/unsubscribe may be called from any thread while streaming. The
+ * capture thread works on an immutable snapshot of the list, so it never
+ * waits for a (un)subscribe.
+ */
+class FrameSubscriptions {
+public:
+  struct Subscriber;
+  using Snapshot =
+      std::shared_ptr<const std::vector<std::shared_ptr<Subscriber>>>;
+
+  /**
+   * @param device_id Device the pool tasks are accounted to
+   */
+  explicit FrameSubscriptions(int32_t device_id);
+  ~FrameSubscriptions();
+
+  FrameSubscriptions(const FrameSubscriptions &) = delete;
+  FrameSubscriptions &operator=(const FrameSubscriptions &) = delete;
+
+  /**
+   * Add a subscriber
+   * @param callback Called for each delivered frame, the callable must stay
+   *        valid until unsubscribe() returns
+   * @return Positive subscription id, negative on error
+   */
+  int32_t subscribe(const SubscriberOptions &options,
+                    FrameFunctionRef callback);
+
+  /**
+   * Remove a subscriber
+   * Waits for a running call to finish unless called from that call, so the
+   * callable can be destroyed right after this returns.
+   * @return 0 on success, -ENOENT if the id is unknown
+   */
+  int unsubscribe(int32_t id);
+
+  /**
+   * Remove all subscribers and wait for their running calls
+   */
+  void clear();
+
+  /**
+   * Number of subscribers
+   */
+  size_t size() const;
+
+  /**
+   * Get the delivery counters of a subscriber
+   * @return 0 on success, -ENOENT if the id is unknown
+   */
+  int getStats(int32_t id, SubscriberStats &stats) const;
+
+  //----------------------------------------------------------------------------
+  // Capture thread side
+
+  /**
+   * Current subscriber list
+   */
+  Snapshot snapshot() const;
+
+  /**
+   * Whether any subscriber in the list takes RGBA frames
+   */
+  static bool wantsRgba(const Snapshot &subscribers);
+
+  /**
+   * Decide which subscribers get the frame with this timestamp
+   * Pool subscribers still busy with the previous frame and subscribers over
+   * their rate are skipped. Only the capture thread may call this.
+   * @param timestamp_ns Frame timestamp, used for the rate limit
+   * @param width Camera frame width, the crops are clipped to it
+   * @param height Camera frame height
+   * @param rgba Decoded pixels needed by the due subscribers
+   * @return Whether any subscriber is due
+   */
+  bool schedule(const Snapshot &subscribers, int64_t timestamp_ns,
+                uint32_t width, uint32_t height, RgbaDemand &rgba);
+
+  /**
+   * Hand the fetched frame to the due raw subscribers
+   * Inline subscribers are called before this returns, pool subscribers get
+   * a copy and are submitted to the pool. Only the capture thread may call
+   * this.
+   * @param on_deliver Called right before each delivery (latency probe)
+   */
+  void dispatch(const Snapshot &subscribers, const FrameView &frame,
+                FunctionRef<void()> on_deliver);
+
+  /**
+   * Hand the decoded frame to the due RGBA subscribers
+   * Each subscriber gets its crop scaled to its size and turned to its
+   * orientation, the turn is fused into the copy every subscriber but one
+   * makes anyway. The decoded pixels are passed without a copy to an inline
+   * subscriber that takes all of them as they are.
+   * @param frame Decoded region covering the crops of the due subscribers
+   */
+  void dispatch(const Snapshot &subscribers, const DecodedFrame &frame,
+                FunctionRef<void()> on_deliver);
+
+private:
+  const int32_t m_device_id;
+
+  mutable std::mutex m_lock;
+  std::condition_variable m_idle;
+  int32_t m_next_id;
+  Snapshot m_subscribers;
+  // Removed subscribers with a pool call still running
+  std::vector<std::shared_ptr<Subscriber>> m_retired;
+
+  void deliver(Subscriber &subscriber, const FrameView &view, bool copy,
+               FunctionRef<void()> on_deliver);
+  void runOnPool(Subscriber *subscriber);
+  void finish(Subscriber *subscriber);
+};
+
+} // namespace serenegiant::flutter
+
+#endif // FLUTTER_FRAME_SUBSCRIPTION_H
@@ -0,0 +1,223 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef AANDUSB_FLUTTER_LATENCY_PROBE_H
+#define AANDUSB_FLUTTER_LATENCY_PROBE_H
+
+// 標準ライブラリ
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace serenegiant::flutter
+{
+
+	/**
+	 * 遅延測定用のスタンプの識別子("LPRB")
+	 */
+	#define LATENCY_PROBE_MAGIC (0x4252504cu)
+	/**
+	 * フレームへ埋め込むスタンプのバイト数(識別子, シーケンス番号, 撮影時刻)
+	 */
+	#define LATENCY_PROBE_STAMP_BYTES (16)
+	/**
+	 * 遅延のヒストグラムのビン数
+	 * ビン0は1マイクロ秒未満, ビンi(i>=1)は[2^(i-1), 2^i)マイクロ秒, 最後のビンはそれ以上
+	 */
+	#define LATENCY_HISTOGRAM_BUCKETS (24)
+
+	/**
+	 * 遅延を測定するパイプラインの段階
+	 */
+	typedef enum latency_stage {
+		/**
+		 * uvc_get_frameでフレームを受け取った
+		 */
+		LATENCY_STAGE_FETCH = 0,
+		/**
+		 * MJPEGのデコード/RGBAへの変換が終わった
+		 */
+		LATENCY_STAGE_CONVERT,
+		/**
+		 * プレビュー用Surfaceへ書き込んだ
+		 */
+		LATENCY_STAGE_PREVIEW,
+		/**
+		 * 録画用Surface(エンコーダーの入力)へ書き込んだ
+		 */
+		LATENCY_STAGE_RECORDING,
+		/**
+		 * フレームコールバックを呼び出した
+		 */
+		LATENCY_STAGE_CALLBACK,
+		LATENCY_STAGE_NUM,
+	} latency_stage_t;
+
+	/**
+	 * 映像ソースがフレームへ埋め込むスタンプ
+	 */
+	typedef struct latency_stamp {
+		/**
+		 * フレームのシーケンス番号
+		 */
+		uint32_t seq;
+		/**
+		 * 撮影したCLOCK_MONOTONICの時刻[ナノ秒]
+		 */
+		int64_t capture_ns;
+	} latency_stamp_t;
+
+	/**
+	 * パイプラインの段階毎の撮影からの遅延の統計情報
+	 */
+	typedef struct latency_stats {
+		/**
+		 * 測定したフレーム数
+		 */
+		uint64_t count;
+		/**
+		 * 撮影からの遅延の最小値/平均値/最大値[ナノ秒]
+		 */
+		int64_t min_ns;
+		int64_t mean_ns;
+		int64_t max_ns;
+		/**
+		 * ヒストグラムから求めた撮影からの遅延のパーセンタイル[ナノ秒]
+		 * ビンの上限値なので最大でビンの幅だけ大きい
+		 */
+		int64_t p50_ns;
+		int64_t p95_ns;
+		int64_t p99_ns;
+		/**
+		 * 撮影からの遅延のヒストグラム
+		 */
+		uint32_t histogram[LATENCY_HISTOGRAM_BUCKETS];
+	} latency_stats_t;
+
+	/**
+	 * 遅延測定用のスタンプをフレームへ埋め込む
+	 * MJPEGはSOIの直後にCOMセグメントとして挿入し, 非圧縮フレームは先頭の16バイトを上書きする
+	 * H264等のその他の圧縮フォーマットには埋め込めない
+	 * @param frame_type フレームの映像フォーマット
+	 * @param data フレームデータ
+	 * @param bytes フレームデータのバイト数, MJPEGならCOMセグメント分だけ増える
+	 * @param capacity dataのバイト数
+	 * @param stamp
+	 * @return 0: 成功, 負: エラーコード
+	 */
+	int latency_probe_embed(
+		const uint32_t &frame_type,
+		uint8_t *data, size_t &bytes, const size_t &capacity,
+		const latency_stamp_t &stamp);
+
+	/**
+	 * フレームから遅延測定用のスタンプを取り出す
+	 * @param data フレームデータ
+	 * @param bytes フレームデータのバイト数
+	 * @param stamp
+	 * @return true: スタンプが埋め込まれていた
+	 */
+	bool latency_probe_extract(
+		const uint8_t *data, const size_t &bytes,
+		latency_stamp_t &stamp);
+
+	/**
+	 * 撮影からパイプラインの各段階へフレームが届くまでの遅延を測定する
+	 * 映像ソースがフレームへ埋め込んだスタンプの撮影時刻から各段階の時刻までを段階毎のヒストグラムに集計する
+	 * 有効にしていない時は何もしない
+	 * ・beginは映像取得スレッドから, recordはタスクプールのワーカースレッドを含む任意のスレッドから呼び出してよい
+	 */
+	class LatencyProbe
+	{
+	private:
+		mutable std::mutex m_lock;
+		std::atomic<bool> m_enabled;
+		/**
+		 * スタンプ付きで受け取ったフレーム数/スタンプの無かったフレーム数
+		 */
+		uint64_t m_frames;
+		uint64_t m_no_stamp;
+		/**
+		 * シーケンス番号の欠番から求めたパイプラインへ届かなかったフレーム数
+		 */
+		uint64_t m_dropped;
+		bool m_has_seq;
+		uint32_t m_last_seq;
+		/**
+		 * 段階毎の集計結果, countが0ならmin/maxは未確定
+		 */
+		struct {
+			uint64_t count;
+			int64_t sum_ns;
+			int64_t min_ns;
+			int64_t max_ns;
+			uint32_t histogram[LATENCY_HISTOGRAM_BUCKETS];
+		} m_stages[LATENCY_STAGE_NUM];
+
+		void reset_locked();
+	public:
+		LatencyProbe();
+		~LatencyProbe() = default;
+
+		LatencyProbe(const LatencyProbe &) = delete;
+		LatencyProbe &operator=(const LatencyProbe &) = delete;
+
+		/**
+		 * 遅延の測定を有効/無効にする, 集計結果は破棄する
+		 * @param enabled
+		 */
+		void set_enabled(const bool &enabled);
+		inline bool is_enabled() const { return m_enabled; }
+		/**
+		 * 集計結果を破棄する
+		 */
+		void reset();
+		/**
+		 * 受け取ったフレームからスタンプを取り出して欠番を数える
+		 * @param data
+		 * @param bytes
+		 * @param stamp
+		 * @return true: 測定が有効でスタンプが埋め込まれていた, recordを呼ぶ
+		 */
+		bool begin(const uint8_t *data, const size_t &bytes, latency_stamp_t &stamp);
+		/**
+		 * フレームがパイプラインの段階へ届いたのを記録する
+		 * @param stage
+		 * @param stamp beginで取り出したスタンプ
+		 * @param now_ns 届いたCLOCK_MONOTONICの時刻[ナノ秒], 0なら現在時刻
+		 */
+		void record(const latency_stage_t &stage, const latency_stamp_t &stamp, const int64_t &now_ns = 0);
+		/**
+		 * 段階毎の集計結果を取得
+		 * @param stage
+		 * @param stats
+		 */
+		void get_stats(const latency_stage_t &stage, latency_stats_t &stats) const;
+		/**
+		 * シーケンス番号の欠番から求めたパイプラインへ届かなかったフレーム数
+		 */
+		uint64_t get_dropped() const;
+		/**
+		 * スタンプが無かったので測定できなかったフレーム数
+		 */
+		uint64_t get_no_stamp() const;
+	};
+
+}	// namespace serenegiant::flutter
+
+#endif //AANDUSB_FLUTTER_LATENCY_PROBE_H
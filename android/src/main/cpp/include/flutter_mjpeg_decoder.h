@@ -0,0 +1,124 @@
+/**
+ * Flutter MJPEG Decoder
+ *
+ * Decodes MJPEG frames into RGBA using libjpeg-turbo. When the consumers of
+ * a frame need fewer pixels than the camera produces, the decoder uses
+ * libjpeg-turbo's scaled IDCT (1/2, 1/4, 1/8) so that the reduced image
+ * comes straight out of the IDCT instead of being decoded at full size and
+ * thrown away. When the consumers only look at part of the frame, the
+ * decoder crops the IDCT columns with jpeg_crop_scanline, skips the rows
+ * above the crop with jpeg_skip_scanlines and stops after the last row.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#ifndef FLUTTER_MJPEG_DECODER_H
+#define FLUTTER_MJPEG_DECODER_H
+
+// Standard C/C++ headers
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// libjpeg-turbo
+#include <cstdio>
+#include "jpeglib.h"
+
+// Project headers
+#include "flutter_frame_crop.h"
+
+namespace serenegiant::flutter {
+
+/**
+ * MJPEG to RGBA decoder with scaled IDCT support
+ * Not thread safe, use one instance per capture thread.
+ */
+class MjpegDecoder {
+public:
+  MjpegDecoder();
+  ~MjpegDecoder();
+
+  // Disable copy
+  MjpegDecoder(const MjpegDecoder &) = delete;
+  MjpegDecoder &operator=(const MjpegDecoder &) = delete;
+
+  /**
+   * Select the largest IDCT scale denominator (1, 2, 4 or 8) whose output
+   * still covers the requested size, so consumers never get fewer pixels
+   * than they asked for.
+   * @param src_width Source (encoded) width
+   * @param src_height Source (encoded) height
+   * @param dst_width Width needed by the consumers, 0 means full resolution
+   * @param dst_height Height needed by the consumers, 0 means full resolution
+   * @return Scale denominator, 1 means full resolution
+   */
+  static uint32_t selectScaleDenom(uint32_t src_width, uint32_t src_height,
+                                   uint32_t dst_width, uint32_t dst_height);
+
+  /**
+   * Decode a MJPEG frame into tightly packed RGBA
+   * @param jpeg MJPEG frame data
+   * @param len Length of the frame data
+   * @param dst_width Width needed by the consumers, 0 means full resolution
+   * @param dst_height Height needed by the consumers, 0 means full resolution
+   * @param rgba Output buffer, resized as needed
+   * @param out_width Actual decoded width
+   * @param out_height Actual decoded height
+   * @return 0 on success, negative on error
+   */
+  int decode(const uint8_t *jpeg, size_t len, uint32_t dst_width,
+             uint32_t dst_height, std::vector<uint8_t> &rgba,
+             uint32_t &out_width, uint32_t &out_height);
+
+  /**
+   * Decode the part of a MJPEG frame covering a crop into tightly packed RGBA
+   * @param crop Part of the frame needed, in encoded pixels, empty means the
+   *        whole frame
+   * @param out_width Decoded width of the whole frame
+   * @param out_height Decoded height of the whole frame
+   * @param region Part of the decoded frame written to rgba, covers the crop
+   *        scaled to the decoded size and is widened to whole iMCU columns.
+   *        The row stride of rgba is region.width * 4.
+   * @return 0 on success, negative on error
+   */
+  int decode(const uint8_t *jpeg, size_t len, uint32_t dst_width,
+             uint32_t dst_height, const FrameRect &crop,
+             std::vector<uint8_t> &rgba, uint32_t &out_width,
+             uint32_t &out_height, FrameRect &region);
+
+  /**
+   * Decode only the luma of a MJPEG frame, the chroma components skip the
+   * IDCT and upsampling
+   * @param scale_denom IDCT scale denominator, 1, 2, 4 or 8
+   * @param luma Output buffer, out_width * out_height bytes, resized as
+   *        needed
+   * @return 0 on success, negative on error
+   */
+  int decodeLuma(const uint8_t *jpeg, size_t len, uint32_t scale_denom,
+                 std::vector<uint8_t> &luma, uint32_t &out_width,
+                 uint32_t &out_height);
+
+  /**
+   * Scale denominator used by the last successful decode
+   */
+  uint32_t lastScaleDenom() const { return m_last_scale_denom; }
+
+private:
+  struct ErrorManager {
+    jpeg_error_mgr pub;
+    void *jmp_buf_ptr;
+  };
+
+  jpeg_decompress_struct m_cinfo;
+  ErrorManager m_jerr;
+  uint32_t m_last_scale_denom;
+  std::vector<JSAMPROW> m_rows;
+
+  static void onError(j_common_ptr cinfo);
+  static void onMessage(j_common_ptr cinfo);
+};
+
+} // namespace serenegiant::flutter
+
+#endif // FLUTTER_MJPEG_DECODER_H
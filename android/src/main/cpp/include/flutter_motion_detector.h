@@ -0,0 +1,160 @@
+/**
+ * Flutter Motion Detector
+ *
+ * Cheap frame difference motion detector for gating the recording. Every
+ * analysed frame is reduced to a subsampled luma plane (MJPEG through the
+ * scaled IDCT of the luma component only), split into a grid and
+ * compared with the previous plane using a SIMD sum of absolute differences
+ * (NEON on Android, SSE2 on x86). A cell changes when its mean difference
+ * reaches the threshold, a frame has motion when enough unmasked cells
+ * changed. Hysteresis keeps short flickers from starting the recording and
+ * keeps the recording running until the scene has been still for a while.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#ifndef FLUTTER_MOTION_DETECTOR_H
+#define FLUTTER_MOTION_DETECTOR_H
+
+// Standard C/C++ headers
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Project headers
+#include "flutter_mjpeg_decoder.h"
+
+namespace serenegiant::flutter {
+
+/**
+ * Maximum grid columns and rows
+ */
+#define MOTION_MAX_GRID (32)
+/**
+ * Maximum number of grid cells, size of the mask
+ */
+#define MOTION_MAX_CELLS (MOTION_MAX_GRID * MOTION_MAX_GRID)
+
+/**
+ * Motion detection settings
+ */
+struct MotionConfig {
+  // Grid the luma plane is split into, 1..MOTION_MAX_GRID each
+  uint32_t grid_columns = 16;
+  uint32_t grid_rows = 12;
+  // Every n-th pixel of every n-th row is analysed, 1, 2, 4 or 8
+  uint32_t subsample = 4;
+  // Sensitivity, mean absolute luma difference (1..255) from which a cell
+  // counts as changed and number of changed cells that make a frame with
+  // motion
+  uint32_t cell_threshold = 12;
+  uint32_t min_cells = 2;
+  // Hysteresis, consecutive frames with motion that start the motion and
+  // time without motion until it ends
+  uint32_t trigger_frames = 2;
+  uint32_t hold_ms = 3000;
+  // Minimum time between analysed frames, 0 analyses every frame
+  uint32_t interval_ms = 100;
+  // Whether the recording only gets frames while there is motion
+  bool gate_recording = false;
+  // grid_columns * grid_rows entries row by row, 0 ignores the cell.
+  // Empty watches every cell.
+  std::vector<uint8_t> mask;
+};
+
+/**
+ * Result of one analysed frame
+ */
+struct MotionResult {
+  // Cells above the threshold in this frame
+  uint32_t changed_cells;
+  // Highest mean absolute difference of a cell
+  uint32_t peak;
+  // Motion state after hysteresis
+  bool motion;
+  // Whether this frame started or ended the motion
+  bool changed;
+};
+
+/**
+ * Sum of absolute differences of two byte rows
+ */
+uint32_t sadRow(const uint8_t *a, const uint8_t *b, size_t n);
+
+/**
+ * Motion detector, every call is serialised by an internal lock so frames
+ * may come from several threads (e.g. during the recording handover).
+ */
+class MotionDetector {
+public:
+  MotionDetector() = default;
+
+  // Disable copy
+  MotionDetector(const MotionDetector &) = delete;
+  MotionDetector &operator=(const MotionDetector &) = delete;
+
+  /**
+   * Apply new settings and start over without motion
+   * @return 0 on success, -EINVAL for settings out of range
+   */
+  int configure(const MotionConfig &config);
+
+  /**
+   * Drop the reference frame and the motion state
+   */
+  void reset();
+
+  /**
+   * Analyse a frame
+   * The reference frame is replaced after every analysed frame, a frame of
+   * another type or size only becomes the reference.
+   * @param frame_type MJPEG, YUYV, NV12, NV21 or RGBX
+   * @param time_us Monotonic time of the frame, drives the interval and
+   *        the hold time
+   * @return 0 when analysed, -EAGAIN when skipped (interval or new
+   *         reference), -ENOTSUP for other formats, -EINVAL when the frame
+   *         is too short, -ENODATA when the MJPEG frame did not decode
+   */
+  int process(uint32_t frame_type, const uint8_t *frame, size_t len,
+              uint32_t width, uint32_t height, int64_t time_us,
+              MotionResult &result);
+
+  /**
+   * Motion state after hysteresis
+   */
+  bool inMotion() const { return m_in_motion.load(); }
+
+  /**
+   * Whether the recording only gets frames while there is motion
+   */
+  bool gatesRecording() const { return m_gate_recording.load(); }
+
+private:
+  int extractLuma(uint32_t frame_type, const uint8_t *frame, size_t len,
+                  uint32_t width, uint32_t height);
+  void compare(MotionResult &result) const;
+
+  std::mutex m_lock;
+  MotionConfig m_config;
+  MjpegDecoder m_decoder;
+  // Current and reference luma planes
+  std::vector<uint8_t> m_luma;
+  std::vector<uint8_t> m_reference;
+  uint32_t m_luma_width = 0;
+  uint32_t m_luma_height = 0;
+  uint32_t m_reference_type = 0;
+  uint32_t m_reference_width = 0;
+  uint32_t m_reference_height = 0;
+  int64_t m_last_time_us = 0;
+  int64_t m_last_motion_us = 0;
+  uint32_t m_motion_frames = 0;
+  std::atomic<bool> m_in_motion{false};
+  std::atomic<bool> m_gate_recording{false};
+};
+
+} // namespace serenegiant::flutter
+
+#endif // FLUTTER_MOTION_DETECTOR_H
@@ -37,6 +37,410 @@
  */
 #define MAX_INTERVALS (128)
 
+/**
+ * Flutterのc#側と映像サイズ設定をやりとりするための構造体定義
+ * Flutterのc#側にも同じ構造体を定義する必要がある
+ * should match to uvc_video_size_t in aandusb_native.h
+ */
+typedef struct flutter_video_size {
+	uint32_t frame_type;
+	/**
+	 * フレームインデックス
+	 */
+	int32_t frame_index;
+	/**
+	 * 映像幅[ピクセル数]
+	 */
+	uint32_t width;
+	/**
+	 * 映像高さ[ピクセル数]
+	 */
+	uint32_t height;
+	/**
+	 * フレームレートのタイプ
+	 * 0: min/max/stepの3つのuint32_tで指定
+	 * 正数: フレームインターバルデータの個数
+	 */
+	int32_t frame_interval_type;
+	/**
+	 * フレームインターバルデータ
+	 */
+	uint32_t frame_intervals[MAX_INTERVALS];
+	/**
+	 * フレームインターバルデータの個数
+	 */
+	int32_t num_frame_intervals;
+	/**
+	 * フレームレート
+	 */
+	float fps[MAX_INTERVALS];
+	/**
+	 * フレームレートの個数
+	 */
+	int32_t num_fps;
+} __attribute__((__packed__)) flutter_video_size_t;
+
+/**
+ * Dart側から複数UVC機器の帯域計画を要求するための構造体定義
+ * Dart側にも同じ構造体を定義する必要がある
+ */
+typedef struct flutter_bandwidth_request {
+	/**
+	 * UVC機器の識別子
+	 */
+	int32_t device_id;
+	/**
+	 * 最小映像幅[ピクセル数], 0なら制限なし
+	 */
+	uint32_t min_width;
+	/**
+	 * 最小映像高さ[ピクセル数], 0なら制限なし
+	 */
+	uint32_t min_height;
+	/**
+	 * 最小フレームレート, 0以下なら15fps
+	 */
+	float min_fps;
+} __attribute__((__packed__)) flutter_bandwidth_request_t;
+
+/**
+ * 複数UVC機器の帯域計画の結果をDart側へ返すための構造体定義
+ * Dart側にも同じ構造体を定義する必要がある
+ */
+typedef struct flutter_bandwidth_plan {
+	int32_t device_id;
+	uint32_t frame_type;
+	uint32_t width;
+	uint32_t height;
+	/**
+	 * フレームインターバル[100ナノ秒単位], 録画時はこのフレームレートへ間引く
+	 */
+	uint32_t frame_interval;
+	/**
+	 * フレームレート
+	 */
+	float fps;
+	/**
+	 * 必要な帯域の見積もり[バイト/秒], negotiated_intervalで見積もる
+	 */
+	uint64_t bandwidth;
+	/**
+	 * UVC機器がネゴシエーションするフレームインターバル[100ナノ秒単位]
+	 * 映像サイズ変更時にフレームインターバルを指定できないので対応している最短のもの
+	 */
+	uint32_t negotiated_interval;
+	/**
+	 * UVC機器がネゴシエーションするフレームレート
+	 */
+	float negotiated_fps;
+} __attribute__((__packed__)) flutter_bandwidth_plan_t;
+
+/**
+ * Dart側から映像処理スレッドのスレッドポリシーを指定するための構造体定義
+ * Dart側にも同じ構造体を定義する必要がある
+ * should match to thread_policy_t in flutter_thread_policy.h
+ */
+typedef struct flutter_thread_policy {
+	/**
+	 * 実行するCPUのビットマスク(ビットnがCPU n), 0なら全てのCPU
+	 */
+	uint64_t cpu_mask;
+	/**
+	 * nice値(-20〜19)
+	 */
+	int32_t nice;
+	/**
+	 * SCHED_FIFOの優先度(1〜99), 0ならSCHED_OTHER
+	 */
+	int32_t rt_priority;
+} __attribute__((__packed__)) flutter_thread_policy_t;
+
+/**
+ * 映像処理スレッドの統計情報をDart側へ返すための構造体定義
+ * Dart側にも同じ構造体を定義する必要がある
+ */
+typedef struct flutter_thread_stats {
+	uint8_t name[16];
+	int32_t device_id;
+	int32_t tid;
+	/**
+	 * 最後に確認した時に実行していたCPU
+	 */
+	int32_t cpu;
+	/**
+	 * 適用されているスケジューリングポリシー, 0: SCHED_OTHER, 1: SCHED_FIFO
+	 */
+	int32_t sched_policy;
+	/**
+	 * スレッドポリシーを適用した結果, 0: 成功, 負: エラーコード
+	 */
+	int32_t policy_result;
+	uint64_t samples;
+	/**
+	 * 実行するCPUが変わっていた回数
+	 */
+	uint64_t migrations;
+	/**
+	 * 他のスレッドに横取りされた回数(非自発的コンテキストスイッチ)
+	 */
+	uint64_t preemptions;
+	/**
+	 * 自発的コンテキストスイッチの回数
+	 */
+	uint64_t voluntary_switches;
+} __attribute__((__packed__)) flutter_thread_stats_t;
+
+/**
+ * 機器側PTSからCLOCK_MONOTONICへのクロックモデルの統計情報をDart側へ返すための構造体定義
+ * Dart側にも同じ構造体を定義する必要がある
+ */
+typedef struct flutter_clock_stats {
+	uint64_t frames;
+	/**
+	 * PTSが無いので到着時刻をそのまま使ったフレーム数
+	 */
+	uint64_t no_pts;
+	/**
+	 * PTSの巻き戻り/不連続でクロックモデルをやり直した回数
+	 */
+	uint64_t resets;
+	uint32_t samples;
+	/**
+	 * 機器側クロックのずれ[ppm], 正なら機器側クロックが進んでいる
+	 */
+	double drift_ppm;
+	/**
+	 * 到着時刻の揺らぎの標準偏差/最大値[マイクロ秒]
+	 */
+	int64_t jitter_us;
+	int64_t max_jitter_us;
+	/**
+	 * 揺らぎを吸収するために録画用Surfaceへの書き込みを遅らせる時間[マイクロ秒]
+	 */
+	int64_t pacing_us;
+} __attribute__((__packed__)) flutter_clock_stats_t;
+
+/**
+ * 遅延測定のヒストグラムのビン数
+ * ビン0は1マイクロ秒未満, ビンi(i>=1)は[2^(i-1), 2^i)マイクロ秒, 最後のビンはそれ以上
+ */
+#define FLUTTER_LATENCY_HISTOGRAM_BUCKETS (24)
+
+/**
+ * 撮影からパイプラインの段階へフレームが届くまでの遅延をDart側へ返すための構造体定義
+ * Dart側にも同じ構造体を定義する必要がある
+ */
+typedef struct flutter_latency_stats {
+	/**
+	 * パイプラインの段階, 0: uvc_get_frame, 1: 変換, 2: プレビュー, 3: 録画(エンコーダーの入力), 4: フレームコールバック
+	 */
+	int32_t stage;
+	uint64_t count;
+	/**
+	 * 撮影からの遅延[マイクロ秒]
+	 */
+	int64_t min_us;
+	int64_t mean_us;
+	int64_t max_us;
+	int64_t p50_us;
+	int64_t p95_us;
+	int64_t p99_us;
+	uint32_t histogram[FLUTTER_LATENCY_HISTOGRAM_BUCKETS];
+} __attribute__((__packed__)) flutter_latency_stats_t;
+
+/**
+ * 動き検出の区画の最大数(32x32), マスクの要素数
+ */
+#define FLUTTER_MOTION_MAX_CELLS (1024)
+
+/**
+ * Dart側から動き検出の設定を指定するための構造体定義
+ * Dart側にも同じ構造体を定義する必要がある
+ * should match to MotionConfig in flutter_motion_detector.h
+ */
+typedef struct flutter_motion_config {
+	/**
+	 * 映像を区切る格子の列数/行数(1〜32)
+	 */
+	int32_t grid_columns;
+	int32_t grid_rows;
+	/**
+	 * 縦横何画素毎に解析するか(1, 2, 4, 8)
+	 */
+	int32_t subsample;
+	/**
+	 * 区画の輝度の差分の平均がこの値以上なら変化したとみなす(1〜255)
+	 */
+	int32_t cell_threshold;
+	/**
+	 * 変化した区画がこの数以上あるフレームを動きがあるフレームとみなす
+	 */
+	int32_t min_cells;
+	/**
+	 * 動きがあるフレームがこの数だけ続いたら動きを検出したとする
+	 */
+	int32_t trigger_frames;
+	/**
+	 * 動きが無い状態がこの時間[ミリ秒]続いたら動きが無くなったとする
+	 */
+	int32_t hold_ms;
+	/**
+	 * フレームを解析する間隔[ミリ秒], 0なら全てのフレーム
+	 */
+	int32_t interval_ms;
+	/**
+	 * 0以外なら動きが無い間は録画用Surfaceへ書き込まない
+	 */
+	int32_t gate_recording;
+	/**
+	 * maskの有効な要素数, grid_columns * grid_rowsまたは0(全ての区画を解析する)
+	 */
+	int32_t mask_cells;
+	/**
+	 * 行毎に並べた区画毎のマスク, 0の区画は解析しない
+	 */
+	uint8_t mask[FLUTTER_MOTION_MAX_CELLS];
+} __attribute__((__packed__)) flutter_motion_config_t;
+
+/**
+ * 重複フレームの検出の統計情報をDart側へ返すための構造体定義
+ * Dart側にも同じ構造体を定義する必要がある
+ */
+typedef struct flutter_dedup_stats {
+	/**
+	 * 前のフレームと比較したフレーム数
+	 */
+	uint64_t frames;
+	/**
+	 * 前のフレームと同じだったので変換/書き込みしなかったフレーム数
+	 */
+	uint64_t duplicates;
+	/**
+	 * 連続した重複フレームの最大数
+	 */
+	uint64_t longest_run;
+	/**
+	 * duplicates / frames, 比較したフレームが無ければ0
+	 */
+	double ratio;
+} __attribute__((__packed__)) flutter_dedup_stats_t;
+
+/**
+ * ビットレート/フレームレート制御の最近の変更の最大数
+ */
+#define FLUTTER_RATE_MAX_DECISIONS (32)
+
+/**
+ * ビットレート/フレームレート制御の設定をDart側から受け取るための構造体定義
+ * Dart側にも同じ構造体を定義する必要がある
+ */
+typedef struct flutter_rate_control_config {
+	/**
+	 * 下げられる最低のビットレート[bps]
+	 */
+	int32_t min_bitrate;
+	/**
+	 * 戻す時の最高のビットレート[bps], 0なら録画開始時のビットレート
+	 */
+	int32_t max_bitrate;
+	/**
+	 * エンコーダーの処理待ちのフレーム数がこの数以下なら追いついているとする
+	 */
+	int32_t target_queue_depth;
+	/**
+	 * エンコーダーの処理待ちのフレーム数がこの数を超えたら遅れているとする
+	 */
+	int32_t max_queue_depth;
+	/**
+	 * フレームを間引く最大の間隔(1〜8), 1なら間引かない
+	 */
+	int32_t max_decimation;
+	/**
+	 * 書き込みが停滞した時間の割合[‰]がこの値以上なら停滞しているとする(1〜1000)
+	 */
+	int32_t stall_permille;
+	/**
+	 * 制御する最短の間隔[ミリ秒](1以上)
+	 */
+	int32_t interval_ms;
+	/**
+	 * 追いついた状態がこの回数続いたら1段階戻す
+	 */
+	int32_t recover_intervals;
+} __attribute__((__packed__)) flutter_rate_control_config_t;
+
+/**
+ * ビットレート/フレームレート制御の集計結果をDart側へ返すための構造体定義
+ * Dart側にも同じ構造体を定義する必要がある
+ */
+typedef struct flutter_rate_control_stats {
+	/**
+	 * 評価したエンコーダーの報告の数
+	 */
+	uint64_t updates;
+	/**
+	 * ビットレート/フレームレートを変更した回数
+	 */
+	uint64_t decisions;
+	uint64_t bitrate_decreases;
+	uint64_t bitrate_increases;
+	uint64_t decimation_increases;
+	uint64_t decimation_decreases;
+	/**
+	 * 間引いて録画用Surfaceへ書き込まなかったフレーム数
+	 */
+	uint64_t dropped_frames;
+	/**
+	 * 直近に測定したエンコーダーの出力[bps]
+	 */
+	uint64_t output_bps;
+	/**
+	 * 現在のビットレート[bps], エンコーダーの報告が無ければ0
+	 */
+	uint32_t bitrate;
+	/**
+	 * 現在のフレームの間引き間隔, 1なら間引いていない
+	 */
+	uint32_t decimation;
+	/**
+	 * 直近と最大のエンコーダーの処理待ちのフレーム数
+	 */
+	uint32_t queue_depth;
+	uint32_t max_queue_depth;
+	/**
+	 * 直近の書き込みが停滞した時間の割合[‰]
+	 */
+	uint32_t stall_permille;
+} __attribute__((__packed__)) flutter_rate_control_stats_t;
+
+/**
+ * ビットレート/フレームレートの変更1回分をDart側へ返すための構造体定義
+ * Dart側にも同じ構造体を定義する必要がある
+ */
+typedef struct flutter_rate_decision {
+	/**
+	 * 変更した時刻(CLOCK_MONOTONIC)[マイクロ秒]
+	 */
+	int64_t time_us;
+	/**
+	 * 直近に測定したエンコーダーの出力[bps]
+	 */
+	uint64_t output_bps;
+	/**
+	 * 変更した理由, 0: エンコーダーの処理待ち, 1: 書き込みの停滞, 2: 回復
+	 */
+	uint32_t reason;
+	uint32_t old_bitrate;
+	uint32_t bitrate;
+	uint32_t old_decimation;
+	uint32_t decimation;
+	/**
+	 * 変更した時のエンコーダーの処理待ちのフレーム数と書き込みが停滞した時間の割合[‰]
+	 */
+	uint32_t queue_depth;
+	uint32_t stall_permille;
+} __attribute__((__packed__)) flutter_rate_decision_t;
+
 //--------------------------------------------------------------------------------
 // DartのFlutterプラグイン部分から呼ばれる関数
 
@@ -64,10 +468,303 @@ int set_video_size(
 	uint32_t type,
 	uint32_t width, uint32_t height);
 
+/**
+ * 映像サイズとフレームレートを設定する
+ * 指定した映像サイズが対応しているフレームインターバルの中から
+ * fpsに最も近いもの(min_fps〜max_fpsの範囲内)を選択する
+ * @param device_id
+ * @param type
+ * @param width
+ * @param height
+ * @param fps 要求するフレームレート, 0以下なら範囲内で最大のフレームレート
+ * @param min_fps 最小フレームレート, 0以下なら制限なし
+ * @param max_fps 最大フレームレート, 0以下なら制限なし
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int set_video_size_fps(
+	int32_t device_id,
+	uint32_t type,
+	uint32_t width, uint32_t height,
+	float fps, float min_fps, float max_fps);
+
 EXTERN_C
 int get_current_size(
 	int32_t device_id,
-	uvc_video_size_t *data);
+	flutter_video_size_t *data);
+
+/**
+ * 現在選択されているフレームレートを取得する
+ * @param device_id
+ * @return フレームレート, 未選択/エラー時は0
+ */
+EXTERN_C
+float get_current_fps(int32_t device_id);
+
+/**
+ * uvc_get_frameで受け取った映像フレームのファイルへの記録を開始する
+ * 記録したファイルはFrameReplaySourceで再生できる
+ * @param device_id
+ * @param path 記録ファイルのパス, 既存のファイルは上書きする
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t start_frame_capture(int32_t device_id, const char *path);
+
+/**
+ * 映像フレームの記録を終了する
+ * @param device_id
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t stop_frame_capture(int32_t device_id);
+
+/**
+ * 映像の消費者を登録する
+ * プレビュー用/録画用Surfaceは自動的に登録するのでそれ以外で映像を使う時に呼ぶ
+ * 消費者がいなくて映像取得を一時停止していればすぐに再開する
+ * @param device_id
+ * @param type 0: プレビュー, 1: 録画, 2: 映像解析
+ * @return 0以上: 登録後のその種類の消費者の数, 負: エラーコード
+ */
+EXTERN_C
+int32_t acquire_consumer(int32_t device_id, int32_t type);
+
+/**
+ * acquire_consumerで登録した映像の消費者を解除する
+ * 消費者がいなくなれば猶予時間の経過後に映像取得を一時停止する
+ * @param device_id
+ * @param type 0: プレビュー, 1: 録画, 2: 映像解析
+ * @return 0以上: 解除後のその種類の消費者の数, 負: エラーコード
+ */
+EXTERN_C
+int32_t release_consumer(int32_t device_id, int32_t type);
+
+/**
+ * 消費者がいなくなってから映像取得を一時停止するまでの猶予時間をセットする
+ * @param device_id
+ * @param timeout_ms 猶予時間[ミリ秒], 負なら一時停止しない
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t set_idle_timeout(int32_t device_id, int32_t timeout_ms);
+
+/**
+ * ヘッドレスモードを切り替える
+ * アプリがバックグラウンドの間はプレビューのための変換/描画/テクスチャ更新を止めて
+ * 録画だけを継続する, プレビューだけなら消費者がいなくなるので猶予時間後に映像取得も一時停止する
+ * @param device_id
+ * @param headless 0: 解除, 0以外: ヘッドレスモード
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t set_headless(int32_t device_id, int32_t headless);
+
+/**
+ * 最後に映像取得中に映像サイズを変更した時に映像取得を再開するまでに掛かった時間を取得
+ * 映像取得中のset_video_size/set_video_size_fpsはSurfaceや録画スレッドはそのままで
+ * 映像取得だけを終了→映像サイズ変更→再開する
+ * @param device_id
+ * @return 0以上: 切り替え時間[マイクロ秒](映像取得中に変更していなければ0), 負: エラーコード
+ */
+EXTERN_C
+int64_t get_switch_latency_us(int32_t device_id);
+
+/**
+ * UVC機器が接続された時に映像取得開始後の最初のフレームまでの処理
+ * (共有タスクプールのワーカースレッドの生成, 録画用フレームバッファの確保)を前もって行うかどうかをセットする
+ * 有効にした時に既に接続されているUVC機器も事前準備する
+ * @param enabled 0: 事前準備しない(デフォルト), 0以外: 事前準備する
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t set_prewarm_on_attach(int32_t enabled);
+
+/**
+ * 映像取得を開始してから最初のフレームを受け取るまでに掛かった時間を取得
+ * プレビューはaandusbが直接Surfaceへ描画するので録画用Surfaceへ最初のフレームを書き込むまでの時間
+ * @param device_id
+ * @return 0以上: 時間[マイクロ秒](最初のフレームを受け取っていなければ0), 負: エラーコード
+ */
+EXTERN_C
+int64_t get_time_to_first_frame_us(int32_t device_id);
+
+/**
+ * 映像処理スレッドのスレッドポリシー(CPUアフィニティ/nice値/SCHED_FIFO)をセットする
+ * 映像取得/録画スレッドは次のフレームから適用する, UVC機器を開く前にセットしてもよい
+ * @param device_id UVC機器の識別子, -1なら複数UVC機器で共有するタスクプールのワーカースレッド
+ * @param policy
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t set_thread_policy(int32_t device_id, const flutter_thread_policy_t *policy);
+
+/**
+ * 実行中の映像処理スレッドの統計情報を取得する
+ * @param device_id UVC機器の識別子, -1なら複数UVC機器で共有するタスクプールのワーカースレッド
+ * @param stats_out 統計情報を書き込むバッファ
+ * @param max_stats stats_outの要素数
+ * @return 0以上: 書き込んだ統計情報の数, 負: エラーコード
+ */
+EXTERN_C
+int32_t get_thread_stats(int32_t device_id, flutter_thread_stats_t *stats_out, int32_t max_stats);
+
+/**
+ * 機器側PTSからCLOCK_MONOTONICへのクロックモデルの推定結果と到着時刻の揺らぎを取得する
+ * 録画中に録画用Surfaceへ書き込んだフレームから推定する
+ * @param device_id
+ * @param stats_out
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t get_clock_stats(int32_t device_id, flutter_clock_stats_t *stats_out);
+
+/**
+ * 撮影からパイプラインの段階へフレームが届くまでの遅延の測定を有効/無効にする
+ * 映像ソースがフレームへ遅延測定用のスタンプ(シーケンス番号と撮影時刻)を埋め込んでいる時のみ測定できる
+ * 有効/無効を切り替えると集計結果を破棄する
+ * @param device_id
+ * @param enabled 0: 無効, それ以外: 有効
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t set_latency_probe(int32_t device_id, int32_t enabled);
+
+/**
+ * 映像の一部だけを録画する
+ * 録画用Surfaceのサイズは次のフレームから切り取る範囲のサイズになる
+ * @param device_id
+ * @param x 切り取る範囲の左端(映像の画素単位)
+ * @param y 切り取る範囲の上端(映像の画素単位)
+ * @param width 切り取る範囲の幅, 幅か高さが0なら映像全体を録画する
+ * @param height 切り取る範囲の高さ
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t set_recording_crop(int32_t device_id, int32_t x, int32_t y, int32_t width, int32_t height);
+
+/**
+ * 録画する映像を回転/反転する
+ * 切り出した範囲(set_recording_crop)を回転/反転して録画する
+ * 録画用Surfaceのサイズは次のフレームから回転後のサイズになる
+ * @param device_id
+ * @param rotation 時計回りの回転角度, 0/90/180/270
+ * @param mirror_h 0: 左右反転しない, それ以外: 左右反転する
+ * @param mirror_v 0: 上下反転しない, それ以外: 上下反転する
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t set_recording_orientation(int32_t device_id, int32_t rotation, int32_t mirror_h, int32_t mirror_v);
+
+/**
+ * 次のフレームを静止画(JPEG)としてワーカースレッドで撮影する
+ * MJPEGはデコードせずにカメラが送ってきたJPEGをそのまま使う(ハフマンテーブルが無ければ標準のものを追加する)
+ * 非圧縮フォーマットはJPEGへ圧縮する
+ * 完了すると"on_still_captured"イベントをDartへ送信する
+ * @param device_id
+ * @param path 書き込み先のファイルパス, nullptrまたは空文字列ならJPEGデータをイベントで送る
+ * @return 0: 撮影を開始した, 負: エラーコード
+ */
+EXTERN_C
+int32_t capture_still(int32_t device_id, const char *path);
+
+/**
+ * 連続したフレームをワーカースレッドで撮影する
+ * 撮影開始前にすべてのスロットを確保するので撮影中はメモリを確保しない
+ * 完了すると"on_burst_captured"イベントでフレーム毎のPTSとデータをまとめてDartへ送信する
+ * @param device_id
+ * @param count 撮影するフレーム数(1〜60)
+ * @param encode 0以外ならすべて揃ってから並列にJPEGへ圧縮する, 0ならカメラ(録画中はRGBX)のフォーマットのまま
+ * @return 0: 撮影を開始した, 負: エラーコード
+ */
+EXTERN_C
+int32_t capture_burst(int32_t device_id, int32_t count, int32_t encode);
+
+/**
+ * 動き検出を開始/停止する
+ * 映像を格子状に区切って前のフレームとの輝度の差分から動きを検出し,
+ * 動きの有無が切り替わると"on_motion"イベントをDartへ送信する
+ * config->gate_recordingが0以外なら動きが無い間は録画用Surfaceへ書き込まない
+ * @param device_id
+ * @param config 動き検出の設定, nullptrなら停止する
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t set_motion_detection(int32_t device_id, const flutter_motion_config_t *config);
+
+/**
+ * 前のフレームと同じフレームを録画用Surfaceへ書き込まないようにする
+ * 書き込まなかった間はエンコーダーが前のフレームを繰り返す
+ * MJPEGはフレーム全体を, 非圧縮フォーマットはsample_rows行ごとの行だけを比較する
+ * 有効/無効を切り替えると統計情報を破棄する
+ * @param device_id
+ * @param enabled 0: 無効, それ以外: 有効
+ * @param sample_rows 比較する行の間隔(1〜64), 1なら全ての行
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t set_frame_dedup(int32_t device_id, int32_t enabled, int32_t sample_rows);
+
+/**
+ * 重複フレームの検出の統計情報を取得する
+ * @param device_id
+ * @param stats_out
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t get_dedup_stats(int32_t device_id, flutter_dedup_stats_t *stats_out);
+
+/**
+ * エンコーダーの処理待ちや書き込みの停滞に合わせて録画のビットレートとフレームレートを下げる
+ * 処理待ちが減ったらフレームレート, ビットレートの順に1段階ずつ戻す
+ * 変更するとログへ出力し, get_rate_decisionsで取得できる
+ * 設定すると制御状態と統計情報を破棄する
+ * @param device_id
+ * @param config 制御の設定, nullptrなら停止する(ビットレートはそのまま)
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t set_rate_control(int32_t device_id, const flutter_rate_control_config_t *config);
+
+/**
+ * ビットレート/フレームレート制御の集計結果を取得する
+ * @param device_id
+ * @param stats_out
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t get_rate_control_stats(int32_t device_id, flutter_rate_control_stats_t *stats_out);
+
+/**
+ * 最近のビットレート/フレームレートの変更を古い順に取得する
+ * @param device_id
+ * @param decisions_out 変更を書き込むバッファ
+ * @param max_decisions decisions_outの要素数, 最大FLUTTER_RATE_MAX_DECISIONS個
+ * @return 0以上: 書き込んだ変更の数, 負: エラーコード
+ */
+EXTERN_C
+int32_t get_rate_decisions(int32_t device_id, flutter_rate_decision_t *decisions_out, int32_t max_decisions);
+
+/**
+ * 撮影からパイプラインの段階へフレームが届くまでの遅延の集計結果を取得する
+ * 1フレームも届いていない段階は返さない
+ * @param device_id
+ * @param stats_out 集計結果を書き込むバッファ
+ * @param max_stats stats_outの要素数
+ * @return 0以上: 書き込んだ集計結果の数, 負: エラーコード
+ */
+EXTERN_C
+int32_t get_latency_stats(int32_t device_id, flutter_latency_stats_t *stats_out, int32_t max_stats);
+
+/**
+ * 対応解像度一覧/UVCコントロール一覧の取得が完了しているかどうか
+ * UVC機器接続時にワーカースレッドで取得を開始し
+ * 完了すると"on_capabilities_ready"イベントをDartへ送信する
+ * @param device_id
+ * @return 1: 取得完了, 0: 取得中, 負: エラーコード
+ */
+EXTERN_C
+int32_t is_capabilities_ready(int32_t device_id);
 
 /**
  * コントロール機能でサポートしている機能を取得
@@ -126,7 +823,24 @@ int32_t get_ctrl_value(int32_t device_id, uint64_t type, int32_t *value);
 EXTERN_C
 int32_t get_supported_size(
 	int32_t device_id,
-	int32_t index, int32_t *num_supported, uvc_video_size_t *data);
+	int32_t index, int32_t *num_supported, flutter_video_size_t *data);
+
+/**
+ * 接続中の複数のUVC機器がUSBの帯域内に収まるように映像設定を計画する
+ * 各UVC機器の対応解像度一覧から要求を満たし帯域内に収まる組み合わせのうち
+ * 処理負荷が最も小さいもの(非圧縮フォーマット優先)を選択する
+ * @param requests UVC機器毎の要求
+ * @param num_requests requestsの要素数
+ * @param bus_bandwidth USBバスの帯域[バイト/秒], 0ならUSB2.0の周期転送の帯域
+ * @param apply 0以外なら計画した映像設定を適用する
+ * @param plan_out 計画した映像設定を書き込むバッファ, num_requests個以上の要素が必要
+ * @return 0: 成功, 負: エラーコード
+ */
+EXTERN_C
+int32_t plan_video_sizes(
+	flutter_bandwidth_request_t *requests, int32_t num_requests,
+	uint64_t bus_bandwidth, int32_t apply,
+	flutter_bandwidth_plan_t *plan_out);
 
 /**
  * 映像取得用のsurfaceをセットする
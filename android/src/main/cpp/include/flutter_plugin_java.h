@@ -21,8 +21,20 @@
 // 標準ライブラリ
 #include <mutex>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
 #include <jni.h>
+// flutter
+#include "flutter_plugin.h"
+#include "flutter_bandwidth_planner.h"
+#include "flutter_clock_model.h"
+#include "flutter_frame_crop.h"
+#include "flutter_frame_dedup.h"
+#include "flutter_latency_probe.h"
+#include "flutter_motion_detector.h"
+#include "flutter_rate_controller.h"
+#include "flutter_consumer_registry.h"
 
 //--------------------------------------------------------------------------------
 // 外部クラスの前方宣言
@@ -49,6 +61,10 @@ namespace serenegiant::flutter
 		 * UVC機器のidとUVCHolderSpのペアを保持
 		 */
 		std::unordered_map<int32_t, std::shared_ptr<FlutterUVCHolder>> holders;
+		/**
+		 * UVC機器が接続された時に映像取得開始後の最初のフレームまでの処理を前もって行うかどうか
+		 */
+		bool m_prewarm_on_attach;
 
 		/**
 		 * 使用中のＵＶＣ機器があれば終了させる
@@ -133,18 +149,226 @@ namespace serenegiant::flutter
 		 * @param frame_type
 		 * @param width
 		 * @param height
+		 * @param fps 要求するフレームレート, 0以下なら範囲内で最大のフレームレート
+		 * @param min_fps 最小フレームレート, 0以下なら制限なし
+		 * @param max_fps 最大フレームレート, 0以下なら制限なし
 		 * @return
 		 */
 		int32_t set_video_size(const int32_t &device_id,
 							   const uvc_raw_frame_t &frame_type,
-							   const uint32_t &width, const uint32_t &height);
+							   const uint32_t &width, const uint32_t &height,
+							   const float &fps = 0.0f, const float &min_fps = 0.0f, const float &max_fps = 0.0f);
 		/**
 		 * 現在の映像サイズ設定を取得
 		 * @param device_id
 		 * @param data 映像サイズ設定を書き込むためのflutter_video_size_t構造体へのポインタ
 		 * @return 0: 成功, 負: エラーコード
 		 */
-		int get_current_size(const int &device_id, uvc_video_size_t *data);
+		int get_current_size(const int &device_id, flutter_video_size_t *data);
+		/**
+		 * 接続中の複数のUVC機器がUSBの帯域内に収まるように映像設定を計画する
+		 * 対応解像度一覧の取得完了を待つことがあるのでUIスレッドから呼ばないこと
+		 * @param requirements UVC機器毎の要求
+		 * @param bus_bandwidth USBバスの帯域[バイト/秒], 0ならUSB2.0の周期転送の帯域
+		 * @param apply trueなら計画した映像設定をset_video_sizeで適用する
+		 * @param result 計画した映像設定を受け取るvector, requirementsと同じ順
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int plan_video_sizes(
+			const std::vector<bandwidth_requirement_t> &requirements,
+			const uint64_t &bus_bandwidth, const bool &apply,
+			std::vector<bandwidth_assignment_t> &result);
+		/**
+		 * set_video_sizeで選択したフレームレートを取得
+		 * @param device_id
+		 * @return フレームレート, 未選択/エラー時は0
+		 */
+		float get_current_fps(const int32_t &device_id);
+		/**
+		 * uvc_get_frameで受け取った映像フレームのファイルへの記録を開始する
+		 * @param device_id
+		 * @param path 記録ファイルのパス, 既存のファイルは上書きする
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int start_frame_capture(const int32_t &device_id, const std::string &path);
+		/**
+		 * 映像フレームの記録を終了する
+		 * @param device_id
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int stop_frame_capture(const int32_t &device_id);
+		/**
+		 * 映像の消費者を登録する
+		 * 消費者がいなくて映像取得を一時停止していればすぐに再開する
+		 * @param device_id
+		 * @param type
+		 * @return 0以上: 登録後のその種類の消費者の数, 負: エラーコード
+		 */
+		int acquire_consumer(const int32_t &device_id, const consumer_type_t &type);
+		/**
+		 * acquire_consumerで登録した映像の消費者を解除する
+		 * @param device_id
+		 * @param type
+		 * @return 0以上: 解除後のその種類の消費者の数, 負: エラーコード
+		 */
+		int release_consumer(const int32_t &device_id, const consumer_type_t &type);
+		/**
+		 * 消費者がいなくなってから映像取得を一時停止するまでの猶予時間をセットする
+		 * @param device_id
+		 * @param timeout_ms 猶予時間[ミリ秒], 負なら一時停止しない
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int set_idle_timeout(const int32_t &device_id, const int64_t &timeout_ms);
+		/**
+		 * ヘッドレスモードを切り替える
+		 * ヘッドレスモード中はプレビューのための変換/描画を行わず録画だけを継続する
+		 * @param device_id
+		 * @param headless
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int set_headless(const int32_t &device_id, const bool &headless);
+		/**
+		 * 最後に映像取得中に映像サイズを変更した時に映像取得を再開するまでに掛かった時間を取得
+		 * @param device_id
+		 * @param latency_ns 切り替え時間[ナノ秒], 映像取得中に変更していなければ0
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int get_switch_latency(const int32_t &device_id, int64_t &latency_ns);
+		/**
+		 * UVC機器が接続された時に映像取得開始後の最初のフレームまでの処理を前もって行うかどうかをセットする
+		 * trueにした時に既に接続されているUVC機器も事前準備する
+		 * @param prewarm
+		 */
+		void set_prewarm_on_attach(const bool &prewarm);
+		/**
+		 * 映像取得を開始してから最初のフレームを受け取るまでに掛かった時間を取得
+		 * @param device_id
+		 * @param time_ns 時間[ナノ秒], 最初のフレームを受け取っていなければ0
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int get_time_to_first_frame(const int32_t &device_id, int64_t &time_ns);
+		/**
+		 * クロックモデルの推定結果と到着時刻の揺らぎを取得
+		 * @param device_id
+		 * @param stats
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int get_clock_stats(const int32_t &device_id, clock_stats_t &stats);
+		/**
+		 * 撮影からパイプラインの段階へフレームが届くまでの遅延の測定を有効/無効にする
+		 * @param device_id
+		 * @param enabled
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int set_latency_probe(const int32_t &device_id, const bool &enabled);
+		/**
+		 * 映像の一部だけを録画する
+		 * @param device_id
+		 * @param crop 録画する範囲(映像の画素単位), 空なら映像全体
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int set_recording_crop(const int32_t &device_id, const FrameRect &crop);
+		/**
+		 * 録画する映像を回転/反転する
+		 * @param device_id
+		 * @param orientation 時計回りの回転角度(0/90/180/270)と左右/上下反転
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int set_recording_orientation(const int32_t &device_id, const FrameOrientation &orientation);
+		/**
+		 * 次のフレームを静止画(JPEG)としてワーカースレッドで撮影する
+		 * 完了すると"on_still_captured"イベントをDartへ送信する
+		 * @param device_id
+		 * @param path 書き込み先のファイルパス, 空ならJPEGデータをイベントで送る
+		 * @return 0: 撮影を開始した, 負: エラーコード
+		 */
+		int capture_still(const int32_t &device_id, const std::string &path);
+		/**
+		 * 連続したフレームをワーカースレッドで撮影する
+		 * 完了すると"on_burst_captured"イベントをDartへ送信する
+		 * @param device_id
+		 * @param count 撮影するフレーム数
+		 * @param encode trueならJPEGへ圧縮する
+		 * @return 0: 撮影を開始した, 負: エラーコード
+		 */
+		int capture_burst(const int32_t &device_id, const uint32_t &count, const bool &encode);
+		/**
+		 * 動き検出を開始/停止する
+		 * 動きの有無が切り替わると"on_motion"イベントをDartへ送信する
+		 * @param device_id
+		 * @param enabled
+		 * @param config 動き検出の設定, 停止時は使わない
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int set_motion_detection(const int32_t &device_id, const bool &enabled, const MotionConfig &config);
+		/**
+		 * 前のフレームと同じフレームを録画用Surfaceへ書き込まないようにする
+		 * @param device_id
+		 * @param enabled
+		 * @param sample_rows 比較する行の間隔, 1なら全ての行
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int set_frame_dedup(const int32_t &device_id, const bool &enabled, const uint32_t &sample_rows);
+		/**
+		 * 重複フレームの検出の統計情報を取得
+		 * @param device_id
+		 * @param stats
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int get_dedup_stats(const int32_t &device_id, DedupStats &stats);
+		/**
+		 * 録画用Surfaceへ書き込まなかった間にエンコーダーが前のフレームを繰り返すべきかどうか
+		 * @param device_id
+		 * @return
+		 */
+		bool repeats_frames(const int32_t &device_id);
+		/**
+		 * エンコーダーの処理待ちや書き込みの停滞に合わせてビットレートとフレームレートを下げる
+		 * @param device_id
+		 * @param enabled
+		 * @param config
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int set_rate_control(const int32_t &device_id, const bool &enabled, const RateControlConfig &config);
+		/**
+		 * エンコーダーの録画開始からの累計を報告する
+		 * @param device_id
+		 * @param encoded_frames エンコードしたフレーム数
+		 * @param output_bytes エンコードしたバイト数
+		 * @param stall_us 書き込みが停滞した時間[マイクロ秒]
+		 * @param bitrate エンコーダーの現在のビットレート
+		 * @return 正: エンコーダーに設定するビットレート, 0: 変更なし, 負: エラーコード
+		 */
+		int report_encoder_stats(const int32_t &device_id,
+			const uint64_t &encoded_frames, const uint64_t &output_bytes,
+			const uint64_t &stall_us, const uint32_t &bitrate);
+		/**
+		 * ビットレート/フレームレート制御の集計結果を取得
+		 * @param device_id
+		 * @param stats
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int get_rate_control_stats(const int32_t &device_id, RateControlStats &stats);
+		/**
+		 * 最近のビットレート/フレームレートの変更を古い順に取得
+		 * @param device_id
+		 * @param decisions
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int get_rate_decisions(const int32_t &device_id, std::vector<RateDecision> &decisions);
+		/**
+		 * 撮影からパイプラインの段階へフレームが届くまでの遅延の集計結果を取得
+		 * @param device_id
+		 * @param stats 段階(latency_stage_t)毎の集計結果
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int get_latency_stats(const int32_t &device_id, std::vector<latency_stats_t> &stats);
+		/**
+		 * 対応解像度一覧/UVCコントロール一覧の取得が完了しているかどうか
+		 * @param device_id
+		 * @return 1: 取得完了, 0: 取得中, 負: エラーコード
+		 */
+		int32_t is_capabilities_ready(const int32_t &device_id);
 		/**
 		 * 映像取得用のSurfaceをセットする
 		 * @param device_id
@@ -209,7 +433,7 @@ namespace serenegiant::flutter
 		 * @param data 映像サイズ設定を書き込むためのflutter_video_size_t構造体へのポインタ
 		 * @return 0: 成功, 負: エラーコード
 		 */
-		int get_supported_size(const int &device_id, const int32_t &index, int32_t *num_supported, uvc_video_size_t *data);
+		int get_supported_size(const int &device_id, const int32_t &index, int32_t *num_supported, flutter_video_size_t *data);
 	};
 
 	typedef std::shared_ptr<FlutterPluginJava> FlutterPluginJavaSp;
@@ -0,0 +1,218 @@
+/**
+ * Flutter Rate Controller
+ *
+ * Keeps the recording latency bounded when the encoder or the storage falls
+ * behind. The encoder reports how many frames it has encoded, how many
+ * bytes it has produced and how long writing them blocked. The controller
+ * compares the encoded frames with the frames posted to the encoder's input
+ * surface to get the input queue depth. A growing queue or blocked writes
+ * lower the bitrate first and then decimate the frames posted to the
+ * encoder. The bitrate is lowered from what the encoder actually outputs
+ * when that is below its setting. Once the queue has been short for a while
+ * the decimation and then the bitrate are restored step by step, the
+ * bitrate only while the encoder uses most of it. Every decision is kept
+ * for the metrics.
+ *
+ * The encoder itself lives on the Java side (MediaCodec with an input
+ * surface), the controller only returns the bitrate to apply.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#ifndef FLUTTER_RATE_CONTROLLER_H
+#define FLUTTER_RATE_CONTROLLER_H
+
+// Standard C/C++ headers
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace serenegiant::flutter {
+
+/**
+ * Highest frame decimation, one of every n frames is encoded
+ */
+#define RATE_MAX_DECIMATION (8)
+/**
+ * Number of decisions kept for the metrics
+ */
+#define RATE_MAX_DECISIONS (32)
+
+/**
+ * Share of the bitrate (permille) the encoder has to output before the
+ * bitrate is raised again, a static scene does not need a higher one
+ */
+#define RATE_MIN_OUTPUT_PERMILLE (500)
+
+/**
+ * Rate control settings
+ */
+struct RateControlConfig {
+  // Bitrate range in bits per second, max_bitrate 0 uses the encoder's
+  // bitrate at its first report
+  uint32_t min_bitrate = 500000;
+  uint32_t max_bitrate = 0;
+  // Frames waiting in the encoder that count as caught up and as falling
+  // behind
+  uint32_t target_queue_depth = 2;
+  uint32_t max_queue_depth = 6;
+  // Highest decimation, 1..RATE_MAX_DECIMATION, 1 never drops frames
+  uint32_t max_decimation = 4;
+  // Share of the time (1..1000 permille) blocked writing the output that
+  // counts as a storage stall
+  uint32_t stall_permille = 200;
+  // Minimum time between two decisions, at least 1
+  uint32_t interval_ms = 500;
+  // Calm intervals in a row before one step is restored
+  uint32_t recover_intervals = 4;
+};
+
+/**
+ * Cumulative encoder counters since the recording started
+ */
+struct EncoderSample {
+  // Monotonic time of the report
+  int64_t time_us;
+  // Frames the encoder has output
+  uint64_t encoded_frames;
+  // Bytes the encoder has output
+  uint64_t output_bytes;
+  // Time writing the output blocked for longer than a frame interval
+  uint64_t stall_us;
+  // Bitrate the encoder is running at
+  uint32_t bitrate;
+};
+
+/**
+ * Why the controller changed the rate
+ */
+enum class RateReason : uint32_t {
+  // The input queue grew beyond max_queue_depth
+  EncoderBacklog = 0,
+  // Writing the output blocked for too long
+  StorageStall = 1,
+  // The queue stayed short, one step restored
+  Recovered = 2,
+};
+
+/**
+ * One change of the bitrate and/or the decimation
+ */
+struct RateDecision {
+  int64_t time_us;
+  RateReason reason;
+  uint32_t old_bitrate;
+  uint32_t bitrate;
+  uint32_t old_decimation;
+  uint32_t decimation;
+  // Measurements that led to the decision
+  uint32_t queue_depth;
+  uint64_t output_bps;
+  uint32_t stall_permille;
+};
+
+/**
+ * Rate control statistics
+ */
+struct RateControlStats {
+  // Encoder reports that were evaluated
+  uint64_t updates;
+  uint64_t decisions;
+  uint64_t bitrate_decreases;
+  uint64_t bitrate_increases;
+  uint64_t decimation_increases;
+  uint64_t decimation_decreases;
+  // Frames not posted to the encoder because of the decimation
+  uint64_t dropped_frames;
+  // Current state
+  uint32_t bitrate;
+  uint32_t decimation;
+  // Last and highest measured values
+  uint32_t queue_depth;
+  uint32_t max_queue_depth;
+  uint64_t output_bps;
+  uint32_t stall_permille;
+};
+
+/**
+ * Rate controller of one recording
+ * dropFrame/framePosted are called from the recording thread only,
+ * update from the encoder's thread, everything else from any thread.
+ */
+class RateController {
+public:
+  RateController() = default;
+
+  // Disable copy
+  RateController(const RateController &) = delete;
+  RateController &operator=(const RateController &) = delete;
+
+  /**
+   * Enable or disable the rate control, the statistics are cleared
+   * Disabling restores full frame rate, the bitrate stays where it is.
+   * @return 0 on success, -EINVAL for settings out of range
+   */
+  int configure(bool enabled, const RateControlConfig &config);
+
+  bool enabled() const { return m_enabled.load(); }
+
+  /**
+   * Start over for a new recording (new encoder), keeps the settings
+   */
+  void reset();
+
+  /**
+   * Whether the recording thread should skip this frame
+   */
+  bool dropFrame();
+
+  /**
+   * A frame was posted to the encoder's input surface
+   */
+  void framePosted() { m_posted++; }
+
+  /**
+   * Evaluate an encoder report
+   * @return Bitrate the encoder should switch to, 0 to keep its bitrate
+   */
+  uint32_t update(const EncoderSample &sample);
+
+  void getStats(RateControlStats &stats) const;
+
+  /**
+   * Recent decisions, oldest first
+   */
+  void getDecisions(std::vector<RateDecision> &decisions) const;
+
+private:
+  void resetLocked();
+
+  mutable std::mutex m_lock;
+  RateControlConfig m_config;
+  std::atomic<bool> m_enabled{false};
+  std::atomic<uint32_t> m_decimation{1};
+  std::atomic<uint64_t> m_posted{0};
+  std::atomic<uint64_t> m_dropped{0};
+  // Recording thread only
+  uint32_t m_phase = 0;
+  // Bitrate range and current bitrate, 0 until the first report
+  uint32_t m_bitrate = 0;
+  uint32_t m_min_bitrate = 0;
+  uint32_t m_max_bitrate = 0;
+  // Previous evaluated report
+  bool m_has_last = false;
+  EncoderSample m_last{};
+  // Frames the encoder output beyond the posted ones (repeated frames)
+  uint64_t m_encoded_offset = 0;
+  uint32_t m_calm = 0;
+  RateControlStats m_stats{};
+  std::vector<RateDecision> m_decisions;
+  size_t m_next_decision = 0;
+};
+
+} // namespace serenegiant::flutter
+
+#endif // FLUTTER_RATE_CONTROLLER_H
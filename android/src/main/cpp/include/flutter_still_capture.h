@@ -0,0 +1,112 @@
+/**
+ * Flutter Still Capture
+ *
+ * Turns one frame of the stream into a JPEG still. MJPEG cameras already
+ * deliver JPEG, so their frame is handed out byte-for-byte instead of being
+ * decoded and encoded again. Many UVC cameras leave the Huffman tables (DHT)
+ * out of their MJPEG frames and rely on the standard tables of the JPEG
+ * specification (Annex K.3), which general purpose viewers do not assume;
+ * those tables are inserted in front of the scan. Uncompressed frames are
+ * converted to RGBA and encoded with libjpeg-turbo.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#ifndef FLUTTER_STILL_CAPTURE_H
+#define FLUTTER_STILL_CAPTURE_H
+
+// Standard C/C++ headers
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// libjpeg-turbo
+#include <cstdio>
+#include "jpeglib.h"
+
+namespace serenegiant::flutter {
+
+/**
+ * JPEG quality of stills encoded from uncompressed frames
+ */
+#define STILL_JPEG_QUALITY (90)
+
+/**
+ * Whether a JPEG defines Huffman tables (DHT) before its first scan
+ * @return false when the data is not a JPEG or has no DHT segment
+ */
+bool jpegHasHuffmanTables(const uint8_t *jpeg, size_t len);
+
+/**
+ * Make a MJPEG frame a complete JPEG file
+ * The frame is copied up to its EOI marker, anything after it (padding some
+ * cameras add to the payload) is dropped. When the frame has no DHT segment
+ * the standard Huffman tables are inserted in front of the first scan. All
+ * other bytes are copied unchanged.
+ * @param jpeg Output, replaced
+ * @return 0 on success, -EINVAL when the frame does not start with SOI or has
+ *         no scan, -ENODATA when the scan is truncated (no EOI)
+ */
+int completeJpeg(const uint8_t *frame, size_t len, std::vector<uint8_t> &jpeg);
+
+/**
+ * Uncompressed frame to JPEG encoder
+ * Not thread safe, use one instance per thread.
+ */
+class JpegEncoder {
+public:
+  explicit JpegEncoder(int quality = STILL_JPEG_QUALITY);
+  ~JpegEncoder();
+
+  // Disable copy
+  JpegEncoder(const JpegEncoder &) = delete;
+  JpegEncoder &operator=(const JpegEncoder &) = delete;
+
+  /**
+   * Encode an uncompressed frame
+   * @param frame_type uvc_raw_frame_t of the frame, any format convertToRgba
+   *        accepts
+   * @param jpeg Output, replaced
+   * @return 0 on success, -EINVAL for unsupported formats, -ENOSPC when src
+   *         is shorter than one frame, -EIO when libjpeg fails
+   */
+  int encode(uint32_t frame_type, const uint8_t *src, size_t src_len,
+             uint32_t width, uint32_t height, std::vector<uint8_t> &jpeg);
+
+private:
+  struct ErrorManager {
+    jpeg_error_mgr pub;
+    void *jmp_buf_ptr;
+  };
+
+  const int m_quality;
+  jpeg_compress_struct m_cinfo;
+  ErrorManager m_jerr;
+  std::vector<uint8_t> m_rgba;
+
+  static void onError(j_common_ptr cinfo);
+};
+
+/**
+ * Make a JPEG still from a frame fetched with RAW_FRAME_UNKNOWN
+ * MJPEG frames go through completeJpeg, uncompressed frames are encoded.
+ * @return 0 on success, -ENOTSUP for other compressed formats (H.264, ...),
+ *         otherwise the error of completeJpeg or JpegEncoder::encode
+ */
+int makeStillJpeg(uint32_t frame_type, const uint8_t *frame, size_t len,
+                  uint32_t width, uint32_t height, JpegEncoder &encoder,
+                  std::vector<uint8_t> &jpeg);
+
+/**
+ * Write a still to a file, an existing file is overwritten
+ * The data goes to a temporary file next to path which is renamed once it
+ * is complete, so a reader never sees a partial JPEG.
+ * @return 0 on success, negative errno on error
+ */
+int writeStillFile(const std::string &path, const std::vector<uint8_t> &jpeg);
+
+} // namespace serenegiant::flutter
+
+#endif // FLUTTER_STILL_CAPTURE_H
@@ -0,0 +1,254 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef AANDUSB_FLUTTER_TASK_POOL_H
+#define AANDUSB_FLUTTER_TASK_POOL_H
+
+// 標準ライブラリ
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace serenegiant::flutter
+{
+
+	/**
+	 * タスクの優先度, 値が小さいほど優先する
+	 */
+	typedef enum task_priority {
+		TASK_PRIORITY_RECORDING = 0,	// 録画
+		TASK_PRIORITY_PREVIEW,			// プレビュー
+		TASK_PRIORITY_ANALYSIS,			// 映像解析(フレームコールバック)
+		TASK_PRIORITY_NUM,
+	} task_priority_t;
+
+	/**
+	 * 優先度毎のキューの統計情報
+	 */
+	typedef struct task_queue_metrics {
+		/**
+		 * 投入したタスク数
+		 */
+		uint64_t submitted;
+		/**
+		 * 実行を開始したタスク数
+		 */
+		uint64_t executed;
+		/**
+		 * 現在キューに入っているタスク数
+		 */
+		uint32_t queued;
+		/**
+		 * キューに入っていたタスク数の最大値
+		 */
+		uint32_t max_queued;
+		/**
+		 * 投入から実行開始までの待ち時間の合計[ナノ秒]
+		 */
+		uint64_t total_wait_ns;
+		/**
+		 * 投入から実行開始までの待ち時間の最大値[ナノ秒]
+		 */
+		uint64_t max_wait_ns;
+	} task_queue_metrics_t;
+
+	/**
+	 * タスクプールの統計情報
+	 */
+	typedef struct task_pool_metrics {
+		/**
+		 * ワーカースレッド数
+		 */
+		uint32_t num_workers;
+		/**
+		 * 他のワーカースレッドのキューから盗んで実行したタスク数
+		 */
+		uint64_t stolen;
+		task_queue_metrics_t queues[TASK_PRIORITY_NUM];
+	} task_pool_metrics_t;
+
+	typedef std::function<void()> Task;
+
+	/**
+	 * 複数のUVC機器の映像処理(デコード/色変換/拡大縮小/描画)で共有するワークスティーリングスレッドプール
+	 * UVC機器毎に専用スレッドで処理すると機器の数だけスレッドが増えて少数のコアを奪い合うので
+	 * コア数分のワーカースレッドへタスクとして投入する
+	 *
+	 * ・外部スレッドから投入したタスクは優先度毎のキューへ入れて, 同じ優先度の中では
+	 *   UVC機器毎にラウンドロビンで取り出す(1台が大量に投入しても他の機器が待たされない)
+	 * ・ワーカースレッド内から投入したタスク(タスクの分割)はそのワーカースレッドのキューへ入れて
+	 *   手の空いたワーカースレッドが盗んで実行する
+	 * ・TaskGroup::waitで待機中のスレッドはそのTaskGroupのタスクだけを実行する
+	 *   (待機中にデッドロックせず, 他のUVC機器や解析のタスクに待たされない)
+	 */
+	class TaskPool
+	{
+	private:
+		struct task_item {
+			Task task;
+			int32_t device_id;
+			task_priority_t priority;
+			int64_t queued_ns;
+		};
+		/**
+		 * UVC機器毎のキュー
+		 */
+		struct device_queue {
+			std::deque<task_item> tasks[TASK_PRIORITY_NUM];
+			task_queue_metrics_t metrics[TASK_PRIORITY_NUM];
+		};
+		/**
+		 * ワーカースレッド毎のキュー
+		 * 自分は末尾から(LIFO), 他のワーカースレッドは先頭から(FIFO)取り出す
+		 */
+		struct worker {
+			std::mutex lock;
+			std::deque<task_item> tasks;
+			std::thread thread;
+		};
+
+		mutable std::mutex m_lock;
+		std::condition_variable m_cond;
+		std::vector<std::unique_ptr<worker>> m_workers;
+		/**
+		 * UVC機器毎のキュー, m_lockで保護
+		 */
+		std::unordered_map<int32_t, device_queue> m_devices;
+		/**
+		 * 優先度毎のタスクがあるUVC機器のラウンドロビン順, m_lockで保護
+		 */
+		std::deque<int32_t> m_ready[TASK_PRIORITY_NUM];
+		/**
+		 * 全てのキューに入っているタスク数
+		 */
+		std::atomic<uint32_t> m_pending;
+		task_queue_metrics_t m_metrics[TASK_PRIORITY_NUM];
+		uint64_t m_stolen;
+		/**
+		 * m_lockで保護
+		 */
+		bool m_running;
+
+		void worker_loop(const size_t &ix);
+		/**
+		 * 実行するタスクを1つ取り出す
+		 * 自分のキュー→UVC機器毎のキュー(優先度順, ラウンドロビン)→他のワーカースレッドのキューの順
+		 */
+		bool pop(task_item &item);
+		bool pop_global_locked(task_item &item);
+		void update_queued_locked(const task_item &item);
+		void execute(task_item &item);
+	public:
+		/**
+		 * プロセス全体で共有するタスクプールを取得する
+		 * ワーカースレッド数はCPUのコア数
+		 */
+		static TaskPool &get_instance();
+
+		/**
+		 * コンストラクタ
+		 * @param num_workers ワーカースレッド数, 0ならCPUのコア数
+		 */
+		explicit TaskPool(const size_t &num_workers = 0);
+		~TaskPool();
+
+		TaskPool(const TaskPool &) = delete;
+		TaskPool &operator=(const TaskPool &) = delete;
+
+		/**
+		 * タスクを投入する
+		 * @param device_id 公平性の単位となるUVC機器の識別子
+		 * @param priority
+		 * @param task
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int submit(const int32_t &device_id, const task_priority_t &priority, Task task);
+		/**
+		 * キューに入っているタスクを1つ実行する
+		 * @return タスクを実行したらtrue
+		 */
+		bool run_one();
+		/**
+		 * ワーカースレッド数を取得
+		 */
+		inline size_t num_workers() const { return m_workers.size(); };
+		/**
+		 * 統計情報を取得
+		 * @param metrics
+		 */
+		void get_metrics(task_pool_metrics_t &metrics) const;
+		/**
+		 * UVC機器毎の統計情報を取得
+		 * @param device_id
+		 * @param metrics
+		 * @return 0: 成功, -ENOENT: タスクを投入したことがないUVC機器
+		 */
+		int get_metrics(const int32_t &device_id, task_pool_metrics_t &metrics) const;
+		/**
+		 * UVC機器の統計情報を破棄する
+		 * キューに残っているタスクは実行される
+		 * @param device_id
+		 */
+		void remove_device(const int32_t &device_id);
+	};
+
+	/**
+	 * TaskPoolへ投入した複数のタスクの終了を待つためのヘルパークラス
+	 * 待機中はまだワーカースレッドが取り出していない自分のタスクだけを実行する
+	 */
+	class TaskGroup
+	{
+	private:
+		struct group_item;
+		struct group_state;
+		TaskPool &m_pool;
+		const int32_t m_device_id;
+		/**
+		 * ワーカースレッドのタスクはTaskGroupの破棄後に実行されることがあるので
+		 * TaskGroup本体ではなく共有した状態だけを参照する
+		 */
+		std::shared_ptr<group_state> m_state;
+	public:
+		TaskGroup(TaskPool &pool, const int32_t &device_id);
+		~TaskGroup();
+
+		TaskGroup(const TaskGroup &) = delete;
+		TaskGroup &operator=(const TaskGroup &) = delete;
+
+		/**
+		 * タスクを投入する
+		 * @param priority
+		 * @param task
+		 */
+		void run(const task_priority_t &priority, Task task);
+		/**
+		 * 投入した全てのタスクが終了するまで待つ
+		 */
+		void wait();
+	};
+
+}	// namespace serenegiant::flutter
+
+#endif //AANDUSB_FLUTTER_TASK_POOL_H
@@ -0,0 +1,173 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef AANDUSB_FLUTTER_THREAD_POLICY_H
+#define AANDUSB_FLUTTER_THREAD_POLICY_H
+
+// 標準ライブラリ
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace serenegiant::flutter
+{
+
+	/**
+	 * 共有タスクプール(TaskPool)のワーカースレッドのスレッドポリシーを指定するときのUVC機器の識別子
+	 */
+	#define THREAD_POLICY_POOL (-1)
+	/**
+	 * スレッド名の最大長(終端のnulを含む), pthread_setname_npの制限
+	 */
+	#define THREAD_NAME_LEN (16)
+	/**
+	 * 実行しているCPUとコンテキストスイッチ回数を集計する間隔[ナノ秒]
+	 */
+	#define THREAD_STATS_INTERVAL_NS (100000000LL)
+
+	/**
+	 * 映像処理スレッドのスレッドポリシー
+	 * 全て0なら既定値(全てのCPU, nice値0, SCHED_OTHER)
+	 */
+	typedef struct thread_policy {
+		/**
+		 * 実行するCPUのビットマスク(ビットnがCPU n), 0なら全てのCPU
+		 * big.LITTLE構成でbigコアだけを指定するとLITTLEコアへ移動しなくなる
+		 */
+		uint64_t cpu_mask;
+		/**
+		 * nice値(-20〜19), SCHED_FIFOを使わない時に適用する
+		 */
+		int32_t nice;
+		/**
+		 * SCHED_FIFOの優先度(1〜99), 0ならSCHED_OTHER
+		 * 権限が無くてSCHED_FIFOにできなかった時はnice値を適用する
+		 */
+		int32_t rt_priority;
+	} thread_policy_t;
+
+	/**
+	 * 映像処理スレッドの統計情報
+	 */
+	typedef struct thread_stats {
+		char name[THREAD_NAME_LEN];
+		int32_t device_id;
+		/**
+		 * カーネルのスレッドID
+		 */
+		int32_t tid;
+		/**
+		 * 最後に集計した時に実行していたCPU
+		 */
+		int32_t cpu;
+		/**
+		 * 実際に適用されているスケジューリングポリシー(SCHED_OTHER/SCHED_FIFO)
+		 */
+		int32_t sched_policy;
+		/**
+		 * 最後にスレッドポリシーを適用した結果, 0: 成功, 負: 最初に失敗した設定のエラーコード
+		 */
+		int32_t policy_result;
+		/**
+		 * 統計情報を更新した回数(映像処理スレッドのループ回数)
+		 */
+		uint64_t samples;
+		/**
+		 * 集計の間に実行するCPUが変わっていた回数
+		 * 集計の間(THREAD_STATS_INTERVAL_NS)に複数回移動しても1回と数えるので実際の移動回数以下になる
+		 */
+		uint64_t migrations;
+		/**
+		 * 他のスレッドに横取りされた回数(非自発的コンテキストスイッチ), 最後に集計した時の値
+		 */
+		uint64_t preemptions;
+		/**
+		 * 自発的コンテキストスイッチの回数(待機/ブロック), 最後に集計した時の値
+		 */
+		uint64_t voluntary_switches;
+	} thread_stats_t;
+
+	/**
+	 * UVC機器毎のスレッドポリシーをセットする
+	 * 映像処理スレッドが次にPipelineThread::updateを呼んだ時に適用する
+	 * UVC機器を開く前にセットしておくこともできる
+	 * @param device_id UVC機器の識別子, THREAD_POLICY_POOLならタスクプールのワーカースレッド
+	 * @param policy
+	 * @return 0: 成功, -EINVAL: 範囲外の値
+	 */
+	int set_thread_policy(const int32_t &device_id, const thread_policy_t &policy);
+	/**
+	 * UVC機器毎のスレッドポリシーを取得する
+	 * @param device_id
+	 * @param policy
+	 * @return 0: 成功, -ENOENT: スレッドポリシーをセットしていない
+	 */
+	int get_thread_policy(const int32_t &device_id, thread_policy_t &policy);
+	/**
+	 * UVC機器の実行中の映像処理スレッドの統計情報を取得する
+	 * @param device_id UVC機器の識別子, THREAD_POLICY_POOLならタスクプールのワーカースレッド
+	 * @param stats
+	 */
+	void get_thread_stats(const int32_t &device_id, std::vector<thread_stats_t> &stats);
+
+	/**
+	 * 映像処理スレッドへスレッドポリシーを適用して統計情報を集計するためのヘルパークラス
+	 * 映像処理スレッドの開始時にそのスレッド上で生成し, ループ毎にupdateを呼ぶ
+	 * スレッドポリシーと統計情報の取得(getrusage)は自スレッドにしか使えないので
+	 * 設定したスレッドポリシーは各スレッドがupdateの中で適用する
+	 * updateはループ毎に呼んでも軽くなるように, 実行しているCPUとコンテキストスイッチ回数は
+	 * THREAD_STATS_INTERVAL_NS毎にだけ集計してグローバルなロックを使わずにスレッド毎の統計情報へ書き込む
+	 */
+	class PipelineThread
+	{
+	public:
+		struct record;
+	private:
+		std::shared_ptr<record> m_record;
+		uint64_t m_generation;
+		int32_t m_last_cpu;
+		int64_t m_base_preemptions;
+		int64_t m_base_voluntary;
+		/**
+		 * 次に統計情報を集計する時刻[ナノ秒]
+		 */
+		int64_t m_next_collect_ns;
+		void apply();
+		void collect(const int64_t &now);
+	public:
+		/**
+		 * コンストラクタ
+		 * スレッド名をセットしてスレッドポリシーがあれば適用する
+		 * @param device_id
+		 * @param name スレッド名, THREAD_NAME_LEN - 1文字を超える分は切り捨てる
+		 */
+		PipelineThread(const int32_t &device_id, const char *name);
+		~PipelineThread();
+
+		PipelineThread(const PipelineThread &) = delete;
+		PipelineThread &operator=(const PipelineThread &) = delete;
+
+		/**
+		 * スレッドポリシーが変更されていれば適用して統計情報を更新する
+		 * 前回の集計からTHREAD_STATS_INTERVAL_NS経過していなければループ回数を数えるだけ
+		 */
+		void update();
+	};
+
+}	// namespace serenegiant::flutter
+
+#endif //AANDUSB_FLUTTER_THREAD_POLICY_H
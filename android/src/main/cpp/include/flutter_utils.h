@@ -18,7 +18,11 @@
 #ifndef AANDUSB_FLUTTER_UTILS_H
 #define AANDUSB_FLUTTER_UTILS_H
 
+// 標準ライブラリ
+#include <memory>
+#include <vector>
 // flutter
+#include "flutter_frame_burst.h"
 #include "flutter_plugin.h"
 
 namespace serenegiant::flutter {
@@ -43,6 +47,51 @@ int send_msg_to_flutter(const Char *action, Args * ...args);
  */
 int send_on_device_changed(const int32_t &device_id, const bool &attached);
 
+/**
+ * 対応解像度一覧/UVCコントロール一覧の取得完了イベントをnative portを使ってDartへ送信する
+ * action="on_capabilities_ready"
+ * @param device_id
+ * @param result 0: 成功, 負: エラーコード
+ * @return
+ */
+int send_on_capabilities_ready(const int32_t &device_id, const int32_t &result);
+
+/**
+ * 静止画の撮影完了イベントをnative portを使ってDartへ送信する
+ * action="on_still_captured"
+ * @param device_id
+ * @param result 0: 成功, 負: エラーコード
+ * @param jpeg JPEGデータ, 空ならnullを送る
+ * @return
+ */
+int send_on_still_captured(const int32_t &device_id, const int32_t &result, std::vector<uint8_t> &&jpeg);
+
+/**
+ * 連写の完了イベントをnative portを使ってDartへ送信する
+ * action="on_burst_captured"
+ * 各フレームは[pts_us, frame_type, width, height, data]の配列
+ * dataはコピーせずにburstのスロットを参照し, すべてのフレームがDart側で破棄されるとburstも破棄される
+ * @param device_id
+ * @param result 0: 成功, 負: エラーコード
+ * @param burst 撮影したフレーム, nullptrならnullを送る
+ * @return
+ */
+int send_on_burst_captured(const int32_t &device_id, const int32_t &result, std::shared_ptr<FrameBurst> burst);
+
+/**
+ * 動きの有無が切り替わったイベントをnative portを使ってDartへ送信する
+ * action="on_motion"
+ * @param device_id
+ * @param motion true: 動きを検出した, false: 動きが無くなった
+ * @param changed_cells 切り替わったフレームで閾値を超えた区画の数
+ * @param peak 切り替わったフレームの区画の輝度の差分の平均の最大値
+ * @param pts_us 切り替わったフレームのPTS[マイクロ秒]
+ * @return
+ */
+int send_on_motion(
+	const int32_t &device_id, const bool &motion,
+	const uint32_t &changed_cells, const uint32_t &peak, const int64_t &pts_us);
+
 }	// namespace serenegiant::flutter
 
 #endif //AANDUSB_FLUTTER_UTILS_H
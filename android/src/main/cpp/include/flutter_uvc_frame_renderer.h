@@ -15,6 +15,8 @@
 // Standard C/C++ headers
 #include <atomic>
 #include <functional>
+#include <future>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -25,11 +27,25 @@
 
 // Project headers
 #include "aandusb/aandusb_native.h"
+#include "flutter_clock_model.h"
+#include "flutter_consumer_registry.h"
+#include "flutter_frame_capture.h"
+#include "flutter_frame_converter.h"
+#include "flutter_frame_crop.h"
+#include "flutter_frame_dedup.h"
+#include "flutter_frame_scaler.h"
+#include "flutter_frame_subscription.h"
+#include "flutter_latency_probe.h"
+#include "flutter_mjpeg_decoder.h"
+#include "flutter_task_pool.h"
+#include "flutter_thread_policy.h"
 
 namespace serenegiant::flutter {
 
 /**
  * Callback for notifying when a frame is available
+ * pts_us is the de-jittered CLOCK_MONOTONIC timestamp of the frame in
+ * microseconds (the device PTS mapped through the renderer's clock model).
  */
 using FrameCallback =
     std::function<void(const uint8_t *data, size_t len, uint32_t width,
@@ -53,6 +69,19 @@ public:
   FlutterUvcFrameRenderer(const FlutterUvcFrameRenderer &) = delete;
   FlutterUvcFrameRenderer &operator=(const FlutterUvcFrameRenderer &) = delete;
 
+  /**
+   * Do the first frame setup ahead of start(), e.g. when a device is attached
+   * Negotiates the format with the device, allocates the frame buffers, the
+   * MJPEG decoder and the scaled buffers of the windows already set, sizes
+   * the window buffers and spawns the shared pool workers. A following
+   * start() with the same parameters then only starts streaming.
+   * @param width Video width
+   * @param height Video height
+   * @param frame_type Frame type (MJPEG, YUY2, etc.)
+   * @return 0 on success, -1 if running, -2 if the size is rejected
+   */
+  int prewarm(uint32_t width, uint32_t height, uint32_t frame_type);
+
   /**
    * Start the frame capture and rendering loop
    * @param width Video width
@@ -67,6 +96,25 @@ public:
    */
   void stop();
 
+  /**
+   * Switch resolution and/or format while running
+   * The new buffers and decoder are allocated on the caller thread. The
+   * capture loop swaps them in between two frames and restarts streaming at
+   * the new size; threads, windows and the pool are kept, windows that follow
+   * the camera resolution only get new buffer geometry.
+   * Blocks until the capture loop has switched.
+   * @return 0 on success, -1 if not running, -2 if the size is rejected,
+   *         -3 if streaming could not be restarted
+   */
+  int reconfigure(uint32_t width, uint32_t height, uint32_t frame_type);
+
+  /**
+   * Time from the last reconfigure request to the first frame rendered at
+   * the new size
+   * @return Latency in nanoseconds, 0 if no switch has completed yet
+   */
+  int64_t getSwitchLatencyNs() const { return m_switch_latency_ns; }
+
   /**
    * Check if running
    */
@@ -74,21 +122,159 @@ public:
 
   /**
    * Set the preview window (Flutter texture surface)
+   * The texture is scaled by the compositor, so a small preview widget only
+   * needs a display sized buffer. When width/height are given the preview
+   * buffer has that size; MJPEG frames are decoded with a scaled IDCT to the
+   * smallest size that still covers every consumer and then downscaled.
    * @param window Native window for preview
+   * @param width Preview output width, 0 means camera resolution
+   * @param height Preview output height, 0 means camera resolution
    */
-  void setPreviewWindow(ANativeWindow *window);
+  void setPreviewWindow(ANativeWindow *window, uint32_t width = 0,
+                        uint32_t height = 0);
 
   /**
    * Set the recording window (MediaCodec input surface)
    * @param window Native window for recording
+   * @param width Recording output width, 0 means camera resolution
+   * @param height Recording output height, 0 means camera resolution
+   */
+  void setRecordingWindow(ANativeWindow *window, uint32_t width = 0,
+                          uint32_t height = 0);
+
+  /**
+   * Show only part of the camera frame in the preview
+   * Only the union of the consumers' crops is decoded or converted, MJPEG
+   * frames are cropped inside the decoder before the IDCT. The crop is scaled
+   * to the preview output size, or shown at its decoded size when the
+   * preview follows the camera resolution.
+   * @param crop Region in camera pixels, empty shows the whole frame
+   */
+  void setPreviewCrop(const FrameRect &crop);
+
+  /**
+   * Record only part of the camera frame, see setPreviewCrop
+   * @param crop Region in camera pixels, empty records the whole frame
+   */
+  void setRecordingCrop(const FrameRect &crop);
+
+  /**
+   * Rotate and/or mirror the preview
+   * Applied after the crop, the preview output size is the oriented size.
+   * When the camera delivers uncompressed frames, the orientation of the
+   * recording window (else the preview) is applied by the color conversion
+   * itself; any other orientation is applied while the frame is copied into
+   * the window buffer. Either way no pass is added.
+   * @return 0 on success, -EINVAL if the rotation is not 0, 90, 180 or 270
+   */
+  int setPreviewOrientation(const FrameOrientation &orientation);
+
+  /**
+   * Rotate and/or mirror the recording, see setPreviewOrientation
+   * @return 0 on success, -EINVAL if the rotation is not 0, 90, 180 or 270
+   */
+  int setRecordingOrientation(const FrameOrientation &orientation);
+
+  /**
+   * Switch headless mode, used while the app is in the background
+   * The preview window is kept but nothing is converted, scaled or rendered
+   * for it and its buffers are freed. Recording, the frame callback and the
+   * capture file keep running at full rate.
+   * @param headless true to skip preview work, false to resume it
+   */
+  void setHeadless(bool headless);
+
+  /**
+   * Check if headless mode is on
    */
-  void setRecordingWindow(ANativeWindow *window);
+  bool isHeadless();
 
   /**
    * Set frame callback for additional processing
+   * Shorthand for a raw frame subscription running on the pool, replaces the
+   * previous callback set here.
    */
   void setFrameCallback(FrameCallback callback);
 
+  /**
+   * Add a frame subscriber, safe while streaming
+   * Any subscriber keeps the device streaming as an analysis consumer.
+   * @param options Format, size, rate and execution mode of the subscriber
+   * @param callback Called for each delivered frame, the callable must stay
+   *        valid until unsubscribe() returns
+   * @return Positive subscription id, negative on error
+   */
+  int32_t subscribe(const SubscriberOptions &options,
+                    FrameFunctionRef callback);
+
+  /**
+   * Remove a frame subscriber, safe while streaming
+   * Waits for a running call of the subscriber unless called from it.
+   * @return 0 on success, -ENOENT if the id is unknown
+   */
+  int unsubscribe(int32_t id);
+
+  /**
+   * Get the delivery counters of a subscriber
+   * @return 0 on success, -ENOENT if the id is unknown
+   */
+  int getSubscriberStats(int32_t id, SubscriberStats &stats) const {
+    return m_subscriptions.getStats(id, stats);
+  }
+
+  /**
+   * Record every frame returned by uvc_get_frame into a capture file
+   * @param path Capture file path, overwritten if it exists
+   * @return 0 on success, negative on error
+   */
+  int startCapture(const std::string &path);
+
+  /**
+   * Stop recording and write the capture file index
+   * @return 0 on success, negative on error
+   */
+  int stopCapture();
+
+  /**
+   * Feed frames from a capture file instead of the UVC device
+   * Set before start(); the device is then neither resized nor started.
+   * @param source Replay source, nullptr switches back to the device
+   */
+  void setReplaySource(std::shared_ptr<FrameReplaySource> source);
+
+  /**
+   * Register a consumer other than the windows, frame callback and capture
+   * file, which are counted automatically
+   * Streaming is resumed right away when it was suspended for lack of
+   * consumers.
+   * @return Number of consumers of the type, negative on error
+   */
+  int acquireConsumer(consumer_type_t type);
+
+  /**
+   * Unregister a consumer registered with acquireConsumer
+   * @return Number of consumers of the type, negative on error
+   */
+  int releaseConsumer(consumer_type_t type);
+
+  /**
+   * Set how long the device keeps streaming without any consumer
+   * @param timeout_ms Grace period in milliseconds, negative never suspends
+   */
+  void setIdleTimeout(int64_t timeout_ms);
+
+  /**
+   * Check if streaming is suspended because nobody consumes the frames
+   */
+  bool isSuspended() const { return m_consumers.is_suspended(); }
+
+  /**
+   * Get consumer counts and suspend/resume statistics
+   */
+  void getConsumerMetrics(consumer_metrics_t &metrics) const {
+    m_consumers.get_metrics(metrics);
+  }
+
   /**
    * Get current frame rate (calculated)
    */
@@ -99,6 +285,54 @@ public:
    */
   int64_t getFrameCount() const { return m_frame_count; }
 
+  /**
+   * Time from start() to the first frame handed to a consumer
+   * @return Latency in nanoseconds, 0 until the first frame after start()
+   */
+  int64_t getTimeToFirstFrameNs() const { return m_time_to_first_frame_ns; }
+
+  /**
+   * Get the clock model estimate and the measured arrival jitter
+   */
+  void getClockStats(clock_stats_t &stats) const { m_clock.get_stats(stats); }
+
+  /**
+   * Enable or disable the latency probe, the collected stats are cleared
+   * The source has to embed a latency stamp into its frames (see
+   * synthetic_uvc_config_t::latency_probe), replayed frames are not measured.
+   */
+  void setLatencyProbe(bool enabled) { m_latency.set_enabled(enabled); }
+
+  /**
+   * Get the latency from capture to a pipeline stage
+   */
+  void getLatencyStats(latency_stage_t stage, latency_stats_t &stats) const {
+    m_latency.get_stats(stage, stats);
+  }
+
+  /**
+   * Frames that never reached the pipeline, from gaps in the stamp sequence
+   */
+  uint64_t getLatencyDropped() const { return m_latency.get_dropped(); }
+
+  /**
+   * Skip frames that repeat the previous one, the stats are cleared
+   * A repeated frame is neither decoded nor rendered to the windows, the
+   * recording surface's encoder repeats the last frame it got instead.
+   * Subscribers and the capture file still get every frame.
+   * @param sample_rows Hash every n-th row of uncompressed frames
+   * @return 0 on success, -EINVAL if sample_rows is out of range
+   */
+  int setFrameDedup(bool enabled,
+                    uint32_t sample_rows = DEDUP_DEFAULT_SAMPLE_ROWS) {
+    return m_dedup.configure(enabled, sample_rows);
+  }
+
+  /**
+   * Get the number of checked and skipped frames
+   */
+  void getDedupStats(DedupStats &stats) const { m_dedup.getStats(stats); }
+
 private:
   usb_manager_t *m_manager;
   int32_t m_device_id;
@@ -110,23 +344,126 @@ private:
 
   // State
   std::atomic<bool> m_is_running{false};
+  std::atomic<bool> m_replaying{false};
   std::thread m_capture_thread;
   std::mutex m_mutex;
 
+  // Reference counts of the consumers, streaming is suspended with uvc_stop
+  // when there is none for the idle timeout. Calls into the registry are
+  // serialized by m_consumer_mutex and never made while holding m_mutex.
+  std::mutex m_consumer_mutex;
+  ConsumerRegistry m_consumers;
+
   // Output windows
   ANativeWindow *m_preview_window;
   ANativeWindow *m_recording_window;
+  // Preview window is ignored while headless
+  bool m_headless;
+  // Output size of each consumer, 0 means camera resolution
+  uint32_t m_preview_request_width;
+  uint32_t m_preview_request_height;
+  uint32_t m_recording_request_width;
+  uint32_t m_recording_request_height;
+  // Part of the camera frame each window shows, empty means the whole frame
+  FrameRect m_preview_crop;
+  FrameRect m_recording_crop;
+  // Orientation of each window's output
+  FrameOrientation m_preview_orientation;
+  FrameOrientation m_recording_orientation;
+
+  // MJPEG decode stage, used by one frame at a time (the capture loop waits
+  // for each frame before fetching the next)
+  std::unique_ptr<MjpegDecoder> m_mjpeg_decoder;
 
-  // Frame callback
+  // Callback set by setFrameCallback and its subscription, guarded by
+  // m_consumer_mutex
   FrameCallback m_frame_callback;
+  int32_t m_frame_callback_id;
+  struct FrameCallbackAdapter {
+    FlutterUvcFrameRenderer *renderer;
+    void operator()(const FrameView &frame) const {
+      renderer->m_frame_callback(frame.data, frame.len, frame.width,
+                                 frame.height, frame.pts_us);
+    }
+  } m_frame_callback_adapter{this};
+
+  // Frame subscribers, also the consumers of the frame callback
+  FrameSubscriptions m_subscriptions;
+
+  // Capture file writer and replay source, guarded by m_mutex
+  std::shared_ptr<FrameCaptureWriter> m_capture_writer;
+  std::shared_ptr<FrameReplaySource> m_replay_source;
 
   // Statistics
   std::atomic<int64_t> m_frame_count{0};
   int64_t m_start_time_ns;
+  std::atomic<int64_t> m_time_to_first_frame_ns{0};
+
+  // Maps the device PTS to CLOCK_MONOTONIC, reset on every (re)start
+  PtsClockModel m_clock;
+
+  // Per stage latency from the capture stamp embedded by the source
+  LatencyProbe m_latency;
+  FrameDedup m_dedup;
+
+  // Parameters negotiated by prewarm(), consumed by the next start()
+  bool m_prewarmed;
+  uint32_t m_prewarm_width;
+  uint32_t m_prewarm_height;
+  uint32_t m_prewarm_frame_type;
+
+  // Configuration prepared by reconfigure(), applied by the capture loop
+  struct PendingConfig {
+    uint32_t width;
+    uint32_t height;
+    uint32_t frame_type;
+    std::vector<uint8_t> frame_buffer;
+    std::vector<uint8_t> rgb_buffer;
+    std::unique_ptr<MjpegDecoder> mjpeg_decoder;
+    int64_t requested_ns;
+    std::promise<int> done;
+  };
+  // Guarded by m_mutex
+  std::unique_ptr<PendingConfig> m_pending_config;
+  // Request time of the switch waiting for its first frame, capture thread only
+  int64_t m_switch_requested_ns;
+  std::atomic<int64_t> m_switch_latency_ns{0};
 
   // Frame buffer
   std::vector<uint8_t> m_frame_buffer;
   std::vector<uint8_t> m_rgb_buffer;
+  // Per consumer scaled frames, only used when the output size differs from
+  // the decoded size
+  std::vector<uint8_t> m_preview_buffer;
+  std::vector<uint8_t> m_recording_buffer;
+
+  /**
+   * Acquire or release an implicit consumer when its output is attached to or
+   * detached from the renderer
+   * @param attached Whether the output was set before the change
+   * @param attach Whether the output is set after the change
+   */
+  void updateConsumer(consumer_type_t type, bool attached, bool attach);
+
+  /**
+   * Preview window that should receive frames, nullptr while headless
+   * Call with m_mutex held.
+   */
+  ANativeWindow *activePreviewLocked() const {
+    return m_headless ? nullptr : m_preview_window;
+  }
+
+  /**
+   * Size of the buffer receiving frames from uvc_get_frame
+   */
+  static size_t frameBufferBytes(uint32_t frame_type, uint32_t width,
+                                 uint32_t height);
+
+  /**
+   * Switch to the configuration prepared by reconfigure() if any
+   * Called by the capture loop between two frames.
+   */
+  void applyPendingConfig();
 
   /**
    * Main capture loop - runs on separate thread
@@ -134,16 +471,54 @@ private:
   void captureLoop();
 
   /**
-   * Render frame to a native window
+   * Get the next frame from the replay source if set, otherwise from the
+   * device, and append it to the capture file if capturing
+   * Arguments follow uvc_get_frame.
+   * @return 0 on success, negative on error or when no frame is available
    */
-  void renderToWindow(ANativeWindow *window, const uint8_t *data,
-                      uint32_t width, uint32_t height);
+  int fetchFrame(uint32_t &frame_type, uint32_t &width, uint32_t &height,
+                 uint32_t &data_len, int64_t &pts_us, uint32_t &flags);
+
+  /**
+   * Decode the part of the captured frame the current consumers look at
+   * into m_rgb_buffer, at the size they require
+   * @param width Camera frame width, set to the decoded frame width
+   * @param height Camera frame height, set to the decoded frame height
+   * @param region Set to the part of the decoded frame held by m_rgb_buffer
+   * @param orientation Set to the orientation m_rgb_buffer is stored with
+   * @param priority Pool priority of the stripes of a parallel conversion
+   * @param subscribers Pixels needed by the frame subscribers due for it
+   * @return 0 on success, negative on error
+   */
+  int decodeFrame(uint32_t frame_type, uint32_t data_len, uint32_t &width,
+                  uint32_t &height, FrameRect &region,
+                  FrameOrientation &orientation, task_priority_t priority,
+                  const RgbaDemand &subscribers);
 
   /**
-   * Convert YUV to RGB for display
+   * Crop the decoded frame, scale it to the consumer's output size if needed
+   * and render it in the consumer's orientation
+   * @param crop Consumer crop in camera pixels, empty means the whole frame
+   * @param orientation Consumer orientation
+   * @param req_width Consumer output width, 0 means decoded width of the
+   *        oriented crop
+   * @param req_height Consumer output height, 0 means decoded height
+   * @param scaled Work buffer for the scaled frame
    */
-  void convertYuvToRgb(const uint8_t *yuv, uint8_t *rgb, uint32_t width,
-                       uint32_t height);
+  void renderScaled(ANativeWindow *window, const DecodedFrame &frame,
+                    const FrameRect &crop, const FrameOrientation &orientation,
+                    uint32_t req_width, uint32_t req_height,
+                    std::vector<uint8_t> &scaled);
+
+  /**
+   * Render frame to a native window
+   * The window buffer geometry follows the rendered frame size.
+   * @param stride Bytes per source row
+   * @param turn Orientation applied while copying into the window buffer
+   */
+  void renderToWindow(ANativeWindow *window, const uint8_t *data,
+                      uint32_t width, uint32_t height, uint32_t stride,
+                      const FrameOrientation &turn = {});
 };
 
 } // namespace serenegiant::flutter
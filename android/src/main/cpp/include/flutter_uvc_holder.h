@@ -20,7 +20,12 @@
 
 // 標準ライブラリ
 #include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
 #include <vector>
 // android
@@ -28,6 +33,16 @@
 // aandusb-native
 #include "aandusb_native.h"
 // flutter
+#include "flutter_clock_model.h"
+#include "flutter_consumer_registry.h"
+#include "flutter_frame_burst.h"
+#include "flutter_frame_capture.h"
+#include "flutter_frame_crop.h"
+#include "flutter_frame_dedup.h"
+#include "flutter_latency_probe.h"
+#include "flutter_motion_detector.h"
+#include "flutter_rate_controller.h"
+#include "flutter_still_capture.h"
 #include "flutter_utils.h"
 
 namespace serenegiant::flutter
@@ -35,41 +50,306 @@ namespace serenegiant::flutter
 
 #define DEFAULT_WIDTH (640)
 #define DEFAULT_HEIGHT (480)
+/**
+ * 静止画の撮影で次のフレームを待つ時間の上限[ミリ秒]
+ * 一時停止中の映像取得を再開して最初のフレームが届くまでを含む
+ */
+#define STILL_TIMEOUT_MS (2000)
+
+	/**
+	 * 対応解像度一覧/UVCコントロール一覧の取得が完了したときのコールバック
+	 * ワーカースレッド上で呼び出される
+	 * @param device_id
+	 * @param result 0: 成功, 負: エラーコード
+	 */
+	typedef std::function<void(const int32_t &device_id, const int &result)> OnCapabilitiesReady;
+
+	/**
+	 * 静止画の撮影が完了したときのコールバック
+	 * ワーカースレッド上で呼び出される
+	 * @param device_id
+	 * @param result 0: 成功, 負: エラーコード
+	 * @param jpeg JPEGデータ, ファイルへ書き込んだ時とエラーの時は空
+	 */
+	typedef std::function<void(const int32_t &device_id, const int &result, std::vector<uint8_t> &&jpeg)> OnStillCaptured;
+
+	/**
+	 * 連写が完了したときのコールバック
+	 * ワーカースレッド上で呼び出される
+	 * @param device_id
+	 * @param result 0: 成功, 負: エラーコード
+	 * @param burst 撮影したフレーム, エラーの時はnullptr
+	 */
+	typedef std::function<void(const int32_t &device_id, const int &result, std::shared_ptr<FrameBurst> burst)> OnBurstCaptured;
+
+	/**
+	 * 動きの有無が切り替わったときのコールバック
+	 * 動き検出スレッドまたは録画スレッド上で呼び出される
+	 * @param device_id
+	 * @param result 切り替わったフレームの解析結果
+	 * @param pts_us 切り替わったフレームのPTS[マイクロ秒]
+	 */
+	typedef std::function<void(const int32_t &device_id, const MotionResult &result, const int64_t &pts_us)> OnMotionChanged;
 
 	class FlutterUVCHolder
 	{
 	private:
 		const int32_t m_device_id;
 		usb_manager_t *m_manager;
+		const uvc_raw_frame_t m_initial_frame_type;
+		const uint32_t m_initial_width;
+		const uint32_t m_initial_height;
 		uvc_video_size_t m_current_size;
-		std::vector<const uvc_video_size_t> m_supported_size;
+		std::vector<uvc_video_size_t> m_supported_size;
 		std::vector<uint64_t> m_supported_ctrls;
+		/**
+		 * set_video_sizeで選択したフレームインターバル[100ナノ秒単位]
+		 * UVC機器へは指定できないので録画スレッドが間引くのにだけ使う
+		 * 0なら未選択(録画時はデフォルトの30fpsで取得する)
+		 */
+		std::atomic<uint32_t> m_frame_interval{0};
+		/**
+		 * 対応解像度一覧/UVCコントロール一覧の取得完了を待機するためのfuture
+		 * prepare_asyncを呼ぶまではinvalid
+		 */
+		std::shared_future<int> m_ready;
+		/**
+		 * 事前準備の完了を待機するためのfuture
+		 * prewarm_asyncを呼ぶまではinvalid
+		 */
+		std::shared_future<int> m_prewarmed;
+		/**
+		 * m_readyとm_prewarmedの排他制御用
+		 * 録画/プレビュー/Dart側の各スレッドから参照されるので代入/コピーは必ず保持して行う
+		 */
+		mutable std::mutex m_ready_lock;
 		ANativeWindow *m_recording_window = nullptr; // Recording surface for MediaCodec
 
 		// Recording frame capture thread
 		std::atomic<bool> m_recording_active{false};
 		std::unique_ptr<std::thread> m_recording_thread;
 		std::vector<uint8_t> m_frame_buffer;
+		/**
+		 * uvc_get_frameで受け取った映像フレームの記録先
+		 * 録画中は録画スレッドが, それ以外は記録スレッドがカメラが送ってきたフォーマットのまま書き込む
+		 * m_capture_lockはm_captureとm_capture_threadを保護する
+		 */
+		std::mutex m_capture_lock;
+		std::shared_ptr<FrameCaptureWriter> m_capture;
+		std::atomic<bool> m_capture_active{false};
+		std::unique_ptr<std::thread> m_capture_thread;
+		/**
+		 * プレビュー用Surfaceとモデルビュー変換行列
+		 * ヘッドレスモード中もSurfaceは保持しておき, 解除した時にaandusbへセットし直す
+		 */
+		std::mutex m_preview_lock;
+		ANativeWindow *m_preview_window = nullptr;
+		std::vector<float> m_mvp_matrix;
+		bool m_headless = false;
+		/**
+		 * 映像取得中の映像サイズ変更時に録画スレッドへ引き渡すフレームバッファ
+		 * 録画スレッドが次のフレームの前に入れ替える
+		 */
+		std::mutex m_config_lock;
+		std::vector<uint8_t> m_pending_frame_buffer;
+		uint32_t m_pending_width = 0;
+		uint32_t m_pending_height = 0;
+		std::atomic<bool> m_has_pending{false};
+		/**
+		 * 録画する範囲(映像の画素単位), 空なら映像全体, m_config_lockで保護する
+		 */
+		FrameRect m_recording_crop;
+		/**
+		 * 録画する映像の向き(切り出した後に回転/反転する), m_config_lockで保護する
+		 */
+		FrameOrientation m_recording_orientation;
+		/**
+		 * 最後に映像取得中に映像サイズを変更した時に映像取得を再開するまでに掛かった時間[ナノ秒]
+		 */
+		std::atomic<int64_t> m_switch_latency_ns{0};
+		/**
+		 * 事前準備で確保した録画用のフレームバッファ
+		 * 録画開始時に映像サイズが一致すればm_frame_bufferと入れ替える, m_config_lockで保護する
+		 */
+		std::vector<uint8_t> m_prewarm_frame_buffer;
+		/**
+		 * startを呼んだ時刻[ナノ秒]と最初のフレームを受け取るまでに掛かった時間[ナノ秒]
+		 */
+		std::atomic<int64_t> m_start_ns{0};
+		std::atomic<int64_t> m_time_to_first_frame_ns{0};
+		/**
+		 * 機器側PTSからCLOCK_MONOTONICへのクロックモデル
+		 * 録画用Surfaceへの書き込みを揺らぎを取り除いた時刻まで遅らせるのに使う
+		 */
+		PtsClockModel m_clock;
+		/**
+		 * 撮影から録画用Surfaceへ書き込むまでの遅延の測定
+		 */
+		LatencyProbe m_latency;
+		/**
+		 * 映像の消費者の参照カウント
+		 * 消費者がいなくなると猶予時間の経過後にuvc_stopで映像取得を一時停止する
+		 */
+		ConsumerRegistry m_consumers;
+		/**
+		 * 撮影中の静止画, 同時に撮影できるのは1枚だけ
+		 */
+		std::mutex m_still_lock;
+		std::shared_future<int> m_still;
+		/**
+		 * 静止画にするフレームの受け渡し
+		 * 録画/記録/動き検出スレッドが動いている間はフレームを取り合わないように
+		 * そのスレッドが受け取ったフレームをm_still_frameへコピーする
+		 * m_still_frame_lockはm_still_frameを保護する
+		 */
+		struct still_frame {
+			std::vector<uint8_t> data;
+			size_t data_len;
+			uint32_t frame_type;
+			uint32_t width;
+			uint32_t height;
+		};
+		std::mutex m_still_frame_lock;
+		std::condition_variable m_still_frame_cond;
+		std::atomic<bool> m_still_requested{false};
+		still_frame m_still_frame {};
+		/**
+		 * 撮影中の連写, 同時に撮影できるのは1回だけ
+		 * 録画中は録画スレッドがm_burstへフレームを書き込む
+		 * m_burst_lockはm_burstとm_burst_workersを保護する
+		 */
+		std::mutex m_burst_lock;
+		std::shared_ptr<FrameBurst> m_burst;
+		std::atomic<bool> m_burst_active{false};
+		// コールバックから次の連写を開始できるようにコールバックの前に解除する
+		std::atomic<bool> m_burst_running{false};
+		/**
+		 * 撮影スレッドはコールバックから次の連写を開始しても自分自身を待たないように切り離して
+		 * 終了するまでの数を数えて破棄時に待つ
+		 */
+		std::condition_variable m_burst_cond;
+		uint32_t m_burst_workers{0};
+		/**
+		 * 動き検出
+		 * 録画中は録画スレッドが録画用のRGBXフレームを, それ以外は記録スレッドまたは動き検出スレッドが
+		 * カメラが送ってきたフォーマットのままのフレームを解析する
+		 * m_motion_lockはm_on_motionとm_motion_threadを保護する
+		 */
+		MotionDetector m_motion;
+		std::mutex m_motion_lock;
+		OnMotionChanged m_on_motion;
+		std::atomic<bool> m_motion_enabled{false};
+		// 動き検出スレッドがフレームを解析する間隔[ミリ秒]
+		std::atomic<uint32_t> m_motion_interval_ms{0};
+		std::unique_ptr<std::thread> m_motion_thread;
+		/**
+		 * 静止した映像の重複フレームの検出
+		 * 録画スレッドが録画用のRGBXフレームを前のフレームと比較する
+		 */
+		FrameDedup m_dedup;
+		/**
+		 * エンコーダーの処理待ちに合わせたビットレート/フレームレートの制御
+		 * 録画スレッドが間引くフレームを決め, エンコーダーの報告で制御する
+		 */
+		RateController m_rate;
 
 		/**
 		 * 対応しているUVC設定機能一覧を更新する
 		 */
 		void update_supported_ctrls();
+		/**
+		 * 対応解像度一覧を更新する
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int update_supported_size();
+		/**
+		 * 対応解像度一覧/UVCコントロール一覧を取得する
+		 * prepare_asyncからワーカースレッド上で呼び出される
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int enumerate_capabilities();
+		/**
+		 * 映像取得開始後の最初のフレームまでの処理を前もって行う
+		 * prewarm_asyncからワーカースレッド上で呼び出される
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int prewarm();
 
 		/**
 		 * Recording frame capture loop
 		 */
 		void recording_capture_loop();
 
+		/**
+		 * 次のフレームを受け取って静止画(JPEG)にする
+		 * 録画/記録/動き検出中はそのスレッドから受け取り, それ以外はuvc_get_frameで直接受け取る
+		 * capture_stillからワーカースレッド上で呼び出される
+		 * @param jpeg
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int take_still(std::vector<uint8_t> &jpeg);
+		/**
+		 * 静止画の撮影待ちならフレームをコピーして撮影スレッドへ渡す
+		 * 録画/記録/動き検出スレッドがuvc_get_frameで受け取る毎に呼ぶ
+		 * @param frame_type
+		 * @param data
+		 * @param data_len
+		 * @param width
+		 * @param height
+		 */
+		void offer_still(
+			const uint32_t &frame_type, const uint8_t *data, const size_t &data_len,
+			const uint32_t &width, const uint32_t &height);
+		/**
+		 * 連写のスロットがすべて埋まるまでフレームを受け取る
+		 * 録画中は録画スレッドへ書き込みを任せ, それ以外はuvc_get_frameでスロットへ直接受け取る
+		 * capture_burstからワーカースレッド上で呼び出される
+		 * @param burst
+		 * @param timeout_ms
+		 * @return 0: 成功, -ETIMEDOUT: 時間内にすべてのスロットが埋まらなかった
+		 */
+		int fill_burst(const std::shared_ptr<FrameBurst> &burst, const int64_t &timeout_ms);
+		/**
+		 * 録画中以外にフレームを受け取って動き検出を行う
+		 * 動き検出スレッドの実行関数
+		 */
+		void motion_loop();
+		/**
+		 * 録画中以外にフレームを受け取ってファイルへ記録する
+		 * 記録スレッドの実行関数
+		 */
+		void capture_loop();
+		/**
+		 * フレームを動き検出器へ渡して動きの有無が切り替わればコールバックを呼ぶ
+		 * @param frame_type
+		 * @param data
+		 * @param data_len
+		 * @param width
+		 * @param height
+		 * @param pts_us
+		 */
+		void detect_motion(
+			const uint32_t &frame_type, const uint8_t *data, const size_t &data_len,
+			const uint32_t &width, const uint32_t &height, const int64_t &pts_us);
+
+		/**
+		 * プレビュー用Surfaceとヘッドレスモードの状態をaandusbへ反映する
+		 * m_preview_lockを保持した状態で呼び出すこと
+		 * @param attached 変更前にaandusbへSurfaceをセットしていたかどうか
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int apply_preview_locked(const bool &attached);
+
 	protected:
 	public:
 		/**
 		 * コンストラクタ
+		 * 対応解像度一覧等の取得は行わないので生成後にprepare_asyncを呼ぶこと
 		 * @param manager
 		 * @param device_id
-		 * @param frame_type
-		 * @param width
-		 * @param height
+		 * @param frame_type prepare_asyncで最初に適用する映像フォーマット
+		 * @param width prepare_asyncで最初に適用する映像幅
+		 * @param height prepare_asyncで最初に適用する映像高さ
 		 */
 		explicit FlutterUVCHolder(
 			usb_manager_t *manager, const int32_t &device_id,
@@ -81,23 +361,60 @@ namespace serenegiant::flutter
 		 */
 		virtual ~FlutterUVCHolder() noexcept;
 
+		/**
+		 * 対応解像度一覧/UVCコントロール一覧の取得をワーカースレッドで開始する
+		 * 既に開始している場合は何もしない
+		 * @param on_ready 取得完了時のコールバック, nullptrでも可
+		 * @return 取得完了を待機するためのfuture
+		 */
+		std::shared_future<int> prepare_async(OnCapabilitiesReady on_ready = nullptr);
+
+		/**
+		 * 対応解像度一覧/UVCコントロール一覧の取得完了後に
+		 * 映像取得開始後の最初のフレームまでの処理(共有タスクプールのワーカースレッドの生成,
+		 * 録画用フレームバッファの確保)をワーカースレッドで前もって行う
+		 * 映像フォーマットのネゴシエーションはprepare_asyncで済んでいるので
+		 * startでは映像取得の開始だけになる
+		 * 既に開始している場合は何もしない
+		 * @return 事前準備の完了を待機するためのfuture
+		 */
+		std::shared_future<int> prewarm_async();
+
+		/**
+		 * 対応解像度一覧/UVCコントロール一覧の取得が完了しているかどうか
+		 * @return
+		 */
+		[[nodiscard]]
+		bool is_ready() const;
+
+		/**
+		 * 対応解像度一覧/UVCコントロール一覧の取得完了を待機する
+		 * prepare_asyncを呼んでいなければ呼び出し元スレッドで取得する
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int wait_ready();
+
 		/**
 		 * 対応解像度一覧を取得
+		 * 取得完了前に呼び出すと完了するまでブロックする
 		 * @return
 		 */
 		[[nodiscard]]
-		inline const std::vector<const uvc_video_size_t> &supported_size() const
+		inline const std::vector<uvc_video_size_t> &supported_size()
 		{
+			wait_ready();
 			return m_supported_size;
 		};
 
 		/**
 		 * 対応しているUVC設定機能一覧を取得する
+		 * 取得完了前に呼び出すと完了するまでブロックする
 		 * @return
 		 */
 		[[nodiscard]]
-		inline const std::vector<uint64_t> &supported_ctrls() const
+		inline const std::vector<uint64_t> &supported_ctrls()
 		{
+			wait_ready();
 			return m_supported_ctrls;
 		};
 
@@ -126,39 +443,45 @@ namespace serenegiant::flutter
 
 		/**
 		 * コントロールユニットの対応機能フラグを取得
+		 * 対応解像度一覧/UVCコントロール一覧の取得完了前に呼び出すと完了するまでブロックする
 		 * @return
 		 */
 		uint64_t get_ctrl_supports();
 
 		/**
 		 * プロセッシングユニットの対応機能フラグを取得
+		 * 対応解像度一覧/UVCコントロール一覧の取得完了前に呼び出すと完了するまでブロックする
 		 * @return
 		 */
 		uint64_t get_proc_supports();
 
 		/**
 		 * UVC設定機能の情報を取得
+		 * 対応解像度一覧/UVCコントロール一覧の取得完了前に呼び出すと完了するまでブロックする
 		 * @param info
 		 * @return 0: 成功, 負: エラーコード
 		 */
-		int get_control_info(uvc_control_info_t &info) const;
+		int get_control_info(uvc_control_info_t &info);
 
 		/**
 		 * UVC設定機能へ値を適用
+		 * 対応解像度一覧/UVCコントロール一覧の取得完了前に呼び出すと完了するまでブロックする
+		 * (prepare_asyncでの初期設定と同時に適用しないように)
 		 * @param type
 		 * @param value
 		 * @return 0: 成功, 負: エラーコード
 		 */
 		[[nodiscard]]
-		int set_control_value(const uint64_t &type, const int32_t &value) const;
+		int set_control_value(const uint64_t &type, const int32_t &value);
 
 		/**
 		 * UVC設定機能の現在の値を取得
+		 * 対応解像度一覧/UVCコントロール一覧の取得完了前に呼び出すと完了するまでブロックする
 		 * @param type
 		 * @param value
 		 * @return 0: 成功, 負: エラーコード
 		 */
-		int get_control_value(const uint64_t &type, int32_t &value) const;
+		int get_control_value(const uint64_t &type, int32_t &value);
 
 		/**
 		 * UVC機器からの映像を受け取るためのSurface(ANativeWindow*)をセット
@@ -168,6 +491,22 @@ namespace serenegiant::flutter
 		 */
 		int set_preview_surface(ANativeWindow *preview_window, const float *mvp_matrix = nullptr);
 
+		/**
+		 * ヘッドレスモードを切り替える
+		 * ヘッドレスモード中はプレビュー用Surfaceをaandusbから外してプレビューのための
+		 * 変換/描画を行わない, 録画は継続する
+		 * アプリがバックグラウンドへ移行する時に使う
+		 * @param headless
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int set_headless(const bool &headless);
+
+		/**
+		 * ヘッドレスモードかどうか
+		 * @return
+		 */
+		bool is_headless();
+
 		/**
 		 * 録画用のSurface(ANativeWindow*)をセット
 		 * MediaCodecのencoderSurfaceを渡すことで録画を行う
@@ -186,14 +525,221 @@ namespace serenegiant::flutter
 
 		/**
 		 * 映像設定
+		 * 対応しているフレームインターバルの中からfpsに最も近いもの(min_fps〜max_fpsの範囲内)を選択する
+		 * UVC機器は既定のフレームレートのままで, 選択したフレームレートは録画時に間引くのにだけ使う
+		 * 映像取得中ならプレビュー用/録画用Surfaceや録画スレッドはそのままで
+		 * 映像取得だけを終了→映像サイズ変更→再開する
 		 * @param frame_type
 		 * @param width
 		 * @param height
-		 * @return
+		 * @param fps 要求するフレームレート, 0以下なら範囲内で最大のフレームレート
+		 * @param min_fps 最小フレームレート, 0以下なら制限なし
+		 * @param max_fps 最大フレームレート, 0以下なら制限なし
+		 * @return 0: 成功, 負: エラーコード
 		 */
 		int set_video_size(
 			const uvc_raw_frame_t &frame_type,
-			const uint32_t &width, const uint32_t &height);
+			const uint32_t &width, const uint32_t &height,
+			const float &fps = 0.0f, const float &min_fps = 0.0f, const float &max_fps = 0.0f);
+
+		/**
+		 * 最後に映像取得中に映像サイズを変更した時に映像取得を再開するまでに掛かった時間を取得
+		 * @return 切り替え時間[ナノ秒], 映像取得中に変更していなければ0
+		 */
+		int64_t get_switch_latency_ns() const
+		{
+			return m_switch_latency_ns;
+		}
+
+		/**
+		 * startを呼んでから最初のフレームを受け取るまでに掛かった時間を取得
+		 * プレビューはaandusbが直接Surfaceへ描画するので録画用Surfaceへ最初のフレームを
+		 * 書き込むまでの時間(録画開始がstartより後ならその時刻から)
+		 * @return 時間[ナノ秒], startを呼んでから最初のフレームを受け取っていなければ0
+		 */
+		int64_t get_time_to_first_frame_ns() const
+		{
+			return m_time_to_first_frame_ns;
+		}
+
+		/**
+		 * クロックモデルの推定結果と到着時刻の揺らぎの統計情報を取得
+		 * 録画中に録画用Surfaceへ書き込んだフレームから推定する
+		 * @param stats
+		 */
+		void get_clock_stats(clock_stats_t &stats) const
+		{
+			m_clock.get_stats(stats);
+		}
+
+		/**
+		 * 遅延の測定を有効/無効にする, 集計結果は破棄する
+		 * 映像ソースがフレームへ遅延測定用のスタンプを埋め込んでいる時のみ測定できる
+		 * @param enabled
+		 */
+		void set_latency_probe(const bool &enabled)
+		{
+			m_latency.set_enabled(enabled);
+		}
+
+		/**
+		 * 映像の一部だけを録画する
+		 * 録画用Surfaceのサイズは範囲のサイズになり, 範囲の画素だけをSurfaceへ書き込む
+		 * 録画中でも次のフレームから切り替わる
+		 * @param crop 録画する範囲(映像の画素単位), 空なら映像全体
+		 */
+		void set_recording_crop(const FrameRect &crop);
+
+		/**
+		 * 録画する映像を回転/反転する
+		 * 切り出した範囲を録画用Surfaceへコピーする時に向きを変えるので処理は増えない
+		 * 録画用Surfaceのサイズは回転後のサイズになる
+		 * 録画中でも次のフレームから切り替わる
+		 * @param orientation 時計回りの回転角度(0/90/180/270)と左右/上下反転
+		 * @return 0: 成功, -EINVAL: 回転角度が90度単位ではない
+		 */
+		int set_recording_orientation(const FrameOrientation &orientation);
+
+		/**
+		 * 次のフレームを静止画(JPEG)としてワーカースレッドで撮影する
+		 * MJPEGはデコードせずにカメラが送ってきたJPEGをそのまま使う(ハフマンテーブルが無ければ標準のものを追加する)
+		 * 非圧縮フォーマットはlibjpeg-turboでJPEGへ圧縮する
+		 * 録画中でもuvc_get_frameで受け取るフレームを1枚使う
+		 * @param path 書き込み先のファイルパス, 空ならJPEGデータをコールバックへ渡す
+		 * @param on_captured 撮影完了時のコールバック, nullptrでも可
+		 * @return 0: 撮影を開始した, -EBUSY: 撮影中, -EPIPE: 映像取得中ではない
+		 */
+		int capture_still(const std::string &path, OnStillCaptured on_captured);
+
+		/**
+		 * 連続したフレームをワーカースレッドで撮影する
+		 * 撮影開始前にすべてのスロットを確保するので撮影中はメモリを確保しない
+		 * 録画中は録画用のRGBXフレームを, それ以外はカメラが送ってきたフォーマットのまま保持する
+		 * @param count 撮影するフレーム数(1〜BURST_MAX_FRAMES)
+		 * @param encode trueならすべて揃ってから共有タスクプールで並列にJPEGへ圧縮する
+		 * @param on_captured 撮影完了時のコールバック, nullptrでも可
+		 * @return 0: 撮影を開始した, -EBUSY: 撮影中, -EPIPE: 映像取得中ではない,
+		 *         -ENOTSUP: H.264など保持できないフォーマット, -EINVAL/-ENOMEM: フレーム数/サイズが大きすぎる
+		 */
+		int capture_burst(const uint32_t &count, const bool &encode, OnBurstCaptured on_captured);
+
+		/**
+		 * 動き検出を開始/停止する
+		 * 映像を格子状に区切って前のフレームとの輝度の差分から動きを検出し,
+		 * 動きの有無が切り替わった時にコールバックを呼ぶ
+		 * config.gate_recordingがtrueなら動きが無い間は録画用Surfaceへ書き込まない
+		 * 検出中に呼ぶと設定を変更して動きが無い状態からやり直す
+		 * コールバック内から停止しないこと(動き検出スレッドの終了を待つため)
+		 * @param enabled
+		 * @param config 動き検出の設定, 停止時は使わない
+		 * @param on_motion 動きの有無が切り替わった時のコールバック, nullptrでも可
+		 * @return 0: 成功, -EINVAL: 設定が範囲外
+		 */
+		int set_motion_detection(const bool &enabled, const MotionConfig &config, OnMotionChanged on_motion);
+
+		/**
+		 * 動きを検出しているかどうか
+		 * @return
+		 */
+		bool in_motion() const
+		{
+			return m_motion_enabled && m_motion.inMotion();
+		}
+
+		/**
+		 * 前のフレームと同じフレームを録画用Surfaceへ書き込まないようにする, 集計結果は破棄する
+		 * 書き込まなかった間はエンコーダーが前のフレームを繰り返す
+		 * 非圧縮フレームはsample_rows行ごとの行だけを比較する
+		 * @param enabled
+		 * @param sample_rows 比較する行の間隔(1〜DEDUP_MAX_SAMPLE_ROWS), 1なら全ての行
+		 * @return 0: 成功, -EINVAL: sample_rowsが範囲外
+		 */
+		int set_frame_dedup(const bool &enabled, const uint32_t &sample_rows)
+		{
+			return m_dedup.configure(enabled, sample_rows);
+		}
+
+		/**
+		 * 比較したフレーム数と書き込まなかった重複フレーム数を取得
+		 * @param stats
+		 */
+		void get_dedup_stats(DedupStats &stats) const
+		{
+			m_dedup.getStats(stats);
+		}
+
+		/**
+		 * 録画用Surfaceへ書き込まなかった間にエンコーダーが前のフレームを繰り返すべきかどうか
+		 * 重複フレームを書き込まない時はtrue, ただし動きの無い間の録画を止める時は
+		 * 繰り返すと止めた間も静止画が録画されるのでfalse
+		 * 間引き中の繰り返しはビットレート/フレームレート制御がエンコーダー自身のフレームとして数える
+		 * エンコーダーの設定は録画開始時に決まるので録画開始時の設定で判断する
+		 * @return
+		 */
+		bool repeats_frames() const
+		{
+			return m_dedup.enabled() && !(m_motion_enabled && m_motion.gatesRecording());
+		}
+
+		/**
+		 * エンコーダーの処理待ちや書き込みの停滞に合わせてビットレートとフレームレートを下げる
+		 * 制御状態と集計結果は破棄する, 無効にすると間引きを止める(ビットレートはそのまま)
+		 * @param enabled
+		 * @param config
+		 * @return 0: 成功, -EINVAL: 設定が範囲外
+		 */
+		int set_rate_control(const bool &enabled, const RateControlConfig &config)
+		{
+			return m_rate.configure(enabled, config);
+		}
+
+		/**
+		 * エンコーダーの録画開始からの累計を報告する
+		 * @param encoded_frames エンコードしたフレーム数
+		 * @param output_bytes エンコードしたバイト数
+		 * @param stall_us 書き込みが停滞した時間[マイクロ秒]
+		 * @param bitrate エンコーダーの現在のビットレート
+		 * @return エンコーダーに設定するビットレート, 0なら変更なし
+		 */
+		uint32_t report_encoder_stats(
+			const uint64_t &encoded_frames, const uint64_t &output_bytes,
+			const uint64_t &stall_us, const uint32_t &bitrate);
+
+		/**
+		 * ビットレート/フレームレート制御の集計結果を取得
+		 * @param stats
+		 */
+		void get_rate_control_stats(RateControlStats &stats) const
+		{
+			m_rate.getStats(stats);
+		}
+
+		/**
+		 * 最近のビットレート/フレームレートの変更を古い順に取得
+		 * @param decisions
+		 */
+		void get_rate_decisions(std::vector<RateDecision> &decisions) const
+		{
+			m_rate.getDecisions(decisions);
+		}
+
+		/**
+		 * 撮影からパイプラインの段階へフレームが届くまでの遅延の集計結果を取得
+		 * プレビューはaandusbが直接Surfaceへ描画するのでuvc_get_frameで受け取った時と録画用Surfaceへ書き込んだ時のみ
+		 * @param stage
+		 * @param stats
+		 */
+		void get_latency_stats(const latency_stage_t &stage, latency_stats_t &stats) const
+		{
+			m_latency.get_stats(stage, stats);
+		}
+
+		/**
+		 * set_video_sizeで選択したフレームレートを取得
+		 * 録画時に間引くフレームレートでUVC機器が送ってくるフレームレートではない
+		 * @return フレームレート, 未選択なら0
+		 */
+		float get_current_fps() const;
 
 		/**
 		 * 現在の映像設定を取得
@@ -210,7 +756,7 @@ namespace serenegiant::flutter
 		 */
 		int get_supported_size(
 			const int32_t &index, int32_t *num_supported,
-			uvc_video_size_t *data) const;
+			uvc_video_size_t *data);
 
 		/**
 		 * 映像取得開始
@@ -223,6 +769,56 @@ namespace serenegiant::flutter
 		 * @return
 		 */
 		int stop();
+
+		/**
+		 * 映像の消費者を登録する
+		 * プレビュー用/録画用Surfaceは自動的に登録するので
+		 * それ以外で映像を使う時(映像解析等)に呼ぶ
+		 * 消費者がいなくて映像取得を一時停止していればすぐに再開する
+		 * @param type
+		 * @return 0以上: 登録後のその種類の消費者の数, 負: エラーコード
+		 */
+		int acquire_consumer(const consumer_type_t &type);
+
+		/**
+		 * acquire_consumerで登録した映像の消費者を解除する
+		 * 消費者がいなくなれば猶予時間の経過後に映像取得を一時停止する
+		 * @param type
+		 * @return 0以上: 解除後のその種類の消費者の数, 負: エラーコード
+		 */
+		int release_consumer(const consumer_type_t &type);
+
+		/**
+		 * 消費者がいなくなってから映像取得を一時停止するまでの猶予時間をセットする
+		 * @param timeout_ms 猶予時間[ミリ秒], 負なら一時停止しない
+		 */
+		void set_idle_timeout(const int64_t &timeout_ms);
+
+		/**
+		 * 映像の消費者の登録状況と一時停止/再開の統計情報を取得する
+		 * @param metrics
+		 */
+		void get_consumer_metrics(consumer_metrics_t &metrics) const;
+
+		/**
+		 * uvc_get_frameで受け取った映像フレームのファイルへの記録を開始する
+		 * 録画中かどうかにかかわらずカメラが送ってきたフォーマットのまま記録する
+		 * @param path 記録ファイルのパス, 既存のファイルは上書きする
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int start_capture(const std::string &path);
+
+		/**
+		 * 映像フレームの記録を終了する
+		 * @return 0: 成功, 負: エラーコード
+		 */
+		int stop_capture();
+
+		/**
+		 * 映像フレームを記録中かどうか
+		 * @return
+		 */
+		bool is_capturing();
 	};
 
 	typedef std::shared_ptr<FlutterUVCHolder> FlutterUVCHolderSp;
@@ -0,0 +1,74 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#ifndef AANDUSB_FLUTTER_VIDEO_SIZE_H
+#define AANDUSB_FLUTTER_VIDEO_SIZE_H
+
+// 標準ライブラリ
+#include <cstddef>
+// aandusb-native
+#include "aandusb_native.h"
+// flutter
+#include "flutter_plugin.h"
+
+namespace serenegiant::flutter
+{
+
+/**
+ * フレームインターバルの単位(UVC規格では100ナノ秒単位)
+ */
+#define FRAME_INTERVAL_UNITS_PER_SEC (10000000)
+
+	/**
+	 * フレームインターバル[100ナノ秒単位]をフレームレートへ変換する
+	 * @param interval
+	 * @return フレームレート, intervalが0なら0
+	 */
+	float interval_to_fps(const uint32_t &interval);
+
+	/**
+	 * フレームレートをフレームインターバル[100ナノ秒単位]へ変換する
+	 * @param fps
+	 * @return フレームインターバル, fpsが0以下なら0
+	 */
+	uint32_t fps_to_interval(const float &fps);
+
+	/**
+	 * 映像サイズ設定が対応しているフレームインターバルの中から
+	 * 指定したフレームレートに最も近いものを選択する
+	 * min_fps/max_fpsは0以下なら制限なし
+	 * @param size 映像サイズ設定
+	 * @param fps 要求するフレームレート, 0以下ならmin_fps〜max_fpsの範囲内で最大のフレームレートを選択する
+	 * @param min_fps 最小フレームレート
+	 * @param max_fps 最大フレームレート
+	 * @return 選択したフレームインターバル[100ナノ秒単位], 該当するものが無ければ0
+	 */
+	uint32_t select_frame_interval(
+		const uvc_video_size_t &size,
+		const float &fps, const float &min_fps = 0.0f, const float &max_fps = 0.0f);
+
+	/**
+	 * uvc_video_size_tをDart側とやりとりするためのflutter_video_size_tへコピーする
+	 * フレームインターバル/フレームレートはMAX_INTERVALS個までしかコピーしない
+	 * @param src
+	 * @param dst
+	 */
+	void copy_video_size(const uvc_video_size_t &src, flutter_video_size_t &dst);
+
+}	// namespace serenegiant::flutter
+
+#endif //AANDUSB_FLUTTER_VIDEO_SIZE_H
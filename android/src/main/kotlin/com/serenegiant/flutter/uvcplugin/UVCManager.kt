@@ -162,7 +162,12 @@ class UVCManager: FlutterPlugin, MethodCallHandler, ActivityAware {
             if (mVideoRecorder == null) {
               mVideoRecorder = UvcVideoRecorder()
             }
-            val r = mVideoRecorder?.startRecording(path, width, height, bitrate) ?: -1
+            // The native rate controller decides the bitrate from the encoder's counters
+            mVideoRecorder?.statsListener = UvcVideoRecorder.StatsListener { frames, bytes, stallUs, rate ->
+              nativeReportEncoderStats(deviceId, frames, bytes, stallUs, rate)
+            }
+            val repeatPreviousFrame = nativeRepeatsFrames(deviceId)
+            val r = mVideoRecorder?.startRecording(path, width, height, bitrate, repeatPreviousFrame) ?: -1
             
             // Get the encoder surface and connect to native frame renderer
             val encoderSurface = mVideoRecorder?.getEncoderSurface()
@@ -300,6 +305,20 @@ class UVCManager: FlutterPlugin, MethodCallHandler, ActivityAware {
   @Keep
   external fun nativeSetRecordingSurfaceObj(deviceId: Int, surface: Surface?): Int
 
+  /**
+   * Report the recording encoder's counters to the native rate controller
+   * @return bitrate the encoder should switch to, 0 to keep it, negative on error
+   */
+  @Keep
+  external fun nativeReportEncoderStats(deviceId: Int, encodedFrames: Long, outputBytes: Long, stallUs: Long, bitrate: Int): Int
+
+  /**
+   * Whether the encoder should repeat the previous frame while native skips frames
+   * True with frame deduplication unless motion gating pauses the recording
+   */
+  @Keep
+  external fun nativeRepeatsFrames(deviceId: Int): Boolean
+
   companion object {
     private const val DEBUG = true // Enable debug logging for development
     private val TAG = UVCManager::class.java.simpleName
@@ -13,6 +13,7 @@ import android.media.MediaCodec
 import android.media.MediaCodecInfo
 import android.media.MediaFormat
 import android.media.MediaMuxer
+import android.os.Bundle
 import android.os.Handler
 import android.os.HandlerThread
 import android.os.SystemClock
@@ -31,8 +32,30 @@ class UvcVideoRecorder {
         private const val MIME_TYPE = MediaFormat.MIMETYPE_VIDEO_AVC
         private const val FRAME_RATE = 30
         private const val I_FRAME_INTERVAL = 1
+        // With frame deduplication native skips frames that repeat the
+        // previous one, the encoder then repeats the last frame it got after
+        // this many microseconds. Not used while motion gating pauses the
+        // recording, the pause would be filled with the last frame. Repeats
+        // during rate control decimation are counted by the native rate
+        // controller as the encoder's own frames, not as drained backlog.
+        private const val REPEAT_PREVIOUS_FRAME_AFTER_US = 2_000_000L / FRAME_RATE
         private const val DEFAULT_BITRATE = 4_000_000 // 4 Mbps
+        // How often the encoder's counters are reported to the stats listener
+        private const val STATS_INTERVAL_NS = 250_000_000L
     }
+
+    /**
+     * Receives the encoder's counters since the recording started and
+     * returns the bitrate to switch to, 0 or negative to keep the current one
+     */
+    fun interface StatsListener {
+        fun onEncoderStats(encodedFrames: Long, outputBytes: Long, stallUs: Long, bitrate: Int): Int
+    }
+
+    /**
+     * Set before startRecording, called on the encoder thread
+     */
+    var statsListener: StatsListener? = null
     
     // Recording state
     private var isRecording = AtomicBoolean(false)
@@ -54,6 +77,13 @@ class UvcVideoRecorder {
     private var frameCount = 0L
     private var lastFrameTimeNs = 0L
     private var frameIntervalNs = 1_000_000_000L / FRAME_RATE  // nanoseconds per frame
+
+    // Encoder counters for the stats listener, encoder thread only
+    private var bitrate = DEFAULT_BITRATE
+    private var encodedFrames = 0L
+    private var outputBytes = 0L
+    private var stallNs = 0L
+    private var lastReportNs = 0L
     
     // Dimensions
     private var videoWidth = 1280
@@ -77,20 +107,28 @@ class UvcVideoRecorder {
     
     /**
      * Start recording to the specified path
+     * @param repeatPreviousFrame true to let the encoder repeat the last frame
+     *        while native skips duplicate frames
      */
-    fun startRecording(path: String, width: Int, height: Int, bitrate: Int = DEFAULT_BITRATE): Int {
+    fun startRecording(path: String, width: Int, height: Int, bitrate: Int = DEFAULT_BITRATE,
+                       repeatPreviousFrame: Boolean = false): Int {
         if (isRecording.get()) {
             Log.w(TAG, "Already recording")
             return -1
         }
         
-        if (DEBUG) Log.d(TAG, "startRecording: $path ($width x $height) @ $bitrate bps")
+        if (DEBUG) Log.d(TAG, "startRecording: $path ($width x $height) @ $bitrate bps, repeat=$repeatPreviousFrame")
         
         try {
             outputPath = path
             frameCount = 0
             startTimeNs = System.nanoTime()
             lastFrameTimeNs = startTimeNs
+            this.bitrate = bitrate
+            encodedFrames = 0
+            outputBytes = 0
+            stallNs = 0
+            lastReportNs = startTimeNs
             
             // Ensure width/height are even
             videoWidth = if (width % 2 == 0) width else width + 1
@@ -106,6 +144,9 @@ class UvcVideoRecorder {
                 setInteger(MediaFormat.KEY_BIT_RATE, bitrate)
                 setInteger(MediaFormat.KEY_FRAME_RATE, FRAME_RATE)
                 setInteger(MediaFormat.KEY_I_FRAME_INTERVAL, I_FRAME_INTERVAL)
+                if (repeatPreviousFrame) {
+                    setLong(MediaFormat.KEY_REPEAT_PREVIOUS_FRAME_AFTER, REPEAT_PREVIOUS_FRAME_AFTER_US)
+                }
             }
             
             // Create encoder
@@ -253,7 +294,17 @@ class UvcVideoRecorder {
                             buffer.position(bufferInfo.offset)
                             buffer.limit(bufferInfo.offset + bufferInfo.size)
                             
+                            val writeStartNs = System.nanoTime()
                             mediaMuxer?.writeSampleData(videoTrackIndex, buffer, bufferInfo)
+                            val writeNs = System.nanoTime() - writeStartNs
+                            // A write longer than a frame interval holds up the encoder
+                            if (writeNs > frameIntervalNs) {
+                                stallNs += writeNs
+                            }
+                            if (bufferInfo.flags and MediaCodec.BUFFER_FLAG_CODEC_CONFIG == 0) {
+                                encodedFrames++
+                                outputBytes += bufferInfo.size
+                            }
                         }
                         
                         codec.releaseOutputBuffer(index, false)
@@ -268,6 +319,9 @@ class UvcVideoRecorder {
                         // No buffer available, continue
                     }
                 }
+                // Also reported while nothing comes out, that is when the
+                // encoder is falling behind
+                reportStats(codec)
             } catch (e: Exception) {
                 if (isRecording.get()) {
                     Log.e(TAG, "Drain error", e)
@@ -279,6 +333,30 @@ class UvcVideoRecorder {
         if (DEBUG) Log.d(TAG, "drainEncoder finished")
     }
     
+    /**
+     * Report the encoder's counters and apply the bitrate the listener returns
+     */
+    private fun reportStats(codec: MediaCodec) {
+        val listener = statsListener ?: return
+        val now = System.nanoTime()
+        if (now - lastReportNs < STATS_INTERVAL_NS) {
+            return
+        }
+        lastReportNs = now
+        val newBitrate = listener.onEncoderStats(encodedFrames, outputBytes, stallNs / 1000, bitrate)
+        if (newBitrate > 0 && newBitrate != bitrate) {
+            try {
+                codec.setParameters(Bundle().apply {
+                    putInt(MediaCodec.PARAMETER_KEY_VIDEO_BITRATE, newBitrate)
+                })
+                if (DEBUG) Log.d(TAG, "bitrate $bitrate -> $newBitrate bps")
+                bitrate = newBitrate
+            } catch (e: Exception) {
+                Log.w(TAG, "Failed to change bitrate", e)
+            }
+        }
+    }
+    
     /**
      * Clean up all resources
      */
@@ -0,0 +1,221 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * BandwidthPlannerのホスト上でのユニットテスト
+ * 実機のUVC機器の代わりに合成した対応解像度一覧を使う
+ *
+ * android/src/main/cppをホストのcmakeでビルドしてctestで実行する
+ *   cmake -S android/src/main/cpp -B build && cmake --build build && ctest --test-dir build
+ */
+
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+#include "flutter_video_size.h"
+#include "flutter_bandwidth_planner.h"
+
+using namespace serenegiant::flutter;
+
+// フレームインターバル[100ナノ秒単位]
+static uint32_t INTERVALS[] = { 333333, 666666, 1000000 };	// 30/15/10fps
+
+static uvc_video_size_t make_size(const uint32_t &frame_type, const uint32_t &width, const uint32_t &height)
+{
+	uvc_video_size_t size{};
+	size.frame_type = frame_type;
+	size.width = width;
+	size.height = height;
+	size.frame_interval_type = 3;
+	size.frame_intervals = INTERVALS;
+	size.num_frame_intervals = 3;
+	return size;
+}
+
+/**
+ * 一般的なUVC機器の対応解像度一覧(YUYVとMJPEG)
+ */
+static std::vector<uvc_video_size_t> typical_camera()
+{
+	return {
+		make_size(RAW_FRAME_UNCOMPRESSED_YUYV, 640, 480),
+		make_size(RAW_FRAME_UNCOMPRESSED_YUYV, 1280, 720),
+		make_size(RAW_FRAME_MJPEG, 640, 480),
+		make_size(RAW_FRAME_MJPEG, 1280, 720),
+		make_size(RAW_FRAME_MJPEG, 1920, 1080),
+	};
+}
+
+/**
+ * 帯域に余裕があれば非圧縮フォーマットを優先すること
+ */
+static void test_single_device_prefers_uncompressed()
+{
+	BandwidthPlanner planner;
+	assert(!planner.add_device({1, 640, 480, 30.0f}, typical_camera()));
+	std::vector<bandwidth_assignment_t> plan;
+	assert(!planner.plan(plan));
+	assert(plan.size() == 1);
+	assert(plan[0].device_id == 1);
+	assert(plan[0].frame_type == RAW_FRAME_UNCOMPRESSED_YUYV);
+	assert(plan[0].width == 640 && plan[0].height == 480);
+	assert(plan[0].frame_interval == 333333);
+}
+
+/**
+ * 要求したフレームレート以上で最も低いフレームレートを選択すること
+ */
+static void test_lowest_sufficient_frame_rate()
+{
+	BandwidthPlanner planner;
+	assert(!planner.add_device({1, 640, 480, 12.0f}, typical_camera()));
+	std::vector<bandwidth_assignment_t> plan;
+	assert(!planner.plan(plan));
+	assert(plan[0].frame_interval == 666666);
+}
+
+/**
+ * 2台目のUVC機器を追加すると帯域に収まるようにMJPEGへ切り替わること
+ */
+static void test_two_devices_fall_back_to_mjpeg()
+{
+	// 1280x720 YUYV 30fpsは約55MB/秒なので1台でもUSB2.0の帯域を超える
+	BandwidthPlanner planner;
+	assert(!planner.add_device({1, 1280, 720, 30.0f}, typical_camera()));
+	assert(!planner.add_device({2, 640, 480, 30.0f}, typical_camera()));
+	std::vector<bandwidth_assignment_t> plan;
+	assert(!planner.plan(plan));
+	assert(plan.size() == 2);
+	assert(plan[0].frame_type == RAW_FRAME_MJPEG);
+	assert(plan[0].width == 1280);
+	uint64_t total = 0;
+	for (const auto &a: plan)
+	{
+		total += a.bandwidth;
+	}
+	assert(total <= BANDWIDTH_USB2_BUS);
+	// 640x480 YUYV 30fps(約18MB/秒)はMJPEGの1280x720と合わせても帯域内
+	assert(plan[1].frame_type == RAW_FRAME_UNCOMPRESSED_YUYV);
+}
+
+/**
+ * 3台とも640x480 YUYV 30fpsでは帯域を超えるので一部をMJPEGにすること
+ */
+static void test_three_devices_share_bus()
+{
+	BandwidthPlanner planner;
+	for (int32_t id = 1; id <= 3; id++)
+	{
+		assert(!planner.add_device({id, 640, 480, 30.0f}, typical_camera()));
+	}
+	std::vector<bandwidth_assignment_t> plan;
+	assert(!planner.plan(plan));
+	assert(plan.size() == 3);
+	int num_yuyv = 0;
+	uint64_t total = 0;
+	for (const auto &a: plan)
+	{
+		if (a.frame_type == RAW_FRAME_UNCOMPRESSED_YUYV) num_yuyv++;
+		total += a.bandwidth;
+	}
+	assert(total <= BANDWIDTH_USB2_BUS);
+	// 18.4MB/秒×2=36.8MB/秒 + MJPEG 4.6MB/秒で収まる
+	assert(num_yuyv == 2);
+}
+
+/**
+ * 帯域内に収まらない場合/要求を満たす映像設定が無い場合はエラー
+ */
+static void test_infeasible()
+{
+	{
+		BandwidthPlanner planner;
+		assert(planner.add_device({1, 3840, 2160, 30.0f}, typical_camera()) < 0);
+	}
+	{
+		// 小さい帯域を指定して2台分が収まらないようにする
+		BandwidthPlanner planner(5000000ULL);
+		assert(!planner.add_device({1, 1280, 720, 30.0f}, typical_camera()));
+		assert(!planner.add_device({2, 1280, 720, 30.0f}, typical_camera()));
+		std::vector<bandwidth_assignment_t> plan;
+		assert(planner.plan(plan) < 0);
+		assert(plan.empty());
+	}
+}
+
+/**
+ * 連続値(min/max/step)のフレームインターバルでも要求を満たすフレームレートを選択すること
+ */
+static void test_continuous_interval()
+{
+	static uint32_t continuous[] = { 333333, 2000000, 333333 };	// 30fps〜5fps, 1/30秒刻み
+	auto size = make_size(RAW_FRAME_UNCOMPRESSED_NV12, 640, 480);
+	size.frame_interval_type = 0;
+	size.frame_intervals = continuous;
+	BandwidthPlanner planner;
+	assert(!planner.add_device({1, 0, 0, 14.0f}, { size }));
+	std::vector<bandwidth_assignment_t> plan;
+	assert(!planner.plan(plan));
+	// 15fps(666666)が14fps以上で最も低いフレームレート
+	assert(plan[0].frame_interval == 666666);
+	// 帯域はネゴシエーションされる30fpsで見積もる
+	assert(plan[0].negotiated_interval == 333333);
+	assert(plan[0].bandwidth == BandwidthPlanner::estimate_bandwidth(
+		RAW_FRAME_UNCOMPRESSED_NV12, 640, 480, 333333));
+}
+
+/**
+ * 低いフレームレートを要求してもUVC機器は最高フレームレートで送ってくるので
+ * 帯域はネゴシエーションされるフレームレートで見積もること
+ */
+static void test_negotiated_frame_rate()
+{
+	// 640x480 YUYVは10fpsなら約6MB/秒×3台で収まるが, 実際には30fps(約18MB/秒)で届く
+	BandwidthPlanner planner;
+	for (int32_t id = 1; id <= 3; id++)
+	{
+		assert(!planner.add_device({id, 640, 480, 10.0f}, typical_camera()));
+	}
+	std::vector<bandwidth_assignment_t> plan;
+	assert(!planner.plan(plan));
+	int num_yuyv = 0;
+	uint64_t total = 0;
+	for (const auto &a: plan)
+	{
+		assert(a.frame_interval == 1000000);
+		assert(a.negotiated_interval == 333333);
+		if (a.frame_type == RAW_FRAME_UNCOMPRESSED_YUYV) num_yuyv++;
+		total += a.bandwidth;
+	}
+	assert(total <= BANDWIDTH_USB2_BUS);
+	assert(num_yuyv == 2);
+}
+
+int main()
+{
+	test_single_device_prefers_uncompressed();
+	test_lowest_sufficient_frame_rate();
+	test_two_devices_fall_back_to_mjpeg();
+	test_three_devices_share_bus();
+	test_infeasible();
+	test_continuous_interval();
+	test_negotiated_frame_rate();
+	printf("bandwidth_planner_test: OK\n");
+	return 0;
+}
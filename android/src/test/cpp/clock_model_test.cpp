@@ -0,0 +1,155 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * 機器側PTSからCLOCK_MONOTONICへのクロックモデル(PtsClockModel)のホスト上でのユニットテスト
+ *
+ * android/src/main/cppをホストのcmakeでビルドしてctestで実行する
+ *   cmake -S android/src/main/cpp -B build && cmake --build build && ctest --test-dir build
+ */
+
+#undef NDEBUG
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "flutter_clock_model.h"
+
+using namespace serenegiant::flutter;
+
+#define FRAME_INTERVAL_NS (33333333LL)
+
+/**
+ * 機器側クロックのずれと到着時刻の揺らぎを加えたフレームを入力して
+ * 出力したタイムスタンプの間隔のフレームインターバルからのずれの最大値を返す
+ * @param model
+ * @param frames
+ * @param drift_ppm 機器側クロックのずれ[ppm]
+ * @param jitter_ns 到着時刻の遅れの最大値[ナノ秒](0〜jitter_nsの一様分布)
+ * @param start_frame 最初のフレーム番号
+ * @param pts_base_us フレーム番号0のPTS[マイクロ秒]
+ * @return 推定が落ち着いた後半のフレームでの出力間隔のずれの最大値[ナノ秒]
+ */
+static int64_t feed(PtsClockModel &model, const int &frames,
+	const double &drift_ppm, const int64_t &jitter_ns, const int &start_frame = 0,
+	const int64_t &pts_base_us = 5000000LL)
+{
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<int64_t> jitter(0, jitter_ns);
+	const int64_t base_ns = 1000000000LL;
+	int64_t last = 0;
+	int64_t max_error = 0;
+	for (int i = start_frame; i < start_frame + frames; i++)
+	{
+		const int64_t capture_ns = base_ns + i * FRAME_INTERVAL_NS;
+		const int64_t pts_us = pts_base_us
+			+ std::llround(i * FRAME_INTERVAL_NS * (1.0 + drift_ppm * 1.0e-6) / 1000.0);
+		const int64_t arrival_ns = capture_ns + 2000000LL + (jitter_ns ? jitter(random) : 0);
+		const int64_t ts = model.update(pts_us, arrival_ns);
+		// タイムスタンプは単調増加する
+		assert(ts > last);
+		if (last && (i - start_frame > frames / 2))
+		{
+			max_error = std::max<int64_t>(max_error, std::llabs(ts - last - FRAME_INTERVAL_NS));
+			// 推定が落ち着けば揺らぎの無い到着時刻(撮影時刻+最小の転送遅れ)との差は揺らぎより十分小さい
+			assert(std::llabs(ts - (capture_ns + 2000000LL)) < 1000000LL);
+		}
+		last = ts;
+	}
+	return max_error;
+}
+
+/**
+ * 到着時刻が揺らいでも出力するタイムスタンプは等間隔になり
+ * 測定した揺らぎを統計情報として返すこと
+ */
+static void test_jitter()
+{
+	PtsClockModel model;
+	const int64_t jitter_ns = 8000000LL;
+	const auto max_error = feed(model, 600, 0.0, jitter_ns);
+	// 到着時刻は最大8ms揺らぐが出力間隔のずれはPTSの丸め誤差程度
+	assert(max_error < 50000);
+
+	clock_stats_t stats;
+	model.get_stats(stats);
+	assert(stats.frames == 600 && stats.resets == 0 && stats.no_pts == 0);
+	assert(stats.samples == CLOCK_MODEL_WINDOW);
+	assert(std::fabs(stats.drift_ppm) < 200.0);
+	// 0〜8msの一様分布の標準偏差は約2.3ms
+	assert(stats.jitter_ns > 1500000 && stats.jitter_ns < 3200000);
+	assert(stats.max_jitter_ns <= jitter_ns + 1000000 && stats.max_jitter_ns > jitter_ns / 2);
+	assert(stats.pacing_ns > 0 && stats.pacing_ns <= stats.max_jitter_ns);
+	// 出力時刻はタイムスタンプに遅れ分を加えた時刻
+	assert(model.pacing_target_ns(1000) == 1000 + stats.pacing_ns);
+}
+
+/**
+ * 機器側クロックのずれを推定できること
+ */
+static void test_drift()
+{
+	PtsClockModel model;
+	const auto max_error = feed(model, 600, 300.0, 0);
+	assert(max_error < 50000);
+	clock_stats_t stats;
+	model.get_stats(stats);
+	assert(std::fabs(stats.drift_ppm - 300.0) < 20.0);
+	assert(stats.jitter_ns < 100000);
+}
+
+/**
+ * PTSが巻き戻ったらやり直し, PTSが無ければ到着時刻をそのまま使うこと
+ */
+static void test_discontinuity()
+{
+	PtsClockModel model;
+	feed(model, 100, 0.0, 0);
+	// 機器側の再起動でPTSが最初からになった
+	feed(model, 50, 0.0, 0, 200, 100000LL);
+	clock_stats_t stats;
+	model.get_stats(stats);
+	assert(stats.resets == 1);
+	assert(stats.samples == 50);
+
+	// PTSが無い機器
+	PtsClockModel no_pts;
+	assert(no_pts.update(0, 1000) == 1000);
+	assert(no_pts.update(0, 2000) == 2000);
+	// 到着時刻が戻っても単調増加する
+	assert(no_pts.update(0, 1500) == 2001);
+	no_pts.get_stats(stats);
+	assert(stats.no_pts == 3 && stats.samples == 0);
+
+	no_pts.reset();
+	no_pts.get_stats(stats);
+	assert(!stats.frames && !stats.no_pts);
+	assert(no_pts.update(0, 10) == 10);
+}
+
+int main()
+{
+	test_jitter();
+	test_drift();
+	test_discontinuity();
+
+	printf("clock_model_test: OK\n");
+	return 0;
+}
@@ -0,0 +1,280 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * 映像の消費者の参照カウント(ConsumerRegistry)のホスト上でのユニットテスト
+ *
+ * android/src/main/cppをホストのcmakeでビルドしてctestで実行する
+ *   cmake -S android/src/main/cpp -B build && cmake --build build && ctest --test-dir build
+ */
+
+#undef NDEBUG
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "flutter_consumer_registry.h"
+
+using namespace serenegiant::flutter;
+
+/**
+ * 映像取得の開始/終了回数を数えるだけの疑似機器
+ */
+struct FakeStream {
+	std::atomic<int> starts{0};
+	std::atomic<int> stops{0};
+	std::atomic<bool> streaming{false};
+	std::atomic<int> start_result{0};
+
+	StreamControl start_func()
+	{
+		return [this]() {
+			const int result = start_result;
+			if (result) return result;
+			starts++;
+			streaming = true;
+			return 0;
+		};
+	}
+	StreamControl stop_func()
+	{
+		return [this]() {
+			stops++;
+			streaming = false;
+			return 0;
+		};
+	}
+};
+
+/**
+ * 条件を満たすまで最大timeout_ms待つ
+ */
+template<typename Pred>
+static bool wait_for(Pred pred, const int &timeout_ms = 3000)
+{
+	const auto limit = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	while (!pred()) {
+		if (std::chrono::steady_clock::now() > limit) return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+	return true;
+}
+
+/**
+ * 種類毎に参照カウントすること
+ * 登録していない消費者の解除はエラーになること
+ */
+static void test_refcount()
+{
+	FakeStream stream;
+	ConsumerRegistry registry(stream.start_func(), stream.stop_func(), -1);
+	assert(registry.acquire(CONSUMER_PREVIEW) == 1);
+	assert(registry.acquire(CONSUMER_PREVIEW) == 2);
+	assert(registry.acquire(CONSUMER_ANALYSIS) == 1);
+	assert(registry.has_consumer(CONSUMER_PREVIEW));
+	assert(!registry.has_consumer(CONSUMER_RECORDING));
+	assert(registry.release(CONSUMER_PREVIEW) == 1);
+	assert(registry.release(CONSUMER_RECORDING) == -EINVAL);
+	assert(registry.acquire(CONSUMER_NUM) == -EINVAL);
+	assert(registry.release((consumer_type_t)-1) == -EINVAL);
+
+	consumer_metrics_t metrics;
+	registry.get_metrics(metrics);
+	assert(metrics.consumers[CONSUMER_PREVIEW] == 1);
+	assert(metrics.consumers[CONSUMER_RECORDING] == 0);
+	assert(metrics.consumers[CONSUMER_ANALYSIS] == 1);
+	assert(!metrics.started && !metrics.suspended);
+	// startしていなければ映像取得の開始/終了処理を呼ばない
+	assert(!stream.starts && !stream.stops);
+}
+
+/**
+ * 消費者がいなければ猶予時間の経過後に一時停止して
+ * 消費者を登録するとすぐに再開すること
+ */
+static void test_suspend_resume()
+{
+	FakeStream stream;
+	ConsumerRegistry registry(stream.start_func(), stream.stop_func(), 20);
+	assert(registry.acquire(CONSUMER_PREVIEW) == 1);
+	assert(!registry.start());
+	assert(stream.starts == 1);
+	// 消費者がいる間は一時停止しない
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	assert(!registry.is_suspended() && stream.streaming);
+
+	assert(registry.release(CONSUMER_PREVIEW) == 0);
+	assert(wait_for([&] { return registry.is_suspended(); }));
+	assert(!stream.streaming && (stream.stops == 1));
+	assert(registry.is_started());
+	assert(!registry.wait_resumed(1));
+
+	// 別スレッドで待機中に消費者を登録すると再開する
+	std::atomic<bool> resumed(false);
+	std::thread waiter([&]() {
+		while (!registry.wait_resumed(10)) {}
+		resumed = true;
+	});
+	assert(registry.acquire(CONSUMER_RECORDING) == 1);
+	assert(stream.streaming && (stream.starts == 2));
+	waiter.join();
+	assert(resumed);
+
+	consumer_metrics_t metrics;
+	registry.get_metrics(metrics);
+	assert(metrics.suspend_count == 1 && metrics.resume_count == 1);
+	assert(metrics.total_suspended_ns > 0);
+	assert(metrics.last_resume_ns >= 0);
+
+	// 一時停止していなければstopで終了処理を呼ぶ
+	assert(!registry.stop());
+	assert(stream.stops == 2);
+	assert(!registry.is_started());
+}
+
+/**
+ * 猶予時間の間に消費者が登録されれば一時停止しないこと
+ */
+static void test_grace_period()
+{
+	FakeStream stream;
+	ConsumerRegistry registry(stream.start_func(), stream.stop_func(), 100);
+	assert(!registry.start());
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	assert(registry.acquire(CONSUMER_ANALYSIS) == 1);
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	assert(!registry.is_suspended() && (stream.stops == 0));
+	// 解除し直すと猶予時間を最初から数える
+	assert(registry.release(CONSUMER_ANALYSIS) == 0);
+	assert(wait_for([&] { return registry.is_suspended(); }));
+	// 一時停止中のstopでは終了処理を呼ばない
+	assert(!registry.stop());
+	assert(stream.stops == 1);
+	assert(!registry.is_suspended() && !registry.is_started());
+	// stop後は消費者が来ても開始しない
+	assert(registry.acquire(CONSUMER_PREVIEW) == 1);
+	assert(stream.starts == 1);
+}
+
+/**
+ * 猶予時間が負なら一時停止せず, 後から猶予時間をセットすると一時停止すること
+ */
+static void test_disabled()
+{
+	FakeStream stream;
+	ConsumerRegistry registry(stream.start_func(), stream.stop_func(), -1);
+	assert(!registry.start());
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	assert(!registry.is_suspended());
+	registry.set_idle_timeout(10);
+	assert(wait_for([&] { return registry.is_suspended(); }));
+	assert(!registry.stop());
+}
+
+/**
+ * 再開に失敗したらエラーを返し, 消費者の登録は残して再開できるまで再試行すること
+ */
+static void test_resume_error()
+{
+	FakeStream stream;
+	ConsumerRegistry registry(stream.start_func(), stream.stop_func(), 0);
+	assert(!registry.start());
+	assert(wait_for([&] { return registry.is_suspended(); }));
+	stream.start_result = -EIO;
+	assert(registry.acquire(CONSUMER_PREVIEW) == -EIO);
+	assert(registry.is_suspended());
+	std::this_thread::sleep_for(std::chrono::milliseconds(RESUME_RETRY_MS * 2));
+	assert(registry.is_suspended() && !stream.streaming);
+	// 登録自体は残っているので開始できるようになれば再開する
+	stream.start_result = 0;
+	assert(wait_for([&] { return !registry.is_suspended(); }));
+	assert(stream.streaming);
+	consumer_metrics_t metrics;
+	registry.get_metrics(metrics);
+	assert(metrics.consumers[CONSUMER_PREVIEW] == 1);
+	assert(metrics.resume_count == 1);
+	assert(!registry.stop());
+}
+
+/**
+ * 映像取得中のrestartは終了→指定処理→再開の順に呼び
+ * 映像取得中でなければ指定処理だけを呼ぶこと
+ */
+static void test_restart()
+{
+	FakeStream stream;
+	ConsumerRegistry registry(stream.start_func(), stream.stop_func(), -1);
+	int calls = 0;
+	// 映像取得前は指定処理だけ
+	assert(!registry.restart([&]() { calls++; return 0; }));
+	assert((calls == 1) && !stream.starts && !stream.stops);
+
+	assert(!registry.start());
+	assert(!registry.restart([&]() {
+		// 指定処理は映像取得を終了している間に呼ぶ
+		assert(!stream.streaming);
+		calls++;
+		return 0;
+	}));
+	assert((calls == 2) && (stream.starts == 2) && (stream.stops == 1));
+	assert(stream.streaming && !registry.is_suspended());
+
+	// 指定処理が失敗しても映像取得は再開してエラーを返す
+	assert(registry.restart([&]() { return -EBUSY; }) == -EBUSY);
+	assert(stream.streaming && (stream.starts == 3));
+
+	// 再開に失敗したら一時停止中として扱って消費者の登録で再試行できる
+	stream.start_result = -EIO;
+	assert(registry.restart([&]() { return 0; }) == -EIO);
+	assert(registry.is_suspended() && !stream.streaming);
+	stream.start_result = 0;
+	assert(registry.acquire(CONSUMER_PREVIEW) == 1);
+	assert(!registry.is_suspended() && stream.streaming);
+
+	// 消費者がいれば再開できるまで再試行する
+	stream.start_result = -EIO;
+	assert(registry.restart([&]() { return 0; }) == -EIO);
+	assert(registry.is_suspended() && !stream.streaming);
+	stream.start_result = 0;
+	assert(wait_for([&] { return !registry.is_suspended(); }));
+	assert(stream.streaming);
+
+	// 一時停止中は指定処理だけ
+	assert(!registry.release(CONSUMER_PREVIEW));
+	registry.set_idle_timeout(0);
+	assert(wait_for([&] { return registry.is_suspended(); }));
+	const int starts = stream.starts;
+	assert(!registry.restart([&]() { calls++; return 0; }));
+	assert(registry.is_suspended() && (stream.starts == starts));
+	assert(!registry.stop());
+}
+
+int main()
+{
+	test_refcount();
+	test_suspend_resume();
+	test_grace_period();
+	test_disabled();
+	test_resume_error();
+	test_restart();
+
+	printf("consumer_registry_test: OK\n");
+	return 0;
+}
@@ -0,0 +1,142 @@
+/**
+ * FrameBurst host unit test
+ *
+ * Checks the slot limits, that frames pushed or fetched into the slots come
+ * back in order without reallocating the slots, that the consumer wakes up
+ * when the burst is full, and that the burst is encoded to JPEG on the pool.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#undef NDEBUG
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "aandusb/aandusb_native.h"
+#include "flutter_frame_burst.h"
+#include "flutter_still_capture.h"
+
+using namespace serenegiant::flutter;
+
+static void testReserve() {
+  FrameBurst burst;
+  assert(burst.reserve(0, 1024) == -EINVAL);
+  assert(burst.reserve(BURST_MAX_FRAMES + 1, 1024) == -EINVAL);
+  assert(burst.reserve(10, 0) == -EINVAL);
+  assert(burst.reserve(BURST_MAX_FRAMES, BURST_MAX_BYTES / 10) == -ENOMEM);
+
+  assert(burst.reserve(BURST_MAX_FRAMES, 1920 * 1080 * 2) == 0);
+  assert(burst.capacity() == BURST_MAX_FRAMES);
+  assert(burst.slotBytes() == 1920 * 1080 * 2);
+  assert(burst.size() == 0 && !burst.full());
+}
+
+static void testPush() {
+  FrameBurst burst;
+  assert(burst.reserve(4, 64) == 0);
+  const uint8_t *first = burst.nextSlot();
+  std::vector<uint8_t> frame(64);
+
+  for (uint32_t i = 0; i < 4; i++) {
+    memset(frame.data(), (int)i + 1, frame.size());
+    if (i == 2) {
+      // Too large for a slot, dropped and the slot stays free
+      std::vector<uint8_t> large(65);
+      assert(burst.push(large.data(), large.size(), RAW_FRAME_MJPEG, 8, 8,
+                        0) == -ENOSPC);
+    }
+    assert(burst.push(frame.data(), 32 + i, RAW_FRAME_UNCOMPRESSED_YUYV, 8,
+                      4, 1000 * i) == 0);
+  }
+  assert(burst.full() && burst.size() == 4 && burst.dropped() == 1);
+  assert(!burst.nextSlot());
+  assert(burst.push(frame.data(), 32, RAW_FRAME_UNCOMPRESSED_YUYV, 8, 4,
+                    0) == -ENOBUFS);
+  assert(burst.wait(0));
+
+  for (uint32_t i = 0; i < 4; i++) {
+    const auto &f = burst.at(i);
+    // The slots are laid out back to back and never move
+    assert(f.data == first + i * 64);
+    assert(f.len == 32 + i && f.pts_us == 1000 * i);
+    assert(f.frame_type == RAW_FRAME_UNCOMPRESSED_YUYV);
+    assert(f.width == 8 && f.height == 4);
+    assert(f.data[0] == i + 1 && f.data[f.len - 1] == i + 1);
+  }
+
+  // Reserving again starts a new burst
+  assert(burst.reserve(2, 64) == 0);
+  assert(burst.size() == 0 && burst.dropped() == 0);
+}
+
+static void testFetchAndWait() {
+  FrameBurst burst;
+  assert(burst.reserve(8, 16) == 0);
+  assert(!burst.wait(10));
+
+  std::thread producer([&burst]() {
+    for (uint32_t i = 0; i < 8; i++) {
+      uint8_t *slot = burst.nextSlot();
+      assert(slot);
+      // As uvc_get_frame would, straight into the slot
+      memset(slot, (int)i, 16);
+      burst.commit(16, RAW_FRAME_UNCOMPRESSED_YUYV, 4, 2, i);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+  assert(burst.wait(3000));
+  producer.join();
+  for (uint32_t i = 0; i < 8; i++) {
+    assert(burst.at(i).data[15] == i && burst.at(i).pts_us == i);
+  }
+}
+
+static void testEncode() {
+  const uint32_t width = 64, height = 48;
+  std::vector<uint8_t> yuyv(width * height * 2);
+  for (size_t i = 0; i < yuyv.size(); i += 2) {
+    yuyv[i] = 126;
+    yuyv[i + 1] = 128;
+  }
+  TaskPool pool(2);
+  FrameBurst burst;
+  assert(burst.reserve(6, yuyv.size()) == 0);
+  for (int i = 0; i < 6; i++) {
+    assert(burst.push(yuyv.data(), yuyv.size(), RAW_FRAME_UNCOMPRESSED_YUYV,
+                      width, height, i * 33333) == 0);
+  }
+  assert(!burst.encoded());
+  assert(burst.encode(pool, 1) == 0);
+  assert(burst.encoded());
+  for (uint32_t i = 0; i < 6; i++) {
+    const auto &f = burst.at(i);
+    assert(f.frame_type == RAW_FRAME_MJPEG);
+    assert(f.width == width && f.height == height && f.pts_us == i * 33333);
+    assert(jpegHasHuffmanTables(f.data, f.len));
+  }
+
+  // A frame that can not be encoded fails the whole batch
+  FrameBurst broken;
+  assert(broken.reserve(2, yuyv.size()) == 0);
+  assert(broken.push(yuyv.data(), yuyv.size(), RAW_FRAME_UNCOMPRESSED_YUYV,
+                     width, height, 0) == 0);
+  assert(broken.push(yuyv.data(), 100, RAW_FRAME_UNCOMPRESSED_YUYV, width,
+                     height, 0) == 0);
+  assert(broken.encode(pool, 1) == -ENOSPC);
+  assert(!broken.encoded());
+  assert(broken.at(0).frame_type == RAW_FRAME_UNCOMPRESSED_YUYV);
+}
+
+int main() {
+  testReserve();
+  testPush();
+  testFetchAndWait();
+  testEncode();
+  printf("frame_burst_test: OK\n");
+  return 0;
+}
@@ -0,0 +1,291 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * 映像フレームの記録ファイル(FrameCaptureWriter/FrameCaptureReader/FrameReplaySource)の
+ * ホスト上でのユニットテスト
+ *
+ * android/src/main/cppをホストのcmakeでビルドしてctestで実行する
+ *   cmake -S android/src/main/cpp -B build && cmake --build build && ctest --test-dir build
+ */
+
+#undef NDEBUG
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "flutter_frame_capture.h"
+#include "flutter_uvc_frame_renderer.h"
+#include "host_native_window.h"
+#include "synthetic_uvc.h"
+
+using namespace serenegiant::flutter;
+
+static std::string temp_path(const char *name)
+{
+	char path[256];
+	snprintf(path, sizeof(path), "/tmp/%s_%d.uvccap", name, (int)getpid());
+	return path;
+}
+
+template<typename Pred>
+static bool wait_for(Pred pred, const int &timeout_ms = 3000)
+{
+	const auto limit = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	while (!pred()) {
+		if (std::chrono::steady_clock::now() > limit) return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+	return true;
+}
+
+/**
+ * i番目の映像フレームのデータ, 長さがフレーム毎に異なるようにする
+ */
+static std::vector<uint8_t> make_payload(const int &i)
+{
+	std::vector<uint8_t> data(100 + i * 37);
+	for (size_t j = 0; j < data.size(); j++) {
+		data[j] = (uint8_t)(i * 13 + j);
+	}
+	return data;
+}
+
+static void write_frames(FrameCaptureWriter &writer, const int &num, const int64_t &interval_us)
+{
+	for (int i = 0; i < num; i++) {
+		const auto data = make_payload(i);
+		assert(!writer.write(RAW_FRAME_MJPEG, 640, 480,
+			data.data(), data.size(), 1000000 + i * interval_us, i & 1));
+	}
+}
+
+/**
+ * 書き込んだ映像フレームをそのまま読み込めること
+ */
+static void test_roundtrip()
+{
+	const auto path = temp_path("roundtrip");
+	{
+		FrameCaptureWriter writer;
+		assert(!writer.open(path));
+		assert(writer.is_opened());
+		write_frames(writer, 10, 33333);
+		assert(writer.num_frames() == 10);
+		assert(!writer.close());
+		assert(!writer.is_opened());
+		// クローズ後は書き込めない
+		uint8_t dummy = 0;
+		assert(writer.write(RAW_FRAME_MJPEG, 1, 1, &dummy, 1, 0, 0));
+	}
+	FrameCaptureReader reader;
+	assert(!reader.open(path));
+	assert(reader.is_complete());
+	assert(reader.num_frames() == 10);
+	for (int i = 0; i < 10; i++) {
+		capture_frame_t frame;
+		assert(!reader.get(i, frame));
+		const auto expected = make_payload(i);
+		assert(frame.frame_type == RAW_FRAME_MJPEG);
+		assert(frame.width == 640 && frame.height == 480);
+		assert(frame.flags == (uint32_t)(i & 1));
+		assert(frame.pts_us == 1000000 + i * 33333);
+		assert(frame.data_len == expected.size());
+		assert(!memcmp(frame.data, expected.data(), expected.size()));
+		// 記録データは8バイト境界に揃える
+		assert(((uintptr_t)frame.data & (FRAME_CAPTURE_ALIGNMENT - 1)) == 0);
+	}
+	capture_frame_t frame;
+	assert(reader.get(10, frame) == -ENOENT);
+	// pts以降の最初の映像フレームを返すこと
+	assert(reader.find(0) == 0);
+	assert(reader.find(1000000 + 33333 * 3) == 3);
+	assert(reader.find(1000000 + 33333 * 3 + 1) == 4);
+	assert(reader.find(INT64_MAX) == 10);
+	reader.close();
+	unlink(path.c_str());
+}
+
+/**
+ * クローズされていない/途中で切れた記録ファイルもインデックスを再構築して読み込めること
+ */
+static void test_rebuild_index()
+{
+	const auto path = temp_path("rebuild");
+	uint64_t bytes = 0;
+	{
+		FrameCaptureWriter writer;
+		assert(!writer.open(path));
+		write_frames(writer, 5, 33333);
+		bytes = writer.bytes();
+		assert(!writer.close());
+	}
+	// インデックスを削除してヘッダーをクローズ前の状態へ戻した上で最後の記録を途中で切る
+	{
+		FILE *fp = fopen(path.c_str(), "r+b");
+		assert(fp);
+		frame_capture_header_t header;
+		assert(fread(&header, sizeof(header), 1, fp) == 1);
+		header.index_offset = 0;
+		header.num_frames = 0;
+		fseek(fp, 0, SEEK_SET);
+		assert(fwrite(&header, sizeof(header), 1, fp) == 1);
+		fclose(fp);
+		assert(!truncate(path.c_str(), bytes - 10));
+	}
+	FrameCaptureReader reader;
+	assert(!reader.open(path));
+	assert(!reader.is_complete());
+	assert(reader.num_frames() == 4);
+	capture_frame_t frame;
+	assert(!reader.get(3, frame));
+	const auto expected = make_payload(3);
+	assert(frame.data_len == expected.size());
+	assert(!memcmp(frame.data, expected.data(), expected.size()));
+	reader.close();
+	unlink(path.c_str());
+
+	// 記録ファイルではないときはエラー
+	FILE *fp = fopen(path.c_str(), "wb");
+	fputs("not a capture file, not a capture file, not a capture file, not a capture file", fp);
+	fclose(fp);
+	assert(reader.open(path) == -EINVAL);
+	unlink(path.c_str());
+	assert(reader.open(path));
+}
+
+/**
+ * 最大速度/元の速度での再生, シーク, ループ
+ */
+static void test_replay()
+{
+	const auto path = temp_path("replay");
+	{
+		FrameCaptureWriter writer;
+		assert(!writer.open(path));
+		write_frames(writer, 5, 20000);
+		assert(!writer.close());
+	}
+	FrameReplaySource source;
+	// 最大速度なら待たずに全ての映像フレームを返してから-ENOENT
+	assert(!source.open(path, 0.0f));
+	assert(source.num_frames() == 5);
+	capture_frame_t frame;
+	for (int i = 0; i < 5; i++) {
+		assert(!source.next(frame));
+		assert(frame.pts_us == 1000000 + i * 20000);
+	}
+	assert(source.next(frame) == -ENOENT);
+	assert(!source.seek(1000000 + 20000 * 2));
+	assert(!source.next(frame));
+	assert(frame.pts_us == 1000000 + 20000 * 2);
+
+	// uvc_get_frameと同じ引数での取得, バッファが足りないときは消費しない
+	assert(!source.seek(0));
+	std::vector<uint8_t> buffer(16);
+	uint32_t frame_type = 0, width = 0, height = 0, flags = 0;
+	uint32_t data_len = buffer.size();
+	int64_t pts_us = 0;
+	assert(source.next(&frame_type, &width, &height, buffer.data(), &data_len, &pts_us, &flags) == -ENOSPC);
+	assert(data_len == make_payload(0).size());
+	buffer.resize(4096);
+	data_len = buffer.size();
+	assert(!source.next(&frame_type, &width, &height, buffer.data(), &data_len, &pts_us, &flags));
+	assert(frame_type == RAW_FRAME_MJPEG && width == 640 && height == 480);
+	assert(pts_us == 1000000 && data_len == make_payload(0).size());
+	source.close();
+
+	// 元の速度なら記録時の間隔で返す
+	assert(!source.open(path, 1.0f, true));
+	const auto start = std::chrono::steady_clock::now();
+	int count = 0;
+	while (count < 7) {
+		const int result = source.next(frame);
+		if (!result) {
+			count++;
+		} else {
+			assert(result == -EAGAIN);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	// ループするので5フレーム目以降は先頭へ戻る
+	assert(frame.pts_us == 1000000 + 20000);
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - start).count();
+	assert(elapsed >= 80 - 5);
+	source.close();
+	unlink(path.c_str());
+}
+
+/**
+ * FlutterUvcFrameRendererで合成UVC機器の映像を記録して, 記録ファイルから再生できること
+ */
+static void test_renderer_capture_replay()
+{
+	const auto path = temp_path("renderer");
+	auto manager = manager_init(nullptr, nullptr, nullptr);
+	synthetic_uvc_config_t config;
+	synthetic_uvc_default_config(config);
+	config.max_width = 640;
+	config.max_height = 480;
+	const auto id = synthetic_uvc_attach(manager, config);
+	{
+		FlutterUvcFrameRenderer renderer(manager, id);
+		assert(!renderer.startCapture(path));
+		assert(!renderer.start(640, 480, RAW_FRAME_MJPEG));
+		assert(wait_for([&] { return renderer.getFrameCount() >= 5; }));
+		renderer.stop();
+		assert(!renderer.stopCapture());
+	}
+	manager_release(manager);
+
+	auto source = std::make_shared<FrameReplaySource>();
+	assert(!source->open(path, 0.0f));
+	const auto num_frames = source->num_frames();
+	assert(num_frames >= 5);
+	auto window = host_native_window_create(320, 240);
+	{
+		// 再生中はUVC機器へアクセスしない
+		FlutterUvcFrameRenderer renderer(nullptr, 0);
+		renderer.setReplaySource(source);
+		renderer.setPreviewWindow(window, 320, 240);
+		assert(!renderer.start(640, 480, RAW_FRAME_MJPEG));
+		assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= num_frames; }));
+		renderer.stop();
+		renderer.setPreviewWindow(nullptr);
+	}
+	ANativeWindow_release(window);
+	source->close();
+	unlink(path.c_str());
+}
+
+int main()
+{
+	test_roundtrip();
+	test_rebuild_index();
+	test_replay();
+	test_renderer_capture_replay();
+
+	printf("frame_capture_test: OK\n");
+	return 0;
+}
@@ -0,0 +1,366 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * 非圧縮映像→RGBA変換(convertToRgba/convertRegionToRgbaParallel/orientRgbx)のホスト上でのユニットテスト
+ *
+ * android/src/main/cppをホストのcmakeでビルドしてctestで実行する
+ *   cmake -S android/src/main/cpp -B build && cmake --build build && ctest --test-dir build
+ */
+
+#undef NDEBUG
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "aandusb/aandusb_native.h"
+#include "flutter_frame_converter.h"
+
+using namespace serenegiant::flutter;
+
+static void test_frame_bytes()
+{
+	assert(rawFrameBytes(RAW_FRAME_UNCOMPRESSED_YUYV, 640, 480) == 640 * 480 * 2);
+	assert(rawFrameBytes(RAW_FRAME_UNCOMPRESSED_RGB565, 640, 480) == 640 * 480 * 2);
+	assert(rawFrameBytes(RAW_FRAME_UNCOMPRESSED_NV12, 640, 480) == 640 * 480 * 3 / 2);
+	assert(rawFrameBytes(RAW_FRAME_UNCOMPRESSED_NV21, 640, 480) == 640 * 480 * 3 / 2);
+	assert(rawFrameBytes(RAW_FRAME_UNCOMPRESSED_RGBX, 640, 480) == 640 * 480 * 4);
+	assert(rawFrameBytes(RAW_FRAME_MJPEG, 640, 480) == 0);
+	assert(rawFrameBytes(RAW_FRAME_H264, 640, 480) == 0);
+}
+
+/**
+ * グレー(U=V=128)は輝度がそのままRGBになること
+ * YUYV/NV12/NV21で同じ結果になること
+ */
+static void test_yuv()
+{
+	const uint32_t width = 4, height = 2;
+	const uint8_t Y[] = { 16, 80, 160, 235, 0, 255, 128, 64 };
+	std::vector<uint8_t> yuyv(width * height * 2);
+	std::vector<uint8_t> nv12(width * height * 3 / 2, 128);
+	for (uint32_t i = 0; i < width * height; i++) {
+		yuyv[i * 2] = Y[i];
+		yuyv[i * 2 + 1] = 128;
+		nv12[i] = Y[i];
+	}
+	std::vector<uint8_t> rgba(width * height * 4);
+	for (const auto frame_type : { RAW_FRAME_UNCOMPRESSED_YUYV, RAW_FRAME_UNCOMPRESSED_NV12, RAW_FRAME_UNCOMPRESSED_NV21 }) {
+		const auto &src = frame_type == RAW_FRAME_UNCOMPRESSED_YUYV ? yuyv : nv12;
+		memset(rgba.data(), 0, rgba.size());
+		assert(!convertToRgba(frame_type, src.data(), src.size(), width, height, rgba.data(), width * 4));
+		for (uint32_t i = 0; i < width * height; i++) {
+			assert(rgba[i * 4] == Y[i] && rgba[i * 4 + 1] == Y[i] && rgba[i * 4 + 2] == Y[i]);
+			assert(rgba[i * 4 + 3] == 255);
+		}
+	}
+
+	// NV12はUV, NV21はVUの順
+	nv12[width * height] = 255;		// NV12ならU(青), NV21ならV(赤)
+	nv12[width * height + 1] = 128;
+	assert(!convertToRgba(RAW_FRAME_UNCOMPRESSED_NV12, nv12.data(), nv12.size(), width, height, rgba.data(), width * 4));
+	assert(rgba[1 * 4 + 2] > rgba[1 * 4]);
+	assert(!convertToRgba(RAW_FRAME_UNCOMPRESSED_NV21, nv12.data(), nv12.size(), width, height, rgba.data(), width * 4));
+	assert(rgba[1 * 4] > rgba[1 * 4 + 2]);
+}
+
+static void test_rgb()
+{
+	const uint32_t width = 2, height = 1;
+	// 赤, 白
+	const uint8_t rgb565[] = { 0x00, 0xf8, 0xff, 0xff };
+	std::vector<uint8_t> rgba(width * height * 4);
+	assert(!convertToRgba(RAW_FRAME_UNCOMPRESSED_RGB565, rgb565, sizeof(rgb565), width, height, rgba.data(), width * 4));
+	const uint8_t expected[] = { 255, 0, 0, 255, 255, 255, 255, 255 };
+	assert(!memcmp(rgba.data(), expected, sizeof(expected)));
+
+	// RGBXのパディングは不透明にする
+	const uint8_t rgbx[] = { 1, 2, 3, 0, 4, 5, 6, 7 };
+	assert(!convertToRgba(RAW_FRAME_UNCOMPRESSED_RGBX, rgbx, sizeof(rgbx), width, height, rgba.data(), width * 4));
+	const uint8_t expected_rgbx[] = { 1, 2, 3, 255, 4, 5, 6, 255 };
+	assert(!memcmp(rgba.data(), expected_rgbx, sizeof(expected_rgbx)));
+}
+
+/**
+ * 出力先のストライドが幅より大きいときは行末を書き換えないこと
+ */
+static void test_stride()
+{
+	const uint32_t width = 2, height = 2, stride = 12;
+	const uint8_t rgbx[] = { 1, 2, 3, 0, 4, 5, 6, 0, 7, 8, 9, 0, 10, 11, 12, 0 };
+	std::vector<uint8_t> rgba(stride * height, 0xaa);
+	assert(!convertToRgba(RAW_FRAME_UNCOMPRESSED_RGBX, rgbx, sizeof(rgbx), width, height, rgba.data(), stride));
+	assert(rgba[8] == 0xaa && rgba[11] == 0xaa);
+	assert(rgba[12] == 7 && rgba[15] == 255);
+	assert(rgba[20] == 0xaa);
+}
+
+static void test_errors()
+{
+	uint8_t src[16] = {}, dst[64];
+	assert(convertToRgba(RAW_FRAME_MJPEG, src, sizeof(src), 2, 2, dst, 8) == -EINVAL);
+	assert(convertToRgba(RAW_FRAME_H264, src, sizeof(src), 2, 2, dst, 8) == -EINVAL);
+	assert(convertToRgba(RAW_FRAME_UNCOMPRESSED_YUYV, nullptr, sizeof(src), 2, 2, dst, 8) == -EINVAL);
+	assert(convertToRgba(RAW_FRAME_UNCOMPRESSED_YUYV, src, sizeof(src), 2, 2, dst, 4) == -EINVAL);
+	assert(convertToRgba(RAW_FRAME_UNCOMPRESSED_RGBX, src, 8, 2, 2, dst, 8) == -ENOSPC);
+}
+
+/**
+ * 小さいフレームやワーカースレッドが1つなら分割しないこと
+ * 大きいフレームでもワーカースレッド毎の上限を超えて分割しないこと
+ */
+static void test_stripe_count()
+{
+	assert(selectStripeCount(RAW_FRAME_UNCOMPRESSED_YUYV, 640, 480, 8) == 1);
+	assert(selectStripeCount(RAW_FRAME_UNCOMPRESSED_YUYV, 3840, 2160, 1) == 1);
+	assert(selectStripeCount(RAW_FRAME_MJPEG, 3840, 2160, 8) == 1);
+	assert(selectStripeCount(RAW_FRAME_UNCOMPRESSED_YUYV, 3840, 2160, 2) == 2 * STRIPES_PER_WORKER);
+	const uint32_t stripes = selectStripeCount(RAW_FRAME_UNCOMPRESSED_NV12, 3840, 2160, 64);
+	assert(stripes > 8 && stripes < 64 * STRIPES_PER_WORKER);
+}
+
+/**
+ * 分割して並列に変換しても1スレッドで変換した結果と全く同じになること
+ */
+static void test_parallel()
+{
+	static const uint32_t types[] = {
+		RAW_FRAME_UNCOMPRESSED_YUYV, RAW_FRAME_UNCOMPRESSED_NV12, RAW_FRAME_UNCOMPRESSED_NV21,
+		RAW_FRAME_UNCOMPRESSED_RGB565, RAW_FRAME_UNCOMPRESSED_RGBX,
+	};
+	static const uint32_t sizes[][2] = { { 3840, 2160 }, { 1920, 1082 }, { 640, 480 } };
+	TaskPool pool(3);
+	std::mt19937 rand(1234);
+	for (const auto &type : types) {
+		for (const auto &size : sizes) {
+			const uint32_t width = size[0], height = size[1];
+			std::vector<uint8_t> src(rawFrameBytes(type, width, height));
+			for (auto &v : src) {
+				v = (uint8_t)rand();
+			}
+			std::vector<uint8_t> expected(width * height * 4), actual(width * height * 4);
+			assert(!convertToRgba(type, src.data(), src.size(), width, height, expected.data(), width * 4));
+			for (uint32_t threads = 0; threads <= 4; threads++) {
+				memset(actual.data(), 0, actual.size());
+				assert(!convertToRgbaParallel(pool, 1, TASK_PRIORITY_PREVIEW, type,
+					src.data(), src.size(), width, height, actual.data(), width * 4, threads));
+				assert(actual == expected);
+			}
+		}
+	}
+	uint8_t src[16] = {}, dst[64];
+	assert(convertToRgbaParallel(pool, 1, TASK_PRIORITY_PREVIEW, RAW_FRAME_MJPEG,
+		src, sizeof(src), 2, 2, dst, 8) == -EINVAL);
+	assert(convertToRgbaParallel(pool, 1, TASK_PRIORITY_PREVIEW, RAW_FRAME_UNCOMPRESSED_RGBX,
+		src, 8, 2, 2, dst, 8) == -ENOSPC);
+}
+
+/**
+ * 領域だけを変換すると全体を変換した結果の同じ部分と一致すること
+ * 色差を共有する画素/行の途中から始まる領域は広げること
+ */
+static void test_region()
+{
+	static const uint32_t types[] = {
+		RAW_FRAME_UNCOMPRESSED_YUYV, RAW_FRAME_UNCOMPRESSED_NV12, RAW_FRAME_UNCOMPRESSED_NV21,
+		RAW_FRAME_UNCOMPRESSED_RGB565, RAW_FRAME_UNCOMPRESSED_RGBX,
+	};
+	static const FrameRect regions[] = {
+		{ 101, 51, 333, 201 }, { 0, 0, 1920, 1080 }, { 1800, 1000, 500, 500 }, { 1280, 720, 1, 1 },
+	};
+	const uint32_t width = 1920, height = 1080;
+	TaskPool pool(3);
+	std::mt19937 rand(4321);
+	for (const auto &type : types) {
+		std::vector<uint8_t> src(rawFrameBytes(type, width, height));
+		for (auto &v : src) {
+			v = (uint8_t)rand();
+		}
+		std::vector<uint8_t> full(width * height * 4);
+		assert(!convertToRgba(type, src.data(), src.size(), width, height, full.data(), width * 4));
+		for (const auto &requested : regions) {
+			const FrameRect aligned = alignConvertRegion(type, width, height, requested);
+			const FrameRect clipped = clipRect(requested, width, height);
+			// 要求した領域を含み, フレームからはみ出さない
+			assert(aligned.x <= clipped.x && aligned.y <= clipped.y);
+			assert(aligned.x + aligned.width >= clipped.x + clipped.width);
+			assert(aligned.y + aligned.height >= clipped.y + clipped.height);
+			assert(aligned.x + aligned.width <= width && aligned.y + aligned.height <= height);
+			if (type != RAW_FRAME_UNCOMPRESSED_RGB565 && type != RAW_FRAME_UNCOMPRESSED_RGBX) {
+				assert(!(aligned.x & 1) && !(aligned.width & 1));
+			} else {
+				assert(aligned == clipped);
+			}
+			FrameRect region = requested;
+			std::vector<uint8_t> actual(aligned.width * aligned.height * 4);
+			assert(!convertRegionToRgbaParallel(pool, 1, TASK_PRIORITY_PREVIEW, type,
+				src.data(), src.size(), width, height, region, actual.data(), aligned.width * 4));
+			assert(region == aligned);
+			for (uint32_t y = 0; y < region.height; y++) {
+				assert(!memcmp(&actual[y * region.width * 4],
+					&full[((region.y + y) * width + region.x) * 4], region.width * 4));
+			}
+		}
+	}
+	// 出力先のストライドが領域の幅より小さい
+	std::vector<uint8_t> src(rawFrameBytes(RAW_FRAME_UNCOMPRESSED_YUYV, 64, 64)), dst(64 * 64 * 4);
+	FrameRect region = { 8, 8, 16, 16 };
+	assert(convertRegionToRgbaParallel(pool, 1, TASK_PRIORITY_PREVIEW, RAW_FRAME_UNCOMPRESSED_YUYV,
+		src.data(), src.size(), 64, 64, region, dst.data(), 15 * 4) == -EINVAL);
+	assert(region == FrameRect({ 8, 8, 16, 16 }));
+}
+
+/**
+ * 正立で変換してから回転/反転した結果と一致すること
+ */
+static void check_oriented(const std::vector<uint8_t> &upright, const uint32_t &upright_stride,
+	const FrameRect &rect, const FrameOrientation &orientation,
+	const uint8_t *actual, const uint32_t &stride)
+{
+	for (uint32_t y = 0; y < rect.height; y++) {
+		for (uint32_t x = 0; x < rect.width; x++) {
+			int64_t ox, oy;
+			orientPoint(orientation, rect.width, rect.height, x, y, ox, oy);
+			assert(!memcmp(&actual[oy * stride + ox * 4],
+				&upright[(rect.y + y) * upright_stride + (rect.x + x) * 4], 4));
+		}
+	}
+}
+
+/**
+ * 回転/反転しながら変換した結果が正立で変換してから回転/反転した結果と一致すること
+ * 複数スレッドで変換しても同じになること
+ */
+static void test_orientation()
+{
+	static const uint32_t types[] = {
+		RAW_FRAME_UNCOMPRESSED_YUYV, RAW_FRAME_UNCOMPRESSED_NV12, RAW_FRAME_UNCOMPRESSED_NV21,
+		RAW_FRAME_UNCOMPRESSED_RGB565, RAW_FRAME_UNCOMPRESSED_RGBX,
+	};
+	static const FrameRect regions[] = {
+		{ 0, 0, 0, 0 }, { 102, 50, 334, 202 },
+	};
+	const uint32_t width = 1280, height = 720;
+	TaskPool pool(3);
+	std::mt19937 rand(2468);
+	for (const auto &type : types) {
+		std::vector<uint8_t> src(rawFrameBytes(type, width, height));
+		for (auto &v : src) {
+			v = (uint8_t)rand();
+		}
+		std::vector<uint8_t> upright(width * height * 4);
+		assert(!convertToRgba(type, src.data(), src.size(), width, height, upright.data(), width * 4));
+		for (const auto &requested : regions) {
+			for (uint32_t rotation = 0; rotation < 360; rotation += 90) {
+				for (int mirror = 0; mirror < 4; mirror++) {
+					const FrameOrientation orientation = { rotation, (mirror & 1) != 0, (mirror & 2) != 0 };
+					FrameRect region = requested;
+					const FrameRect aligned = alignConvertRegion(type, width, height, requested);
+					uint32_t w, h;
+					orientedSize(orientation, aligned.width, aligned.height, w, h);
+					// 余白付きのストライド
+					const uint32_t stride = (w + 3) * 4;
+					std::vector<uint8_t> actual(stride * h);
+					assert(!convertRegionToRgbaParallel(pool, 1, TASK_PRIORITY_PREVIEW, type,
+						src.data(), src.size(), width, height, region, orientation,
+						actual.data(), stride, (mirror & 1) ? 1 : 0));
+					assert(region == aligned);
+					check_oriented(upright, width * 4, region, orientation, actual.data(), stride);
+				}
+			}
+		}
+	}
+	// RGBA→RGBAの回転コピー
+	{
+		const FrameRect rect = { 30, 20, 100, 70 };
+		const FrameOrientation orientation = { 270, true, false };
+		std::vector<uint8_t> rgba(width * height * 4);
+		for (auto &v : rgba) {
+			v = (uint8_t)rand();
+		}
+		std::vector<uint8_t> opaque = rgba;
+		for (size_t i = 3; i < opaque.size(); i += 4) {
+			opaque[i] = 255;
+		}
+		std::vector<uint8_t> actual(rect.width * rect.height * 4);
+		assert(!orientRgbx(&rgba[(rect.y * width + rect.x) * 4], rect.width, rect.height, width * 4,
+			orientation, actual.data(), rect.height * 4));
+		check_oriented(opaque, width * 4, rect, orientation, actual.data(), rect.height * 4);
+		// 90度回転すると出力の幅は元の高さになる
+		assert(orientRgbx(rgba.data(), rect.width, rect.height, width * 4,
+			orientation, actual.data(), (rect.height - 1) * 4) == -EINVAL);
+	}
+	// 90度単位でない回転
+	std::vector<uint8_t> src(rawFrameBytes(RAW_FRAME_UNCOMPRESSED_YUYV, 64, 64)), dst(64 * 64 * 4);
+	FrameRect region;
+	assert(convertRegionToRgbaParallel(pool, 1, TASK_PRIORITY_PREVIEW, RAW_FRAME_UNCOMPRESSED_YUYV,
+		src.data(), src.size(), 64, 64, region, FrameOrientation{ 45 }, dst.data(), 64 * 4) == -EINVAL);
+}
+
+/**
+ * 同じ結果になる回転/反転の組み合わせは等しいこと
+ * relativeOrientationで別の向きに変換済みの映像から目的の向きにできること
+ */
+static void test_orientation_algebra()
+{
+	assert((FrameOrientation{ 180, true, false } == FrameOrientation{ 0, false, true }));
+	assert((FrameOrientation{ 0, true, true } == FrameOrientation{ 180, false, false }));
+	assert((FrameOrientation{ 90, true, false } != FrameOrientation{ 270, true, false }));
+	assert(FrameOrientation{ 90 }.swapsAxes() && !FrameOrientation{ 180 }.swapsAxes());
+	assert((FrameOrientation{ 0, true, true }.swapsAxes() == false));
+	const uint32_t width = 5, height = 3;
+	for (uint32_t i = 0; i < 8; i++) {
+		const FrameOrientation from = FrameOrientation::fromCanonical(i & 4, i);
+		for (uint32_t j = 0; j < 16; j++) {
+			const FrameOrientation to = { (j & 3) * 90, (j & 4) != 0, (j & 8) != 0 };
+			const FrameOrientation relative = relativeOrientation(from, to);
+			uint32_t w, h;
+			orientedSize(from, width, height, w, h);
+			for (int64_t y = 0; y < height; y++) {
+				for (int64_t x = 0; x < width; x++) {
+					int64_t fx, fy, rx, ry, tx, ty;
+					orientPoint(from, width, height, x, y, fx, fy);
+					orientPoint(relative, w, h, fx, fy, rx, ry);
+					orientPoint(to, width, height, x, y, tx, ty);
+					assert(rx == tx && ry == ty);
+				}
+			}
+		}
+	}
+	// 矩形の向き
+	assert((orientRect(FrameOrientation{ 90 }, { 1, 0, 2, 1 }, width, height) == FrameRect{ 2, 1, 1, 2 }));
+}
+
+int main()
+{
+	test_frame_bytes();
+	test_yuv();
+	test_rgb();
+	test_stride();
+	test_errors();
+	test_stripe_count();
+	test_parallel();
+	test_region();
+	test_orientation();
+	test_orientation_algebra();
+
+	printf("frame_converter_test: OK\n");
+	return 0;
+}
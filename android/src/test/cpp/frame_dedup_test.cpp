@@ -0,0 +1,138 @@
+/**
+ * FrameDedup host unit test
+ *
+ * Checks XXH64 against the reference implementation, which bytes the
+ * sampled frame hash covers, and how duplicates, invalidation and the
+ * statistics behave.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#undef NDEBUG
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "aandusb/aandusb_native.h"
+#include "flutter_frame_dedup.h"
+
+using namespace serenegiant::flutter;
+
+static const uint32_t WIDTH = 64;
+static const uint32_t HEIGHT = 48;
+
+static void testXxhash() {
+  // Values of the reference implementation (xxhash 0.8)
+  struct Vector {
+    const char *input;
+    uint64_t seed0;
+    uint64_t seed1;
+  };
+  const Vector vectors[] = {
+      {"", 0xef46db3751d8e999ULL, 0xac75fda2929b17efULL},
+      {"a", 0xd24ec4f1a98c6e5bULL, 0x393da8b78992279bULL},
+      {"abc", 0x44bc2cf5ad770999ULL, 0x1318df30094a85fdULL},
+      {"Nobody inspects the spammish repetition", 0xfbcea83c8a378bf1ULL,
+       0x56db22dd5b051147ULL},
+  };
+  const uint64_t seed = 0x9e3779b1ULL;
+  for (const auto &v : vectors) {
+    assert(xxhash64(v.input, strlen(v.input)) == v.seed0);
+    assert(xxhash64(v.input, strlen(v.input), seed) == v.seed1);
+  }
+  std::vector<uint8_t> bytes(1024);
+  for (size_t i = 0; i < bytes.size(); i++) {
+    bytes[i] = (uint8_t)i;
+  }
+  assert(xxhash64(bytes.data(), bytes.size()) == 0x6f3914f18fe4df57ULL);
+  assert(xxhash64(bytes.data(), bytes.size(), seed) == 0xb05af54d5f68bff7ULL);
+}
+
+static void testFrameHash() {
+  const uint32_t yuyv = RAW_FRAME_UNCOMPRESSED_YUYV;
+  const size_t row_bytes = WIDTH * 2;
+  std::vector<uint8_t> frame(row_bytes * HEIGHT, 16);
+  const uint64_t base = frameHash(yuyv, frame.data(), frame.size(), WIDTH,
+                                  HEIGHT, DEDUP_DEFAULT_SAMPLE_ROWS);
+  // A change in a row that is not sampled goes unnoticed...
+  std::vector<uint8_t> changed = frame;
+  changed[row_bytes * 1 + 5] = 200;
+  assert(frameHash(yuyv, changed.data(), changed.size(), WIDTH, HEIGHT,
+                   DEDUP_DEFAULT_SAMPLE_ROWS) == base);
+  // ...unless every row is hashed
+  assert(frameHash(yuyv, changed.data(), changed.size(), WIDTH, HEIGHT, 1) !=
+         frameHash(yuyv, frame.data(), frame.size(), WIDTH, HEIGHT, 1));
+  // Sampled rows and the last row are covered
+  for (uint32_t row : {0u, 4u, 44u, HEIGHT - 1}) {
+    changed = frame;
+    changed[row_bytes * row + row_bytes - 1] = 200;
+    assert(frameHash(yuyv, changed.data(), changed.size(), WIDTH, HEIGHT,
+                     DEDUP_DEFAULT_SAMPLE_ROWS) != base);
+  }
+
+  // Chroma plane of NV12
+  const uint32_t nv12 = RAW_FRAME_UNCOMPRESSED_NV12;
+  std::vector<uint8_t> nv(WIDTH * HEIGHT * 3 / 2, 128);
+  const uint64_t nv_base =
+      frameHash(nv12, nv.data(), nv.size(), WIDTH, HEIGHT, 4);
+  nv[WIDTH * (HEIGHT + 4)] = 0;
+  assert(frameHash(nv12, nv.data(), nv.size(), WIDTH, HEIGHT, 4) != nv_base);
+
+  // MJPEG is hashed completely
+  std::vector<uint8_t> mjpeg(3000, 1);
+  const uint64_t jpeg_base = frameHash(RAW_FRAME_MJPEG, mjpeg.data(),
+                                       mjpeg.size(), WIDTH, HEIGHT, 4);
+  assert(jpeg_base == xxhash64(mjpeg.data(), mjpeg.size()));
+  mjpeg[1234] = 2;
+  assert(frameHash(RAW_FRAME_MJPEG, mjpeg.data(), mjpeg.size(), WIDTH, HEIGHT,
+                   4) != jpeg_base);
+}
+
+static void testDedup() {
+  FrameDedup dedup;
+  assert(dedup.configure(true, 0) == -EINVAL);
+  assert(dedup.configure(true, DEDUP_MAX_SAMPLE_ROWS + 1) == -EINVAL);
+  const uint32_t type = RAW_FRAME_UNCOMPRESSED_RGBX;
+  std::vector<uint8_t> a(WIDTH * HEIGHT * 4, 10), b(WIDTH * HEIGHT * 4, 20);
+  auto check = [&](const std::vector<uint8_t> &frame, uint32_t w,
+                   uint32_t h) {
+    return dedup.isDuplicate(type, frame.data(), frame.size(), w, h);
+  };
+
+  // Disabled by default
+  assert(!check(a, WIDTH, HEIGHT) && !check(a, WIDTH, HEIGHT));
+  DedupStats stats;
+  dedup.getStats(stats);
+  assert(!stats.frames && stats.ratio() == 0.0);
+
+  assert(dedup.configure(true) == 0 && dedup.enabled());
+  assert(!check(a, WIDTH, HEIGHT));
+  assert(check(a, WIDTH, HEIGHT) && check(a, WIDTH, HEIGHT));
+  assert(!check(b, WIDTH, HEIGHT) && check(b, WIDTH, HEIGHT));
+  // Same bytes but another size
+  assert(!check(b, WIDTH * 2, HEIGHT / 2));
+  // An output that needs the frame again
+  dedup.invalidate();
+  assert(!check(b, WIDTH * 2, HEIGHT / 2));
+  assert(check(b, WIDTH * 2, HEIGHT / 2));
+  dedup.getStats(stats);
+  assert(stats.frames == 8 && stats.duplicates == 4 && stats.longest_run == 2);
+  assert(stats.ratio() == 0.5);
+
+  // Disabling clears the statistics and passes every frame
+  assert(dedup.configure(false) == 0 && !dedup.enabled());
+  assert(!check(b, WIDTH * 2, HEIGHT / 2));
+  dedup.getStats(stats);
+  assert(!stats.frames && !stats.duplicates && !stats.longest_run);
+}
+
+int main() {
+  testXxhash();
+  testFrameHash();
+  testDedup();
+  printf("frame_dedup_test: OK\n");
+  return 0;
+}
@@ -0,0 +1,549 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * 複数の映像解析用コンシューマーへのフレームの配信(FrameSubscriptions)のホスト上でのユニットテスト
+ *
+ * android/src/main/cppをホストのcmakeでビルドしてctestで実行する
+ *   cmake -S android/src/main/cpp -B build && cmake --build build && ctest --test-dir build
+ */
+
+#undef NDEBUG
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "aandusb_native.h"
+#include "flutter_frame_subscription.h"
+
+using namespace serenegiant::flutter;
+
+static const int32_t DEVICE_ID = 4301;
+// 60fps
+static const int64_t INTERVAL_NS = 16666667LL;
+
+/**
+ * 条件を満たすまで最大2秒待つ
+ */
+template<typename F>
+static bool wait_for(F condition)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (!condition())
+	{
+		if (std::chrono::steady_clock::now() > deadline)
+		{
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+/**
+ * 映像取得スレッドと同じ手順で1フレームを配信する
+ * @return 配信対象の購読者がいたかどうか
+ */
+static bool deliver(
+	FrameSubscriptions &subscriptions,
+	const FrameView &raw, const DecodedFrame *rgba, const int64_t &timestamp_ns,
+	RgbaDemand *demand = nullptr)
+{
+	const auto subscribers = subscriptions.snapshot();
+	RgbaDemand rgba_demand;
+	const bool due = subscriptions.schedule(subscribers, timestamp_ns, raw.width, raw.height, rgba_demand);
+	auto on_deliver = [] {};
+	subscriptions.dispatch(subscribers, raw, on_deliver);
+	if (rgba && rgba_demand.due)
+	{
+		subscriptions.dispatch(subscribers, *rgba, on_deliver);
+	}
+	if (demand)
+	{
+		*demand = rgba_demand;
+	}
+	return due;
+}
+
+/**
+ * FunctionRefは参照先の呼び出し可能オブジェクトを呼び出すこと
+ */
+static void test_function_ref()
+{
+	FunctionRef<int(int)> empty;
+	assert(!empty);
+
+	int base = 10;
+	auto add = [&](int v) { return base + v; };
+	FunctionRef<int(int)> ref(add);
+	assert(ref);
+	assert(ref(5) == 15);
+	// 参照なので呼び出し可能オブジェクトの状態の変化が見える
+	base = 20;
+	assert(ref(5) == 25);
+	// コピーしても同じオブジェクトを参照する
+	const auto copy = ref;
+	assert(copy(1) == 21);
+	static_assert(sizeof(FrameFunctionRef) == 2 * sizeof(void *), "FunctionRef must be two pointers");
+}
+
+/**
+ * 購読の追加/削除と不正な引数
+ */
+static void test_subscribe_unsubscribe()
+{
+	FrameSubscriptions subscriptions(DEVICE_ID);
+	auto callback = [](const FrameView &) {};
+	FrameFunctionRef ref(callback);
+
+	SubscriberOptions options;
+	const auto id1 = subscriptions.subscribe(options, ref);
+	const auto id2 = subscriptions.subscribe(options, ref);
+	assert(id1 > 0 && id2 > id1);
+	assert(subscriptions.size() == 2);
+	assert(!FrameSubscriptions::wantsRgba(subscriptions.snapshot()));
+
+	// 不正な引数
+	assert(subscriptions.subscribe(options, FrameFunctionRef()) == -EINVAL);
+	SubscriberOptions bad;
+	bad.max_fps = -1.0f;
+	assert(subscriptions.subscribe(bad, ref) == -EINVAL);
+	bad = SubscriberOptions();
+	bad.format = FrameFormat::Rgba;
+	bad.width = 320;
+	assert(subscriptions.subscribe(bad, ref) == -EINVAL);
+	// 非圧縮/MJPEGのままのフレームは拡大縮小/切り出しできない
+	bad.format = FrameFormat::Raw;
+	bad.height = 240;
+	assert(subscriptions.subscribe(bad, ref) == -EINVAL);
+	bad = SubscriberOptions();
+	bad.crop = { 0, 0, 320, 240 };
+	assert(subscriptions.subscribe(bad, ref) == -EINVAL);
+
+	SubscriberStats stats;
+	assert(!subscriptions.getStats(id1, stats));
+	assert(!stats.delivered && !stats.rate_limited && !stats.dropped_busy);
+
+	assert(!subscriptions.unsubscribe(id1));
+	assert(subscriptions.unsubscribe(id1) == -ENOENT);
+	assert(subscriptions.getStats(id1, stats) == -ENOENT);
+	assert(subscriptions.size() == 1);
+	subscriptions.clear();
+	assert(!subscriptions.size());
+	assert(subscriptions.unsubscribe(id2) == -ENOENT);
+}
+
+/**
+ * 映像取得スレッドで呼び出す購読者はフレームをコピーせずにそのまま受け取り
+ * max_fpsを超えるフレームは間引くこと
+ */
+static void test_inline_rate_limit()
+{
+	FrameSubscriptions subscriptions(DEVICE_ID);
+	std::vector<uint8_t> frame(64, 0x5a);
+	const FrameView raw{ frame.data(), frame.size(), RAW_FRAME_MJPEG, 4, 4, 0 };
+
+	int every = 0;
+	bool same_buffer = true;
+	auto every_frame = [&](const FrameView &view) {
+		every++;
+		same_buffer = same_buffer && (view.data == frame.data()) && (view.len == frame.size());
+	};
+	int limited = 0;
+	auto limited_frame = [&](const FrameView &) { limited++; };
+
+	SubscriberOptions options;
+	options.mode = DispatchMode::Inline;
+	const auto id_every = subscriptions.subscribe(options, every_frame);
+	options.max_fps = 15.0f;
+	const auto id_limited = subscriptions.subscribe(options, limited_frame);
+
+	// 60fpsで2秒分, 到着時刻の揺らぎがあっても平均でmax_fpsになる
+	const int num_frames = 120;
+	for (int i = 0; i < num_frames; i++)
+	{
+		const int64_t jitter_ns = (i % 3 == 1) ? 2000000LL : 0;
+		assert(deliver(subscriptions, raw, nullptr, i * INTERVAL_NS + jitter_ns));
+	}
+	assert(every == num_frames && same_buffer);
+	assert(limited == num_frames / 4);
+
+	SubscriberStats stats;
+	assert(!subscriptions.getStats(id_every, stats));
+	assert(stats.delivered == num_frames && !stats.rate_limited && !stats.dropped_busy);
+	assert(!subscriptions.getStats(id_limited, stats));
+	assert(stats.delivered == num_frames / 4 && stats.rate_limited == num_frames * 3 / 4);
+
+	// 止まっていた後は遅れを取り戻そうとせず次のフレームから間引き直す
+	limited = 0;
+	const int64_t resume_ns = (num_frames + 600) * INTERVAL_NS;
+	for (int i = 0; i < 8; i++)
+	{
+		deliver(subscriptions, raw, nullptr, resume_ns + i * INTERVAL_NS);
+	}
+	assert(limited == 2);
+}
+
+/**
+ * タスクプールで呼び出す購読者はフレームのコピーを受け取り
+ * 前のフレームの処理中に届いたフレームは映像取得スレッドを待たせずに破棄すること
+ */
+static void test_pool_busy_drop()
+{
+	FrameSubscriptions subscriptions(DEVICE_ID);
+	std::vector<uint8_t> frame(64);
+	const FrameView raw{ frame.data(), frame.size(), RAW_FRAME_UNCOMPRESSED_YUYV, 4, 8, 0 };
+
+	std::promise<void> release;
+	auto released = release.get_future().share();
+	std::atomic<int> calls(0);
+	std::atomic<bool> copied(true);
+	std::atomic<int> first_byte(-1);
+	auto slow = [&](const FrameView &view) {
+		copied = copied && (view.data != frame.data()) && (view.len == frame.size());
+		if (calls++ == 0)
+		{
+			first_byte = view.data[0];
+			released.wait();
+		}
+	};
+	const auto id = subscriptions.subscribe(SubscriberOptions(), slow);
+
+	frame[0] = 1;
+	assert(deliver(subscriptions, raw, nullptr, 0));
+	// 映像取得側のバッファは次のフレームで上書きされる
+	frame[0] = 2;
+	assert(wait_for([&] { return calls == 1; }));
+	assert(first_byte == 1);
+	for (int i = 1; i <= 5; i++)
+	{
+		assert(!deliver(subscriptions, raw, nullptr, i * INTERVAL_NS));
+	}
+	SubscriberStats stats;
+	assert(!subscriptions.getStats(id, stats));
+	assert(stats.delivered == 1 && stats.dropped_busy == 5);
+
+	release.set_value();
+	assert(wait_for([&] {
+		return deliver(subscriptions, raw, nullptr, 6 * INTERVAL_NS);
+	}));
+	assert(wait_for([&] { return calls == 2; }));
+	assert(copied);
+	assert(!subscriptions.unsubscribe(id));
+}
+
+/**
+ * RGBAの購読者は要求したサイズへ縮小したフレームを受け取ること
+ */
+static void test_rgba_scaling()
+{
+	FrameSubscriptions subscriptions(DEVICE_ID);
+	const uint32_t width = 64, height = 48;
+	std::vector<uint8_t> rgba(width * height * 4);
+	for (size_t i = 0; i < rgba.size(); i += 4)
+	{
+		rgba[i] = 0x10; rgba[i + 1] = 0x80; rgba[i + 2] = 0xf0; rgba[i + 3] = 0xff;
+	}
+	std::vector<uint8_t> frame(16);
+	const FrameView raw{ frame.data(), frame.size(), RAW_FRAME_MJPEG, width, height, 1234 };
+	const DecodedFrame decoded{ rgba.data(), width, height, { 0, 0, width, height }, width, height, 1234 };
+
+	FrameView small{};
+	bool small_ok = false;
+	auto on_small = [&](const FrameView &view) {
+		small = view;
+		small_ok = (view.len == 16 * 12 * 4);
+		for (size_t i = 0; small_ok && (i < view.len); i += 4)
+		{
+			small_ok = (view.data[i] == 0x10) && (view.data[i + 1] == 0x80)
+				&& (view.data[i + 2] == 0xf0);
+		}
+	};
+	SubscriberOptions options;
+	options.format = FrameFormat::Rgba;
+	options.mode = DispatchMode::Inline;
+	options.width = 16;
+	options.height = 12;
+	const auto id_small = subscriptions.subscribe(options, on_small);
+	assert(FrameSubscriptions::wantsRgba(subscriptions.snapshot()));
+
+	RgbaDemand demand;
+	assert(deliver(subscriptions, raw, &decoded, 0, &demand));
+	assert(demand.due && !demand.full && demand.width == 16 && demand.height == 12);
+	assert(small_ok && small.width == 16 && small.height == 12 && small.pts_us == 1234);
+	assert(small.data != rgba.data());
+
+	// 要求したサイズが違う購読者がいれば大きい方, 元のサイズの購読者がいればデコードしたまま
+	FrameView full{};
+	auto on_full = [&](const FrameView &view) { full = view; };
+	options.width = options.height = 0;
+	const auto id_full = subscriptions.subscribe(options, on_full);
+	assert(deliver(subscriptions, raw, &decoded, INTERVAL_NS, &demand));
+	assert(demand.due && demand.full);
+	assert(full.data == rgba.data() && full.width == width && full.height == height);
+
+	// RAWの購読者しか配信対象でなければRGBAへの変換は不要
+	assert(!subscriptions.unsubscribe(id_small));
+	assert(!subscriptions.unsubscribe(id_full));
+	auto on_raw = [](const FrameView &) {};
+	options = SubscriberOptions();
+	options.mode = DispatchMode::Inline;
+	subscriptions.subscribe(options, on_raw);
+	assert(deliver(subscriptions, raw, &decoded, 2 * INTERVAL_NS, &demand));
+	assert(!demand.due);
+}
+
+/**
+ * 切り出し範囲を指定したRGBAの購読者はデコード済みの領域から自分の範囲だけを受け取り
+ * デコードが必要な領域は配信対象の購読者の切り出し範囲を合わせた範囲になること
+ */
+static void test_rgba_crop()
+{
+	FrameSubscriptions subscriptions(DEVICE_ID);
+	// カメラは640x480, 1/2でデコードして(40,20)-(200,140)の範囲だけを保持している
+	const uint32_t source_width = 640, source_height = 480;
+	const FrameRect region = { 40, 20, 160, 120 };
+	std::vector<uint8_t> rgba(region.width * region.height * 4);
+	for (uint32_t y = 0; y < region.height; y++) {
+		for (uint32_t x = 0; x < region.width; x++) {
+			uint8_t *p = &rgba[(y * region.width + x) * 4];
+			p[0] = (uint8_t)(region.x + x);
+			p[1] = (uint8_t)(region.y + y);
+			p[2] = 0;
+			p[3] = 0xff;
+		}
+	}
+	std::vector<uint8_t> frame(16);
+	const FrameView raw{ frame.data(), frame.size(), RAW_FRAME_MJPEG, source_width, source_height, 0 };
+	const DecodedFrame decoded{ rgba.data(), 320, 240, region, source_width, source_height, 0 };
+
+	// 切り出し範囲をそのままの大きさで受け取る
+	std::vector<uint8_t> cropped;
+	FrameView cropped_view{};
+	auto on_cropped = [&](const FrameView &view) {
+		cropped_view = view;
+		cropped.assign(view.data, view.data + view.len);
+	};
+	SubscriberOptions options;
+	options.format = FrameFormat::Rgba;
+	options.mode = DispatchMode::Inline;
+	options.crop = { 100, 60, 200, 120 };
+	subscriptions.subscribe(options, on_cropped);
+	// 切り出し範囲を縮小して受け取る
+	FrameView small{};
+	auto on_small = [&](const FrameView &view) { small = view; };
+	options.crop = { 300, 200, 100, 80 };
+	options.width = 25;
+	options.height = 20;
+	subscriptions.subscribe(options, on_small);
+
+	RgbaDemand demand;
+	assert(deliver(subscriptions, raw, &decoded, 0, &demand));
+	// (100,60)-(400,280)のカメラの画素が必要, 縮小する購読者は1/4の大きさで足りる
+	assert(demand.due && demand.full);
+	assert(demand.region == FrameRect({ 100, 60, 300, 220 }));
+	// 1/2でデコードしたので(50,30)から100x60の範囲になり, 行は詰めて渡す
+	assert(cropped_view.width == 100 && cropped_view.height == 60);
+	assert(cropped.size() == 100 * 60 * 4);
+	for (uint32_t y = 0; y < 60; y += 7) {
+		for (uint32_t x = 0; x < 100; x += 9) {
+			const uint8_t *p = &cropped[(y * 100 + x) * 4];
+			assert(p[0] == 50 + x && p[1] == 30 + y);
+		}
+	}
+	assert(small.width == 25 && small.height == 20 && small.len == 25 * 20 * 4);
+	// 2x2画素の平均
+	assert(std::abs(small.data[0] - 150) <= 1 && std::abs(small.data[1] - 100) <= 1);
+
+	// 縮小する購読者だけなら縮小に必要なフレーム全体の大きさを返す
+	FrameSubscriptions only_small(DEVICE_ID);
+	only_small.subscribe(options, on_small);
+	assert(deliver(only_small, raw, &decoded, 0, &demand));
+	assert(demand.due && !demand.full);
+	assert(demand.region == options.crop);
+	assert(demand.width == 160 && demand.height == 120);
+}
+
+/**
+ * RGBAの購読者は切り出した範囲を指定した向きで受け取ること
+ * 変換時に回転済みのフレームはそのまま/元の向きへ戻して受け取れること
+ */
+static void test_rgba_orientation()
+{
+	// カメラは640x480, 1/2でデコードして(40,20)-(200,140)の範囲だけを保持している
+	const uint32_t source_width = 640, source_height = 480;
+	const FrameRect region = { 40, 20, 160, 120 };
+	std::vector<uint8_t> upright(region.width * region.height * 4);
+	std::vector<uint8_t> rotated(region.width * region.height * 4);
+	const FrameOrientation quarter = { 90 };
+	for (uint32_t y = 0; y < region.height; y++) {
+		for (uint32_t x = 0; x < region.width; x++) {
+			const uint8_t pixel[] = { (uint8_t)(region.x + x), (uint8_t)(region.y + y), 0, 0xff };
+			memcpy(&upright[(y * region.width + x) * 4], pixel, 4);
+			int64_t ox, oy;
+			orientPoint(quarter, region.width, region.height, x, y, ox, oy);
+			memcpy(&rotated[(oy * region.height + ox) * 4], pixel, 4);
+		}
+	}
+	std::vector<uint8_t> frame(16);
+	const FrameView raw{ frame.data(), frame.size(), RAW_FRAME_MJPEG, source_width, source_height, 0 };
+
+	// 正立のフレームを切り出して90度回転する
+	{
+		FrameSubscriptions subscriptions(DEVICE_ID);
+		const DecodedFrame decoded{ upright.data(), 320, 240, region, source_width, source_height, 0 };
+		std::vector<uint8_t> received;
+		FrameView view{};
+		auto on_frame = [&](const FrameView &v) {
+			view = v;
+			received.assign(v.data, v.data + v.len);
+		};
+		SubscriberOptions options;
+		options.format = FrameFormat::Rgba;
+		options.mode = DispatchMode::Inline;
+		options.crop = { 100, 60, 200, 120 };
+		options.orientation = quarter;
+		assert(subscriptions.subscribe(options, on_frame) > 0);
+		assert(deliver(subscriptions, raw, &decoded, 0));
+		// 1/2でデコードしたので(50,30)から100x60の範囲になり, 回転して60x100で受け取る
+		assert(view.width == 60 && view.height == 100 && received.size() == 60 * 100 * 4);
+		for (uint32_t y = 0; y < 60; y += 7) {
+			for (uint32_t x = 0; x < 100; x += 9) {
+				const uint8_t *p = &received[(x * 60 + 59 - y) * 4];
+				assert(p[0] == 50 + x && p[1] == 30 + y);
+			}
+		}
+	}
+	// 回転済みのフレーム
+	{
+		FrameSubscriptions subscriptions(DEVICE_ID);
+		const DecodedFrame decoded{ rotated.data(), 320, 240, region, source_width, source_height, 0, quarter };
+		assert(decoded.stride() == region.height * 4);
+		FrameView same{};
+		auto on_same = [&](const FrameView &v) { same = v; };
+		std::vector<uint8_t> received;
+		auto on_upright = [&](const FrameView &v) { received.assign(v.data, v.data + v.len); };
+		SubscriberOptions options;
+		options.format = FrameFormat::Rgba;
+		options.mode = DispatchMode::Inline;
+		options.orientation = quarter;
+		subscriptions.subscribe(options, on_same);
+		options.orientation = FrameOrientation();
+		subscriptions.subscribe(options, on_upright);
+		RgbaDemand demand;
+		assert(deliver(subscriptions, raw, &decoded, 0, &demand));
+		// 同じ向きでフレーム全体ならコピーしない
+		assert(same.data == rotated.data() && same.width == 120 && same.height == 160);
+		// 元の向きへ戻す
+		assert(received == upright);
+	}
+	// 回転後の出力サイズから必要なデコードサイズを求める
+	{
+		FrameSubscriptions subscriptions(DEVICE_ID);
+		auto on_frame = [&](const FrameView &) {};
+		SubscriberOptions options;
+		options.format = FrameFormat::Rgba;
+		options.orientation = { 270 };
+		options.width = 120;
+		options.height = 160;
+		subscriptions.subscribe(options, on_frame);
+		RgbaDemand demand;
+		assert(deliver(subscriptions, raw, nullptr, 0, &demand));
+		assert(demand.due && !demand.full && demand.width == 160 && demand.height == 120);
+		// 生フレームは回転できない, 90度単位以外の回転はできない
+		options.format = FrameFormat::Raw;
+		options.width = options.height = 0;
+		assert(subscriptions.subscribe(options, on_frame) == -EINVAL);
+		options.format = FrameFormat::Rgba;
+		options.orientation = { 30 };
+		assert(subscriptions.subscribe(options, on_frame) == -EINVAL);
+	}
+}
+
+/**
+ * コールバックの中から自分自身の購読を解除できること
+ * 他のスレッドからの解除は実行中のコールバックが終わるまで待つこと
+ */
+static void test_unsubscribe_during_call()
+{
+	FrameSubscriptions subscriptions(DEVICE_ID);
+	std::vector<uint8_t> frame(16);
+	const FrameView raw{ frame.data(), frame.size(), RAW_FRAME_MJPEG, 4, 4, 0 };
+
+	// 映像取得スレッドで呼び出す購読者
+	int32_t inline_id = 0;
+	int inline_calls = 0;
+	int inline_result = 1;
+	auto inline_self = [&](const FrameView &) {
+		inline_calls++;
+		inline_result = subscriptions.unsubscribe(inline_id);
+	};
+	SubscriberOptions options;
+	options.mode = DispatchMode::Inline;
+	inline_id = subscriptions.subscribe(options, inline_self);
+	deliver(subscriptions, raw, nullptr, 0);
+	assert(inline_calls == 1 && !inline_result && !subscriptions.size());
+	deliver(subscriptions, raw, nullptr, INTERVAL_NS);
+	assert(inline_calls == 1);
+
+	// タスクプールで呼び出す購読者
+	std::atomic<int32_t> pool_id(0);
+	std::atomic<int> pool_result(1);
+	auto pool_self = [&](const FrameView &) {
+		pool_result = subscriptions.unsubscribe(pool_id);
+	};
+	pool_id = subscriptions.subscribe(SubscriberOptions(), pool_self);
+	deliver(subscriptions, raw, nullptr, 2 * INTERVAL_NS);
+	assert(wait_for([&] { return pool_result != 1; }));
+	assert(!pool_result && !subscriptions.size());
+
+	// 他のスレッドから解除するとコールバックが返るまで待つ
+	std::atomic<bool> entered(false);
+	std::atomic<bool> finished(false);
+	auto slow = [&](const FrameView &) {
+		entered = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		finished = true;
+	};
+	const auto id = subscriptions.subscribe(SubscriberOptions(), slow);
+	deliver(subscriptions, raw, nullptr, 3 * INTERVAL_NS);
+	assert(wait_for([&] { return entered.load(); }));
+	assert(!subscriptions.unsubscribe(id));
+	assert(finished);
+}
+
+int main()
+{
+	test_function_ref();
+	test_subscribe_unsubscribe();
+	test_inline_rate_limit();
+	test_pool_busy_drop();
+	test_rgba_scaling();
+	test_rgba_crop();
+	test_rgba_orientation();
+	test_unsubscribe_during_call();
+
+	printf("frame_subscription_test: OK\n");
+	return 0;
+}
@@ -0,0 +1,76 @@
+/**
+ * JPEG helpers shared by the host unit tests
+ *
+ * Encodes synthetic RGB pictures with libjpeg so that the tests can feed
+ * MJPEG frames to the decoder, the still capture and the motion detector.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#ifndef FLUTTER_JPEG_TEST_UTILS_H
+#define FLUTTER_JPEG_TEST_UTILS_H
+
+// Standard C/C++ headers
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+// libjpeg-turbo
+#include <cstdio>
+#include "jpeglib.h"
+
+/**
+ * Encode tightly packed RGB to a baseline JPEG with libjpeg's default
+ * (standard) Huffman tables
+ * @param restart_interval MCUs between restart markers, 0 means none
+ */
+static inline std::vector<uint8_t>
+encodeRgb(const std::vector<uint8_t> &rgb, uint32_t width, uint32_t height,
+          unsigned int restart_interval = 0) {
+  jpeg_compress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&cinfo);
+  unsigned char *out = nullptr;
+  unsigned long out_len = 0;
+  jpeg_mem_dest(&cinfo, &out, &out_len);
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, 90, TRUE);
+  cinfo.restart_interval = restart_interval;
+  jpeg_start_compress(&cinfo, TRUE);
+  while (cinfo.next_scanline < cinfo.image_height) {
+    JSAMPROW row = const_cast<uint8_t *>(&rgb[cinfo.next_scanline * width * 3]);
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  std::vector<uint8_t> result(out, out + out_len);
+  jpeg_destroy_compress(&cinfo);
+  free(out);
+  return result;
+}
+
+/**
+ * Smooth gradient, every pixel differs from its neighbours so that every
+ * table of the encoder is used
+ */
+static inline std::vector<uint8_t>
+encodeGradientFrame(uint32_t width, uint32_t height,
+                    unsigned int restart_interval = 0) {
+  std::vector<uint8_t> rgb(width * height * 3);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      uint8_t *p = &rgb[(y * width + x) * 3];
+      p[0] = (uint8_t)(x * 255 / width);
+      p[1] = (uint8_t)(y * 255 / height);
+      p[2] = (uint8_t)((x + y) & 0xff);
+    }
+  }
+  return encodeRgb(rgb, width, height, restart_interval);
+}
+
+#endif // FLUTTER_JPEG_TEST_UTILS_H
@@ -0,0 +1,146 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * 撮影からパイプラインの各段階までの遅延測定(LatencyProbe)のホスト上でのユニットテスト
+ *
+ * android/src/main/cppをホストのcmakeでビルドしてctestで実行する
+ *   cmake -S android/src/main/cpp -B build && cmake --build build && ctest --test-dir build
+ */
+
+#undef NDEBUG
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "aandusb_native.h"
+#include "flutter_latency_probe.h"
+
+using namespace serenegiant::flutter;
+
+/**
+ * MJPEGはSOIの直後へCOMセグメントとして, 非圧縮フレームは先頭へスタンプを埋め込み取り出せること
+ */
+static void test_embed_extract()
+{
+	const latency_stamp_t stamp = { 1234, 5678901234LL };
+	latency_stamp_t out{};
+
+	// SOI, 適当なセグメント, EOI
+	const std::vector<uint8_t> jpeg = {
+		0xff, 0xd8, 0xff, 0xdb, 0x00, 0x04, 0x01, 0x02,
+		0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88,
+		0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff, 0xd9 };
+	std::vector<uint8_t> data(jpeg.size() + 20);
+	memcpy(data.data(), jpeg.data(), jpeg.size());
+	size_t bytes = jpeg.size();
+	assert(!latency_probe_extract(data.data(), bytes, out));
+	// バッファが足りなければ埋め込まない
+	assert(latency_probe_embed(RAW_FRAME_MJPEG, data.data(), bytes, bytes, stamp) == -ENOSPC);
+	assert(bytes == jpeg.size());
+	assert(!latency_probe_embed(RAW_FRAME_MJPEG, data.data(), bytes, data.size(), stamp));
+	assert(bytes == jpeg.size() + 20);
+	assert(data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff && data[3] == 0xfe);
+	// 元のセグメントはCOMセグメントの後ろへずれる
+	assert(!memcmp(data.data() + 22, jpeg.data() + 2, jpeg.size() - 2));
+	assert(latency_probe_extract(data.data(), bytes, out));
+	assert(out.seq == stamp.seq && out.capture_ns == stamp.capture_ns);
+
+	std::vector<uint8_t> yuyv(64 * 2, 0x80);
+	bytes = yuyv.size();
+	assert(!latency_probe_extract(yuyv.data(), bytes, out));
+	assert(!latency_probe_embed(RAW_FRAME_UNCOMPRESSED_YUYV, yuyv.data(), bytes, bytes, stamp));
+	assert(bytes == yuyv.size());
+	out = {};
+	assert(latency_probe_extract(yuyv.data(), bytes, out));
+	assert(out.seq == stamp.seq && out.capture_ns == stamp.capture_ns);
+
+	// H264には埋め込めない
+	assert(latency_probe_embed(RAW_FRAME_H264, yuyv.data(), bytes, bytes, stamp) == -EINVAL);
+}
+
+/**
+ * 段階毎に遅延を集計してヒストグラムとパーセンタイルを求め, シーケンス番号の欠番を数えること
+ */
+static void test_stats()
+{
+	LatencyProbe probe;
+	std::vector<uint8_t> frame(64, 0);
+	size_t bytes = frame.size();
+	latency_stamp_t stamp;
+	// 無効な時は何もしない
+	assert(!probe.begin(frame.data(), bytes, stamp));
+
+	probe.set_enabled(true);
+	assert(!probe.begin(frame.data(), bytes, stamp));
+	assert(probe.get_no_stamp() == 1);
+
+	const int64_t capture_ns = 1000000000LL;
+	for (uint32_t i = 0; i < 100; i++)
+	{
+		// 10番毎に1フレーム欠ける
+		const latency_stamp_t src = { i + i / 10, capture_ns };
+		assert(!latency_probe_embed(RAW_FRAME_UNCOMPRESSED_RGBX, frame.data(), bytes, bytes, src));
+		assert(probe.begin(frame.data(), bytes, stamp));
+		// uvc_get_frameまで2ms, 描画までは1〜100ms
+		probe.record(LATENCY_STAGE_FETCH, stamp, capture_ns + 2000000LL);
+		probe.record(LATENCY_STAGE_PREVIEW, stamp, capture_ns + (i + 1) * 1000000LL);
+	}
+	assert(probe.get_dropped() == 9);
+
+	latency_stats_t stats;
+	probe.get_stats(LATENCY_STAGE_FETCH, stats);
+	assert(stats.count == 100);
+	assert(stats.min_ns == 2000000LL && stats.max_ns == 2000000LL && stats.mean_ns == 2000000LL);
+	// 2000マイクロ秒は[1024, 2048)のビン11
+	assert(stats.histogram[11] == 100);
+	assert(stats.p50_ns == 2000000LL && stats.p99_ns == 2000000LL);
+
+	probe.get_stats(LATENCY_STAGE_PREVIEW, stats);
+	assert(stats.count == 100);
+	assert(stats.min_ns == 1000000LL && stats.max_ns == 100000000LL);
+	assert(stats.mean_ns == 50500000LL);
+	// パーセンタイルはビンの上限値なので真の値以上で2倍未満
+	assert(stats.p50_ns >= 50000000LL && stats.p50_ns < 100000000LL);
+	assert(stats.p95_ns >= 95000000LL && stats.p95_ns <= stats.max_ns);
+	assert(stats.p50_ns <= stats.p95_ns && stats.p95_ns <= stats.p99_ns);
+	uint64_t total = 0;
+	for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+	{
+		total += stats.histogram[i];
+	}
+	assert(total == 100);
+
+	probe.get_stats(LATENCY_STAGE_RECORDING, stats);
+	assert(!stats.count && !stats.max_ns);
+
+	// 切り替えると集計結果を破棄する
+	probe.set_enabled(false);
+	probe.get_stats(LATENCY_STAGE_FETCH, stats);
+	assert(!stats.count && !probe.get_dropped() && !probe.get_no_stamp());
+}
+
+int main()
+{
+	test_embed_extract();
+	test_stats();
+
+	printf("latency_probe_test: OK\n");
+	return 0;
+}
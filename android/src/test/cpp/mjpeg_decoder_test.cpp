@@ -0,0 +1,167 @@
+/**
+ * MjpegDecoder host unit test
+ *
+ * Encodes a synthetic frame with libjpeg and checks that scaled IDCT decoding
+ * returns the expected sizes and colors, and that cropped decoding matches
+ * the same pixels of a full decode.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#undef NDEBUG
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "flutter_mjpeg_decoder.h"
+#include "jpeg_test_utils.h"
+
+using namespace serenegiant::flutter;
+
+// Left half red, right half blue
+static std::vector<uint8_t> encodeTestFrame(uint32_t width, uint32_t height) {
+  std::vector<uint8_t> rgb(width * height * 3);
+  for (uint32_t y = 0; y < height; y++) {
+    for (uint32_t x = 0; x < width; x++) {
+      uint8_t *p = &rgb[(y * width + x) * 3];
+      p[0] = x < width / 2 ? 255 : 0;
+      p[1] = 0;
+      p[2] = x < width / 2 ? 0 : 255;
+    }
+  }
+
+  return encodeRgb(rgb, width, height);
+}
+
+static void testSelectScaleDenom() {
+  // Full resolution requested
+  assert(MjpegDecoder::selectScaleDenom(1920, 1080, 0, 0) == 1);
+  assert(MjpegDecoder::selectScaleDenom(1920, 1080, 1920, 1080) == 1);
+  // Half still covers 960x540
+  assert(MjpegDecoder::selectScaleDenom(1920, 1080, 960, 540) == 2);
+  assert(MjpegDecoder::selectScaleDenom(1920, 1080, 961, 540) == 1);
+  // Thumbnail sized preview
+  assert(MjpegDecoder::selectScaleDenom(1920, 1080, 320, 180) == 4);
+  assert(MjpegDecoder::selectScaleDenom(3840, 2160, 320, 180) == 8);
+  // Never more than 1/8
+  assert(MjpegDecoder::selectScaleDenom(3840, 2160, 16, 16) == 8);
+}
+
+static void testScaledDecode() {
+  const auto jpeg = encodeTestFrame(1280, 720);
+  MjpegDecoder decoder;
+  std::vector<uint8_t> rgba;
+  uint32_t width = 0, height = 0;
+
+  assert(decoder.decode(jpeg.data(), jpeg.size(), 0, 0, rgba, width,
+                        height) == 0);
+  assert(width == 1280 && height == 720);
+  assert(decoder.lastScaleDenom() == 1);
+
+  assert(decoder.decode(jpeg.data(), jpeg.size(), 320, 180, rgba, width,
+                        height) == 0);
+  assert(width == 320 && height == 180);
+  assert(decoder.lastScaleDenom() == 4);
+  // Check colors away from the edge between the halves
+  const uint8_t *left = &rgba[(90 * width + 40) * 4];
+  const uint8_t *right = &rgba[(90 * width + 280) * 4];
+  assert(left[0] > 200 && left[2] < 60 && left[3] == 255);
+  assert(right[2] > 200 && right[0] < 60 && right[3] == 255);
+}
+
+// Largest channel difference between a rect of a cropped decode and the
+// same pixels of the full decode
+static int cropDiff(const std::vector<uint8_t> &full, uint32_t full_width,
+                    const std::vector<uint8_t> &cropped,
+                    const FrameRect &region, const FrameRect &rect) {
+  int diff = 0;
+  for (uint32_t y = rect.y; y < rect.y + rect.height; y++) {
+    const uint8_t *a = &full[((size_t)y * full_width + rect.x) * 4];
+    const uint8_t *b =
+        &cropped[((size_t)(y - region.y) * region.width + rect.x - region.x) *
+                 4];
+    for (uint32_t i = 0; i < rect.width * 4; i++) {
+      diff = std::max(diff, std::abs(a[i] - b[i]));
+    }
+  }
+  return diff;
+}
+
+static void testCroppedDecode() {
+  const auto jpeg = encodeGradientFrame(640, 480);
+  MjpegDecoder decoder;
+  std::vector<uint8_t> full, cropped;
+  uint32_t width = 0, height = 0;
+  FrameRect region;
+
+  assert(decoder.decode(jpeg.data(), jpeg.size(), 0, 0, full, width,
+                        height) == 0);
+  const uint32_t full_width = width;
+
+  // Columns are widened to whole iMCUs, rows are exact
+  const FrameRect crop = {200, 100, 160, 120};
+  assert(decoder.decode(jpeg.data(), jpeg.size(), 0, 0, crop, cropped, width,
+                        height, region) == 0);
+  assert(width == 640 && height == 480);
+  assert(region.x <= crop.x && region.x + region.width >= crop.x + crop.width);
+  assert(region.width < 640 && region.x % 16 == 0);
+  assert(region.y == crop.y && region.height == crop.height);
+  assert(cropDiff(full, full_width, cropped, region, crop) == 0);
+
+  // An empty crop decodes the whole frame
+  assert(decoder.decode(jpeg.data(), jpeg.size(), 0, 0, FrameRect(), cropped,
+                        width, height, region) == 0);
+  assert(region == FrameRect({0, 0, 640, 480}));
+  assert(cropDiff(full, full_width, cropped, region, region) == 0);
+
+  // A crop touching the right and bottom edges
+  const FrameRect corner = {600, 440, 40, 40};
+  assert(decoder.decode(jpeg.data(), jpeg.size(), 0, 0, corner, cropped,
+                        width, height, region) == 0);
+  assert(region.x + region.width == 640 && region.y + region.height == 480);
+  assert(cropDiff(full, full_width, cropped, region, corner) == 0);
+
+  // With a scaled IDCT the crop is mapped onto the scaled frame
+  std::vector<uint8_t> half;
+  assert(decoder.decode(jpeg.data(), jpeg.size(), 320, 240, half, width,
+                        height) == 0);
+  assert(decoder.decode(jpeg.data(), jpeg.size(), 320, 240, crop, cropped,
+                        width, height, region) == 0);
+  assert(width == 320 && height == 240 && decoder.lastScaleDenom() == 2);
+  assert(region.x <= 100 && region.x + region.width >= 180);
+  assert(region.y == 50 && region.height == 60);
+  assert(cropDiff(half, 320, cropped, region, {100, 50, 80, 60}) == 0);
+
+  // The decoder stays usable after stopping below the crop
+  std::vector<uint8_t> again;
+  assert(decoder.decode(jpeg.data(), jpeg.size(), 0, 0, again, width,
+                        height) == 0);
+  assert(again == full);
+}
+
+static void testCorruptFrame() {
+  auto jpeg = encodeTestFrame(64, 64);
+  jpeg.resize(16); // truncated inside the headers
+  MjpegDecoder decoder;
+  std::vector<uint8_t> rgba;
+  uint32_t width = 0, height = 0;
+  assert(decoder.decode(jpeg.data(), jpeg.size(), 0, 0, rgba, width,
+                        height) < 0);
+  // The decoder must stay usable after an error
+  const auto valid = encodeTestFrame(64, 64);
+  assert(decoder.decode(valid.data(), valid.size(), 0, 0, rgba, width,
+                        height) == 0);
+  assert(width == 64 && height == 64);
+}
+
+int main() {
+  testSelectScaleDenom();
+  testScaledDecode();
+  testCroppedDecode();
+  testCorruptFrame();
+  printf("mjpeg_decoder_test: OK\n");
+  return 0;
+}
@@ -0,0 +1,239 @@
+/**
+ * MotionDetector host unit test
+ *
+ * Checks the SIMD sum of absolute differences against a plain loop, that a
+ * moving block is found in every supported format, and that the mask, the
+ * analysis interval and the hysteresis behave as configured.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#undef NDEBUG
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "aandusb/aandusb_native.h"
+#include "flutter_motion_detector.h"
+#include "jpeg_test_utils.h"
+
+using namespace serenegiant::flutter;
+
+static const uint32_t WIDTH = 320;
+static const uint32_t HEIGHT = 240;
+// 100 ms apart, one analysed frame per call with the default interval
+static const int64_t FRAME_US = 100000;
+
+// Gradient background with a bright 40x40 block at (bx, by)
+static std::vector<uint8_t> scene(int bx, int by) {
+  std::vector<uint8_t> luma(WIDTH * HEIGHT);
+  for (uint32_t y = 0; y < HEIGHT; y++) {
+    for (uint32_t x = 0; x < WIDTH; x++) {
+      const bool block = (int)x >= bx && (int)x < bx + 40 && (int)y >= by &&
+                         (int)y < by + 40;
+      luma[y * WIDTH + x] = block ? 235 : (uint8_t)(32 + (x + y) / 8);
+    }
+  }
+  return luma;
+}
+
+static std::vector<uint8_t> toFrame(uint32_t frame_type,
+                                    const std::vector<uint8_t> &luma) {
+  std::vector<uint8_t> frame;
+  switch (frame_type) {
+  case RAW_FRAME_UNCOMPRESSED_YUYV:
+    frame.resize(WIDTH * HEIGHT * 2);
+    for (size_t i = 0; i < luma.size(); i++) {
+      frame[i * 2] = luma[i];
+      frame[i * 2 + 1] = 128;
+    }
+    break;
+  case RAW_FRAME_UNCOMPRESSED_NV12:
+    frame.assign(WIDTH * HEIGHT * 3 / 2, 128);
+    memcpy(frame.data(), luma.data(), luma.size());
+    break;
+  case RAW_FRAME_UNCOMPRESSED_RGBX:
+    frame.resize(WIDTH * HEIGHT * 4);
+    for (size_t i = 0; i < luma.size(); i++) {
+      frame[i * 4] = frame[i * 4 + 1] = frame[i * 4 + 2] = luma[i];
+      frame[i * 4 + 3] = 255;
+    }
+    break;
+  case RAW_FRAME_MJPEG: {
+    std::vector<uint8_t> rgb(WIDTH * HEIGHT * 3);
+    for (size_t i = 0; i < luma.size(); i++) {
+      rgb[i * 3] = rgb[i * 3 + 1] = rgb[i * 3 + 2] = luma[i];
+    }
+    frame = encodeRgb(rgb, WIDTH, HEIGHT);
+    break;
+  }
+  }
+  return frame;
+}
+
+static int process(MotionDetector &detector, uint32_t frame_type,
+                   const std::vector<uint8_t> &frame, int64_t time_us,
+                   MotionResult &result) {
+  return detector.process(frame_type, frame.data(), frame.size(), WIDTH,
+                          HEIGHT, time_us, result);
+}
+
+static void testSadRow() {
+  std::mt19937 random(1);
+  std::uniform_int_distribution<int> dist(0, 255);
+  std::vector<uint8_t> a(300), b(300);
+  for (size_t i = 0; i < a.size(); i++) {
+    a[i] = (uint8_t)dist(random);
+    b[i] = (uint8_t)dist(random);
+  }
+  for (size_t offset : {0, 1, 7}) {
+    for (size_t n : {0, 1, 15, 16, 17, 31, 64, 100, 255}) {
+      uint32_t expected = 0;
+      for (size_t i = 0; i < n; i++) {
+        expected += (uint32_t)std::abs(a[offset + i] - b[offset + i]);
+      }
+      assert(sadRow(&a[offset], &b[offset], n) == expected);
+    }
+  }
+  // Largest differences do not overflow the lanes
+  std::vector<uint8_t> black(4096, 0), white(4096, 255);
+  assert(sadRow(black.data(), white.data(), black.size()) == 4096u * 255);
+}
+
+static void testConfigure() {
+  MotionDetector detector;
+  MotionConfig config;
+  assert(detector.configure(config) == 0);
+  MotionConfig bad = config;
+  bad.grid_columns = MOTION_MAX_GRID + 1;
+  assert(detector.configure(bad) == -EINVAL);
+  bad = config;
+  bad.subsample = 3;
+  assert(detector.configure(bad) == -EINVAL);
+  bad = config;
+  bad.cell_threshold = 0;
+  assert(detector.configure(bad) == -EINVAL);
+  bad = config;
+  bad.min_cells = config.grid_columns * config.grid_rows + 1;
+  assert(detector.configure(bad) == -EINVAL);
+  bad = config;
+  bad.mask.assign(10, 1);
+  assert(detector.configure(bad) == -EINVAL);
+
+  MotionResult result;
+  const std::vector<uint8_t> h264(1000);
+  assert(detector.process(RAW_FRAME_H264, h264.data(), h264.size(), WIDTH,
+                          HEIGHT, 0, result) == -ENOTSUP);
+  const auto yuyv = toFrame(RAW_FRAME_UNCOMPRESSED_YUYV, scene(0, 0));
+  assert(detector.process(RAW_FRAME_UNCOMPRESSED_YUYV, yuyv.data(), 100,
+                          WIDTH, HEIGHT, 0, result) == -EINVAL);
+  assert(detector.process(RAW_FRAME_MJPEG, h264.data(), h264.size(), WIDTH,
+                          HEIGHT, 0, result) == -ENODATA);
+}
+
+static void testFormats() {
+  for (uint32_t frame_type :
+       {RAW_FRAME_UNCOMPRESSED_YUYV, RAW_FRAME_UNCOMPRESSED_NV12,
+        RAW_FRAME_UNCOMPRESSED_RGBX, RAW_FRAME_MJPEG}) {
+    MotionDetector detector;
+    MotionConfig config;
+    config.trigger_frames = 1;
+    assert(detector.configure(config) == 0);
+    const auto still = toFrame(frame_type, scene(100, 100));
+    const auto moved = toFrame(frame_type, scene(140, 100));
+    MotionResult result;
+    // The first frame only becomes the reference
+    assert(process(detector, frame_type, still, 0, result) == -EAGAIN);
+    assert(process(detector, frame_type, still, FRAME_US, result) == 0);
+    assert(!result.changed_cells && !result.motion && !result.changed);
+    assert(result.peak < 4);
+    assert(process(detector, frame_type, moved, FRAME_US * 2, result) == 0);
+    assert(result.changed_cells >= 2 && result.peak > 100);
+    assert(result.motion && result.changed && detector.inMotion());
+  }
+}
+
+static void testMaskAndInterval() {
+  MotionDetector detector;
+  MotionConfig config;
+  config.trigger_frames = 1;
+  config.min_cells = 1;
+  // Ignore the left half of the grid, the block moves there
+  config.mask.assign(config.grid_columns * config.grid_rows, 1);
+  for (uint32_t r = 0; r < config.grid_rows; r++) {
+    for (uint32_t c = 0; c < config.grid_columns / 2; c++) {
+      config.mask[r * config.grid_columns + c] = 0;
+    }
+  }
+  assert(detector.configure(config) == 0);
+  const uint32_t type = RAW_FRAME_UNCOMPRESSED_NV12;
+  MotionResult result;
+  assert(process(detector, type, toFrame(type, scene(20, 100)), 0, result) ==
+         -EAGAIN);
+  assert(process(detector, type, toFrame(type, scene(80, 100)), FRAME_US,
+                 result) == 0);
+  assert(!result.changed_cells && !result.motion);
+  // Too soon after the last analysed frame
+  assert(process(detector, type, toFrame(type, scene(200, 100)),
+                 FRAME_US + 1000, result) == -EAGAIN);
+  assert(process(detector, type, toFrame(type, scene(200, 100)), FRAME_US * 2,
+                 result) == 0);
+  assert(result.changed_cells && result.motion);
+}
+
+static void testHysteresis() {
+  MotionDetector detector;
+  MotionConfig config;
+  config.trigger_frames = 3;
+  config.hold_ms = 1000;
+  config.interval_ms = 0;
+  assert(detector.configure(config) == 0);
+  const uint32_t type = RAW_FRAME_UNCOMPRESSED_YUYV;
+  std::vector<std::vector<uint8_t>> frames;
+  for (int i = 0; i < 8; i++) {
+    frames.push_back(toFrame(type, scene(20 + i * 30, 100)));
+  }
+  int64_t t = 0;
+  MotionResult result;
+  assert(process(detector, type, frames[0], t, result) == -EAGAIN);
+  // A single flicker does not start the motion
+  assert(process(detector, type, frames[1], t += FRAME_US, result) == 0);
+  assert(!result.motion);
+  assert(process(detector, type, frames[1], t += FRAME_US, result) == 0);
+  assert(!result.motion && !result.changed);
+  // Three frames in a row do
+  for (int i = 2; i <= 4; i++) {
+    assert(process(detector, type, frames[i], t += FRAME_US, result) == 0);
+    assert(result.motion == (i == 4) && result.changed == (i == 4));
+  }
+  // Still until the hold time has passed
+  const int64_t last_motion = t;
+  while (t - last_motion < 1000000) {
+    assert(process(detector, type, frames[4], t += FRAME_US, result) == 0);
+    assert(result.motion == (t - last_motion < 1000000));
+  }
+  assert(!result.motion && result.changed && !detector.inMotion());
+
+  // A frame of another format is only the new reference
+  const auto rgbx = toFrame(RAW_FRAME_UNCOMPRESSED_RGBX, scene(0, 0));
+  assert(process(detector, RAW_FRAME_UNCOMPRESSED_RGBX, rgbx,
+                 t += FRAME_US, result) == -EAGAIN);
+  assert(process(detector, RAW_FRAME_UNCOMPRESSED_RGBX, rgbx,
+                 t += FRAME_US, result) == 0);
+  assert(!result.changed_cells);
+}
+
+int main() {
+  testSadRow();
+  testConfigure();
+  testFormats();
+  testMaskAndInterval();
+  testHysteresis();
+  printf("motion_detector_test: OK\n");
+  return 0;
+}
@@ -0,0 +1,229 @@
+/**
+ * RateController host unit test
+ *
+ * Feeds simulated encoder reports and checks that a growing input queue or
+ * blocked writes lower the bitrate and then the frame rate, that a calm
+ * encoder gets both back step by step, that the measured output rate sets
+ * where the bitrate goes, and that every decision is kept.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#undef NDEBUG
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <vector>
+
+#include "flutter_rate_controller.h"
+
+using namespace serenegiant::flutter;
+
+static const uint32_t BITRATE = 4000000;
+// Reports 100 ms apart, decisions at most every 500 ms
+static const int64_t REPORT_US = 100000;
+
+/**
+ * Encoder simulation, posts and encodes a number of frames per report
+ */
+struct Encoder {
+  RateController &controller;
+  EncoderSample sample{0, 0, 0, 0, BITRATE};
+  // Share of the bitrate the scene needs
+  uint32_t output_permille = 1000;
+
+  explicit Encoder(RateController &c) : controller(c) {}
+
+  // Returns the bitrate of the last decision that changed it, 0 if none
+  uint32_t run(int reports, int posted, int encoded, uint64_t stall_us = 0) {
+    uint32_t changed = 0;
+    for (int i = 0; i < reports; i++) {
+      for (int f = 0; f < posted; f++) {
+        if (!controller.dropFrame()) {
+          controller.framePosted();
+        }
+      }
+      sample.time_us += REPORT_US;
+      sample.encoded_frames += encoded;
+      sample.output_bytes +=
+          (uint64_t)sample.bitrate * output_permille / 1000 / 8 / 10;
+      sample.stall_us += stall_us;
+      const uint32_t bitrate = controller.update(sample);
+      if (bitrate) {
+        sample.bitrate = changed = bitrate;
+      }
+    }
+    return changed;
+  }
+};
+
+static void testConfigure() {
+  RateController controller;
+  RateControlConfig config;
+  assert(controller.configure(true, config) == 0 && controller.enabled());
+  RateControlConfig bad = config;
+  bad.min_bitrate = 0;
+  assert(controller.configure(true, bad) == -EINVAL);
+  bad = config;
+  bad.max_bitrate = config.min_bitrate - 1;
+  assert(controller.configure(true, bad) == -EINVAL);
+  bad = config;
+  bad.target_queue_depth = config.max_queue_depth;
+  assert(controller.configure(true, bad) == -EINVAL);
+  bad = config;
+  bad.max_decimation = RATE_MAX_DECIMATION + 1;
+  assert(controller.configure(true, bad) == -EINVAL);
+  bad = config;
+  bad.stall_permille = 1001;
+  assert(controller.configure(true, bad) == -EINVAL);
+  bad = config;
+  bad.interval_ms = 0;
+  assert(controller.configure(true, bad) == -EINVAL);
+
+  // Disabled it never intervenes
+  assert(controller.configure(false, config) == 0);
+  Encoder encoder(controller);
+  assert(!encoder.run(50, 3, 0));
+  RateControlStats stats;
+  controller.getStats(stats);
+  assert(!stats.updates && !stats.decisions && stats.decimation == 1);
+}
+
+static void testBacklog() {
+  RateController controller;
+  RateControlConfig config;
+  config.min_bitrate = 1000000;
+  assert(controller.configure(true, config) == 0);
+  Encoder encoder(controller);
+
+  // Keeping up, nothing changes
+  assert(!encoder.run(20, 3, 3));
+  RateControlStats stats;
+  controller.getStats(stats);
+  assert(stats.updates >= 3 && !stats.decisions);
+  assert(stats.bitrate == BITRATE && stats.queue_depth == 0);
+
+  // The encoder falls behind, the bitrate goes down until the floor...
+  const uint32_t bitrate = encoder.run(11, 3, 0);
+  assert(bitrate && bitrate < BITRATE);
+  encoder.run(40, 3, 0);
+  controller.getStats(stats);
+  assert(stats.bitrate == config.min_bitrate && stats.bitrate_decreases >= 4);
+  // ...and frames are dropped as well
+  assert(stats.decimation == config.max_decimation);
+  assert(stats.decimation_increases == config.max_decimation - 1);
+  assert(stats.dropped_frames > 0);
+  assert(stats.max_queue_depth > config.max_queue_depth * 2);
+
+  // The encoder catches up, the frame rate comes back first...
+  encoder.run(70, 3, 10);
+  controller.getStats(stats);
+  assert(stats.decimation == 1 && !stats.bitrate_increases);
+  assert(stats.decimation_decreases == config.max_decimation - 1);
+  // ...then the bitrate up to where it started
+  assert(encoder.run(400, 3, 3) == BITRATE);
+  controller.getStats(stats);
+  assert(stats.bitrate == BITRATE && stats.bitrate_increases > 0);
+}
+
+static void testStall() {
+  RateController controller;
+  RateControlConfig config;
+  assert(controller.configure(true, config) == 0);
+  Encoder encoder(controller);
+  assert(!encoder.run(10, 2, 2));
+  // Writes blocked 50 ms of every 100 ms, the queue itself is short
+  const uint32_t bitrate = encoder.run(6, 2, 2, 50000);
+  assert(bitrate == BITRATE * 3 / 4);
+  std::vector<RateDecision> decisions;
+  controller.getDecisions(decisions);
+  assert(decisions.size() == 1);
+  assert(decisions[0].reason == RateReason::StorageStall);
+  assert(decisions[0].old_bitrate == BITRATE && decisions[0].bitrate == bitrate);
+  assert(decisions[0].stall_permille == 500 && decisions[0].decimation == 1);
+  assert(decisions[0].output_bps > 0);
+}
+
+static void testOutputRate() {
+  RateController controller;
+  RateControlConfig config;
+  config.min_bitrate = 1000000;
+  assert(controller.configure(true, config) == 0);
+  Encoder encoder(controller);
+  // A simple scene takes half of the bitrate, the cut starts from there
+  encoder.output_permille = 500;
+  assert(!encoder.run(10, 3, 3));
+  const uint32_t bitrate = encoder.run(6, 3, 0);
+  assert(bitrate == BITRATE / 2 * 3 / 4);
+  std::vector<RateDecision> decisions;
+  controller.getDecisions(decisions);
+  assert(decisions.size() == 1 && decisions[0].output_bps == BITRATE / 2);
+
+  // A static scene does not get its bitrate back, the frame rate does
+  encoder.output_permille = 200;
+  encoder.run(100, 3, 10);
+  RateControlStats stats;
+  controller.getStats(stats);
+  assert(stats.decimation == 1 && stats.bitrate == bitrate);
+  assert(!stats.bitrate_increases);
+  // The scene needs the bitrate again
+  encoder.output_permille = 1000;
+  assert(encoder.run(400, 3, 3) == BITRATE);
+}
+
+static void testRepeatedFrames() {
+  // An encoder repeating the last frame outputs more frames than posted,
+  // that must not hide a later backlog
+  RateController controller;
+  RateControlConfig config;
+  assert(controller.configure(true, config) == 0);
+  Encoder encoder(controller);
+  assert(!encoder.run(20, 1, 3));
+  assert(encoder.run(20, 3, 1));
+  RateControlStats stats;
+  controller.getStats(stats);
+  assert(stats.max_queue_depth > config.max_queue_depth);
+}
+
+static void testDecisionLog() {
+  RateController controller;
+  RateControlConfig config;
+  config.min_bitrate = 1;
+  config.max_decimation = 1;
+  // One decision per report
+  config.interval_ms = REPORT_US / 1000;
+  assert(controller.configure(true, config) == 0);
+  Encoder encoder(controller);
+  encoder.run(1, 0, 0);
+  // One decision per report while the queue keeps growing
+  encoder.run(RATE_MAX_DECISIONS + 5, 10, 0);
+  std::vector<RateDecision> decisions;
+  controller.getDecisions(decisions);
+  assert(decisions.size() == RATE_MAX_DECISIONS);
+  for (size_t i = 1; i < decisions.size(); i++) {
+    assert(decisions[i].time_us > decisions[i - 1].time_us);
+    assert(decisions[i].old_bitrate == decisions[i - 1].bitrate);
+    assert(decisions[i].reason == RateReason::EncoderBacklog);
+  }
+  RateControlStats stats;
+  controller.getStats(stats);
+  assert(stats.decisions == RATE_MAX_DECISIONS + 5);
+
+  // A new recording starts over
+  controller.reset();
+  controller.getDecisions(decisions);
+  controller.getStats(stats);
+  assert(decisions.empty() && !stats.decisions && !stats.bitrate);
+}
+
+int main() {
+  testConfigure();
+  testBacklog();
+  testStall();
+  testOutputRate();
+  testRepeatedFrames();
+  testDecisionLog();
+  printf("rate_controller_test: OK\n");
+  return 0;
+}
@@ -0,0 +1,222 @@
+/**
+ * Still capture host unit test
+ *
+ * Checks that complete MJPEG frames pass through byte-for-byte, that frames
+ * without Huffman tables get the standard ones and decode to the same
+ * pixels, and that uncompressed frames are encoded to a JPEG of the same
+ * picture.
+ *
+ * Copyright (c) 2024 Statslane
+ * Based on saki4510t's UVC4Flutter architecture
+ */
+
+#undef NDEBUG
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "aandusb/aandusb_native.h"
+#include "flutter_still_capture.h"
+#include "jpeg_test_utils.h"
+
+using namespace serenegiant::flutter;
+
+static std::vector<uint8_t> decodeRgb(const std::vector<uint8_t> &jpeg,
+                                      uint32_t &width, uint32_t &height) {
+  jpeg_decompress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, jpeg.data(), jpeg.size());
+  assert(jpeg_read_header(&cinfo, TRUE) == JPEG_HEADER_OK);
+  cinfo.out_color_space = JCS_RGB;
+  jpeg_start_decompress(&cinfo);
+  width = cinfo.output_width;
+  height = cinfo.output_height;
+  std::vector<uint8_t> rgb((size_t)width * height * 3);
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = &rgb[(size_t)cinfo.output_scanline * width * 3];
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return rgb;
+}
+
+// Huffman tables by class/id, the counts and symbols of each
+static std::map<uint8_t, std::vector<uint8_t>>
+huffmanTables(const std::vector<uint8_t> &jpeg) {
+  std::map<uint8_t, std::vector<uint8_t>> tables;
+  size_t pos = 2;
+  while (pos + 3 < jpeg.size() && jpeg[pos + 1] != 0xda) {
+    const size_t len = (size_t)jpeg[pos + 2] << 8 | jpeg[pos + 3];
+    if (jpeg[pos + 1] == 0xc4) {
+      size_t p = pos + 4;
+      while (p < pos + 2 + len) {
+        size_t symbols = 0;
+        for (int i = 1; i <= 16; i++) {
+          symbols += jpeg[p + i];
+        }
+        tables[jpeg[p]].assign(jpeg.begin() + p + 1,
+                               jpeg.begin() + p + 17 + symbols);
+        p += 17 + symbols;
+      }
+    }
+    pos += 2 + len;
+  }
+  return tables;
+}
+
+// Same frame without its DHT segments, as many UVC cameras send it
+static std::vector<uint8_t> stripHuffmanTables(
+    const std::vector<uint8_t> &jpeg) {
+  std::vector<uint8_t> stripped(jpeg.begin(), jpeg.begin() + 2);
+  size_t pos = 2;
+  while (jpeg[pos + 1] != 0xda) {
+    const size_t len = (size_t)jpeg[pos + 2] << 8 | jpeg[pos + 3];
+    if (jpeg[pos + 1] != 0xc4) {
+      stripped.insert(stripped.end(), jpeg.begin() + pos,
+                      jpeg.begin() + pos + 2 + len);
+    }
+    pos += 2 + len;
+  }
+  stripped.insert(stripped.end(), jpeg.begin() + pos, jpeg.end());
+  return stripped;
+}
+
+static void testPassthrough() {
+  for (unsigned int restart_interval : {0u, 1u}) {
+    const auto frame = encodeGradientFrame(320, 240, restart_interval);
+    assert(jpegHasHuffmanTables(frame.data(), frame.size()));
+    std::vector<uint8_t> jpeg;
+    assert(completeJpeg(frame.data(), frame.size(), jpeg) == 0);
+    assert(jpeg == frame);
+
+    // Padding after EOI is dropped, the JPEG itself is untouched
+    auto padded = frame;
+    padded.insert(padded.end(), {0x00, 0xff, 0xd9, 0x00, 0x00});
+    assert(completeJpeg(padded.data(), padded.size(), jpeg) == 0);
+    assert(jpeg == frame);
+  }
+}
+
+static void testInjectHuffmanTables() {
+  for (unsigned int restart_interval : {0u, 1u}) {
+    const auto frame = encodeGradientFrame(320, 240, restart_interval);
+    const auto stripped = stripHuffmanTables(frame);
+    assert(stripped.size() < frame.size());
+    assert(!jpegHasHuffmanTables(stripped.data(), stripped.size()));
+
+    std::vector<uint8_t> jpeg;
+    assert(completeJpeg(stripped.data(), stripped.size(), jpeg) == 0);
+    assert(jpegHasHuffmanTables(jpeg.data(), jpeg.size()));
+    // libjpeg's default tables are the standard ones
+    const auto expected = huffmanTables(frame);
+    assert(expected.size() == 4);
+    assert(huffmanTables(jpeg) == expected);
+
+    uint32_t w1 = 0, h1 = 0, w2 = 0, h2 = 0;
+    assert(decodeRgb(jpeg, w1, h1) == decodeRgb(frame, w2, h2));
+    assert(w1 == 320 && h1 == 240);
+  }
+}
+
+static void testBrokenFrames() {
+  const auto frame = encodeGradientFrame(64, 64, 0);
+  std::vector<uint8_t> jpeg;
+  // Cut inside the scan, no EOI
+  assert(completeJpeg(frame.data(), frame.size() - 10, jpeg) == -ENODATA);
+  // Cut inside the headers, no scan
+  assert(completeJpeg(frame.data(), 40, jpeg) == -EINVAL);
+  assert(!jpegHasHuffmanTables(frame.data(), 40));
+  // Not a JPEG
+  const uint8_t junk[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05};
+  assert(completeJpeg(junk, sizeof(junk), jpeg) == -EINVAL);
+  assert(completeJpeg(nullptr, 0, jpeg) == -EINVAL);
+}
+
+static void testEncode() {
+  const uint32_t width = 64, height = 48;
+  // YUYV and NV12 of one gray level, BT.601 limited range Y=126 -> ~128
+  std::vector<uint8_t> yuyv(width * height * 2);
+  for (size_t i = 0; i < yuyv.size(); i += 2) {
+    yuyv[i] = 126;
+    yuyv[i + 1] = 128;
+  }
+  std::vector<uint8_t> nv12(width * height * 3 / 2, 128);
+  memset(nv12.data(), 126, width * height);
+
+  JpegEncoder encoder;
+  std::vector<uint8_t> jpeg;
+  for (const auto &[type, frame] :
+       {std::make_pair(RAW_FRAME_UNCOMPRESSED_YUYV, &yuyv),
+        std::make_pair(RAW_FRAME_UNCOMPRESSED_NV12, &nv12)}) {
+    assert(makeStillJpeg(type, frame->data(), frame->size(), width, height,
+                         encoder, jpeg) == 0);
+    assert(jpegHasHuffmanTables(jpeg.data(), jpeg.size()));
+    uint32_t w = 0, h = 0;
+    const auto rgb = decodeRgb(jpeg, w, h);
+    assert(w == width && h == height);
+    const int expected = rgb[0];
+    assert(expected > 110 && expected < 150);
+    for (uint8_t v : rgb) {
+      assert(std::abs(v - expected) <= 2);
+    }
+  }
+
+  // Too short, unsupported and compressed formats
+  assert(encoder.encode(RAW_FRAME_UNCOMPRESSED_YUYV, yuyv.data(), 100, width,
+                        height, jpeg) == -ENOSPC);
+  assert(makeStillJpeg(RAW_FRAME_H264, yuyv.data(), yuyv.size(), width,
+                       height, encoder, jpeg) == -ENOTSUP);
+  // The encoder stays usable after an error
+  assert(encoder.encode(RAW_FRAME_UNCOMPRESSED_YUYV, yuyv.data(), yuyv.size(),
+                        width, height, jpeg) == 0);
+
+  // MJPEG is not re-encoded
+  const auto frame = encodeGradientFrame(64, 48, 0);
+  assert(makeStillJpeg(RAW_FRAME_MJPEG, frame.data(), frame.size(), 64, 48,
+                       encoder, jpeg) == 0);
+  assert(jpeg == frame);
+}
+
+static void testWriteFile() {
+  char dir[] = "/tmp/still_capture_testXXXXXX";
+  assert(mkdtemp(dir));
+  const std::string path = std::string(dir) + "/still.jpg";
+  const auto frame = encodeGradientFrame(64, 48, 0);
+  assert(writeStillFile(path, frame) == 0);
+
+  FILE *fp = fopen(path.c_str(), "rb");
+  assert(fp);
+  std::vector<uint8_t> read(frame.size() + 1);
+  assert(fread(read.data(), 1, read.size(), fp) == frame.size());
+  fclose(fp);
+  read.resize(frame.size());
+  assert(read == frame);
+  // The temporary file has been renamed
+  fp = fopen((path + ".tmp").c_str(), "rb");
+  assert(!fp);
+
+  assert(writeStillFile(std::string(dir) + "/missing/still.jpg", frame) ==
+         -ENOENT);
+  assert(writeStillFile(path, {}) == -EINVAL);
+  remove(path.c_str());
+  rmdir(dir);
+}
+
+int main() {
+  testPassthrough();
+  testInjectHuffmanTables();
+  testBrokenFrames();
+  testEncode();
+  testWriteFile();
+  printf("still_capture_test: OK\n");
+  return 0;
+}
@@ -0,0 +1,1495 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * 合成UVC機器バックエンドのホスト上でのユニットテスト
+ * 実機の代わりに合成UVC機器をFlutterUVCHolder/FlutterUvcFrameRendererへ接続して動作を確認する
+ *
+ * android/src/main/cppをホストのcmakeでビルドしてctestで実行する
+ *   cmake -S android/src/main/cpp -B build && cmake --build build && ctest --test-dir build
+ */
+
+#undef NDEBUG
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "flutter_frame_capture.h"
+#include "flutter_mjpeg_decoder.h"
+#include "flutter_uvc_holder.h"
+#include "flutter_uvc_frame_renderer.h"
+#include "flutter_video_size.h"
+#include "host_native_window.h"
+#include "synthetic_uvc.h"
+
+using namespace serenegiant::flutter;
+
+static int32_t attached_id = 0;
+static int32_t detached_id = 0;
+
+static void on_attach(usb_manager_t * /*manager*/, void * /*args*/, int32_t device_id)
+{
+	attached_id = device_id;
+}
+
+static void on_detach(usb_manager_t * /*manager*/, void * /*args*/, int32_t device_id)
+{
+	detached_id = device_id;
+}
+
+/**
+ * 条件を満たすまで最大timeout_ms待つ
+ */
+template<typename Pred>
+static bool wait_for(Pred pred, const int &timeout_ms = 3000)
+{
+	const auto limit = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	while (!pred()) {
+		if (std::chrono::steady_clock::now() > limit) return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+	return true;
+}
+
+static synthetic_uvc_config_t small_config()
+{
+	synthetic_uvc_config_t config;
+	synthetic_uvc_default_config(config);
+	config.max_width = 640;
+	config.max_height = 480;
+	config.fps = 60.0f;
+	return config;
+}
+
+/**
+ * 接続/取り外しでコールバックが呼ばれ, 取り外し後はエラーになること
+ */
+static void test_attach_detach()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	auto config = small_config();
+	config.audio = true;
+	const auto id = synthetic_uvc_attach(manager, config);
+	assert(id > 0 && attached_id == id);
+	assert(uvc_get_device_state(manager, id) == CONNECTED);
+	assert(usb_get_vendor_id(manager, id) == config.vendor_id);
+	assert(usb_match(manager, id, 0x0e, 0xff, 0xff) == 1);
+	assert(usb_match(manager, id, 0x01, 0x02, 0xff) == 1);
+	uac_info_t info;
+	assert(!uac_get_info(manager, id, &info) && info.sampling_freq == 48000);
+
+	assert(!synthetic_uvc_detach(manager, id));
+	assert(detached_id == id);
+	assert(uvc_get_device_state(manager, id) == DISCONNECTED);
+	assert(uvc_start(manager, id) == -ENODEV);
+	manager_release(manager);
+}
+
+/**
+ * 非圧縮フォーマットはUSB2.0の帯域に収まるフレームレートだけに対応すること
+ */
+static void test_supported_size()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	int32_t num = 0;
+	assert(!uvc_get_supported_size(manager, id, 0, &num, nullptr));
+	// YUYV/MJPEG/NV12/H264それぞれ320x240と640x480
+	assert(num == 8);
+	for (int32_t i = 0; i < num; i++) {
+		uvc_video_size_t size;
+		assert(!uvc_get_supported_size(manager, id, i, &num, &size));
+		assert(size.num_frame_intervals > 0);
+		if ((size.width == 640) && (size.frame_type == RAW_FRAME_UNCOMPRESSED_YUYV)) {
+			// 640x480x2x60=36.8MB/秒は帯域外なので30fpsが最大
+			assert(size.frame_intervals[0] == fps_to_interval(30.0f));
+		} else if ((size.width == 640) && (size.frame_type == RAW_FRAME_MJPEG)) {
+			assert(size.frame_intervals[0] == fps_to_interval(60.0f));
+		}
+	}
+	manager_release(manager);
+}
+
+/**
+ * FlutterUVCHolderのUVC設定機能の取得/適用は対応解像度一覧/UVCコントロール一覧の取得完了を待つこと
+ */
+static void test_holder_controls_wait_ready()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	{
+		FlutterUVCHolder holder(manager, id);
+		holder.prepare_async();
+		const uint64_t type = PU_MASK | PU_BRIGHTNESS;
+		assert(!holder.set_control_value(type, 10));
+		assert(holder.is_ready());
+		int32_t value = 0;
+		assert(!holder.get_control_value(type, value));
+		assert(value == 10);
+		assert(holder.get_proc_supports() & PU_BRIGHTNESS);
+	}
+	manager_release(manager);
+}
+
+/**
+ * FlutterUVCHolderで対応解像度を列挙してRGBXへ変換したフレームを取得できること
+ */
+static void test_holder_get_frame()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	{
+		FlutterUVCHolder holder(manager, id);
+		holder.prepare_async();
+		assert(!holder.wait_ready());
+		assert(holder.supported_size().size() == 8);
+		assert(!holder.set_video_size(RAW_FRAME_UNCOMPRESSED_YUYV, 640, 480, 30.0f));
+		assert(!holder.start());
+		assert(uvc_get_device_state(manager, id) == STREAMING);
+
+		std::vector<uint8_t> buffer(640 * 480 * 4);
+		int64_t last_pts = 0;
+		for (int i = 0; i < 3; i++) {
+			uint32_t frame_type = RAW_FRAME_UNCOMPRESSED_RGBX;
+			uint32_t width = 0, height = 0, flags = 0;
+			uint32_t data_len = 0;
+			int64_t pts_us = 0;
+			assert(wait_for([&] {
+				data_len = buffer.size();
+				return !uvc_get_frame(manager, id, &frame_type, &width, &height,
+					buffer.data(), &data_len, &pts_us, &flags);
+			}));
+			assert(frame_type == RAW_FRAME_UNCOMPRESSED_RGBX);
+			assert(width == 640 && height == 480 && data_len == 640 * 480 * 4);
+			assert(pts_us > last_pts);
+			last_pts = pts_us;
+		}
+		// バッファが足りないときは必要なバイト数を返すこと
+		uint32_t frame_type = RAW_FRAME_UNCOMPRESSED_RGBX;
+		uint32_t data_len = 16;
+		assert(wait_for([&] {
+			data_len = 16;
+			return uvc_get_frame(manager, id, &frame_type, nullptr, nullptr,
+				buffer.data(), &data_len, nullptr, nullptr) == -ENOSPC;
+		}));
+		assert(data_len == 640 * 480 * 4);
+		assert(!holder.stop());
+	}
+	manager_release(manager);
+}
+
+/**
+ * FlutterUvcFrameRendererでMJPEGをデコードしてプレビューへ描画できること
+ */
+static void test_renderer_mjpeg_preview()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	auto window = host_native_window_create(320, 240);
+	{
+		FlutterUvcFrameRenderer renderer(manager, id);
+		renderer.setPreviewWindow(window, 320, 240);
+		assert(!renderer.start(640, 480, RAW_FRAME_MJPEG));
+		assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= 5; }));
+		renderer.stop();
+		renderer.setPreviewWindow(nullptr);
+	}
+	std::vector<uint8_t> rgba;
+	int32_t width = 0, height = 0;
+	assert(!host_native_window_copy_front(window, rgba, width, height));
+	assert(width == 320 && height == 240);
+	ANativeWindow_release(window);
+	manager_release(manager);
+}
+
+/**
+ * プレビューの切り出し範囲だけをデコード/変換して表示し
+ * フレーム全体をデコードした時の同じ範囲と一致すること
+ */
+static void test_renderer_preview_crop()
+{
+	static const uint32_t frame_types[] = { RAW_FRAME_MJPEG, RAW_FRAME_UNCOMPRESSED_YUYV };
+	for (const auto &frame_type : frame_types) {
+		auto manager = manager_init(nullptr, on_attach, on_detach);
+		auto config = small_config();
+		config.moving = false;
+		const auto id = synthetic_uvc_attach(manager, config);
+		auto window = host_native_window_create(640, 480);
+		std::vector<uint8_t> full, cropped;
+		int32_t width = 0, height = 0;
+		{
+			FlutterUvcFrameRenderer renderer(manager, id);
+			renderer.setPreviewWindow(window);
+			assert(!renderer.start(640, 480, frame_type));
+			const auto wait_frames = [&](const uint64_t &n) {
+				const auto posted = host_native_window_get_posted_frames(window);
+				assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= posted + n; }));
+			};
+			wait_frames(3);
+			assert(!host_native_window_copy_front(window, full, width, height));
+			assert(width == 640 && height == 480);
+
+			// 切り出し範囲をそのままの大きさで表示する
+			const FrameRect crop = { 161, 121, 320, 240 };
+			renderer.setPreviewCrop(crop);
+			wait_frames(3);
+			assert(!host_native_window_copy_front(window, cropped, width, height));
+			assert(width == 320 && height == 240);
+			for (uint32_t y = 0; y < crop.height; y++) {
+				assert(!memcmp(&cropped[y * crop.width * 4],
+					&full[((crop.y + y) * 640 + crop.x) * 4], crop.width * 4));
+			}
+
+			// 出力サイズを指定すると切り出し範囲を縮小する
+			renderer.setPreviewWindow(window, 160, 120);
+			wait_frames(3);
+			assert(!host_native_window_copy_front(window, cropped, width, height));
+			assert(width == 160 && height == 120);
+
+			// 空の範囲でフレーム全体へ戻る
+			renderer.setPreviewWindow(window);
+			renderer.setPreviewCrop(FrameRect());
+			wait_frames(3);
+			assert(!host_native_window_copy_front(window, cropped, width, height));
+			assert(width == 640 && height == 480 && cropped == full);
+			renderer.stop();
+			renderer.setPreviewWindow(nullptr);
+		}
+		ANativeWindow_release(window);
+		manager_release(manager);
+	}
+}
+
+/**
+ * 正立の映像のrectの範囲をorientationで回転/反転した映像と一致するかどうか
+ */
+static bool is_oriented(const std::vector<uint8_t> &full, const uint32_t &full_width,
+	const FrameRect &rect, const FrameOrientation &orientation,
+	const std::vector<uint8_t> &actual, const int32_t &width, const int32_t &height)
+{
+	uint32_t w, h;
+	orientedSize(orientation, rect.width, rect.height, w, h);
+	if ((width != (int32_t)w) || (height != (int32_t)h)) {
+		return false;
+	}
+	for (uint32_t y = 0; y < rect.height; y++) {
+		for (uint32_t x = 0; x < rect.width; x++) {
+			int64_t ox, oy;
+			orientPoint(orientation, rect.width, rect.height, x, y, ox, oy);
+			if (memcmp(&actual[(oy * w + ox) * 4], &full[((rect.y + y) * full_width + rect.x + x) * 4], 4)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * FlutterUvcFrameRendererでプレビューと録画をそれぞれの向きへ回転/反転できること
+ * 非圧縮映像は録画の向きで変換してプレビューはウインドウへのコピー時に向きを変える
+ */
+static void test_renderer_orientation()
+{
+	static const uint32_t frame_types[] = { RAW_FRAME_MJPEG, RAW_FRAME_UNCOMPRESSED_YUYV };
+	for (const auto &frame_type : frame_types) {
+		auto manager = manager_init(nullptr, on_attach, on_detach);
+		auto config = small_config();
+		config.moving = false;
+		const auto id = synthetic_uvc_attach(manager, config);
+		auto preview = host_native_window_create(640, 480);
+		auto recording = host_native_window_create(640, 480);
+		std::vector<uint8_t> full, actual;
+		int32_t width = 0, height = 0;
+		{
+			FlutterUvcFrameRenderer renderer(manager, id);
+			renderer.setPreviewWindow(preview);
+			assert(!renderer.start(640, 480, frame_type));
+			const auto wait_frames = [&](ANativeWindow *window, const uint64_t &n) {
+				const auto posted = host_native_window_get_posted_frames(window);
+				assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= posted + n; }));
+			};
+			wait_frames(preview, 3);
+			assert(!host_native_window_copy_front(preview, full, width, height));
+			assert(width == 640 && height == 480);
+
+			const FrameRect whole = { 0, 0, 640, 480 };
+			const FrameOrientation preview_orientation = { 90 };
+			const FrameOrientation recording_orientation = { 0, true };
+			assert(!renderer.setPreviewOrientation(preview_orientation));
+			assert(!renderer.setRecordingOrientation(recording_orientation));
+			assert(renderer.setRecordingOrientation(FrameOrientation{ 45 }) == -EINVAL);
+			renderer.setRecordingWindow(recording);
+			wait_frames(preview, 3);
+			wait_frames(recording, 3);
+			assert(!host_native_window_copy_front(preview, actual, width, height));
+			assert(is_oriented(full, 640, whole, preview_orientation, actual, width, height));
+			assert(!host_native_window_copy_front(recording, actual, width, height));
+			assert(is_oriented(full, 640, whole, recording_orientation, actual, width, height));
+
+			// 切り出してから回転する, 出力サイズは回転後の大きさ
+			const FrameRect crop = { 161, 121, 320, 240 };
+			const FrameOrientation rotated = { 270, false, true };
+			renderer.setPreviewCrop(crop);
+			renderer.setPreviewOrientation(rotated);
+			wait_frames(preview, 3);
+			assert(!host_native_window_copy_front(preview, actual, width, height));
+			assert(is_oriented(full, 640, crop, rotated, actual, width, height));
+			renderer.setPreviewWindow(preview, 120, 160);
+			wait_frames(preview, 3);
+			assert(!host_native_window_copy_front(preview, actual, width, height));
+			assert(width == 120 && height == 160);
+			renderer.stop();
+			renderer.setPreviewWindow(nullptr);
+			renderer.setRecordingWindow(nullptr);
+		}
+		ANativeWindow_release(preview);
+		ANativeWindow_release(recording);
+		manager_release(manager);
+	}
+}
+
+/**
+ * FlutterUvcFrameRendererで消費者がいなければ映像取得を一時停止して
+ * プレビューをセットすると再開すること
+ */
+static void test_renderer_idle_suspend()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	auto window = host_native_window_create(320, 240);
+	{
+		FlutterUvcFrameRenderer renderer(manager, id);
+		renderer.setIdleTimeout(20);
+		assert(!renderer.start(640, 480, RAW_FRAME_MJPEG));
+		assert(wait_for([&] { return renderer.isSuspended(); }));
+		assert(uvc_get_device_state(manager, id) == CONNECTED);
+		assert(renderer.isRunning());
+
+		renderer.setPreviewWindow(window, 320, 240);
+		assert(!renderer.isSuspended());
+		assert(uvc_get_device_state(manager, id) == STREAMING);
+		assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= 3; }));
+
+		// フレームコールバックだけなら変換せずに生フレームを渡す
+		std::atomic<int> callbacks(0);
+		renderer.setFrameCallback([&](const uint8_t *, size_t, uint32_t, uint32_t, int64_t) {
+			callbacks++;
+		});
+		renderer.setPreviewWindow(nullptr);
+		const auto posted = host_native_window_get_posted_frames(window);
+		assert(wait_for([&] { return callbacks >= 3; }));
+		assert(host_native_window_get_posted_frames(window) == posted);
+		assert(!renderer.isSuspended());
+
+		renderer.setFrameCallback(nullptr);
+		assert(wait_for([&] { return renderer.isSuspended(); }));
+		consumer_metrics_t metrics;
+		renderer.getConsumerMetrics(metrics);
+		assert(metrics.suspend_count == 2 && metrics.resume_count == 1);
+		renderer.stop();
+		assert(uvc_get_device_state(manager, id) == CONNECTED);
+	}
+	ANativeWindow_release(window);
+	manager_release(manager);
+}
+
+/**
+ * FlutterUVCHolderでプレビュー用Surfaceを外すと映像取得を一時停止して
+ * 明示的に消費者を登録すると再開すること
+ */
+static void test_holder_idle_suspend()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	auto window = host_native_window_create(640, 480);
+	{
+		FlutterUVCHolder holder(manager, id);
+		holder.prepare_async();
+		assert(!holder.set_video_size(RAW_FRAME_UNCOMPRESSED_YUYV, 640, 480, 30.0f));
+		holder.set_idle_timeout(20);
+		assert(!holder.set_preview_surface(window));
+		assert(!holder.start());
+		std::this_thread::sleep_for(std::chrono::milliseconds(60));
+		assert(uvc_get_device_state(manager, id) == STREAMING);
+
+		assert(!holder.set_preview_surface(nullptr));
+		assert(wait_for([&] { return uvc_get_device_state(manager, id) == CONNECTED; }));
+		assert(holder.is_running());
+
+		assert(holder.acquire_consumer(CONSUMER_ANALYSIS) == 1);
+		assert(uvc_get_device_state(manager, id) == STREAMING);
+		assert(holder.release_consumer(CONSUMER_ANALYSIS) == 0);
+		assert(holder.release_consumer(CONSUMER_ANALYSIS) == -EINVAL);
+		assert(wait_for([&] { return uvc_get_device_state(manager, id) == CONNECTED; }));
+
+		consumer_metrics_t metrics;
+		holder.get_consumer_metrics(metrics);
+		assert(metrics.suspend_count == 2 && metrics.resume_count == 1);
+		assert(!holder.stop());
+		assert(!holder.is_running());
+	}
+	ANativeWindow_release(window);
+	manager_release(manager);
+}
+
+/**
+ * FlutterUvcFrameRendererのヘッドレスモード中はプレビューへ描画せずに録画だけを継続して
+ * 録画も無くなると映像取得を一時停止すること
+ */
+static void test_renderer_headless()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	auto preview = host_native_window_create(320, 240);
+	auto recording = host_native_window_create(640, 480);
+	{
+		FlutterUvcFrameRenderer renderer(manager, id);
+		renderer.setIdleTimeout(20);
+		renderer.setPreviewWindow(preview, 320, 240);
+		renderer.setRecordingWindow(recording);
+		assert(!renderer.start(640, 480, RAW_FRAME_MJPEG));
+		assert(wait_for([&] { return host_native_window_get_posted_frames(preview) >= 3; }));
+
+		renderer.setHeadless(true);
+		assert(renderer.isHeadless());
+		// 切り替え時に描画中だったフレームの分を待つ(録画へ2フレーム描画すれば次のフレーム以降)
+		const auto switching = host_native_window_get_posted_frames(recording);
+		assert(wait_for([&] {
+			return host_native_window_get_posted_frames(recording) >= switching + 2; }));
+		const auto preview_posted = host_native_window_get_posted_frames(preview);
+		const auto recording_posted = host_native_window_get_posted_frames(recording);
+		assert(wait_for([&] {
+			return host_native_window_get_posted_frames(recording) >= recording_posted + 5; }));
+		assert(host_native_window_get_posted_frames(preview) == preview_posted);
+		assert(!renderer.isSuspended());
+		consumer_metrics_t metrics;
+		renderer.getConsumerMetrics(metrics);
+		assert(metrics.consumers[CONSUMER_PREVIEW] == 0);
+
+		// 録画も無くなれば一時停止する
+		renderer.setRecordingWindow(nullptr);
+		assert(wait_for([&] { return renderer.isSuspended(); }));
+
+		// ヘッドレスモードを解除するとプレビューを再開する
+		renderer.setHeadless(false);
+		assert(!renderer.isSuspended());
+		assert(wait_for([&] {
+			return host_native_window_get_posted_frames(preview) >= preview_posted + 3; }));
+		renderer.stop();
+		renderer.setPreviewWindow(nullptr);
+	}
+	ANativeWindow_release(preview);
+	ANativeWindow_release(recording);
+	manager_release(manager);
+}
+
+/**
+ * FlutterUVCHolderのヘッドレスモード中はプレビュー用Surfaceを外して
+ * 解除すると元のSurfaceへ描画を再開すること
+ */
+static void test_holder_headless()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	auto window = host_native_window_create(640, 480);
+	{
+		FlutterUVCHolder holder(manager, id);
+		holder.prepare_async();
+		assert(!holder.set_video_size(RAW_FRAME_UNCOMPRESSED_YUYV, 640, 480, 30.0f));
+		holder.set_idle_timeout(20);
+		assert(!holder.set_preview_surface(window));
+		assert(!holder.start());
+		assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= 3; }));
+
+		assert(!holder.set_headless(true));
+		assert(holder.is_headless());
+		assert(wait_for([&] { return uvc_get_device_state(manager, id) == CONNECTED; }));
+		const auto posted = host_native_window_get_posted_frames(window);
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		assert(host_native_window_get_posted_frames(window) == posted);
+
+		assert(!holder.set_headless(false));
+		assert(uvc_get_device_state(manager, id) == STREAMING);
+		assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= posted + 3; }));
+		assert(!holder.stop());
+		assert(!holder.set_preview_surface(nullptr));
+	}
+	ANativeWindow_release(window);
+	manager_release(manager);
+}
+
+/**
+ * FlutterUvcFrameRendererで映像取得中に解像度を変更しても
+ * スレッドやプレビューをそのままで新しいサイズのフレームの描画を継続すること
+ */
+static void test_renderer_reconfigure()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	auto window = host_native_window_create(640, 480);
+	{
+		FlutterUvcFrameRenderer renderer(manager, id);
+		// 映像取得前はエラー
+		assert(renderer.reconfigure(320, 240, RAW_FRAME_MJPEG) == -1);
+		renderer.setPreviewWindow(window);
+		assert(!renderer.start(640, 480, RAW_FRAME_MJPEG));
+		assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= 3; }));
+
+		assert(!renderer.reconfigure(320, 240, RAW_FRAME_MJPEG));
+		assert(renderer.isRunning());
+		assert(uvc_get_device_state(manager, id) == STREAMING);
+		assert(wait_for([&] { return renderer.getSwitchLatencyNs() > 0; }));
+		const auto posted = host_native_window_get_posted_frames(window);
+		assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= posted + 3; }));
+		// 対応していないサイズなら元の解像度のまま継続する
+		assert(renderer.reconfigure(4096, 4096, RAW_FRAME_MJPEG) == -2);
+		assert(uvc_get_device_state(manager, id) == STREAMING);
+		renderer.stop();
+		renderer.setPreviewWindow(nullptr);
+	}
+	std::vector<uint8_t> rgba;
+	int32_t width = 0, height = 0;
+	assert(!host_native_window_copy_front(window, rgba, width, height));
+	assert(width == 320 && height == 240);
+	ANativeWindow_release(window);
+	manager_release(manager);
+}
+
+/**
+ * FlutterUvcFrameRendererの解像度変更と映像取得終了を同時に呼んでも
+ * 解像度変更が終了を待たずに戻ること
+ */
+static void test_renderer_reconfigure_stop()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	{
+		FlutterUvcFrameRenderer renderer(manager, id);
+		for (int i = 0; i < 20; i++) {
+			assert(!renderer.start(640, 480, RAW_FRAME_MJPEG));
+			// 映像取得を終了するまで解像度変更を繰り返す
+			auto switching = std::async(std::launch::async, [&] {
+				for (int j = 0; ; j++) {
+					const bool small = (j % 2) == 0;
+					if (renderer.reconfigure(small ? 320 : 640, small ? 240 : 480, RAW_FRAME_MJPEG) == -1) {
+						return j;
+					}
+				}
+			});
+			std::this_thread::sleep_for(std::chrono::milliseconds(i % 5));
+			renderer.stop();
+			assert(switching.wait_for(std::chrono::seconds(3)) == std::future_status::ready);
+			switching.get();
+			assert(!renderer.isRunning());
+		}
+	}
+	manager_release(manager);
+}
+
+/**
+ * FlutterUVCHolderで映像取得中にset_video_sizeを呼んでも映像取得を継続すること
+ */
+static void test_holder_reconfigure()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	auto window = host_native_window_create(640, 480);
+	{
+		FlutterUVCHolder holder(manager, id);
+		holder.prepare_async();
+		assert(!holder.set_video_size(RAW_FRAME_UNCOMPRESSED_YUYV, 640, 480, 30.0f));
+		assert(!holder.get_switch_latency_ns());
+		assert(!holder.set_preview_surface(window));
+		assert(!holder.start());
+		assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= 3; }));
+
+		assert(!holder.set_video_size(RAW_FRAME_UNCOMPRESSED_YUYV, 320, 240, 30.0f));
+		assert(uvc_get_device_state(manager, id) == STREAMING);
+		assert(holder.get_switch_latency_ns() > 0);
+		const auto posted = host_native_window_get_posted_frames(window);
+		assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= posted + 3; }));
+		assert(!holder.stop());
+		assert(!holder.set_preview_surface(nullptr));
+	}
+	ANativeWindow_release(window);
+	manager_release(manager);
+}
+
+/**
+ * FlutterUvcFrameRendererで事前準備するとstart前にプレビューのバッファサイズが決まり
+ * start後の最初のフレームまでの時間を計測できること
+ */
+static void test_renderer_prewarm()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	auto window = host_native_window_create(1, 1);
+	{
+		FlutterUvcFrameRenderer renderer(manager, id);
+		renderer.setPreviewWindow(window, 320, 240);
+		assert(renderer.prewarm(4096, 4096, RAW_FRAME_MJPEG) == -2);
+		assert(!renderer.prewarm(640, 480, RAW_FRAME_MJPEG));
+		assert(ANativeWindow_getWidth(window) == 320 && ANativeWindow_getHeight(window) == 240);
+		assert(uvc_get_device_state(manager, id) == CONNECTED);
+		assert(!renderer.getTimeToFirstFrameNs());
+
+		assert(!renderer.start(640, 480, RAW_FRAME_MJPEG));
+		assert(renderer.prewarm(640, 480, RAW_FRAME_MJPEG) == -1);
+		assert(wait_for([&] { return renderer.getTimeToFirstFrameNs() > 0; }));
+		assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= 1; }));
+		renderer.stop();
+		renderer.setPreviewWindow(nullptr);
+	}
+	ANativeWindow_release(window);
+	manager_release(manager);
+}
+
+/**
+ * FlutterUVCHolderで事前準備してから録画すると最初のフレームまでの時間を計測できること
+ */
+static void test_holder_prewarm()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	auto window = host_native_window_create(640, 480);
+	{
+		FlutterUVCHolder holder(manager, id);
+		holder.prepare_async();
+		auto prewarmed = holder.prewarm_async();
+		assert(!prewarmed.get());
+		// 2回目以降は同じfuture
+		assert(!holder.prewarm_async().get());
+		assert(!holder.get_time_to_first_frame_ns());
+
+		assert(!holder.set_recording_surface(window));
+		assert(!holder.start());
+		assert(wait_for([&] { return holder.get_time_to_first_frame_ns() > 0; }));
+		assert(host_native_window_get_posted_frames(window) >= 1);
+		assert(!holder.set_recording_surface(nullptr));
+		assert(!holder.stop());
+	}
+	ANativeWindow_release(window);
+	manager_release(manager);
+}
+
+/**
+ * FlutterUVCHolderで切り出した範囲を回転/反転して録画できること
+ */
+static void test_holder_recording_orientation()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	auto config = small_config();
+	config.moving = false;
+	const auto id = synthetic_uvc_attach(manager, config);
+	auto window = host_native_window_create(640, 480);
+	{
+		FlutterUVCHolder holder(manager, id);
+		holder.prepare_async();
+		assert(!holder.wait_ready());
+		assert(!holder.set_recording_surface(window));
+		assert(!holder.start());
+		const auto wait_frames = [&](const uint64_t &n) {
+			const auto posted = host_native_window_get_posted_frames(window);
+			assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= posted + n; }));
+		};
+		wait_frames(3);
+		std::vector<uint8_t> full, actual;
+		int32_t width = 0, height = 0;
+		assert(!host_native_window_copy_front(window, full, width, height));
+		const uint32_t full_width = width;
+
+		const FrameRect crop = { 100, 50, 320, 240 };
+		const FrameOrientation orientation = { 90, true, false };
+		holder.set_recording_crop(crop);
+		assert(!holder.set_recording_orientation(orientation));
+		assert(holder.set_recording_orientation(FrameOrientation{ 100 }) == -EINVAL);
+		wait_frames(3);
+		assert(!host_native_window_copy_front(window, actual, width, height));
+		assert(is_oriented(full, full_width, crop, orientation, actual, width, height));
+
+		assert(!holder.set_recording_surface(nullptr));
+		assert(!holder.stop());
+	}
+	ANativeWindow_release(window);
+	manager_release(manager);
+}
+
+/**
+ * FlutterUVCHolderで録画中かどうかにかかわらずカメラが送ってきたフォーマットのまま
+ * 映像フレームを記録でき, 記録中もRGBXへ変換して録画できること
+ */
+static void test_holder_capture_file()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	auto window = host_native_window_create(640, 480);
+	char dir[] = "/tmp/synthetic_uvc_testXXXXXX";
+	assert(mkdtemp(dir));
+	const std::string path = std::string(dir) + "/capture.bin";
+	const auto check_file = [&](const size_t &min_frames) {
+		FrameCaptureReader reader;
+		assert(!reader.open(path));
+		assert(reader.is_complete());
+		assert(reader.num_frames() >= min_frames);
+		for (size_t i = 0; i < reader.num_frames(); i++)
+		{
+			capture_frame_t frame;
+			assert(!reader.get(i, frame));
+			assert(frame.frame_type == RAW_FRAME_MJPEG);
+			assert((frame.width == 640) && (frame.height == 480));
+		}
+	};
+	{
+		FlutterUVCHolder holder(manager, id);
+		holder.prepare_async();
+		assert(!holder.wait_ready());
+		assert(!holder.start());
+		// 録画していなくても記録スレッドが記録する
+		assert(!holder.start_capture(path));
+		assert(holder.is_capturing());
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		assert(!holder.stop_capture());
+		assert(!holder.is_capturing());
+		check_file(3);
+
+		// 記録中の静止画は記録スレッドが受け取ったフレームから作るので記録するフレームが抜けない
+		synthetic_uvc_stats_t before, after;
+		assert(!synthetic_uvc_get_stats(manager, id, before));
+		assert(!holder.start_capture(path));
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		std::promise<int> still;
+		std::vector<uint8_t> jpeg;
+		assert(!holder.capture_still("",
+			[&](const int32_t &, const int &r, std::vector<uint8_t> &&data) {
+				jpeg = std::move(data);
+				still.set_value(r);
+			}));
+		assert(!still.get_future().get());
+		assert(!jpeg.empty());
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		assert(!holder.stop_capture());
+		assert(!synthetic_uvc_get_stats(manager, id, after));
+		check_file(3);
+		{
+			FrameCaptureReader reader;
+			assert(!reader.open(path));
+			assert(reader.num_frames() == after.delivered - before.delivered);
+		}
+
+		// 録画中は録画スレッドがMJPEGのまま記録してからRGBXへ変換して書き込む
+		assert(!holder.set_recording_surface(window));
+		assert(!holder.start_capture(path));
+		const auto posted = host_native_window_get_posted_frames(window);
+		assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= posted + 3; }));
+		assert(!holder.stop_capture());
+		check_file(3);
+		assert(!holder.set_recording_surface(nullptr));
+		assert(!holder.stop());
+	}
+	remove(path.c_str());
+	rmdir(dir);
+	ANativeWindow_release(window);
+	manager_release(manager);
+}
+
+/**
+ * FlutterUVCHolderで静止画を撮影できること
+ * MJPEGはカメラが送ってきたJPEGへ標準のハフマンテーブルを追加しただけのもので
+ * 非圧縮フォーマットはJPEGへ圧縮してファイルへ書き込むこと
+ */
+static void test_holder_capture_still()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	auto config = small_config();
+	config.moving = false;
+	config.omit_dht = true;
+	const auto id = synthetic_uvc_attach(manager, config);
+	{
+		FlutterUVCHolder holder(manager, id);
+		holder.prepare_async();
+		assert(!holder.wait_ready());
+		const auto capture = [&](const std::string &path, std::vector<uint8_t> &jpeg) {
+			auto promise = std::make_shared<std::promise<int>>();
+			auto result = promise->get_future();
+			assert(!holder.capture_still(path,
+				[&, promise](const int32_t &device_id, const int &r, std::vector<uint8_t> &&data) {
+					assert(device_id == id);
+					jpeg = std::move(data);
+					promise->set_value(r);
+				}));
+			return result.get();
+		};
+		std::vector<uint8_t> jpeg;
+		// 映像取得中でなければ撮影できない
+		assert(holder.capture_still("", nullptr) == -EPIPE);
+
+		assert(!holder.start());
+		assert(!capture("", jpeg));
+		assert(jpegHasHuffmanTables(jpeg.data(), jpeg.size()));
+		// 毎フレーム同じ映像なのでカメラが送ってくるフレームと比較できる
+		std::vector<uint8_t> frame(640 * 480 * 2), expected;
+		uint32_t frame_type, data_len;
+		assert(wait_for([&] {
+			frame_type = RAW_FRAME_UNKNOWN;
+			data_len = frame.size();
+			return !uvc_get_frame(manager, id, &frame_type, nullptr, nullptr,
+				frame.data(), &data_len, nullptr, nullptr);
+		}));
+		assert(frame_type == RAW_FRAME_MJPEG);
+		frame.resize(data_len);
+		assert(!jpegHasHuffmanTables(frame.data(), frame.size()));
+		assert(!completeJpeg(frame.data(), frame.size(), expected));
+		assert(jpeg == expected);
+
+		// 非圧縮フォーマットはJPEGへ圧縮してファイルへ書き込む
+		char dir[] = "/tmp/synthetic_uvc_testXXXXXX";
+		assert(mkdtemp(dir));
+		const std::string path = std::string(dir) + "/still.jpg";
+		assert(!holder.set_video_size(RAW_FRAME_UNCOMPRESSED_YUYV, 320, 240, 30.0f));
+		assert(!capture(path, jpeg));
+		assert(jpeg.empty());
+		FILE *fp = fopen(path.c_str(), "rb");
+		assert(fp);
+		std::vector<uint8_t> file(320 * 240 * 4);
+		file.resize(fread(file.data(), 1, file.size(), fp));
+		fclose(fp);
+		MjpegDecoder decoder;
+		std::vector<uint8_t> rgba;
+		uint32_t width = 0, height = 0;
+		assert(!decoder.decode(file.data(), file.size(), 0, 0, rgba, width, height));
+		assert((width == 320) && (height == 240));
+		remove(path.c_str());
+		rmdir(dir);
+
+		assert(!holder.stop());
+	}
+	manager_release(manager);
+}
+
+/**
+ * FlutterUVCHolderで連写できること
+ * 録画中でなければカメラが送ってきたフォーマットのまま, 録画中は録画用のRGBXフレームを
+ * 撮影順(PTSが増加する順)に受け取れ, 指定すればJPEGへ圧縮されること
+ */
+static void test_holder_capture_burst()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	auto config = small_config();
+	config.moving = false;
+	const auto id = synthetic_uvc_attach(manager, config);
+	auto window = host_native_window_create(320, 240);
+	{
+		FlutterUVCHolder holder(manager, id);
+		holder.prepare_async();
+		assert(!holder.wait_ready());
+		const auto start = [&](const uint32_t &count, const bool &encode, std::shared_ptr<FrameBurst> &burst) {
+			auto promise = std::make_shared<std::promise<int>>();
+			auto result = promise->get_future();
+			assert(!holder.capture_burst(count, encode,
+				[&, promise](const int32_t &device_id, const int &r, std::shared_ptr<FrameBurst> frames) {
+					assert(device_id == id);
+					burst = std::move(frames);
+					promise->set_value(r);
+				}));
+			return result;
+		};
+		const auto capture = [&](const uint32_t &count, const bool &encode, std::shared_ptr<FrameBurst> &burst) {
+			return start(count, encode, burst).get();
+		};
+		const auto check_frames = [](const FrameBurst &burst, const uint32_t &frame_type,
+			const uint32_t &width, const uint32_t &height) {
+			for (uint32_t i = 0; i < burst.size(); i++)
+			{
+				const auto &frame = burst.at(i);
+				assert(frame.frame_type == frame_type);
+				assert((frame.width == width) && (frame.height == height));
+				assert(!i || (frame.pts_us > burst.at(i - 1).pts_us));
+			}
+		};
+		std::shared_ptr<FrameBurst> burst;
+		// 映像取得中でなければ撮影できない
+		assert(holder.capture_burst(4, false, nullptr) == -EPIPE);
+
+		assert(!holder.start());
+		assert(holder.capture_burst(0, false, nullptr) == -EINVAL);
+		assert(holder.capture_burst(BURST_MAX_FRAMES + 1, false, nullptr) == -EINVAL);
+		// MJPEGはカメラが送ってきたフレームのまま
+		assert(!capture(5, false, burst));
+		assert(burst && (burst->size() == 5) && !burst->encoded());
+		check_frames(*burst, RAW_FRAME_MJPEG, 640, 480);
+		// 撮影中は次の連写を開始できない
+		auto pending = start(30, false, burst);
+		assert(holder.capture_burst(1, false, nullptr) == -EBUSY);
+		assert(!pending.get());
+		assert(burst && (burst->size() == 30));
+		// コールバックから次の連写を開始できる
+		{
+			std::promise<int> chained;
+			assert(!holder.capture_burst(2, false,
+				[&](const int32_t &, const int &r, std::shared_ptr<FrameBurst>) {
+					assert(!r);
+					const int next = holder.capture_burst(3, false,
+						[&](const int32_t &, const int &r2, std::shared_ptr<FrameBurst> frames) {
+							burst = std::move(frames);
+							chained.set_value(r2);
+						});
+					assert(!next);
+				}));
+			auto chained_result = chained.get_future();
+			assert(chained_result.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+			assert(!chained_result.get());
+			assert(burst && (burst->size() == 3));
+		}
+
+		// 非圧縮フォーマットを並列にJPEGへ圧縮する
+		assert(!holder.set_video_size(RAW_FRAME_UNCOMPRESSED_YUYV, 320, 240, 30.0f));
+		assert(!capture(4, true, burst));
+		assert(burst && (burst->size() == 4) && burst->encoded());
+		check_frames(*burst, RAW_FRAME_MJPEG, 320, 240);
+		MjpegDecoder decoder;
+		std::vector<uint8_t> rgba;
+		uint32_t width = 0, height = 0;
+		assert(!decoder.decode(burst->at(3).data, burst->at(3).len, 0, 0, rgba, width, height));
+		assert((width == 320) && (height == 240));
+
+		// 録画中は録画スレッドが録画用のRGBXフレームを書き込む
+		assert(!holder.set_recording_surface(window));
+		assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= 2; }));
+		assert(!capture(6, false, burst));
+		assert(burst && (burst->size() == 6));
+		check_frames(*burst, RAW_FRAME_UNCOMPRESSED_RGBX, 320, 240);
+		assert(burst->at(0).len == 320 * 240 * 4);
+
+		assert(!holder.set_recording_surface(nullptr));
+		assert(!holder.stop());
+	}
+	ANativeWindow_release(window);
+	manager_release(manager);
+}
+
+/**
+ * 映像が止まっている間は動きを検出せず, 動き出すと検出して止まると保持時間後に解除すること
+ * 録画を動きで制限すると動きが無い間は録画用Surfaceへ書き込まないこと
+ */
+static void test_holder_motion_detection()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	auto window = host_native_window_create(320, 240);
+	{
+		FlutterUVCHolder holder(manager, id);
+		holder.prepare_async();
+		assert(!holder.wait_ready());
+		std::mutex lock;
+		std::vector<bool> events;
+		const auto on_motion = [&](const int32_t &device_id, const MotionResult &result, const int64_t &/*pts_us*/) {
+			assert(device_id == id);
+			assert(result.changed && (!result.motion || (result.changed_cells >= 2)));
+			std::lock_guard<std::mutex> guard(lock);
+			events.push_back(result.motion);
+		};
+		const auto num_events = [&]() {
+			std::lock_guard<std::mutex> guard(lock);
+			return events.size();
+		};
+		MotionConfig config;
+		config.hold_ms = 300;
+		config.interval_ms = 30;
+		MotionConfig bad = config;
+		bad.subsample = 3;
+		assert(holder.set_motion_detection(true, bad, on_motion) == -EINVAL);
+
+		assert(!synthetic_uvc_freeze(manager, id, true));
+		assert(!holder.start());
+		assert(!holder.set_motion_detection(true, config, on_motion));
+		// 止まっている間は検出しない
+		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		assert(!num_events() && !holder.in_motion());
+		// 動き出すと検出する
+		assert(!synthetic_uvc_freeze(manager, id, false));
+		assert(wait_for([&] { return num_events() >= 1; }));
+		assert(events[0] && holder.in_motion());
+		// 止まると保持時間後に解除する
+		assert(!synthetic_uvc_freeze(manager, id, true));
+		assert(wait_for([&] { return num_events() >= 2; }));
+		assert(!events[1] && !holder.in_motion());
+
+		// 動きが無い間は録画用Surfaceへ書き込まない
+		config.gate_recording = true;
+		assert(!holder.set_motion_detection(true, config, on_motion));
+		assert(!holder.set_recording_surface(window));
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+		assert(host_native_window_get_posted_frames(window) == 0);
+		assert(!synthetic_uvc_freeze(manager, id, false));
+		assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= 5; }));
+		assert((num_events() >= 3) && events[2]);
+
+		// 停止すると制限も解除する
+		assert(!synthetic_uvc_freeze(manager, id, true));
+		assert(!holder.set_motion_detection(false, config, nullptr));
+		assert(!holder.in_motion());
+		const auto posted = host_native_window_get_posted_frames(window);
+		assert(wait_for([&] { return host_native_window_get_posted_frames(window) >= posted + 5; }));
+
+		assert(!holder.set_recording_surface(nullptr));
+		assert(!holder.stop());
+	}
+	assert(synthetic_uvc_freeze(manager, -1, true) == -ENODEV);
+	ANativeWindow_release(window);
+	manager_release(manager);
+}
+
+/**
+ * 映像が止まっている間は前のフレームと同じフレームを録画用Surface/プレビューへ書き込まず,
+ * 出力の設定を変えた時と映像が動き出した時は書き込むこと
+ */
+static void test_frame_dedup()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	auto window = host_native_window_create(320, 240);
+	const auto posted = [&]() { return host_native_window_get_posted_frames(window); };
+	// 書き込まれたフレーム数が変わらなくなるまで待つ
+	const auto wait_settled = [&]() {
+		auto last = posted();
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		while (posted() != last) {
+			last = posted();
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		}
+		return last;
+	};
+	assert(!synthetic_uvc_freeze(manager, id, true));
+	{
+		FlutterUVCHolder holder(manager, id);
+		holder.prepare_async();
+		assert(!holder.wait_ready());
+		assert(!holder.repeats_frames());
+		assert(holder.set_frame_dedup(true, 0) == -EINVAL);
+		assert(!holder.set_frame_dedup(true, DEDUP_DEFAULT_SAMPLE_ROWS));
+		// 書き込まなかった間はエンコーダーが前のフレームを繰り返す
+		assert(holder.repeats_frames());
+		// 動きの無い間の録画を止める時は繰り返さない
+		MotionConfig motion;
+		motion.gate_recording = true;
+		assert(!holder.set_motion_detection(true, motion, nullptr));
+		assert(!holder.repeats_frames());
+		assert(!holder.set_motion_detection(false, motion, nullptr));
+		assert(holder.repeats_frames());
+		assert(!holder.start());
+		assert(!holder.set_recording_surface(window));
+		assert(wait_for([&] { return posted() >= 1; }));
+		const auto still = wait_settled();
+		assert(still <= 2);
+		DedupStats stats;
+		holder.get_dedup_stats(stats);
+		assert(stats.duplicates > 0 && stats.frames > stats.duplicates);
+		assert(stats.longest_run > 0 && stats.ratio() > 0.5);
+		// 録画する範囲を変えると同じフレームでも書き込む
+		holder.set_recording_crop({ 0, 0, 160, 120 });
+		assert(wait_for([&] { return posted() > still; }));
+		const auto cropped = wait_settled();
+		assert(cropped <= still + 2);
+		// 動き出すと全て書き込む
+		assert(!synthetic_uvc_freeze(manager, id, false));
+		assert(wait_for([&] { return posted() >= cropped + 10; }));
+		// 無効にすると止まっていても書き込む
+		assert(!synthetic_uvc_freeze(manager, id, true));
+		assert(!holder.set_frame_dedup(false, DEDUP_DEFAULT_SAMPLE_ROWS));
+		assert(!holder.repeats_frames());
+		const auto disabled = posted();
+		assert(wait_for([&] { return posted() >= disabled + 10; }));
+		holder.get_dedup_stats(stats);
+		assert(!stats.frames && !stats.duplicates);
+
+		assert(!holder.set_recording_surface(nullptr));
+		assert(!holder.stop());
+	}
+	{
+		// MJPEGはデコードせずに比較し, 生フレームの購読者へは全てのフレームを渡す
+		FlutterUvcFrameRenderer renderer(manager, id);
+		std::atomic<int> raw_frames(0);
+		renderer.setFrameCallback([&](const uint8_t *, size_t, uint32_t, uint32_t, int64_t) {
+			raw_frames++;
+		});
+		assert(!renderer.setFrameDedup(true));
+		renderer.setPreviewWindow(window);
+		assert(!renderer.start(320, 240, RAW_FRAME_MJPEG));
+		const auto start = posted();
+		assert(wait_for([&] { return posted() > start; }));
+		const auto still = wait_settled();
+		assert(still <= start + 2);
+		const int raw = raw_frames;
+		assert(wait_for([&] { return raw_frames >= raw + 10; }));
+		assert(posted() == still);
+		DedupStats stats;
+		renderer.getDedupStats(stats);
+		assert(stats.duplicates >= 10);
+		// プレビューの範囲を変えると同じフレームでも書き込む
+		renderer.setPreviewCrop({ 0, 0, 160, 120 });
+		assert(wait_for([&] { return posted() > still; }));
+		assert(!synthetic_uvc_freeze(manager, id, false));
+		const auto moving = posted();
+		assert(wait_for([&] { return posted() >= moving + 10; }));
+		renderer.setFrameCallback(nullptr);
+		renderer.stop();
+	}
+	ANativeWindow_release(window);
+	manager_release(manager);
+}
+
+/**
+ * 到着時刻が揺らいでもフレームコールバックへ渡すタイムスタンプは
+ * 機器側クロックに沿って等間隔かつ単調増加になり, 揺らぎを統計情報として取得できること
+ */
+static void test_renderer_clock_model()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	auto config = small_config();
+	config.jitter_us = 3000;
+	config.drift_ppm = 200.0f;
+	const auto id = synthetic_uvc_attach(manager, config);
+	const int num_frames = 90;
+	std::mutex lock;
+	std::vector<int64_t> timestamps_us;
+	std::vector<int64_t> arrivals_us;
+	{
+		FlutterUvcFrameRenderer renderer(manager, id);
+		renderer.setFrameCallback([&](const uint8_t *, size_t, uint32_t, uint32_t, int64_t pts_us) {
+			const auto now_us = PtsClockModel::monotonic_ns() / 1000;
+			std::lock_guard<std::mutex> guard(lock);
+			timestamps_us.push_back(pts_us);
+			arrivals_us.push_back(now_us);
+		});
+		assert(!renderer.start(640, 480, RAW_FRAME_MJPEG));
+		assert(wait_for([&] {
+			std::lock_guard<std::mutex> guard(lock);
+			return timestamps_us.size() >= num_frames;
+		}));
+		renderer.setFrameCallback(nullptr);
+		clock_stats_t stats;
+		renderer.getClockStats(stats);
+		assert(stats.frames >= num_frames && !stats.no_pts && !stats.resets);
+		assert(stats.jitter_ns > 0 && stats.pacing_ns > 0);
+		renderer.stop();
+	}
+	// 60fps
+	const int64_t interval_us = 16666;
+	int64_t max_error_us = 0;
+	int64_t max_arrival_error_us = 0;
+	for (int i = 1; i < num_frames; i++)
+	{
+		assert(timestamps_us[i] > timestamps_us[i - 1]);
+		if (i > num_frames / 2)
+		{
+			// フレームコールバックはタスクプールで呼び出すので取りこぼした時は間隔の倍数との差を見る
+			const int64_t dt = timestamps_us[i] - timestamps_us[i - 1];
+			const int64_t frames = std::max<int64_t>(1, llround((double)dt / interval_us));
+			max_error_us = std::max<int64_t>(max_error_us,
+				std::llabs(dt - frames * interval_us));
+			max_arrival_error_us = std::max<int64_t>(max_arrival_error_us,
+				std::llabs(arrivals_us[i] - arrivals_us[i - 1] - frames * interval_us));
+		}
+	}
+	// 到着間隔は最大±6ms揺らぐがタイムスタンプの間隔は揺らがない
+	assert(max_error_us < 1000);
+	assert(max_error_us < max_arrival_error_us);
+	manager_release(manager);
+}
+
+/**
+ * 複数の購読者がそれぞれのフォーマット/サイズ/フレームレートでフレームを受け取り
+ * 遅い購読者がいても他の購読者と映像取得は遅れないこと
+ */
+static void test_renderer_subscribers()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	{
+		FlutterUvcFrameRenderer renderer(manager, id);
+		// タスクプールでMJPEGのまま受け取る
+		std::atomic<int> raw_frames(0);
+		std::atomic<bool> raw_ok(true);
+		auto on_raw = [&](const FrameView &view) {
+			raw_ok = raw_ok && (view.frame_type == RAW_FRAME_MJPEG)
+				&& (view.len > 2) && (view.data[0] == 0xff) && (view.data[1] == 0xd8);
+			raw_frames++;
+		};
+		// 映像取得スレッドで縮小したRGBAを15fpsで受け取る
+		std::atomic<int> rgba_frames(0);
+		std::atomic<bool> rgba_ok(true);
+		auto on_rgba = [&](const FrameView &view) {
+			rgba_ok = rgba_ok && (view.frame_type == RAW_FRAME_UNCOMPRESSED_RGBX)
+				&& (view.width == 160) && (view.height == 120) && (view.len == 160 * 120 * 4);
+			rgba_frames++;
+		};
+		// 1フレーム毎に100ミリ秒かかる
+		std::atomic<int> slow_frames(0);
+		auto on_slow = [&](const FrameView &) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			slow_frames++;
+		};
+		SubscriberOptions options;
+		const auto raw_id = renderer.subscribe(options, on_raw);
+		options.format = FrameFormat::Rgba;
+		options.width = 160;
+		options.height = 120;
+		options.max_fps = 15.0f;
+		options.mode = DispatchMode::Inline;
+		const auto rgba_id = renderer.subscribe(options, on_rgba);
+		const auto slow_id = renderer.subscribe(SubscriberOptions(), on_slow);
+		assert(raw_id > 0 && rgba_id > 0 && slow_id > 0);
+
+		assert(!renderer.start(640, 480, RAW_FRAME_MJPEG));
+		assert(wait_for([&] { return raw_frames >= 60; }));
+		// 遅い購読者が間に合わないフレームは破棄する
+		SubscriberStats raw_stats, rgba_stats, slow_stats;
+		assert(!renderer.unsubscribe(slow_id));
+		assert(!renderer.getSubscriberStats(raw_id, raw_stats));
+		assert(!renderer.getSubscriberStats(rgba_id, rgba_stats));
+		assert(renderer.getSubscriberStats(slow_id, slow_stats) == -ENOENT);
+		assert(slow_frames > 0 && slow_frames < raw_frames / 3);
+		assert(raw_ok && rgba_ok);
+		assert(rgba_frames > 0 && rgba_stats.rate_limited > rgba_stats.delivered);
+		assert(rgba_stats.delivered < raw_stats.delivered / 2);
+
+		// 映像取得中に購読を解除しても残りの購読者へ配信を続ける
+		assert(!renderer.unsubscribe(rgba_id));
+		const int rgba_last = rgba_frames;
+		const int raw_last = raw_frames;
+		assert(wait_for([&] { return raw_frames >= raw_last + 10; }));
+		assert(rgba_frames == rgba_last);
+		assert(renderer.unsubscribe(rgba_id) == -ENOENT);
+		assert(!renderer.unsubscribe(raw_id));
+		renderer.stop();
+	}
+	manager_release(manager);
+}
+
+/**
+ * 合成UVC機器が埋め込んだスタンプからパイプラインの段階毎の撮影からの遅延を測定できること
+ */
+static void test_renderer_latency_probe()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	auto config = small_config();
+	config.latency_probe = true;
+	const auto id = synthetic_uvc_attach(manager, config);
+	auto preview = host_native_window_create(320, 240);
+	auto recording = host_native_window_create(640, 480);
+	{
+		FlutterUvcFrameRenderer renderer(manager, id);
+		std::atomic<int> callbacks(0);
+		renderer.setLatencyProbe(true);
+		renderer.setPreviewWindow(preview, 320, 240);
+		renderer.setRecordingWindow(recording);
+		renderer.setFrameCallback([&](const uint8_t *, size_t, uint32_t, uint32_t, int64_t) {
+			callbacks++;
+		});
+		assert(!renderer.start(640, 480, RAW_FRAME_MJPEG));
+		// COMセグメントを挿入したMJPEGもデコードできる
+		assert(wait_for([&] { return host_native_window_get_posted_frames(preview) >= 10; }));
+		assert(wait_for([&] { return callbacks >= 10; }));
+		renderer.stop();
+
+		latency_stats_t stats[LATENCY_STAGE_NUM];
+		for (int stage = 0; stage < LATENCY_STAGE_NUM; stage++)
+		{
+			renderer.getLatencyStats((latency_stage_t)stage, stats[stage]);
+			assert(stats[stage].count >= 10);
+			assert(stats[stage].min_ns > 0 && stats[stage].min_ns <= stats[stage].mean_ns);
+			assert(stats[stage].mean_ns <= stats[stage].max_ns);
+			assert(stats[stage].p50_ns <= stats[stage].p99_ns);
+		}
+		// 変換の後に描画するのでその分遅れる
+		assert(stats[LATENCY_STAGE_FETCH].mean_ns <= stats[LATENCY_STAGE_CONVERT].mean_ns);
+		assert(stats[LATENCY_STAGE_CONVERT].mean_ns <= stats[LATENCY_STAGE_PREVIEW].mean_ns);
+		assert(stats[LATENCY_STAGE_CONVERT].mean_ns <= stats[LATENCY_STAGE_RECORDING].mean_ns);
+
+		// 無効にすると集計結果を破棄して測定しない
+		renderer.setLatencyProbe(false);
+		renderer.getLatencyStats(LATENCY_STAGE_FETCH, stats[0]);
+		assert(!stats[0].count);
+	}
+	ANativeWindow_release(preview);
+	ANativeWindow_release(recording);
+	manager_release(manager);
+}
+
+/**
+ * エラー発生率を指定するとuvc_get_frameが-EIOを返すこと
+ */
+static void test_error_rate()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	auto config = small_config();
+	config.error_rate = 1.0f;
+	const auto id = synthetic_uvc_attach(manager, config);
+	assert(!uvc_resize(manager, id, RAW_FRAME_UNCOMPRESSED_NV12, 320, 240));
+	assert(!uvc_start(manager, id));
+	std::vector<uint8_t> buffer(320 * 240 * 2);
+	assert(wait_for([&] {
+		uint32_t data_len = buffer.size();
+		return uvc_get_frame(manager, id, nullptr, nullptr, nullptr,
+			buffer.data(), &data_len, nullptr, nullptr) == -EIO;
+	}));
+	synthetic_uvc_stats_t stats;
+	assert(!synthetic_uvc_get_stats(manager, id, stats));
+	assert(stats.errors > 0 && stats.delivered == 0);
+	manager_release(manager);
+}
+
+/**
+ * エンコーダーが追いつかないとビットレートを下げてから録画用Surfaceへ書き込むフレームを間引き,
+ * 追いつくとフレームレート, ビットレートの順に戻すこと
+ */
+static void test_holder_rate_control()
+{
+	auto manager = manager_init(nullptr, on_attach, on_detach);
+	const auto id = synthetic_uvc_attach(manager, small_config());
+	auto window = host_native_window_create(320, 240);
+	const auto posted = [&]() { return host_native_window_get_posted_frames(window); };
+	{
+		FlutterUVCHolder holder(manager, id);
+		holder.prepare_async();
+		assert(!holder.wait_ready());
+		RateControlConfig config;
+		config.min_bitrate = 1000000;
+		config.interval_ms = 10;
+		config.recover_intervals = 1;
+		RateControlConfig bad = config;
+		bad.interval_ms = 0;
+		assert(holder.set_rate_control(true, bad) == -EINVAL);
+		bad = config;
+		bad.max_decimation = 0;
+		assert(holder.set_rate_control(true, bad) == -EINVAL);
+		assert(!holder.set_rate_control(true, config));
+		assert(!holder.start());
+		assert(!holder.set_recording_surface(window));
+		assert(wait_for([&] { return posted() >= 10; }));
+
+		// エンコーダーが1フレームも出力しない
+		// 出力するバイト数はビットレートどおりとする
+		uint32_t bitrate = 4000000;
+		uint64_t output_bytes = 0;
+		const auto report = [&](const uint64_t &encoded) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			output_bytes += bitrate / 8 / 100;
+			const auto r = holder.report_encoder_stats(encoded, output_bytes, 0, bitrate);
+			if (r)
+			{
+				bitrate = r;
+			}
+		};
+		RateControlStats stats;
+		assert(wait_for([&] {
+			report(0);
+			holder.get_rate_control_stats(stats);
+			return stats.decimation == config.max_decimation;
+		}));
+		assert(bitrate < 4000000 && stats.bitrate == bitrate);
+		assert(stats.bitrate_decreases > 0 && stats.queue_depth > config.max_queue_depth);
+		// 4フレームに1フレームだけ書き込む
+		const auto posted_start = posted();
+		const auto dropped_start = stats.dropped_frames;
+		assert(wait_for([&] {
+			holder.get_rate_control_stats(stats);
+			return stats.dropped_frames >= dropped_start + 30;
+		}));
+		const auto written = posted() - posted_start;
+		assert(written > 0 && written * 2 < stats.dropped_frames - dropped_start);
+
+		// 追いつくと1段階ずつ戻す, 書き込んだフレーム数より多く出力したとする
+		uint64_t encoded = 0;
+		assert(wait_for([&] {
+			encoded += 1000;
+			report(encoded);
+			holder.get_rate_control_stats(stats);
+			return stats.bitrate == 4000000;
+		}));
+		assert(stats.decimation == 1 && bitrate == 4000000);
+		std::vector<RateDecision> decisions;
+		holder.get_rate_decisions(decisions);
+		assert(decisions.size() >= 2);
+		assert(decisions.front().reason == RateReason::EncoderBacklog);
+		assert(decisions.back().reason == RateReason::Recovered);
+		assert(decisions.back().decimation == 1);
+
+		// 新しい録画は制御し直す
+		assert(!holder.set_recording_surface(nullptr));
+		assert(!holder.set_recording_surface(window));
+		holder.get_rate_decisions(decisions);
+		holder.get_rate_control_stats(stats);
+		assert(decisions.empty() && !stats.decisions && !stats.bitrate);
+		// 無効ならビットレートを変えない
+		assert(!holder.set_rate_control(false, config));
+		for (int i = 0; i < 5; i++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			assert(!holder.report_encoder_stats(0, 0, 0, bitrate));
+		}
+
+		assert(!holder.set_recording_surface(nullptr));
+		assert(!holder.stop());
+	}
+	ANativeWindow_release(window);
+	manager_release(manager);
+}
+
+int main()
+{
+	test_attach_detach();
+	test_supported_size();
+	test_holder_get_frame();
+	test_holder_controls_wait_ready();
+	test_renderer_mjpeg_preview();
+	test_renderer_preview_crop();
+	test_renderer_orientation();
+	test_renderer_idle_suspend();
+	test_holder_idle_suspend();
+	test_renderer_headless();
+	test_holder_headless();
+	test_renderer_reconfigure();
+	test_renderer_reconfigure_stop();
+	test_holder_reconfigure();
+	test_renderer_prewarm();
+	test_holder_prewarm();
+	test_holder_recording_orientation();
+	test_holder_capture_file();
+	test_holder_capture_still();
+	test_holder_capture_burst();
+	test_holder_motion_detection();
+	test_frame_dedup();
+	test_holder_rate_control();
+	test_renderer_clock_model();
+	test_renderer_subscribers();
+	test_renderer_latency_probe();
+	test_error_rate();
+
+	printf("synthetic_uvc_test: OK\n");
+	return 0;
+}
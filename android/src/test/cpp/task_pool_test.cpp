@@ -0,0 +1,263 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * 共有タスクプール(TaskPool/TaskGroup)のホスト上でのユニットテスト
+ *
+ * android/src/main/cppをホストのcmakeでビルドしてctestで実行する
+ *   cmake -S android/src/main/cpp -B build && cmake --build build && ctest --test-dir build
+ */
+
+#undef NDEBUG
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "flutter_task_pool.h"
+
+using namespace serenegiant::flutter;
+
+/**
+ * 実行順を確認するときはメインスレッドがTaskGroup::waitでタスクを実行しないように
+ * ワーカースレッドが全て実行するまで待つ
+ */
+static void wait_size(std::mutex &lock, const size_t &size, const std::function<size_t()> &get)
+{
+	for ( ; ; ) {
+		{
+			std::lock_guard<std::mutex> l(lock);
+			if (get() >= size) return;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+/**
+ * ワーカースレッドが1つのタスクプールでワーカースレッドを塞いでおき
+ * その間に投入したタスクの実行順を確認するためのヘルパー
+ */
+class Blocker {
+private:
+	std::promise<void> m_release;
+	std::promise<void> m_started;
+public:
+	explicit Blocker(TaskPool &pool)
+	{
+		auto release = m_release.get_future().share();
+		pool.submit(-1, TASK_PRIORITY_RECORDING, [this, release]() {
+			m_started.set_value();
+			release.wait();
+		});
+		m_started.get_future().wait();
+	}
+	void release()
+	{
+		m_release.set_value();
+	}
+};
+
+/**
+ * 優先度の高い順(録画→プレビュー→映像解析)に実行すること
+ */
+static void test_priority()
+{
+	TaskPool pool(1);
+	std::mutex lock;
+	std::vector<std::string> order;
+	auto record = [&](const char *name) {
+		return [&, name]() {
+			std::lock_guard<std::mutex> l(lock);
+			order.push_back(name);
+		};
+	};
+	Blocker blocker(pool);
+	TaskGroup group(pool, 1);
+	group.run(TASK_PRIORITY_ANALYSIS, record("analysis"));
+	group.run(TASK_PRIORITY_PREVIEW, record("preview"));
+	group.run(TASK_PRIORITY_RECORDING, record("recording"));
+	blocker.release();
+	wait_size(lock, 3, [&]() { return order.size(); });
+	group.wait();
+	assert(order.size() == 3);
+	assert(order[0] == "recording" && order[1] == "preview" && order[2] == "analysis");
+}
+
+/**
+ * 同じ優先度ならUVC機器毎に交互に実行すること
+ */
+static void test_fairness()
+{
+	TaskPool pool(1);
+	std::mutex lock;
+	std::vector<int> order;
+	Blocker blocker(pool);
+	TaskGroup group_a(pool, 1);
+	TaskGroup group_b(pool, 2);
+	for (int i = 0; i < 10; i++) {
+		group_a.run(TASK_PRIORITY_PREVIEW, [&]() { std::lock_guard<std::mutex> l(lock); order.push_back(1); });
+	}
+	for (int i = 0; i < 3; i++) {
+		group_b.run(TASK_PRIORITY_PREVIEW, [&]() { std::lock_guard<std::mutex> l(lock); order.push_back(2); });
+	}
+	blocker.release();
+	wait_size(lock, 13, [&]() { return order.size(); });
+	group_a.wait();
+	group_b.wait();
+	assert(order.size() == 13);
+	// 機器2の3つのタスクは機器1のタスクと交互に最初の6つの中で実行される
+	const std::vector<int> head(order.begin(), order.begin() + 6);
+	assert((head == std::vector<int> { 1, 2, 1, 2, 1, 2 }));
+}
+
+/**
+ * タスク内で投入したタスクを他のワーカースレッドが盗んで実行できること
+ * TaskGroup::waitはタスク内から呼んでもデッドロックしないこと
+ */
+static void test_nested_steal()
+{
+	TaskPool pool(4);
+	std::atomic<int> count{0};
+	std::promise<void> done;
+	// ワーカースレッド上で実行させるためにTaskGroupを使わずに投入して待つ
+	pool.submit(1, TASK_PRIORITY_PREVIEW, [&]() {
+		TaskGroup inner(pool, 1);
+		for (int j = 0; j < 64; j++) {
+			inner.run(TASK_PRIORITY_PREVIEW, [&]() {
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+				count++;
+			});
+		}
+		inner.wait();
+		done.set_value();
+	});
+	done.get_future().wait();
+	assert(count == 64);
+
+	task_pool_metrics_t metrics;
+	pool.get_metrics(metrics);
+	assert(metrics.num_workers == 4);
+	assert(metrics.queues[TASK_PRIORITY_PREVIEW].submitted == 1 + 64);
+	assert(metrics.queues[TASK_PRIORITY_PREVIEW].executed == 1 + 64);
+	assert(metrics.queues[TASK_PRIORITY_PREVIEW].queued == 0);
+	// 投入したワーカースレッド以外のワーカースレッドが盗んで実行する
+	assert(metrics.stolen > 0);
+}
+
+/**
+ * TaskGroup::waitは自分のタスクだけを実行し, 他のUVC機器のタスクに待たされないこと
+ */
+static void test_wait_isolation()
+{
+	TaskPool pool(1);
+	Blocker blocker(pool);
+	const auto caller = std::this_thread::get_id();
+	// 他のUVC機器の遅い映像解析のタスク
+	std::atomic<bool> slow_on_caller{false};
+	TaskGroup other(pool, 2);
+	other.run(TASK_PRIORITY_ANALYSIS, [&]() {
+		slow_on_caller = std::this_thread::get_id() == caller;
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	});
+	std::atomic<int> count{0};
+	TaskGroup group(pool, 1);
+	for (int i = 0; i < 3; i++) {
+		group.run(TASK_PRIORITY_RECORDING, [&]() { count++; });
+	}
+	// ワーカースレッドが塞がっているので自分のタスクは待機中のスレッドが実行する
+	const auto start = std::chrono::steady_clock::now();
+	group.wait();
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+	assert(count == 3);
+	assert(elapsed < std::chrono::milliseconds(100));
+	assert(!slow_on_caller);
+	blocker.release();
+	other.wait();
+}
+
+/**
+ * 統計情報
+ */
+static void test_metrics()
+{
+	TaskPool pool(1);
+	Blocker blocker(pool);
+	TaskGroup group(pool, 7);
+	for (int i = 0; i < 5; i++) {
+		group.run(TASK_PRIORITY_ANALYSIS, []() {});
+	}
+	task_pool_metrics_t metrics;
+	assert(!pool.get_metrics(7, metrics));
+	assert(metrics.queues[TASK_PRIORITY_ANALYSIS].queued == 5);
+	assert(metrics.queues[TASK_PRIORITY_ANALYSIS].max_queued == 5);
+	assert(metrics.queues[TASK_PRIORITY_ANALYSIS].executed == 0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	blocker.release();
+	group.wait();
+	// waitが実行したタスクもワーカースレッドがキューから取り出すまで残る
+	std::mutex lock;
+	wait_size(lock, 5, [&]() {
+		pool.get_metrics(7, metrics);
+		return (size_t)metrics.queues[TASK_PRIORITY_ANALYSIS].executed;
+	});
+	assert(!pool.get_metrics(7, metrics));
+	assert(metrics.queues[TASK_PRIORITY_ANALYSIS].submitted == 5);
+	assert(metrics.queues[TASK_PRIORITY_ANALYSIS].executed == 5);
+	assert(metrics.queues[TASK_PRIORITY_ANALYSIS].queued == 0);
+	assert(metrics.queues[TASK_PRIORITY_ANALYSIS].max_wait_ns >= 5000000);
+	assert(metrics.queues[TASK_PRIORITY_RECORDING].submitted == 0);
+
+	pool.remove_device(7);
+	assert(pool.get_metrics(7, metrics) == -ENOENT);
+	assert(pool.submit(7, TASK_PRIORITY_NUM, []() {}) == -EINVAL);
+	assert(pool.submit(7, TASK_PRIORITY_PREVIEW, nullptr) == -EINVAL);
+}
+
+/**
+ * 破棄時にキューに残っているタスクを全て実行すること
+ */
+static void test_drain_on_destroy()
+{
+	std::atomic<int> count{0};
+	{
+		TaskPool pool(2);
+		for (int i = 0; i < 100; i++) {
+			pool.submit(i % 3, TASK_PRIORITY_PREVIEW, [&]() { count++; });
+		}
+	}
+	assert(count == 100);
+}
+
+int main()
+{
+	test_priority();
+	test_fairness();
+	test_nested_steal();
+	test_wait_isolation();
+	test_metrics();
+	test_drain_on_destroy();
+
+	printf("task_pool_test: OK\n");
+	return 0;
+}
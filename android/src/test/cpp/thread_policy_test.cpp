@@ -0,0 +1,231 @@
+/**
+ * aAndUsb
+ * Copyright (c) 2014-2026 saki t_saki@serenegiant.com
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * 映像処理スレッドのスレッドポリシー(PipelineThread)のホスト上でのユニットテスト
+ *
+ * android/src/main/cppをホストのcmakeでビルドしてctestで実行する
+ *   cmake -S android/src/main/cpp -B build && cmake --build build && ctest --test-dir build
+ */
+
+#undef NDEBUG
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "flutter_task_pool.h"
+#include "flutter_thread_policy.h"
+
+using namespace serenegiant::flutter;
+
+static int32_t thread_id()
+{
+	return (int32_t)syscall(__NR_gettid);
+}
+
+static bool find_stats(const int32_t &device_id, const char *name, thread_stats_t &stats)
+{
+	std::vector<thread_stats_t> list;
+	get_thread_stats(device_id, list);
+	for (const auto &s: list)
+	{
+		if (!strcmp(s.name, name))
+		{
+			stats = s;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * スレッド名をセットして実行中だけ統計情報を取得できること
+ * 長すぎるスレッド名は切り捨てること
+ */
+static void test_name_and_stats()
+{
+	std::thread t([]() {
+		PipelineThread thread(5, "uvc5-name-too-long-for-linux");
+		char name[32] = {};
+		pthread_getname_np(pthread_self(), name, sizeof(name));
+		assert(!strcmp(name, "uvc5-name-too-l"));
+		for (int i = 0; i < 10; i++)
+		{
+			thread.update();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		thread_stats_t stats;
+		assert(find_stats(5, "uvc5-name-too-l", stats));
+		assert(stats.tid == thread_id());
+		assert(stats.samples == 11);
+		assert(stats.sched_policy == SCHED_OTHER);
+		assert(stats.cpu >= 0);
+		// コンテキストスイッチ回数は集計する間隔が経過するまで更新しない
+		const auto voluntary = stats.voluntary_switches;
+		std::this_thread::sleep_for(std::chrono::nanoseconds(THREAD_STATS_INTERVAL_NS));
+		thread.update();
+		assert(find_stats(5, "uvc5-name-too-l", stats));
+		assert(stats.samples == 12);
+		// sleepで待機しているので自発的コンテキストスイッチが数えられている
+		assert(stats.voluntary_switches > voluntary);
+	});
+	t.join();
+	std::vector<thread_stats_t> list;
+	get_thread_stats(5, list);
+	assert(list.empty());
+}
+
+/**
+ * スレッド開始前にセットしたnice値を適用すること
+ */
+static void test_nice()
+{
+	const thread_policy_t policy = { 0, 5, 0 };
+	assert(!set_thread_policy(6, policy));
+	thread_policy_t p;
+	assert(!get_thread_policy(6, p));
+	assert((p.cpu_mask == 0) && (p.nice == 5) && (p.rt_priority == 0));
+	std::thread t([]() {
+		PipelineThread thread(6, "uvc6-nice");
+		assert(getpriority(PRIO_PROCESS, thread_id()) == 5);
+		thread_stats_t stats;
+		assert(find_stats(6, "uvc6-nice", stats));
+		assert(stats.policy_result == 0);
+	});
+	t.join();
+	// 他のスレッドには影響しない
+	assert(getpriority(PRIO_PROCESS, thread_id()) == 0);
+}
+
+/**
+ * 実行中にセットしたCPUアフィニティを次のupdateで適用すること
+ */
+static void test_affinity_at_runtime()
+{
+	std::atomic<bool> running(true);
+	std::atomic<int> cpu(-1);
+	std::thread t([&]() {
+		PipelineThread thread(7, "uvc7-affinity");
+		while (running)
+		{
+			thread.update();
+			cpu = sched_getcpu();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+	// 最初の1つのCPUだけで実行させる
+	cpu_set_t cpus;
+	assert(!sched_getaffinity(0, sizeof(cpus), &cpus));
+	int first = 0;
+	while (!CPU_ISSET(first, &cpus)) first++;
+	const thread_policy_t policy = { 1ULL << first, 0, 0 };
+	assert(!set_thread_policy(7, policy));
+	thread_stats_t stats {};
+	for (int i = 0; i < 1000; i++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		if ((cpu == first) && find_stats(7, "uvc7-affinity", stats) && (stats.cpu == first)) break;
+	}
+	assert(cpu == first);
+	assert(stats.policy_result == 0);
+	running = false;
+	t.join();
+}
+
+/**
+ * SCHED_FIFOにできなければnice値を適用してエラーコードを残すこと
+ */
+static void test_realtime()
+{
+	const thread_policy_t policy = { 0, 3, 10 };
+	assert(!set_thread_policy(8, policy));
+	std::thread t([]() {
+		PipelineThread thread(8, "uvc8-rt");
+		thread_stats_t stats;
+		assert(find_stats(8, "uvc8-rt", stats));
+		int sched_policy;
+		sched_param param;
+		assert(!pthread_getschedparam(pthread_self(), &sched_policy, &param));
+		if (stats.sched_policy == SCHED_FIFO)
+		{
+			assert(stats.policy_result == 0);
+			assert((sched_policy == SCHED_FIFO) && (param.sched_priority == 10));
+		}
+		else
+		{
+			// 権限が無い環境
+			assert(stats.policy_result < 0);
+			assert(sched_policy == SCHED_OTHER);
+			assert(getpriority(PRIO_PROCESS, thread_id()) == 3);
+		}
+	});
+	t.join();
+}
+
+static void test_errors()
+{
+	thread_policy_t policy;
+	assert(get_thread_policy(100, policy) == -ENOENT);
+	assert(set_thread_policy(100, { 0, -21, 0 }) == -EINVAL);
+	assert(set_thread_policy(100, { 0, 20, 0 }) == -EINVAL);
+	assert(set_thread_policy(100, { 0, 0, 100 }) == -EINVAL);
+	assert(set_thread_policy(100, { 0, 0, -1 }) == -EINVAL);
+	assert(get_thread_policy(100, policy) == -ENOENT);
+}
+
+/**
+ * タスクプールのワーカースレッドもスレッドポリシーの対象になること
+ */
+static void test_pool()
+{
+	TaskPool pool(2);
+	std::vector<thread_stats_t> list;
+	for (int i = 0; (i < 1000) && (list.size() < 2); i++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		get_thread_stats(THREAD_POLICY_POOL, list);
+	}
+	assert(list.size() == 2);
+	thread_stats_t stats;
+	assert(find_stats(THREAD_POLICY_POOL, "uvc-pool0", stats));
+	assert(find_stats(THREAD_POLICY_POOL, "uvc-pool1", stats));
+}
+
+int main()
+{
+	test_name_and_stats();
+	test_nice();
+	test_affinity_at_runtime();
+	test_realtime();
+	test_errors();
+	test_pool();
+
+	printf("thread_policy_test: OK\n");
+	return 0;
+}
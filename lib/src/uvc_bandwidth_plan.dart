@@ -0,0 +1,93 @@
+// Copyright (c) 2020-2025 saki t_saki@serenegiant.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+import 'package:uvc_recorder_plus/uvc_recorder_plus.dart';
+
+/// 複数UVC機器の帯域計画の要求(UVC機器毎)
+class BandwidthRequest {
+  /// UVC機器の識別子
+  final int deviceId;
+
+  /// 最小映像幅[ピクセル数], 0なら制限なし
+  final int minWidth;
+
+  /// 最小映像高さ[ピクセル数], 0なら制限なし
+  final int minHeight;
+
+  /// 最小フレームレート, 0以下なら15fps
+  final double minFps;
+
+  /// コンストラクタ
+  BandwidthRequest(
+    this.deviceId, {
+    this.minWidth = 0,
+    this.minHeight = 0,
+    this.minFps = 0.0,
+  });
+
+  @override
+  String toString() {
+    return 'BandwidthRequest{deviceId:$deviceId, minWidth:$minWidth, minHeight:$minHeight, minFps:$minFps}';
+  }
+}
+
+/// 複数UVC機器の帯域計画の結果(UVC機器毎)
+class BandwidthPlan {
+  /// UVC機器の識別子
+  final int deviceId;
+
+  final int frameType;
+
+  /// 映像幅[ピクセル数]
+  final int width;
+
+  /// 映像高さ[ピクセル数]
+  final int height;
+
+  /// フレームインターバル[100ナノ秒単位]
+  /// 録画時はこのフレームレートへ間引く
+  final int frameInterval;
+
+  /// フレームレート
+  final double fps;
+
+  /// 必要な帯域の見積もり[バイト/秒]
+  /// UVC機器がネゴシエーションするフレームレートで見積もる
+  final int bandwidth;
+
+  /// UVC機器がネゴシエーションするフレームインターバル[100ナノ秒単位]
+  /// 映像サイズ変更時にフレームインターバルを指定できないので対応している最短のもの
+  final int negotiatedInterval;
+
+  /// UVC機器がネゴシエーションするフレームレート
+  final double negotiatedFps;
+
+  /// コンストラクタ
+  BandwidthPlan(
+    this.deviceId,
+    this.frameType,
+    this.width,
+    this.height,
+    this.frameInterval,
+    this.fps,
+    this.bandwidth,
+    this.negotiatedInterval,
+    this.negotiatedFps,
+  );
+
+  @override
+  String toString() {
+    return 'BandwidthPlan{deviceId:$deviceId, frameType:$frameType/(${VideoSize.frameTypeString(frameType)}), width:$width, height:$height, frameInterval:$frameInterval, fps:$fps, bandwidth:$bandwidth, negotiatedFps:$negotiatedFps}';
+  }
+}
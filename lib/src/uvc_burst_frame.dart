@@ -0,0 +1,47 @@
+// Copyright (c) 2020-2025 saki t_saki@serenegiant.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+import 'dart:typed_data';
+
+/// 連写で撮影した1フレーム
+class BurstFrame {
+  /// 機器側のPTS
+  final Duration pts;
+
+  /// フレームフォーマット(FRAME_TYPE_XXX), JPEGへ圧縮した時はFRAME_TYPE_MJPEG
+  final int frameType;
+
+  /// 映像幅
+  final int width;
+
+  /// 映像高さ
+  final int height;
+
+  /// フレームデータ, native側で確保したスロットをコピーせずに参照する
+  final Uint8List data;
+
+  /// コンストラクタ
+  BurstFrame(
+    this.pts,
+    this.frameType,
+    this.width,
+    this.height,
+    this.data,
+  );
+
+  @override
+  String toString() {
+    return 'BurstFrame{pts:$pts, frameType:0x${frameType.toRadixString(16)}, width:$width, height:$height, bytes:${data.length}}';
+  }
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2020-2025 saki t_saki@serenegiant.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+/// 機器側PTSからCLOCK_MONOTONICへのクロックモデルの推定結果と到着時刻の揺らぎ
+/// 録画中に録画用Surfaceへ書き込んだフレームから推定する
+class ClockStats {
+  /// クロックモデルへ入力したフレーム数
+  final int frames;
+
+  /// PTSが無いので到着時刻をそのまま使ったフレーム数
+  final int noPts;
+
+  /// PTSの巻き戻り/不連続でクロックモデルをやり直した回数
+  final int resets;
+
+  /// 推定に使っているフレーム数
+  final int samples;
+
+  /// 機器側クロックのずれ[ppm], 正なら機器側クロックが進んでいる
+  final double driftPpm;
+
+  /// 到着時刻の揺らぎの標準偏差
+  final Duration jitter;
+
+  /// 到着時刻の揺らぎの最大値
+  final Duration maxJitter;
+
+  /// 揺らぎを吸収するために録画用Surfaceへの書き込みを遅らせる時間
+  final Duration pacing;
+
+  /// コンストラクタ
+  ClockStats(
+    this.frames,
+    this.noPts,
+    this.resets,
+    this.samples,
+    this.driftPpm,
+    this.jitter,
+    this.maxJitter,
+    this.pacing,
+  );
+
+  @override
+  String toString() {
+    return 'ClockStats{frames:$frames, noPts:$noPts, resets:$resets, samples:$samples, driftPpm:${driftPpm.toStringAsFixed(1)}, jitter:$jitter, maxJitter:$maxJitter, pacing:$pacing}';
+  }
+}
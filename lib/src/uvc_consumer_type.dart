@@ -0,0 +1,27 @@
+// Copyright (c) 2020-2025 saki t_saki@serenegiant.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+/// 映像の消費者の種類
+/// 消費者がいなくなると猶予時間の経過後にUVC機器からの映像取得を一時停止する
+/// プレビュー/録画用Surfaceはnative側で自動的に登録する
+enum ConsumerType {
+  /// プレビュー
+  preview,
+
+  /// 録画
+  recording,
+
+  /// 映像解析
+  analysis,
+}
@@ -27,8 +27,17 @@ import 'package:logger/logger.dart';
 import './uvc_manager_platform_interface.dart';
 import './uvcplugin_bindings_generated.dart';
 import './uvc_device_info.dart';
+import './uvc_latency_stats.dart';
+import './uvc_motion.dart';
 import './uvc_control_info.dart';
 import './uvc_video_size.dart';
+import './uvc_bandwidth_plan.dart';
+import './uvc_burst_frame.dart';
+import './uvc_clock_stats.dart';
+import './uvc_dedup_stats.dart';
+import './uvc_rate_control.dart';
+import './uvc_consumer_type.dart';
+import './uvc_thread_policy.dart';
 
 //--------------------------------------------------------------------------------
 // 定数達
@@ -97,12 +106,16 @@ class _VideoParam {
   final int frameType;
   final int width;
   final int height;
+  final double fps;
+  final double minFps;
+  final double maxFps;
 
-  _VideoParam(this.frameType, this.width, this.height);
+  _VideoParam(this.frameType, this.width, this.height,
+      {this.fps = 0.0, this.minFps = 0.0, this.maxFps = 0.0});
 
   @override
   String toString() {
-    return '_VideoParam{frameType:$frameType, width:$width, height:$height}';
+    return '_VideoParam{frameType:$frameType, width:$width, height:$height, fps:$fps, minFps:$minFps, maxFps:$maxFps}';
   }
 }
 
@@ -163,6 +176,13 @@ class UVCController implements UVCControllerInterface {
   final _supportedSize = <VideoSize>[];             // List<VideoSize>
   /// 対応UVC機器コントロール設定一覧
   final _supportedControls = <int, ControlInfo>{};  // Map<int, ControlInfo>
+  /// native側での対応解像度一覧/UVCコントロール一覧の取得完了待機用
+  final _capabilitiesReady = Completer<void>();
+  /// native側での静止画の撮影完了待機用
+  Completer<Uint8List?>? _stillCaptured;
+  Completer<List<BurstFrame>>? _burstCaptured;
+  /// native側からの動き検出イベントの配信用
+  final _motionEvents = StreamController<MotionEvent>.broadcast();
 
   /// コンストラクタ
   UVCController({
@@ -177,6 +197,7 @@ class UVCController implements UVCControllerInterface {
     if (textureId >= 0) {
       await releaseTexture();
     }
+    await _motionEvents.close();
   }
 
   /// 現在の接続状態を取得する
@@ -205,10 +226,387 @@ class UVCController implements UVCControllerInterface {
     return _binding.stop(deviceId);
   }
 
+  /// 受け取った映像フレームのファイルへの記録を開始する
+  /// 録画中のフレームを記録する
+  /// @param path 記録ファイルのパス, 既存のファイルは上書きする
+  @override
+  int startFrameCapture(String path) {
+    if (_debug) _logger.d("UVCController#startFrameCapture:deviceId=$deviceId,path=$path");
+    final nativePath = path.toNativeUtf8();
+    try {
+      return _binding.start_frame_capture(deviceId, nativePath.cast<ffi.Char>());
+    } finally {
+      ffi.malloc.free(nativePath);
+    }
+  }
+
+  /// 映像フレームの記録を終了する
+  @override
+  int stopFrameCapture() {
+    if (_debug) _logger.d("UVCController#stopFrameCapture:deviceId=$deviceId");
+    return _binding.stop_frame_capture(deviceId);
+  }
+
+  /// 映像の消費者を登録する
+  /// プレビュー/録画以外で映像を使う時に呼ぶ
+  /// 消費者がいなくて映像取得を一時停止していればすぐに再開する
+  /// @return 0以上: 登録後のその種類の消費者の数, 負: エラーコード
+  @override
+  int acquireConsumer(ConsumerType type) {
+    if (_debug) _logger.d("UVCController#acquireConsumer:deviceId=$deviceId,type=$type");
+    return _binding.acquire_consumer(deviceId, type.index);
+  }
+
+  /// acquireConsumerで登録した映像の消費者を解除する
+  /// 消費者がいなくなれば猶予時間の経過後に映像取得を一時停止する
+  /// @return 0以上: 解除後のその種類の消費者の数, 負: エラーコード
+  @override
+  int releaseConsumer(ConsumerType type) {
+    if (_debug) _logger.d("UVCController#releaseConsumer:deviceId=$deviceId,type=$type");
+    return _binding.release_consumer(deviceId, type.index);
+  }
+
+  /// 消費者がいなくなってから映像取得を一時停止するまでの猶予時間をセットする
+  /// @param timeout 猶予時間, nullなら一時停止しない
+  @override
+  int setIdleTimeout(Duration? timeout) {
+    if (_debug) _logger.d("UVCController#setIdleTimeout:deviceId=$deviceId,timeout=$timeout");
+    return _binding.set_idle_timeout(deviceId, timeout?.inMilliseconds ?? -1);
+  }
+
+  /// ヘッドレスモードを切り替える
+  /// ヘッドレスモード中はプレビューのための変換/描画/テクスチャ更新を止めて録画だけを継続する
+  /// アプリのライフサイクルに合わせてUVCManagerが呼び出す
+  @override
+  int setHeadless(bool headless) {
+    if (_debug) _logger.d("UVCController#setHeadless:deviceId=$deviceId,headless=$headless");
+    return _binding.set_headless(deviceId, headless ? 1 : 0);
+  }
+
+  /// 最後に映像取得中に解像度を変更した時に映像取得を再開するまでに掛かった時間を取得
+  /// 映像取得中の解像度変更はテクスチャや録画を止めずに切り替える
+  /// @return 切り替え時間, 映像取得中に変更していない/エラー時はnull
+  @override
+  Duration? getSwitchLatency() {
+    final us = _binding.get_switch_latency_us(deviceId);
+    return us > 0 ? Duration(microseconds: us) : null;
+  }
+
+  /// 映像取得を開始してから最初のフレームを受け取るまでに掛かった時間を取得
+  /// プレビューはネイティブ側で直接描画するので録画を開始して最初のフレームを書き込むまでの時間
+  /// @return 最初のフレームまでの時間, 最初のフレームを受け取っていない/エラー時はnull
+  @override
+  Duration? getTimeToFirstFrame() {
+    final us = _binding.get_time_to_first_frame_us(deviceId);
+    return us > 0 ? Duration(microseconds: us) : null;
+  }
+
+  /// 映像取得/録画スレッドのスレッドポリシーをセットする
+  /// 次のフレームから適用する, 映像取得開始前にセットしてもよい
+  @override
+  int setThreadPolicy(ThreadPolicy policy) {
+    if (_debug) _logger.d("UVCController#setThreadPolicy:deviceId=$deviceId,$policy");
+    return _setThreadPolicy(deviceId, policy);
+  }
+
+  /// 実行中の映像取得/録画スレッドの統計情報を取得する
+  @override
+  List<ThreadStats> getThreadStats() {
+    return _getThreadStats(deviceId);
+  }
+
+  /// 機器側クロックのずれと到着時刻の揺らぎを取得する
+  /// 録画中は揺らぎを取り除いた時刻に合わせて録画用Surfaceへ書き込むのでエンコーダーのタイムスタンプが等間隔になる
+  /// @return 統計情報, エラー時はnull
+  @override
+  ClockStats? getClockStats() {
+    final stats = ffi.calloc<flutter_clock_stats_t>();
+    try {
+      if (_binding.get_clock_stats(deviceId, stats) != 0) {
+        return null;
+      }
+      final s = stats.ref;
+      return ClockStats(s.frames, s.no_pts, s.resets, s.samples, s.drift_ppm,
+          Duration(microseconds: s.jitter_us),
+          Duration(microseconds: s.max_jitter_us),
+          Duration(microseconds: s.pacing_us));
+    } finally {
+      ffi.calloc.free(stats);
+    }
+  }
+
+  /// 撮影からパイプラインの段階へフレームが届くまでの遅延の測定を有効/無効にする
+  /// 映像ソースがフレームへ遅延測定用のスタンプ(シーケンス番号と撮影時刻)を埋め込んでいる時のみ測定できる
+  /// 有効/無効を切り替えると集計結果を破棄する
+  @override
+  int setLatencyProbe(bool enabled) {
+    if (_debug) _logger.d("UVCController#setLatencyProbe:deviceId=$deviceId,enabled=$enabled");
+    return _binding.set_latency_probe(deviceId, enabled ? 1 : 0);
+  }
+
+  /// 映像の一部だけを録画する
+  /// 録画用Surfaceのサイズは次のフレームから切り取る範囲のサイズになる
+  /// cropがnullまたは空なら映像全体を録画する
+  @override
+  int setRecordingCrop(Rect? crop) {
+    if (_debug) _logger.d("UVCController#setRecordingCrop:deviceId=$deviceId,crop=$crop");
+    if (crop == null || crop.isEmpty) {
+      return _binding.set_recording_crop(deviceId, 0, 0, 0, 0);
+    }
+    return _binding.set_recording_crop(deviceId,
+      crop.left.round(), crop.top.round(), crop.width.round(), crop.height.round());
+  }
+
+  /// 録画する映像を回転/反転する
+  /// 切り出した範囲を回転/反転して録画する, 録画用Surfaceのサイズは次のフレームから回転後のサイズになる
+  /// @param rotation 時計回りの回転角度, 0/90/180/270
+  @override
+  int setRecordingOrientation(int rotation, {bool mirrorH = false, bool mirrorV = false}) {
+    if (_debug) _logger.d("UVCController#setRecordingOrientation:deviceId=$deviceId,rotation=$rotation,mirrorH=$mirrorH,mirrorV=$mirrorV");
+    return _binding.set_recording_orientation(deviceId, rotation, mirrorH ? 1 : 0, mirrorV ? 1 : 0);
+  }
+
+  /// 次のフレームを静止画(JPEG)として撮影する
+  /// MJPEGの機器はデコードせずにカメラが送ってきたJPEGをそのまま使う(ハフマンテーブルが無ければ標準のものを追加する)
+  /// 非圧縮フォーマットの機器はnative側のワーカースレッドでJPEGへ圧縮する
+  /// 同時に撮影できるのは1枚だけ
+  /// @param path 書き込み先のファイルパス, 省略時はJPEGデータを返す
+  /// @return JPEGデータ, pathを指定した時はnull
+  @override
+  Future<Uint8List?> captureStill({String? path}) async {
+    if (_debug) _logger.d("UVCController#captureStill:deviceId=$deviceId,path=$path");
+    final nativePath = (path ?? "").toNativeUtf8();
+    final int result;
+    try {
+      result = _binding.capture_still(deviceId, nativePath.cast<ffi.Char>());
+    } finally {
+      ffi.malloc.free(nativePath);
+    }
+    if (result != 0) {
+      throw Exception("Failed to capture still, err=$result");
+    }
+    final completer = Completer<Uint8List?>();
+    _stillCaptured = completer;
+    return completer.future;
+  }
+
+  /// native側で静止画の撮影が完了した時の処理
+  void onStillCaptured(int result, Uint8List? jpeg) {
+    if (_debug) _logger.d("UVCController#onStillCaptured:deviceId=$deviceId,result=$result,bytes=${jpeg?.length}");
+    final completer = _stillCaptured;
+    _stillCaptured = null;
+    if (completer == null) {
+      return;
+    }
+    if (result == 0) {
+      completer.complete(jpeg);
+    } else {
+      completer.completeError(Exception("Failed to capture still, err=$result"));
+    }
+  }
+
+  /// 連続したフレームを撮影する
+  /// 撮影開始前にnative側ですべてのフレームのメモリを確保してから撮影する
+  /// 録画中は録画用のRGBXフレーム, それ以外はカメラが送ってきたフォーマットのまま返す
+  /// 同時に撮影できるのは1回だけ
+  /// @param count 撮影するフレーム数(1〜60)
+  /// @param encode trueならnative側のワーカースレッドで並列にJPEGへ圧縮する
+  /// @return 撮影したフレーム, 撮影順
+  @override
+  Future<List<BurstFrame>> captureBurst(int count, {bool encode = false}) async {
+    if (_debug) _logger.d("UVCController#captureBurst:deviceId=$deviceId,count=$count,encode=$encode");
+    final result = _binding.capture_burst(deviceId, count, encode ? 1 : 0);
+    if (result != 0) {
+      throw Exception("Failed to capture burst, err=$result");
+    }
+    final completer = Completer<List<BurstFrame>>();
+    _burstCaptured = completer;
+    return completer.future;
+  }
+
+  /// native側で連写が完了した時の処理
+  void onBurstCaptured(int result, List<BurstFrame> frames) {
+    if (_debug) _logger.d("UVCController#onBurstCaptured:deviceId=$deviceId,result=$result,frames=${frames.length}");
+    final completer = _burstCaptured;
+    _burstCaptured = null;
+    if (completer == null) {
+      return;
+    }
+    if (result == 0) {
+      completer.complete(frames);
+    } else {
+      completer.completeError(Exception("Failed to capture burst, err=$result"));
+    }
+  }
+
+  /// 動き検出を開始/停止する
+  /// 動きの有無が切り替わるとmotionEventsへイベントを送る
+  /// 録画中は録画用のフレーム, それ以外はnative側の専用スレッドで受け取ったフレームを解析する
+  /// 検出中に呼ぶと設定を変更して動きが無い状態からやり直す
+  /// @param config 動き検出の設定, nullなら停止する
+  /// @return 0: 成功, 負: エラーコード
+  @override
+  int setMotionDetection(MotionConfig? config) {
+    if (_debug) _logger.d("UVCController#setMotionDetection:deviceId=$deviceId,config=$config");
+    return _setMotionDetection(deviceId, config);
+  }
+
+  /// 動きの有無が切り替わった時のイベント
+  @override
+  Stream<MotionEvent> get motionEvents => _motionEvents.stream;
+
+  /// native側で動きの有無が切り替わった時の処理
+  void onMotion(MotionEvent event) {
+    if (_debug) _logger.d("UVCController#onMotion:deviceId=$deviceId,event=$event");
+    if (!_motionEvents.isClosed) {
+      _motionEvents.add(event);
+    }
+  }
+
+  /// 前のフレームと同じフレームを録画用Surfaceへ書き込まないようにする
+  /// 静止した映像では変換/書き込みを省き, その間はエンコーダーが前のフレームを繰り返す
+  /// 有効/無効を切り替えると統計情報を破棄する
+  /// @param enabled
+  /// @param sampleRows 非圧縮フォーマットで比較する行の間隔(1〜64), 1なら全ての行
+  /// @return 0: 成功, 負: エラーコード
+  @override
+  int setFrameDedup(bool enabled, {int sampleRows = 4}) {
+    if (_debug) _logger.d("UVCController#setFrameDedup:deviceId=$deviceId,enabled=$enabled,sampleRows=$sampleRows");
+    return _binding.set_frame_dedup(deviceId, enabled ? 1 : 0, sampleRows);
+  }
+
+  /// 重複フレームの検出の統計情報を取得する
+  /// @return 統計情報, エラー時はnull
+  @override
+  DedupStats? getDedupStats() {
+    final stats = ffi.calloc<flutter_dedup_stats_t>();
+    try {
+      if (_binding.get_dedup_stats(deviceId, stats) != 0) {
+        return null;
+      }
+      final s = stats.ref;
+      return DedupStats(s.frames, s.duplicates, s.longest_run, s.ratio);
+    } finally {
+      ffi.calloc.free(stats);
+    }
+  }
+
+  /// エンコーダーの処理待ちや書き込みの停滞に合わせて録画のビットレートとフレームレートを下げる
+  /// 変更した時の測定値はgetRateDecisionsで取得できる
+  /// 設定すると制御状態と統計情報を破棄する
+  /// @param config 制御の設定, nullなら停止する(ビットレートはそのまま)
+  /// @return 0: 成功, 負: エラーコード
+  @override
+  int setRateControl(RateControlConfig? config) {
+    if (_debug) _logger.d("UVCController#setRateControl:deviceId=$deviceId,config=$config");
+    return _setRateControl(deviceId, config);
+  }
+
+  /// ビットレート/フレームレート制御の集計結果を取得する
+  /// @return 集計結果, エラー時はnull
+  @override
+  RateControlStats? getRateControlStats() {
+    final stats = ffi.calloc<flutter_rate_control_stats_t>();
+    try {
+      if (_binding.get_rate_control_stats(deviceId, stats) != 0) {
+        return null;
+      }
+      final s = stats.ref;
+      return RateControlStats(
+        s.updates, s.decisions,
+        s.bitrate_decreases, s.bitrate_increases,
+        s.decimation_increases, s.decimation_decreases,
+        s.dropped_frames, s.output_bps,
+        s.bitrate, s.decimation,
+        s.queue_depth, s.max_queue_depth, s.stall_permille,
+      );
+    } finally {
+      ffi.calloc.free(stats);
+    }
+  }
+
+  /// 最近のビットレート/フレームレートの変更を古い順に取得する
+  @override
+  List<RateDecision> getRateDecisions() {
+    final result = <RateDecision>[];
+    final decisions = ffi.calloc<flutter_rate_decision_t>(FLUTTER_RATE_MAX_DECISIONS);
+    try {
+      final n = _binding.get_rate_decisions(deviceId, decisions, FLUTTER_RATE_MAX_DECISIONS);
+      for (int i = 0; i < n; i++) {
+        final d = decisions[i];
+        if (d.reason >= RateReason.values.length) {
+          continue;
+        }
+        result.add(RateDecision(
+          Duration(microseconds: d.time_us),
+          RateReason.values[d.reason],
+          d.old_bitrate, d.bitrate,
+          d.old_decimation, d.decimation,
+          d.queue_depth, d.output_bps, d.stall_permille,
+        ));
+      }
+    } finally {
+      ffi.calloc.free(decisions);
+    }
+    return result;
+  }
+
+  /// 撮影からパイプラインの段階へフレームが届くまでの遅延の集計結果を取得する
+  /// 1フレームも届いていない段階は含まない
+  @override
+  List<LatencyStats> getLatencyStats() {
+    final result = <LatencyStats>[];
+    final num = LatencyStage.values.length;
+    final stats = ffi.calloc<flutter_latency_stats_t>(num);
+    try {
+      final n = _binding.get_latency_stats(deviceId, stats, num);
+      for (int i = 0; i < n; i++) {
+        final s = stats[i];
+        if (s.stage < 0 || s.stage >= num) continue;
+        final histogram = <int>[];
+        for (int j = 0; j < FLUTTER_LATENCY_HISTOGRAM_BUCKETS; j++) {
+          histogram.add(s.histogram[j]);
+        }
+        result.add(LatencyStats(LatencyStage.values[s.stage], s.count,
+            Duration(microseconds: s.min_us),
+            Duration(microseconds: s.mean_us),
+            Duration(microseconds: s.max_us),
+            Duration(microseconds: s.p50_us),
+            Duration(microseconds: s.p95_us),
+            Duration(microseconds: s.p99_us),
+            histogram));
+      }
+    } finally {
+      ffi.calloc.free(stats);
+    }
+    return result;
+  }
+
+  /// 対応解像度一覧/UVCコントロール一覧のnative側での取得完了を待機する
+  /// 取得失敗時もcompleteする
+  @override
+  Future<void> waitCapabilitiesReady() async {
+    // イベントを受信する前に取得が完了している場合があるのでnative側の状態も確認する
+    // 負(ロック競合/機器無し)は取得完了ではないのでイベントを待つ
+    if (!_capabilitiesReady.isCompleted
+        && (_binding.is_capabilities_ready(deviceId) == 1)) {
+      _capabilitiesReady.complete();
+    }
+    return _capabilitiesReady.future;
+  }
+
+  /// native側で対応解像度一覧/UVCコントロール一覧の取得が完了したときの処理
+  void onCapabilitiesReady(int result) {
+    if (_debug) _logger.d("UVCController#onCapabilitiesReady:deviceId=$deviceId,result=$result");
+    if (!_capabilitiesReady.isCompleted) {
+      _capabilitiesReady.complete();
+    }
+  }
+
   /// 対応する解像度設定一覧を取得
   @override
   Future<List<VideoSize>> getSupportedSize() async {
-    await Future.delayed(Duration(milliseconds: 300));
+    await waitCapabilitiesReady();
     return compute(_updateSupportedSize, 0);
   }
 
@@ -216,7 +614,7 @@ class UVCController implements UVCControllerInterface {
   @override
   Future<List<ControlInfo>> getSupportedControls() async {
     if (_supportedControls.isEmpty) {
-      await Future.delayed(Duration(milliseconds: 300));
+      await waitCapabilitiesReady();
       _supportedControls.addAll(await compute(_updateSupportedControls, 0));
     }
     final result = _supportedControls.values.toList();
@@ -224,10 +622,18 @@ class UVCController implements UVCControllerInterface {
   }
 
   /// 映像設定を適用
+  /// 対応しているフレームインターバルの中からfpsに最も近いもの(minFps〜maxFpsの範囲内)を選択する
+  /// UVC機器へはフレームインターバルを指定できないのでUVC機器は既定のフレームレートのままで,
+  /// 選択したフレームレートは録画時にフレームを間引くのにだけ使う(プレビュー/静止画/解析は間引かない)
+  /// @param fps 要求するフレームレート, 0以下なら範囲内で最大のフレームレート
+  /// @param minFps 最小フレームレート, 0以下なら制限なし
+  /// @param maxFps 最大フレームレート, 0以下なら制限なし
   @override
-  Future<VideoSize> setSize(int frameType, int width, int height) async {
-    if (_debug) _logger.d('UVCController#setSize:frameType=$frameType,width=$width,height=$height');
-    return compute(_setSize, _VideoParam(frameType, width, height));
+  Future<VideoSize> setSize(int frameType, int width, int height,
+      {double fps = 0.0, double minFps = 0.0, double maxFps = 0.0}) async {
+    if (_debug) _logger.d('UVCController#setSize:frameType=$frameType,width=$width,height=$height,fps=$fps($minFps-$maxFps)');
+    return compute(_setSize, _VideoParam(frameType, width, height,
+        fps: fps, minFps: minFps, maxFps: maxFps));
   }
 
   /// 現在の映像設定を取得
@@ -315,7 +721,11 @@ class UVCController implements UVCControllerInterface {
   /// computeの引数にffiのバインディングを渡すとクラッシュするので通常のdart関数としてラップ
   VideoSize _setSize(_VideoParam sz) {
     if (_debug) _logger.d("UVCController#_setSize:$sz");
-    _binding.set_video_size(deviceId, sz.frameType, sz.width, sz.height);
+    var r = _binding.set_video_size_fps(deviceId, sz.frameType, sz.width, sz.height,
+        sz.fps, sz.minFps, sz.maxFps);
+    if (r != 0) {
+      _logger.w("UVCController#_setSize:failed to set video size,err=$r");
+    }
     return _getCurrentSize(0);
   }
 
@@ -326,7 +736,8 @@ class UVCController implements UVCControllerInterface {
     try {
       var r = _binding.get_current_size(deviceId, sz);
       if (r == 0) {
-        result = createVideoSizeFrom(sz.ref);
+        result = createVideoSizeFrom(sz.ref,
+            selectedFps: _binding.get_current_fps(deviceId));
       }
     } finally {
       ffi.malloc.free(sz);
@@ -467,6 +878,9 @@ class UVCManager with ChangeNotifier, WidgetsBindingObserver implements UVCManag
     //     inactive -> resume
     switch (state) {
       case AppLifecycleState.resumed:
+        for (var controller in _availableControllers.values) {
+          controller.setHeadless(false);
+        }
         // アプリがポーズ中にUVC機器が取り外された時の処理
         final List<int> removed = <int>[];
         for (var entry in _availableControllers.entries) {
@@ -489,6 +903,10 @@ class UVCManager with ChangeNotifier, WidgetsBindingObserver implements UVCManag
       case AppLifecycleState.hidden:
         break;
       case AppLifecycleState.paused:
+        // バックグラウンドの間はプレビューの処理を止めて録画だけを継続する
+        for (var controller in _availableControllers.values) {
+          controller.setHeadless(true);
+        }
         break;
       case AppLifecycleState.detached:
         break;
@@ -504,6 +922,22 @@ class UVCManager with ChangeNotifier, WidgetsBindingObserver implements UVCManag
       // 機器接続・切断イベントメッセージを受信したときの処理
         _handleOnDeviceChanged(message[1], message[2]);
         break;
+      case 'on_capabilities_ready':
+      // 対応解像度一覧/UVCコントロール一覧の取得完了イベントメッセージを受信したときの処理
+        _handleOnCapabilitiesReady(message[1], message[2]);
+        break;
+      case 'on_still_captured':
+      // 静止画の撮影完了イベントメッセージを受信したときの処理
+        _handleOnStillCaptured(message[1], message[2], message[3]);
+        break;
+      case 'on_burst_captured':
+      // 連写の完了イベントメッセージを受信したときの処理
+        _handleOnBurstCaptured(message[1], message[2], message[3]);
+        break;
+      case 'on_motion':
+      // 動きの有無が切り替わったイベントメッセージを受信したときの処理
+        _handleOnMotion(message[1], message[2], message[3], message[4], message[5]);
+        break;
       default:
         if (_debug) _logger.d('unknown received message:$message');
         break;
@@ -558,6 +992,47 @@ class UVCManager with ChangeNotifier, WidgetsBindingObserver implements UVCManag
     }
   }
 
+  /// 複数のUVC機器を同時に使うときにUSBの帯域内に収まる映像設定を計画する
+  /// 各UVC機器の対応解像度一覧から要求(最小解像度/最小フレームレート)を満たし
+  /// 帯域内に収まる組み合わせのうち処理負荷が最も小さいもの(非圧縮フォーマット優先)を選択する
+  /// 帯域内に収まる組み合わせが無ければ空リストを返す
+  /// @param requests UVC機器毎の要求
+  /// @param apply trueなら計画した映像設定を各UVC機器へ適用する
+  /// @param busBandwidth USBバスの帯域[バイト/秒], 0ならUSB2.0の周期転送の帯域
+  @override
+  Future<List<BandwidthPlan>> planVideoSizes(List<BandwidthRequest> requests,
+      {bool apply = true, int busBandwidth = 0}) async {
+    if (_debug) _logger.d("UVCManager#planVideoSizes:$requests,apply=$apply");
+    if (requests.isEmpty) {
+      return [];
+    }
+    return compute(_planVideoSizes, _PlanParam(requests, apply, busBandwidth));
+  }
+
+  /// UVC機器が接続された時に映像取得開始後の最初のフレームまでの処理を前もって行うかどうかをセットする
+  /// 有効にすると対応解像度一覧の取得後に共有タスクプールのワーカースレッドの生成や
+  /// 録画用フレームバッファの確保を行うのでstartでは映像取得の開始だけになる
+  /// 有効にした時に既に接続されているUVC機器も事前準備する
+  @override
+  int setPrewarmOnAttach(bool enabled) {
+    if (_debug) _logger.d("UVCManager#setPrewarmOnAttach:$enabled");
+    return _binding.set_prewarm_on_attach(enabled ? 1 : 0);
+  }
+
+  /// 複数UVC機器で共有するタスクプールのワーカースレッドのスレッドポリシーをセットする
+  /// 次のタスクから適用する
+  @override
+  int setPoolThreadPolicy(ThreadPolicy policy) {
+    if (_debug) _logger.d("UVCManager#setPoolThreadPolicy:$policy");
+    return _setThreadPolicy(_poolThreadPolicyId, policy);
+  }
+
+  /// 複数UVC機器で共有するタスクプールのワーカースレッドの統計情報を取得する
+  @override
+  List<ThreadStats> getPoolThreadStats() {
+    return _getThreadStats(_poolThreadPolicyId);
+  }
+
   /// 画面の自動消灯のON/OFF
   @override
   Future<Null> keepScreenOn(bool onoff) async {
@@ -583,6 +1058,52 @@ class UVCManager with ChangeNotifier, WidgetsBindingObserver implements UVCManag
     }
     notifyListeners();
   }
+
+  /// 対応解像度一覧/UVCコントロール一覧の取得が完了したときの処理
+  void _handleOnCapabilitiesReady(int deviceId, int result) {
+    if (_debug) _logger.d('UVCManager#onCapabilitiesReady:deviceId=$deviceId,result=$result');
+    final controller = _availableControllers[deviceId];
+    if (controller is UVCController) {
+      controller.onCapabilitiesReady(result);
+    }
+  }
+
+  /// 静止画の撮影完了イベントメッセージを受信したときの処理
+  void _handleOnStillCaptured(int deviceId, int result, Uint8List? jpeg) {
+    if (_debug) _logger.d('UVCManager#onStillCaptured:deviceId=$deviceId,result=$result');
+    final controller = _availableControllers[deviceId];
+    if (controller is UVCController) {
+      controller.onStillCaptured(result, jpeg);
+    }
+  }
+
+  /// 連写の完了イベントメッセージを受信したときの処理
+  /// 各フレームは[pts_us, frame_type, width, height, data]の配列
+  void _handleOnBurstCaptured(int deviceId, int result, List<dynamic>? frames) {
+    if (_debug) _logger.d('UVCManager#onBurstCaptured:deviceId=$deviceId,result=$result');
+    final controller = _availableControllers[deviceId];
+    if (controller is UVCController) {
+      controller.onBurstCaptured(result, [
+        for (final frame in frames ?? const [])
+          BurstFrame(
+            Duration(microseconds: frame[0]),
+            frame[1],
+            frame[2],
+            frame[3],
+            frame[4],
+          ),
+      ]);
+    }
+  }
+
+  /// 動きの有無が切り替わったイベントメッセージを受信したときの処理
+  void _handleOnMotion(int deviceId, bool motion, int changedCells, int peak, int ptsUs) {
+    if (_debug) _logger.d('UVCManager#onMotion:deviceId=$deviceId,motion=$motion');
+    final controller = _availableControllers[deviceId];
+    if (controller is UVCController) {
+      controller.onMotion(MotionEvent(motion, changedCells, peak, Duration(microseconds: ptsUs)));
+    }
+  }
 }
 
 void keepScreenOn(bool onoff) {
@@ -614,8 +1135,46 @@ String _arrayToString(ffi.Array<ffi.Uint8> array) {
   return String.fromCharCodes(stringList);
 }
 
+/// 共有タスクプールのワーカースレッドを指定するときの機器識別ID(THREAD_POLICY_POOL)
+const int _poolThreadPolicyId = -1;
+
+/// 一度に取得する映像処理スレッドの統計情報の最大数
+const int _maxThreadStats = 64;
+
+/// 映像処理スレッドのスレッドポリシーをセットするヘルパー関数
+int _setThreadPolicy(int deviceId, ThreadPolicy policy) {
+  final p = ffi.calloc<flutter_thread_policy_t>();
+  try {
+    p.ref.cpu_mask = policy.cpuMask;
+    p.ref.nice = policy.nice;
+    p.ref.rt_priority = policy.rtPriority;
+    return _binding.set_thread_policy(deviceId, p);
+  } finally {
+    ffi.calloc.free(p);
+  }
+}
+
+/// 映像処理スレッドの統計情報を取得するヘルパー関数
+List<ThreadStats> _getThreadStats(int deviceId) {
+  final result = <ThreadStats>[];
+  final stats = ffi.calloc<flutter_thread_stats_t>(_maxThreadStats);
+  try {
+    final num = _binding.get_thread_stats(deviceId, stats, _maxThreadStats);
+    for (int i = 0; i < num; i++) {
+      final s = stats[i];
+      result.add(ThreadStats(_arrayToString(s.name), s.device_id, s.tid, s.cpu,
+          s.sched_policy == 1, s.policy_result,
+          s.samples, s.migrations, s.preemptions, s.voluntary_switches));
+    }
+  } finally {
+    ffi.calloc.free(stats);
+  }
+  return result;
+}
+
 /// FFI経由で読み取ったバックエンド側の情報からVideoSizeを生成するヘルパー関数
-VideoSize createVideoSizeFrom(flutter_video_size sz) {
+/// selectedFpsはsetSizeで選択されたフレームレート(getCurrentSizeのときのみ)
+VideoSize createVideoSizeFrom(flutter_video_size sz, {double selectedFps = 0.0}) {
   var frameIntervals = <int>[];
   for (int i = 0; i < sz.num_frame_intervals; i++) {
     frameIntervals.add(sz.frame_intervals[i]);
@@ -631,9 +1190,53 @@ VideoSize createVideoSizeFrom(flutter_video_size sz) {
     sz.frame_interval_type,
     frameIntervals, sz.num_frame_intervals,
     fps, sz.num_fps,
+    selectedFps: selectedFps,
   );
 }
 
+/// UVCManager#planVideoSizesの引数をcomputeへ渡すためのヘルパークラス
+class _PlanParam {
+  final List<BandwidthRequest> requests;
+  final bool apply;
+  final int busBandwidth;
+
+  _PlanParam(this.requests, this.apply, this.busBandwidth);
+}
+
+/// 複数UVC機器の帯域計画を行う
+/// computeで別スレッド処理するために通常のdart関数としてラップ
+List<BandwidthPlan> _planVideoSizes(_PlanParam param) {
+  final result = <BandwidthPlan>[];
+  final num = param.requests.length;
+  final requests = ffi.calloc<flutter_bandwidth_request_t>(num);
+  final plan = ffi.calloc<flutter_bandwidth_plan_t>(num);
+  try {
+    for (int i = 0; i < num; i++) {
+      final request = param.requests[i];
+      requests[i].device_id = request.deviceId;
+      requests[i].min_width = request.minWidth;
+      requests[i].min_height = request.minHeight;
+      requests[i].min_fps = request.minFps;
+    }
+    final r = _binding.plan_video_sizes(
+        requests, num, param.busBandwidth, param.apply ? 1 : 0, plan);
+    if (r == 0) {
+      for (int i = 0; i < num; i++) {
+        final p = plan[i];
+        result.add(BandwidthPlan(p.device_id, p.frame_type, p.width, p.height,
+            p.frame_interval, p.fps, p.bandwidth,
+            p.negotiated_interval, p.negotiated_fps));
+      }
+    } else {
+      _logger.w("planVideoSizes:failed to plan,err=$r");
+    }
+  } finally {
+    ffi.calloc.free(requests);
+    ffi.calloc.free(plan);
+  }
+  return result;
+}
+
 ControlInfo _createControlInfoFrom(flutter_control_info_t info) {
   return ControlInfo(
       info.type,
@@ -645,3 +1248,54 @@ ControlInfo _createControlInfoFrom(flutter_control_info_t info) {
       info.min,
       info.max);
 }
+
+/// 動き検出を開始/停止するヘルパー関数
+int _setMotionDetection(int deviceId, MotionConfig? config) {
+  if (config == null) {
+    return _binding.set_motion_detection(deviceId, ffi.nullptr);
+  }
+  final mask = config.mask;
+  final p = ffi.calloc<flutter_motion_config_t>();
+  try {
+    p.ref.grid_columns = config.gridColumns;
+    p.ref.grid_rows = config.gridRows;
+    p.ref.subsample = config.subsample;
+    p.ref.cell_threshold = config.cellThreshold;
+    p.ref.min_cells = config.minCells;
+    p.ref.trigger_frames = config.triggerFrames;
+    p.ref.hold_ms = config.hold.inMilliseconds;
+    p.ref.interval_ms = config.interval.inMilliseconds;
+    p.ref.gate_recording = config.gateRecording ? 1 : 0;
+    if (mask != null) {
+      // 区画数を超えるマスクはnative側でエラーになる
+      p.ref.mask_cells = mask.length;
+      for (int i = 0; (i < mask.length) && (i < FLUTTER_MOTION_MAX_CELLS); i++) {
+        p.ref.mask[i] = mask[i] ? 1 : 0;
+      }
+    }
+    return _binding.set_motion_detection(deviceId, p);
+  } finally {
+    ffi.calloc.free(p);
+  }
+}
+
+/// ビットレート/フレームレート制御を設定するヘルパー関数
+int _setRateControl(int deviceId, RateControlConfig? config) {
+  if (config == null) {
+    return _binding.set_rate_control(deviceId, ffi.nullptr);
+  }
+  final p = ffi.calloc<flutter_rate_control_config_t>();
+  try {
+    p.ref.min_bitrate = config.minBitrate;
+    p.ref.max_bitrate = config.maxBitrate;
+    p.ref.target_queue_depth = config.targetQueueDepth;
+    p.ref.max_queue_depth = config.maxQueueDepth;
+    p.ref.max_decimation = config.maxDecimation;
+    p.ref.stall_permille = config.stallPermille;
+    p.ref.interval_ms = config.interval.inMilliseconds;
+    p.ref.recover_intervals = config.recoverIntervals;
+    return _binding.set_rate_control(deviceId, p);
+  } finally {
+    ffi.calloc.free(p);
+  }
+}
@@ -0,0 +1,42 @@
+// Copyright (c) 2020-2025 saki t_saki@serenegiant.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+/// 重複フレームの検出の統計情報
+/// 録画中に録画用Surfaceへ書き込む前のフレームを比較する
+class DedupStats {
+  /// 前のフレームと比較したフレーム数
+  final int frames;
+
+  /// 前のフレームと同じだったので書き込まなかったフレーム数
+  final int duplicates;
+
+  /// 連続した重複フレームの最大数
+  final int longestRun;
+
+  /// duplicates / frames, 比較したフレームが無ければ0
+  final double ratio;
+
+  /// コンストラクタ
+  DedupStats(
+    this.frames,
+    this.duplicates,
+    this.longestRun,
+    this.ratio,
+  );
+
+  @override
+  String toString() {
+    return 'DedupStats{frames:$frames, duplicates:$duplicates, longestRun:$longestRun, ratio:${ratio.toStringAsFixed(3)}}';
+  }
+}
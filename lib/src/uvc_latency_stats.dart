@@ -0,0 +1,74 @@
+// Copyright (c) 2020-2025 saki t_saki@serenegiant.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+/// 遅延を測定するパイプラインの段階
+/// native側のlatency_stage_tと同じ順にすること
+enum LatencyStage {
+  /// UVC機器からフレームを受け取った
+  fetch,
+
+  /// MJPEGのデコード/RGBAへの変換が終わった
+  convert,
+
+  /// プレビュー用Surfaceへ書き込んだ
+  preview,
+
+  /// 録画用Surface(エンコーダーの入力)へ書き込んだ
+  recording,
+
+  /// フレームコールバックを呼び出した
+  callback,
+}
+
+/// 撮影からパイプラインの段階へフレームが届くまでの遅延の集計結果
+class LatencyStats {
+  /// パイプラインの段階
+  final LatencyStage stage;
+
+  /// 測定したフレーム数
+  final int count;
+
+  /// 撮影からの遅延の最小値/平均値/最大値
+  final Duration min;
+  final Duration mean;
+  final Duration max;
+
+  /// ヒストグラムから求めた撮影からの遅延のパーセンタイル
+  /// ビンの上限値なので最大でビンの幅だけ大きい
+  final Duration p50;
+  final Duration p95;
+  final Duration p99;
+
+  /// 撮影からの遅延のヒストグラム
+  /// ビン0は1マイクロ秒未満, ビンi(i>=1)は[2^(i-1), 2^i)マイクロ秒, 最後のビンはそれ以上
+  final List<int> histogram;
+
+  /// コンストラクタ
+  LatencyStats(
+    this.stage,
+    this.count,
+    this.min,
+    this.mean,
+    this.max,
+    this.p50,
+    this.p95,
+    this.p99,
+    this.histogram,
+  );
+
+  @override
+  String toString() {
+    return 'LatencyStats{stage:${stage.name}, count:$count, min:$min, mean:$mean, max:$max, p50:$p50, p95:$p95, p99:$p99}';
+  }
+}
@@ -12,6 +12,7 @@
 //  See the License for the specific language governing permissions and
 //  limitations under the License.
 
+import 'dart:typed_data';
 import 'dart:ui';
 
 import 'package:plugin_platform_interface/plugin_platform_interface.dart';
@@ -40,6 +41,14 @@ abstract class UVCControllerInterface {
     throw UnimplementedError('stop() has not been implemented.');
   }
 
+  /// 対応解像度一覧/UVCコントロール一覧のnative側での取得完了を待機する
+  /// 取得失敗時もcompleteする
+  Future<void> waitCapabilitiesReady() async {
+    throw UnimplementedError(
+      'waitCapabilitiesReady() has not been implemented.',
+    );
+  }
+
   /// 対応する解像度設定一覧を取得
   Future<List<VideoSize>> getSupportedSize() async {
     throw UnimplementedError('getSupportedSize() has not been implemented.');
@@ -53,7 +62,10 @@ abstract class UVCControllerInterface {
   }
 
   /// 映像設定を適用
-  Future<VideoSize> setSize(int frameType, int width, int height) async {
+  /// fps/minFps/maxFpsを指定するとその範囲内で対応しているフレームレートを選択する
+  /// 選択したフレームレートは録画時にフレームを間引くのにだけ使い, UVC機器のフレームレートは変わらない
+  Future<VideoSize> setSize(int frameType, int width, int height,
+      {double fps = 0.0, double minFps = 0.0, double maxFps = 0.0}) async {
     throw UnimplementedError('setSize() has not been implemented.');
   }
 
@@ -92,6 +104,130 @@ abstract class UVCControllerInterface {
   Future<Null> releaseTexture() async {
     throw UnimplementedError('releaseTexture() has not been implemented.');
   }
+
+  /// 受け取った映像フレームのファイルへの記録を開始する
+  /// @param path 記録ファイルのパス, 既存のファイルは上書きする
+  int startFrameCapture(String path) {
+    throw UnimplementedError('startFrameCapture() has not been implemented.');
+  }
+
+  /// 映像フレームの記録を終了する
+  int stopFrameCapture() {
+    throw UnimplementedError('stopFrameCapture() has not been implemented.');
+  }
+
+  /// 映像の消費者を登録する
+  /// 消費者がいなくて映像取得を一時停止していればすぐに再開する
+  int acquireConsumer(ConsumerType type) {
+    throw UnimplementedError('acquireConsumer() has not been implemented.');
+  }
+
+  /// acquireConsumerで登録した映像の消費者を解除する
+  int releaseConsumer(ConsumerType type) {
+    throw UnimplementedError('releaseConsumer() has not been implemented.');
+  }
+
+  /// 消費者がいなくなってから映像取得を一時停止するまでの猶予時間をセットする
+  /// @param timeout 猶予時間, nullなら一時停止しない
+  int setIdleTimeout(Duration? timeout) {
+    throw UnimplementedError('setIdleTimeout() has not been implemented.');
+  }
+
+  /// ヘッドレスモードを切り替える
+  /// ヘッドレスモード中はプレビューのための処理を止めて録画だけを継続する
+  int setHeadless(bool headless) {
+    throw UnimplementedError('setHeadless() has not been implemented.');
+  }
+
+  /// 最後に映像取得中に解像度を変更した時に映像取得を再開するまでに掛かった時間を取得
+  Duration? getSwitchLatency() {
+    throw UnimplementedError('getSwitchLatency() has not been implemented.');
+  }
+
+  /// 映像取得を開始してから最初のフレームを受け取るまでに掛かった時間を取得
+  Duration? getTimeToFirstFrame() {
+    throw UnimplementedError('getTimeToFirstFrame() has not been implemented.');
+  }
+
+  /// 映像取得/録画スレッドのスレッドポリシーをセットする
+  /// 次のフレームから適用する
+  int setThreadPolicy(ThreadPolicy policy) {
+    throw UnimplementedError('setThreadPolicy() has not been implemented.');
+  }
+
+  /// 実行中の映像取得/録画スレッドの統計情報を取得する
+  List<ThreadStats> getThreadStats() {
+    throw UnimplementedError('getThreadStats() has not been implemented.');
+  }
+
+  /// 機器側クロックのずれと到着時刻の揺らぎを取得する
+  ClockStats? getClockStats() {
+    throw UnimplementedError('getClockStats() has not been implemented.');
+  }
+
+  /// 撮影からパイプラインの段階へフレームが届くまでの遅延の測定を有効/無効にする
+  int setLatencyProbe(bool enabled) {
+    throw UnimplementedError('setLatencyProbe() has not been implemented.');
+  }
+
+  /// 映像の一部だけを録画する
+  int setRecordingCrop(Rect? crop) {
+    throw UnimplementedError('setRecordingCrop() has not been implemented.');
+  }
+
+  /// 録画する映像を回転/反転する
+  int setRecordingOrientation(int rotation, {bool mirrorH = false, bool mirrorV = false}) {
+    throw UnimplementedError('setRecordingOrientation() has not been implemented.');
+  }
+
+  /// 次のフレームを静止画(JPEG)として撮影する
+  Future<Uint8List?> captureStill({String? path}) {
+    throw UnimplementedError('captureStill() has not been implemented.');
+  }
+
+  /// 連続したフレームを撮影する
+  Future<List<BurstFrame>> captureBurst(int count, {bool encode = false}) {
+    throw UnimplementedError('captureBurst() has not been implemented.');
+  }
+
+  /// 動き検出を開始/停止する
+  int setMotionDetection(MotionConfig? config) {
+    throw UnimplementedError('setMotionDetection() has not been implemented.');
+  }
+
+  /// 動きの有無が切り替わった時のイベント
+  Stream<MotionEvent> get motionEvents =>
+      throw UnimplementedError('motionEvents has not been implemented.');
+
+  /// 前のフレームと同じフレームを録画用Surfaceへ書き込まないようにする
+  int setFrameDedup(bool enabled, {int sampleRows = 4}) {
+    throw UnimplementedError('setFrameDedup() has not been implemented.');
+  }
+
+  /// 重複フレームの検出の統計情報を取得する
+  DedupStats? getDedupStats() {
+    throw UnimplementedError('getDedupStats() has not been implemented.');
+  }
+
+  /// エンコーダーの処理待ちに合わせて録画のビットレートとフレームレートを下げる
+  int setRateControl(RateControlConfig? config) {
+    throw UnimplementedError('setRateControl() has not been implemented.');
+  }
+
+  /// ビットレート/フレームレート制御の集計結果を取得する
+  RateControlStats? getRateControlStats() {
+    throw UnimplementedError('getRateControlStats() has not been implemented.');
+  }
+
+  /// 最近のビットレート/フレームレートの変更を古い順に取得する
+  List<RateDecision> getRateDecisions() {
+    throw UnimplementedError('getRateDecisions() has not been implemented.');
+  }
+
+  /// 撮影からパイプラインの段階へフレームが届くまでの遅延の集計結果を取得する
+  List<LatencyStats> getLatencyStats() {
+    throw UnimplementedError('getLatencyStats() has not been implemented.');
+  }
 }
 
 abstract class UVCManagerPlatform extends PlatformInterface {
@@ -143,6 +279,27 @@ abstract class UVCManagerPlatform extends PlatformInterface {
     throw UnimplementedError('getController() has not been implemented.');
   }
 
+  /// 複数のUVC機器を同時に使うときにUSBの帯域内に収まる映像設定を計画する
+  Future<List<BandwidthPlan>> planVideoSizes(List<BandwidthRequest> requests,
+      {bool apply = true, int busBandwidth = 0}) async {
+    throw UnimplementedError('planVideoSizes() has not been implemented.');
+  }
+
+  /// UVC機器が接続された時に映像取得開始後の最初のフレームまでの処理を前もって行うかどうかをセットする
+  int setPrewarmOnAttach(bool enabled) {
+    throw UnimplementedError('setPrewarmOnAttach() has not been implemented.');
+  }
+
+  /// 複数UVC機器で共有するタスクプールのワーカースレッドのスレッドポリシーをセットする
+  int setPoolThreadPolicy(ThreadPolicy policy) {
+    throw UnimplementedError('setPoolThreadPolicy() has not been implemented.');
+  }
+
+  /// 複数UVC機器で共有するタスクプールのワーカースレッドの統計情報を取得する
+  List<ThreadStats> getPoolThreadStats() {
+    throw UnimplementedError('getPoolThreadStats() has not been implemented.');
+  }
+
   /// 画面の自動消灯のON/OFF
   Future<Null> keepScreenOn(bool onoff) async {
     throw UnimplementedError('keepScreenOn() has not been implemented.');
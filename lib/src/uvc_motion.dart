@@ -0,0 +1,94 @@
+// Copyright (c) 2020-2025 saki t_saki@serenegiant.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+/// 動き検出の設定
+/// 映像を格子状に区切って区画毎に前のフレームとの輝度の差分の平均を求め,
+/// cellThreshold以上の区画がminCells以上あるフレームを動きがあるフレームとみなす
+class MotionConfig {
+  /// 映像を区切る格子の列数/行数(1〜32)
+  final int gridColumns;
+  final int gridRows;
+
+  /// 縦横何画素毎に解析するか(1, 2, 4, 8), 大きいほど負荷が小さい
+  final int subsample;
+
+  /// 感度, 区画の輝度の差分の平均がこの値以上なら変化したとみなす(1〜255)
+  final int cellThreshold;
+
+  /// 変化した区画がこの数以上あるフレームを動きがあるフレームとみなす
+  final int minCells;
+
+  /// 動きがあるフレームがこの数だけ続いたら動きを検出したとする
+  final int triggerFrames;
+
+  /// 動きが無い状態がこの時間続いたら動きが無くなったとする
+  final Duration hold;
+
+  /// フレームを解析する間隔, Duration.zeroなら全てのフレーム
+  final Duration interval;
+
+  /// trueなら動きが無い間は録画用Surfaceへ書き込まない
+  final bool gateRecording;
+
+  /// 行毎に並べた区画毎のマスク(gridColumns * gridRows個), falseの区画は解析しない
+  /// nullなら全ての区画を解析する
+  final List<bool>? mask;
+
+  /// コンストラクタ
+  const MotionConfig({
+    this.gridColumns = 16,
+    this.gridRows = 12,
+    this.subsample = 4,
+    this.cellThreshold = 12,
+    this.minCells = 2,
+    this.triggerFrames = 2,
+    this.hold = const Duration(seconds: 3),
+    this.interval = const Duration(milliseconds: 100),
+    this.gateRecording = false,
+    this.mask,
+  });
+
+  @override
+  String toString() {
+    return 'MotionConfig{grid:${gridColumns}x$gridRows, subsample:$subsample, cellThreshold:$cellThreshold, minCells:$minCells, triggerFrames:$triggerFrames, hold:$hold, interval:$interval, gateRecording:$gateRecording, mask:${mask?.length}}';
+  }
+}
+
+/// 動きの有無が切り替わった時のイベント
+class MotionEvent {
+  /// true: 動きを検出した, false: 動きが無くなった
+  final bool motion;
+
+  /// 切り替わったフレームで変化した区画の数
+  final int changedCells;
+
+  /// 切り替わったフレームの区画の輝度の差分の平均の最大値
+  final int peak;
+
+  /// 切り替わったフレームの機器側のPTS
+  final Duration pts;
+
+  /// コンストラクタ
+  MotionEvent(
+    this.motion,
+    this.changedCells,
+    this.peak,
+    this.pts,
+  );
+
+  @override
+  String toString() {
+    return 'MotionEvent{motion:$motion, changedCells:$changedCells, peak:$peak, pts:$pts}';
+  }
+}
@@ -150,7 +150,9 @@ class UVCVideoViewState extends State<UVCVideoView>
       case AppLifecycleState.hidden:
         break;
       case AppLifecycleState.paused:
-        await _controller.stop();
+        // 録画中の場合があるのでstopせずにテクスチャだけを破棄する
+        // (UVCManagerがヘッドレスモードにするので録画以外の消費者がいなければ
+        // 猶予時間後にnative側で映像取得を一時停止する)
         await _controller.releaseTexture();
         setState(() {
           _textureId = -1;
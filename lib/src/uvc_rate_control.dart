@@ -0,0 +1,165 @@
+// Copyright (c) 2020-2025 saki t_saki@serenegiant.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+/// ビットレート/フレームレート制御の設定
+/// エンコーダーの処理待ちのフレーム数がmaxQueueDepthを超えるか書き込みが停滞すると
+/// ビットレートを3/4ずつ下げ, 下げきるか処理待ちが大きく溢れたらフレームを間引く
+/// 処理待ちがtargetQueueDepth以下の状態がrecoverIntervals回続いたら
+/// フレームレート, ビットレートの順に1段階ずつ戻す
+class RateControlConfig {
+  /// 下げられる最低のビットレート[bps]
+  final int minBitrate;
+
+  /// 戻す時の最高のビットレート[bps], 0なら録画開始時のビットレート
+  final int maxBitrate;
+
+  /// エンコーダーの処理待ちのフレーム数がこの数以下なら追いついているとする
+  final int targetQueueDepth;
+
+  /// エンコーダーの処理待ちのフレーム数がこの数を超えたら遅れているとする
+  final int maxQueueDepth;
+
+  /// フレームを間引く最大の間隔(1〜8), 1なら間引かない
+  final int maxDecimation;
+
+  /// 書き込みが停滞した時間の割合[‰]がこの値以上なら停滞しているとする(1〜1000)
+  final int stallPermille;
+
+  /// 制御する最短の間隔(1ミリ秒以上)
+  final Duration interval;
+
+  /// 追いついた状態がこの回数続いたら1段階戻す
+  final int recoverIntervals;
+
+  /// コンストラクタ
+  const RateControlConfig({
+    this.minBitrate = 500000,
+    this.maxBitrate = 0,
+    this.targetQueueDepth = 2,
+    this.maxQueueDepth = 6,
+    this.maxDecimation = 4,
+    this.stallPermille = 200,
+    this.interval = const Duration(milliseconds: 500),
+    this.recoverIntervals = 4,
+  });
+
+  @override
+  String toString() {
+    return 'RateControlConfig{bitrate:$minBitrate..$maxBitrate, queue:$targetQueueDepth/$maxQueueDepth, maxDecimation:$maxDecimation, stallPermille:$stallPermille, interval:$interval, recoverIntervals:$recoverIntervals}';
+  }
+}
+
+/// ビットレート/フレームレート制御の集計結果
+class RateControlStats {
+  /// 評価したエンコーダーの報告の数
+  final int updates;
+
+  /// ビットレート/フレームレートを変更した回数
+  final int decisions;
+  final int bitrateDecreases;
+  final int bitrateIncreases;
+  final int decimationIncreases;
+  final int decimationDecreases;
+
+  /// 間引いて録画用Surfaceへ書き込まなかったフレーム数
+  final int droppedFrames;
+
+  /// 直近に測定したエンコーダーの出力[bps]
+  final int outputBps;
+
+  /// 現在のビットレート[bps], エンコーダーの報告が無ければ0
+  final int bitrate;
+
+  /// 現在のフレームの間引き間隔, 1なら間引いていない
+  final int decimation;
+
+  /// 直近と最大のエンコーダーの処理待ちのフレーム数
+  final int queueDepth;
+  final int maxQueueDepth;
+
+  /// 直近の書き込みが停滞した時間の割合[‰]
+  final int stallPermille;
+
+  /// コンストラクタ
+  RateControlStats(
+    this.updates,
+    this.decisions,
+    this.bitrateDecreases,
+    this.bitrateIncreases,
+    this.decimationIncreases,
+    this.decimationDecreases,
+    this.droppedFrames,
+    this.outputBps,
+    this.bitrate,
+    this.decimation,
+    this.queueDepth,
+    this.maxQueueDepth,
+    this.stallPermille,
+  );
+
+  @override
+  String toString() {
+    return 'RateControlStats{updates:$updates, decisions:$decisions, bitrate:$bitrate(-$bitrateDecreases/+$bitrateIncreases), decimation:$decimation(+$decimationIncreases/-$decimationDecreases), droppedFrames:$droppedFrames, outputBps:$outputBps, queueDepth:$queueDepth/$maxQueueDepth, stallPermille:$stallPermille}';
+  }
+}
+
+/// ビットレート/フレームレートを変更した理由
+enum RateReason {
+  /// エンコーダーの処理待ちのフレーム数がmaxQueueDepthを超えた
+  encoderBacklog,
+
+  /// 書き込みが停滞した
+  storageStall,
+
+  /// 追いついた状態が続いたので1段階戻した
+  recovered,
+}
+
+/// ビットレート/フレームレートの変更1回分
+class RateDecision {
+  /// 変更した時刻(CLOCK_MONOTONIC)
+  final Duration time;
+  final RateReason reason;
+  final int oldBitrate;
+  final int bitrate;
+  final int oldDecimation;
+  final int decimation;
+
+  /// 変更した時のエンコーダーの処理待ちのフレーム数
+  final int queueDepth;
+
+  /// 変更した時のエンコーダーの出力[bps]
+  final int outputBps;
+
+  /// 変更した時の書き込みが停滞した時間の割合[‰]
+  final int stallPermille;
+
+  /// コンストラクタ
+  RateDecision(
+    this.time,
+    this.reason,
+    this.oldBitrate,
+    this.bitrate,
+    this.oldDecimation,
+    this.decimation,
+    this.queueDepth,
+    this.outputBps,
+    this.stallPermille,
+  );
+
+  @override
+  String toString() {
+    return 'RateDecision{time:$time, reason:${reason.name}, bitrate:$oldBitrate->$bitrate, decimation:$oldDecimation->$decimation, queueDepth:$queueDepth, outputBps:$outputBps, stallPermille:$stallPermille}';
+  }
+}
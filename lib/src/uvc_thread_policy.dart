@@ -0,0 +1,99 @@
+// Copyright (c) 2020-2025 saki t_saki@serenegiant.com
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+
+/// 映像処理スレッドのスレッドポリシー
+/// 全て既定値なら全てのCPU, nice値0, SCHED_OTHER
+class ThreadPolicy {
+  /// 実行するCPUのビットマスク(ビットnがCPU n), 0なら全てのCPU
+  /// big.LITTLE構成でbigコアだけを指定するとLITTLEコアへ移動しなくなる
+  final int cpuMask;
+
+  /// nice値(-20〜19), SCHED_FIFOを使わない時に適用する
+  final int nice;
+
+  /// SCHED_FIFOの優先度(1〜99), 0ならSCHED_OTHER
+  /// 権限が無くてSCHED_FIFOにできなかった時はnice値を適用する
+  final int rtPriority;
+
+  /// コンストラクタ
+  const ThreadPolicy({
+    this.cpuMask = 0,
+    this.nice = 0,
+    this.rtPriority = 0,
+  });
+
+  /// CPU番号の一覧からcpuMaskを生成するコンストラクタ
+  ThreadPolicy.cpus(
+    List<int> cpus, {
+    this.nice = 0,
+    this.rtPriority = 0,
+  }) : cpuMask = cpus.fold(0, (mask, cpu) => mask | (1 << cpu));
+
+  @override
+  String toString() {
+    return 'ThreadPolicy{cpuMask:0x${cpuMask.toRadixString(16)}, nice:$nice, rtPriority:$rtPriority}';
+  }
+}
+
+/// 映像処理スレッドの統計情報
+class ThreadStats {
+  /// スレッド名
+  final String name;
+
+  /// UVC機器の識別子, -1なら共有タスクプールのワーカースレッド
+  final int deviceId;
+
+  /// カーネルのスレッドID
+  final int tid;
+
+  /// 最後に確認した時に実行していたCPU
+  final int cpu;
+
+  /// SCHED_FIFOが適用されているかどうか
+  final bool realtime;
+
+  /// スレッドポリシーを適用した結果, 0: 成功, 負: 最初に失敗した設定のエラーコード
+  final int policyResult;
+
+  /// 統計情報を更新した回数(映像処理スレッドのループ回数)
+  final int samples;
+
+  /// 実行するCPUが変わっていた回数
+  final int migrations;
+
+  /// 他のスレッドに横取りされた回数(非自発的コンテキストスイッチ)
+  final int preemptions;
+
+  /// 自発的コンテキストスイッチの回数
+  final int voluntarySwitches;
+
+  /// コンストラクタ
+  ThreadStats(
+    this.name,
+    this.deviceId,
+    this.tid,
+    this.cpu,
+    this.realtime,
+    this.policyResult,
+    this.samples,
+    this.migrations,
+    this.preemptions,
+    this.voluntarySwitches,
+  );
+
+  @override
+  String toString() {
+    return 'ThreadStats{name:$name, deviceId:$deviceId, tid:$tid, cpu:$cpu, realtime:$realtime, policyResult:$policyResult, samples:$samples, migrations:$migrations, preemptions:$preemptions, voluntarySwitches:$voluntarySwitches}';
+  }
+}
@@ -44,6 +44,11 @@ class VideoSize {
   /// フレームレートの個数
   final int numFps;
 
+  /// setSizeで選択されたフレームレート
+  /// getCurrentSize/setSizeの返値のみ有効, 未選択なら0
+  /// 録画時に間引くフレームレートで, UVC機器が送ってくるフレームレートではない
+  final double selectedFps;
+
   /// コンストラクタ
   VideoSize(
     this.frameType,
@@ -54,17 +59,37 @@ class VideoSize {
     this.frameIntervals,
     this.numFrameIntervals,
     this.fps,
-    this.numFps,
-  );
+    this.numFps, {
+    this.selectedFps = 0.0,
+  });
 
   /// 保持している解像度設定が有効かどうかを取得
   bool isValid() {
     return frameType != 0 && width != 0 && height != 0;
   }
 
+  /// 対応しているフレームレートの中から指定したフレームレートに最も近いものを取得
+  /// フレームレートの情報が無ければ0を返す
+  /// frameIntervalTypeが0(min/max/step)の場合はmin〜maxの範囲に制限した値を返す
+  double closestFps(double requested) {
+    if (frameIntervalType == 0 && numFrameIntervals >= 3) {
+      // フレームインターバルは100ナノ秒単位なので最小インターバルが最大フレームレート
+      final maxFps = frameIntervals[0] > 0 ? 1.0e7 / frameIntervals[0] : 0.0;
+      final minFps = frameIntervals[1] > 0 ? 1.0e7 / frameIntervals[1] : 0.0;
+      return requested.clamp(minFps, maxFps).toDouble();
+    }
+    var result = 0.0;
+    for (final f in fps) {
+      if (result == 0.0 || (f - requested).abs() < (result - requested).abs()) {
+        result = f;
+      }
+    }
+    return result;
+  }
+
   @override
   String toString() {
-    return 'VideoSize{isValid:${isValid()}, frameType:$frameType/(${frameTypeString(frameType)}), frameIndex:$frameIndex, width:$width, height:$height, frameIntervalType:$frameIntervalType, frameIntervals:$frameIntervals, numFrameIntervals:$numFrameIntervals, fps:$fps, numFps:$numFps}';
+    return 'VideoSize{isValid:${isValid()}, frameType:$frameType/(${frameTypeString(frameType)}), frameIndex:$frameIndex, width:$width, height:$height, frameIntervalType:$frameIntervalType, frameIntervals:$frameIntervals, numFrameIntervals:$numFrameIntervals, fps:$fps, numFps:$numFps, selectedFps:$selectedFps}';
   }
 
   String toShortString() {
@@ -131,6 +131,46 @@ class UVCPluginBindings {
   late final _set_video_size =
       _set_video_sizePtr.asFunction<int Function(int, int, int, int)>();
 
+  /// 映像サイズとフレームレートを設定する
+  /// 指定した映像サイズが対応しているフレームインターバルの中から
+  /// fpsに最も近いもの(min_fps〜max_fpsの範囲内)を選択する
+  /// aandusbはUVC機器へフレームインターバルを指定できないのでUVC機器は既定のフレームレートのままで,
+  /// 選択したフレームレートは録画時にフレームを間引くのにだけ使う(プレビュー/静止画/解析は間引かない)
+  /// @param device_id
+  /// @param type
+  /// @param width
+  /// @param height
+  /// @param fps 要求するフレームレート, 0以下なら範囲内で最大のフレームレート
+  /// @param min_fps 最小フレームレート, 0以下なら制限なし
+  /// @param max_fps 最大フレームレート, 0以下なら制限なし
+  /// @return 0: 成功, 負: エラーコード
+  int set_video_size_fps(
+    int device_id,
+    int type,
+    int width,
+    int height,
+    double fps,
+    double min_fps,
+    double max_fps,
+  ) {
+    return _set_video_size_fps(
+      device_id,
+      type,
+      width,
+      height,
+      fps,
+      min_fps,
+      max_fps,
+    );
+  }
+
+  late final _set_video_size_fpsPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int Function(ffi.Int32, ffi.Uint32, ffi.Uint32, ffi.Uint32,
+              ffi.Float, ffi.Float, ffi.Float)>>('set_video_size_fps');
+  late final _set_video_size_fps = _set_video_size_fpsPtr.asFunction<
+      int Function(int, int, int, int, double, double, double)>();
+
   int get_current_size(
     int device_id,
     ffi.Pointer<flutter_video_size_t> data,
@@ -148,6 +188,588 @@ class UVCPluginBindings {
   late final _get_current_size = _get_current_sizePtr
       .asFunction<int Function(int, ffi.Pointer<flutter_video_size_t>)>();
 
+  /// 現在選択されているフレームレートを取得する
+  /// 録画時に間引くフレームレートでUVC機器が送ってくるフレームレートではない
+  /// @param device_id
+  /// @return フレームレート, 未選択/エラー時は0
+  double get_current_fps(
+    int device_id,
+  ) {
+    return _get_current_fps(
+      device_id,
+    );
+  }
+
+  late final _get_current_fpsPtr =
+      _lookup<ffi.NativeFunction<ffi.Float Function(ffi.Int32)>>(
+          'get_current_fps');
+  late final _get_current_fps =
+      _get_current_fpsPtr.asFunction<double Function(int)>();
+
+  /// uvc_get_frameで受け取った映像フレームのファイルへの記録を開始する
+  /// 記録したファイルはFrameReplaySourceで再生できる
+  /// @param device_id
+  /// @param path 記録ファイルのパス, 既存のファイルは上書きする
+  /// @return 0: 成功, 負: エラーコード
+  int start_frame_capture(
+    int device_id,
+    ffi.Pointer<ffi.Char> path,
+  ) {
+    return _start_frame_capture(
+      device_id,
+      path,
+    );
+  }
+
+  late final _start_frame_capturePtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Int32, ffi.Pointer<ffi.Char>)>>(
+      'start_frame_capture');
+  late final _start_frame_capture = _start_frame_capturePtr
+      .asFunction<int Function(int, ffi.Pointer<ffi.Char>)>();
+
+  /// 映像フレームの記録を終了する
+  /// @param device_id
+  /// @return 0: 成功, 負: エラーコード
+  int stop_frame_capture(
+    int device_id,
+  ) {
+    return _stop_frame_capture(
+      device_id,
+    );
+  }
+
+  late final _stop_frame_capturePtr =
+      _lookup<ffi.NativeFunction<ffi.Int32 Function(ffi.Int32)>>(
+          'stop_frame_capture');
+  late final _stop_frame_capture =
+      _stop_frame_capturePtr.asFunction<int Function(int)>();
+
+  /// 映像の消費者を登録する
+  /// プレビュー用/録画用Surfaceは自動的に登録するのでそれ以外で映像を使う時に呼ぶ
+  /// 消費者がいなくて映像取得を一時停止していればすぐに再開する
+  /// @param device_id
+  /// @param type 0: プレビュー, 1: 録画, 2: 映像解析
+  /// @return 0以上: 登録後のその種類の消費者の数, 負: エラーコード
+  int acquire_consumer(
+    int device_id,
+    int type,
+  ) {
+    return _acquire_consumer(
+      device_id,
+      type,
+    );
+  }
+
+  late final _acquire_consumerPtr =
+      _lookup<ffi.NativeFunction<ffi.Int32 Function(ffi.Int32, ffi.Int32)>>(
+          'acquire_consumer');
+  late final _acquire_consumer =
+      _acquire_consumerPtr.asFunction<int Function(int, int)>();
+
+  /// acquire_consumerで登録した映像の消費者を解除する
+  /// 消費者がいなくなれば猶予時間の経過後に映像取得を一時停止する
+  /// @param device_id
+  /// @param type 0: プレビュー, 1: 録画, 2: 映像解析
+  /// @return 0以上: 解除後のその種類の消費者の数, 負: エラーコード
+  int release_consumer(
+    int device_id,
+    int type,
+  ) {
+    return _release_consumer(
+      device_id,
+      type,
+    );
+  }
+
+  late final _release_consumerPtr =
+      _lookup<ffi.NativeFunction<ffi.Int32 Function(ffi.Int32, ffi.Int32)>>(
+          'release_consumer');
+  late final _release_consumer =
+      _release_consumerPtr.asFunction<int Function(int, int)>();
+
+  /// 消費者がいなくなってから映像取得を一時停止するまでの猶予時間をセットする
+  /// @param device_id
+  /// @param timeout_ms 猶予時間[ミリ秒], 負なら一時停止しない
+  /// @return 0: 成功, 負: エラーコード
+  int set_idle_timeout(
+    int device_id,
+    int timeout_ms,
+  ) {
+    return _set_idle_timeout(
+      device_id,
+      timeout_ms,
+    );
+  }
+
+  late final _set_idle_timeoutPtr =
+      _lookup<ffi.NativeFunction<ffi.Int32 Function(ffi.Int32, ffi.Int32)>>(
+          'set_idle_timeout');
+  late final _set_idle_timeout =
+      _set_idle_timeoutPtr.asFunction<int Function(int, int)>();
+
+  /// ヘッドレスモードを切り替える
+  /// アプリがバックグラウンドの間はプレビューのための変換/描画/テクスチャ更新を止めて
+  /// 録画だけを継続する, プレビューだけなら消費者がいなくなるので猶予時間後に映像取得も一時停止する
+  /// @param device_id
+  /// @param headless 0: 解除, 0以外: ヘッドレスモード
+  /// @return 0: 成功, 負: エラーコード
+  int set_headless(
+    int device_id,
+    int headless,
+  ) {
+    return _set_headless(
+      device_id,
+      headless,
+    );
+  }
+
+  late final _set_headlessPtr =
+      _lookup<ffi.NativeFunction<ffi.Int32 Function(ffi.Int32, ffi.Int32)>>(
+          'set_headless');
+  late final _set_headless =
+      _set_headlessPtr.asFunction<int Function(int, int)>();
+
+  /// 最後に映像取得中に映像サイズを変更した時に映像取得を再開するまでに掛かった時間を取得
+  /// 映像取得中のset_video_size/set_video_size_fpsはSurfaceや録画スレッドはそのままで
+  /// 映像取得だけを終了→映像サイズ変更→再開する
+  /// @param device_id
+  /// @return 0以上: 切り替え時間[マイクロ秒](映像取得中に変更していなければ0), 負: エラーコード
+  int get_switch_latency_us(
+    int device_id,
+  ) {
+    return _get_switch_latency_us(
+      device_id,
+    );
+  }
+
+  late final _get_switch_latency_usPtr =
+      _lookup<ffi.NativeFunction<ffi.Int64 Function(ffi.Int32)>>(
+          'get_switch_latency_us');
+  late final _get_switch_latency_us =
+      _get_switch_latency_usPtr.asFunction<int Function(int)>();
+
+  /// UVC機器が接続された時に映像取得開始後の最初のフレームまでの処理
+  /// (共有タスクプールのワーカースレッドの生成, 録画用フレームバッファの確保)を前もって行うかどうかをセットする
+  /// 有効にした時に既に接続されているUVC機器も事前準備する
+  /// @param enabled 0: 事前準備しない(デフォルト), 0以外: 事前準備する
+  /// @return 0: 成功, 負: エラーコード
+  int set_prewarm_on_attach(
+    int enabled,
+  ) {
+    return _set_prewarm_on_attach(
+      enabled,
+    );
+  }
+
+  late final _set_prewarm_on_attachPtr =
+      _lookup<ffi.NativeFunction<ffi.Int32 Function(ffi.Int32)>>(
+          'set_prewarm_on_attach');
+  late final _set_prewarm_on_attach =
+      _set_prewarm_on_attachPtr.asFunction<int Function(int)>();
+
+  /// 映像取得を開始してから最初のフレームを受け取るまでに掛かった時間を取得
+  /// プレビューはaandusbが直接Surfaceへ描画するので録画用Surfaceへ最初のフレームを書き込むまでの時間
+  /// @param device_id
+  /// @return 0以上: 時間[マイクロ秒](最初のフレームを受け取っていなければ0), 負: エラーコード
+  int get_time_to_first_frame_us(
+    int device_id,
+  ) {
+    return _get_time_to_first_frame_us(
+      device_id,
+    );
+  }
+
+  late final _get_time_to_first_frame_usPtr =
+      _lookup<ffi.NativeFunction<ffi.Int64 Function(ffi.Int32)>>(
+          'get_time_to_first_frame_us');
+  late final _get_time_to_first_frame_us =
+      _get_time_to_first_frame_usPtr.asFunction<int Function(int)>();
+
+  /// 映像処理スレッドのスレッドポリシー(CPUアフィニティ/nice値/SCHED_FIFO)をセットする
+  /// 映像取得/録画スレッドは次のフレームから適用する, UVC機器を開く前にセットしてもよい
+  /// @param device_id UVC機器の識別子, -1なら複数UVC機器で共有するタスクプールのワーカースレッド
+  /// @param policy
+  /// @return 0: 成功, 負: エラーコード
+  int set_thread_policy(
+    int device_id,
+    ffi.Pointer<flutter_thread_policy_t> policy,
+  ) {
+    return _set_thread_policy(
+      device_id,
+      policy,
+    );
+  }
+
+  late final _set_thread_policyPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Int32,
+              ffi.Pointer<flutter_thread_policy_t>)>>('set_thread_policy');
+  late final _set_thread_policy = _set_thread_policyPtr
+      .asFunction<int Function(int, ffi.Pointer<flutter_thread_policy_t>)>();
+
+  /// 実行中の映像処理スレッドの統計情報を取得する
+  /// @param device_id UVC機器の識別子, -1なら複数UVC機器で共有するタスクプールのワーカースレッド
+  /// @param stats_out 統計情報を書き込むバッファ
+  /// @param max_stats stats_outの要素数
+  /// @return 0以上: 書き込んだ統計情報の数, 負: エラーコード
+  int get_thread_stats(
+    int device_id,
+    ffi.Pointer<flutter_thread_stats_t> stats_out,
+    int max_stats,
+  ) {
+    return _get_thread_stats(
+      device_id,
+      stats_out,
+      max_stats,
+    );
+  }
+
+  late final _get_thread_statsPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Int32, ffi.Pointer<flutter_thread_stats_t>,
+              ffi.Int32)>>('get_thread_stats');
+  late final _get_thread_stats = _get_thread_statsPtr.asFunction<
+      int Function(int, ffi.Pointer<flutter_thread_stats_t>, int)>();
+
+  /// 機器側PTSからCLOCK_MONOTONICへのクロックモデルの推定結果と到着時刻の揺らぎを取得する
+  /// 録画中に録画用Surfaceへ書き込んだフレームから推定する
+  /// @param device_id
+  /// @param stats_out
+  /// @return 0: 成功, 負: エラーコード
+  int get_clock_stats(
+    int device_id,
+    ffi.Pointer<flutter_clock_stats_t> stats_out,
+  ) {
+    return _get_clock_stats(
+      device_id,
+      stats_out,
+    );
+  }
+
+  late final _get_clock_statsPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Int32,
+              ffi.Pointer<flutter_clock_stats_t>)>>('get_clock_stats');
+  late final _get_clock_stats = _get_clock_statsPtr
+      .asFunction<int Function(int, ffi.Pointer<flutter_clock_stats_t>)>();
+
+  /// 撮影からパイプラインの段階へフレームが届くまでの遅延の測定を有効/無効にする
+  /// 映像ソースがフレームへ遅延測定用のスタンプ(シーケンス番号と撮影時刻)を埋め込んでいる時のみ測定できる
+  /// 有効/無効を切り替えると集計結果を破棄する
+  /// @param device_id
+  /// @param enabled 0: 無効, それ以外: 有効
+  /// @return 0: 成功, 負: エラーコード
+  int set_latency_probe(
+    int device_id,
+    int enabled,
+  ) {
+    return _set_latency_probe(
+      device_id,
+      enabled,
+    );
+  }
+
+  late final _set_latency_probePtr =
+      _lookup<ffi.NativeFunction<ffi.Int32 Function(ffi.Int32, ffi.Int32)>>(
+          'set_latency_probe');
+  late final _set_latency_probe =
+      _set_latency_probePtr.asFunction<int Function(int, int)>();
+
+  /// 映像の一部だけを録画する
+  /// 録画用Surfaceのサイズは次のフレームから切り取る範囲のサイズになる
+  /// @param device_id
+  /// @param x 切り取る範囲の左端(映像の画素単位)
+  /// @param y 切り取る範囲の上端(映像の画素単位)
+  /// @param width 切り取る範囲の幅, 幅か高さが0なら映像全体を録画する
+  /// @param height 切り取る範囲の高さ
+  /// @return 0: 成功, 負: エラーコード
+  int set_recording_crop(
+    int device_id,
+    int x,
+    int y,
+    int width,
+    int height,
+  ) {
+    return _set_recording_crop(
+      device_id,
+      x,
+      y,
+      width,
+      height,
+    );
+  }
+
+  late final _set_recording_cropPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Int32, ffi.Int32, ffi.Int32, ffi.Int32,
+              ffi.Int32)>>('set_recording_crop');
+  late final _set_recording_crop = _set_recording_cropPtr
+      .asFunction<int Function(int, int, int, int, int)>();
+
+  /// 録画する映像を回転/反転する
+  /// 切り出した範囲(set_recording_crop)を回転/反転して録画する
+  /// 録画用Surfaceのサイズは次のフレームから回転後のサイズになる
+  /// @param device_id
+  /// @param rotation 時計回りの回転角度, 0/90/180/270
+  /// @param mirror_h 0: 左右反転しない, それ以外: 左右反転する
+  /// @param mirror_v 0: 上下反転しない, それ以外: 上下反転する
+  /// @return 0: 成功, 負: エラーコード
+  int set_recording_orientation(
+    int device_id,
+    int rotation,
+    int mirror_h,
+    int mirror_v,
+  ) {
+    return _set_recording_orientation(
+      device_id,
+      rotation,
+      mirror_h,
+      mirror_v,
+    );
+  }
+
+  late final _set_recording_orientationPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Int32, ffi.Int32, ffi.Int32,
+              ffi.Int32)>>('set_recording_orientation');
+  late final _set_recording_orientation = _set_recording_orientationPtr
+      .asFunction<int Function(int, int, int, int)>();
+
+  /// 次のフレームを静止画(JPEG)としてワーカースレッドで撮影する
+  /// MJPEGはデコードせずにカメラが送ってきたJPEGをそのまま使う(ハフマンテーブルが無ければ標準のものを追加する)
+  /// 非圧縮フォーマットはJPEGへ圧縮する
+  /// 完了すると"on_still_captured"イベントをDartへ送信する
+  /// @param device_id
+  /// @param path 書き込み先のファイルパス, nullptrまたは空文字列ならJPEGデータをイベントで送る
+  /// @return 0: 撮影を開始した, 負: エラーコード
+  int capture_still(
+    int device_id,
+    ffi.Pointer<ffi.Char> path,
+  ) {
+    return _capture_still(
+      device_id,
+      path,
+    );
+  }
+
+  late final _capture_stillPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Int32, ffi.Pointer<ffi.Char>)>>(
+      'capture_still');
+  late final _capture_still = _capture_stillPtr
+      .asFunction<int Function(int, ffi.Pointer<ffi.Char>)>();
+
+  /// 連続したフレームをワーカースレッドで撮影する
+  /// 撮影開始前にすべてのスロットを確保するので撮影中はメモリを確保しない
+  /// 完了すると"on_burst_captured"イベントでフレーム毎のPTSとデータをまとめてDartへ送信する
+  /// @param device_id
+  /// @param count 撮影するフレーム数(1〜60)
+  /// @param encode 0以外ならすべて揃ってから並列にJPEGへ圧縮する, 0ならカメラ(録画中はRGBX)のフォーマットのまま
+  /// @return 0: 撮影を開始した, 負: エラーコード
+  int capture_burst(
+    int device_id,
+    int count,
+    int encode,
+  ) {
+    return _capture_burst(
+      device_id,
+      count,
+      encode,
+    );
+  }
+
+  late final _capture_burstPtr = _lookup<
+          ffi.NativeFunction<ffi.Int32 Function(ffi.Int32, ffi.Int32, ffi.Int32)>>(
+      'capture_burst');
+  late final _capture_burst =
+      _capture_burstPtr.asFunction<int Function(int, int, int)>();
+
+  /// 動き検出を開始/停止する
+  /// 映像を格子状に区切って前のフレームとの輝度の差分から動きを検出し,
+  /// 動きの有無が切り替わると"on_motion"イベントをDartへ送信する
+  /// config->gate_recordingが0以外なら動きが無い間は録画用Surfaceへ書き込まない
+  /// @param device_id
+  /// @param config 動き検出の設定, nullptrなら停止する
+  /// @return 0: 成功, 負: エラーコード
+  int set_motion_detection(
+    int device_id,
+    ffi.Pointer<flutter_motion_config_t> config,
+  ) {
+    return _set_motion_detection(
+      device_id,
+      config,
+    );
+  }
+
+  late final _set_motion_detectionPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Int32,
+              ffi.Pointer<flutter_motion_config_t>)>>('set_motion_detection');
+  late final _set_motion_detection = _set_motion_detectionPtr
+      .asFunction<int Function(int, ffi.Pointer<flutter_motion_config_t>)>();
+
+  /// 前のフレームと同じフレームを録画用Surfaceへ書き込まないようにする
+  /// 書き込まなかった間はエンコーダーが前のフレームを繰り返す
+  /// MJPEGはフレーム全体を, 非圧縮フォーマットはsample_rows行ごとの行だけを比較する
+  /// 有効/無効を切り替えると統計情報を破棄する
+  /// @param device_id
+  /// @param enabled 0: 無効, それ以外: 有効
+  /// @param sample_rows 比較する行の間隔(1〜64), 1なら全ての行
+  /// @return 0: 成功, 負: エラーコード
+  int set_frame_dedup(
+    int device_id,
+    int enabled,
+    int sample_rows,
+  ) {
+    return _set_frame_dedup(
+      device_id,
+      enabled,
+      sample_rows,
+    );
+  }
+
+  late final _set_frame_dedupPtr = _lookup<
+          ffi.NativeFunction<ffi.Int32 Function(ffi.Int32, ffi.Int32, ffi.Int32)>>(
+      'set_frame_dedup');
+  late final _set_frame_dedup =
+      _set_frame_dedupPtr.asFunction<int Function(int, int, int)>();
+
+  /// 重複フレームの検出の統計情報を取得する
+  /// @param device_id
+  /// @param stats_out
+  /// @return 0: 成功, 負: エラーコード
+  int get_dedup_stats(
+    int device_id,
+    ffi.Pointer<flutter_dedup_stats_t> stats_out,
+  ) {
+    return _get_dedup_stats(
+      device_id,
+      stats_out,
+    );
+  }
+
+  late final _get_dedup_statsPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Int32,
+              ffi.Pointer<flutter_dedup_stats_t>)>>('get_dedup_stats');
+  late final _get_dedup_stats = _get_dedup_statsPtr
+      .asFunction<int Function(int, ffi.Pointer<flutter_dedup_stats_t>)>();
+
+  /// エンコーダーの処理待ちや書き込みの停滞に合わせて録画のビットレートとフレームレートを下げる
+  /// 処理待ちが減ったらフレームレート, ビットレートの順に1段階ずつ戻す
+  /// 変更するとログへ出力し, get_rate_decisionsで取得できる
+  /// 設定すると制御状態と統計情報を破棄する
+  /// @param device_id
+  /// @param config 制御の設定, nullptrなら停止する(ビットレートはそのまま)
+  /// @return 0: 成功, 負: エラーコード
+  int set_rate_control(
+    int device_id,
+    ffi.Pointer<flutter_rate_control_config_t> config,
+  ) {
+    return _set_rate_control(
+      device_id,
+      config,
+    );
+  }
+
+  late final _set_rate_controlPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Int32,
+              ffi.Pointer<flutter_rate_control_config_t>)>>('set_rate_control');
+  late final _set_rate_control = _set_rate_controlPtr.asFunction<
+      int Function(int, ffi.Pointer<flutter_rate_control_config_t>)>();
+
+  /// ビットレート/フレームレート制御の集計結果を取得する
+  /// @param device_id
+  /// @param stats_out
+  /// @return 0: 成功, 負: エラーコード
+  int get_rate_control_stats(
+    int device_id,
+    ffi.Pointer<flutter_rate_control_stats_t> stats_out,
+  ) {
+    return _get_rate_control_stats(
+      device_id,
+      stats_out,
+    );
+  }
+
+  late final _get_rate_control_statsPtr = _lookup<
+          ffi.NativeFunction<
+              ffi.Int32 Function(
+                  ffi.Int32, ffi.Pointer<flutter_rate_control_stats_t>)>>(
+      'get_rate_control_stats');
+  late final _get_rate_control_stats = _get_rate_control_statsPtr.asFunction<
+      int Function(int, ffi.Pointer<flutter_rate_control_stats_t>)>();
+
+  /// 最近のビットレート/フレームレートの変更を古い順に取得する
+  /// @param device_id
+  /// @param decisions_out 変更を書き込むバッファ
+  /// @param max_decisions decisions_outの要素数, 最大FLUTTER_RATE_MAX_DECISIONS個
+  /// @return 0以上: 書き込んだ変更の数, 負: エラーコード
+  int get_rate_decisions(
+    int device_id,
+    ffi.Pointer<flutter_rate_decision_t> decisions_out,
+    int max_decisions,
+  ) {
+    return _get_rate_decisions(
+      device_id,
+      decisions_out,
+      max_decisions,
+    );
+  }
+
+  late final _get_rate_decisionsPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Int32, ffi.Pointer<flutter_rate_decision_t>,
+              ffi.Int32)>>('get_rate_decisions');
+  late final _get_rate_decisions = _get_rate_decisionsPtr.asFunction<
+      int Function(int, ffi.Pointer<flutter_rate_decision_t>, int)>();
+
+  /// 撮影からパイプラインの段階へフレームが届くまでの遅延の集計結果を取得する
+  /// 1フレームも届いていない段階は返さない
+  /// @param device_id
+  /// @param stats_out 集計結果を書き込むバッファ
+  /// @param max_stats stats_outの要素数
+  /// @return 0以上: 書き込んだ集計結果の数, 負: エラーコード
+  int get_latency_stats(
+    int device_id,
+    ffi.Pointer<flutter_latency_stats_t> stats_out,
+    int max_stats,
+  ) {
+    return _get_latency_stats(
+      device_id,
+      stats_out,
+      max_stats,
+    );
+  }
+
+  late final _get_latency_statsPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(ffi.Int32, ffi.Pointer<flutter_latency_stats_t>,
+              ffi.Int32)>>('get_latency_stats');
+  late final _get_latency_stats = _get_latency_statsPtr.asFunction<
+      int Function(int, ffi.Pointer<flutter_latency_stats_t>, int)>();
+
+  /// 対応解像度一覧/UVCコントロール一覧の取得が完了しているかどうか
+  /// UVC機器接続時にワーカースレッドで取得を開始し
+  /// 完了すると"on_capabilities_ready"イベントをDartへ送信する
+  /// @param device_id
+  /// @return 1: 取得完了, 0: 取得中, 負: エラーコード
+  int is_capabilities_ready(
+    int device_id,
+  ) {
+    return _is_capabilities_ready(
+      device_id,
+    );
+  }
+
+  late final _is_capabilities_readyPtr =
+      _lookup<ffi.NativeFunction<ffi.Int32 Function(ffi.Int32)>>(
+          'is_capabilities_ready');
+  late final _is_capabilities_ready =
+      _is_capabilities_readyPtr.asFunction<int Function(int)>();
+
   /// コントロール機能でサポートしている機能を取得
   /// @param device_id
   /// @return
@@ -280,6 +902,43 @@ class UVCPluginBindings {
       int Function(int, int, ffi.Pointer<ffi.Int32>,
           ffi.Pointer<flutter_video_size_t>)>();
 
+  /// 接続中の複数のUVC機器がUSBの帯域内に収まるように映像設定を計画する
+  /// 各UVC機器の対応解像度一覧から要求を満たし帯域内に収まる組み合わせのうち
+  /// 処理負荷が最も小さいもの(非圧縮フォーマット優先)を選択する
+  /// @param requests UVC機器毎の要求
+  /// @param num_requests requestsの要素数
+  /// @param bus_bandwidth USBバスの帯域[バイト/秒], 0ならUSB2.0の周期転送の帯域
+  /// @param apply 0以外なら計画した映像設定を適用する
+  /// @param plan_out 計画した映像設定を書き込むバッファ, num_requests個以上の要素が必要
+  /// @return 0: 成功, 負: エラーコード
+  int plan_video_sizes(
+    ffi.Pointer<flutter_bandwidth_request_t> requests,
+    int num_requests,
+    int bus_bandwidth,
+    int apply,
+    ffi.Pointer<flutter_bandwidth_plan_t> plan_out,
+  ) {
+    return _plan_video_sizes(
+      requests,
+      num_requests,
+      bus_bandwidth,
+      apply,
+      plan_out,
+    );
+  }
+
+  late final _plan_video_sizesPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(
+              ffi.Pointer<flutter_bandwidth_request_t>,
+              ffi.Int32,
+              ffi.Uint64,
+              ffi.Int32,
+              ffi.Pointer<flutter_bandwidth_plan_t>)>>('plan_video_sizes');
+  late final _plan_video_sizes = _plan_video_sizesPtr.asFunction<
+      int Function(ffi.Pointer<flutter_bandwidth_request_t>, int, int, int,
+          ffi.Pointer<flutter_bandwidth_plan_t>)>();
+
   /// 映像取得用のsurfaceをセットする
   /// @param device_id UVC機器の識別子
   /// @param tex_id   テクスチャID
@@ -417,6 +1076,438 @@ final class flutter_video_size extends ffi.Struct {
 /// Flutterのc#側にも同じ構造体を定義する必要がある
 typedef flutter_video_size_t = flutter_video_size;
 
+/// Dart側から複数UVC機器の帯域計画を要求するための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+@ffi.Packed(1)
+final class flutter_bandwidth_request extends ffi.Struct {
+  /// UVC機器の識別子
+  @ffi.Int32()
+  external int device_id;
+
+  /// 最小映像幅[ピクセル数], 0なら制限なし
+  @ffi.Uint32()
+  external int min_width;
+
+  /// 最小映像高さ[ピクセル数], 0なら制限なし
+  @ffi.Uint32()
+  external int min_height;
+
+  /// 最小フレームレート, 0以下なら15fps
+  @ffi.Float()
+  external double min_fps;
+}
+
+/// Dart側から複数UVC機器の帯域計画を要求するための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+typedef flutter_bandwidth_request_t = flutter_bandwidth_request;
+
+/// 複数UVC機器の帯域計画の結果をDart側へ返すための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+@ffi.Packed(1)
+final class flutter_bandwidth_plan extends ffi.Struct {
+  @ffi.Int32()
+  external int device_id;
+
+  @ffi.Uint32()
+  external int frame_type;
+
+  @ffi.Uint32()
+  external int width;
+
+  @ffi.Uint32()
+  external int height;
+
+  /// フレームインターバル[100ナノ秒単位], 録画時はこのフレームレートへ間引く
+  @ffi.Uint32()
+  external int frame_interval;
+
+  /// フレームレート
+  @ffi.Float()
+  external double fps;
+
+  /// 必要な帯域の見積もり[バイト/秒], negotiated_intervalで見積もる
+  @ffi.Uint64()
+  external int bandwidth;
+
+  /// UVC機器がネゴシエーションするフレームインターバル[100ナノ秒単位]
+  /// 映像サイズ変更時にフレームインターバルを指定できないので対応している最短のもの
+  @ffi.Uint32()
+  external int negotiated_interval;
+
+  /// UVC機器がネゴシエーションするフレームレート
+  @ffi.Float()
+  external double negotiated_fps;
+}
+
+/// 複数UVC機器の帯域計画の結果をDart側へ返すための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+typedef flutter_bandwidth_plan_t = flutter_bandwidth_plan;
+
+/// Dart側から映像処理スレッドのスレッドポリシーを指定するための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+@ffi.Packed(1)
+final class flutter_thread_policy extends ffi.Struct {
+  /// 実行するCPUのビットマスク(ビットnがCPU n), 0なら全てのCPU
+  @ffi.Uint64()
+  external int cpu_mask;
+
+  /// nice値(-20〜19)
+  @ffi.Int32()
+  external int nice;
+
+  /// SCHED_FIFOの優先度(1〜99), 0ならSCHED_OTHER
+  @ffi.Int32()
+  external int rt_priority;
+}
+
+/// Dart側から映像処理スレッドのスレッドポリシーを指定するための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+typedef flutter_thread_policy_t = flutter_thread_policy;
+
+/// 映像処理スレッドの統計情報をDart側へ返すための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+@ffi.Packed(1)
+final class flutter_thread_stats extends ffi.Struct {
+  @ffi.Array.multi([16])
+  external ffi.Array<ffi.Uint8> name;
+
+  @ffi.Int32()
+  external int device_id;
+
+  @ffi.Int32()
+  external int tid;
+
+  /// 最後に確認した時に実行していたCPU
+  @ffi.Int32()
+  external int cpu;
+
+  /// 適用されているスケジューリングポリシー, 0: SCHED_OTHER, 1: SCHED_FIFO
+  @ffi.Int32()
+  external int sched_policy;
+
+  /// スレッドポリシーを適用した結果, 0: 成功, 負: エラーコード
+  @ffi.Int32()
+  external int policy_result;
+
+  @ffi.Uint64()
+  external int samples;
+
+  /// 実行するCPUが変わっていた回数
+  @ffi.Uint64()
+  external int migrations;
+
+  /// 他のスレッドに横取りされた回数(非自発的コンテキストスイッチ)
+  @ffi.Uint64()
+  external int preemptions;
+
+  /// 自発的コンテキストスイッチの回数
+  @ffi.Uint64()
+  external int voluntary_switches;
+}
+
+/// 映像処理スレッドの統計情報をDart側へ返すための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+typedef flutter_thread_stats_t = flutter_thread_stats;
+
+/// 機器側PTSからCLOCK_MONOTONICへのクロックモデルの統計情報をDart側へ返すための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+@ffi.Packed(1)
+final class flutter_clock_stats extends ffi.Struct {
+  @ffi.Uint64()
+  external int frames;
+
+  /// PTSが無いので到着時刻をそのまま使ったフレーム数
+  @ffi.Uint64()
+  external int no_pts;
+
+  /// PTSの巻き戻り/不連続でクロックモデルをやり直した回数
+  @ffi.Uint64()
+  external int resets;
+
+  @ffi.Uint32()
+  external int samples;
+
+  /// 機器側クロックのずれ[ppm], 正なら機器側クロックが進んでいる
+  @ffi.Double()
+  external double drift_ppm;
+
+  /// 到着時刻の揺らぎの標準偏差/最大値[マイクロ秒]
+  @ffi.Int64()
+  external int jitter_us;
+
+  @ffi.Int64()
+  external int max_jitter_us;
+
+  /// 揺らぎを吸収するために録画用Surfaceへの書き込みを遅らせる時間[マイクロ秒]
+  @ffi.Int64()
+  external int pacing_us;
+}
+
+/// 機器側PTSからCLOCK_MONOTONICへのクロックモデルの統計情報をDart側へ返すための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+typedef flutter_clock_stats_t = flutter_clock_stats;
+
+/// 遅延測定のヒストグラムのビン数
+const int FLUTTER_LATENCY_HISTOGRAM_BUCKETS = 24;
+
+/// 撮影からパイプラインの段階へフレームが届くまでの遅延をDart側へ返すための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+@ffi.Packed(1)
+final class flutter_latency_stats extends ffi.Struct {
+  /// パイプラインの段階, 0: uvc_get_frame, 1: 変換, 2: プレビュー, 3: 録画(エンコーダーの入力), 4: フレームコールバック
+  @ffi.Int32()
+  external int stage;
+
+  @ffi.Uint64()
+  external int count;
+
+  /// 撮影からの遅延[マイクロ秒]
+  @ffi.Int64()
+  external int min_us;
+
+  @ffi.Int64()
+  external int mean_us;
+
+  @ffi.Int64()
+  external int max_us;
+
+  @ffi.Int64()
+  external int p50_us;
+
+  @ffi.Int64()
+  external int p95_us;
+
+  @ffi.Int64()
+  external int p99_us;
+
+  @ffi.Array.multi([24])
+  external ffi.Array<ffi.Uint32> histogram;
+}
+
+/// 撮影からパイプラインの段階へフレームが届くまでの遅延をDart側へ返すための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+typedef flutter_latency_stats_t = flutter_latency_stats;
+
+/// 動き検出の区画の最大数(32x32), マスクの要素数
+const int FLUTTER_MOTION_MAX_CELLS = 1024;
+
+/// Dart側から動き検出の設定を指定するための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+@ffi.Packed(1)
+final class flutter_motion_config extends ffi.Struct {
+  /// 映像を区切る格子の列数/行数(1〜32)
+  @ffi.Int32()
+  external int grid_columns;
+
+  @ffi.Int32()
+  external int grid_rows;
+
+  /// 縦横何画素毎に解析するか(1, 2, 4, 8)
+  @ffi.Int32()
+  external int subsample;
+
+  /// 区画の輝度の差分の平均がこの値以上なら変化したとみなす(1〜255)
+  @ffi.Int32()
+  external int cell_threshold;
+
+  /// 変化した区画がこの数以上あるフレームを動きがあるフレームとみなす
+  @ffi.Int32()
+  external int min_cells;
+
+  /// 動きがあるフレームがこの数だけ続いたら動きを検出したとする
+  @ffi.Int32()
+  external int trigger_frames;
+
+  /// 動きが無い状態がこの時間[ミリ秒]続いたら動きが無くなったとする
+  @ffi.Int32()
+  external int hold_ms;
+
+  /// フレームを解析する間隔[ミリ秒], 0なら全てのフレーム
+  @ffi.Int32()
+  external int interval_ms;
+
+  /// 0以外なら動きが無い間は録画用Surfaceへ書き込まない
+  @ffi.Int32()
+  external int gate_recording;
+
+  /// maskの有効な要素数, grid_columns * grid_rowsまたは0(全ての区画を解析する)
+  @ffi.Int32()
+  external int mask_cells;
+
+  /// 行毎に並べた区画毎のマスク, 0の区画は解析しない
+  @ffi.Array.multi([1024])
+  external ffi.Array<ffi.Uint8> mask;
+}
+
+/// Dart側から動き検出の設定を指定するための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+typedef flutter_motion_config_t = flutter_motion_config;
+
+/// 重複フレームの検出の統計情報をDart側へ返すための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+@ffi.Packed(1)
+final class flutter_dedup_stats extends ffi.Struct {
+  /// 前のフレームと比較したフレーム数
+  @ffi.Uint64()
+  external int frames;
+
+  /// 前のフレームと同じだったので変換/書き込みしなかったフレーム数
+  @ffi.Uint64()
+  external int duplicates;
+
+  /// 連続した重複フレームの最大数
+  @ffi.Uint64()
+  external int longest_run;
+
+  /// duplicates / frames, 比較したフレームが無ければ0
+  @ffi.Double()
+  external double ratio;
+}
+
+/// 重複フレームの検出の統計情報をDart側へ返すための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+typedef flutter_dedup_stats_t = flutter_dedup_stats;
+
+/// ビットレート/フレームレート制御の最近の変更の最大数
+const int FLUTTER_RATE_MAX_DECISIONS = 32;
+
+/// ビットレート/フレームレート制御の設定をDart側から受け取るための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+@ffi.Packed(1)
+final class flutter_rate_control_config extends ffi.Struct {
+  /// 下げられる最低のビットレート[bps]
+  @ffi.Int32()
+  external int min_bitrate;
+
+  /// 戻す時の最高のビットレート[bps], 0なら録画開始時のビットレート
+  @ffi.Int32()
+  external int max_bitrate;
+
+  /// エンコーダーの処理待ちのフレーム数がこの数以下なら追いついているとする
+  @ffi.Int32()
+  external int target_queue_depth;
+
+  /// エンコーダーの処理待ちのフレーム数がこの数を超えたら遅れているとする
+  @ffi.Int32()
+  external int max_queue_depth;
+
+  /// フレームを間引く最大の間隔(1〜8), 1なら間引かない
+  @ffi.Int32()
+  external int max_decimation;
+
+  /// 書き込みが停滞した時間の割合[‰]がこの値以上なら停滞しているとする(1〜1000)
+  @ffi.Int32()
+  external int stall_permille;
+
+  /// 制御する最短の間隔[ミリ秒](1以上)
+  @ffi.Int32()
+  external int interval_ms;
+
+  /// 追いついた状態がこの回数続いたら1段階戻す
+  @ffi.Int32()
+  external int recover_intervals;
+}
+
+/// ビットレート/フレームレート制御の設定をDart側から受け取るための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+typedef flutter_rate_control_config_t = flutter_rate_control_config;
+
+/// ビットレート/フレームレート制御の集計結果をDart側へ返すための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+@ffi.Packed(1)
+final class flutter_rate_control_stats extends ffi.Struct {
+  /// 評価したエンコーダーの報告の数
+  @ffi.Uint64()
+  external int updates;
+
+  /// ビットレート/フレームレートを変更した回数
+  @ffi.Uint64()
+  external int decisions;
+
+  @ffi.Uint64()
+  external int bitrate_decreases;
+
+  @ffi.Uint64()
+  external int bitrate_increases;
+
+  @ffi.Uint64()
+  external int decimation_increases;
+
+  @ffi.Uint64()
+  external int decimation_decreases;
+
+  /// 間引いて録画用Surfaceへ書き込まなかったフレーム数
+  @ffi.Uint64()
+  external int dropped_frames;
+
+  /// 直近に測定したエンコーダーの出力[bps]
+  @ffi.Uint64()
+  external int output_bps;
+
+  /// 現在のビットレート[bps], エンコーダーの報告が無ければ0
+  @ffi.Uint32()
+  external int bitrate;
+
+  /// 現在のフレームの間引き間隔, 1なら間引いていない
+  @ffi.Uint32()
+  external int decimation;
+
+  /// 直近と最大のエンコーダーの処理待ちのフレーム数
+  @ffi.Uint32()
+  external int queue_depth;
+
+  @ffi.Uint32()
+  external int max_queue_depth;
+
+  /// 直近の書き込みが停滞した時間の割合[‰]
+  @ffi.Uint32()
+  external int stall_permille;
+}
+
+/// ビットレート/フレームレート制御の集計結果をDart側へ返すための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+typedef flutter_rate_control_stats_t = flutter_rate_control_stats;
+
+/// ビットレート/フレームレートの変更1回分をDart側へ返すための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+@ffi.Packed(1)
+final class flutter_rate_decision extends ffi.Struct {
+  /// 変更した時刻(CLOCK_MONOTONIC)[マイクロ秒]
+  @ffi.Int64()
+  external int time_us;
+
+  /// 直近に測定したエンコーダーの出力[bps]
+  @ffi.Uint64()
+  external int output_bps;
+
+  /// 変更した理由, 0: エンコーダーの処理待ち, 1: 書き込みの停滞, 2: 回復
+  @ffi.Uint32()
+  external int reason;
+
+  @ffi.Uint32()
+  external int old_bitrate;
+
+  @ffi.Uint32()
+  external int bitrate;
+
+  @ffi.Uint32()
+  external int old_decimation;
+
+  @ffi.Uint32()
+  external int decimation;
+
+  /// 変更した時のエンコーダーの処理待ちのフレーム数と書き込みが停滞した時間の割合[‰]
+  @ffi.Uint32()
+  external int queue_depth;
+
+  @ffi.Uint32()
+  external int stall_permille;
+}
+
+/// ビットレート/フレームレートの変更1回分をDart側へ返すための構造体定義
+/// Dart側にも同じ構造体を定義する必要がある
+typedef flutter_rate_decision_t = flutter_rate_decision;
+
 /// 接続しているUSB機器情報
 @ffi.Packed(1)
 final class flutter_device_info extends ffi.Struct {
@@ -12,10 +12,19 @@
 //  See the License for the specific language governing permissions and
 //  limitations under the License.
 
+export './src/uvc_bandwidth_plan.dart';
+export './src/uvc_burst_frame.dart';
+export './src/uvc_clock_stats.dart';
+export './src/uvc_consumer_type.dart';
 export './src/uvc_control_info.dart';
 export './src/uvc_controller.dart';
+export './src/uvc_dedup_stats.dart';
 export './src/uvc_device_info.dart';
+export './src/uvc_latency_stats.dart';
+export './src/uvc_motion.dart';
 export './src/uvc_preview.dart';
+export './src/uvc_rate_control.dart';
+export './src/uvc_thread_policy.dart';
 export './src/uvc_video_size.dart';
 export './src/uvc_recorder.dart';
 export './src/uvc_manager_platform_interface.dart'
@@ -56,6 +56,13 @@ class MockUvcManagerPlatform
     throw UnimplementedError();
   }
 
+  @override
+  Future<List<BandwidthPlan>> planVideoSizes(List<BandwidthRequest> requests,
+      {bool apply = true, int busBandwidth = 0}) {
+    // TODO: implement planVideoSizes
+    throw UnimplementedError();
+  }
+
   @override
   void removeListener(VoidCallback listener) {
     // TODO: implement removeListener